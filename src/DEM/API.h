@@ -32,11 +32,13 @@ namespace deme {
 // class DEMDynamicThread;
 // class ThreadManager;
 class DEMInspector;
+class DEMInspectorGroup;
+class DEMDistributionInspector;
+class DEMCoarseGrainer;
 class DEMTracker;
 
 //////////////////////////////////////////////////////////////
-// TODO LIST: 1. Variable ts size (MAX_VEL flavor uses tracked max cp vel)
-//            2. Allow ext obj init CoM setting
+// TODO LIST: 2. Allow ext obj init CoM setting
 //            3. Instruct how many dT steps should at LEAST do before receiving kT update
 //            4. Sleepers that don't participate CD or integration
 //            5. Update the game of life demo (it's about model ingredient usage)
@@ -96,8 +98,8 @@ class DEMSolver {
     /// @brief Get the number of kT-reported potential contact pairs.
     /// @return Number of potential contact pairs.
     size_t GetNumContacts() const { return dT->getNumContacts(); }
-    /// Get the current time step size in simulation.
-    double GetTimeStepSize() const { return m_ts_size; }
+    /// Get the current time step size in simulation. With an adaptive time step, it is the step size dT last used.
+    double GetTimeStepSize() const { return ts_size_is_const ? m_ts_size : dT->getTimeStepSize(); }
     /// Get the current expand factor in simulation.
     float GetExpandFactor() const;
     /// Set the number of dT steps before it waits for a contact-pair info update from kT.
@@ -112,9 +114,36 @@ class DEMSolver {
     double GetSimTime() const;
     /// Set the simulation time manually.
     void SetSimTime(double time);
-    /// @brief Set the strategy for auto-adapting time step size (NOT implemented, no effect yet).
-    /// @param type "none" or "max_vel" or "int_diff".
+    /// @brief Set the strategy for auto-adapting time step size. The step size is derived from the system max velocity
+    /// each step: a collision must be resolved by a number of steps (SetAdaptiveTimeStepStepsPerCollision) and a
+    /// contact overlap must not grow too much in one step (SetAdaptiveTimeStepMaxOverlapRatio). The initial step size
+    /// is the one given by SetInitTimeStep.
+    /// @param type "none" (constant step size), "max_vel" (step size picked before each step), or "int_diff" (like
+    /// "max_vel", but a step is also judged by the velocity after it, and redone with a smaller step size if that
+    /// velocity calls for a much smaller one).
     void SetAdaptiveTimeStepType(const std::string& type);
+    /// @brief Set the range that the adaptive time step size must stay in.
+    /// @param min_ts Min step size (non-positive for 1/100 of the initial step size).
+    /// @param max_ts Max step size (non-positive for 10 times the initial step size).
+    void SetAdaptiveTimeStepBounds(double min_ts, double max_ts) {
+        adapt_ts_min = min_ts;
+        adapt_ts_max = max_ts;
+    }
+    /// @brief Set how much the adaptive time step size can grow from one step to the next (it can shrink at once).
+    /// @param rate Relative growth, such as 0.1 (default) for 10%.
+    void SetAdaptiveTimeStepMaxGrowth(float rate) { adapt_ts_max_growth = (rate > 0) ? rate : 0; }
+    /// @brief Set the number of steps that a collision must be resolved by. The collision time is estimated from the
+    /// Hertzian theory using the E and nu material properties, or from SetAdaptiveTimeStepStiffness.
+    /// @param n Steps per collision (default 30).
+    void SetAdaptiveTimeStepStepsPerCollision(float n) { adapt_ts_steps_per_collision = (n > 1) ? n : 1; }
+    /// @brief Set how much a contact overlap may grow in one step, as a fraction of the smallest sphere radius.
+    /// @param ratio Default 0.01.
+    void SetAdaptiveTimeStepMaxOverlapRatio(float ratio) { adapt_ts_max_overlap_ratio = (ratio > 0) ? ratio : 0; }
+    /// @brief Set the max contact stiffness for deriving the adaptive time step size, for linear-spring force models.
+    /// @param k Stiffness (non-positive to use the Hertzian estimate only).
+    void SetAdaptiveTimeStepStiffness(float k) { adapt_ts_stiffness = k; }
+    /// @brief Get the number of steps that were rejected and redone (with "int_diff" adaptive time step).
+    unsigned int GetNumRejectedSteps() const { return dT->tsController.GetNumRejected(); }
 
     /// @brief Set the time integrator for this simulator.
     /// @param intg "forward_euler" or "extended_taylor" or "centered_difference".
@@ -171,6 +200,16 @@ class DEMSolver {
 
     /// Instruct the solver if contact pair arrays should be sorted (based on the types of contacts) before usage.
     void SetSortContactPairs(bool use_sort) { should_sort_contacts = use_sort; }
+    /// @brief Calculate contact forces with kernels specialized for each contact type, rather than one kernel that
+    /// branches on the type.
+    /// @details The type-sorted contact pairs are split into one segment per contact type, and each is run by a kernel
+    /// compiled for that type only, which avoids warp divergence and the register pressure of the other types' code.
+    /// Segments smaller than a fuse size (see SetForceSegmentFuseSize) are run together by a kernel for all types.
+    /// Needs contact pair sorting (SetSortContactPairs), and falls back to the generic kernel without it.
+    void UseContactTypeSegmentedForce(bool use = true);
+    /// Set the number of contact pairs under which a contact type segment is fused with its small neighbors. Default
+    /// 2048.
+    void SetForceSegmentFuseSize(size_t n) { force_segment_fuse_size = n; }
 
     /// Instruct the solver to rearrange and consolidate clump templates information, then jitify it into GPU kernels
     /// (if set to true), rather than using flattened sphere component configuration arrays whose entries are associated
@@ -243,6 +282,20 @@ class DEMSolver {
     /// @param num_cnts Error-out contact number.
     void SetErrorOutAvgContacts(float num_cnts) { threshold_error_out_num_cnts = num_cnts; }
 
+    /// @brief Set how the contact arrays (on both workers, with the contact wildcards and the transfer buffers) grow
+    /// ahead of the contact number, and shrink after it stays low for a while. Call it when the solver is not running
+    /// (before Initialize or after a DoDynamicsThenSync).
+    /// @param policy The capacity policy (see CapacityPolicy).
+    void SetContactCapacityPolicy(const CapacityPolicy& policy) {
+        dT->contactCapacity.setPolicy(policy);
+        kT->contactCapacity.setPolicy(policy);
+    }
+    /// @brief Get how many times the contact arrays grew and shrank, and their peak capacity.
+    /// @param kinematic If true, get those of kT's arrays; otherwise, those of dT's.
+    CapacityStats GetContactCapacityStats(bool kinematic = false) const {
+        return kinematic ? kT->contactCapacity.getStats() : dT->contactCapacity.getStats();
+    }
+
     /// @brief Get the current number of contacts each sphere has.
     /// @return Number of contacts.
     float GetAvgSphContacts() const { return kT->stateParams.avgCntsPerSphere; }
@@ -252,6 +305,45 @@ class DEMSolver {
     void UseAdaptiveBinSize(bool use = true) { auto_adjust_bin_size = use; }
     /// @brief Disable the use of adaptive bin size (always use initial size).
     void DisableAdaptiveBinSize() { auto_adjust_bin_size = false; }
+    /// @brief Let rigid meshes use facet grids in their own frames, built once at initialization, instead of binning
+    /// their facets in the world frame at every contact detection. Meshes that later get deformed go back to the
+    /// world-frame binning automatically.
+    /// @param use Enable or disable.
+    /// @param cell_size Grid cell size. If not positive, it is picked based on the facet sizes of each mesh.
+    void UseRigidMeshLocalGrid(bool use = true, float cell_size = 0.f) {
+        use_mesh_local_grid = use;
+        mesh_local_grid_cell_size = cell_size;
+    }
+    /// @brief Find sphere--sphere contacts through a hierarchical grid, instead of the uniform bins. Each sphere is put
+    /// in the grid level whose cell size matches its diameter, and only looks for contacts in its neighboring cells at
+    /// its own level and the coarser levels. This helps strongly polydisperse systems (such as boulders in fines),
+    /// where any single bin size either packs too many fines in a bin or makes large spheres touch too many bins. The
+    /// bins are still used for the contacts involving meshes and analytical objects.
+    /// @param use Enable or disable.
+    void UseHierarchicalBinning(bool use = true) { use_hier_grid_cd = use; }
+    /// @brief Trigger contact detection by how far things moved since the last one (the Verlet list criterion), instead
+    /// of by step counts. All geometries are enlarged by a skin; a new CD is ordered when any owner moved (counting the
+    /// motion caused by its rotation) by a fraction of the skin, and dT waits for it only if the skin is used up. This
+    /// way no contact is missed, and a quiescent system rarely needs CD.
+    /// @param use Enable or disable.
+    /// @param skin The initial skin thickness. If not positive, 10% of the smallest sphere radius is used.
+    /// @param auto_tune If true, the skin is re-chosen on the fly, balancing the cost of the force calculation on the
+    /// extra pairs a thicker skin brings against the cost of more frequent CD.
+    void UseDisplacementTriggeredCD(bool use = true, float skin = 0.f, bool auto_tune = true) {
+        use_displacement_cd = use;
+        cd_skin = skin;
+        auto_tune_cd_skin = auto_tune;
+    }
+    /// @brief Set the range the skin stays in when it is auto-tuned in displacement-triggered CD.
+    /// @param min_skin Min skin thickness. If not positive, a tenth of the initial skin is used.
+    /// @param max_skin Max skin thickness. If not positive, ten times the initial skin is used.
+    void SetCDSkinRange(float min_skin, float max_skin) {
+        cd_skin_min = min_skin;
+        cd_skin_max = max_skin;
+    }
+    /// @brief Get the skin of the contact pairs currently in use (displacement-triggered CD only).
+    /// @return The skin thickness.
+    float GetCDSkin() const { return dT->getCDSkin(); }
     /// @brief Enable or disable the use of adaptive max update step count (by default it is on).
     /// @param use Enable or disable.
     void UseAdaptiveUpdateFreq(bool use = true) { auto_adjust_update_freq = use; }
@@ -267,12 +359,11 @@ class DEMSolver {
                 n);
         auto_adjust_observe_steps = (n >= 1) ? n : 1;
     }
-    /// @brief Set the max rate that the bin size can change in one adjustment.
-    /// @param rate 0: never changes; 1: can double or halve size in one go; suggest using default.
-    void SetAdaptiveBinSizeMaxRate(float rate) { auto_adjust_max_rate = (rate > 0) ? rate : 0; }
-    /// @brief Set how fast kT changes the direction of bin size adjustmemt when there's a more beneficial direction.
-    /// @param acc 0.01: slowly change direction; 1: quickly change direction
-    void SetAdaptiveBinSizeAcc(float acc) { auto_adjust_acc = clampBetween(acc, 0.01, 1.0); }
+    /// @brief Set the relative change of bin size that kT uses when probing how CD time responds to it. Once kT's cost
+    /// model of CD is fitted, it jumps to the predicted optimum directly, which this rate does not limit.
+    /// @param rate 0.01: tiny probes (that may drown in timing noise); 1: double or halve size in one probe; suggest
+    /// using default.
+    void SetAdaptiveBinSizeMaxRate(float rate) { auto_adjust_max_rate = (rate > 0.01) ? rate : 0.01; }
     /// @brief Set how proactive the solver is in avoiding the bin being too big (leading to too many geometries in a
     /// bin).
     /// @param ratio 0: not proavtive; 1: very proactive.
@@ -437,6 +528,40 @@ class DEMSolver {
     std::vector<float3> GetOwnerAcc(bodyID_t ownerID, bodyID_t n = 1) const;
     /// Get the angular acceleration of n consecutive owners.
     std::vector<float3> GetOwnerAngAcc(bodyID_t ownerID, bodyID_t n = 1) const;
+    /// @brief Write the state of n consecutive owners into a caller-owned buffer (which can be pinned memory, or a
+    /// view into a coupled code's own array), without allocating intermediate vectors.
+    /// @details Positions are decoded from the voxel representation on multiple host threads. Only the requested
+    /// owner range and columns are transferred from the device.
+    /// @param buffer The buffer to fill. Its precision is the output precision.
+    /// @param buffer_len Length of the buffer in elements. Must be at least layout.RequiredLength(n).
+    /// @param ownerID First owner's ID.
+    /// @param n The number of consecutive owners.
+    /// @param layout The columns (STATE_EXPORT_CONTENT flags) to write, and whether/how rows are interleaved.
+    /// @return The number of owners written.
+    size_t ExportOwnerState(float* buffer,
+                            size_t buffer_len,
+                            bodyID_t ownerID,
+                            bodyID_t n,
+                            const StateExportLayout& layout = StateExportLayout()) const;
+    size_t ExportOwnerState(double* buffer,
+                            size_t buffer_len,
+                            bodyID_t ownerID,
+                            bodyID_t n,
+                            const StateExportLayout& layout = StateExportLayout()) const;
+    /// @brief Write the state of the owners in a list into a caller-owned buffer. Row i of the buffer is IDs[i].
+    /// @param buffer The buffer to fill. Its precision is the output precision.
+    /// @param buffer_len Length of the buffer in elements. Must be at least layout.RequiredLength(IDs.size()).
+    /// @param IDs The owner IDs.
+    /// @param layout The columns (STATE_EXPORT_CONTENT flags) to write, and whether/how rows are interleaved.
+    /// @return The number of owners written.
+    size_t ExportOwnerState(float* buffer,
+                            size_t buffer_len,
+                            const std::vector<bodyID_t>& IDs,
+                            const StateExportLayout& layout = StateExportLayout()) const;
+    size_t ExportOwnerState(double* buffer,
+                            size_t buffer_len,
+                            const std::vector<bodyID_t>& IDs,
+                            const StateExportLayout& layout = StateExportLayout()) const;
     /// @brief Get the family number of n consecutive owners.
     /// @param ownerID First owner's ID.
     /// @param n The number of consecutive owners.
@@ -527,6 +652,15 @@ class DEMSolver {
     /// @return A sorted (based on contact body A's owner ID) vector of contact pairs. First is the owner ID of contact
     /// body A, and Second is that of contact body B.
     std::vector<std::pair<bodyID_t, bodyID_t>> GetContacts() const;
+    /// @brief Write all contact owner ID pairs (potential contacts included, unsorted) and optionally their contact
+    /// forces into caller-owned buffers, without allocating intermediate vectors.
+    /// @param idA Buffer for the owner IDs of contact body A.
+    /// @param idB Buffer for the owner IDs of contact body B.
+    /// @param forces Buffer for the contact forces (3 elements per contact, global frame). Can be nullptr.
+    /// @param capacity Number of contacts the buffers can hold. Must be no less than GetNumContacts().
+    /// @return The number of contacts written.
+    size_t ExportContacts(bodyID_t* idA, bodyID_t* idB, float* forces, size_t capacity) const;
+    size_t ExportContacts(bodyID_t* idA, bodyID_t* idB, double* forces, size_t capacity) const;
     /// @brief Get all contact ID pairs in the simulation system. Note all GetContact-like methods reports potential
     /// contacts (not necessarily confirmed contacts), meaning they are similar to what
     /// WriteContactFileIncludingPotentialPairs does, not what WriteContactFile does.
@@ -565,6 +699,28 @@ class DEMSolver {
     /// the normal direction at the contact point.
     std::shared_ptr<ContactInfoContainer> GetContactDetailedInfo(float force_thres = -1.0) const;
 
+    /// @brief Analyze the network of contacts between clumps, without exporting the contact pairs.
+    /// @details The analysis runs on the host, and gives the coordination number histogram, rattlers and mechanical
+    /// coordination, the strong-force subnetwork, cluster sizes and fabric tensors (see ContactNetwork.hpp). A contact
+    /// with a mesh or an analytical boundary counts toward the coordination of its clump, but does not link clumps.
+    /// @param opts Settings of the analysis.
+    /// @param force_thres Only contacts with force larger than this value are in the network.
+    /// @return The summary of the network.
+    ContactNetworkSummary GetContactNetworkSummary(const ContactNetworkOptions& opts = ContactNetworkOptions(),
+                                                   float force_thres = DEME_TINY_FLOAT) const;
+
+    /// @brief Dump the state of each contact in the force calculation, to check a host force model against the solver.
+    /// @details The force kernel then writes what the force model is given and what it produces as HostContactBatch
+    /// rows (see HostForceModel.hpp), at a cost of memory and bandwidth. Ingredients and contact wildcards the model
+    /// does not use are left at 0. Must be called before initialization.
+    void SetContactStateDump(bool flag = true);
+    /// @brief Get the contact states dumped in the last force calculation (see SetContactStateDump).
+    /// @details Only the pairs in contact are in it. With multi-rate integration, the last force calculation of a step
+    /// is that of the fast contacts only.
+    /// @return The contact states, which a host force model can be run over (CalcHostContactForces) or validated
+    /// against (ValidateHostForceModel), with the solver's materials, step size and time.
+    HostContactBatch GetContactStates() const;
+
     /// @brief Get the host memory usage (in bytes) on dT.
     /// @return Number of bytes.
     size_t GetHostMemUsageDynamic() const { return dT->estimateHostMemUsage(); }
@@ -579,6 +735,20 @@ class DEMSolver {
     size_t GetDeviceMemUsageKinematic() const { return kT->estimateDeviceMemUsage(); }
     /// @brief Print the current memory usage in pretty format.
     void ShowMemStats() const;
+    /// @brief Get the named memory records of the solver's arrays (current and peak bytes, on host and device).
+    /// @return Records in the order they were registered. Names start with the worker, like `dT.contactForces'.
+    std::vector<MemoryRecord> GetMemoryRecords() const { return m_mem_registry.GetRecords(); }
+    /// @brief Get the current and peak memory of each category of arrays (contact, owner, geometry, family, wildcard,
+    /// inspection, params, scratch).
+    std::map<std::string, MemoryRollup> GetMemoryCategoryRollups() const {
+        return m_mem_registry.GetCategoryRollups();
+    }
+    /// @brief Get the array growth events kept so far, oldest first.
+    std::vector<MemoryEvent> GetMemoryTimeline() const { return m_mem_registry.GetTimeline(); }
+    /// @brief Set how many array growth events are kept (the oldest are dropped first). Default is 4096.
+    void SetMemoryTimelineCapacity(size_t n) { m_mem_registry.SetTimelineCapacity(n); }
+    /// @brief Write the memory records, category rollups and growth timeline to a JSON file.
+    void WriteMemoryReport(const std::string& outfilename) const;
 
     /// Load input clumps (topology types and initial locations) on a per-pair basis. Note that the initial location
     /// means the location of the clumps' CoM coordinates in the global frame.
@@ -671,6 +841,26 @@ class DEMSolver {
     /// Create a inspector object that can help query some statistical info of the clumps in the simulation
     std::shared_ptr<DEMInspector> CreateInspector(const std::string& quantity = "clump_max_z");
     std::shared_ptr<DEMInspector> CreateInspector(const std::string& quantity, const std::string& region);
+    /// Create an inspector group: several quantities (added to it via Add) evaluated together in one pass, with the
+    /// results cached for the current time step
+    std::shared_ptr<DEMInspectorGroup> CreateInspectorGroup();
+    /// Create an inspector of the distribution (histogram, quantiles, grouped count/sum/extremes) of a quantity of
+    /// spheres, owners or contacts. Besides the quantities of CreateInspector (evaluated per entity, such as absv and
+    /// clump_kinetic_energy), it takes the contact quantities contact_force, contact_normal_force and contact_overlap,
+    /// and coordination_number (the number of force-bearing contacts of each clump).
+    std::shared_ptr<DEMDistributionInspector> CreateDistributionInspector(const std::string& quantity);
+    std::shared_ptr<DEMDistributionInspector> CreateDistributionInspector(const std::string& quantity,
+                                                                          const std::string& region);
+    /// Create a coarse-grainer that averages the clumps and contacts over time windows into continuum fields on a grid
+    /// of nX * nY * nZ nodes from lo, spacing apart. width is the standard deviation of the Gaussian weight, or the
+    /// support radius of Lucy's weight.
+    std::shared_ptr<DEMCoarseGrainer> CreateCoarseGrainer(float3 lo,
+                                                          float spacing,
+                                                          unsigned int nX,
+                                                          unsigned int nY,
+                                                          unsigned int nZ,
+                                                          CG_WEIGHT weight,
+                                                          float width);
 
     /// Instruct the solver that the 2 input families should not have contacts (a.k.a. ignored, if such a pair is
     /// encountered in contact detection). These 2 families can be the same (which means no contact within members of
@@ -926,6 +1116,45 @@ class DEMSolver {
                                  std::vector<float3>& torques,
                                  bool torque_in_local = false);
 
+    /// @brief Register a probe that monitors the total contact force on a set of owners.
+    /// @details All probes are evaluated together in one pass over the contacts, the first time any of them is queried
+    /// after a force calculation. A contact between two members of the same probe is internal to it: its forces on the
+    /// two members cancel, so it is left out of the probe's totals, count and detail.
+    /// @param ownerIDs The IDs of the owners.
+    /// @param ref_point The point about which the moments are taken.
+    /// @param keep_detail If true, the per-contact points, forces and torques can be retrieved using
+    /// GetContactForceProbeDetail.
+    /// @return The index of this probe.
+    unsigned int AddContactForceProbe(const std::vector<bodyID_t>& ownerIDs,
+                                      const float3& ref_point = make_float3(0, 0, 0),
+                                      bool keep_detail = false);
+    /// @brief Register a probe that monitors the total contact force on all owners in some families.
+    /// @param families The family numbers.
+    /// @param ref_point The point about which the moments are taken.
+    /// @param keep_detail If true, the per-contact detail is kept.
+    /// @return The index of this probe.
+    unsigned int AddFamilyContactForceProbe(const std::set<unsigned int>& families,
+                                            const float3& ref_point = make_float3(0, 0, 0),
+                                            bool keep_detail = false);
+    /// @brief Get the total contact force, moment and force center of a probe, as of the last force calculation.
+    /// @param probe The index of the probe.
+    /// @return The aggregated results.
+    ContactForceProbeResult GetContactForceProbeResult(unsigned int probe);
+    /// @brief Write the contact points, forces and torques (all global) of a probe registered with keep_detail into
+    /// caller-owned buffers, without allocating.
+    /// @param probe The index of the probe.
+    /// @param points Buffer for the contact points.
+    /// @param forces Buffer for the contact forces.
+    /// @param torques Buffer for the torques of the torque-only forces.
+    /// @param capacity Number of contacts the buffers can hold. Must be no less than the numContacts of
+    /// GetContactForceProbeResult.
+    /// @return Number of contacts written.
+    size_t GetContactForceProbeDetail(unsigned int probe,
+                                      float3* points,
+                                      float3* forces,
+                                      float3* torques,
+                                      size_t capacity);
+
     /// @brief Set the wildcard values of some triangles.
     /// @param geoID The ID of the starting (first) triangle that needs to be modified.
     /// @param name The name of the wildcard.
@@ -980,6 +1209,42 @@ class DEMSolver {
     /// @param extra_size The thickness of the extra contact margin.
     void SetFamilyExtraMargin(unsigned int N, float extra_size);
 
+    /// @brief Set the number of sub-steps the fast contacts take in each time step (multi-rate integration).
+    /// @details The contacts involving a sub-stepped family (see SetFamilySubStepped), and optionally all sphere--mesh
+    /// contacts (see SetMeshContactsSubStepped), are fast; the rest are slow. In a time step, the slow contacts' forces
+    /// are computed once at its start and applied as an impulse, while the fast contacts' forces and the integration of
+    /// all owners are done in n sub-steps. So the time step size can be set by the bulk, and only the stiff contacts
+    /// pay for the small step size. Accelerations added by the user (such as AddOwnerNextStepAcc) act like slow forces.
+    /// @param n Number of sub-steps. 1 (default) turns multi-rate integration off.
+    void SetMultiRateSubSteps(unsigned int n);
+    /// @brief Let the contacts involving this family be fast (sub-stepped) in multi-rate integration.
+    /// @param N Family number.
+    /// @param flag Whether they are fast.
+    void SetFamilySubStepped(unsigned int N, bool flag = true);
+    /// @brief Let all sphere--mesh contacts be fast (sub-stepped) in multi-rate integration.
+    void SetMeshContactsSubStepped(bool flag = true);
+
+    /// @brief Let quiescent contact islands sleep, taking them out of force calculation and integration.
+    /// @details Owners linked by contact pairs form islands. An island falls asleep when all its owners' kinetic energy
+    /// per unit mass and all its contacts' overlap rates have stayed below thresholds (see SetSleepThresholds) for a
+    /// number of steps (see SetSleepSteps). A sleeping island is woken, as a whole, when an awake owner comes in
+    /// contact with it, when the family of its owners changes, or when its owners are given a velocity or an
+    /// acceleration. Owners of fixed families are static: they do not link islands and never wake them. Owners of
+    /// families with other prescribed motions never sleep. Contacts in a sleeping island keep the forces from before it
+    /// fell asleep. Adding clumps wakes all islands. Must be called before initialization.
+    void EnableSleeping(bool flag = true);
+    /// @brief Set the thresholds below which owners and contacts are considered quiet, for island sleeping.
+    /// @param ke_per_mass Kinetic energy per unit mass of an owner, (v^2 + (w r)^2) / 2 with r its bounding radius.
+    /// Default 1e-6.
+    /// @param overlap_rate A bound of the overlap rate of a contact, from its owners' velocities. Default 1e-3.
+    void SetSleepThresholds(float ke_per_mass, float overlap_rate);
+    /// @brief Set the number of steps an island must stay quiet for before it falls asleep. Default 1000.
+    void SetSleepSteps(unsigned int n);
+    /// @brief Set how often (in time steps) the solver looks for islands to put to sleep. Default 100.
+    void SetSleepCheckInterval(unsigned int n);
+    /// @brief Get the number of owners that are asleep now.
+    size_t GetNumSleepingOwners();
+
     /// @brief Get the owner wildcard's values of some owners.
     /// @param ownerID Starting owner's ID.
     /// @param name Wildcard's name.
@@ -1104,6 +1369,10 @@ class DEMSolver {
     /// @param force_thres Forces with magnitude smaller than this amount will not be outputted.
     void WriteContactFile(const std::string& outfilename, float force_thres = DEME_TINY_FLOAT) const;
     void WriteContactFile(const std::filesystem::path& outfilename) const { WriteContactFile(outfilename.string()); }
+    /// @brief Write the summary of the contact network (see GetContactNetworkSummary) to a file, as `key value' lines.
+    void WriteContactNetworkSummary(const std::string& outfilename,
+                                    const ContactNetworkOptions& opts = ContactNetworkOptions(),
+                                    float force_thres = DEME_TINY_FLOAT) const;
     /// @brief Write all contact pairs kT-supplied to a file, thus including the potential ones (those are not yet in
     /// contact, or recently used to be in contact).
     /// @details The outputted torque using this method is in global, rather than each object's local coordinate system.
@@ -1276,6 +1545,10 @@ class DEMSolver {
 
     /// Show the wall time and percentages of wall time spend on various solver tasks.
     void ShowTimingStats();
+    /// @brief Get the wall time (in seconds) spent on various solver tasks, as ShowTimingStats reports them.
+    /// @param kinematic If true, get those of kT's tasks; otherwise, those of dT's.
+    /// @return Pairs of task name and wall time, in the order the solver reports them.
+    std::vector<std::pair<std::string, double>> GetTimingStats(bool kinematic = false);
 
     /// Show potential anomalies that may have been there in the simulation, then clear the anomaly log.
     void ShowAnomalies();
@@ -1333,8 +1606,32 @@ class DEMSolver {
     /// Recommend "INFO".
     void SetVerbosity(const std::string& verbose);
     /// @brief Choose sphere and clump output file format.
-    /// @param format Choice among "CSV", "BINARY".
+    /// @param format Choice among "CSV", "BINARY", "QUANTIZED". "QUANTIZED" writes clumps' native voxel/sub-voxel
+    /// integers and grid parameters, so positions can be reconstructed exactly (see utils/QuantizedIO.hpp).
     void SetOutputFormat(const std::string& format);
+    /// @brief Set whether QUANTIZED clump output frames are coded against the previously written frame.
+    /// @details Delta-coded files must be decoded in the order they are written. A self-contained key frame is forced
+    /// when the set of outputted clumps changes.
+    /// @param use Whether to use delta coding.
+    /// @param keyframe_interval Force a key frame every this many frames (0 means only when needed).
+    void SetQuantizedOutputDeltaCoding(bool use, unsigned int keyframe_interval = 0) {
+        dT->quantEncoder.SetDeltaCoding(use, keyframe_interval);
+        dT->quantEncoder.Reset();
+    }
+    /// @brief Set a filter that selects the spheres/clumps written by WriteSphereFile and WriteClumpFile.
+    /// @details Regions, family sets, velocity/force ranges and subsampling can be combined, see
+    /// utils/OutputFilters.hpp. It is applied on top of DisableFamilyOutput.
+    /// @param filter The filter (copied).
+    void SetOutputFilter(const OutputFilter& filter) { dT->ownerOutputFilter = filter; }
+    /// @brief Set a filter that selects the contacts written by WriteContactFile. A contact is in a region if its
+    /// contact point is, and it is in a family if either of its owners is.
+    /// @param filter The filter (copied).
+    void SetContactOutputFilter(const OutputFilter& filter) { dT->contactOutputFilter = filter; }
+    /// @brief Remove the sphere/clump and contact output filters.
+    void ClearOutputFilters() {
+        dT->ownerOutputFilter.Clear();
+        dT->contactOutputFilter.Clear();
+    }
     /// @brief Specify the information that needs to go into the clump or sphere output files.
     /// @param content A list of "XYZ", "QUAT", "ABSV", "VEL", "ANG_VEL", "ABS_ACC", "ACC", "ANG_ACC", "FAMILY", "MAT",
     /// "OWNER_WILDCARD" and/or "GEO_WILDCARD".
@@ -1347,8 +1644,15 @@ class DEMSolver {
     /// "GEO_ID" and/or "NICKNAME".
     void SetContactOutputContent(const std::vector<std::string>& content);
     /// @brief Specify the output file format of meshes.
-    /// @param format A choice between "VTK", "OBJ".
+    /// @param format A choice between "VTK", "OBJ", "INCREMENTAL". "INCREMENTAL" writes mesh topology and nodes only
+    /// in the first (key) frame, then only the owner poses and deformed node blocks that changed; use
+    /// ReadMeshFrameFiles in utils/MeshFrameIO.hpp to reconstruct the geometry.
     void SetMeshOutputFormat(const std::string& format);
+    /// @brief Force a key frame in INCREMENTAL mesh output every this many frames (default 0: only the first frame and
+    /// when the meshes change), so the output can be read starting from the middle of a run.
+    void SetMeshOutputKeyframeInterval(unsigned int keyframe_interval) {
+        dT->meshFrameEncoder.SetKeyframeInterval(keyframe_interval);
+    }
 
     // void SetOutputContent(const std::string& content) { SetOutputContent({content}); }
     // void SetContactOutputContent(const std::string& content) { SetContactOutputContent({content}); }
@@ -1377,6 +1681,24 @@ class DEMSolver {
                              INSPECT_ENTITY_TYPE thing_to_insp,
                              CUB_REDUCE_FLAVOR reduce_flavor,
                              bool all_domain);
+    /// Let dT evaluate an inspector group and return the reduced values of its quantities.
+    float* dTInspectGroup(const std::shared_ptr<jitify::Program>& group_kernels,
+                          unsigned int nQuantities,
+                          bool inspect_spheres,
+                          bool inspect_owners);
+    /// Let dT evaluate the distribution of an inspected quantity and return the summaries of its groups.
+    std::vector<DistributionGroupResult> dTInspectDistribution(const std::shared_ptr<jitify::Program>& dist_kernels,
+                                                               INSPECT_ENTITY_TYPE thing_to_insp,
+                                                               bool need_contact_counts,
+                                                               unsigned int nGroups,
+                                                               const std::vector<float>& bin_edges,
+                                                               const std::vector<float>& quantiles);
+    /// Let dT deposit one coarse-graining sample, adding to the window sums.
+    void dTCoarseGrainSample(const std::shared_ptr<jitify::Program>& cg_kernels,
+                             const CGGridParams& grid,
+                             bool on_device,
+                             DualArray<double>& sums,
+                             unsigned int n_threads);
 
   private:
     ////////////////////////////////////////////////////////////////////////////////
@@ -1387,6 +1709,9 @@ class DEMSolver {
     VERBOSITY verbosity = INFO;
     // If true, dT should sort contact arrays (based on contact type) before usage
     bool should_sort_contacts = true;
+    // If true, contact forces are calculated by kernels specialized for each contact type
+    bool use_segmented_force = false;
+    size_t force_segment_fuse_size = 2048;
     // If true, the solvers may need to do a per-step sweep to apply family number changes
     bool famnum_can_change_conditionally = false;
 
@@ -1403,6 +1728,17 @@ class DEMSolver {
     // Whether to auto-adjust the bin size and the max update frequency
     bool auto_adjust_bin_size = true;
     bool auto_adjust_update_freq = true;
+    // Whether rigid meshes use local-frame facet grids, and the grid cell size (0 for auto)
+    bool use_mesh_local_grid = false;
+    float mesh_local_grid_cell_size = 0.f;
+    // Whether sphere--sphere contacts are found through the hierarchical grid
+    bool use_hier_grid_cd = false;
+    // Whether CD is triggered by displacement against a skin, the initial skin and its range (non-positive for auto)
+    bool use_displacement_cd = false;
+    bool auto_tune_cd_skin = true;
+    float cd_skin = 0.f;
+    float cd_skin_min = 0.f;
+    float cd_skin_max = 0.f;
     // User-instructed initial bin size as a multiple of smallest sphere radius
     float m_binSize_as_multiple = 8.0;
     // Target initial bin number
@@ -1456,7 +1792,7 @@ class DEMSolver {
     double m_voxelSize;
     // Time step size
     double m_ts_size = 1e-5;
-    // If the time step size is a constant (if not, it needs to be supplied with a file or a function)
+    // If the time step size is a constant (if not, it is chosen by dT's time step controller)
     bool ts_size_is_const = true;
     // The length unit. Any XYZ we report to the user, is under the hood a multiple of this l.
     float l = FLT_MAX;
@@ -1531,8 +1867,7 @@ class DEMSolver {
     // Num of steps that kT takes average before making a conclusion on the performance of this bin size
     unsigned int auto_adjust_observe_steps = 25;
     // See corresponding method for those...
-    float auto_adjust_max_rate = 0.03;
-    float auto_adjust_acc = 0.2;
+    float auto_adjust_max_rate = 0.2;
     float auto_adjust_upper_proactive_ratio = 0.75;
     float auto_adjust_lower_proactive_ratio = 0.5;
     unsigned int upper_bound_future_drift = 200;
@@ -1545,6 +1880,20 @@ class DEMSolver {
     // See SetCollectAccRightAfterForceCalc
     bool collect_force_in_force_kernel = false;
 
+    // Multi-rate integration: the number of sub-steps of the fast contacts, and whether sphere--mesh contacts are fast
+    unsigned int multi_rate_sub_steps = 1;
+    bool sub_step_mesh_contacts = false;
+
+    // See SetContactStateDump
+    bool dump_contact_states = false;
+
+    // Island sleeping
+    bool use_sleeping = false;
+    float sleep_ke_threshold = 1e-6;
+    float sleep_rate_threshold = 1e-3;
+    unsigned int sleep_steps = 1000;
+    unsigned int sleep_check_interval = 100;
+
     // Error-out avg num contacts
     float threshold_error_out_num_cnts = 100.;
 
@@ -1555,8 +1904,16 @@ class DEMSolver {
     std::shared_ptr<DEMForceModel> m_force_model =
         std::make_shared<DEMForceModel>(std::move(DEMForceModel(FORCE_MODEL::HERTZIAN)));
 
-    // Strategy for auto-adapting time steps size
+    // Strategy for auto-adapting time steps size, and its settings (see corresponding methods)
     ADAPT_TS_TYPE adapt_ts_type = ADAPT_TS_TYPE::NONE;
+    double adapt_ts_min = -1.;
+    double adapt_ts_max = -1.;
+    float adapt_ts_max_growth = 0.1;
+    float adapt_ts_steps_per_collision = 30.;
+    float adapt_ts_max_overlap_ratio = 0.01;
+    float adapt_ts_stiffness = -1.;
+    // Relative step size excess that makes a step rejected in "int_diff" mode
+    float adapt_ts_reject_tol = 0.5;
 
     ////////////////////////////////////////////////////////////////////////////////
     // No user method is provided to modify the following key quantities, even if
@@ -1577,6 +1934,9 @@ class DEMSolver {
 
     // Cached inspectors that can be used to query the simulation system
     std::vector<std::shared_ptr<DEMInspector>> m_inspectors;
+    std::vector<std::shared_ptr<DEMInspectorGroup>> m_inspector_groups;
+    std::vector<std::shared_ptr<DEMDistributionInspector>> m_dist_inspectors;
+    std::vector<std::shared_ptr<DEMCoarseGrainer>> m_coarse_grainers;
 
     // Total number of spheres
     size_t nSpheresGM = 0;
@@ -1778,6 +2138,10 @@ class DEMSolver {
     std::vector<float> m_ext_obj_mass;
     std::vector<float3> m_ext_obj_moi;
     std::vector<unsigned int> m_ext_obj_comp_num;  // number of component of each analytical obj
+    // Symmetry axis (zero if none) and CoM-to-furthest-point distance (DEME_HUGE_FLOAT if unbounded) of each analytical
+    // obj, which bound how far its rotation moves its geometry
+    std::vector<float3> m_ext_obj_sym_axis;
+    std::vector<float> m_ext_obj_bound_radius;
     // Meshed objects that will be flatten and transferred into kernels upon Initialize()
     std::vector<float> m_mesh_obj_mass;
     std::vector<float3> m_mesh_obj_moi;
@@ -1813,6 +2177,8 @@ class DEMSolver {
     ThreadManager* dTkT_InteractionManager;
     DEMKinematicThread* kT;
     DEMDynamicThread* dT;
+    // Named records of the workers' arrays; it outlives the workers, which are deleted in the destructor body
+    MemoryRegistry m_mem_registry;
 
     ////////////////////////////////////////////////////////////////////////////////
     // DEM system's private methods
@@ -1847,6 +2213,10 @@ class DEMSolver {
     void addWorldBoundingBox();
     /// Transfer cached solver preferences/instructions to dT and kT.
     void setSolverParams();
+    /// Derive the contact scales that limit the adaptive time step size from the templates and materials.
+    TimeStepScales figureOutTimeStepScales();
+    // Island sleeping roles of families, from their prescribed motions
+    std::vector<SLEEP_ROLE> figureOutFamilySleepRoles();
     /// Transfer (CPU-side) cached simulation data (about sim world) to the GPU-side. It is called automatically during
     /// system initialization.
     void setSimParams();
@@ -1941,6 +2311,7 @@ class DEMSolver {
     inline void equipFamilyPrescribedMotions(std::unordered_map<std::string, std::string>& strMap);
     inline void equipFamilyOnFlyChanges(std::unordered_map<std::string, std::string>& strMap);
     inline void equipForceModel(std::unordered_map<std::string, std::string>& strMap);
+    inline void equipForceSegments(std::unordered_map<std::string, std::string>& strMap);
     inline void equipIntegrationScheme(std::unordered_map<std::string, std::string>& strMap);
     inline void equipKernelIncludes(std::unordered_map<std::string, std::string>& strMap);
 };
@@ -7,6 +7,7 @@
 #include <DEM/API.h>
 #include <DEM/Defines.h>
 #include <DEM/HostSideHelpers.hpp>
+#include <DEM/utils/IndexWidth.hpp>
 
 #include <iostream>
 #include <fstream>
@@ -259,6 +260,19 @@ void DEMSolver::postResourceGenChecksAndTabKeeping() {
             nAnalGM);
     }
 
+    // Sanity check for entity numbers: owners and geometries are numbered by bodyID_t, and the user-loaded contacts
+    // by contactPairs_t
+    const std::pair<const char*, size_t> body_nums[] = {
+        {"owners", nOwnerBodies}, {"spheres", nSpheresGM}, {"triangles", nTriGM}};
+    for (const auto& body_num : body_nums) {
+        if (!IndexCountFits<bodyID_t>(body_num.second)) {
+            DEME_ERROR("%s", IndexOverflowMessage<bodyID_t>(body_num.first, body_num.second).c_str());
+        }
+    }
+    if (!IndexCountFits<contactPairs_t>(nExtraContacts)) {
+        DEME_ERROR("%s", IndexOverflowMessage<contactPairs_t>("user-loaded contacts", nExtraContacts).c_str());
+    }
+
     // Keep tab of some quatities... It has to be done this late, because initialization may add analytical objects to
     // the system.
     nLastTimeClumpTemplateLoad = nClumpTemplateLoad;
@@ -300,6 +314,7 @@ void DEMSolver::jitifyKernels() {
     equipFamilyPrescribedMotions(m_subs);
     equipFamilyOnFlyChanges(m_subs);
     equipForceModel(m_subs);
+    equipForceSegments(m_subs);
     equipIntegrationScheme(m_subs);
     equipKernelIncludes(m_subs);
 
@@ -540,7 +555,8 @@ void DEMSolver::decideBinSize() {
         }
     }
 
-    // A final safety check: Do we have more bins that our data type can handle?
+    // A final safety check: Do we have more bins that our data type can handle? (The comparison is done in 64 bits, so
+    // it also holds in the wide index mode.)
     if (m_num_bins > std::numeric_limits<binID_t>::max() - 1) {
         if (use_user_defined_bin_size != INIT_BIN_SIZE_TYPE::EXPLICIT) {
             DEME_WARNING(
@@ -558,8 +574,8 @@ void DEMSolver::decideBinSize() {
         } else {
             DEME_ERROR(
                 "The simulation world has %zu bins (for domain partitioning in contact detection), but the largest bin "
-                "ID that we can have is %zu.\nYou can try to make bins larger via SetInitBinSize, or redefine binID_t "
-                "and recompile.",
+                "ID that we can have is %zu.\nYou can try to make bins larger via SetInitBinSize, or rebuild DEME with "
+                "USE_WIDE_INDICES=ON to use 64-bit bin IDs.",
                 m_num_bins, (size_t)(std::numeric_limits<binID_t>::max() - 1));
         }
     }
@@ -618,7 +634,14 @@ void DEMSolver::reportInitStats() const {
             DEME_INFO("An unknown force model is in use, this is probably not going well...");
     }
 
-    if (use_user_defined_expand_factor) {
+    if (use_displacement_cd) {
+        DEME_INFO(
+            "Contact detection is triggered by displacement. All geometries are enlarged/thickened by a skin of %.6g "
+            "initially for contact detection purpose.",
+            dT->cdSkin);
+        DEME_INFO("This in the case of the smallest sphere, means enlarging radius by %.6g%%.",
+                  (dT->cdSkin / m_smallest_radius) * 100.0);
+    } else if (use_user_defined_expand_factor) {
         DEME_INFO(
             "All geometries are enlarged/thickened by %.6g (estimated with the initial step size and update frequency) "
             "for contact detection purpose.",
@@ -687,6 +710,51 @@ void DEMSolver::preprocessAnalyticalObjs() {
         }
         nAnalGM += this_num_anal_ent;
         m_ext_obj_comp_num.push_back(this_num_anal_ent);
+
+        // How far rotation can move this object's geometry, for displacement-triggered CD. Planes, and infinite
+        // cylinders whose axis passes through the CoM, do not change when turned about their normal or axis, so if all
+        // components share such an axis, only the turning of that axis counts. Unbounded components reach as far as
+        // the world does, which dT works out.
+        float3 sym_axis = make_float3(0, 0, 0);
+        bool has_sym_axis = true;
+        float bound_radius = 0.f;
+        for (unsigned int i = 0; i < ext_obj->types.size(); i++) {
+            const auto& param = comp_params.at(i);
+            float3 comp_axis = make_float3(0, 0, 0);
+            switch (ext_obj->types.at(i)) {
+                case OBJ_COMPONENT::PLANE:
+                    comp_axis = normalize(param.plane.normal);
+                    bound_radius = DEME_HUGE_FLOAT;
+                    break;
+                case OBJ_COMPONENT::CYL_INF:
+                    comp_axis = normalize(param.cyl.dir);
+                    bound_radius = DEME_HUGE_FLOAT;
+                    if (length(cross(param.cyl.center, comp_axis)) >
+                        ANAL_SYM_AXIS_TOLERANCE * length(param.cyl.center)) {
+                        has_sym_axis = false;
+                    }
+                    break;
+                case OBJ_COMPONENT::PLATE:
+                    has_sym_axis = false;
+                    bound_radius = std::max(bound_radius, length(param.plate.center) +
+                                                              std::sqrt(param.plate.h_dim_x * param.plate.h_dim_x +
+                                                                        param.plate.h_dim_y * param.plate.h_dim_y));
+                    break;
+                default:
+                    break;
+            }
+            if (!has_sym_axis)
+                continue;
+            if (length(sym_axis) == 0.f) {
+                sym_axis = comp_axis;
+            } else if (length(cross(sym_axis, comp_axis)) > ANAL_SYM_AXIS_TOLERANCE) {
+                has_sym_axis = false;
+            }
+        }
+        // A bounded object is better served by its own size
+        m_ext_obj_sym_axis.push_back((has_sym_axis && bound_radius >= DEME_HUGE_FLOAT) ? sym_axis
+                                                                                        : make_float3(0, 0, 0));
+        m_ext_obj_bound_radius.push_back(bound_radius);
         thisExtObj++;
     }
 }
@@ -1043,6 +1111,38 @@ void DEMSolver::setSolverParams() {
     // Time step constant-ness and expand factor constant-ness
     dT->solverFlags.isStepConst = ts_size_is_const;
     kT->solverFlags.isExpandFactorFixed = use_user_defined_expand_factor;
+    switch (adapt_ts_type) {
+        case (ADAPT_TS_TYPE::MAX_VEL):
+            dT->solverFlags.stepSizeStrat = VAR_TS_STRAT::MAX_VEL;
+            break;
+        case (ADAPT_TS_TYPE::INT_DIFF):
+            dT->solverFlags.stepSizeStrat = VAR_TS_STRAT::INT_GAP;
+            break;
+        default:
+            dT->solverFlags.stepSizeStrat = VAR_TS_STRAT::DEME_CONST;
+    }
+    // The saved state for step rejection is only needed when steps can be rejected
+    if (dT->solverFlags.stepSizeStrat != VAR_TS_STRAT::INT_GAP) {
+        dT->stepUndoBuffer.free();
+    }
+    if (!ts_size_is_const) {
+        dT->tsController.SetScales(figureOutTimeStepScales());
+        double min_ts = (adapt_ts_min > 0.) ? adapt_ts_min : 0.01 * m_ts_size;
+        double max_ts = (adapt_ts_max > 0.) ? adapt_ts_max : 10. * m_ts_size;
+        if (min_ts > max_ts) {
+            DEME_ERROR("The min adaptive time step size (%.6g) is larger than the max (%.6g).", min_ts, max_ts);
+        }
+        dT->tsController.SetBounds(min_ts, max_ts);
+        dT->tsController.SetMaxGrowth(adapt_ts_max_growth);
+        dT->tsController.SetStepsPerCollision(adapt_ts_steps_per_collision);
+        dT->tsController.SetMaxOverlapRatio(adapt_ts_max_overlap_ratio);
+        // Resting contacts still see the velocity that gravity brings about in a drop of the smallest radius
+        if (m_smallest_radius < FLT_MAX) {
+            dT->tsController.SetVelocityFloor(std::sqrt(2. * length(G) * m_smallest_radius));
+        }
+        dT->tsController.SetRejectionTolerance((adapt_ts_type == ADAPT_TS_TYPE::INT_DIFF) ? adapt_ts_reject_tol : 0.);
+        dT->tsController.Reset(m_ts_size);
+    }
 
     // Jitify or not
     dT->solverFlags.useClumpJitify = jitify_clump_templates;
@@ -1077,9 +1177,34 @@ void DEMSolver::setSolverParams() {
     dT->solverFlags.useNoContactRecord = no_recording_contact_forces;
     dT->solverFlags.useForceCollectInPlace = collect_force_in_force_kernel;
 
+    // Multi-rate integration
+    dT->solverFlags.nSubSteps = multi_rate_sub_steps;
+    dT->solverFlags.subStepMeshContacts = sub_step_mesh_contacts;
+
+    // Island sleeping
+    dT->solverFlags.useSleeping = use_sleeping;
+    dT->simParams->useSleeping = use_sleeping;
+    if (use_sleeping) {
+        dT->sleepManager.SetThresholds(sleep_ke_threshold, sleep_rate_threshold);
+        dT->sleepManager.SetSleepSteps(sleep_steps);
+        dT->sleepCheckInterval = sleep_check_interval;
+        const std::vector<SLEEP_ROLE> roles = figureOutFamilySleepRoles();
+        for (unsigned int i = 0; i < NUM_AVAL_FAMILIES; i++) {
+            dT->familySleepRole.setVal((notStupidBool_t)roles[i], i);
+        }
+    }
+
     // Whether sorts contact before using them (not implemented)
     kT->solverFlags.should_sort_pairs = should_sort_contacts;
     dT->solverFlags.should_sort_pairs = should_sort_contacts;
+    if (use_segmented_force && !should_sort_contacts) {
+        DEME_WARNING(
+            "Contact type-segmented force calculation needs contact pairs sorted by type, but sorting is disabled.\n"
+            "The generic force kernel will be used.");
+    }
+    dT->solverFlags.useSegmentedForce = use_segmented_force && should_sort_contacts;
+    dT->solverFlags.forceSegmentFuseSize = force_segment_fuse_size;
+    dT->solverFlags.dumpContactStates = dump_contact_states;
 
     // Error out policies
     kT->solverFlags.errOutAvgSphCnts = threshold_error_out_num_cnts;
@@ -1092,12 +1217,48 @@ void DEMSolver::setSolverParams() {
     kT->simParams->errOutVel = threshold_error_out_vel;
     dT->simParams->errOutVel = threshold_error_out_vel;
 
+    // Whether rigid meshes are binned once in their own frames
+    kT->solverFlags.useMeshLocalGrid = use_mesh_local_grid;
+    kT->meshLocalGridCellSize = mesh_local_grid_cell_size;
+    // Whether sphere--sphere contacts come from the hierarchical grid
+    kT->solverFlags.useHierGridCD = use_hier_grid_cd;
+
+    // Displacement-triggered CD
+    kT->solverFlags.useDisplacementCD = use_displacement_cd;
+    dT->solverFlags.useDisplacementCD = use_displacement_cd;
+    dT->solverFlags.autoTuneCDSkin = auto_tune_cd_skin;
+    if (use_displacement_cd) {
+        float skin = cd_skin;
+        if (skin <= 0.f) {
+            if (m_smallest_radius >= FLT_MAX || m_smallest_radius <= DEME_TINY_FLOAT) {
+                DEME_ERROR(
+                    "Displacement-triggered contact detection derives the default skin from the smallest sphere "
+                    "radius, but there is no sphere in this simulation.\nPlease specify the skin thickness in "
+                    "UseDisplacementTriggeredCD.");
+            }
+            skin = 0.1f * m_smallest_radius;
+        }
+        float min_skin = (cd_skin_min > 0.f) ? cd_skin_min : 0.1f * skin;
+        float max_skin = (cd_skin_max > 0.f) ? cd_skin_max : 10.f * skin;
+        if (min_skin > max_skin) {
+            DEME_ERROR("The min CD skin (%.6g) is larger than the max CD skin (%.6g).", min_skin, max_skin);
+        }
+        dT->cdSkin = clampBetween<float, float>(skin, min_skin, max_skin);
+        dT->cdSkinTuner.SetRange(min_skin, max_skin);
+        dT->cdSkinTuner.Clear();
+        if (use_user_defined_expand_factor) {
+            DEME_WARNING(
+                "SetExpandFactor has no effect when displacement-triggered contact detection is used; the CD skin is "
+                "used as the contact margin instead.");
+        }
+    }
+
     // Whether the solver should auto-update bin sizes
     kT->solverFlags.autoBinSize = auto_adjust_bin_size;
     {
         kT->stateParams.binChangeObserveSteps = auto_adjust_observe_steps;
-        kT->stateParams.binTopChangeRate = auto_adjust_max_rate;
-        kT->stateParams.binChangeRateAcc = auto_adjust_acc;
+        kT->binSizeTuner.SetObserveSteps(auto_adjust_observe_steps);
+        kT->binSizeTuner.SetProbeRatio(auto_adjust_max_rate);
         // Suppose for avoiding bins too big, the most proactive thing you can do is starting to shrink it when half max
         // geo count is reached...
         double base_val = 0.01;
@@ -1116,6 +1277,70 @@ void DEMSolver::setSolverParams() {
     dT->accumStepUpdater.SetCacheSize(max_drift_gauge_history_size);
 }
 
+std::vector<SLEEP_ROLE> DEMSolver::figureOutFamilySleepRoles() {
+    std::vector<SLEEP_ROLE> roles(NUM_AVAL_FAMILIES, SLEEP_ROLE::REGULAR);
+    for (unsigned int i = 0; i < m_unique_family_prescription.size(); i++) {
+        const auto& pre = m_unique_family_prescription.at(i);
+        if (!pre.used)
+            continue;
+        // Any prescription other than `stay still' makes the family active
+        const std::vector<std::string> motions = {pre.linPosX, pre.linPosY, pre.linPosZ, pre.oriQ,    pre.linVelX,
+                                                  pre.linVelY, pre.linVelZ, pre.rotVelX, pre.rotVelY, pre.rotVelZ,
+                                                  pre.accX,    pre.accY,    pre.accZ,    pre.angAccX, pre.angAccY,
+                                                  pre.angAccZ};
+        bool moves = false;
+        for (const auto& m : motions) {
+            if (m != "none" && m != "0")
+                moves = true;
+        }
+        bool fixed = pre.linVelXPrescribed && pre.linVelYPrescribed && pre.linVelZPrescribed &&
+                     pre.rotVelXPrescribed && pre.rotVelYPrescribed && pre.rotVelZPrescribed && pre.linVelX == "0" &&
+                     pre.linVelY == "0" && pre.linVelZ == "0" && pre.rotVelX == "0" && pre.rotVelY == "0" &&
+                     pre.rotVelZ == "0";
+        if (moves) {
+            roles[i] = SLEEP_ROLE::ACTIVE;
+        } else if (fixed) {
+            roles[i] = SLEEP_ROLE::STATIC;
+        }
+    }
+    return roles;
+}
+
+TimeStepScales DEMSolver::figureOutTimeStepScales() {
+    TimeStepScales scales;
+    // The collision time goes with (m^2 / R)^(1/5), so the clump type with the smallest m^2 / R (using its largest
+    // component) has the shortest
+    double min_m2_over_r = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < m_template_clump_mass.size(); i++) {
+        if (m_template_sp_radii.at(i).empty())
+            continue;
+        double rad = *std::max_element(m_template_sp_radii.at(i).begin(), m_template_sp_radii.at(i).end());
+        double mass = m_template_clump_mass.at(i);
+        if (rad > 0. && mass * mass / rad < min_m2_over_r) {
+            min_m2_over_r = mass * mass / rad;
+            scales.refMass = mass;
+            scales.refRadius = rad;
+        }
+    }
+    scales.minRadius = (m_smallest_radius < FLT_MAX) ? m_smallest_radius : 0.;
+    // The stiffest material pair is a material with itself
+    for (const auto& a_mat : m_loaded_materials) {
+        const auto& props = a_mat->mat_prop;
+        if (props.find("E") != props.end() && props.find("nu") != props.end()) {
+            double E = props.at("E"), nu = props.at("nu");
+            scales.maxEStar = std::max(scales.maxEStar, E / (2. * (1. - nu * nu)));
+        }
+    }
+    scales.maxStiffness = (adapt_ts_stiffness > 0.f) ? adapt_ts_stiffness : 0.;
+    if (scales.refMass <= 0. || (scales.maxEStar <= 0. && scales.maxStiffness <= 0.)) {
+        DEME_WARNING(
+            "The adaptive time step size cannot be limited by the collision time, since there is no clump, or the "
+            "materials have no E and nu properties.\nOnly the overlap limit and the step size bounds apply. For "
+            "linear-spring force models, consider SetAdaptiveTimeStepStiffness.");
+    }
+    return scales;
+}
+
 void DEMSolver::setSimParams() {
     if ((!use_user_defined_expand_factor) && m_approx_max_vel < 1e-4f && m_suggestedFutureDrift > 0) {
         DEME_WARNING(
@@ -1147,6 +1372,26 @@ void DEMSolver::setSimParams() {
             DEME_MAX_WILDCARD_NUM);
     }
     DEME_DEBUG_PRINTF("%u contact wildcards are in the force model.", nContactWildcards);
+    // Pooled contact wildcards must be declared, and be in one pool only
+    {
+        std::set<std::string> pooled;
+        for (const auto& pool : m_force_model->m_wildcard_pools) {
+            for (const auto& name : pool.names) {
+                if (m_force_model->m_contact_wildcards.find(name) == m_force_model->m_contact_wildcards.end()) {
+                    DEME_ERROR(
+                        "Contact wildcard %s is in a contact wildcard pool, but it is not declared in "
+                        "SetPerContactWildcards of the force model.",
+                        name.c_str());
+                }
+                if (!pooled.insert(name).second) {
+                    DEME_ERROR("Contact wildcard %s is in more than one contact wildcard pool.", name.c_str());
+                }
+            }
+        }
+        DEME_DEBUG_PRINTF("%zu of them are in %zu packed pools.", pooled.size(),
+                          m_force_model->m_wildcard_pools.size());
+    }
+    dT->wildcardPools = m_force_model->m_wildcard_pools;
 
     // Error-out velocity should be no smaller than the max velocity we can expect
     if (threshold_error_out_vel < m_approx_max_vel) {
@@ -1180,6 +1425,9 @@ void DEMSolver::allocateGPUArrays() {
     }));
     dThread.join();
     kThread.join();
+    // Wildcard arrays are only made now, so bind again
+    dT->bindMemoryRecords(&m_mem_registry);
+    kT->bindMemoryRecords(&m_mem_registry);
 }
 
 void DEMSolver::initializeGPUArrays() {
@@ -1201,7 +1449,7 @@ void DEMSolver::initializeGPUArrays() {
         // Clump template info (mass, sphere components, materials etc.)
         flattened_clump_templates,
         // Analytical obj `template' properties
-        m_ext_obj_mass, m_ext_obj_moi, m_ext_obj_comp_num,
+        m_ext_obj_mass, m_ext_obj_moi, m_ext_obj_comp_num, m_ext_obj_sym_axis, m_ext_obj_bound_radius,
         // Meshed obj `template' properties
         m_mesh_obj_mass, m_mesh_obj_moi,
         // Universal template info
@@ -1249,7 +1497,7 @@ void DEMSolver::updateClumpMeshArrays(size_t nOwners,
         // Clump template info (mass, sphere components, materials etc.)
         flattened_clump_templates,
         // Analytical obj `template' properties
-        m_ext_obj_mass, m_ext_obj_moi, m_ext_obj_comp_num,
+        m_ext_obj_mass, m_ext_obj_moi, m_ext_obj_comp_num, m_ext_obj_sym_axis, m_ext_obj_bound_radius,
         // Meshed obj `template' properties
         m_mesh_obj_mass, m_mesh_obj_moi,
         // Universal template info
@@ -1419,7 +1667,7 @@ inline void DEMSolver::equipForceModel(std::unordered_map<std::string, std::stri
     }
     // Then, owner/geo wildcards should be added to the ingredient list too. But first we check whether a wildcard
     // shares name with existing ingredients. If not, we add them to the list.
-    unsigned int owner_wc_num = 0, geo_wc_num = 0, cnt_wc_num = 0;
+    unsigned int owner_wc_num = 0, geo_wc_num = 0;
     for (const auto& owner_wildcard_name : owner_wildcard_names) {
         if (added_ingredients.find(owner_wildcard_name) != added_ingredients.end()) {
             DEME_ERROR(
@@ -1458,8 +1706,18 @@ inline void DEMSolver::equipForceModel(std::unordered_map<std::string, std::stri
                 "different name for this wildcard and try again.",
                 contact_wildcard_name.c_str());
         }
-        m_cnt_wc_num[contact_wildcard_name] = cnt_wc_num;
-        cnt_wc_num++;
+    }
+    // Those in packed pools are numbered after the dense ones, and dT numbers them the same way
+    std::set<std::string> dense_contact_wildcard_names;
+    {
+        std::map<std::string, unsigned int> wc_num;
+        std::vector<ContactWildcardSlot> wc_slots;
+        NumberContactWildcards(contact_wildcard_names, m_force_model->m_wildcard_pools, wc_num, wc_slots);
+        for (const auto& name_num : wc_num) {
+            m_cnt_wc_num[name_num.first] = name_num.second;
+            if (wc_slots.at(name_num.second).pool < 0)
+                dense_contact_wildcard_names.insert(name_num.first);
+        }
     }
 
     // Owner write-back needs ABOwner number
@@ -1521,7 +1779,9 @@ inline void DEMSolver::equipForceModel(std::unordered_map<std::string, std::stri
     // For contact wildcards, it needs to be brought from the global memory, and we expect the user's force model to use
     // and modify them, and in the end we will write them back to global mem.
     equip_contact_wildcards(cnt_wildcard_acquisition, cnt_wildcard_write_back, cnt_wildcard_destroy_record,
-                            contact_wildcard_names);
+                            dense_contact_wildcard_names);
+    EquipPooledContactWildcards(m_force_model->m_wildcard_pools, cnt_wildcard_acquisition, cnt_wildcard_write_back,
+                                cnt_wildcard_destroy_record);
 
     // If the user wants to reduce force in the calculation kernel...
     std::string whether_reduce_in_kernel = " ";
@@ -1529,6 +1789,12 @@ inline void DEMSolver::equipForceModel(std::unordered_map<std::string, std::stri
         whether_reduce_in_kernel = FORCE_REDUCTION_RIGHT_AFTER_CALC_STRAT();
     }
 
+    // If the contact states are dumped for checking host force models...
+    std::string state_dump_in = " ", state_dump_out = " ";
+    if (dump_contact_states) {
+        equip_contact_state_dump(state_dump_in, state_dump_out, added_ingredients, contact_wildcard_names);
+    }
+
     // If the user doesn't want to keep tab of contact forces...
     std::string contact_info_write_strat = " ";
     if (!no_recording_contact_forces) {
@@ -1542,6 +1808,8 @@ inline void DEMSolver::equipForceModel(std::unordered_map<std::string, std::stri
         ingredient_acquisition_B = compact_code(ingredient_acquisition_B);
         whether_reduce_in_kernel = compact_code(whether_reduce_in_kernel);
         contact_info_write_strat = compact_code(contact_info_write_strat);
+        state_dump_in = compact_code(state_dump_in);
+        state_dump_out = compact_code(state_dump_out);
     }
     strMap["_DEMForceModel_"] = model;
     strMap["_forceModelPrerequisites_;"] = model_prerequisites;
@@ -1562,6 +1830,8 @@ inline void DEMSolver::equipForceModel(std::unordered_map<std::string, std::stri
 
     strMap["_forceCollectInPlaceStrat_"] = whether_reduce_in_kernel;
     strMap["_contactInfoWrite_"] = contact_info_write_strat;
+    strMap["_contactStateDumpIn_"] = state_dump_in;
+    strMap["_contactStateDumpOut_"] = state_dump_out;
 
     DEME_DEBUG_PRINTF("Model ingredient definition:\n%s", ingredient_definition.c_str());
 
@@ -2085,6 +2355,25 @@ inline void DEMSolver::equipClumpTemplates(std::unordered_map<std::string, std::
     strMap["_componentAcqStrat_"] = componentAcqStrat;
 }
 
+inline void DEMSolver::equipForceSegments(std::unordered_map<std::string, std::string>& strMap) {
+    if (!dT->solverFlags.useSegmentedForce) {
+        strMap["_forceSegmentKernels_;"] = " ";
+        return;
+    }
+    // The contact types that can appear in this simulation each get a specialized kernel
+    unsigned int mask = ContactTypeBit(NOT_A_CONTACT) | ContactTypeBit(SPHERE_SPHERE_CONTACT);
+    if (nTriGM > 0) {
+        mask |= ContactTypeBit(SPHERE_MESH_CONTACT);
+    }
+    for (const auto& type : m_anal_types) {
+        mask |= ContactTypeBit(SPHERE_PLANE_CONTACT + type);
+    }
+    dT->forceSegmentTypeMask = mask;
+    std::string segment_kernels = GenerateForceSegmentKernels(mask);
+    DEME_DEBUG_PRINTF("Contact type-segmented force kernels:\n%s", segment_kernels.c_str());
+    strMap["_forceSegmentKernels_;"] = segment_kernels;
+}
+
 inline void DEMSolver::equipIntegrationScheme(std::unordered_map<std::string, std::string>& strMap) {
     std::string strat;
     switch (m_integrator) {
@@ -47,6 +47,9 @@ DEMSolver::DEMSolver(unsigned int nGPUs) {
     // Make friends
     dT->kT = kT;
     kT->dT = dT;
+
+    dT->bindMemoryRecords(&m_mem_registry);
+    kT->bindMemoryRecords(&m_mem_registry);
 }
 
 DEMSolver::~DEMSolver() {
@@ -100,6 +103,9 @@ void DEMSolver::SetOutputFormat(const std::string& format) {
         case ("BINARY"_):
             m_out_format = OUTPUT_FORMAT::BINARY;
             break;
+        case ("QUANTIZED"_):
+            m_out_format = OUTPUT_FORMAT::QUANTIZED;
+            break;
         case ("CHPF"_):
 #ifdef DEME_USE_CHPF
             m_out_format = OUTPUT_FORMAT::CHPF;
@@ -140,6 +146,9 @@ void DEMSolver::SetMeshOutputFormat(const std::string& format) {
         case ("OBJ"_):
             m_mesh_out_format = MESH_FORMAT::OBJ;
             break;
+        case ("INCREMENTAL"_):
+            m_mesh_out_format = MESH_FORMAT::INCREMENTAL;
+            break;
         default:
             DEME_ERROR("Instruction %s is unknown in SetMeshOutputFormat call.", format.c_str());
     }
@@ -395,6 +404,13 @@ std::vector<std::pair<bodyID_t, bodyID_t>> DEMSolver::GetClumpContacts(
     return out_pair;
 }
 
+size_t DEMSolver::ExportContacts(bodyID_t* idA, bodyID_t* idB, float* forces, size_t capacity) const {
+    return dT->exportContacts<float>(idA, idB, forces, capacity);
+}
+size_t DEMSolver::ExportContacts(bodyID_t* idA, bodyID_t* idB, double* forces, size_t capacity) const {
+    return dT->exportContacts<double>(idA, idB, forces, capacity);
+}
+
 std::vector<std::pair<bodyID_t, bodyID_t>> DEMSolver::GetContacts() const {
     std::vector<bodyID_t> idA_tmp, idB_tmp;
     std::vector<family_t> famA_tmp, famB_tmp;
@@ -457,6 +473,22 @@ std::shared_ptr<ContactInfoContainer> DEMSolver::GetContactDetailedInfo(float fo
     return dT->generateContactInfo(force_thres);
 }
 
+ContactNetworkSummary DEMSolver::GetContactNetworkSummary(const ContactNetworkOptions& opts, float force_thres) const {
+    return dT->analyzeContactNetwork(opts, force_thres);
+}
+
+void DEMSolver::SetContactStateDump(bool flag) {
+    assertSysNotInit("SetContactStateDump");
+    dump_contact_states = flag;
+}
+
+HostContactBatch DEMSolver::GetContactStates() const {
+    if (!dump_contact_states) {
+        DEME_WARNING("GetContactStates is called, but contact states are not dumped. Call SetContactStateDump first.");
+    }
+    return dT->getContactStates();
+}
+
 std::vector<float3> DEMSolver::GetOwnerPosition(bodyID_t ownerID, bodyID_t n) const {
     return dT->getOwnerPos(ownerID, n);
 }
@@ -475,6 +507,32 @@ std::vector<float3> DEMSolver::GetOwnerAcc(bodyID_t ownerID, bodyID_t n) const {
 std::vector<float3> DEMSolver::GetOwnerAngAcc(bodyID_t ownerID, bodyID_t n) const {
     return dT->getOwnerAngAcc(ownerID, n);
 }
+size_t DEMSolver::ExportOwnerState(float* buffer,
+                                   size_t buffer_len,
+                                   bodyID_t ownerID,
+                                   bodyID_t n,
+                                   const StateExportLayout& layout) const {
+    return dT->exportOwnerState<float>(buffer, buffer_len, ownerID, n, nullptr, layout);
+}
+size_t DEMSolver::ExportOwnerState(double* buffer,
+                                   size_t buffer_len,
+                                   bodyID_t ownerID,
+                                   bodyID_t n,
+                                   const StateExportLayout& layout) const {
+    return dT->exportOwnerState<double>(buffer, buffer_len, ownerID, n, nullptr, layout);
+}
+size_t DEMSolver::ExportOwnerState(float* buffer,
+                                   size_t buffer_len,
+                                   const std::vector<bodyID_t>& IDs,
+                                   const StateExportLayout& layout) const {
+    return dT->exportOwnerState<float>(buffer, buffer_len, 0, 0, &IDs, layout);
+}
+size_t DEMSolver::ExportOwnerState(double* buffer,
+                                   size_t buffer_len,
+                                   const std::vector<bodyID_t>& IDs,
+                                   const StateExportLayout& layout) const {
+    return dT->exportOwnerState<double>(buffer, buffer_len, 0, 0, &IDs, layout);
+}
 std::vector<unsigned int> DEMSolver::GetOwnerFamily(bodyID_t ownerID, bodyID_t n) const {
     return dT->getOwnerFamily(ownerID, n);
 }
@@ -568,6 +626,35 @@ size_t DEMSolver::GetOwnerContactForces(const std::vector<bodyID_t>& ownerIDs,
     return dT->getOwnerContactForces(ownerIDs, points, forces, torques, torque_in_local);
 }
 
+unsigned int DEMSolver::AddContactForceProbe(const std::vector<bodyID_t>& ownerIDs,
+                                             const float3& ref_point,
+                                             bool keep_detail) {
+    ContactForceProbe probe;
+    probe.owners = ownerIDs;
+    probe.refPoint = ref_point;
+    probe.keepDetail = keep_detail;
+    return dT->addContactForceProbe(probe);
+}
+unsigned int DEMSolver::AddFamilyContactForceProbe(const std::set<unsigned int>& families,
+                                                   const float3& ref_point,
+                                                   bool keep_detail) {
+    ContactForceProbe probe;
+    probe.families = families;
+    probe.refPoint = ref_point;
+    probe.keepDetail = keep_detail;
+    return dT->addContactForceProbe(probe);
+}
+ContactForceProbeResult DEMSolver::GetContactForceProbeResult(unsigned int probe) {
+    return dT->getContactForceProbeResult(probe);
+}
+size_t DEMSolver::GetContactForceProbeDetail(unsigned int probe,
+                                             float3* points,
+                                             float3* forces,
+                                             float3* torques,
+                                             size_t capacity) {
+    return dT->getContactForceProbeDetail(probe, points, forces, torques, capacity);
+}
+
 std::vector<float> DEMSolver::GetOwnerMass(bodyID_t ownerID, bodyID_t n) const {
     std::vector<float> res(n);
     for (bodyID_t i = 0; i < n; i++) {
@@ -724,8 +811,6 @@ void DEMSolver::SetIntegrator(const std::string& intg) {
 }
 
 void DEMSolver::SetAdaptiveTimeStepType(const std::string& type) {
-    DEME_WARNING(
-        "SetAdaptiveTimeStepType is currently not implemented and has no effect, time step size is still fixed.");
     switch (hash_charr(type.c_str())) {
         case ("none"_):
             adapt_ts_type = ADAPT_TS_TYPE::NONE;
@@ -740,6 +825,7 @@ void DEMSolver::SetAdaptiveTimeStepType(const std::string& type) {
             DEME_ERROR("Adaptive time step type %s is unknown. Please select another via SetAdaptiveTimeStepType.",
                        type.c_str());
     }
+    ts_size_is_const = (adapt_ts_type == ADAPT_TS_TYPE::NONE);
 }
 
 void DEMSolver::SetCDNumStepsMaxDriftHistorySize(unsigned int n) {
@@ -1290,6 +1376,17 @@ void DEMSolver::ShowMemStats() const {
     DEME_PRINTF("kT device memory usage: %s\n", pretty_format_bytes(GetDeviceMemUsageKinematic()).c_str());
     DEME_PRINTF("dT host memory usage: %s\n", pretty_format_bytes(GetHostMemUsageDynamic()).c_str());
     DEME_PRINTF("dT device memory usage: %s\n", pretty_format_bytes(GetDeviceMemUsageDynamic()).c_str());
+    for (const auto& [cat, roll] : m_mem_registry.GetCategoryRollups()) {
+        DEME_PRINTF("  %s: device %s (peak %s), host %s (peak %s)\n", cat.c_str(),
+                    pretty_format_bytes(roll.bytes[1]).c_str(), pretty_format_bytes(roll.peakBytes[1]).c_str(),
+                    pretty_format_bytes(roll.bytes[0]).c_str(), pretty_format_bytes(roll.peakBytes[0]).c_str());
+    }
+}
+
+void DEMSolver::WriteMemoryReport(const std::string& outfilename) const {
+    std::ofstream reportFile(outfilename, std::ios::out);
+    m_mem_registry.WriteReport(reportFile);
+    reportFile.close();
 }
 
 void DEMSolver::AddFamilyPrescribedAcc(unsigned int ID,
@@ -1816,6 +1913,68 @@ void DEMSolver::SetFamilyExtraMargin(unsigned int N, float extra_size) {
     dT->familyExtraMarginSize.setVal(extra_size, N);
 }
 
+void DEMSolver::SetMultiRateSubSteps(unsigned int n) {
+    if (n == 0) {
+        DEME_ERROR("The number of multi-rate sub-steps should be at least 1 (1 means no sub-stepping).");
+    }
+    multi_rate_sub_steps = n;
+    if (sys_initialized) {
+        dT->solverFlags.nSubSteps = n;
+    }
+}
+
+void DEMSolver::SetFamilySubStepped(unsigned int N, bool flag) {
+    if (N > std::numeric_limits<family_t>::max()) {
+        DEME_ERROR("You are sub-stepping family %u, but family number should not be larger than %u.", N,
+                   std::numeric_limits<family_t>::max());
+    }
+    dT->familySubStepped.setVal(flag ? 1 : 0, N);
+}
+
+void DEMSolver::UseContactTypeSegmentedForce(bool use) {
+    assertSysNotInit("UseContactTypeSegmentedForce");
+    use_segmented_force = use;
+}
+
+void DEMSolver::EnableSleeping(bool flag) {
+    assertSysNotInit("EnableSleeping");
+    use_sleeping = flag;
+}
+
+void DEMSolver::SetSleepThresholds(float ke_per_mass, float overlap_rate) {
+    if (ke_per_mass < 0. || overlap_rate < 0.) {
+        DEME_ERROR("Sleeping thresholds should not be negative.");
+    }
+    sleep_ke_threshold = ke_per_mass;
+    sleep_rate_threshold = overlap_rate;
+    dT->sleepManager.SetThresholds(ke_per_mass, overlap_rate);
+}
+
+void DEMSolver::SetSleepSteps(unsigned int n) {
+    sleep_steps = n;
+    dT->sleepManager.SetSleepSteps(n);
+}
+
+void DEMSolver::SetSleepCheckInterval(unsigned int n) {
+    if (n == 0) {
+        DEME_ERROR("The sleeping check interval should be at least 1 step.");
+    }
+    sleep_check_interval = n;
+    dT->sleepCheckInterval = n;
+}
+
+size_t DEMSolver::GetNumSleepingOwners() {
+    assertSysInit("GetNumSleepingOwners");
+    return dT->getNumSleepingOwners();
+}
+
+void DEMSolver::SetMeshContactsSubStepped(bool flag) {
+    sub_step_mesh_contacts = flag;
+    if (sys_initialized) {
+        dT->solverFlags.subStepMeshContacts = flag;
+    }
+}
+
 void DEMSolver::ClearCache() {
     deallocate_array(cached_input_clump_batches);
     deallocate_array(cached_extern_objs);
@@ -1917,6 +2076,37 @@ std::shared_ptr<DEMInspector> DEMSolver::CreateInspector(const std::string& quan
     return m_inspectors.back();
 }
 
+std::shared_ptr<DEMInspectorGroup> DEMSolver::CreateInspectorGroup() {
+    m_inspector_groups.push_back(std::make_shared<DEMInspectorGroup>(this, this->dT));
+    return m_inspector_groups.back();
+}
+
+std::shared_ptr<DEMDistributionInspector> DEMSolver::CreateDistributionInspector(const std::string& quantity) {
+    m_dist_inspectors.push_back(std::make_shared<DEMDistributionInspector>(this, this->dT, quantity));
+    return m_dist_inspectors.back();
+}
+
+std::shared_ptr<DEMDistributionInspector> DEMSolver::CreateDistributionInspector(const std::string& quantity,
+                                                                                 const std::string& region) {
+    m_dist_inspectors.push_back(std::make_shared<DEMDistributionInspector>(this, this->dT, quantity, region));
+    return m_dist_inspectors.back();
+}
+
+std::shared_ptr<DEMCoarseGrainer> DEMSolver::CreateCoarseGrainer(float3 lo,
+                                                                 float spacing,
+                                                                 unsigned int nX,
+                                                                 unsigned int nY,
+                                                                 unsigned int nZ,
+                                                                 CG_WEIGHT weight,
+                                                                 float width) {
+    if (!(spacing > 0.f) || !(width > 0.f) || nX == 0 || nY == 0 || nZ == 0) {
+        DEME_ERROR("CreateCoarseGrainer needs a positive spacing and width, and at least one node in each direction.");
+    }
+    m_coarse_grainers.push_back(std::make_shared<DEMCoarseGrainer>(
+        this, this->dT, MakeCGGridParams(lo.x, lo.y, lo.z, spacing, nX, nY, nZ, weight, width)));
+    return m_coarse_grainers.back();
+}
+
 void DEMSolver::WriteSphereFile(const std::string& outfilename) const {
     switch (m_out_format) {
 #ifdef DEME_USE_CHPF
@@ -1942,6 +2132,14 @@ void DEMSolver::WriteSphereFile(const std::string& outfilename) const {
             ptFile.close();
             break;
         }
+        case (OUTPUT_FORMAT::QUANTIZED): {
+            // Quantized output stores owner-level native positions; sphere positions are not voxel-native
+            std::ofstream ptFile(outfilename, std::ios::out);
+            DEME_WARNING("Quantized output is only available for clumps (WriteClumpFile), using CSV for spheres...");
+            dT->writeSpheresAsCsv(ptFile);
+            ptFile.close();
+            break;
+        }
         default:
             DEME_ERROR("Sphere output file format is unknown. Please set it via SetOutputFormat.");
     }
@@ -1972,11 +2170,26 @@ void DEMSolver::WriteClumpFile(const std::string& outfilename, unsigned int accu
             ptFile.close();
             break;
         }
+        case (OUTPUT_FORMAT::QUANTIZED): {
+            // accuracy is not relevant: the native integer positions are lossless
+            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+            dT->writeClumpsAsQuantized(ptFile);
+            ptFile.close();
+            break;
+        }
         default:
             DEME_ERROR("Clump output file format is unknown. Please set it via SetOutputFormat.");
     }
 }
 
+void DEMSolver::WriteContactNetworkSummary(const std::string& outfilename,
+                                           const ContactNetworkOptions& opts,
+                                           float force_thres) const {
+    std::ofstream summaryFile(outfilename, std::ios::out);
+    deme::WriteContactNetworkSummary(summaryFile, GetContactNetworkSummary(opts, force_thres));
+    summaryFile.close();
+}
+
 void DEMSolver::WriteContactFile(const std::string& outfilename, float force_thres) const {
     if (no_recording_contact_forces) {
         DEME_WARNING(
@@ -2014,6 +2227,12 @@ void DEMSolver::WriteMeshFile(const std::string& outfilename) const {
             ptFile.close();
             break;
         }
+        case (MESH_FORMAT::INCREMENTAL): {
+            std::ofstream ptFile(outfilename, std::ios::out | std::ios::binary);
+            dT->writeMeshesIncremental(ptFile);
+            ptFile.close();
+            break;
+        }
         default:
             DEME_ERROR(
                 "Mesh output file format is unknown or not implemented. Please re-set it via SetMeshOutputFormat.");
@@ -2162,6 +2381,21 @@ void DEMSolver::ShowTimingStats() {
     DEME_PRINTF("--------------------------\n");
 }
 
+std::vector<std::pair<std::string, double>> DEMSolver::GetTimingStats(bool kinematic) {
+    std::vector<std::string> timer_names;
+    std::vector<double> timer_vals;
+    if (kinematic) {
+        kT->getTiming(timer_names, timer_vals);
+    } else {
+        dT->getTiming(timer_names, timer_vals);
+    }
+    std::vector<std::pair<std::string, double>> stats;
+    for (unsigned int i = 0; i < timer_names.size(); i++) {
+        stats.emplace_back(timer_names.at(i), timer_vals.at(i));
+    }
+    return stats;
+}
+
 void DEMSolver::ClearTimingStats() {
     kT->resetTimers();
     dT->resetTimers();
@@ -2206,6 +2440,8 @@ void DEMSolver::ReleaseFlattenedArrays() {
     deallocate_array(m_ext_obj_mass);
     deallocate_array(m_ext_obj_moi);
     deallocate_array(m_ext_obj_comp_num);
+    deallocate_array(m_ext_obj_sym_axis);
+    deallocate_array(m_ext_obj_bound_radius);
 
     deallocate_array(m_mesh_obj_mass);
     deallocate_array(m_mesh_obj_moi);
@@ -2261,6 +2497,8 @@ void DEMSolver::UpdateStepSize(double ts) {
     // We for now store ts as float on devices...
     dT->simParams->h = ts;
     kT->simParams->h = ts;
+    // An adaptive step size restarts from here
+    dT->tsController.Reset(ts);
     // dT->simParams.syncMemberToDevice<float>(offsetof(DEMSimParams, h));
     // kT->simParams.syncMemberToDevice<float>(offsetof(DEMSimParams, h));
     dT->simParams.toDevice();
@@ -2471,4 +2709,30 @@ float* DEMSolver::dTInspectNoReduce(const std::shared_ptr<jitify::Program>& insp
     return pRes;
 }
 
+float* DEMSolver::dTInspectGroup(const std::shared_ptr<jitify::Program>& group_kernels,
+                                 unsigned int nQuantities,
+                                 bool inspect_spheres,
+                                 bool inspect_owners) {
+    return dT->inspectGroupCall(group_kernels, nQuantities, inspect_spheres, inspect_owners);
+}
+
+std::vector<DistributionGroupResult> DEMSolver::dTInspectDistribution(
+    const std::shared_ptr<jitify::Program>& dist_kernels,
+    INSPECT_ENTITY_TYPE thing_to_insp,
+    bool need_contact_counts,
+    unsigned int nGroups,
+    const std::vector<float>& bin_edges,
+    const std::vector<float>& quantiles) {
+    return dT->inspectDistributionCall(dist_kernels, thing_to_insp, need_contact_counts, nGroups, bin_edges,
+                                       quantiles);
+}
+
+void DEMSolver::dTCoarseGrainSample(const std::shared_ptr<jitify::Program>& cg_kernels,
+                                    const CGGridParams& grid,
+                                    bool on_device,
+                                    DualArray<double>& sums,
+                                    unsigned int n_threads) {
+    dT->coarseGrainSample(cg_kernels, grid, on_device, sums, n_threads);
+}
+
 }  // namespace deme
@@ -184,6 +184,19 @@ float* DEMInspector::dT_GetValue() {
     return dT->inspectCall(inspection_kernel, kernel_name, thing_to_insp, reduce_flavor, all_domain);
 }
 
+void DEMInspector::assertRegionLegit() {
+    std::string placeholder;
+    if (!any_whole_word_match(in_region_code, {"X", "Y", "Z"}) ||
+        !all_whole_word_match(in_region_code, {"return"}, placeholder)) {
+        std::stringstream ss;
+        ss << "One of your insepctors is set to query a specific region, but the domian is not properly "
+              "defined.\nIt needs to return a bool variable that is a result of logical operations involving X, Y "
+              "and Z.\nYou can remove the region argument if all simulation entities should be considered."
+           << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+}
+
 void DEMInspector::assertInit() {
     if (!initialized) {
         Initialize(sys->GetJitStringSubs(), sys->GetJitifyOptions());
@@ -201,18 +214,10 @@ void DEMInspector::Initialize(const std::unordered_map<std::string, std::string>
         throw std::runtime_error(ss.str());
     }
     // We want to make sure if the in_region_code is legit, if it is not an all_domain query
-    std::string in_region_specifier = in_region_code, placeholder;
+    std::string in_region_specifier = in_region_code;
     // But if the in_region_code is all spaces, it's fine, probably they don't care
     if ((!all_domain) && (!is_all_spaces(in_region_code))) {
-        if (!any_whole_word_match(in_region_code, {"X", "Y", "Z"}) ||
-            !all_whole_word_match(in_region_code, {"return"}, placeholder)) {
-            std::stringstream ss;
-            ss << "One of your insepctors is set to query a specific region, but the domian is not properly "
-                  "defined.\nIt needs to return a bool variable that is a result of logical operations involving X, Y "
-                  "and Z.\nYou can remove the region argument if all simulation entities should be considered."
-               << std::endl;
-            throw std::runtime_error(ss.str());
-        }
+        assertRegionLegit();
         // Replace the return with our own variable
         in_region_specifier = replace_pattern(in_region_specifier, "return", "bool isInRegion = ");
         in_region_specifier += "if (!isInRegion) { not_in_region[" + index_name + "] = 1; return; }\n";
@@ -238,6 +243,377 @@ void DEMInspector::Initialize(const std::unordered_map<std::string, std::string>
     initialized = true;
 }
 
+// =============================================================================
+// DEMInspectorGroup class
+// =============================================================================
+
+unsigned int DEMInspectorGroup::addMember(DEMInspector&& insp) {
+    if (insp.reduce_flavor == CUB_REDUCE_FLAVOR::NONE) {
+        std::stringstream ss;
+        ss << "An inspector group can only hold reduced quantities; use a standalone inspector for the others."
+           << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    if (members.size() >= MAX_INSPECTOR_GROUP_SIZE) {
+        std::stringstream ss;
+        ss << "An inspector group can hold at most " << MAX_INSPECTOR_GROUP_SIZE << " quantities." << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    if (insp.thing_to_insp == INSPECT_ENTITY_TYPE::SPHERE) {
+        has_sphere_members = true;
+    } else {
+        has_owner_members = true;
+    }
+    members.push_back(std::move(insp));
+    // The kernels need to be re-generated
+    initialized = false;
+    cache_valid = false;
+    return members.size() - 1;
+}
+
+unsigned int DEMInspectorGroup::Add(const std::string& quantity) {
+    return addMember(DEMInspector(sys, dT, quantity));
+}
+
+unsigned int DEMInspectorGroup::Add(const std::string& quantity, const std::string& region) {
+    return addMember(DEMInspector(sys, dT, quantity, region));
+}
+
+std::vector<InspectorGroupMember> DEMInspectorGroup::generateMembers() const {
+    std::vector<InspectorGroupMember> gen_members;
+    for (const auto& insp : members) {
+        InspectorGroupMember gen;
+        gen.ofSpheres = (insp.thing_to_insp == INSPECT_ENTITY_TYPE::SPHERE);
+        gen.flavor = insp.reduce_flavor;
+        if (insp.thing_to_insp == INSPECT_ENTITY_TYPE::CLUMP) {
+            gen.ownerTypes = OWNER_T_CLUMP;
+        } else if (insp.thing_to_insp == INSPECT_ENTITY_TYPE::EVERYTHING) {
+            gen.ownerTypes = OWNER_T_CLUMP | OWNER_T_MESH | OWNER_T_ANALYTICAL;
+        }
+        // The inspection code writes the quantity of this entity to an array; redirect it to the local of the group
+        gen.quantityCode = InspectorGroupQuantityCode(insp.inspection_code, insp.index_name);
+        if (!is_all_spaces(insp.in_region_code)) {
+            gen.regionCode = InspectorGroupRegionCode(insp.in_region_code);
+        }
+        gen_members.push_back(std::move(gen));
+    }
+    return gen_members;
+}
+
+void DEMInspectorGroup::Initialize(const std::unordered_map<std::string, std::string>& Subs,
+                                   const std::vector<std::string>& options,
+                                   bool force) {
+    if (!(sys->GetInitStatus()) && !force) {
+        std::stringstream ss;
+        ss << "Inspector group should only be initialized or used after the simulation system is initialized "
+              "(because it uses device-side data)!"
+           << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    if (members.empty()) {
+        std::stringstream ss;
+        ss << "An inspector group is used before any quantity is added to it." << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    for (auto& insp : members) {
+        if (!is_all_spaces(insp.in_region_code))
+            insp.assertRegionLegit();
+    }
+    const std::vector<InspectorGroupMember> gen_members = generateMembers();
+
+    std::unordered_map<std::string, std::string> my_subs = Subs;
+    my_subs["_nGroupQuantities_"] = std::to_string(gen_members.size());
+    my_subs["_groupIdentities_"] = GenerateInspectorGroupIdentities(gen_members);
+    my_subs["_groupCombine_"] = GenerateInspectorGroupCombine(gen_members);
+    my_subs["_sphereGroupQuantities_"] = GenerateInspectorGroupQuantities(gen_members, true);
+    my_subs["_ownerGroupQuantities_"] = GenerateInspectorGroupQuantities(gen_members, false);
+    group_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        "DEMInspectorGroupKernels", JitHelper::KERNEL_DIR / "DEMInspectorGroupKernels.cu", my_subs, options)));
+    initialized = true;
+}
+
+void DEMInspectorGroup::assertInit() {
+    if (!initialized) {
+        Initialize(sys->GetJitStringSubs(), sys->GetJitifyOptions());
+    }
+}
+
+void DEMInspectorGroup::evaluate() {
+    assertInit();
+    float* res = sys->dTInspectGroup(group_kernels, members.size(), has_sphere_members, has_owner_members);
+    cached_values.assign(res, res + members.size());
+    cached_step = dT->nTotalSteps;
+    cached_time = sys->GetSimTime();
+    cache_valid = true;
+}
+
+void DEMInspectorGroup::Update() {
+    evaluate();
+}
+
+std::vector<float> DEMInspectorGroup::GetValues() {
+    // A step advances both, but the step count alone can be reset by the user
+    if (!cache_valid || cached_step != dT->nTotalSteps || cached_time != sys->GetSimTime()) {
+        evaluate();
+    }
+    return cached_values;
+}
+
+float DEMInspectorGroup::GetValue(unsigned int index) {
+    if (index >= members.size()) {
+        std::stringstream ss;
+        ss << "Inspector group quantity index " << index << " is out of range (there are " << members.size()
+           << " quantities)." << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    return GetValues()[index];
+}
+
+// =============================================================================
+// DEMDistributionInspector class
+// =============================================================================
+
+const std::string DIST_CODE_CONTACT_FORCE = R"V0G0N(
+    distValue = length(myForce);
+)V0G0N";
+
+const std::string DIST_CODE_CONTACT_NORMAL_FORCE = R"V0G0N(
+    distValue = fabsf(dot(myForce, myNormal));
+)V0G0N";
+
+const std::string DIST_CODE_CONTACT_OVERLAP = R"V0G0N(
+    distValue = myOverlap;
+)V0G0N";
+
+const std::string DIST_CODE_COORDINATION_NUMBER = R"V0G0N(
+    distValue = (float)ownerContactCounts[myOwner];
+)V0G0N";
+
+// Region and group codes both need to return something of X, Y and Z
+static void assertPositionCodeLegit(const std::string& code, const std::string& what) {
+    std::string placeholder;
+    if (!any_whole_word_match(code, {"X", "Y", "Z"}) || !all_whole_word_match(code, {"return"}, placeholder)) {
+        std::stringstream ss;
+        ss << "The " << what << " code of a distribution inspector is not properly defined.\nIt needs to return a "
+           << "value that is a result of operations involving X, Y and Z." << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+}
+
+void DEMDistributionInspector::switch_quantity_type(const std::string& quantity) {
+    switch (hash_charr(quantity.c_str())) {
+        case ("contact_force"_):
+            quantity_code = DIST_CODE_CONTACT_FORCE;
+            thing_to_insp = INSPECT_ENTITY_TYPE::CONTACT;
+            break;
+        case ("contact_normal_force"_):
+            quantity_code = DIST_CODE_CONTACT_NORMAL_FORCE;
+            thing_to_insp = INSPECT_ENTITY_TYPE::CONTACT;
+            break;
+        case ("contact_overlap"_):
+            quantity_code = DIST_CODE_CONTACT_OVERLAP;
+            thing_to_insp = INSPECT_ENTITY_TYPE::CONTACT;
+            break;
+        case ("coordination_number"_):
+            quantity_code = DIST_CODE_COORDINATION_NUMBER;
+            thing_to_insp = INSPECT_ENTITY_TYPE::CLUMP;
+            need_contact_counts = true;
+            break;
+        default: {
+            // Then it is a quantity of a regular inspector, which is evaluated for each entity instead of reduced
+            DEMInspector insp(sys, dT, quantity);
+            quantity_code = replace_pattern(insp.inspection_code, "quantity[" + insp.index_name + "]", "distValue");
+            thing_to_insp = insp.thing_to_insp;
+        }
+    }
+}
+
+void DEMDistributionInspector::SetHistogram(float lo, float hi, unsigned int n_bins, bool log_bins) {
+    if (n_bins == 0 || !(hi > lo) || (log_bins && !(lo > 0.f))) {
+        std::stringstream ss;
+        ss << "A distribution inspector histogram needs at least one bin and hi > lo (and lo > 0 for log bins); got "
+           << n_bins << " bins from " << lo << " to " << hi << "." << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    bin_edges = DistributionBinEdges(lo, hi, n_bins, log_bins);
+}
+
+void DEMDistributionInspector::SetQuantiles(const std::vector<float>& qs) {
+    for (const auto& q : qs) {
+        if (!(q >= 0.f && q <= 1.f)) {
+            std::stringstream ss;
+            ss << "Quantile " << q << " of a distribution inspector is not in [0, 1]." << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+    }
+    quantiles = qs;
+}
+
+void DEMDistributionInspector::GroupByFamily() {
+    group_by = DIST_GROUP_BY::FAMILY;
+    n_groups = NUM_AVAL_FAMILIES;
+    group_code = " ";
+    initialized = false;
+}
+
+void DEMDistributionInspector::GroupByRegion(const std::string& code, unsigned int n) {
+    if (n == 0) {
+        std::stringstream ss;
+        ss << "A distribution inspector grouped by region needs at least one group." << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    group_by = DIST_GROUP_BY::REGION;
+    n_groups = n;
+    group_code = code;
+    initialized = false;
+}
+
+void DEMDistributionInspector::assertInit() {
+    if (!initialized) {
+        Initialize(sys->GetJitStringSubs(), sys->GetJitifyOptions());
+    }
+}
+
+void DEMDistributionInspector::Initialize(const std::unordered_map<std::string, std::string>& Subs,
+                                          const std::vector<std::string>& options,
+                                          bool force) {
+    if (!(sys->GetInitStatus()) && !force) {
+        std::stringstream ss;
+        ss << "Distribution inspector should only be initialized or used after the simulation system is initialized "
+              "(because it uses device-side data)!"
+           << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    std::string region_specifier = " ";
+    if (!is_all_spaces(in_region_code)) {
+        assertPositionCodeLegit(in_region_code, "region");
+        region_specifier = replace_pattern(in_region_code, "return", "isInRegion = ");
+    }
+    std::string group_specifier;
+    switch (group_by) {
+        case (DIST_GROUP_BY::FAMILY):
+            group_specifier = "distGroup = granData->familyID[myOwner];";
+            break;
+        case (DIST_GROUP_BY::REGION):
+            assertPositionCodeLegit(group_code, "group");
+            group_specifier = replace_pattern(group_code, "return", "distGroup = ");
+            break;
+        default:
+            group_specifier = "distGroup = 0;";
+    }
+
+    std::unordered_map<std::string, std::string> my_subs = Subs;
+    my_subs["_distributionRegion_"] = region_specifier;
+    my_subs["_distributionQuantity_"] = quantity_code;
+    my_subs["_distributionGroup_"] = group_specifier;
+    dist_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        "DEMDistributionKernels", JitHelper::KERNEL_DIR / "DEMDistributionKernels.cu", my_subs, options)));
+    initialized = true;
+}
+
+std::vector<DistributionGroupResult> DEMDistributionInspector::GetDistributions() {
+    assertInit();
+    return sys->dTInspectDistribution(dist_kernels, thing_to_insp, need_contact_counts, n_groups, bin_edges,
+                                      quantiles);
+}
+
+DistributionGroupResult DEMDistributionInspector::GetDistribution(unsigned int group) {
+    if (group >= n_groups) {
+        std::stringstream ss;
+        ss << "Distribution inspector group " << group << " is out of range (there are " << n_groups << " groups)."
+           << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    return GetDistributions()[group];
+}
+
+// =============================================================================
+// DEMCoarseGrainer class
+// =============================================================================
+
+void DEMCoarseGrainer::assertInit() {
+    if (!initialized) {
+        Initialize(sys->GetJitStringSubs(), sys->GetJitifyOptions());
+    }
+}
+
+void DEMCoarseGrainer::Initialize(const std::unordered_map<std::string, std::string>& Subs,
+                                  const std::vector<std::string>& options,
+                                  bool force) {
+    if (!(sys->GetInitStatus()) && !force) {
+        std::stringstream ss;
+        ss << "Coarse-grainer should only be initialized or used after the simulation system is initialized (because "
+              "it uses device-side data)!"
+           << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    cg_kernels = std::make_shared<jitify::Program>(std::move(JitHelper::buildProgram(
+        "DEMCoarseGrainingKernels", JitHelper::KERNEL_DIR / "DEMCoarseGrainingKernels.cu", Subs, options)));
+    initialized = true;
+    ResetWindow();
+}
+
+void DEMCoarseGrainer::SetBackend(CG_BACKEND b) {
+    if (b != backend && n_samples > 0) {
+        std::stringstream ss;
+        ss << "The backend of a coarse-grainer can only change when its window is empty (call ResetWindow first)."
+           << std::endl;
+        throw std::runtime_error(ss.str());
+    }
+    backend = b;
+}
+
+void DEMCoarseGrainer::ResetWindow() {
+    window_sums.resize(cgNumNodes(grid) * DEME_CG_NUM_RAW_FIELDS);
+    std::fill(window_sums.host(), window_sums.host() + window_sums.size(), 0.);
+    window_sums.toDevice();
+    n_samples = 0;
+}
+
+void DEMCoarseGrainer::Sample() {
+    assertInit();
+    const double t = sys->GetSimTime();
+    if (n_samples == 0) {
+        window_start = t;
+    }
+    window_end = t;
+    sys->dTCoarseGrainSample(cg_kernels, grid, backend == CG_BACKEND::DEVICE, window_sums, n_threads);
+    n_samples++;
+}
+
+std::vector<float> DEMCoarseGrainer::GetFields() {
+    assertInit();
+    // The host sums are current for the host backend; the device ones need to be brought over
+    if (backend == CG_BACKEND::DEVICE) {
+        window_sums.toHost();
+    }
+    return CoarseGrainOutputFields(grid, window_sums.host(), n_samples);
+}
+
+std::vector<float> DEMCoarseGrainer::GetField(const std::string& name) {
+    for (unsigned int f = 0; f < CG_NUM_OUTPUT_FIELDS; f++) {
+        if (name == CG_OUTPUT_FIELD_NAMES[f]) {
+            const std::vector<float> fields = GetFields();
+            const size_t nNodes = cgNumNodes(grid);
+            return std::vector<float>(fields.begin() + f * nNodes, fields.begin() + (f + 1) * nNodes);
+        }
+    }
+    std::stringstream ss;
+    ss << "Coarse-grained field " << name << " is not known." << std::endl;
+    throw std::runtime_error(ss.str());
+}
+
+void DEMCoarseGrainer::WriteGrid(const std::string& filename) {
+    CoarseGrainFrame frame;
+    frame.grid = grid;
+    frame.nSamples = n_samples;
+    frame.timeStart = window_start;
+    frame.timeEnd = window_end;
+    frame.fieldNames.assign(CG_OUTPUT_FIELD_NAMES, CG_OUTPUT_FIELD_NAMES + CG_NUM_OUTPUT_FIELDS);
+    frame.fields = GetFields();
+    WriteCoarseGrainFile(filename, frame);
+}
+
 // =============================================================================
 // DEMTracker class
 // =============================================================================
@@ -808,6 +1184,41 @@ void DEMForceModel::SetPerContactWildcards(const std::set<std::string>& wildcard
     m_contact_wildcards = wildcards;
 }
 
+void DEMForceModel::SetContactWildcardPool(const std::set<std::string>& wildcards,
+                                           const std::set<contact_t>& contact_types,
+                                           const std::vector<std::pair<unsigned int, unsigned int>>& family_pairs,
+                                           CNT_WILDCARD_PRECISION precision,
+                                           float quant_scale) {
+    if (wildcards.empty() || contact_types.empty()) {
+        throw std::runtime_error("A contact wildcard pool needs at least one wildcard and one contact type.");
+    }
+    if (precision == CNT_WILDCARD_PRECISION::QUANT16 && !(quant_scale > 0.)) {
+        throw std::runtime_error("The scale of a quantized contact wildcard pool must be positive.");
+    }
+    ContactWildcardPool pool;
+    pool.names = wildcards;
+    for (const auto& type : contact_types) {
+        if (type == NOT_A_CONTACT || type >= 32) {
+            std::stringstream ss;
+            ss << "Contact type " << +type << " cannot be in the scope of a contact wildcard pool." << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+        pool.typeMask |= (1u << type);
+    }
+    for (const auto& pair : family_pairs) {
+        if (pair.first >= NUM_AVAL_FAMILIES || pair.second >= NUM_AVAL_FAMILIES) {
+            std::stringstream ss;
+            ss << "Family pair (" << pair.first << ", " << pair.second << ") of a contact wildcard pool is not valid."
+               << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+    }
+    pool.familyPairs = family_pairs;
+    pool.precision = precision;
+    pool.quantScale = quant_scale;
+    m_wildcard_pools.push_back(pool);
+}
+
 void DEMForceModel::SetPerOwnerWildcards(const std::set<std::string>& wildcards) {
     for (const auto& a_str : wildcards) {
         if (match_pattern(a_str, " ")) {
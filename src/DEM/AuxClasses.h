@@ -9,6 +9,11 @@
 #include <unordered_map>
 #include <core/utils/JitHelper.h>
 #include <DEM/Defines.h>
+#include <DEM/utils/WildcardPools.hpp>
+#include <DEM/utils/InspectorGroups.hpp>
+#include <DEM/utils/DistributionInspectors.hpp>
+#include <DEM/utils/CoarseGraining.hpp>
+#include <core/utils/DataMigrationHelper.hpp>
 
 // Forward declare jitify::Program to avoid downstream dependency
 namespace jitify {
@@ -44,12 +49,16 @@ class DEMInspector {
 
     // Based on user input...
     void switch_quantity_type(const std::string& quantity);
+    // Check that the region code returns a bool of X, Y and Z
+    void assertRegionLegit();
 
     void assertInit();
 
   public:
     friend class DEMSolver;
     friend class DEMDynamicThread;
+    friend class DEMInspectorGroup;
+    friend class DEMDistributionInspector;
 
     DEMInspector(DEMSolver* sim_sys, DEMDynamicThread* dT_sys, const std::string& quantity) : sys(sim_sys), dT(dT_sys) {
         switch_quantity_type(quantity);
@@ -85,6 +94,195 @@ class DEMInspector {
     float* dT_GetValue();
 };
 
+/// A group of inspected quantities (each as in DEMInspector, in a given region or not) that are evaluated together: one
+/// kernel pass per entity type (spheres, owners) and one reduction for all of them. The results are cached, so querying
+/// them again in the same time step costs nothing.
+class DEMInspectorGroup {
+  private:
+    std::shared_ptr<jitify::Program> group_kernels;
+    std::vector<DEMInspector> members;
+    bool has_sphere_members = false;
+    bool has_owner_members = false;
+    bool initialized = false;
+
+    // Cached results and the time step they are from
+    std::vector<float> cached_values;
+    bool cache_valid = false;
+    uint64_t cached_step = 0;
+    double cached_time = 0.;
+
+    // Its parent DEMSolver and dT system
+    DEMSolver* sys;
+    DEMDynamicThread* dT;
+
+    unsigned int addMember(DEMInspector&& insp);
+    // The members as code to fuse
+    std::vector<InspectorGroupMember> generateMembers() const;
+    void assertInit();
+    void evaluate();
+
+  public:
+    friend class DEMSolver;
+
+    DEMInspectorGroup(DEMSolver* sim_sys, DEMDynamicThread* dT_sys) : sys(sim_sys), dT(dT_sys) {}
+    ~DEMInspectorGroup() {}
+
+    /// Add a quantity (the same as those of CreateInspector, except the non-reduced ones such as absv) to the group.
+    /// Returns its index in the group.
+    unsigned int Add(const std::string& quantity);
+    /// Add a quantity that is inspected in a region (the same as that of CreateInspector) to the group. Returns its
+    /// index in the group.
+    unsigned int Add(const std::string& quantity, const std::string& region);
+
+    /// Get the number of quantities in this group
+    unsigned int GetNumQuantities() const { return members.size(); }
+
+    /// Get the reduced value of the quantity of this index. All quantities are evaluated at once, at the first query in
+    /// a time step.
+    float GetValue(unsigned int index);
+    /// Get the reduced values of all quantities, in the order they were added
+    std::vector<float> GetValues();
+    /// Evaluate all quantities now, even if they have been evaluated in this time step (for example, after the user
+    /// changed the simulation state without advancing it)
+    void Update();
+
+    // Initialize with the DEM simulation system (user should not call this)
+    void Initialize(const std::unordered_map<std::string, std::string>& Subs,
+                    const std::vector<std::string>& options,
+                    bool force = false);
+};
+
+/// An inspector of the distribution of a quantity of spheres, owners or contacts (in a given region or not): its
+/// histogram, quantiles, count, sum and extremes, optionally per group of entities (by family, or by a region code that
+/// gives a group number). It is evaluated on the device, and only these compact results are copied to the host.
+class DEMDistributionInspector {
+  private:
+    std::shared_ptr<jitify::Program> dist_kernels;
+
+    // Code that computes the quantity of an entity into a float named distValue
+    std::string quantity_code;
+    std::string in_region_code = " ";
+    std::string group_code = " ";
+    INSPECT_ENTITY_TYPE thing_to_insp;
+    // If the quantity needs the number of contacts of each owner
+    bool need_contact_counts = false;
+
+    DIST_GROUP_BY group_by = DIST_GROUP_BY::NONE;
+    unsigned int n_groups = 1;
+    std::vector<float> bin_edges;
+    std::vector<float> quantiles;
+
+    bool initialized = false;
+
+    // Its parent DEMSolver and dT system
+    DEMSolver* sys;
+    DEMDynamicThread* dT;
+
+    void switch_quantity_type(const std::string& quantity);
+    void assertInit();
+
+  public:
+    friend class DEMSolver;
+
+    DEMDistributionInspector(DEMSolver* sim_sys, DEMDynamicThread* dT_sys, const std::string& quantity)
+        : sys(sim_sys), dT(dT_sys) {
+        switch_quantity_type(quantity);
+    }
+    DEMDistributionInspector(DEMSolver* sim_sys,
+                             DEMDynamicThread* dT_sys,
+                             const std::string& quantity,
+                             const std::string& region)
+        : sys(sim_sys), dT(dT_sys) {
+        switch_quantity_type(quantity);
+        in_region_code = region;
+    }
+    ~DEMDistributionInspector() {}
+
+    /// Make a histogram of n_bins bins from lo to hi, evenly spaced or (if log_bins, and lo > 0) in log scale. Values
+    /// below lo or at least hi are counted as under- or overflow.
+    void SetHistogram(float lo, float hi, unsigned int n_bins, bool log_bins = false);
+    /// Get the n_bins + 1 edges of the histogram bins
+    const std::vector<float>& GetBinEdges() const { return bin_edges; }
+    /// Set the quantiles (each in [0, 1]) to evaluate; they are the exact nearest-rank order statistics
+    void SetQuantiles(const std::vector<float>& qs);
+    /// Evaluate the distribution per family: the results have NUM_AVAL_FAMILIES groups, one for each family number
+    void GroupByFamily();
+    /// Evaluate the distribution per group, given by code that returns the group number (0 to n_groups - 1) from X, Y
+    /// and Z. Entities of a larger group number are not counted.
+    void GroupByRegion(const std::string& group_code, unsigned int n_groups);
+
+    /// Get the distributions of all groups (one group, if not grouped)
+    std::vector<DistributionGroupResult> GetDistributions();
+    /// Get the distribution of one group
+    DistributionGroupResult GetDistribution(unsigned int group = 0);
+
+    // Initialize with the DEM simulation system (user should not call this)
+    void Initialize(const std::unordered_map<std::string, std::string>& Subs,
+                    const std::vector<std::string>& options,
+                    bool force = false);
+};
+
+/// A coarse-grainer that deposits the clumps and contacts onto a grid at each Sample, and averages them over a time
+/// window into continuum fields (solid fraction, density, velocity, granular temperature, kinetic and contact stress).
+/// The deposit runs on the device, or on the host (then only the compact particle and contact records are copied
+/// over); both give the same sums, regardless of thread count.
+class DEMCoarseGrainer {
+  private:
+    std::shared_ptr<jitify::Program> cg_kernels;
+
+    CGGridParams grid;
+    CG_BACKEND backend = CG_BACKEND::DEVICE;
+    unsigned int n_threads = 0;
+
+    // The raw field sums of the samples in the window (DEME_CG_NUM_RAW_FIELDS per node)
+    DualArray<double> window_sums;
+    unsigned int n_samples = 0;
+    double window_start = 0.;
+    double window_end = 0.;
+
+    bool initialized = false;
+
+    // Its parent DEMSolver and dT system
+    DEMSolver* sys;
+    DEMDynamicThread* dT;
+
+    void assertInit();
+
+  public:
+    friend class DEMSolver;
+
+    DEMCoarseGrainer(DEMSolver* sim_sys, DEMDynamicThread* dT_sys, const CGGridParams& g)
+        : grid(g), sys(sim_sys), dT(dT_sys) {}
+    ~DEMCoarseGrainer() {}
+
+    /// Set where the deposit runs. It can only change when the window is empty (at the start, or after ResetWindow).
+    void SetBackend(CG_BACKEND b);
+    /// Set the number of threads of the host backend (0 means all hardware threads)
+    void SetNumThreads(unsigned int n) { n_threads = n; }
+
+    /// Deposit the current state of the simulation, as one more sample of the window
+    void Sample();
+    /// Get the number of samples in the window
+    unsigned int GetNumSamples() const { return n_samples; }
+    /// Empty the window
+    void ResetWindow();
+
+    /// Get the window averages of all fields (CG_OUTPUT_FIELD_NAMES), each over all nodes (x fastest), one after
+    /// another
+    std::vector<float> GetFields();
+    /// Get the window average of one field over all nodes (x fastest)
+    std::vector<float> GetField(const std::string& name);
+    /// Write the window averages to a file (see WriteCoarseGrainFrame for the layout)
+    void WriteGrid(const std::string& filename);
+    /// Get the grid
+    const CGGridParams& GetGrid() const { return grid; }
+
+    // Initialize with the DEM simulation system (user should not call this)
+    void Initialize(const std::unordered_map<std::string, std::string>& Subs,
+                    const std::vector<std::string>& options,
+                    bool force = false);
+};
+
 // A struct to get or set tracked owner entities, mainly for co-simulation
 class DEMTracker {
   private:
@@ -438,6 +636,8 @@ class DEMForceModel {
     // Quatity names that we want to associate each owner with. An array will be allocated for storing this, and it
     // lives and die with its associated geometry representation (most typically a sphere).
     std::set<std::string> m_geo_wildcards;
+    // Contact wildcards that are stored in packed pools, rather than in arrays over all contact pairs
+    std::vector<ContactWildcardPool> m_wildcard_pools;
 
   public:
     friend class DEMSolver;
@@ -472,6 +672,20 @@ class DEMForceModel {
     /// initial value of all contact wildcard arrays is automatically 0.
     //// TODO: Maybe allow non-0 initialization?
     void SetPerContactWildcards(const std::set<std::string>& wildcards);
+    /// @brief Store some contact wildcards (named in SetPerContactWildcards) in a packed pool, so that only the
+    /// contacts that need them use memory for them. Only contacts of the given types, and between the given family
+    /// pairs if any are given, keep these wildcards; for other contacts they read as 0 in the force model, and setting
+    /// them has no effect. Good for history that only some contacts have, such as bonds between two families.
+    /// @param wildcards Names of the contact wildcards in this pool. A wildcard can be in one pool only.
+    /// @param contact_types The contact types that keep these wildcards, such as SPHERE_MESH_CONTACT.
+    /// @param family_pairs The family pairs whose contacts keep these wildcards. If empty, all do.
+    /// @param precision Store them as floats, as half-precision floats, or as 16-bit integers (times quant_scale).
+    /// @param quant_scale The value of one unit of the 16-bit integers, if precision is QUANT16.
+    void SetContactWildcardPool(const std::set<std::string>& wildcards,
+                                const std::set<contact_t>& contact_types,
+                                const std::vector<std::pair<unsigned int, unsigned int>>& family_pairs = {},
+                                CNT_WILDCARD_PRECISION precision = CNT_WILDCARD_PRECISION::FLOAT32,
+                                float quant_scale = 1.f);
     /// Set the names for the extra quantities that will be associated with each owner. For example, you can use this to
     /// associate a cohesion parameter to each particle. Only float is supported.
     void SetPerOwnerWildcards(const std::set<std::string>& wildcards);
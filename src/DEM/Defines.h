@@ -34,6 +34,8 @@ namespace deme {
 // In bin--triangle intersection scan, all bins are enlarged by a factor of this following constant, so that no triangle
 // lies in between bins and not picked up by any bins.
 #define DEME_BIN_ENLARGE_RATIO_FOR_FACETS 0.001
+// In hierarchical-grid CD, the top this many bits of a cell key store the grid level
+#define DEME_HIER_GRID_LEVEL_BITS 6
 
 // A few pre-computed constants
 constexpr double TWO_OVER_THREE = 2. / 3.;
@@ -80,9 +82,16 @@ const contact_t SPHERE_PLANE_CONTACT = 11;
 const contact_t SPHERE_PLATE_CONTACT = 12;
 const contact_t SPHERE_CYL_CONTACT = 13;
 const contact_t SPHERE_CONE_CONTACT = 14;
+// A mask with a bit for each contact type, for force kernels that handle all types
+const unsigned int ALL_CONTACT_TYPES_MASK = 0xFFFFFFFFu;
 
 const notStupidBool_t DONT_PREVENT_CONTACT = 0;
 const notStupidBool_t PREVENT_CONTACT = 1;
+// In multi-rate integration, the class of a contact (slow ones are resolved once per step, fast ones at each sub-step),
+// and which class a force pass covers (MULTI_RATE_ALL if multi-rate integration is not in progress)
+const notStupidBool_t MULTI_RATE_ALL = 0;
+const notStupidBool_t MULTI_RATE_SLOW = 1;
+const notStupidBool_t MULTI_RATE_FAST = 2;
 
 // Codes for owner types. We just have a handful of types...
 const ownerType_t OWNER_T_CLUMP = 1;
@@ -101,6 +110,12 @@ constexpr contactPairs_t NULL_MAPPING_PARTNER = ((size_t)1 << (sizeof(contactPai
 // Reserved bodyID
 constexpr bodyID_t NULL_BODYID = ((size_t)1 << (sizeof(bodyID_t) * DEME_BITS_PER_BYTE - 1)) +
                                  (((size_t)1 << (sizeof(bodyID_t) * DEME_BITS_PER_BYTE - 1)) - 1);
+// Island of the static owners (fixed families) while island sleeping is on; awake owners have island NULL_BODYID
+constexpr bodyID_t STATIC_SLEEP_ISLAND = NULL_BODYID - 1;
+// Sleeping roles of families on the device (the values of SLEEP_ROLE)
+constexpr notStupidBool_t SLEEP_ROLE_REGULAR = 0;
+constexpr notStupidBool_t SLEEP_ROLE_STATIC = 1;
+constexpr notStupidBool_t SLEEP_ROLE_ACTIVE = 2;
 // Reserved binID
 constexpr binID_t NULL_BINID = ((size_t)1 << (sizeof(binID_t) * DEME_BITS_PER_BYTE - 1)) +
                                (((size_t)1 << (sizeof(binID_t) * DEME_BITS_PER_BYTE - 1)) - 1);
@@ -166,6 +181,8 @@ enum OUTPUT_CONTENT {
     // the user imposed some fine-grain clump size control.
     EXP_FACTOR = 2048
 };
+// Storage of the fields of a packed contact wildcard pool: float, half-precision float, or 16-bit integer of a scale
+enum class CNT_WILDCARD_PRECISION { FLOAT32, HALF, QUANT16 };
 // Output particles as individual (component) spheres, or as owner clumps (clump CoMs for location, as an example)?
 enum class SPATIAL_DIR { X, Y, Z, NONE };
 // The info that should be present in the contact pair output files
@@ -181,6 +198,16 @@ enum CNT_OUTPUT_CONTENT {
     GEO_ID = 128,
     NICKNAME = 256
 };
+// The owner state columns that can be exported to user buffers (ExportOwnerState), in the order they are laid out
+enum STATE_EXPORT_CONTENT {
+    EXPORT_POS = 1,       // 3 components
+    EXPORT_QUAT = 2,      // 4 components, xyzw
+    EXPORT_VEL = 4,       // 3 components
+    EXPORT_ANG_VEL = 8,   // 3 components, local frame
+    EXPORT_ACC = 16,      // 3 components
+    EXPORT_ANG_ACC = 32,  // 3 components, local frame
+    EXPORT_FAMILY = 64    // 1 component
+};
 
 // =============================================================================
 // NOW DEFINING SOME GPU-SIDE DATA STRUCTURES
@@ -250,6 +277,10 @@ struct DEMSimParams {
     float expSafetyAdder;
     // Stepping method
     TIME_INTEGRATOR stepping = TIME_INTEGRATOR::FORWARD_EULER;
+    // The contact class the current force pass is for, in multi-rate integration
+    notStupidBool_t multiRatePass = MULTI_RATE_ALL;
+    // Whether sleeping islands are taken out of force calculation and integration
+    bool useSleeping = false;
 
     // Number of wildcards (extra property) arrays associated with contacts and owners and geometries
     unsigned int nContactWildcards;
@@ -262,6 +293,27 @@ struct DEMSimParams {
     unsigned int errOutBinSphNum = 32768;
     // The max num of triangles per bin before solver errors out
     unsigned int errOutBinTriNum = 32768;
+    // Number of rigid meshes whose facets are found through their local-frame grids, not binned in world frame
+    unsigned int nMeshGrids = 0;
+    // Number of facets in those grids
+    bodyID_t nTriInMeshGrids = 0;
+};
+
+// Body-frame uniform grid of a rigid mesh, built once. Its cells list the facets whose (local) bounding boxes touch
+// them, in CSR form, and the cells of all grids are stored back to back.
+struct MeshGridInfo {
+    // Grid lower corner, cell size and cell numbers, in the owner's local frame
+    float3 origin;
+    float cellSize;
+    int3 dims;
+    // Offset of this grid's first cell in the cell start array
+    size_t cellOffset;
+    // A facet's CD sandwich is within (margin * miterFactor) of the facet, so queries are padded by this much
+    float miterFactor;
+    // Bounding sphere of all facets (local frame), for quickly ruling out far-away spheres
+    float3 boundCenter;
+    float boundRadius;
+    bodyID_t owner;
 };
 
 // A struct that holds pointers to data arrays that dT uses
@@ -312,12 +364,26 @@ struct DEMDataDT {
     notStupidBool_t* familyMasks;
     // Extra margin size
     float* familyExtraMarginSize;
+    // Whether a family is sub-stepped in multi-rate integration, and the resulting class of each contact
+    notStupidBool_t* familySubStepped;
+    notStupidBool_t* contactRateClass;
+    // Island sleeping: the sleeping island of each owner (NULL_BODYID if awake), its family when it fell asleep, and
+    // the mark of each sleeping island (named by its smallest owner ID) being woken
+    bodyID_t* ownerSleepIsland;
+    family_t* ownerSleepFamily;
+    notStupidBool_t* sleepIslandWoken;
+    // The number of steps each owner has been quiet for, its bounding radius, and the sleeping role of each family
+    unsigned int* ownerQuietSteps;
+    float* ownerSleepRadius;
+    notStupidBool_t* familySleepRole;
 
     // Some dT's own work array pointers
     float3* contactForces;
     float3* contactTorque_convToForce;
     float3* contactPointGeometryA;
     float3* contactPointGeometryB;
+    // The contact states of the last force calculation, a row of HOST_CONTACT_DUMP_WIDTH per contact (only if dumped)
+    float* contactStateDump;
     // float3* contactHistory;
     // float* contactDuration;
 
@@ -337,6 +403,7 @@ struct DEMDataDT {
     unsigned int* pKTOwnedBuffer_maxDrift = nullptr;
     float* pKTOwnedBuffer_absVel = nullptr;
     float* pKTOwnedBuffer_ts = nullptr;
+    float* pKTOwnedBuffer_skin = nullptr;
     voxelID_t* pKTOwnedBuffer_voxelID = nullptr;
     subVoxelPos_t* pKTOwnedBuffer_locX = nullptr;
     subVoxelPos_t* pKTOwnedBuffer_locY = nullptr;
@@ -370,6 +437,9 @@ struct DEMDataDT {
     float* sphereWildcards[DEME_MAX_WILDCARD_NUM] = {nullptr};
     float* analWildcards[DEME_MAX_WILDCARD_NUM] = {nullptr};
     float* triWildcards[DEME_MAX_WILDCARD_NUM] = {nullptr};
+    // Packed contact wildcard pools: the record of each contact (NULL_MAPPING_PARTNER if none), and the packed records
+    contactPairs_t* wildcardPoolIndex[DEME_MAX_WILDCARD_NUM] = {nullptr};
+    uint8_t* wildcardPoolData[DEME_MAX_WILDCARD_NUM] = {nullptr};
 };
 
 // A struct that holds pointers to data arrays that kT uses
@@ -402,6 +472,14 @@ struct DEMDataKT {
     float3* relPosNode2;
     float3* relPosNode3;
 
+    // Local-frame grids of rigid meshes (see MeshGridInfo). triInMeshGrid marks the facets that these grids take care
+    // of, and triGridCellLo is the lowest cell each of them touches.
+    MeshGridInfo* meshGridInfo;
+    size_t* meshGridCellStart;
+    bodyID_t* meshGridCellTris;
+    int3* triGridCellLo;
+    notStupidBool_t* triInMeshGrid;
+
     // kT produces contact info, and stores it, temporarily
     bodyID_t* idGeometryA;
     bodyID_t* idGeometryB;
@@ -443,6 +521,20 @@ const unsigned int NUM_STEPS_RESERVED_AFTER_CHANGING_BIN_SIZE = 5;
 const unsigned int FUTURE_DRIFT_TWEAK_STEP_SIZE = 1;
 // After purging update freq history, this many dT steps are not included in the performance gauging.
 const unsigned int NUM_STEPS_RESERVED_AFTER_RENEWING_FREQ_TUNER = 10;
+// In displacement-triggered CD, dT orders a new CD when the displacement since the last one reaches this fraction
+// of the skin, so kT has the rest of the skin as the time to deliver it
+const float CD_SKIN_ORDER_RATIO = 0.5;
+// In displacement-triggered CD, the skin is re-chosen after this many CD cycles are observed
+const unsigned int NUM_CD_CYCLES_PER_SKIN_TUNE = 10;
+// In displacement-triggered CD, the skin can at most grow or shrink by this factor in one tune
+const float CD_SKIN_MAX_TUNE_RATIO = 2.0;
+// In displacement-triggered CD, analytical components whose axes (or normals) are within this sine of each other
+// share a symmetry axis, and an infinite cylinder whose center is within it of its axis has that axis through the CoM
+const float ANAL_SYM_AXIS_TOLERANCE = 1e-6;
+// Max number of contact force probes (membership is a bit mask per owner/family)
+const unsigned int MAX_NUM_FORCE_PROBES = 32;
+// Number of floats reduced per probe: force (3), moment (3), |F|-weighted contact point (3), sum of |F| (1)
+const unsigned int FORCE_PROBE_NUM_AGGREGATES = 10;
 // Default target simulation `world' size.
 const float DEFAULT_BOX_DOMAIN_SIZE = 20.;
 // The enlargement ratio we apply to the target sim world size when we construct it.
@@ -58,6 +58,57 @@ inline auto run_in_thread(Func&& func, Args&&... args) -> decltype(func(args...)
     return fut.get();
 }
 
+// Split [0, n) into contiguous chunks and run func(chunk_num, start, end) on each chunk in its own thread. Small
+// problems are run in the calling thread. Returns the number of chunks used.
+template <typename Func>
+inline unsigned int hostParallelFor(size_t n,
+                                    const Func& func,
+                                    unsigned int n_threads = 0,
+                                    size_t min_per_thread = 4096) {
+    if (n_threads == 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    n_threads = (unsigned int)std::max<size_t>(1, std::min<size_t>(n_threads, n / std::max<size_t>(min_per_thread, 1)));
+    if (n_threads == 1) {
+        func(0u, (size_t)0, n);
+        return 1;
+    }
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < n_threads; t++) {
+        threads.emplace_back([&func, t, n, n_threads]() { func(t, n * t / n_threads, n * (t + 1) / n_threads); });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    return n_threads;
+}
+
+// Host version of getting the owners of contacts [start, end). Geometry A is always a sphere, so only geometry B needs
+// the contact type to tell whether it is a sphere, a mesh facet or an analytical component.
+inline void contactOwnersOnHost(bodyID_t* idA,
+                                bodyID_t* idB,
+                                const contact_t* types,
+                                const bodyID_t* geoA,
+                                const bodyID_t* geoB,
+                                const bodyID_t* ownerClumpBody,
+                                const bodyID_t* ownerMesh,
+                                const bodyID_t* ownerAnalBody,
+                                size_t start,
+                                size_t end) {
+    for (size_t i = start; i < end; i++) {
+        const contact_t type = types[i];
+        if (type == NOT_A_CONTACT) {
+            idA[i] = NULL_BODYID;
+            idB[i] = NULL_BODYID;
+            continue;
+        }
+        idA[i] = ownerClumpBody[geoA[i]];
+        idB[i] = (type == SPHERE_SPHERE_CONTACT) ? ownerClumpBody[geoB[i]]
+                 : (type == SPHERE_MESH_CONTACT) ? ownerMesh[geoB[i]]
+                                                 : ownerAnalBody[geoB[i]];
+    }
+}
+
 inline int randomZeroOrOne() {
     std::random_device rd;   // Random number device to seed the generator
     std::mt19937 gen(rd());  // Mersenne Twister generator
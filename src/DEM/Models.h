@@ -14,6 +14,7 @@
 #include <DEM/Defines.h>
 #include <DEM/Structs.h>
 #include <DEM/HostSideHelpers.hpp>
+#include <DEM/utils/HostForceModel.hpp>
 #include <core/utils/RuntimeData.h>
 #include <core/utils/DEMEPaths.h>
 
@@ -377,6 +378,83 @@ inline void equip_contact_wildcards(std::string& acquisition,
     }
 }
 
+// Dump the state of a contact into granData->contactStateDump, a row of HOST_CONTACT_DUMP_WIDTH per contact pair laid
+// out as the columns of a HostContactBatch: what the force model is given goes in before it runs, and what it produces
+// after. Ingredients the model does not use are not defined in the kernel, so their columns are left at 0.
+inline void equip_contact_state_dump(std::string& dump_in,
+                                     std::string& dump_out,
+                                     std::unordered_map<std::string, bool>& added_ingredients,
+                                     const std::set<std::string>& contact_wildcard_names) {
+    auto put = [](std::string& code, unsigned int col, const std::string& val) {
+        code += "dumpRow[" + std::to_string(col) + "] = " + val + ";\n";
+    };
+    auto put3 = [&](std::string& code, unsigned int col, const std::string& vec) {
+        put(code, col, vec + ".x");
+        put(code, col + 1, vec + ".y");
+        put(code, col + 2, vec + ".z");
+    };
+    dump_in += "float* dumpRow = granData->contactStateDump + (size_t)myContactID * " +
+               std::to_string(HOST_CONTACT_DUMP_WIDTH) + ";\n";
+    put(dump_in, HC_NUM_COLS, "1.f");
+    put(dump_in, HC_OVERLAP, "overlapDepth");
+    put3(dump_in, HC_B2A_X, "B2A");
+    put3(dump_in, HC_CPA_X, "locCPA");
+    put3(dump_in, HC_CPB_X, "locCPB");
+    put(dump_in, HC_A_MASS, "AOwnerMass");
+    put(dump_in, HC_B_MASS, "BOwnerMass");
+    put(dump_in, HC_A_RADIUS, "ARadius");
+    put(dump_in, HC_B_RADIUS, "BRadius");
+    put(dump_in, HC_A_MAT, "(float)bodyAMatType");
+    put(dump_in, HC_B_MAT, "(float)bodyBMatType");
+    put(dump_in, HC_A_QW, "AOriQ.w");
+    put3(dump_in, HC_A_QX, "AOriQ");
+    put(dump_in, HC_B_QW, "BOriQ.w");
+    put3(dump_in, HC_B_QX, "BOriQ");
+    if (added_ingredients["AOwnerFamily"]) {
+        put(dump_in, HC_A_FAMILY, "(float)AOwnerFamily");
+    }
+    if (added_ingredients["BOwnerFamily"]) {
+        put(dump_in, HC_B_FAMILY, "(float)BOwnerFamily");
+    }
+    if (added_ingredients["ALinVel"] || added_ingredients["BLinVel"]) {
+        put3(dump_in, HC_A_VEL_X, "ALinVel");
+        put3(dump_in, HC_B_VEL_X, "BLinVel");
+    }
+    if (added_ingredients["ARotVel"] || added_ingredients["BRotVel"]) {
+        put3(dump_in, HC_A_ROTVEL_X, "ARotVel");
+        put3(dump_in, HC_B_ROTVEL_X, "BRotVel");
+    }
+    if (added_ingredients["AOwnerMOI"] || added_ingredients["BOwnerMOI"]) {
+        put3(dump_in, HC_A_MOI_X, "AOwnerMOI");
+        put3(dump_in, HC_B_MOI_X, "BOwnerMOI");
+    }
+    // The contact wildcards a batch has columns for, before and after the step
+    const std::pair<const char*, unsigned int> history[] = {{"delta_time", HC_DELTA_TIME},
+                                                            {"delta_tan_x", HC_DELTA_TAN_X},
+                                                            {"delta_tan_y", HC_DELTA_TAN_Y},
+                                                            {"delta_tan_z", HC_DELTA_TAN_Z}};
+    for (const auto& wc : history) {
+        if (contact_wildcard_names.count(wc.first)) {
+            put(dump_in, wc.second, wc.first);
+            put(dump_out, wc.second - HC_DELTA_TIME + HOST_CONTACT_HIST_OUT, wc.first);
+        }
+    }
+    put3(dump_out, HC_FORCE_X, "force");
+    put3(dump_out, HC_TORQUE_ONLY_FORCE_X, "torque_only_force");
+    // The torques as the force collection makes them
+    dump_out += R"V0G0N({
+        float3 dumpF = force + torque_only_force;
+        applyOriQToVector3<float, deme::oriQ_t>(dumpF.x, dumpF.y, dumpF.z, AOriQ.w, -AOriQ.x, -AOriQ.y, -AOriQ.z);
+        const float3 dumpTorqueA = cross(locCPA, dumpF);
+        dumpF = -1.f * (force + torque_only_force);
+        applyOriQToVector3<float, deme::oriQ_t>(dumpF.x, dumpF.y, dumpF.z, BOriQ.w, -BOriQ.x, -BOriQ.y, -BOriQ.z);
+        const float3 dumpTorqueB = cross(locCPB, dumpF);
+    )V0G0N";
+    put3(dump_out, HC_TORQUE_A_X, "dumpTorqueA");
+    put3(dump_out, HC_TORQUE_B_X, "dumpTorqueB");
+    dump_out += "}\n";
+}
+
 }  // namespace deme
 
 #endif
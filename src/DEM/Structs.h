@@ -118,6 +118,207 @@ const std::unordered_map<std::string, bool> force_kernel_ingredient_stats = {{"t
 // NOTE: Data structs here need to be those complex ones (such as needing to include CudaAllocator.hpp), which may
 // not be jitifiable.
 
+// Handles of the temporary arrays taken from the scratch arena; every arena registers them, in this order, with the
+// names in SCRATCH_ARRAY_NAMES. Contact detection, force collection, contact history migration, wildcard pool
+// migration, island sleeping and distribution inspection take their arrays from the arena; the other temporary arrays
+// (of multi-rate integration, inspectors, coarse graining...), and the small dual arrays and structs that are synced to
+// the host, are still claimed by name from the pools.
+enum SCRATCH_ARRAY : ScratchHandle {
+    // Force collection
+    SCRATCH_ACC_A = 0,
+    SCRATCH_ACC_A_SORTED,
+    SCRATCH_ID_A_OWNER_SORTED,
+    SCRATCH_ACC_OWNER,
+    SCRATCH_UNIQUE_OWNER,
+    // Contact history and wildcard pool migration
+    SCRATCH_NEW_WILDCARDS,
+    SCRATCH_CONTACT_SENTRY,
+    SCRATCH_WILDCARD_POOL_SCOPE,
+    SCRATCH_WILDCARD_POOL_NEW_RECORD,
+    SCRATCH_WILDCARD_POOL_NEW_INDEX,
+    SCRATCH_WILDCARD_POOL_NEW_DATA,
+    // Island sleeping
+    SCRATCH_SLEEP_IS_CANDIDATE,
+    // Distribution inspection
+    SCRATCH_DIST_VALUES,
+    SCRATCH_DIST_GROUPS,
+    SCRATCH_DIST_OWNER_CONTACT_COUNTS,
+    SCRATCH_DIST_COUNTS,
+    SCRATCH_DIST_SUMS,
+    SCRATCH_DIST_MIN_MAX_KEYS,
+    SCRATCH_DIST_HIST,
+    SCRATCH_DIST_BIN_EDGES,
+    SCRATCH_DIST_SORT_KEYS,
+    SCRATCH_DIST_SORTED_KEYS,
+    SCRATCH_DIST_POSITIONS,
+    SCRATCH_DIST_QUANTILE_VALS,
+    // Contact detection: binning
+    SCRATCH_CD_NUM_BINS_SPHERE_TOUCHES,
+    SCRATCH_CD_NUM_ANAL_GEO_SPHERE_TOUCHES,
+    SCRATCH_CD_NUM_BINS_SPHERE_TOUCHES_SCAN,
+    SCRATCH_CD_NUM_ANAL_GEO_SPHERE_TOUCHES_SCAN,
+    SCRATCH_CD_BIN_IDS_EACH_SPHERE_TOUCHES,
+    SCRATCH_CD_SPHERE_IDS_EACH_BIN_TOUCHES,
+    SCRATCH_CD_SPHERE_IDS_EACH_BIN_TOUCHES_SORTED,
+    SCRATCH_CD_BIN_IDS_EACH_SPHERE_TOUCHES_SORTED,
+    SCRATCH_CD_NUM_SPHERES_BIN_TOUCHES,
+    SCRATCH_CD_SPHERE_IDS_LOOK_UP_TABLE,
+    SCRATCH_CD_SANDWICH_A_NODE1,
+    SCRATCH_CD_SANDWICH_B_NODE1,
+    SCRATCH_CD_NUM_BINS_TRI_TOUCHES,
+    SCRATCH_CD_NUM_BINS_TRI_TOUCHES_SCAN,
+    SCRATCH_CD_BIN_IDS_EACH_TRI_TOUCHES,
+    SCRATCH_CD_TRI_IDS_EACH_BIN_TOUCHES,
+    SCRATCH_CD_TRI_IDS_EACH_BIN_TOUCHES_SORTED,
+    SCRATCH_CD_BIN_IDS_EACH_TRI_TOUCHES_SORTED,
+    SCRATCH_CD_NUM_TRIANGLES_BIN_TOUCHES,
+    SCRATCH_CD_TRI_IDS_LOOK_UP_TABLE,
+    // Contact detection: contact pairs
+    SCRATCH_CD_NUM_SPH_CONTACTS_IN_EACH_BIN,
+    SCRATCH_CD_NUM_TRI_SPH_CONTACTS_IN_EACH_BIN,
+    SCRATCH_CD_SPH_SPH_CONTACT_REPORT_OFFSETS,
+    SCRATCH_CD_TRI_SPH_CONTACT_REPORT_OFFSETS,
+    SCRATCH_CD_MESH_GRID_WORLD_BOUNDS,
+    SCRATCH_CD_NUM_SPH_MESH_GRID_CONTACTS,
+    SCRATCH_CD_SPH_MESH_GRID_REPORT_OFFSETS,
+    SCRATCH_CD_HIER_GRID_SPH_POS,
+    SCRATCH_CD_HIER_GRID_SPH_RADIUS,
+    SCRATCH_CD_HIER_GRID_KEYS,
+    SCRATCH_CD_HIER_GRID_SPH_IDS,
+    SCRATCH_CD_HIER_GRID_KEYS_SORTED,
+    SCRATCH_CD_HIER_GRID_SPH_IDS_SORTED,
+    SCRATCH_CD_NUM_SPH_HIER_GRID_CONTACTS,
+    SCRATCH_CD_SPH_HIER_GRID_REPORT_OFFSETS,
+    // Contact detection: persistent contacts
+    SCRATCH_CD_GRAB_FLAGS,
+    SCRATCH_CD_SELECTED_ID_A,
+    SCRATCH_CD_SELECTED_ID_B,
+    SCRATCH_CD_SELECTED_TYPES,
+    SCRATCH_CD_TOTAL_ID_A,
+    SCRATCH_CD_TOTAL_ID_B,
+    SCRATCH_CD_TOTAL_TYPES,
+    SCRATCH_CD_TOTAL_PERSISTENCY,
+    SCRATCH_CD_CONTACT_TYPE_SORTED,
+    SCRATCH_CD_ID_A_SORTED,
+    SCRATCH_CD_ID_B_SORTED,
+    SCRATCH_CD_PERSISTENCY_SORTED,
+    SCRATCH_CD_ID_A_RUNLENGTH,
+    SCRATCH_CD_UNIQUE_ID_A,
+    SCRATCH_CD_ID_A_SCANNED_RUNLENGTH,
+    SCRATCH_CD_RETAIN_FLAGS,
+    // Contact detection: history map
+    SCRATCH_CD_NEW_ID_A_RUNLENGTH,
+    SCRATCH_CD_UNIQUE_NEW_ID_A,
+    SCRATCH_CD_OLD_ID_A_RUNLENGTH,
+    SCRATCH_CD_UNIQUE_OLD_ID_A,
+    SCRATCH_CD_NEW_ID_A_RUNLENGTH_FULL,
+    SCRATCH_CD_OLD_ID_A_RUNLENGTH_FULL,
+    SCRATCH_CD_NEW_ID_A_SCANNED_RUNLENGTH,
+    SCRATCH_CD_OLD_ID_A_SCANNED_RUNLENGTH,
+    SCRATCH_CD_OLD_ARR_UNSORT_TO_SORT_MAP,
+    SCRATCH_CD_ONE_TO_N,
+    SCRATCH_CD_OLD_CONTACT_TYPE_SORTED,
+    SCRATCH_CD_MAP_SORTED,
+    // Contact detection: overwriting the previous contacts
+    SCRATCH_CD_ID_A,
+    SCRATCH_CD_ID_B,
+    SCRATCH_CD_TYPES,
+    // Contact detection skin: owner displacements since the last CD
+    SCRATCH_CD_OWNER_DISP,
+    SCRATCH_NUM_ARRAYS
+};
+const std::string SCRATCH_ARRAY_NAMES[SCRATCH_NUM_ARRAYS] = {"acc_A",
+                                                             "acc_A_sorted",
+                                                             "idAOwner_sorted",
+                                                             "accOwner",
+                                                             "uniqueOwner",
+                                                             "newWildcards",
+                                                             "contactSentry",
+                                                             "wildcardPoolScope",
+                                                             "wildcardPoolNewRecord",
+                                                             "wildcardPoolNewIndex",
+                                                             "wildcardPoolNewData",
+                                                             "sleepIsCandidate",
+                                                             "distValues",
+                                                             "distGroups",
+                                                             "distOwnerContactCounts",
+                                                             "distCounts",
+                                                             "distSums",
+                                                             "distMinMaxKeys",
+                                                             "distHist",
+                                                             "distBinEdges",
+                                                             "distSortKeys",
+                                                             "distSortedKeys",
+                                                             "distPositions",
+                                                             "distQuantileVals",
+                                                             "numBinsSphereTouches",
+                                                             "numAnalGeoSphereTouches",
+                                                             "numBinsSphereTouchesScan",
+                                                             "numAnalGeoSphereTouchesScan",
+                                                             "binIDsEachSphereTouches",
+                                                             "sphereIDsEachBinTouches",
+                                                             "sphereIDsEachBinTouches_sorted",
+                                                             "binIDsEachSphereTouches_sorted",
+                                                             "numSpheresBinTouches",
+                                                             "sphereIDsLookUpTable",
+                                                             "sandwichANode1",
+                                                             "sandwichBNode1",
+                                                             "numBinsTriTouches",
+                                                             "numBinsTriTouchesScan",
+                                                             "binIDsEachTriTouches",
+                                                             "triIDsEachBinTouches",
+                                                             "triIDsEachBinTouches_sorted",
+                                                             "binIDsEachTriTouches_sorted",
+                                                             "numTrianglesBinTouches",
+                                                             "triIDsLookUpTable",
+                                                             "numSphContactsInEachBin",
+                                                             "numTriSphContactsInEachBin",
+                                                             "sphSphContactReportOffsets",
+                                                             "triSphContactReportOffsets",
+                                                             "meshGridWorldBounds",
+                                                             "numSphMeshGridContacts",
+                                                             "sphMeshGridReportOffsets",
+                                                             "hierGridSphPos",
+                                                             "hierGridSphRadius",
+                                                             "hierGridKeys",
+                                                             "hierGridSphIDs",
+                                                             "hierGridKeys_sorted",
+                                                             "hierGridSphIDs_sorted",
+                                                             "numSphHierGridContacts",
+                                                             "sphHierGridReportOffsets",
+                                                             "grab_flags",
+                                                             "selected_idA",
+                                                             "selected_idB",
+                                                             "selected_types",
+                                                             "total_idA",
+                                                             "total_idB",
+                                                             "total_types",
+                                                             "total_persistency",
+                                                             "contactType_sorted",
+                                                             "idA_sorted",
+                                                             "idB_sorted",
+                                                             "persistency_sorted",
+                                                             "idA_runlength",
+                                                             "unique_idA",
+                                                             "idA_scanned_runlength",
+                                                             "retain_flags",
+                                                             "new_idA_runlength",
+                                                             "unique_new_idA",
+                                                             "old_idA_runlength",
+                                                             "unique_old_idA",
+                                                             "new_idA_runlength_full",
+                                                             "old_idA_runlength_full",
+                                                             "new_idA_scanned_runlength",
+                                                             "old_idA_scanned_runlength",
+                                                             "old_arr_unsort_to_sort_map",
+                                                             "one_to_n",
+                                                             "old_contactType_sorted",
+                                                             "map_sorted",
+                                                             "idA",
+                                                             "idB",
+                                                             "cType",
+                                                             "ownerCDDisp"};
+
 // DEMSolverScratchData mainly contains space allocated as system scratch pad and as thread temporary arrays
 class DEMSolverScratchData {
   private:
@@ -126,6 +327,8 @@ class DEMSolverScratchData {
     DeviceVectorPool<scratch_t> m_deviceVecPool;
     DualArrayPool<scratch_t> m_dualArrPool;
     DualStructPool<size_t> m_dualStructPool;
+    // Temporary arrays of hot paths, taken by handle (SCRATCH_ARRAY) in scopes
+    ScratchArena<DeviceScratchAllocator> m_arena;
 
   public:
     // Number of contacts in this CD step
@@ -136,11 +339,26 @@ class DEMSolverScratchData {
     DualStruct<size_t> numPrevSpheres = DualStruct<size_t>(0);
 
     DEMSolverScratchData(size_t* external_host_counter = nullptr, size_t* external_device_counter = nullptr)
-        : m_deviceVecPool(external_device_counter), m_dualArrPool(external_host_counter, external_device_counter) {
+        : m_deviceVecPool(external_device_counter),
+          m_dualArrPool(external_host_counter, external_device_counter),
+          m_arena(external_device_counter) {
         m_deviceVecPool.claim("ScratchSpace", 42);
+        for (unsigned int i = 0; i < SCRATCH_NUM_ARRAYS; i++)
+            m_arena.registerHandle(SCRATCH_ARRAY_NAMES[i]);
     }
     ~DEMSolverScratchData() { releaseMemory(); }
 
+    // Record the pools and counters in a memory registry, with names starting with prefix
+    void setMemoryRegistry(MemoryRegistry* registry, const std::string& prefix) {
+        m_deviceVecPool.setMemoryRegistry(registry, prefix + "scratch.deviceVecPool", "scratch");
+        m_dualArrPool.setMemoryRegistry(registry, prefix + "scratch.dualArrPool", "scratch");
+        m_dualStructPool.setMemoryRegistry(registry, prefix + "scratch.dualStructPool", "scratch");
+        m_arena.setMemoryRecord(registry->Register(prefix + "scratch.arena", "scratch"));
+        DEME_REGISTER_MEMORY(registry, prefix + "scratch.", numContacts, "scratch");
+        DEME_REGISTER_MEMORY(registry, prefix + "scratch.", numPrevContacts, "scratch");
+        DEME_REGISTER_MEMORY(registry, prefix + "scratch.", numPrevSpheres, "scratch");
+    }
+
     // Return raw pointer to swath of device memory that is at least "sizeNeeded" large
     scratch_t* allocateScratchSpace(size_t sizeNeeded) {
         m_deviceVecPool.resize("ScratchSpace", sizeNeeded);
@@ -157,6 +375,19 @@ class DEMSolverScratchData {
         return m_deviceVecPool.claim(name, sizeNeeded);
     }
 
+    // Open a scope of the scratch arena; the arrays taken (by handle) in it are given back when it is destroyed. Hold
+    // it in a named variable, like auto scope = scratchPad.openScope();
+    ScratchArena<DeviceScratchAllocator>::Scope openScope() { return m_arena.scope(); }
+    // Take a temporary array for a handle in the innermost scope; no names are looked up, and the memory is shared
+    // with arrays of other scopes
+    scratch_t* allocateTempVector(SCRATCH_ARRAY handle, size_t sizeNeeded) {
+        return (scratch_t*)m_arena.allocate(handle, sizeNeeded);
+    }
+    scratch_t* getTempVector(SCRATCH_ARRAY handle) const { return (scratch_t*)m_arena.get(handle); }
+    void setArenaPolicy(const ScratchArenaPolicy& policy) { m_arena.setPolicy(policy); }
+    const ScratchArenaStats& getArenaStats() const { return m_arena.getStats(); }
+    const ScratchHandleStats& getArenaStats(SCRATCH_ARRAY handle) const { return m_arena.getHandleStats(handle); }
+
     // Dual arrays allocated here will always be temporary. If you need permanent dual array, create it as a member of
     // your worker.
     DualArray<scratch_t>* allocateDualArray(const std::string& name, size_t sizeNeeded) {
@@ -190,22 +421,18 @@ class DEMSolverScratchData {
         m_deviceVecPool.printStatus();
         m_dualArrPool.printStatus();
         m_dualStructPool.printStatus();
+        m_arena.printStatus();
     }
 
     void releaseMemory() {
         m_deviceVecPool.releaseAll();
         m_dualArrPool.releaseAll();
         m_dualStructPool.releaseAll();
+        m_arena.releaseAll();
     }
 };
 
 struct kTStateParams {
-    // The `top speed' of the change of bin size
-    float binTopChangeRate = 0.05;
-    // The `current speed' fo the change of bin size
-    float binCurrentChangeRate = 0.0;
-    // The `acceleration' of bin size change rate, (0, 1]: 1 means each time a change is applied, it's at top speed
-    float binChangeRateAcc = 0.1;
     // Number of CD steps before the solver makes a decision on how to change the bin size
     unsigned int binChangeObserveSteps = 25;
     // Past the point that (this number * error out bin geometry count)-many geometries found in a bin, the solver will
@@ -222,6 +449,10 @@ struct kTStateParams {
     // Num of bins, currently
     size_t numBins = 0;
 
+    // Num of sphere--bin touch pairs and num of bins that have spheres in them, found in the last CD
+    size_t numBinSphereTouchPairs = 0;
+    size_t numActiveBins = 0;
+
     // Current average num of contacts per sphere has.
     float avgCntsPerSphere = 0.;
 
@@ -231,6 +462,8 @@ struct kTStateParams {
     DualStruct<float> ts;                               // kT's own storage of ts size
     DualStruct<unsigned int> maxDrift_buffer;           // buffer for max dT future drift steps
     DualStruct<unsigned int> maxDrift;                  // kT's own storage for max future drift
+    DualStruct<float> skin_buffer;                      // buffer for the CD skin (displacement-triggered CD)
+    DualStruct<float> skin;                             // kT's own storage of the CD skin
 };
 
 struct dTStateParams {};
@@ -261,13 +494,13 @@ inline std::string pretty_format_bytes(size_t bytes) {
 // =============================================================================
 
 // Types of entities (can be either owner or geometry entity) that can be inspected by inspection methods
-enum class INSPECT_ENTITY_TYPE { SPHERE, CLUMP, MESH, MESH_FACET, EVERYTHING };
+enum class INSPECT_ENTITY_TYPE { SPHERE, CLUMP, MESH, MESH_FACET, EVERYTHING, CONTACT };
 // Which reduce operation is needed in an inspection
 enum class CUB_REDUCE_FLAVOR { NONE, MAX, MIN, SUM };
 // Format of the output files
-enum class OUTPUT_FORMAT { CSV, BINARY, CHPF };
+enum class OUTPUT_FORMAT { CSV, BINARY, CHPF, QUANTIZED };
 // Mesh output format
-enum class MESH_FORMAT { VTK, OBJ };
+enum class MESH_FORMAT { VTK, OBJ, INCREMENTAL };
 // Adaptive time step size methods
 enum class ADAPT_TS_TYPE { NONE, MAX_VEL, INT_DIFF };
 
@@ -365,11 +598,21 @@ enum class ADAPT_TS_TYPE { NONE, MAX_VEL, INT_DIFF };
     }
 
 // Jitify options include suppressing variable-not-used warnings. We could use CUDA lib functions too.
-#define DEME_JITIFY_DEFAULT_OPTIONS                                                                   \
-    {                                                                                                 \
-        "-I" + (JitHelper::KERNEL_INCLUDE_DIR).string(), "-I" + (JitHelper::KERNEL_DIR).string(),     \
-            "-I" + std::string(DEME_CUDA_TOOLKIT_HEADERS), "-diag-suppress=550", "-diag-suppress=177" \
-    }
+// The JIT-compiled kernels must see the same index types as the static code.
+#ifdef DEME_USE_WIDE_INDICES
+    #define DEME_JITIFY_DEFAULT_OPTIONS                                                                   \
+        {                                                                                                 \
+            "-I" + (JitHelper::KERNEL_INCLUDE_DIR).string(), "-I" + (JitHelper::KERNEL_DIR).string(),     \
+                "-I" + std::string(DEME_CUDA_TOOLKIT_HEADERS), "-diag-suppress=550", "-diag-suppress=177", \
+                "-DDEME_USE_WIDE_INDICES"                                                                 \
+        }
+#else
+    #define DEME_JITIFY_DEFAULT_OPTIONS                                                                   \
+        {                                                                                                 \
+            "-I" + (JitHelper::KERNEL_INCLUDE_DIR).string(), "-I" + (JitHelper::KERNEL_DIR).string(),     \
+                "-I" + std::string(DEME_CUDA_TOOLKIT_HEADERS), "-diag-suppress=550", "-diag-suppress=177" \
+        }
+#endif
 
 // =============================================================================
 // NOW SOME HOST-SIDE SIMPLE STRUCTS USED BY THE DEM MODULE
@@ -400,6 +643,52 @@ class SolverTimers {
     Timer<double>& GetTimer(const std::string& name) { return m_timers.at(name); }
 };
 
+// How ExportOwnerState lays out the owner states in a user buffer
+struct StateExportLayout {
+    // STATE_EXPORT_CONTENT flags. Selected columns appear in the order of the flag values.
+    unsigned int columns = EXPORT_POS;
+    // If true, the components of one owner are consecutive (row-major, AoS), and rows are rowStride elements apart (0
+    // means tightly packed); if false, each component is a contiguous block of n elements (column-major, SoA).
+    bool interleaved = true;
+    size_t rowStride = 0;
+
+    // Number of components per owner
+    size_t NumComponents() const {
+        return ((columns & EXPORT_POS) ? 3 : 0) + ((columns & EXPORT_QUAT) ? 4 : 0) + ((columns & EXPORT_VEL) ? 3 : 0) +
+               ((columns & EXPORT_ANG_VEL) ? 3 : 0) + ((columns & EXPORT_ACC) ? 3 : 0) +
+               ((columns & EXPORT_ANG_ACC) ? 3 : 0) + ((columns & EXPORT_FAMILY) ? 1 : 0);
+    }
+    // Distance (in elements) between two consecutive owners in the buffer
+    size_t RowStep() const { return interleaved ? (rowStride > 0 ? rowStride : NumComponents()) : 1; }
+    // Minimum buffer length (in elements) to hold n owners
+    size_t RequiredLength(size_t n) const {
+        if (n == 0)
+            return 0;
+        return interleaved ? (n - 1) * RowStep() + NumComponents() : n * NumComponents();
+    }
+};
+
+// Definition of a contact force probe: the owners whose contact forces are monitored
+struct ContactForceProbe {
+    std::vector<bodyID_t> owners;
+    std::set<unsigned int> families;
+    // Moments are taken about this point (global frame)
+    float3 refPoint = make_float3(0, 0, 0);
+    // Whether per-contact points, forces and torques are kept too
+    bool keepDetail = false;
+};
+
+// Aggregated contact forces a probe's bodies experience
+struct ContactForceProbeResult {
+    size_t numContacts = 0;
+    // Sum of contact forces (global frame)
+    float3 force = make_float3(0, 0, 0);
+    // Sum of moments about the probe's reference point (global frame), including torque-only contact forces
+    float3 moment = make_float3(0, 0, 0);
+    // Contact point locations averaged using the force magnitudes as weights
+    float3 forceCenter = make_float3(0, 0, 0);
+};
+
 // Manager of the collabortation between the main thread and worker threads
 class WorkerReportChannel {
   public:
@@ -497,6 +786,14 @@ struct SolverFlags {
     bool canFamilyChangeOnDevice = false;
     // If mesh will deform in the next kT-update cycle
     std::atomic<bool> willMeshDeform = false;
+    // Whether rigid meshes use local-frame facet grids (built once) instead of being binned at each CD
+    bool useMeshLocalGrid = false;
+    // Whether sphere--sphere contacts are found through a hierarchical grid instead of the bins
+    bool useHierGridCD = false;
+    // Whether CD is triggered by the displacement since the last CD (Verlet skin criterion) rather than step counts,
+    // and whether the skin is re-chosen on the fly
+    bool useDisplacementCD = false;
+    bool autoTuneCDSkin = true;
     // Some output-related flags
     unsigned int outputFlags = OUTPUT_CONTENT::QUAT | OUTPUT_CONTENT::ABSV;
     unsigned int cntOutFlags;
@@ -517,6 +814,18 @@ struct SolverFlags {
     bool useNoContactRecord = false;
     // Collect force (reduce to acc) right in the force calculation kernel
     bool useForceCollectInPlace = false;
+    // Number of sub-steps the fast contacts take in one time step (multi-rate integration is off if 1), and whether
+    // all sphere--mesh contacts are fast
+    unsigned int nSubSteps = 1;
+    bool subStepMeshContacts = false;
+    // Whether quiescent contact islands are put to sleep
+    bool useSleeping = false;
+    // Whether contact forces are calculated by kernels specialized for each contact type, and the size under which
+    // contact type segments are fused into one launch
+    bool useSegmentedForce = false;
+    size_t forceSegmentFuseSize = 2048;
+    // Whether the state of each contact is dumped in the force calculation (for checking host force models)
+    bool dumpContactStates = false;
     // Max number of steps dT is allowed to be ahead of kT, even when auto-adapt is enabled
     unsigned int upperBoundFutureDrift = 5000;
     // (targetDriftMoreThanAvg + targetDriftMultipleOfAvg * actual_dT_steps_per_kT_step) is used to calculate contact
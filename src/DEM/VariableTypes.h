@@ -20,8 +20,14 @@ typedef uint16_t subVoxelPos_t;  ///< uint16 or uint32
 
 typedef uint64_t voxelID_t;
 typedef float oriQ_t;
+// Body, bin and contact-pair indices are 64-bit if built with USE_WIDE_INDICES (see DEM/utils/IndexWidth.hpp)
+#ifdef DEME_USE_WIDE_INDICES
+typedef uint64_t bodyID_t;
+typedef uint64_t binID_t;
+#else
 typedef unsigned int bodyID_t;
 typedef unsigned int binID_t;
+#endif
 typedef uint8_t objID_t;
 typedef uint16_t materialsOffset_t;
 typedef uint16_t inertiaOffset_t;
@@ -34,7 +40,11 @@ typedef char scratch_t;  ///< Data type for DEM scratch-pad array (this should N
 typedef unsigned short int binsSphereTouches_t;
 // This type needs to be large enough to hold the result of a prefix scan of the type binsSphereTouches_t (and objID_t);
 // but normally, it should be the same magnitude as bodyID_t.
+#ifdef DEME_USE_WIDE_INDICES
+typedef uint64_t binSphereTouchPairs_t;
+#else
 typedef unsigned int binSphereTouchPairs_t;
+#endif
 // How many spheres a bin can touch, tops? We can assume it will not be too large to save GPU memory.
 typedef unsigned short int spheresBinTouches_t;
 // How many contact pairs can there be in one bin? Sometimes, the geometry overlap is significant and there can be a
@@ -42,7 +52,11 @@ typedef unsigned short int spheresBinTouches_t;
 typedef unsigned int binContactPairs_t;
 // Need to be large enough to hold the number of total contact pairs. In general this number should be in the same
 // magnitude as bodyID_t.
+#ifdef DEME_USE_WIDE_INDICES
+typedef uint64_t contactPairs_t;
+#else
 typedef unsigned int contactPairs_t;
+#endif
 // How many other entities can a sphere touch, tops? It does not need to be large unless you have spheres that have
 // magnitudes of difference in size, which you should preferrably avoid.
 typedef unsigned short int geoSphereTouches_t;
@@ -51,7 +65,11 @@ typedef unsigned short int geoSphereTouches_t;
 typedef unsigned int binsTriangleTouches_t;
 // This type needs to be large enough to hold the result of a prefix scan of the type binsTriangleTouches_t (and
 // objID_t).
+#ifdef DEME_USE_WIDE_INDICES
+typedef uint64_t binsTriangleTouchPairs_t;
+#else
 typedef unsigned int binsTriangleTouchPairs_t;
+#endif
 // How many triangles a bin can touch, tops? We can assume it will not be too large to save GPU memory.
 typedef unsigned short int trianglesBinTouches_t;
 
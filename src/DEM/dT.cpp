@@ -7,6 +7,7 @@
 #include <iostream>
 #include <thread>
 #include <algorithm>
+#include <numeric>
 
 #ifdef DEME_USE_CHPF
     #include <chpf.hpp>
@@ -55,17 +56,29 @@ void DEMDynamicThread::packDataPointers() {
     contactType.bindDevicePointer(&(granData->contactType));
     familyMaskMatrix.bindDevicePointer(&(granData->familyMasks));
     familyExtraMarginSize.bindDevicePointer(&(granData->familyExtraMarginSize));
+    familySubStepped.bindDevicePointer(&(granData->familySubStepped));
+    ownerSleepIsland.bindDevicePointer(&(granData->ownerSleepIsland));
+    ownerSleepFamily.bindDevicePointer(&(granData->ownerSleepFamily));
+    sleepIslandWoken.bindDevicePointer(&(granData->sleepIslandWoken));
+    ownerQuietSteps.bindDevicePointer(&(granData->ownerQuietSteps));
+    ownerSleepRadius.bindDevicePointer(&(granData->ownerSleepRadius));
+    familySleepRole.bindDevicePointer(&(granData->familySleepRole));
 
     contactForces.bindDevicePointer(&(granData->contactForces));
     contactTorque_convToForce.bindDevicePointer(&(granData->contactTorque_convToForce));
     contactPointGeometryA.bindDevicePointer(&(granData->contactPointGeometryA));
     contactPointGeometryB.bindDevicePointer(&(granData->contactPointGeometryB));
+    contactStateDump.bindDevicePointer(&(granData->contactStateDump));
     // granData->contactHistory = contactHistory.data();
     // granData->contactDuration = contactDuration.data();
 
     for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
         contactWildcards[i]->bindDevicePointer(&(granData->contactWildcards[i]));
     }
+    for (unsigned int i = 0; i < wildcardPoolIndex.size(); i++) {
+        wildcardPoolIndex[i]->bindDevicePointer(&(granData->wildcardPoolIndex[i]));
+        wildcardPoolData[i]->bindDevicePointer(&(granData->wildcardPoolData[i]));
+    }
     for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
         ownerWildcards[i]->bindDevicePointer(&(granData->ownerWildcards[i]));
     }
@@ -132,6 +145,17 @@ void DEMDynamicThread::migrateDataToDevice() {
     contactType.toDeviceAsync(streamInfo.stream);
     familyMaskMatrix.toDeviceAsync(streamInfo.stream);
     familyExtraMarginSize.toDeviceAsync(streamInfo.stream);
+    familySubStepped.toDeviceAsync(streamInfo.stream);
+    if (solverFlags.useSleeping) {
+        ownerSleepIsland.toDeviceAsync(streamInfo.stream);
+        ownerSleepFamily.toDeviceAsync(streamInfo.stream);
+        sleepIslandWoken.toDeviceAsync(streamInfo.stream);
+        ownerQuietSteps.toDeviceAsync(streamInfo.stream);
+        ownerSleepRadius.toDeviceAsync(streamInfo.stream);
+        familySleepRole.toDeviceAsync(streamInfo.stream);
+    }
+    ownerBoundRadius.toDeviceAsync(streamInfo.stream);
+    ownerSymAxis.toDeviceAsync(streamInfo.stream);
 
     contactForces.toDeviceAsync(streamInfo.stream);
     contactTorque_convToForce.toDeviceAsync(streamInfo.stream);
@@ -141,6 +165,12 @@ void DEMDynamicThread::migrateDataToDevice() {
     for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
         contactWildcards[i]->toDeviceAsync(streamInfo.stream);
     }
+    for (unsigned int i = 0; i < wildcardPoolIndex.size(); i++) {
+        wildcardPoolIndex[i]->toDeviceAsync(streamInfo.stream);
+        wildcardPoolData[i]->toDeviceAsync(streamInfo.stream);
+        if (wildcardPoolFamilyPairs[i])
+            wildcardPoolFamilyPairs[i]->toDeviceAsync(streamInfo.stream);
+    }
     for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
         ownerWildcards[i]->toDeviceAsync(streamInfo.stream);
     }
@@ -224,6 +254,10 @@ void DEMDynamicThread::migrateContactInfoToHost() {
     for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
         contactWildcards[i]->toHost();
     }
+    for (unsigned int i = 0; i < wildcardPoolIndex.size(); i++) {
+        wildcardPoolIndex[i]->toHost();
+        wildcardPoolData[i]->toHost();
+    }
 }
 
 void DEMDynamicThread::migrateFamilyToHost() {
@@ -287,6 +321,7 @@ void DEMDynamicThread::packTransferPointers(DEMKinematicThread*& kT) {
     // Single-number data are now not packaged in granData...
     granData->pKTOwnedBuffer_ts = &(kT->stateParams.ts_buffer);
     granData->pKTOwnedBuffer_maxDrift = &(kT->stateParams.maxDrift_buffer);
+    granData->pKTOwnedBuffer_skin = &(kT->stateParams.skin_buffer);
 }
 
 void DEMDynamicThread::changeFamily(unsigned int ID_from, unsigned int ID_to) {
@@ -344,7 +379,9 @@ void DEMDynamicThread::setSimParams(unsigned char nvXp2,
     simParams->userBoxMin = user_box_min;
     simParams->userBoxMax = user_box_max;
 
-    simParams->nContactWildcards = contact_wildcards.size();
+    // Only the dense contact wildcards have arrays over all contacts; the pooled ones are numbered after them
+    simParams->nContactWildcards =
+        NumberContactWildcards(contact_wildcards, wildcardPools, m_contact_wildcard_num, m_contact_wildcard_slots);
     simParams->nOwnerWildcards = owner_wildcards.size();
     simParams->nGeoWildcards = geo_wildcards.size();
 
@@ -511,6 +548,34 @@ void DEMDynamicThread::allocateGPUArrays(size_t nOwnerBodies,
     }
     // Volume info is jitified
     DEME_DUAL_ARRAY_RESIZE(volumeOwnerBody, nMassProperties, 0);
+    // Displacement-triggered CD needs the owner sizes and the owner snapshots of the CD orders
+    if (solverFlags.useDisplacementCD) {
+        DEME_DUAL_ARRAY_RESIZE(ownerBoundRadius, nOwnerBodies, 0);
+        DEME_DUAL_ARRAY_RESIZE(ownerSymAxis, nOwnerBodies, make_float3(0));
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(cdRefPos, nOwnerBodies);
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(cdRefOriQ, nOwnerBodies);
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(cdOrderPos, nOwnerBodies);
+        DEME_DUAL_ARRAY_RESIZE_NOVAL(cdOrderOriQ, nOwnerBodies);
+    }
+    // Contact type-segmented force calculation needs the segment bounds, and a flag for unsorted pairs
+    if (solverFlags.useSegmentedForce) {
+        DEME_DUAL_ARRAY_RESIZE(contactTypeSegBounds, NUM_CONTACT_TYPE_SLOTS + 2, 0);
+        forceSegmentsStale = true;
+    }
+    // Island sleeping: (re-)allocation wakes everything up
+    if (solverFlags.useSleeping) {
+        DEME_DUAL_ARRAY_RESIZE(ownerSleepIsland, nOwnerBodies, NULL_BODYID);
+        DEME_DUAL_ARRAY_RESIZE(ownerSleepFamily, nOwnerBodies, 0);
+        DEME_DUAL_ARRAY_RESIZE(sleepIslandWoken, nOwnerBodies, 0);
+        DEME_DUAL_ARRAY_RESIZE(ownerQuietSteps, nOwnerBodies, 0);
+        DEME_DUAL_ARRAY_RESIZE(ownerSleepRadius, nOwnerBodies, 0);
+        for (size_t i = 0; i < nOwnerBodies; i++) {
+            ownerSleepIsland[i] = NULL_BODYID;
+            ownerQuietSteps[i] = 0;
+        }
+        hasSleepMarks = false;
+        stepsSinceSleepCheck = 0;
+    }
 
     // Arrays for contact info
     // The lengths of contact event-based arrays are just estimates. My estimate of total contact pairs is ~ 2n, and I
@@ -532,6 +597,7 @@ void DEMDynamicThread::allocateGPUArrays(size_t nOwnerBodies,
             DEME_DUAL_ARRAY_RESIZE(contactPointGeometryA, cnt_arr_size, make_float3(0));
             DEME_DUAL_ARRAY_RESIZE(contactPointGeometryB, cnt_arr_size, make_float3(0));
         }
+        contactCapacity.setCapacity(idGeometryA.size());
         // Allocate memory for each wildcard array
         contactWildcards.resize(simParams->nContactWildcards);
         ownerWildcards.resize(simParams->nOwnerWildcards);
@@ -542,6 +608,22 @@ void DEMDynamicThread::allocateGPUArrays(size_t nOwnerBodies,
             contactWildcards[i] =
                 std::make_unique<DualArray<float>>(cnt_arr_size, 0, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
         }
+        // A pool starts with no records; they are made as contacts in scope arrive
+        wildcardPoolIndex.resize(wildcardPools.size());
+        wildcardPoolData.resize(wildcardPools.size());
+        wildcardPoolFamilyPairs.resize(wildcardPools.size());
+        wildcardPoolNumRecords.assign(wildcardPools.size(), 0);
+        for (unsigned int i = 0; i < wildcardPools.size(); i++) {
+            wildcardPoolIndex[i] = std::make_unique<DualArray<contactPairs_t>>(
+                cnt_arr_size, NULL_MAPPING_PARTNER, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+            wildcardPoolData[i] = std::make_unique<DualArray<uint8_t>>(
+                WildcardPoolRecordBytes(wildcardPools[i]), 0, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+            std::vector<notStupidBool_t> pair_table = WildcardPoolFamilyPairTable(wildcardPools[i]);
+            if (pair_table.size() > 0) {
+                wildcardPoolFamilyPairs[i] = std::make_unique<DualArray<notStupidBool_t>>(
+                    pair_table, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+            }
+        }
         for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
             ownerWildcards[i] =
                 std::make_unique<DualArray<float>>(nOwnerBodies, 0, &m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
@@ -649,6 +731,8 @@ void DEMDynamicThread::populateEntityArrays(const std::vector<std::shared_ptr<DE
                                             const std::vector<float>& ext_obj_mass_types,
                                             const std::vector<float3>& ext_obj_moi_types,
                                             const std::vector<unsigned int>& ext_obj_comp_num,
+                                            const std::vector<float3>& ext_obj_sym_axis,
+                                            const std::vector<float>& ext_obj_bound_radius,
                                             const std::vector<float>& mesh_obj_mass_types,
                                             const std::vector<float3>& mesh_obj_moi_types,
                                             size_t nExistOwners,
@@ -779,6 +863,22 @@ void DEMDynamicThread::populateEntityArrays(const std::vector<std::shared_ptr<DE
                     (double)this_CoM_coord.x, (double)this_CoM_coord.y, (double)this_CoM_coord.z, simParams->nvXp2,
                     simParams->nvYp2, simParams->voxelSize, simParams->l);
 
+                // Only the sphere centers move with rotation (a sphere turning about its own center does not matter)
+                if (solverFlags.useDisplacementCD) {
+                    float bound = 0.f;
+                    for (const auto& relPos : this_clump_no_sp_relPos) {
+                        bound = std::max(bound, length(relPos));
+                    }
+                    ownerBoundRadius[nExistOwners + i] = bound;
+                }
+                if (solverFlags.useSleeping) {
+                    float bound = 0.f;
+                    for (size_t jj = 0; jj < this_clump_no_sp_radii.size(); jj++) {
+                        bound = std::max(bound, length(this_clump_no_sp_relPos.at(jj)) + this_clump_no_sp_radii.at(jj));
+                    }
+                    ownerSleepRadius[nExistOwners + i] = bound;
+                }
+
                 // Set initial oriQ
                 auto oriQ_of_this_clump = input_clump_oriQ.at(j);
                 oriQw[nExistOwners + i] = oriQ_of_this_clump.w;
@@ -853,10 +953,9 @@ void DEMDynamicThread::populateEntityArrays(const std::vector<std::shared_ptr<DE
                 idGeometryA[cnt_arr_offset] = idPair.first + n_processed_sp_comp + nExistSpheres;
                 idGeometryB[cnt_arr_offset] = idPair.second + n_processed_sp_comp + nExistSpheres;
                 contactType[cnt_arr_offset] = SPHERE_SPHERE_CONTACT;  // Only sph--sph cnt for now
-                unsigned int w_num = 0;
                 for (const auto& w_name : m_contact_wildcard_names) {
-                    (*contactWildcards[w_num])[cnt_arr_offset] = a_batch->contact_wildcards.at(w_name).at(jj);
-                    w_num++;
+                    setContactWildcardOnHost(m_contact_wildcard_num.at(w_name), cnt_arr_offset,
+                                             a_batch->contact_wildcards.at(w_name).at(jj));
                 }
                 cnt_arr_offset++;
             }
@@ -932,6 +1031,20 @@ void DEMDynamicThread::populateEntityArrays(const std::vector<std::shared_ptr<DE
 
         //// TODO: and initial vel?
 
+        // Analytical boundaries may be unbounded, but only the part in the simulation world can touch anything, so
+        // the furthest world corner from an unbounded object bounds its rotation-induced motion. If it has a symmetry
+        // axis, only the turning of that axis moves it.
+        if (solverFlags.useDisplacementCD) {
+            float bound = ext_obj_bound_radius.at(i);
+            if (bound >= DEME_HUGE_FLOAT) {
+                float3 box_center = (simParams->userBoxMin + simParams->userBoxMax) * 0.5f;
+                float3 box_half = (simParams->userBoxMax - simParams->userBoxMin) * 0.5f;
+                bound = length(input_ext_obj_xyz.at(i) - box_center) + length(box_half);
+            }
+            ownerBoundRadius[i + owner_offset_for_ext_obj] = bound;
+            ownerSymAxis[i + owner_offset_for_ext_obj] = ext_obj_sym_axis.at(i);
+        }
+
         family_t this_family_num = input_ext_obj_family.at(i);
         familyID[i + owner_offset_for_ext_obj] = this_family_num;
     }
@@ -1008,6 +1121,14 @@ void DEMDynamicThread::populateEntityArrays(const std::vector<std::shared_ptr<DE
             relPosNode1[nExistingFacets + k] = this_tri.p1;
             relPosNode2[nExistingFacets + k] = this_tri.p2;
             relPosNode3[nExistingFacets + k] = this_tri.p3;
+            if (solverFlags.useDisplacementCD) {
+                float& bound = ownerBoundRadius[owner_offset_for_mesh_obj + this_facet_owner];
+                bound = std::max({bound, length(this_tri.p1), length(this_tri.p2), length(this_tri.p3)});
+            }
+            if (solverFlags.useSleeping) {
+                float& bound = ownerSleepRadius[owner_offset_for_mesh_obj + this_facet_owner];
+                bound = std::max({bound, length(this_tri.p1), length(this_tri.p2), length(this_tri.p3)});
+            }
         }
 
         family_t this_family_num = input_mesh_obj_family.at(i);
@@ -1106,6 +1227,8 @@ void DEMDynamicThread::initGPUArrays(const std::vector<std::shared_ptr<DEMClumpB
                                      const std::vector<float>& ext_obj_mass_types,
                                      const std::vector<float3>& ext_obj_moi_types,
                                      const std::vector<unsigned int>& ext_obj_comp_num,
+                                     const std::vector<float3>& ext_obj_sym_axis,
+                                     const std::vector<float>& ext_obj_bound_radius,
                                      const std::vector<float>& mesh_obj_mass_types,
                                      const std::vector<float3>& mesh_obj_moi_types,
                                      const std::vector<std::shared_ptr<DEMMaterial>>& loaded_materials,
@@ -1122,7 +1245,8 @@ void DEMDynamicThread::initGPUArrays(const std::vector<std::shared_ptr<DEMClumpB
     populateEntityArrays(input_clump_batches, input_ext_obj_xyz, input_ext_obj_rot, input_ext_obj_family,
                          input_mesh_objs, input_mesh_obj_xyz, input_mesh_obj_rot, input_mesh_obj_family,
                          mesh_facet_owner, mesh_facet_materials, mesh_facets, clump_templates, ext_obj_mass_types,
-                         ext_obj_moi_types, ext_obj_comp_num, mesh_obj_mass_types, mesh_obj_moi_types, 0, 0, 0);
+                         ext_obj_moi_types, ext_obj_comp_num, ext_obj_sym_axis, ext_obj_bound_radius,
+                         mesh_obj_mass_types, mesh_obj_moi_types, 0, 0, 0);
 
     buildTrackedObjs(input_clump_batches, ext_obj_comp_num, input_mesh_objs, tracked_objs, 0, 0, 0, 0);
 }
@@ -1142,6 +1266,8 @@ void DEMDynamicThread::updateClumpMeshArrays(const std::vector<std::shared_ptr<D
                                              const std::vector<float>& ext_obj_mass_types,
                                              const std::vector<float3>& ext_obj_moi_types,
                                              const std::vector<unsigned int>& ext_obj_comp_num,
+                                             const std::vector<float3>& ext_obj_sym_axis,
+                                             const std::vector<float>& ext_obj_bound_radius,
                                              const std::vector<float>& mesh_obj_mass_types,
                                              const std::vector<float3>& mesh_obj_moi_types,
                                              const std::vector<std::shared_ptr<DEMMaterial>>& loaded_materials,
@@ -1161,14 +1287,134 @@ void DEMDynamicThread::updateClumpMeshArrays(const std::vector<std::shared_ptr<D
     populateEntityArrays(input_clump_batches, input_ext_obj_xyz, input_ext_obj_rot, input_ext_obj_family,
                          input_mesh_objs, input_mesh_obj_xyz, input_mesh_obj_rot, input_mesh_obj_family,
                          mesh_facet_owner, mesh_facet_materials, mesh_facets, clump_templates, ext_obj_mass_types,
-                         ext_obj_moi_types, ext_obj_comp_num, mesh_obj_mass_types, mesh_obj_moi_types, nExistingOwners,
-                         nExistingSpheres, nExistingFacets);
+                         ext_obj_moi_types, ext_obj_comp_num, ext_obj_sym_axis, ext_obj_bound_radius,
+                         mesh_obj_mass_types, mesh_obj_moi_types, nExistingOwners, nExistingSpheres, nExistingFacets);
 
     // Make changes to tracked objects (potentially add more)
     buildTrackedObjs(input_clump_batches, ext_obj_comp_num, input_mesh_objs, tracked_objs, nExistingOwners,
                      nExistingSpheres, nExistingFacets, nExistingAnalGM);
 }
 
+float3 DEMDynamicThread::getOwnerPosFromHost(bodyID_t ownerID) const {
+    float3 pos;
+    voxelIDToPosition<float, voxelID_t, subVoxelPos_t>(pos.x, pos.y, pos.z, voxelID[ownerID], locX[ownerID],
+                                                       locY[ownerID], locZ[ownerID], simParams->nvXp2,
+                                                       simParams->nvYp2, simParams->voxelSize, simParams->l);
+    pos.x += simParams->LBFX;
+    pos.y += simParams->LBFY;
+    pos.z += simParams->LBFZ;
+    return pos;
+}
+
+float DEMDynamicThread::getOwnerNetForceFromHost(bodyID_t ownerID) const {
+    float mass = (solverFlags.useMassJitify) ? massOwnerBody[inertiaPropOffsets[ownerID]] : massOwnerBody[ownerID];
+    return mass * length(make_float3(aX[ownerID], aY[ownerID], aZ[ownerID]));
+}
+
+std::vector<size_t> DEMDynamicThread::selectSpheresForOutput() {
+    const OutputFilter& filter = ownerOutputFilter;
+    const bool use_filter = filter.IsActive();
+    auto pred = [&](size_t i) {
+        bodyID_t this_owner = ownerClumpBody[i];
+        family_t this_family = familyID[this_owner];
+        // If this (impl-level) family is in the no-output list, skip it
+        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
+            return false;
+        }
+        if (!use_filter)
+            return true;
+        OutputFilterSample s;
+        s.ID = i;
+        s.family = this_family;
+        s.family2 = this_family;
+        if (filter.NeedsPosition()) {
+            size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt[i] : i;
+            float3 this_sp_deviation =
+                make_float3(relPosSphereX[compOffset], relPosSphereY[compOffset], relPosSphereZ[compOffset]);
+            applyOriQToVector3<float, float>(this_sp_deviation.x, this_sp_deviation.y, this_sp_deviation.z,
+                                             oriQw[this_owner], oriQx[this_owner], oriQy[this_owner],
+                                             oriQz[this_owner]);
+            s.pos = getOwnerPosFromHost(this_owner) + this_sp_deviation;
+        }
+        if (filter.NeedsVelocity()) {
+            s.vel = make_float3(vX[this_owner], vY[this_owner], vZ[this_owner]);
+        }
+        if (filter.NeedsForce()) {
+            s.force = getOwnerNetForceFromHost(this_owner);
+        }
+        return filter.Test(s);
+    };
+    return parallelSelectIndices(simParams->nSpheresGM, pred);
+}
+
+std::vector<size_t> DEMDynamicThread::selectClumpsForOutput() {
+    const OutputFilter& filter = ownerOutputFilter;
+    const bool use_filter = filter.IsActive();
+    auto pred = [&](size_t i) {
+        // i is this owner's number. And if it is not a clump, we can move on.
+        if (ownerTypes[i] != OWNER_T_CLUMP)
+            return false;
+        family_t this_family = familyID[i];
+        // If this (impl-level) family is in the no-output list, skip it
+        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
+            return false;
+        }
+        if (!use_filter)
+            return true;
+        OutputFilterSample s;
+        s.ID = i;
+        s.family = this_family;
+        s.family2 = this_family;
+        if (filter.NeedsPosition()) {
+            s.pos = getOwnerPosFromHost(i);
+        }
+        if (filter.NeedsVelocity()) {
+            s.vel = make_float3(vX[i], vY[i], vZ[i]);
+        }
+        if (filter.NeedsForce()) {
+            s.force = getOwnerNetForceFromHost(i);
+        }
+        return filter.Test(s);
+    };
+    return parallelSelectIndices(simParams->nOwnerBodies, pred);
+}
+
+std::vector<size_t> DEMDynamicThread::selectContactsForOutput(float force_thres, bool use_output_filter) {
+    const OutputFilter& filter = contactOutputFilter;
+    const bool use_filter = use_output_filter && filter.IsActive();
+    auto pred = [&](size_t i) {
+        // We don't output fake contacts; but right now, no contact will be marked fake by kT, so no need to check that
+        float3 forcexyz = contactForces[i];
+        float3 torque = contactTorque_convToForce[i];
+        // If this force+torque is too small, then it's not an active contact
+        if (length(forcexyz + torque) < force_thres) {
+            return false;
+        }
+        if (!use_filter)
+            return true;
+        bodyID_t ownerA = ownerClumpBody[idGeometryA[i]];
+        bodyID_t ownerB = getGeoOwnerID(idGeometryB[i], contactType[i]);
+        OutputFilterSample s;
+        s.ID = i;
+        s.family = familyID[ownerA];
+        s.family2 = familyID[ownerB];
+        if (filter.NeedsPosition()) {
+            // Global contact point
+            float3 cntPnt = contactPointGeometryA[i];
+            applyOriQToVector3(cntPnt.x, cntPnt.y, cntPnt.z, oriQw[ownerA], oriQx[ownerA], oriQy[ownerA],
+                               oriQz[ownerA]);
+            s.pos = cntPnt + getOwnerPosFromHost(ownerA);
+        }
+        if (filter.NeedsVelocity()) {
+            // Relative velocity of the two owners' CoMs
+            s.vel = make_float3(vX[ownerA] - vX[ownerB], vY[ownerA] - vY[ownerB], vZ[ownerA] - vZ[ownerB]);
+        }
+        s.force = length(forcexyz);
+        return filter.Test(s);
+    };
+    return parallelSelectIndices(*(solverScratchSpace.numContacts), pred);
+}
+
 #ifdef DEME_USE_CHPF
 void DEMDynamicThread::writeSpheresAsChpf(std::ofstream& ptFile) {
     chpf::Writer pw;
@@ -1188,13 +1434,10 @@ void DEMDynamicThread::writeSpheresAsChpf(std::ofstream& ptFile) {
     }
     size_t num_output_spheres = 0;
 
-    for (size_t i = 0; i < simParams->nSpheresGM; i++) {
+    // Spheres in the no-output families or rejected by the output filter are excluded here
+    for (size_t i : selectSpheresForOutput()) {
         auto this_owner = ownerClumpBody[i];
         family_t this_family = familyID[this_owner];
-        // If this (impl-level) family is in the no-output list, skip it
-        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
-            continue;
-        }
 
         float3 CoM;
         float X, Y, Z;
@@ -1302,13 +1545,10 @@ void DEMDynamicThread::writeSpheresAsCsv(std::ofstream& ptFile) {
     outstrstream << "\n";
 
     // simParams host version should not be different from device version, so no need to update
-    for (size_t i = 0; i < simParams->nSpheresGM; i++) {
+    // Spheres in the no-output families or rejected by the output filter are excluded here
+    for (size_t i : selectSpheresForOutput()) {
         auto this_owner = ownerClumpBody[i];
         family_t this_family = familyID[this_owner];
-        // If this (impl-level) family is in the no-output list, skip it
-        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
-            continue;
-        }
 
         float3 CoM;
         float3 pos;
@@ -1425,13 +1665,8 @@ void DEMDynamicThread::writeClumpsAsChpf(std::ofstream& ptFile, unsigned int acc
     }
     size_t num_output_clumps = 0;
 
-    for (size_t i = 0; i < simParams->nOwnerBodies; i++) {
-        auto this_owner = ownerClumpBody[i];
-        family_t this_family = familyID[this_owner];
-        // If this (impl-level) family is in the no-output list, skip it
-        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
-            continue;
-        }
+    for (size_t i : selectClumpsForOutput()) {
+        family_t this_family = familyID[i];
 
         float3 CoM;
         float X, Y, Z;
@@ -1529,17 +1764,10 @@ void DEMDynamicThread::writeClumpsAsCsv(std::ofstream& ptFile, unsigned int accu
     }
     outstrstream << "\n";
 
-    // simParams host version should not be different from device version, so no need to update
-    for (size_t i = 0; i < simParams->nOwnerBodies; i++) {
-        // i is this owner's number. And if it is not a clump, we can move on.
-        if (ownerTypes[i] != OWNER_T_CLUMP)
-            continue;
-
+    // simParams host version should not be different from device version, so no need to update.
+    // Non-clump owners, clumps in the no-output families or rejected by the output filter are excluded here.
+    for (size_t i : selectClumpsForOutput()) {
         family_t this_family = familyID[i];
-        // If this (impl-level) family is in the no-output list, skip it
-        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
-            continue;
-        }
 
         float3 CoM;
         float X, Y, Z;
@@ -1615,13 +1843,62 @@ void DEMDynamicThread::writeClumpsAsCsv(std::ofstream& ptFile, unsigned int accu
     ptFile << outstrstream.str();
 }
 
-std::shared_ptr<ContactInfoContainer> DEMDynamicThread::generateContactInfo(float force_thres) {
+void DEMDynamicThread::writeClumpsAsQuantized(std::ofstream& ptFile) {
+    migrateFamilyToHost();
+    migrateClumpPosInfoToHost();
+    if (ownerOutputFilter.NeedsVelocity() || ownerOutputFilter.NeedsForce()) {
+        migrateClumpHighOrderInfoToHost();
+    }
+
+    QuantizedFrame frame;
+    frame.header.flags = QUANT_HAS_QUAT;
+    if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
+        frame.header.flags |= QUANT_HAS_FAMILY;
+    }
+    frame.header.nvXp2 = simParams->nvXp2;
+    frame.header.nvYp2 = simParams->nvYp2;
+    frame.header.nvZp2 = simParams->nvZp2;
+    frame.header.voxelSize = simParams->voxelSize;
+    frame.header.l = simParams->l;
+    frame.header.LBFX = simParams->LBFX;
+    frame.header.LBFY = simParams->LBFY;
+    frame.header.LBFZ = simParams->LBFZ;
+    frame.header.time = simParams->timeElapsed;
+    frame.Resize(simParams->nOwnerBodies);
+
+    // Raw voxel and sub-voxel integers are copied as they are, no conversion to floating-point numbers
+    size_t num_output_clumps = 0;
+    for (size_t i : selectClumpsForOutput()) {
+        family_t this_family = familyID[i];
+        frame.ownerIDs[num_output_clumps] = i;
+        frame.voxel[num_output_clumps] = voxelID[i];
+        frame.subX[num_output_clumps] = locX[i];
+        frame.subY[num_output_clumps] = locY[i];
+        frame.subZ[num_output_clumps] = locZ[i];
+        frame.oriQ[num_output_clumps] = make_float4(oriQx[i], oriQy[i], oriQz[i], oriQw[i]);
+        if (solverFlags.outputFlags & OUTPUT_CONTENT::FAMILY) {
+            frame.family[num_output_clumps] = this_family;
+        }
+        num_output_clumps++;
+    }
+    frame.Resize(num_output_clumps);
+
+    quantEncoder.Encode(frame, ptFile);
+}
+
+std::shared_ptr<ContactInfoContainer> DEMDynamicThread::generateContactInfo(float force_thres,
+                                                                            bool use_output_filter) {
     // Migrate contact info to host
     migrateFamilyToHost();
     migrateClumpPosInfoToHost();
     migrateContactInfoToHost();
+    if (use_output_filter && contactOutputFilter.NeedsVelocity()) {
+        migrateClumpHighOrderInfoToHost();
+    }
 
-    size_t total_contacts = *(solverScratchSpace.numContacts);
+    // Contacts that are too weak or rejected by the output filter are excluded here, before assembling the info
+    std::vector<size_t> output_contacts = selectContactsForOutput(force_thres, use_output_filter);
+    size_t total_contacts = output_contacts.size();
     // Wildcards supports only floats now
     std::vector<std::pair<std::string, std::string>> existing_wildcards(m_contact_wildcard_names.size());
     size_t name_i = 0;
@@ -1632,21 +1909,14 @@ std::shared_ptr<ContactInfoContainer> DEMDynamicThread::generateContactInfo(floa
     contactInfo.ResizeAll(total_contacts);
 
     size_t useful_cnt = 0;
-    for (size_t i = 0; i < total_contacts; i++) {
+    for (size_t i : output_contacts) {
         // Geos that are involved in this contact
         auto geoA = idGeometryA[i];
         auto geoB = idGeometryB[i];
         auto type = contactType[i];
-        // We don't output fake contacts; but right now, no contact will be marked fake by kT, so no need to check that
-        // if (type == NOT_A_CONTACT)
-        //     continue;
 
         float3 forcexyz = contactForces[i];
         float3 torque = contactTorque_convToForce[i];
-        // If this force+torque is too small, then it's not an active contact
-        if (length(forcexyz + torque) < force_thres) {
-            continue;
-        }
 
         // geoA's owner must be a sphere
         auto ownerA = ownerClumpBody[geoA];
@@ -1739,11 +2009,8 @@ std::shared_ptr<ContactInfoContainer> DEMDynamicThread::generateContactInfo(floa
 
         // Contact wildcards
         if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::CNT_WILDCARD) {
-            // The order shouldn't be an issue... the same set is being processed here and in equip_contact_wildcards,
-            // see Model.h
-            size_t name_i = 0;
             for (const auto& name : m_contact_wildcard_names) {
-                contactInfo.Get<float>(name)[useful_cnt] = (*contactWildcards[name_i++])[i];
+                contactInfo.Get<float>(name)[useful_cnt] = getContactWildcardOnHost(m_contact_wildcard_num.at(name), i);
             }
         }
 
@@ -1753,10 +2020,80 @@ std::shared_ptr<ContactInfoContainer> DEMDynamicThread::generateContactInfo(floa
     return std::make_shared<ContactInfoContainer>(std::move(contactInfo));
 }
 
+ContactNetworkSummary DEMDynamicThread::analyzeContactNetwork(const ContactNetworkOptions& opts, float force_thres) {
+    migrateClumpPosInfoToHost();
+    migrateContactInfoToHost();
+
+    // Clumps are the particles, numbered in owner order
+    std::vector<bodyID_t> particleOf(simParams->nOwnerBodies, NULL_BODYID);
+    size_t nParticles = 0;
+    for (bodyID_t i = 0; i < simParams->nOwnerBodies; i++) {
+        if (ownerTypes[i] & OWNER_T_CLUMP) {
+            particleOf[i] = nParticles++;
+        }
+    }
+
+    std::vector<size_t> cnts = selectContactsForOutput(force_thres, false);
+    const size_t n = cnts.size();
+    std::vector<bodyID_t> particleA(n), particleB(n);
+    std::vector<float> fX(n), fY(n), fZ(n), nX(n), nY(n), nZ(n);
+    hostParallelFor(
+        n,
+        [&](unsigned int chunk, size_t start, size_t end) {
+            for (size_t k = start; k < end; k++) {
+                const size_t i = cnts[k];
+                const bodyID_t geoA = idGeometryA[i];
+                const bodyID_t ownerA = ownerClumpBody[geoA];
+                const bodyID_t ownerB = getGeoOwnerID(idGeometryB[i], contactType[i]);
+                particleA[k] = particleOf[ownerA];
+                particleB[k] = (contactType[i] == SPHERE_SPHERE_CONTACT) ? particleOf[ownerB] : NULL_BODYID;
+                const float3 force = contactForces[i];
+                fX[k] = force.x;
+                fY[k] = force.y;
+                fZ[k] = force.z;
+                // The normal points from sphere A's center to the contact point, both in A's owner's frame
+                const size_t compOffset = (solverFlags.useClumpJitify) ? clumpComponentOffsetExt[geoA] : geoA;
+                float3 normal = contactPointGeometryA[i];
+                normal.x -= relPosSphereX[compOffset];
+                normal.y -= relPosSphereY[compOffset];
+                normal.z -= relPosSphereZ[compOffset];
+                applyOriQToVector3<float, oriQ_t>(normal.x, normal.y, normal.z, oriQw[ownerA], oriQx[ownerA],
+                                                  oriQy[ownerA], oriQz[ownerA]);
+                normal = normalize(normal);
+                nX[k] = normal.x;
+                nY[k] = normal.y;
+                nZ[k] = normal.z;
+            }
+        },
+        opts.n_threads);
+
+    ContactNetworkInput in;
+    in.nParticles = nParticles;
+    in.nContacts = n;
+    in.particleA = particleA.data();
+    in.particleB = particleB.data();
+    in.fX = fX.data();
+    in.fY = fY.data();
+    in.fZ = fZ.data();
+    in.nX = nX.data();
+    in.nY = nY.data();
+    in.nZ = nZ.data();
+    return AnalyzeContactNetwork(in, opts);
+}
+
+HostContactBatch DEMDynamicThread::getContactStates() {
+    HostContactBatch batch;
+    if (numContactStateDumpRows > 0) {
+        contactStateDump.toHost(0, numContactStateDumpRows * HOST_CONTACT_DUMP_WIDTH);
+        batch.appendDumpRows(contactStateDump.host(), numContactStateDumpRows);
+    }
+    return batch;
+}
+
 void DEMDynamicThread::writeContactsAsCsv(std::ofstream& ptFile, float force_thres) {
     std::ostringstream outstrstream;
 
-    std::shared_ptr<ContactInfoContainer> contactInfo = generateContactInfo(force_thres);
+    std::shared_ptr<ContactInfoContainer> contactInfo = generateContactInfo(force_thres, true);
 
     outstrstream << OUTPUT_FILE_CNT_TYPE_NAME;
     if (solverFlags.cntOutFlags & CNT_OUTPUT_CONTENT::OWNER) {
@@ -1929,16 +2266,48 @@ void DEMDynamicThread::writeMeshesAsVtk(std::ofstream& ptFile) {
     ptFile << ostream.str();
 }
 
+void DEMDynamicThread::writeMeshesIncremental(std::ofstream& ptFile) {
+    migrateFamilyToHost();
+
+    std::vector<float3> meshPos(m_meshes.size());
+    std::vector<float4> meshOriQ(m_meshes.size());
+    std::vector<notStupidBool_t> thisMeshSkip(m_meshes.size(), 0);
+    unsigned int mesh_num = 0;
+    for (const auto& mmesh : m_meshes) {
+        bodyID_t mowner = mmesh->owner;
+        family_t this_family = familyID[mowner];
+        // If this (impl-level) family is in the no-output list, skip it
+        if (familiesNoOutput.find(this_family) != familiesNoOutput.end()) {
+            thisMeshSkip[mesh_num] = 1;
+        }
+        meshPos[mesh_num] = this->getOwnerPos(mowner)[0];
+        meshOriQ[mesh_num] = this->getOwnerOriQ(mowner)[0];
+        mesh_num++;
+    }
+
+    // The encoder decides what actually needs to be written, comparing against the last frame it wrote
+    meshFrameEncoder.Encode(simParams->timeElapsed, m_meshes, meshPos, meshOriQ, thisMeshSkip, ptFile);
+}
+
 inline void DEMDynamicThread::contactEventArraysResize(size_t nContactPairs) {
-    DEME_DUAL_ARRAY_RESIZE(idGeometryA, nContactPairs, 0);
-    DEME_DUAL_ARRAY_RESIZE(idGeometryB, nContactPairs, 0);
-    DEME_DUAL_ARRAY_RESIZE(contactType, nContactPairs, NOT_A_CONTACT);
+    // Reallocated (not just resized), so they shrink too when the capacity manager says so
+    idGeometryA.reallocate(nContactPairs, 0);
+    idGeometryB.reallocate(nContactPairs, 0);
+    contactType.reallocate(nContactPairs, NOT_A_CONTACT);
 
     if (!solverFlags.useNoContactRecord) {
-        DEME_DUAL_ARRAY_RESIZE(contactForces, nContactPairs, make_float3(0));
-        DEME_DUAL_ARRAY_RESIZE(contactTorque_convToForce, nContactPairs, make_float3(0));
-        DEME_DUAL_ARRAY_RESIZE(contactPointGeometryA, nContactPairs, make_float3(0));
-        DEME_DUAL_ARRAY_RESIZE(contactPointGeometryB, nContactPairs, make_float3(0));
+        contactForces.reallocate(nContactPairs, make_float3(0));
+        contactTorque_convToForce.reallocate(nContactPairs, make_float3(0));
+        contactPointGeometryA.reallocate(nContactPairs, make_float3(0));
+        contactPointGeometryB.reallocate(nContactPairs, make_float3(0));
+    }
+    // The contact-indexed history goes with them, so it is never shorter than the contact arrays (or cut short
+    // before it is migrated; the capacity covers the previous contacts too)
+    for (unsigned int i = 0; i < contactWildcards.size(); i++) {
+        contactWildcards[i]->reallocate(nContactPairs, 0);
+    }
+    for (unsigned int i = 0; i < wildcardPoolIndex.size(); i++) {
+        wildcardPoolIndex[i]->reallocate(nContactPairs, NULL_MAPPING_PARTNER);
     }
 
     // Re-packing pointers now is automatic
@@ -1956,9 +2325,13 @@ inline void DEMDynamicThread::unpackMyBuffer() {
     DEME_GPU_CALL(
         cudaMemcpy(&(solverScratchSpace.numContacts), &nContactPairs_buffer, sizeof(size_t), cudaMemcpyDeviceToDevice));
     solverScratchSpace.numContacts.toHost();
-    // Need to resize those contact event-based arrays before usage
-    if (*solverScratchSpace.numContacts > idGeometryA.size() || *solverScratchSpace.numContacts > buffer_size) {
-        contactEventArraysResize(*solverScratchSpace.numContacts);
+    // Need to resize those contact event-based arrays before usage. The capacity manager grows them ahead of need,
+    // and shrinks them after a sustained drop; history is migrated from the previous contacts, so they count too.
+    const bool capacityChanged = contactCapacity.observe(
+        DEME_MAX(*solverScratchSpace.numContacts, *solverScratchSpace.numPrevContacts));
+    if (capacityChanged || *solverScratchSpace.numContacts > idGeometryA.size() ||
+        *solverScratchSpace.numContacts > buffer_size) {
+        contactEventArraysResize(DEME_MAX(contactCapacity.capacity(), *solverScratchSpace.numContacts));
     }
 
     DEME_GPU_CALL(cudaMemcpy(granData->idGeometryA, idGeometryA_buffer.data(),
@@ -2000,8 +2373,13 @@ inline void DEMDynamicThread::sendToTheirBuffer() {
     DEME_GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_absVel, pCycleMaxVel, simParams->nOwnerBodies * sizeof(float),
                              cudaMemcpyDeviceToDevice));
 
-    // Send simulation metrics for kT's reference.
-    DEME_GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_ts, &(simParams->h), sizeof(float), cudaMemcpyHostToDevice));
+    // Send simulation metrics for kT's reference. With a variable step size, kT is told the largest step that dT may
+    // take while it uses the contact pairs of this order (the displacement-triggered CD does not need it).
+    float ts_for_kT = simParams->h;
+    if (!solverFlags.isStepConst && !solverFlags.useDisplacementCD) {
+        ts_for_kT = tsController.RenewCeiling();
+    }
+    DEME_GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_ts, &ts_for_kT, sizeof(float), cudaMemcpyHostToDevice));
     // Note that perhapsIdealFutureDrift is non-negative, and it will be used to determine the margin size; however, if
     // scheduleHelper is instructed to have negative future drift then perhapsIdealFutureDrift no longer affects them.
     DEME_GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_maxDrift, perhapsIdealFutureDrift.getHostPointer(),
@@ -2027,6 +2405,16 @@ inline void DEMDynamicThread::sendToTheirBuffer() {
         kT->solverFlags.willMeshDeform = true;
     }
 
+    // In displacement-triggered CD, the owner states and the skin of this order are what the produced contact pairs
+    // will be trusted against
+    if (solverFlags.useDisplacementCD) {
+        recordOwnerCDSnapshot(cdOrderPos.data(), cdOrderOriQ.data(), &simParams, &granData, simParams->nOwnerBodies,
+                              streamInfo.stream);
+        cdOrderSkin = cdSkin;
+        cdOrderPending = true;
+        DEME_GPU_CALL(cudaMemcpy(granData->pKTOwnedBuffer_skin, &cdOrderSkin, sizeof(float), cudaMemcpyHostToDevice));
+    }
+
     // This subroutine also includes recording the time stamp of this batch ingredient dT sent to kT
     pSchedSupport->kinematicIngredProdDateStamp = (pSchedSupport->currentStampOfDynamic).load();
 }
@@ -2034,10 +2422,12 @@ inline void DEMDynamicThread::sendToTheirBuffer() {
 inline void DEMDynamicThread::migrateEnduringContacts() {
     // Use granData->contactMapping's information (stored in temp device vector) to map old and new contacts
 
+    // The temporary arrays are given back when this scope closes
+    auto scope = solverScratchSpace.openScope();
     // All contact wildcards are the same type, so we can just allocate one temp array for all of them
     float* newWildcards[DEME_MAX_WILDCARD_NUM];
     size_t wildcard_arr_bytes = (*solverScratchSpace.numContacts) * sizeof(float) * simParams->nContactWildcards;
-    newWildcards[0] = (float*)solverScratchSpace.allocateTempVector("newWildcards", wildcard_arr_bytes);
+    newWildcards[0] = (float*)solverScratchSpace.allocateTempVector(SCRATCH_NEW_WILDCARDS, wildcard_arr_bytes);
     for (unsigned int i = 1; i < simParams->nContactWildcards; i++) {
         newWildcards[i] = newWildcards[i - 1] + (*solverScratchSpace.numContacts);
     }
@@ -2046,7 +2436,7 @@ inline void DEMDynamicThread::migrateEnduringContacts() {
     // check if the user did not ask for it.
     size_t sentry_bytes = (*solverScratchSpace.numPrevContacts) * sizeof(notStupidBool_t);
     notStupidBool_t* contactSentry =
-        (notStupidBool_t*)solverScratchSpace.allocateTempVector("contactSentry", sentry_bytes);
+        (notStupidBool_t*)solverScratchSpace.allocateTempVector(SCRATCH_CONTACT_SENTRY, sentry_bytes);
 
     // A sentry array is here to see if there exist a contact that dT thinks it's alive but kT doesn't map it to the new
     // history array. This is just a quick and rough check: we only look at the last contact wildcard to see if it is
@@ -2130,16 +2520,112 @@ inline void DEMDynamicThread::migrateEnduringContacts() {
                                  (*solverScratchSpace.numContacts) * sizeof(float), cudaMemcpyDeviceToDevice));
     }
 
-    solverScratchSpace.finishUsingTempVector("newWildcards");
-    solverScratchSpace.finishUsingTempVector("contactSentry");
-
     // granData may have changed in some of the earlier steps
     granData.toDevice();
 }
 
+inline void DEMDynamicThread::migrateWildcardPools() {
+    const size_t nContacts = *solverScratchSpace.numContacts;
+    auto scope = solverScratchSpace.openScope();
+    notStupidBool_t* inScope = (notStupidBool_t*)solverScratchSpace.allocateTempVector(
+        SCRATCH_WILDCARD_POOL_SCOPE, nContacts * sizeof(notStupidBool_t));
+    contactPairs_t* newRecord = (contactPairs_t*)solverScratchSpace.allocateTempVector(
+        SCRATCH_WILDCARD_POOL_NEW_RECORD, nContacts * sizeof(contactPairs_t));
+    size_t blocks_needed = (nContacts + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+
+    for (unsigned int i = 0; i < wildcardPools.size(); i++) {
+        const ContactWildcardPool& pool = wildcardPools[i];
+        const size_t record_bytes = WildcardPoolRecordBytes(pool);
+        size_t nRecords = 0;
+        if (nContacts > 0) {
+            // The contacts in scope get records, numbered in contact order
+            notStupidBool_t* familyPairs = wildcardPoolFamilyPairs[i] ? wildcardPoolFamilyPairs[i]->data() : nullptr;
+            prep_force_kernels->kernel("markWildcardPoolScope")
+                .instantiate()
+                .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(&granData, inScope, pool.typeMask, familyPairs, nContacts);
+            DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+            cubPrefixScan<notStupidBool_t, contactPairs_t>(inScope, newRecord, nContacts, streamInfo.stream,
+                                                           solverScratchSpace);
+            contactPairs_t last_record;
+            notStupidBool_t last_in_scope;
+            DEME_GPU_CALL(cudaMemcpyAsync(&last_record, newRecord + nContacts - 1, sizeof(contactPairs_t),
+                                          cudaMemcpyDeviceToHost, streamInfo.stream));
+            DEME_GPU_CALL(cudaMemcpyAsync(&last_in_scope, inScope + nContacts - 1, sizeof(notStupidBool_t),
+                                          cudaMemcpyDeviceToHost, streamInfo.stream));
+            DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+            nRecords = (size_t)last_record + last_in_scope;
+        }
+
+        // Move the live records into new arrays, then copy them back (after resizing the pool's arrays); they are
+        // given back at the end of each pool
+        auto pool_scope = solverScratchSpace.openScope();
+        contactPairs_t* newIndex = (contactPairs_t*)solverScratchSpace.allocateTempVector(
+            SCRATCH_WILDCARD_POOL_NEW_INDEX, nContacts * sizeof(contactPairs_t));
+        uint8_t* newData = (uint8_t*)solverScratchSpace.allocateTempVector(SCRATCH_WILDCARD_POOL_NEW_DATA,
+                                                                           DEME_MAX(nRecords, 1) * record_bytes);
+        if (nContacts > 0) {
+            // All fields are 2 or 4 bytes, so a record is moved in 2-byte units
+            prep_force_kernels->kernel("remapWildcardPoolRecords")
+                .instantiate()
+                .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(&granData, inScope, newRecord, granData->wildcardPoolIndex[i],
+                        (unsigned short*)granData->wildcardPoolData[i], newIndex, (unsigned short*)newData,
+                        (unsigned int)(record_bytes / sizeof(unsigned short)), nContacts);
+            DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+        }
+        if (nContacts > wildcardPoolIndex[i]->size()) {
+            DEME_DUAL_ARRAY_RESIZE((*wildcardPoolIndex[i]), nContacts, NULL_MAPPING_PARTNER);
+        }
+        if (nRecords * record_bytes > wildcardPoolData[i]->size()) {
+            DEME_DUAL_ARRAY_RESIZE((*wildcardPoolData[i]), nRecords * record_bytes, 0);
+        }
+        // On dT's stream, so kT's work is not held up by a copy on the default stream
+        DEME_GPU_CALL(cudaMemcpyAsync(granData->wildcardPoolIndex[i], newIndex, nContacts * sizeof(contactPairs_t),
+                                      cudaMemcpyDeviceToDevice, streamInfo.stream));
+        DEME_GPU_CALL(cudaMemcpyAsync(granData->wildcardPoolData[i], newData, nRecords * record_bytes,
+                                      cudaMemcpyDeviceToDevice, streamInfo.stream));
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+        wildcardPoolNumRecords[i] = nRecords;
+    }
+    DEME_STEP_DEBUG_PRINTF("Contact wildcard pools have %zu records in total for %zu contacts.",
+                           std::accumulate(wildcardPoolNumRecords.begin(), wildcardPoolNumRecords.end(), (size_t)0),
+                           nContacts);
+
+    // The pools' arrays may have been reallocated
+    granData.toDevice();
+}
+
+inline void DEMDynamicThread::planForceSegments(size_t nContactPairs) {
+    static_assert(SPHERE_CONE_CONTACT < NUM_CONTACT_TYPE_SLOTS, "Contact types must fit in the force segment slots.");
+    forceSegmentsStale = false;
+    forceSegmentsUsable = false;
+    if (!solverFlags.should_sort_pairs || nContactPairs == 0)
+        return;
+    for (unsigned int i = 0; i < NUM_CONTACT_TYPE_SLOTS + 2; i++) {
+        contactTypeSegBounds[i] = 0;
+    }
+    contactTypeSegBounds.toDevice();
+    size_t blocks_needed = (nContactPairs + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    prep_force_kernels->kernel("findContactTypeSegments")
+        .instantiate()
+        .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+        .launch(&granData, contactTypeSegBounds.device(), NUM_CONTACT_TYPE_SLOTS, nContactPairs);
+    DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    contactTypeSegBounds.toHost();
+    if (contactTypeSegBounds[NUM_CONTACT_TYPE_SLOTS + 1] != 0) {
+        DEME_STEP_DEBUG_PRINTF("Contact pairs are not sorted by type; the generic force kernel is used.");
+        return;
+    }
+    forceSegmentsUsable = PlanForceSegments(contactTypeSegBounds.host(), nContactPairs, forceSegmentTypeMask,
+                                            solverFlags.forceSegmentFuseSize, forceSegmentPlan);
+}
+
 inline void DEMDynamicThread::calculateForces() {
     // Reset force (acceleration) arrays for this time step
     size_t nContactPairs = *solverScratchSpace.numContacts;
+    // Probe results of the last force calculation are stale after this
+    forceCalcCounter++;
 
     timers.GetTimer("Clear force array").start();
     {
@@ -2172,11 +2658,39 @@ inline void DEMDynamicThread::calculateForces() {
     // or other sources.
     if (blocks_needed_for_contacts > 0) {
         timers.GetTimer("Calculate contact forces").start();
-        // a custom kernel to compute forces
-        cal_force_kernels->kernel("calculateContactForces")
-            .instantiate()
-            .configure(dim3(blocks_needed_for_contacts), dim3(DT_FORCE_CALC_NTHREADS_PER_BLOCK), 0, streamInfo.stream)
-            .launch(&simParams, &granData, nContactPairs);
+        if (solverFlags.dumpContactStates) {
+            // The rows of pairs that this pass skips or finds not in contact stay 0, which leaves them out of the dump
+            const size_t dumpLen = nContactPairs * HOST_CONTACT_DUMP_WIDTH;
+            if (contactStateDump.size() < dumpLen) {
+                DEME_DUAL_ARRAY_RESIZE(contactStateDump, dumpLen, 0);
+                granData.toDevice();
+            }
+            DEME_GPU_CALL(
+                cudaMemsetAsync(contactStateDump.device(), 0, dumpLen * sizeof(float), streamInfo.stream));
+            numContactStateDumpRows = nContactPairs;
+        }
+        if (solverFlags.useSegmentedForce && forceSegmentsStale) {
+            planForceSegments(nContactPairs);
+        }
+        if (solverFlags.useSegmentedForce && forceSegmentsUsable) {
+            // One kernel specialized for the contact types of each segment (or group of small segments)
+            for (const auto& seg : forceSegmentPlan) {
+                size_t blocks_needed_for_seg =
+                    (seg.count + DT_FORCE_CALC_NTHREADS_PER_BLOCK - 1) / DT_FORCE_CALC_NTHREADS_PER_BLOCK;
+                cal_force_kernels->kernel(ForceSegmentKernelName(seg.kernelMask))
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_seg), dim3(DT_FORCE_CALC_NTHREADS_PER_BLOCK), 0,
+                               streamInfo.stream)
+                    .launch(&simParams, &granData, (contactPairs_t)seg.start, seg.count);
+            }
+        } else {
+            // a custom kernel to compute forces
+            cal_force_kernels->kernel("calculateContactForces")
+                .instantiate()
+                .configure(dim3(blocks_needed_for_contacts), dim3(DT_FORCE_CALC_NTHREADS_PER_BLOCK), 0,
+                           streamInfo.stream)
+                .launch(&simParams, &granData, nContactPairs);
+        }
         DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
         // displayDeviceFloat3(granData->contactForces, nContactPairs);
         // displayDeviceArray<contact_t>(granData->contactType, nContactPairs);
@@ -2217,6 +2731,242 @@ inline void DEMDynamicThread::integrateOwnerMotions() {
     DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
 }
 
+inline void DEMDynamicThread::setMultiRatePass(notStupidBool_t pass, float h, double t) {
+    simParams->multiRatePass = pass;
+    simParams->h = h;
+    simParams->timeElapsed = t;
+    simParams.toDevice();
+}
+
+inline void DEMDynamicThread::advanceMultiRateStep() {
+    const unsigned int n_sub = solverFlags.nSubSteps;
+    const float coarse_h = simParams->h;
+    const float fine_h = coarse_h / (float)n_sub;
+    const double t_start = simParams->timeElapsed;
+    const size_t nContactPairs = *solverScratchSpace.numContacts;
+    const size_t nOwners = simParams->nOwnerBodies;
+
+    // Families can change on device, so the contacts are classified at each step
+    notStupidBool_t* rateClass = (notStupidBool_t*)solverScratchSpace.allocateTempVector(
+        "contactRateClass", std::max(nContactPairs, (size_t)1) * sizeof(notStupidBool_t));
+    if (granData->contactRateClass != rateClass) {
+        granData->contactRateClass = rateClass;
+        granData.toDevice();
+    }
+    if (nContactPairs > 0) {
+        size_t blocks_needed_for_contacts =
+            (nContactPairs + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+        prep_force_kernels->kernel("markContactRateClasses")
+            .instantiate()
+            .configure(dim3(blocks_needed_for_contacts), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(&simParams, &granData, solverFlags.subStepMeshContacts, nContactPairs);
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    }
+    float* slowAcc = (float*)solverScratchSpace.allocateTempVector("slowAcc", 6 * nOwners * sizeof(float));
+    size_t blocks_needed_for_owners = (nOwners + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
+
+    // The slow contacts, evaluated at the start of the step. Their history (if any) evolves by the whole step. The slow
+    // pass clears all contact forces, so the fast contacts, not computed yet, do not enter this acceleration.
+    setMultiRatePass(MULTI_RATE_SLOW, coarse_h, t_start);
+    calculateForces();
+    integrator_kernels->kernel("stashSlowAcc")
+        .instantiate()
+        .configure(dim3(blocks_needed_for_owners), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, streamInfo.stream)
+        .launch(&simParams, &granData, slowAcc);
+    DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    // The contact pairs do not change within this step, so the force collection need not prepare them again
+    contactPairArr_isFresh = false;
+
+    // If the forces are collected from the contact force array, the slow contacts (whose forces are kept there so they
+    // can be output) are collected in each fast pass as well, and that is taken out
+    const float slow_in_collect = solverFlags.useForceCollectInPlace ? 0.f : 1.f;
+    for (unsigned int i = 0; i < n_sub; i++) {
+        setMultiRatePass(MULTI_RATE_FAST, fine_h, t_start + (double)i * fine_h);
+        calculateForces();
+        // The slow contacts' impulse goes into the first sub-step
+        float factor = (i == 0) ? (float)n_sub - slow_in_collect : -slow_in_collect;
+        if (factor != 0.f) {
+            integrator_kernels->kernel("addSlowAcc")
+                .instantiate()
+                .configure(dim3(blocks_needed_for_owners), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, streamInfo.stream)
+                .launch(&simParams, &granData, slowAcc, factor);
+            DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+        }
+        if (i == 0) {
+            routineChecks();
+        }
+
+        timers.GetTimer("Integration").start();
+        integrateOwnerMotions();
+        timers.GetTimer("Integration").stop();
+    }
+
+    // The step as a whole is accounted for by the caller
+    setMultiRatePass(MULTI_RATE_ALL, coarse_h, t_start);
+    solverScratchSpace.finishUsingTempVector("slowAcc");
+    solverScratchSpace.finishUsingTempVector("contactRateClass");
+}
+
+inline void DEMDynamicThread::wakeSleepingIslands() {
+    size_t nContactPairs = *solverScratchSpace.numContacts;
+    if (nContactPairs > 0) {
+        size_t blocks_needed_for_contacts =
+            (nContactPairs + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+        prep_force_kernels->kernel("wakeIslandsByContact")
+            .instantiate()
+            .configure(dim3(blocks_needed_for_contacts), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(&simParams, &granData, nContactPairs);
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    }
+    size_t blocks_needed_for_owners =
+        (simParams->nOwnerBodies + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    prep_force_kernels->kernel("wakeSleepingOwners")
+        .instantiate()
+        .configure(dim3(blocks_needed_for_owners), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+        .launch(&simParams, &granData);
+    DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+}
+
+inline void DEMDynamicThread::accumulateQuietSteps() {
+    const size_t nContactPairs = *solverScratchSpace.numContacts;
+    size_t blocks_needed_for_owners =
+        (simParams->nOwnerBodies + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    prep_force_kernels->kernel("accumulateQuietSteps")
+        .instantiate()
+        .configure(dim3(blocks_needed_for_owners), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+        .launch(&simParams, &granData, (float)sleepManager.GetKEThreshold(), sleepManager.GetSleepSteps());
+    if (nContactPairs > 0) {
+        size_t blocks_needed_for_contacts =
+            (nContactPairs + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+        prep_force_kernels->kernel("resetQuietStepsByContact")
+            .instantiate()
+            .configure(dim3(blocks_needed_for_contacts), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(&simParams, &granData, (float)sleepManager.GetRateThreshold(), nContactPairs);
+    }
+    DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+}
+
+void DEMDynamicThread::updateSleepingIslands() {
+    static_assert(SleepIslandManager::AWAKE_ISLAND == NULL_BODYID &&
+                      SleepIslandManager::STATIC_ISLAND == STATIC_SLEEP_ISLAND,
+                  "Sleeping island marks of the host and the device must agree.");
+    static_assert((notStupidBool_t)SLEEP_ROLE::REGULAR == SLEEP_ROLE_REGULAR &&
+                      (notStupidBool_t)SLEEP_ROLE::STATIC == SLEEP_ROLE_STATIC &&
+                      (notStupidBool_t)SLEEP_ROLE::ACTIVE == SLEEP_ROLE_ACTIVE,
+                  "Sleeping roles of the host and the device must agree.");
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nContactPairs = *solverScratchSpace.numContacts;
+
+    // List the candidates (awake regular owners quiet for long enough) on device, marking the static owners on the way
+    auto scope = solverScratchSpace.openScope();
+    notStupidBool_t* isCandidate = (notStupidBool_t*)solverScratchSpace.allocateTempVector(
+        SCRATCH_SLEEP_IS_CANDIDATE, nOwners * sizeof(notStupidBool_t));
+    solverScratchSpace.allocateDualArray("sleepCandidates", nOwners * sizeof(bodyID_t));
+    bodyID_t* d_candidates = (bodyID_t*)solverScratchSpace.getDualArrayDevice("sleepCandidates");
+    solverScratchSpace.allocateDualStruct("nSleepCandidates");
+    solverScratchSpace.allocateDualStruct("nSleepMarked");
+    *solverScratchSpace.getDualStructHost("nSleepCandidates") = 0;
+    *solverScratchSpace.getDualStructHost("nSleepMarked") = 0;
+    solverScratchSpace.syncDualStructHostToDevice("nSleepCandidates");
+    solverScratchSpace.syncDualStructHostToDevice("nSleepMarked");
+    size_t blocks_needed_for_owners = (nOwners + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    prep_force_kernels->kernel("flagSleepCandidates")
+        .instantiate()
+        .configure(dim3(blocks_needed_for_owners), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+        .launch(&simParams, &granData, sleepManager.GetSleepSteps(), isCandidate, d_candidates,
+                solverScratchSpace.getDualStructDevice("nSleepCandidates"),
+                solverScratchSpace.getDualStructDevice("nSleepMarked"));
+    DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    solverScratchSpace.syncDualStructDeviceToHost("nSleepCandidates");
+    solverScratchSpace.syncDualStructDeviceToHost("nSleepMarked");
+    const size_t nCandidates = *solverScratchSpace.getDualStructHost("nSleepCandidates");
+    size_t nMarked = *solverScratchSpace.getDualStructHost("nSleepMarked");
+
+    size_t nNewlyAsleep = 0, nIslands = 0;
+    if (nCandidates > 0) {
+        // The owner pairs of the contacts touching a candidate; they can be at most all the contacts
+        solverScratchSpace.allocateDualArray("sleepPairA", nContactPairs * sizeof(bodyID_t));
+        solverScratchSpace.allocateDualArray("sleepPairB", nContactPairs * sizeof(bodyID_t));
+        solverScratchSpace.allocateDualStruct("nSleepPairs");
+        *solverScratchSpace.getDualStructHost("nSleepPairs") = 0;
+        solverScratchSpace.syncDualStructHostToDevice("nSleepPairs");
+        if (nContactPairs > 0) {
+            size_t blocks_needed_for_contacts =
+                (nContactPairs + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+            prep_force_kernels->kernel("collectSleepCandidatePairs")
+                .instantiate()
+                .configure(dim3(blocks_needed_for_contacts), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(&simParams, &granData, isCandidate,
+                        (bodyID_t*)solverScratchSpace.getDualArrayDevice("sleepPairA"),
+                        (bodyID_t*)solverScratchSpace.getDualArrayDevice("sleepPairB"),
+                        solverScratchSpace.getDualStructDevice("nSleepPairs"), nContactPairs);
+            DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+            solverScratchSpace.syncDualStructDeviceToHost("nSleepPairs");
+        }
+        const size_t nPairs = *solverScratchSpace.getDualStructHost("nSleepPairs");
+
+        // Only the candidates and their pairs come to the host, to be grouped into islands
+        SleepCandidates cand;
+        solverScratchSpace.syncDualArrayDeviceToHost("sleepCandidates", 0, nCandidates * sizeof(bodyID_t));
+        const bodyID_t* h_candidates = (bodyID_t*)solverScratchSpace.getDualArrayHost("sleepCandidates");
+        cand.owners.assign(h_candidates, h_candidates + nCandidates);
+        if (nPairs > 0) {
+            solverScratchSpace.syncDualArrayDeviceToHost("sleepPairA", 0, nPairs * sizeof(bodyID_t));
+            solverScratchSpace.syncDualArrayDeviceToHost("sleepPairB", 0, nPairs * sizeof(bodyID_t));
+            const bodyID_t* h_pairA = (bodyID_t*)solverScratchSpace.getDualArrayHost("sleepPairA");
+            const bodyID_t* h_pairB = (bodyID_t*)solverScratchSpace.getDualArrayHost("sleepPairB");
+            cand.pairA.assign(h_pairA, h_pairA + nPairs);
+            cand.pairB.assign(h_pairB, h_pairB + nPairs);
+        }
+        std::vector<bodyID_t> islands;
+        nIslands = sleepManager.FormIslands(cand, islands);
+
+        // Put the islands that can sleep to sleep: their owners stop moving
+        if (nIslands > 0) {
+            solverScratchSpace.allocateDualArray("sleepCandidateIslands", nCandidates * sizeof(bodyID_t));
+            bodyID_t* h_islands = (bodyID_t*)solverScratchSpace.getDualArrayHost("sleepCandidateIslands");
+            for (size_t k = 0; k < nCandidates; k++) {
+                h_islands[k] = islands[k];
+                if (islands[k] != NULL_BODYID)
+                    nNewlyAsleep++;
+            }
+            solverScratchSpace.syncDualArrayHostToDevice("sleepCandidateIslands", 0, nCandidates * sizeof(bodyID_t));
+            size_t blocks_needed_for_candidates =
+                (nCandidates + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+            prep_force_kernels->kernel("putOwnersToSleep")
+                .instantiate()
+                .configure(dim3(blocks_needed_for_candidates), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(&simParams, &granData, d_candidates,
+                        (bodyID_t*)solverScratchSpace.getDualArrayDevice("sleepCandidateIslands"), nCandidates);
+            DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+            solverScratchSpace.finishUsingDualArray("sleepCandidateIslands");
+            nMarked += nNewlyAsleep;
+        }
+        solverScratchSpace.finishUsingDualArray("sleepPairA");
+        solverScratchSpace.finishUsingDualArray("sleepPairB");
+        solverScratchSpace.finishUsingDualStruct("nSleepPairs");
+    }
+    solverScratchSpace.finishUsingDualArray("sleepCandidates");
+    solverScratchSpace.finishUsingDualStruct("nSleepCandidates");
+    solverScratchSpace.finishUsingDualStruct("nSleepMarked");
+
+    hasSleepMarks = (nMarked > 0);
+    DEME_STEP_METRIC("Island sleeping: %zu candidates, %zu owners fell asleep in %zu new islands", nCandidates,
+                     nNewlyAsleep, nIslands);
+}
+
+size_t DEMDynamicThread::getNumSleepingOwners() {
+    if (!solverFlags.useSleeping)
+        return 0;
+    ownerSleepIsland.toHost();
+    size_t count = 0;
+    for (size_t i = 0; i < simParams->nOwnerBodies; i++) {
+        if (ownerSleepIsland[i] != NULL_BODYID && ownerSleepIsland[i] != STATIC_SLEEP_ISLAND)
+            count++;
+    }
+    return count;
+}
+
 inline void DEMDynamicThread::routineChecks() {
     if (solverFlags.canFamilyChangeOnDevice) {
         size_t blocks_needed_for_clumps =
@@ -2233,13 +2983,107 @@ inline float* DEMDynamicThread::determineSysVel() {
     return approxMaxVelFunc->dT_GetValue();
 }
 
+inline float DEMDynamicThread::measureStepMaxVel() {
+    float* absv = determineSysVel();
+    cubMaxReduce<float>(absv, &stepMaxVel, simParams->nOwnerBodies, streamInfo.stream, solverScratchSpace);
+    stepMaxVel.toHost();
+    stepMaxVelKnown = true;
+    return *stepMaxVel;
+}
+
+std::vector<std::pair<void*, size_t>> DEMDynamicThread::stepStateArrays() {
+    size_t n = simParams->nOwnerBodies;
+    std::vector<std::pair<void*, size_t>> arrs = {
+        {granData->voxelID, n * sizeof(voxelID_t)}, {granData->locX, n * sizeof(subVoxelPos_t)},
+        {granData->locY, n * sizeof(subVoxelPos_t)}, {granData->locZ, n * sizeof(subVoxelPos_t)},
+        {granData->oriQw, n * sizeof(oriQ_t)},       {granData->oriQx, n * sizeof(oriQ_t)},
+        {granData->oriQy, n * sizeof(oriQ_t)},       {granData->oriQz, n * sizeof(oriQ_t)},
+        {granData->vX, n * sizeof(float)},           {granData->vY, n * sizeof(float)},
+        {granData->vZ, n * sizeof(float)},           {granData->omgBarX, n * sizeof(float)},
+        {granData->omgBarY, n * sizeof(float)},      {granData->omgBarZ, n * sizeof(float)}};
+    if (solverFlags.canFamilyChangeOnDevice) {
+        arrs.push_back({granData->familyID, n * sizeof(family_t)});
+    }
+    // The force model may change any of the wildcards
+    for (unsigned int i = 0; i < simParams->nContactWildcards; i++) {
+        arrs.push_back({granData->contactWildcards[i], (*solverScratchSpace.numContacts) * sizeof(float)});
+    }
+    for (unsigned int i = 0; i < wildcardPools.size(); i++) {
+        arrs.push_back(
+            {granData->wildcardPoolData[i], wildcardPoolNumRecords[i] * WildcardPoolRecordBytes(wildcardPools[i])});
+    }
+    for (unsigned int i = 0; i < simParams->nOwnerWildcards; i++) {
+        arrs.push_back({granData->ownerWildcards[i], n * sizeof(float)});
+    }
+    for (unsigned int i = 0; i < simParams->nGeoWildcards; i++) {
+        arrs.push_back({granData->sphereWildcards[i], simParams->nSpheresGM * sizeof(float)});
+        arrs.push_back({granData->analWildcards[i], simParams->nAnalGM * sizeof(float)});
+        arrs.push_back({granData->triWildcards[i], simParams->nTriGM * sizeof(float)});
+    }
+    return arrs;
+}
+
+inline void DEMDynamicThread::beginVariableStep(double remaining) {
+    if (!stepMaxVelKnown) {
+        measureStepMaxVel();
+    }
+    simParams->h = tsController.ProposeWithin(*stepMaxVel, remaining);
+    simParams.toDevice();
+    if (solverFlags.stepSizeStrat == VAR_TS_STRAT::INT_GAP) {
+        auto arrs = stepStateArrays();
+        stepUndoOffsets.resize(arrs.size());
+        size_t total_bytes = 0;
+        for (size_t i = 0; i < arrs.size(); i++) {
+            stepUndoOffsets[i] = total_bytes;
+            // Keep each saved array aligned
+            total_bytes += (arrs[i].second + 255) / 256 * 256;
+        }
+        // Grow with some headroom, as the contact arrays grow a bit at a time
+        if (stepUndoBuffer.size() < total_bytes) {
+            stepUndoBuffer.resize(total_bytes + total_bytes / 4);
+        }
+        for (size_t i = 0; i < arrs.size(); i++) {
+            if (arrs[i].second == 0)
+                continue;
+            DEME_GPU_CALL(cudaMemcpyAsync(stepUndoBuffer.data() + stepUndoOffsets[i], arrs[i].first, arrs[i].second,
+                                          cudaMemcpyDeviceToDevice, streamInfo.stream));
+        }
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    }
+}
+
+inline bool DEMDynamicThread::finishVariableStep() {
+    bool accepted = tsController.Accept(simParams->h, measureStepMaxVel());
+    if (!accepted && solverFlags.stepSizeStrat == VAR_TS_STRAT::INT_GAP) {
+        auto arrs = stepStateArrays();
+        for (size_t i = 0; i < arrs.size(); i++) {
+            if (arrs[i].second == 0)
+                continue;
+            DEME_GPU_CALL(cudaMemcpyAsync(arrs[i].first, stepUndoBuffer.data() + stepUndoOffsets[i], arrs[i].second,
+                                          cudaMemcpyDeviceToDevice, streamInfo.stream));
+        }
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    }
+    if (!accepted) {
+        DEME_STEP_DEBUG_PRINTF("Step of size %.7g at time %.9g is rejected, as the max velocity became %.7g",
+                               simParams->h, simParams->timeElapsed, *stepMaxVel);
+        // The velocity of the restored state is what the retry starts from
+        measureStepMaxVel();
+    }
+    return accepted;
+}
+
 inline void DEMDynamicThread::unpack_impl() {
+    if (solverFlags.useDisplacementCD) {
+        promoteCDOrderSnapshot();
+    }
     {
         // Acquire lock and use the content of the dynamic-owned transfer buffer
         std::lock_guard<std::mutex> lock(pSchedSupport->dynamicOwnedBuffer_AccessCoordination);
         unpackMyBuffer();
         // Leave myself a mental note that I just obtained new produce from kT
         contactPairArr_isFresh = true;
+        forceSegmentsStale = true;
         // pSchedSupport->schedulingStats.nDynamicReceives++;
     }
     // dT got the produce, now mark its buffer to be no longer fresh.
@@ -2254,7 +3098,12 @@ inline void DEMDynamicThread::unpack_impl() {
     // If this is a history-based run, then when contacts are received, we need to migrate the contact
     // history info, to match the structure of the new contact array
     if (!solverFlags.isHistoryless) {
-        migrateEnduringContacts();
+        if (simParams->nContactWildcards > 0) {
+            migrateEnduringContacts();
+        }
+        if (wildcardPools.size() > 0) {
+            migrateWildcardPools();
+        }
     }
 
     // With unpacking finished, contactMapping temp array is no longer needed
@@ -2271,7 +3120,14 @@ inline void DEMDynamicThread::calibrateParams() {
     // Unpacking is done; now we can use temp arrays again to derive max velocity and send to kT
     pCycleMaxVel = determineSysVel();
 
-    if (solverFlags.autoUpdateFreq) {
+    if (solverFlags.useDisplacementCD) {
+        // The step-count drift does not decide anything in this mode; the skin is what is tuned
+        float new_skin;
+        if (solverFlags.autoTuneCDSkin && cdSkinTuner.Query(cdSkin, new_skin)) {
+            DEME_DEBUG_PRINTF("CD skin changes from %.7g to %.7g", cdSkin, new_skin);
+            cdSkin = new_skin;
+        }
+    } else if (solverFlags.autoUpdateFreq) {
         unsigned int comfortable_drift;
         if (accumStepUpdater.Query(comfortable_drift)) {
             // If perhapsIdealFutureDrift needs to increase, then the following value much = perhapsIdealFutureDrift.
@@ -2292,26 +3148,102 @@ inline void DEMDynamicThread::calibrateParams() {
     // Actually, perhapsIdealFutureDrift seems to have no need to be on device... but I made it a DualStruct anyway
 }
 
+inline void DEMDynamicThread::sendNewOrder() {
+    timers.GetTimer("Send to kT buffer").start();
+    // Acquire lock and refresh the work order for the kinematic
+    {
+        calibrateParams();
+        std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
+        sendToTheirBuffer();
+    }
+    pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh = true;
+    pSchedSupport->schedulingStats.nKinematicUpdates++;
+    accumStepUpdater.AddUpdate();
+
+    timers.GetTimer("Send to kT buffer").stop();
+    // Signal the kinematic that it has data for a new work order
+    pSchedSupport->cv_KinematicCanProceed.notify_all();
+}
+
 inline void DEMDynamicThread::ifProduceFreshThenUseItAndSendNewOrder() {
     if (pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
         timers.GetTimer("Unpack updates from kT").start();
         unpack_impl();
         timers.GetTimer("Unpack updates from kT").stop();
 
-        timers.GetTimer("Send to kT buffer").start();
-        // Acquire lock and refresh the work order for the kinematic
+        sendNewOrder();
+    }
+}
+
+inline float DEMDynamicThread::computeMaxCDDisplacement() {
+    size_t n = simParams->nOwnerBodies;
+    auto scope = solverScratchSpace.openScope();
+    float* ownerDisp = (float*)solverScratchSpace.allocateTempVector(SCRATCH_CD_OWNER_DISP, n * sizeof(float));
+    computeOwnerCDDisplacement(ownerDisp, cdRefPos.data(), cdRefOriQ.data(), ownerBoundRadius.data(),
+                               ownerSymAxis.data(), &simParams, &granData, n, streamInfo.stream);
+    cubMaxReduce<float>(ownerDisp, &maxCDDisp, n, streamInfo.stream, solverScratchSpace);
+    maxCDDisp.toHost();
+    return *maxCDDisp;
+}
+
+inline void DEMDynamicThread::promoteCDOrderSnapshot() {
+    double force_time = timers.GetTimer("Calculate contact forces").GetTimeSeconds();
+    // Before the outgoing contact pairs are replaced, let the tuner know how they did. Their forces are from the last
+    // force calculation, so we can tell how many of them were actually in contact.
+    if (solverFlags.autoTuneCDSkin && !solverFlags.useNoContactRecord && cdStepsSinceRef > 0) {
+        size_t n_pairs = *solverScratchSpace.numContacts;
+        countForceBearingContacts(&numForceBearingContacts, &granData, n_pairs, streamInfo.stream);
+        numForceBearingContacts.toHost();
+        cdSkinTuner.AddCycle(cdStepsSinceRef, force_time - cdRefForceTime, kT->lastCDTime.load(), n_pairs,
+                             *numForceBearingContacts, *maxCDDisp);
+    }
+
+    size_t n = simParams->nOwnerBodies;
+    DEME_GPU_CALL(cudaMemcpy(cdRefPos.data(), cdOrderPos.data(), n * sizeof(double3), cudaMemcpyDeviceToDevice));
+    DEME_GPU_CALL(cudaMemcpy(cdRefOriQ.data(), cdOrderOriQ.data(), n * sizeof(float4), cudaMemcpyDeviceToDevice));
+    cdRefSkin = cdOrderSkin;
+    cdOrderPending = false;
+    cdStepsSinceRef = 0;
+    cdRefForceTime = force_time;
+}
+
+inline void DEMDynamicThread::advanceDisplacementTriggeredCD() {
+    if (pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
+        timers.GetTimer("Unpack updates from kT").start();
+        unpack_impl();
+        timers.GetTimer("Unpack updates from kT").stop();
+    }
+
+    float disp = computeMaxCDDisplacement();
+    // Order a new CD early enough that kT can deliver it before the skin is used up. The step cap makes sure that
+    // things that do not move geometries (such as family changes) are still picked up.
+    unsigned int max_steps = std::max(1u, solverFlags.upperBoundFutureDrift / 2);
+    if (!cdOrderPending && (disp >= CD_SKIN_ORDER_RATIO * cdRefSkin || cdStepsSinceRef >= max_steps ||
+                            solverFlags.willMeshDeform)) {
+        sendNewOrder();
+    }
+
+    // Past the full skin (or with a deformed mesh), the contact pairs in use may miss contacts, so dT must not step
+    // until it has pairs it can trust. Positions do not change while dT waits, so this takes at most two rounds.
+    while (disp >= cdRefSkin || solverFlags.willMeshDeform) {
+        if (!cdOrderPending) {
+            sendNewOrder();
+        }
+        timers.GetTimer("Wait for kT update").start();
         {
-            calibrateParams();
-            std::lock_guard<std::mutex> lock(pSchedSupport->kinematicOwnedBuffer_AccessCoordination);
-            sendToTheirBuffer();
+            std::unique_lock<std::mutex> lock(pSchedSupport->dynamicCanProceed);
+            while (!pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh) {
+                // Loop to avoid spurious wakeups
+                pSchedSupport->cv_DynamicCanProceed.wait(lock);
+            }
         }
-        pSchedSupport->kinematicOwned_Cons2ProdBuffer_isFresh = true;
-        pSchedSupport->schedulingStats.nKinematicUpdates++;
-        accumStepUpdater.AddUpdate();
+        pSchedSupport->schedulingStats.nTimesDynamicHeldBack++;
+        timers.GetTimer("Wait for kT update").stop();
 
-        timers.GetTimer("Send to kT buffer").stop();
-        // Signal the kinematic that it has data for a new work order
-        pSchedSupport->cv_KinematicCanProceed.notify_all();
+        timers.GetTimer("Unpack updates from kT").start();
+        unpack_impl();
+        timers.GetTimer("Unpack updates from kT").stop();
+        disp = computeMaxCDDisplacement();
     }
 }
 
@@ -2392,7 +3324,14 @@ void DEMDynamicThread::workerThread() {
             }
         }
 
+        // The user may have changed the system in between calls, so a variable step size starts from a fresh max vel
+        stepMaxVelKnown = false;
         for (double cycle = 0.0; cycle < cycleDuration; cycle += (double)(simParams->h)) {
+            // Variable steps take the last bit of the cycle along, so what is left here can only be the round-off of
+            // the steps summed up, not worth a step
+            if (!solverFlags.isStepConst && cycle > 0.0 && cycleDuration - cycle < tsController.RemainderTolerance()) {
+                break;
+            }
             // If the produce is fresh, use it, and then send kT a new work order.
             // We used to send work order to kT whenever kT unpacks its buffer. This can lead to a situation where dT
             // sends a new work order and then immediately bails out (user asks it to do something else). A bit later
@@ -2400,11 +3339,17 @@ void DEMDynamicThread::workerThread() {
             // However! If kT finishes this new order before dT comes back, the persistent contact wildcard map will be
             // off (across 2 kT updates)! So, dT only send new work orders after kT finishes the old order and it
             // unpacks it.
-            ifProduceFreshThenUseItAndSendNewOrder();
+            // In displacement-triggered CD, new work orders are sent based on how far things moved since the last CD,
+            // and dT only waits when the skin is used up.
+            if (solverFlags.useDisplacementCD) {
+                advanceDisplacementTriggeredCD();
+            } else {
+                ifProduceFreshThenUseItAndSendNewOrder();
+            }
 
             // Check if we need to wait; i.e., if dynamic drifted too much into future, then we must wait a bit before
             // the next cycle begins
-            if (pSchedSupport->dynamicShouldWait()) {
+            if (!solverFlags.useDisplacementCD && pSchedSupport->dynamicShouldWait()) {
                 timers.GetTimer("Wait for kT update").start();
                 // Wait for a signal from kT to indicate that kT has caught up
                 std::unique_lock<std::mutex> lock(pSchedSupport->dynamicCanProceed);
@@ -2425,19 +3370,32 @@ void DEMDynamicThread::workerThread() {
             // dynamicOwned_Prod2ConsBuffer_isFresh is false so ifProduceFreshThenUseItAndSendNewOrder didn't run, then
             // kT has to be in the process of doing a CD, we still will not be locked here.
 
+            // Sleeping owners that have been disturbed wake up before the forces are computed
+            if (solverFlags.useSleeping && hasSleepMarks) {
+                wakeSleepingIslands();
+            }
+
             // If using variable ts size, only when a step is accepted can we move on
             bool step_accepted = false;
             do {
-                calculateForces();
+                if (!solverFlags.isStepConst) {
+                    beginVariableStep(cycleDuration - cycle);
+                }
 
-                routineChecks();
+                if (solverFlags.nSubSteps > 1) {
+                    advanceMultiRateStep();
+                } else {
+                    calculateForces();
+
+                    routineChecks();
 
-                timers.GetTimer("Integration").start();
-                integrateOwnerMotions();
-                timers.GetTimer("Integration").stop();
+                    timers.GetTimer("Integration").start();
+                    integrateOwnerMotions();
+                    timers.GetTimer("Integration").stop();
+                }
 
-                step_accepted = true;
-            } while ((!solverFlags.isStepConst) || (!step_accepted));
+                step_accepted = solverFlags.isStepConst || finishVariableStep();
+            } while (!step_accepted);
 
             // CalculateForces is done, set contactPairArr_isFresh to false
             // This will be set to true next time it receives an update from kT
@@ -2451,9 +3409,16 @@ void DEMDynamicThread::workerThread() {
             // Dynamic wrapped up one cycle, record this fact into schedule support
             pSchedSupport->currentStampOfDynamic++;
             nTotalSteps++;
+            cdStepsSinceRef++;
             accumStepUpdater.AddStep();
+            if (solverFlags.useSleeping) {
+                accumulateQuietSteps();
+                if (++stepsSinceSleepCheck >= sleepCheckInterval) {
+                    updateSleepingIslands();
+                    stepsSinceSleepCheck = 0;
+                }
+            }
 
-            //// TODO: make changes for variable time step size cases
             simParams->timeElapsed += (double)simParams->h;
             // timeElapsed needs to be updated to the device each time step
             // simParams.syncMemberToDevice<double>(offsetof(DEMSimParams, timeElapsed));
@@ -2501,6 +3466,129 @@ void DEMDynamicThread::resetUserCallStat() {
     // pSchedSupport->dynamicOwned_Prod2ConsBuffer_isFresh = false;
 }
 
+void DEMDynamicThread::bindMemoryRecords(MemoryRegistry* registry) {
+    if (!registry)
+        return;
+    DEME_REGISTER_MEMORY(registry, "dT.", idGeometryA, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", idGeometryB, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", contactType, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", contactForces, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", contactStateDump, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", contactTorque_convToForce, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", contactPointGeometryA, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", contactPointGeometryB, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", contactTypeSegBounds, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", idGeometryA_buffer, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", idGeometryB_buffer, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", contactType_buffer, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", contactMapping_buffer, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", nContactPairs_buffer, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", numForceBearingContacts, "contact");
+    DEME_REGISTER_MEMORY(registry, "dT.", massOwnerBody, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", mmiXX, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", mmiYY, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", mmiZZ, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", volumeOwnerBody, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerTypes, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", inertiaPropOffsets, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", familyID, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", voxelID, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", locX, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", locY, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", locZ, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", oriQw, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", oriQx, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", oriQy, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", oriQz, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", vX, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", vY, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", vZ, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", omgBarX, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", omgBarY, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", omgBarZ, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", aX, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", aY, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", aZ, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", alphaX, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", alphaY, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", alphaZ, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", accSpecified, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", angAccSpecified, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerBoundRadius, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerSymAxis, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", cdRefPos, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", cdRefOriQ, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", cdOrderPos, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", cdOrderOriQ, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerSleepIsland, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerSleepFamily, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", sleepIslandWoken, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerQuietSteps, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerSleepRadius, "owner");
+    DEME_REGISTER_MEMORY(registry, "dT.", radiiSphere, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", relPosSphereX, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", relPosSphereY, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", relPosSphereZ, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", relPosNode1, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", relPosNode2, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", relPosNode3, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", relPosEntityX, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", relPosEntityY, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", relPosEntityZ, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", oriEntityX, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", oriEntityY, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", oriEntityZ, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", sizeEntity1, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", sizeEntity2, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", sizeEntity3, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerClumpBody, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerMesh, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", ownerAnalBody, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", clumpComponentOffset, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", clumpComponentOffsetExt, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", sphereMaterialOffset, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", triMaterialOffset, "geometry");
+    DEME_REGISTER_MEMORY(registry, "dT.", familyMaskMatrix, "family");
+    DEME_REGISTER_MEMORY(registry, "dT.", familyExtraMarginSize, "family");
+    DEME_REGISTER_MEMORY(registry, "dT.", familySubStepped, "family");
+    DEME_REGISTER_MEMORY(registry, "dT.", familySleepRole, "family");
+    DEME_REGISTER_MEMORY(registry, "dT.", m_reduceResArr, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", m_reduceRes, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", probeOwnerMask, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", probeFamilyMask, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", probeRefPoints, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", probeAggregates, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", probeCounts, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", probeDetailPoints, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", probeDetailForces, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", probeDetailTorques, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", probeDetailIDs, "inspection");
+    DEME_REGISTER_MEMORY(registry, "dT.", simParams, "params");
+    DEME_REGISTER_MEMORY(registry, "dT.", granData, "params");
+    DEME_REGISTER_MEMORY(registry, "dT.", perhapsIdealFutureDrift, "params");
+    DEME_REGISTER_MEMORY(registry, "dT.", maxCDDisp, "params");
+    DEME_REGISTER_MEMORY(registry, "dT.", stepMaxVel, "params");
+    DEME_REGISTER_MEMORY(registry, "dT.", stepUndoBuffer, "scratch");
+    solverScratchSpace.setMemoryRegistry(registry, "dT.");
+    // Wildcard arrays are made at allocation, so they are bound again after each
+    auto registerEach = [&](auto& arrays, const std::string& name) {
+        for (size_t i = 0; i < arrays.size(); i++) {
+            if (arrays[i]) {
+                const std::string recName = "dT." + name + "[" + std::to_string(i) + "]";
+                arrays[i]->setMemoryRecord(registry->Register(recName, "wildcard"));
+            }
+        }
+    };
+    registerEach(contactWildcards, "contactWildcards");
+    registerEach(ownerWildcards, "ownerWildcards");
+    registerEach(sphereWildcards, "sphereWildcards");
+    registerEach(analWildcards, "analWildcards");
+    registerEach(triWildcards, "triWildcards");
+    registerEach(wildcardPoolIndex, "wildcardPoolIndex");
+    registerEach(wildcardPoolData, "wildcardPoolData");
+    registerEach(wildcardPoolFamilyPairs, "wildcardPoolFamilyPairs");
+}
+
 size_t DEMDynamicThread::estimateDeviceMemUsage() const {
     return m_approxDeviceBytesUsed;
 }
@@ -2566,6 +3654,8 @@ float* DEMDynamicThread::inspectCall(const std::shared_ptr<jitify::Program>& ins
             n = simParams->nOwnerBodies;
             owner_type = OWNER_T_CLUMP | OWNER_T_MESH | OWNER_T_ANALYTICAL;
             break;
+        default:
+            DEME_ERROR("An inspector of this entity type can only be used as a distribution inspector.");
     }
 
     // This device set effectively bind the `master' thread, or say the API thread, to the dT device; but it is needed,
@@ -2657,14 +3747,312 @@ float* DEMDynamicThread::inspectCall(const std::shared_ptr<jitify::Program>& ins
     return (float*)m_reduceRes.host();
 }
 
+float* DEMDynamicThread::inspectGroupCall(const std::shared_ptr<jitify::Program>& group_kernels,
+                                          unsigned int nQuantities,
+                                          bool inspect_spheres,
+                                          bool inspect_owners) {
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    const size_t nSpheres = inspect_spheres ? (size_t)simParams->nSpheresGM : 0;
+    const size_t nOwners = inspect_owners ? (size_t)simParams->nOwnerBodies : 0;
+    const size_t nSphereRows = InspectorGroupNumRows(nSpheres), nOwnerRows = InspectorGroupNumRows(nOwners);
+
+    // Both passes write their rows of partial results to the same array, so one reduction finishes them all
+    float* partials = (float*)solverScratchSpace.allocateTempVector(
+        "inspectorGroupPartials", DEME_MAX(nSphereRows + nOwnerRows, (size_t)1) * nQuantities * sizeof(float));
+    if (nSphereRows > 0) {
+        group_kernels->kernel("inspectSpherePropertiesFused")
+            .instantiate()
+            .configure(dim3(nSphereRows), dim3(INSPECTOR_GROUP_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(&granData, &simParams, partials, nSpheres);
+    }
+    if (nOwnerRows > 0) {
+        group_kernels->kernel("inspectOwnerPropertiesFused")
+            .instantiate()
+            .configure(dim3(nOwnerRows), dim3(INSPECTOR_GROUP_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(&granData, &simParams, partials + nSphereRows * nQuantities, nOwners);
+    }
+    DEME_DUAL_ARRAY_RESIZE_NOVAL(m_reduceRes, nQuantities * sizeof(float));
+    float* res = (float*)m_reduceRes.device();
+    group_kernels->kernel("reduceInspectorGroupPartials")
+        .instantiate()
+        .configure(dim3(1), dim3(INSPECTOR_GROUP_THREADS_PER_BLOCK), 0, streamInfo.stream)
+        .launch(partials, nSphereRows + nOwnerRows, res);
+    DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    solverScratchSpace.finishUsingTempVector("inspectorGroupPartials");
+
+    m_reduceRes.toHost();
+    return (float*)m_reduceRes.host();
+}
+
+std::vector<DistributionGroupResult> DEMDynamicThread::inspectDistributionCall(
+    const std::shared_ptr<jitify::Program>& dist_kernels,
+    INSPECT_ENTITY_TYPE thing_to_insp,
+    bool need_contact_counts,
+    unsigned int nGroups,
+    const std::vector<float>& bin_edges,
+    const std::vector<float>& quantiles) {
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nContacts = *solverScratchSpace.numContacts;
+    size_t n = nOwners;
+    ownerType_t owner_type = OWNER_T_CLUMP | OWNER_T_MESH | OWNER_T_ANALYTICAL;
+    if (thing_to_insp == INSPECT_ENTITY_TYPE::SPHERE) {
+        n = simParams->nSpheresGM;
+    } else if (thing_to_insp == INSPECT_ENTITY_TYPE::CONTACT) {
+        n = nContacts;
+    } else if (thing_to_insp == INSPECT_ENTITY_TYPE::CLUMP) {
+        owner_type = OWNER_T_CLUMP;
+    }
+
+    // The value and group of each entity; the temporary arrays are given back when this scope closes
+    auto scope = solverScratchSpace.openScope();
+    float* values =
+        (float*)solverScratchSpace.allocateTempVector(SCRATCH_DIST_VALUES, DEME_MAX(n, (size_t)1) * sizeof(float));
+    unsigned int* groups = (unsigned int*)solverScratchSpace.allocateTempVector(
+        SCRATCH_DIST_GROUPS, DEME_MAX(n, (size_t)1) * sizeof(unsigned int));
+    unsigned int* ownerContactCounts = nullptr;
+    if (need_contact_counts) {
+        ownerContactCounts = (unsigned int*)solverScratchSpace.allocateTempVector(
+            SCRATCH_DIST_OWNER_CONTACT_COUNTS, DEME_MAX(nOwners, (size_t)1) * sizeof(unsigned int));
+        DEME_GPU_CALL(cudaMemsetAsync(ownerContactCounts, 0, nOwners * sizeof(unsigned int), streamInfo.stream));
+        size_t blocks_needed = (nContacts + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+        if (blocks_needed > 0) {
+            dist_kernels->kernel("countOwnerContacts")
+                .instantiate()
+                .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(&granData, ownerContactCounts, nContacts);
+        }
+    }
+    size_t blocks_needed = (n + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    if (blocks_needed > 0) {
+        if (thing_to_insp == INSPECT_ENTITY_TYPE::SPHERE) {
+            dist_kernels->kernel("inspectSphereDistribution")
+                .instantiate()
+                .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(&granData, &simParams, values, groups, n);
+        } else if (thing_to_insp == INSPECT_ENTITY_TYPE::CONTACT) {
+            dist_kernels->kernel("inspectContactDistribution")
+                .instantiate()
+                .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(&granData, &simParams, values, groups, n);
+        } else {
+            dist_kernels->kernel("inspectOwnerDistribution")
+                .instantiate()
+                .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(&granData, &simParams, values, groups, ownerContactCounts, n, owner_type);
+        }
+    }
+
+    // Group counts, sums, extremes and histograms
+    const unsigned int nBins = bin_edges.empty() ? 0 : (unsigned int)bin_edges.size() - 1;
+    const size_t histSize = (size_t)nGroups * (nBins + 2);
+    std::vector<unsigned long long> counts(nGroups), hist(histSize);
+    std::vector<double> sums(nGroups);
+    std::vector<uint32_t> minMaxKeys(2 * (size_t)nGroups);
+    {
+        // The arrays of the group stats are given back at the end of this block
+        auto stats_scope = solverScratchSpace.openScope();
+        unsigned long long* dCounts = (unsigned long long*)solverScratchSpace.allocateTempVector(
+            SCRATCH_DIST_COUNTS, nGroups * sizeof(unsigned long long));
+        double* dSums = (double*)solverScratchSpace.allocateTempVector(SCRATCH_DIST_SUMS, nGroups * sizeof(double));
+        unsigned int* dMinMaxKeys = (unsigned int*)solverScratchSpace.allocateTempVector(
+            SCRATCH_DIST_MIN_MAX_KEYS, 2 * nGroups * sizeof(unsigned int));
+        unsigned long long* dHist = (unsigned long long*)solverScratchSpace.allocateTempVector(
+            SCRATCH_DIST_HIST, DEME_MAX(histSize, (size_t)1) * sizeof(unsigned long long));
+        float* dBinEdges = (float*)solverScratchSpace.allocateTempVector(
+            SCRATCH_DIST_BIN_EDGES, DEME_MAX(bin_edges.size(), (size_t)1) * sizeof(float));
+        DEME_GPU_CALL(cudaMemsetAsync(dCounts, 0, nGroups * sizeof(unsigned long long), streamInfo.stream));
+        DEME_GPU_CALL(cudaMemsetAsync(dSums, 0, nGroups * sizeof(double), streamInfo.stream));
+        // Min keys start at all 1 bits, max keys at 0
+        DEME_GPU_CALL(cudaMemsetAsync(dMinMaxKeys, 0xFF, nGroups * sizeof(unsigned int), streamInfo.stream));
+        DEME_GPU_CALL(cudaMemsetAsync(dMinMaxKeys + nGroups, 0, nGroups * sizeof(unsigned int), streamInfo.stream));
+        DEME_GPU_CALL(cudaMemsetAsync(dHist, 0, histSize * sizeof(unsigned long long), streamInfo.stream));
+        if (nBins > 0) {
+            DEME_GPU_CALL(cudaMemcpyAsync(dBinEdges, bin_edges.data(), bin_edges.size() * sizeof(float),
+                                          cudaMemcpyHostToDevice, streamInfo.stream));
+        }
+        if (blocks_needed > 0) {
+            dist_kernels->kernel("accumulateDistribution")
+                .instantiate()
+                .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(values, groups, n, nGroups, dBinEdges, nBins, dCounts, dSums, dMinMaxKeys,
+                        dMinMaxKeys + nGroups, dHist);
+        }
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+        DEME_GPU_CALL(
+            cudaMemcpy(counts.data(), dCounts, nGroups * sizeof(unsigned long long), cudaMemcpyDeviceToHost));
+        DEME_GPU_CALL(cudaMemcpy(sums.data(), dSums, nGroups * sizeof(double), cudaMemcpyDeviceToHost));
+        DEME_GPU_CALL(
+            cudaMemcpy(minMaxKeys.data(), dMinMaxKeys, 2 * nGroups * sizeof(unsigned int), cudaMemcpyDeviceToHost));
+        DEME_GPU_CALL(
+            cudaMemcpy(hist.data(), dHist, histSize * sizeof(unsigned long long), cudaMemcpyDeviceToHost));
+    }
+
+    // Quantiles: sort by (group, value), then gather only the entries at the quantile positions of each group
+    std::vector<float> quantileVals((size_t)nGroups * quantiles.size(), 0.f);
+    if (!quantiles.empty() && n > 0) {
+        const std::vector<size_t> positions = DistributionQuantilePositions(counts.data(), nGroups, quantiles);
+        auto quantile_scope = solverScratchSpace.openScope();
+        unsigned long long* keys = (unsigned long long*)solverScratchSpace.allocateTempVector(
+            SCRATCH_DIST_SORT_KEYS, n * sizeof(unsigned long long));
+        unsigned long long* sortedKeys = (unsigned long long*)solverScratchSpace.allocateTempVector(
+            SCRATCH_DIST_SORTED_KEYS, n * sizeof(unsigned long long));
+        size_t* dPositions =
+            (size_t*)solverScratchSpace.allocateTempVector(SCRATCH_DIST_POSITIONS, positions.size() * sizeof(size_t));
+        float* dQuantileVals = (float*)solverScratchSpace.allocateTempVector(SCRATCH_DIST_QUANTILE_VALS,
+                                                                             quantileVals.size() * sizeof(float));
+        dist_kernels->kernel("makeDistributionSortKeys")
+            .instantiate()
+            .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(values, groups, n, nGroups, keys);
+        cubSortKeys<unsigned long long>(keys, sortedKeys, n, streamInfo.stream, solverScratchSpace);
+        DEME_GPU_CALL(
+            cudaMemcpy(dPositions, positions.data(), positions.size() * sizeof(size_t), cudaMemcpyHostToDevice));
+        size_t gather_blocks = (positions.size() + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+        dist_kernels->kernel("gatherDistributionQuantiles")
+            .instantiate()
+            .configure(dim3(gather_blocks), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(sortedKeys, dPositions, positions.size(), dQuantileVals);
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+        DEME_GPU_CALL(cudaMemcpy(quantileVals.data(), dQuantileVals, quantileVals.size() * sizeof(float),
+                                 cudaMemcpyDeviceToHost));
+    }
+
+    return AssembleDistributionResults(nGroups, nBins, quantiles.size(), counts.data(), sums.data(), minMaxKeys.data(),
+                                       minMaxKeys.data() + nGroups, hist.data(), quantileVals.data());
+}
+
+void DEMDynamicThread::coarseGrainSample(const std::shared_ptr<jitify::Program>& cg_kernels,
+                                         const CGGridParams& grid,
+                                         bool on_device,
+                                         DualArray<double>& sums,
+                                         unsigned int n_threads) {
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    const size_t nOwners = simParams->nOwnerBodies;
+    const size_t nContacts = *solverScratchSpace.numContacts;
+    const size_t nParticleRecs = DEME_MAX(nOwners, (size_t)1), nContactRecs = DEME_MAX(nContacts, (size_t)1);
+
+    // The records of all owners and contacts; those that are not deposited have a NaN position
+    CGParticle* particles =
+        (CGParticle*)solverScratchSpace.allocateTempVector("cgParticles", nParticleRecs * sizeof(CGParticle));
+    CGContact* contacts =
+        (CGContact*)solverScratchSpace.allocateTempVector("cgContacts", nContactRecs * sizeof(CGContact));
+    unsigned int* particleCells =
+        (unsigned int*)solverScratchSpace.allocateTempVector("cgParticleCells", nParticleRecs * sizeof(unsigned int));
+    unsigned int* contactCells =
+        (unsigned int*)solverScratchSpace.allocateTempVector("cgContactCells", nContactRecs * sizeof(unsigned int));
+    contactPairs_t* particleIds = (contactPairs_t*)solverScratchSpace.allocateTempVector(
+        "cgParticleIds", nParticleRecs * sizeof(contactPairs_t));
+    contactPairs_t* contactIds = (contactPairs_t*)solverScratchSpace.allocateTempVector(
+        "cgContactIds", nContactRecs * sizeof(contactPairs_t));
+    size_t blocks_needed = (nOwners + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    if (blocks_needed > 0) {
+        cg_kernels->kernel("extractCGParticles")
+            .instantiate()
+            .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(&granData, &simParams, grid, particles, particleCells, particleIds, nOwners);
+    }
+    blocks_needed = (nContacts + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    if (blocks_needed > 0) {
+        cg_kernels->kernel("extractCGContacts")
+            .instantiate()
+            .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(&granData, &simParams, grid, contacts, contactCells, contactIds, nContacts);
+    }
+    DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+
+    if (on_device) {
+        // Sort the records by cell (the radix sort is stable, so a cell's records stay in index order, as on the host)
+        const unsigned int nCells = cgNumCells(grid);
+        CGParticle* sortedParticles =
+            (CGParticle*)solverScratchSpace.allocateTempVector("cgSortedParticles", nParticleRecs * sizeof(CGParticle));
+        CGContact* sortedContacts =
+            (CGContact*)solverScratchSpace.allocateTempVector("cgSortedContacts", nContactRecs * sizeof(CGContact));
+        unsigned int* sortedCells = (unsigned int*)solverScratchSpace.allocateTempVector(
+            "cgSortedCells", DEME_MAX(nParticleRecs, nContactRecs) * sizeof(unsigned int));
+        contactPairs_t* sortedIds = (contactPairs_t*)solverScratchSpace.allocateTempVector(
+            "cgSortedIds", DEME_MAX(nParticleRecs, nContactRecs) * sizeof(contactPairs_t));
+        contactPairs_t* particleStarts = (contactPairs_t*)solverScratchSpace.allocateTempVector(
+            "cgParticleStarts", ((size_t)nCells + 1) * sizeof(contactPairs_t));
+        contactPairs_t* contactStarts = (contactPairs_t*)solverScratchSpace.allocateTempVector(
+            "cgContactStarts", ((size_t)nCells + 1) * sizeof(contactPairs_t));
+        const size_t cell_blocks = ((size_t)nCells + 1 + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+
+        cubSortByKey<unsigned int, contactPairs_t>(particleCells, sortedCells, particleIds, sortedIds, nOwners,
+                                                   streamInfo.stream, solverScratchSpace);
+        blocks_needed = (nOwners + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+        if (blocks_needed > 0) {
+            cg_kernels->kernel("permuteCGParticles")
+                .instantiate()
+                .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(particles, sortedIds, sortedParticles, nOwners);
+        }
+        cg_kernels->kernel("findCGCellStarts")
+            .instantiate()
+            .configure(dim3(cell_blocks), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(sortedCells, nOwners, nCells, particleStarts);
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+
+        cubSortByKey<unsigned int, contactPairs_t>(contactCells, sortedCells, contactIds, sortedIds, nContacts,
+                                                   streamInfo.stream, solverScratchSpace);
+        blocks_needed = (nContacts + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+        if (blocks_needed > 0) {
+            cg_kernels->kernel("permuteCGContacts")
+                .instantiate()
+                .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+                .launch(contacts, sortedIds, sortedContacts, nContacts);
+        }
+        cg_kernels->kernel("findCGCellStarts")
+            .instantiate()
+            .configure(dim3(cell_blocks), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(sortedCells, nContacts, nCells, contactStarts);
+
+        const size_t nNodes = cgNumNodes(grid);
+        blocks_needed = (nNodes + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+        cg_kernels->kernel("gatherCGNodes")
+            .instantiate()
+            .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(grid, sortedParticles, particleStarts, sortedContacts, contactStarts, sums.device(), nNodes);
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+        solverScratchSpace.finishUsingTempVector("cgSortedParticles");
+        solverScratchSpace.finishUsingTempVector("cgSortedContacts");
+        solverScratchSpace.finishUsingTempVector("cgSortedCells");
+        solverScratchSpace.finishUsingTempVector("cgSortedIds");
+        solverScratchSpace.finishUsingTempVector("cgParticleStarts");
+        solverScratchSpace.finishUsingTempVector("cgContactStarts");
+    } else {
+        // Only the records are brought over; the host sorts and gathers them itself
+        std::vector<CGParticle> hostParticles(nOwners);
+        std::vector<CGContact> hostContacts(nContacts);
+        DEME_GPU_CALL(
+            cudaMemcpy(hostParticles.data(), particles, nOwners * sizeof(CGParticle), cudaMemcpyDeviceToHost));
+        DEME_GPU_CALL(
+            cudaMemcpy(hostContacts.data(), contacts, nContacts * sizeof(CGContact), cudaMemcpyDeviceToHost));
+        CoarseGrainHost(grid, hostParticles, hostContacts, sums.host(), n_threads);
+    }
+    solverScratchSpace.finishUsingTempVector("cgParticles");
+    solverScratchSpace.finishUsingTempVector("cgContacts");
+    solverScratchSpace.finishUsingTempVector("cgParticleCells");
+    solverScratchSpace.finishUsingTempVector("cgContactCells");
+    solverScratchSpace.finishUsingTempVector("cgParticleIds");
+    solverScratchSpace.finishUsingTempVector("cgContactIds");
+}
+
 void DEMDynamicThread::initAllocation() {
     DEME_DUAL_ARRAY_RESIZE(familyExtraMarginSize, NUM_AVAL_FAMILIES, 0);
+    DEME_DUAL_ARRAY_RESIZE(familySubStepped, NUM_AVAL_FAMILIES, 0);
+    DEME_DUAL_ARRAY_RESIZE(familySleepRole, NUM_AVAL_FAMILIES, SLEEP_ROLE_REGULAR);
 }
 
 void DEMDynamicThread::deallocateEverything() {
     for (unsigned int i = 0; i < contactWildcards.size(); i++) {
         contactWildcards[i].reset();
     }
+    for (unsigned int i = 0; i < wildcardPoolIndex.size(); i++) {
+        wildcardPoolIndex[i].reset();
+        wildcardPoolData[i].reset();
+        wildcardPoolFamilyPairs[i].reset();
+    }
     for (unsigned int i = 0; i < ownerWildcards.size(); i++) {
         ownerWildcards[i].reset();
     }
@@ -2833,6 +4221,165 @@ size_t DEMDynamicThread::getOwnerContactForces(const std::vector<bodyID_t>& owne
     return numUsefulCnt;
 }
 
+unsigned int DEMDynamicThread::addContactForceProbe(const ContactForceProbe& probe) {
+    if (forceProbes.size() >= MAX_NUM_FORCE_PROBES) {
+        DEME_ERROR("At most %u contact force probes can be registered.", MAX_NUM_FORCE_PROBES);
+    }
+    for (const auto& fam : probe.families) {
+        if (fam >= NUM_AVAL_FAMILIES) {
+            DEME_ERROR("Family %u used in a contact force probe is not a valid family number.", fam);
+        }
+    }
+    forceProbes.push_back(probe);
+    forceProbeMasksDirty = true;
+    // Existing results do not cover the new probe
+    forceProbeEvalStamp = SIZE_MAX;
+    return forceProbes.size() - 1;
+}
+
+void DEMDynamicThread::buildContactForceProbeMasks() {
+    size_t nOwners = simParams->nOwnerBodies;
+    DEME_DUAL_ARRAY_RESIZE(probeOwnerMask, nOwners, 0);
+    DEME_DUAL_ARRAY_RESIZE(probeFamilyMask, NUM_AVAL_FAMILIES, 0);
+    DEME_DUAL_ARRAY_RESIZE(probeRefPoints, forceProbes.size(), make_float3(0, 0, 0));
+    for (size_t i = 0; i < nOwners; i++) {
+        probeOwnerMask[i] = 0;
+    }
+    for (unsigned int i = 0; i < NUM_AVAL_FAMILIES; i++) {
+        probeFamilyMask[i] = 0;
+    }
+    for (unsigned int k = 0; k < forceProbes.size(); k++) {
+        const unsigned int bit = 1u << k;
+        for (const auto& owner : forceProbes[k].owners) {
+            if (owner >= nOwners) {
+                DEME_ERROR("Contact force probe %u contains owner %zu, but there are only %zu owners.", k,
+                           (size_t)owner, nOwners);
+            }
+            probeOwnerMask[owner] |= bit;
+        }
+        for (const auto& fam : forceProbes[k].families) {
+            probeFamilyMask[fam] |= bit;
+        }
+        probeRefPoints[k] = forceProbes[k].refPoint;
+    }
+    probeOwnerMask.toDevice();
+    probeFamilyMask.toDevice();
+    probeRefPoints.toDevice();
+    forceProbeMaskNumOwners = nOwners;
+    forceProbeMasksDirty = false;
+}
+
+void DEMDynamicThread::evaluateContactForceProbes() {
+    if (forceProbeEvalStamp == forceCalcCounter)
+        return;
+    if (solverFlags.useNoContactRecord) {
+        DEME_ERROR(
+            "Contact force probes need the contact forces to be recorded, so they cannot be used if the forces are "
+            "collected right inside the force kernel.\nConsider calling SetCollectAccRightAfterForceCalc(false).");
+    }
+    // Set the gpu for this thread
+    DEME_GPU_CALL(cudaSetDevice(streamInfo.device));
+    if (forceProbeMasksDirty || forceProbeMaskNumOwners != simParams->nOwnerBodies) {
+        buildContactForceProbeMasks();
+    }
+
+    unsigned int nProbes = forceProbes.size();
+    unsigned int detailMask = 0;
+    for (unsigned int k = 0; k < nProbes; k++) {
+        if (forceProbes[k].keepDetail)
+            detailMask |= (1u << k);
+    }
+    size_t numCnt = *solverScratchSpace.numContacts;
+    // A contact can show up in the detail of multiple probes, but only once per probe
+    if (detailMask) {
+        size_t nDetailProbes = 0;
+        for (unsigned int k = 0; k < nProbes; k++) {
+            nDetailProbes += (detailMask >> k) & 1u;
+        }
+        size_t detailCap = numCnt * nDetailProbes;
+        if (probeDetailIDs.size() < detailCap) {
+            DEME_DUAL_ARRAY_RESIZE(probeDetailPoints, detailCap, make_float3(0, 0, 0));
+            DEME_DUAL_ARRAY_RESIZE(probeDetailForces, detailCap, make_float3(0, 0, 0));
+            DEME_DUAL_ARRAY_RESIZE(probeDetailTorques, detailCap, make_float3(0, 0, 0));
+            DEME_DUAL_ARRAY_RESIZE(probeDetailIDs, detailCap, 0);
+        }
+    }
+
+    DEME_DUAL_ARRAY_RESIZE(probeAggregates, nProbes * FORCE_PROBE_NUM_AGGREGATES, 0);
+    DEME_DUAL_ARRAY_RESIZE(probeCounts, nProbes + 1, 0);
+    for (size_t i = 0; i < probeAggregates.size(); i++) {
+        probeAggregates[i] = 0;
+    }
+    for (size_t i = 0; i < probeCounts.size(); i++) {
+        probeCounts[i] = 0;
+    }
+    probeAggregates.toDevice();
+    probeCounts.toDevice();
+
+    reduceContactForceProbes(probeAggregates.data(), probeCounts.data(), probeOwnerMask.data(), probeFamilyMask.data(),
+                             probeRefPoints.data(), nProbes, detailMask, probeDetailPoints.data(),
+                             probeDetailForces.data(), probeDetailTorques.data(), probeDetailIDs.data(),
+                             probeCounts.data() + nProbes, &simParams, &granData, numCnt, streamInfo.stream);
+
+    probeAggregates.toHost();
+    probeCounts.toHost();
+    numProbeDetail = probeCounts[nProbes];
+    if (numProbeDetail > 0) {
+        probeDetailPoints.toHost(0, numProbeDetail);
+        probeDetailForces.toHost(0, numProbeDetail);
+        probeDetailTorques.toHost(0, numProbeDetail);
+        probeDetailIDs.toHost(0, numProbeDetail);
+    }
+
+    forceProbeResults.resize(nProbes);
+    for (unsigned int k = 0; k < nProbes; k++) {
+        const float* agg = probeAggregates.host() + k * FORCE_PROBE_NUM_AGGREGATES;
+        ContactForceProbeResult& res = forceProbeResults[k];
+        res.numContacts = probeCounts[k];
+        res.force = make_float3(agg[0], agg[1], agg[2]);
+        res.moment = make_float3(agg[3], agg[4], agg[5]);
+        res.forceCenter = (agg[9] > 0.f) ? make_float3(agg[6], agg[7], agg[8]) / agg[9] : forceProbes[k].refPoint;
+    }
+    forceProbeEvalStamp = forceCalcCounter;
+}
+
+ContactForceProbeResult DEMDynamicThread::getContactForceProbeResult(unsigned int probe) {
+    if (probe >= forceProbes.size()) {
+        DEME_ERROR("Contact force probe %u does not exist; %zu probes are registered.", probe, forceProbes.size());
+    }
+    evaluateContactForceProbes();
+    return forceProbeResults[probe];
+}
+
+size_t DEMDynamicThread::getContactForceProbeDetail(unsigned int probe,
+                                                    float3* points,
+                                                    float3* forces,
+                                                    float3* torques,
+                                                    size_t capacity) {
+    if (probe >= forceProbes.size()) {
+        DEME_ERROR("Contact force probe %u does not exist; %zu probes are registered.", probe, forceProbes.size());
+    }
+    if (!forceProbes[probe].keepDetail) {
+        DEME_ERROR("Contact force probe %u was not registered to keep per-contact detail.", probe);
+    }
+    evaluateContactForceProbes();
+    size_t n = forceProbeResults[probe].numContacts;
+    if (capacity < n) {
+        DEME_ERROR("Contact force probe detail buffers have capacity %zu, but probe %u has %zu contacts.", capacity,
+                   probe, n);
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < numProbeDetail && count < n; i++) {
+        if (probeDetailIDs[i] == probe) {
+            points[count] = probeDetailPoints[i];
+            forces[count] = probeDetailForces[i];
+            torques[count] = probeDetailTorques[i];
+            count++;
+        }
+    }
+    return count;
+}
+
 void DEMDynamicThread::setFamilyContactWildcardValue_impl(
     unsigned int N1,
     unsigned int N2,
@@ -2841,7 +4388,7 @@ void DEMDynamicThread::setFamilyContactWildcardValue_impl(
     const std::function<bool(unsigned int, unsigned int, unsigned int, unsigned int)>& condition) {
     // Get host updated then send all to device
     migrateFamilyToHost();
-    contactWildcards[wc_num]->toHost();
+    contactWildcardToHost(wc_num);
     idGeometryA.toHost();
     idGeometryB.toHost();
     contactType.toHost();
@@ -2858,10 +4405,10 @@ void DEMDynamicThread::setFamilyContactWildcardValue_impl(
         unsigned int famB = +(familyID[ownerB]);
 
         if (condition(famA, famB, N1, N2)) {
-            (*contactWildcards[wc_num])[i] = val;
+            setContactWildcardOnHost(wc_num, i, val);
         }
     }
-    contactWildcards[wc_num]->toDevice();
+    contactWildcardToDevice(wc_num);
 }
 
 void DEMDynamicThread::setFamilyContactWildcardValueEither(unsigned int N, unsigned int wc_num, float val) {
@@ -2887,12 +4434,85 @@ void DEMDynamicThread::setFamilyContactWildcardValue(unsigned int N1, unsigned i
 
 void DEMDynamicThread::setContactWildcardValue(unsigned int wc_num, float val) {
     // Get host updated then send all to device
-    contactWildcards[wc_num]->toHost();
+    contactWildcardToHost(wc_num);
+    if (m_contact_wildcard_slots.at(wc_num).pool >= 0) {
+        // Which contacts are in scope of the pool is judged on the host
+        migrateFamilyToHost();
+        idGeometryA.toHost();
+        idGeometryB.toHost();
+        contactType.toHost();
+    }
     size_t numCnt = *solverScratchSpace.numContacts;
     for (size_t i = 0; i < numCnt; i++) {
-        (*contactWildcards[wc_num])[i] = val;
+        setContactWildcardOnHost(wc_num, i, val);
+    }
+    contactWildcardToDevice(wc_num);
+}
+
+float DEMDynamicThread::getContactWildcardOnHost(unsigned int wc_num, size_t cnt) const {
+    const ContactWildcardSlot& slot = m_contact_wildcard_slots.at(wc_num);
+    if (slot.pool < 0) {
+        return (*contactWildcards[wc_num])[cnt];
+    }
+    contactPairs_t record = (*wildcardPoolIndex[slot.pool])[cnt];
+    if (record == NULL_MAPPING_PARTNER) {
+        return 0.;
+    }
+    return ReadPooledWildcard(wildcardPoolData[slot.pool]->host(), wildcardPools[slot.pool], record, slot.field);
+}
+
+void DEMDynamicThread::setContactWildcardOnHost(unsigned int wc_num, size_t cnt, float val) {
+    const ContactWildcardSlot& slot = m_contact_wildcard_slots.at(wc_num);
+    if (slot.pool < 0) {
+        (*contactWildcards[wc_num])[cnt] = val;
+        return;
+    }
+    const unsigned int p = slot.pool;
+    const ContactWildcardPool& pool = wildcardPools[p];
+    contactPairs_t record = (*wildcardPoolIndex[p])[cnt];
+    if (record == NULL_MAPPING_PARTNER) {
+        // A contact without a record reads 0 anyway
+        if (val == 0. || !contactInWildcardPoolOnHost(p, cnt)) {
+            return;
+        }
+        record = wildcardPoolNumRecords[p]++;
+        size_t record_bytes = WildcardPoolRecordBytes(pool);
+        if (wildcardPoolNumRecords[p] * record_bytes > wildcardPoolData[p]->size()) {
+            DEME_DUAL_ARRAY_RESIZE((*wildcardPoolData[p]), 2 * wildcardPoolNumRecords[p] * record_bytes, 0);
+        }
+        (*wildcardPoolIndex[p])[cnt] = record;
     }
-    contactWildcards[wc_num]->toDevice();
+    WritePooledWildcard(wildcardPoolData[p]->host(), pool, record, slot.field, val);
+}
+
+void DEMDynamicThread::contactWildcardToHost(unsigned int wc_num) {
+    const ContactWildcardSlot& slot = m_contact_wildcard_slots.at(wc_num);
+    if (slot.pool < 0) {
+        contactWildcards[wc_num]->toHost();
+    } else {
+        wildcardPoolIndex[slot.pool]->toHost();
+        wildcardPoolData[slot.pool]->toHost();
+    }
+}
+
+void DEMDynamicThread::contactWildcardToDevice(unsigned int wc_num) {
+    const ContactWildcardSlot& slot = m_contact_wildcard_slots.at(wc_num);
+    if (slot.pool < 0) {
+        contactWildcards[wc_num]->toDevice();
+    } else {
+        wildcardPoolIndex[slot.pool]->toDevice();
+        wildcardPoolData[slot.pool]->toDevice();
+    }
+}
+
+bool DEMDynamicThread::contactInWildcardPoolOnHost(unsigned int pool, size_t cnt) const {
+    contact_t type = contactType[cnt];
+    if (type == NOT_A_CONTACT) {
+        return false;
+    }
+    bodyID_t ownerA = ownerClumpBody[idGeometryA[cnt]];
+    bodyID_t ownerB = getGeoOwnerID(idGeometryB[cnt], type);
+    return ContactInWildcardPoolScope(wildcardPools[pool], type, +(familyID[ownerA]), +(familyID[ownerB]));
 }
 
 void DEMDynamicThread::setOwnerWildcardValue(bodyID_t ownerID, unsigned int wc_num, const std::vector<float>& vals) {
@@ -3056,6 +4676,183 @@ std::vector<float3> DEMDynamicThread::getOwnerPos(bodyID_t ownerID, bodyID_t n)
     return pos;
 }
 
+template <typename T>
+size_t DEMDynamicThread::exportOwnerState(T* buffer,
+                                          size_t buffer_len,
+                                          bodyID_t start,
+                                          bodyID_t n,
+                                          const std::vector<bodyID_t>* IDs,
+                                          const StateExportLayout& layout) {
+    const size_t count = IDs ? IDs->size() : (size_t)n;
+    if (count == 0)
+        return 0;
+    if (layout.interleaved && layout.rowStride > 0 && layout.rowStride < layout.NumComponents()) {
+        DEME_ERROR("Export row stride %zu is smaller than the %zu components selected per owner.", layout.rowStride,
+                   layout.NumComponents());
+    }
+    if (buffer_len < layout.RequiredLength(count)) {
+        DEME_ERROR("Export buffer has length %zu, but %zu owners with the requested layout need length %zu.",
+                   buffer_len, count, layout.RequiredLength(count));
+    }
+
+    // Only the range of owners involved is brought to host, directly into the host mirrors (no temporary vectors)
+    size_t lo = start, hi = (size_t)start + n;
+    if (IDs) {
+        auto minmax = std::minmax_element(IDs->begin(), IDs->end());
+        lo = *(minmax.first);
+        hi = (size_t)(*(minmax.second)) + 1;
+    }
+    if (hi > simParams->nOwnerBodies) {
+        DEME_ERROR("Owner %zu is requested for export, but there are only %zu owners.", hi - 1,
+                   (size_t)simParams->nOwnerBodies);
+    }
+    const size_t span = hi - lo;
+    const unsigned int cols = layout.columns;
+    if (cols & EXPORT_POS) {
+        voxelID.toHostAsync(streamInfo.stream, lo, span);
+        locX.toHostAsync(streamInfo.stream, lo, span);
+        locY.toHostAsync(streamInfo.stream, lo, span);
+        locZ.toHostAsync(streamInfo.stream, lo, span);
+    }
+    if (cols & EXPORT_QUAT) {
+        oriQw.toHostAsync(streamInfo.stream, lo, span);
+        oriQx.toHostAsync(streamInfo.stream, lo, span);
+        oriQy.toHostAsync(streamInfo.stream, lo, span);
+        oriQz.toHostAsync(streamInfo.stream, lo, span);
+    }
+    if (cols & EXPORT_VEL) {
+        vX.toHostAsync(streamInfo.stream, lo, span);
+        vY.toHostAsync(streamInfo.stream, lo, span);
+        vZ.toHostAsync(streamInfo.stream, lo, span);
+    }
+    if (cols & EXPORT_ANG_VEL) {
+        omgBarX.toHostAsync(streamInfo.stream, lo, span);
+        omgBarY.toHostAsync(streamInfo.stream, lo, span);
+        omgBarZ.toHostAsync(streamInfo.stream, lo, span);
+    }
+    if (cols & EXPORT_ACC) {
+        aX.toHostAsync(streamInfo.stream, lo, span);
+        aY.toHostAsync(streamInfo.stream, lo, span);
+        aZ.toHostAsync(streamInfo.stream, lo, span);
+    }
+    if (cols & EXPORT_ANG_ACC) {
+        alphaX.toHostAsync(streamInfo.stream, lo, span);
+        alphaY.toHostAsync(streamInfo.stream, lo, span);
+        alphaZ.toHostAsync(streamInfo.stream, lo, span);
+    }
+    if (cols & EXPORT_FAMILY) {
+        familyID.toHostAsync(streamInfo.stream, lo, span);
+    }
+    syncMemoryTransfer();
+
+    const size_t row_step = layout.RowStep();
+    const size_t comp_step = layout.interleaved ? 1 : count;
+    // Each chunk of rows is processed column by column, so the inner loops are simple, contiguous-read loops
+    hostParallelFor(count, [&](unsigned int chunk, size_t row_start, size_t row_end) {
+        size_t comp = 0;
+        auto owner = [&](size_t r) -> size_t { return IDs ? (size_t)(*IDs)[r] : (size_t)start + r; };
+        auto put = [&](size_t r, size_t c, T val) { buffer[r * row_step + c * comp_step] = val; };
+        if (cols & EXPORT_POS) {
+            const unsigned char nvXp2 = simParams->nvXp2, nvYp2 = simParams->nvYp2;
+            const double voxelSize = simParams->voxelSize, l = simParams->l;
+            for (size_t r = row_start; r < row_end; r++) {
+                size_t i = owner(r);
+                double X, Y, Z;
+                voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(X, Y, Z, voxelID[i], locX[i], locY[i], locZ[i],
+                                                                    nvXp2, nvYp2, voxelSize, l);
+                put(r, comp, (T)(X + simParams->LBFX));
+                put(r, comp + 1, (T)(Y + simParams->LBFY));
+                put(r, comp + 2, (T)(Z + simParams->LBFZ));
+            }
+            comp += 3;
+        }
+        if (cols & EXPORT_QUAT) {
+            for (size_t r = row_start; r < row_end; r++) {
+                size_t i = owner(r);
+                put(r, comp, (T)oriQx[i]);
+                put(r, comp + 1, (T)oriQy[i]);
+                put(r, comp + 2, (T)oriQz[i]);
+                put(r, comp + 3, (T)oriQw[i]);
+            }
+            comp += 4;
+        }
+        auto put3 = [&](DualArray<float>& arrX, DualArray<float>& arrY, DualArray<float>& arrZ) {
+            for (size_t r = row_start; r < row_end; r++) {
+                size_t i = owner(r);
+                put(r, comp, (T)arrX[i]);
+                put(r, comp + 1, (T)arrY[i]);
+                put(r, comp + 2, (T)arrZ[i]);
+            }
+            comp += 3;
+        };
+        if (cols & EXPORT_VEL)
+            put3(vX, vY, vZ);
+        if (cols & EXPORT_ANG_VEL)
+            put3(omgBarX, omgBarY, omgBarZ);
+        if (cols & EXPORT_ACC)
+            put3(aX, aY, aZ);
+        if (cols & EXPORT_ANG_ACC)
+            put3(alphaX, alphaY, alphaZ);
+        if (cols & EXPORT_FAMILY) {
+            for (size_t r = row_start; r < row_end; r++) {
+                put(r, comp, (T)familyID[owner(r)]);
+            }
+        }
+    });
+    return count;
+}
+
+template <typename T>
+size_t DEMDynamicThread::exportContacts(bodyID_t* idA, bodyID_t* idB, T* forces, size_t capacity) {
+    size_t num_contacts = getNumContacts();
+    if (capacity < num_contacts) {
+        DEME_ERROR("Contact export buffers have capacity %zu, but there are %zu contacts.", capacity, num_contacts);
+    }
+    idGeometryA.toHostAsync(streamInfo.stream, 0, num_contacts);
+    idGeometryB.toHostAsync(streamInfo.stream, 0, num_contacts);
+    contactType.toHostAsync(streamInfo.stream, 0, num_contacts);
+    if (forces) {
+        contactForces.toHostAsync(streamInfo.stream, 0, num_contacts);
+    }
+    syncMemoryTransfer();
+
+    // The host mirrors are made ready here, not in the threads
+    const contact_t* types = contactType.host();
+    const bodyID_t* geoA = idGeometryA.host();
+    const bodyID_t* geoB = idGeometryB.host();
+    const bodyID_t* clump_owner = ownerClumpBody.host();
+    const bodyID_t* mesh_owner = ownerMesh.host();
+    const bodyID_t* anal_owner = ownerAnalBody.host();
+    const float3* cnt_forces = forces ? contactForces.host() : nullptr;
+    hostParallelFor(num_contacts, [&](unsigned int, size_t start, size_t end) {
+        contactOwnersOnHost(idA, idB, types, geoA, geoB, clump_owner, mesh_owner, anal_owner, start, end);
+        if (forces) {
+            for (size_t i = start; i < end; i++) {
+                float3 f = cnt_forces[i];
+                forces[3 * i] = (T)f.x;
+                forces[3 * i + 1] = (T)f.y;
+                forces[3 * i + 2] = (T)f.z;
+            }
+        }
+    });
+    return num_contacts;
+}
+
+template size_t DEMDynamicThread::exportOwnerState<float>(float*,
+                                                          size_t,
+                                                          bodyID_t,
+                                                          bodyID_t,
+                                                          const std::vector<bodyID_t>*,
+                                                          const StateExportLayout&);
+template size_t DEMDynamicThread::exportOwnerState<double>(double*,
+                                                           size_t,
+                                                           bodyID_t,
+                                                           bodyID_t,
+                                                           const std::vector<bodyID_t>*,
+                                                           const StateExportLayout&);
+template size_t DEMDynamicThread::exportContacts<float>(bodyID_t*, bodyID_t*, float*, size_t);
+template size_t DEMDynamicThread::exportContacts<double>(bodyID_t*, bodyID_t*, double*, size_t);
+
 std::vector<unsigned int> DEMDynamicThread::getOwnerFamily(bodyID_t ownerID, bodyID_t n) {
     std::vector<unsigned int> fam(n);
     // Get from device by default, even not needed
@@ -3122,6 +4919,14 @@ void DEMDynamicThread::setTriNodeRelPos(size_t start, const std::vector<DEMTrian
     relPosNode1.toDeviceAsync(streamInfo.stream, start, triangles.size());
     relPosNode2.toDeviceAsync(streamInfo.stream, start, triangles.size());
     relPosNode3.toDeviceAsync(streamInfo.stream, start, triangles.size());
+    // A deformed mesh may reach further from its CoM. The size only grows, which stays on the safe side.
+    if (solverFlags.useDisplacementCD) {
+        for (size_t i = 0; i < triangles.size(); i++) {
+            float& bound = ownerBoundRadius[ownerMesh[start + i]];
+            bound = std::max({bound, length(triangles[i].p1), length(triangles[i].p2), length(triangles[i].p3)});
+        }
+        ownerBoundRadius.toDeviceAsync(streamInfo.stream);
+    }
     syncMemoryTransfer();
 }
 
@@ -24,6 +24,16 @@
 #include <DEM/Defines.h>
 #include <DEM/Structs.h>
 #include <DEM/AuxClasses.h>
+#include <DEM/utils/QuantizedIO.hpp>
+#include <DEM/utils/OutputFilters.hpp>
+#include <DEM/utils/MeshFrameIO.hpp>
+#include <DEM/utils/TimeStepController.hpp>
+#include <DEM/utils/CDSkinTuner.hpp>
+#include <DEM/utils/SleepIslands.hpp>
+#include <DEM/utils/ForceSegments.hpp>
+#include <DEM/utils/WildcardPools.hpp>
+#include <DEM/utils/ContactNetwork.hpp>
+#include <DEM/utils/HostForceModel.hpp>
 
 // Forward declare jitify::Program to avoid downstream dependency
 namespace jitify {
@@ -60,6 +70,10 @@ class DEMDynamicThread {
     // it is allocated)
     size_t buffer_size = 0;
 
+    // Capacity of the contact arrays (and the contact wildcards), which grows ahead of the contact number and shrinks
+    // after it stays low for long
+    CapacityManager contactCapacity;
+
     // dT's one-element buffer of kT-supplied nContacts (as buffer, it's device-only, but I used DualStruct just for
     // convenience...)
     DualStruct<size_t> nContactPairs_buffer = DualStruct<size_t>(0);
@@ -159,6 +173,15 @@ class DEMDynamicThread {
     // The (impl-level) family IDs whose entities should not be outputted to files
     std::unordered_set<family_t> familiesNoOutput;
 
+    // Encoder for quantized clump output; it keeps the last written frame for delta coding
+    QuantizedFrameEncoder quantEncoder;
+    // Encoder for incremental mesh output; it keeps the last written mesh state
+    MeshFrameEncoder meshFrameEncoder;
+
+    // User-specified filters applied on top of familiesNoOutput when writing spheres/clumps, and contacts
+    OutputFilter ownerOutputFilter;
+    OutputFilter contactOutputFilter;
+
     // The voxel ID (split into 3 parts, representing XYZ location)
     DualArray<voxelID_t> voxelID = DualArray<voxelID_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
 
@@ -217,6 +240,10 @@ class DEMDynamicThread {
     // Local position of contact point of contact w.r.t. the reference frame of body A and B
     DualArray<float3> contactPointGeometryA = DualArray<float3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
     DualArray<float3> contactPointGeometryB = DualArray<float3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    // The state of each contact in the last force calculation, as HostContactBatch rows (if solverFlags says so), and
+    // the number of contacts it has rows for
+    DualArray<float> contactStateDump = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    size_t numContactStateDumpRows = 0;
     // Wildcard (extra property) arrays associated with contacts and owners
     std::vector<std::unique_ptr<DualArray<float>>> contactWildcards;
     std::vector<std::unique_ptr<DualArray<float>>> ownerWildcards;
@@ -234,6 +261,16 @@ class DEMDynamicThread {
     std::set<std::string> m_contact_wildcard_names;
     std::set<std::string> m_owner_wildcard_names;
     std::set<std::string> m_geo_wildcard_names;
+    // The numbers of the contact wildcards, and where each is stored (a dense array or a packed pool), by number
+    std::map<std::string, unsigned int> m_contact_wildcard_num;
+    std::vector<ContactWildcardSlot> m_contact_wildcard_slots;
+
+    // Packed contact wildcard pools (see WildcardPools.hpp): the record of each contact, the packed records, the table
+    // of family pairs in scope (empty if all are), and the number of records in use
+    std::vector<std::unique_ptr<DualArray<contactPairs_t>>> wildcardPoolIndex;
+    std::vector<std::unique_ptr<DualArray<uint8_t>>> wildcardPoolData;
+    std::vector<std::unique_ptr<DualArray<notStupidBool_t>>> wildcardPoolFamilyPairs;
+    std::vector<size_t> wildcardPoolNumRecords;
 
     // DualArray<float3> contactHistory;
     // // Durations in time of persistent contact pairs
@@ -289,6 +326,10 @@ class DEMDynamicThread {
     // that means geometries should be considered in contact when they are physically in contact.
     DualArray<float> familyExtraMarginSize = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
 
+    // Whether contacts involving each family are sub-stepped in multi-rate integration
+    DualArray<notStupidBool_t> familySubStepped =
+        DualArray<notStupidBool_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+
     // dT's copy of "clump template and their names" map
     std::unordered_map<unsigned int, std::string> templateNumNameMap;
 
@@ -301,6 +342,7 @@ class DEMDynamicThread {
   public:
     friend class DEMSolver;
     friend class DEMKinematicThread;
+    friend class DEMInspectorGroup;
 
     DEMDynamicThread(WorkerReportChannel* pPager, ThreadManager* pSchedSup, const GpuManager::StreamInfo& sInfo)
         : pPagerToMain(pPager), pSchedSupport(pSchedSup), streamInfo(sInfo) {
@@ -362,6 +404,19 @@ class DEMDynamicThread {
     size_t getNumContacts() const;
     /// Get this owner's position in user unit, for n consecutive items.
     std::vector<float3> getOwnerPos(bodyID_t ownerID, bodyID_t n = 1);
+    /// Write the states of owners [start, start + n), or of owners in IDs if it is not null, to a user buffer with the
+    /// given layout. Returns the number of owners written.
+    template <typename T>
+    size_t exportOwnerState(T* buffer,
+                            size_t buffer_len,
+                            bodyID_t start,
+                            bodyID_t n,
+                            const std::vector<bodyID_t>* IDs,
+                            const StateExportLayout& layout);
+    /// Write the owner pairs (and optionally the contact forces, 3 per contact) of all contacts to user buffers.
+    /// Returns the number of contacts written.
+    template <typename T>
+    size_t exportContacts(bodyID_t* idA, bodyID_t* idB, T* forces, size_t capacity);
     /// Get this owner's angular velocity, for n consecutive items.
     std::vector<float3> getOwnerAngVel(bodyID_t ownerID, bodyID_t n = 1);
     /// Get this owner's quaternion, for n consecutive items.
@@ -453,9 +508,30 @@ class DEMDynamicThread {
                                  std::vector<float3>& torques,
                                  bool torque_in_local = false);
 
+    /// Register a contact force probe and return its index.
+    unsigned int addContactForceProbe(const ContactForceProbe& probe);
+    /// Get the aggregated contact forces of a probe, as of the last force calculation.
+    ContactForceProbeResult getContactForceProbeResult(unsigned int probe);
+    /// Write the per-contact points, forces and torques (global) of a probe that keeps detail into caller buffers that
+    /// can hold capacity contacts. Returns the number of contacts.
+    size_t getContactForceProbeDetail(unsigned int probe,
+                                      float3* points,
+                                      float3* forces,
+                                      float3* torques,
+                                      size_t capacity);
+
     /// Get owner of contact geo B.
     bodyID_t getGeoOwnerID(const bodyID_t& geoB, const contact_t& type) const;
 
+    /// Get the skin used by the contact pairs currently in use (displacement-triggered CD only).
+    float getCDSkin() const { return cdRefSkin; }
+    /// Get the max owner displacement (including rotation) since the contact pairs in use were detected.
+    float getCDDisplacement() const { return *maxCDDisp; }
+    /// Get the step size dT last used.
+    double getTimeStepSize() const { return simParams->h; }
+    /// Get the number of owners that are asleep (island sleeping).
+    size_t getNumSleepingOwners();
+
     /// Let dT know that it needs a kT update, as something important may have changed, and old contact pair info is no
     /// longer valid.
     void announceCritical() { pendingCriticalUpdate = true; }
@@ -502,6 +578,8 @@ class DEMDynamicThread {
                               const std::vector<float>& ext_obj_mass_types,
                               const std::vector<float3>& ext_obj_moi_types,
                               const std::vector<unsigned int>& ext_obj_comp_num,
+                              const std::vector<float3>& ext_obj_sym_axis,
+                              const std::vector<float>& ext_obj_bound_radius,
                               const std::vector<float>& mesh_obj_mass_types,
                               const std::vector<float3>& mesh_obj_moi_types,
                               size_t nExistOwners,
@@ -534,6 +612,8 @@ class DEMDynamicThread {
                        const std::vector<float>& ext_obj_mass_types,
                        const std::vector<float3>& ext_obj_moi_types,
                        const std::vector<unsigned int>& ext_obj_comp_num,
+                       const std::vector<float3>& ext_obj_sym_axis,
+                       const std::vector<float>& ext_obj_bound_radius,
                        const std::vector<float>& mesh_obj_mass_types,
                        const std::vector<float3>& mesh_obj_moi_types,
                        const std::vector<std::shared_ptr<DEMMaterial>>& loaded_materials,
@@ -558,6 +638,8 @@ class DEMDynamicThread {
                                const std::vector<float>& ext_obj_mass_types,
                                const std::vector<float3>& ext_obj_moi_types,
                                const std::vector<unsigned int>& ext_obj_comp_num,
+                               const std::vector<float3>& ext_obj_sym_axis,
+                               const std::vector<float>& ext_obj_bound_radius,
                                const std::vector<float>& mesh_obj_mass_types,
                                const std::vector<float3>& mesh_obj_moi_types,
                                const std::vector<std::shared_ptr<DEMMaterial>>& loaded_materials,
@@ -583,8 +665,21 @@ class DEMDynamicThread {
     void migrateDataToDevice();
     // void migrateDataToHost();
 
-    // Generate contact info container based on the current contact array, and return it.
-    std::shared_ptr<ContactInfoContainer> generateContactInfo(float force_thres);
+    // Generate contact info container based on the current contact array, and return it. If use_output_filter, then
+    // contactOutputFilter is applied too.
+    std::shared_ptr<ContactInfoContainer> generateContactInfo(float force_thres, bool use_output_filter = false);
+    // Analyze the network of contacts whose force is at least force_thres, over the clumps
+    ContactNetworkSummary analyzeContactNetwork(const ContactNetworkOptions& opts, float force_thres);
+    // The contact states dumped in the last force calculation, of the pairs that were in contact
+    HostContactBatch getContactStates();
+
+    // Figure out which spheres/clumps/contacts are to be written, considering familiesNoOutput and the output filters.
+    // Host arrays need to be up-to-date before calling them.
+    std::vector<size_t> selectSpheresForOutput();
+    std::vector<size_t> selectClumpsForOutput();
+    std::vector<size_t> selectContactsForOutput(float force_thres, bool use_output_filter);
+    float3 getOwnerPosFromHost(bodyID_t ownerID) const;
+    float getOwnerNetForceFromHost(bodyID_t ownerID) const;
 
 #ifdef DEME_USE_CHPF
     void writeSpheresAsChpf(std::ofstream& ptFile);
@@ -592,8 +687,10 @@ class DEMDynamicThread {
 #endif
     void writeSpheresAsCsv(std::ofstream& ptFile);
     void writeClumpsAsCsv(std::ofstream& ptFile, unsigned int accuracy = 10);
+    void writeClumpsAsQuantized(std::ofstream& ptFile);
     void writeContactsAsCsv(std::ofstream& ptFile, float force_thres = DEME_TINY_FLOAT);
     void writeMeshesAsVtk(std::ofstream& ptFile);
+    void writeMeshesIncremental(std::ofstream& ptFile);
 
     /// Called each time when the user calls DoDynamicsThenSync.
     void startThread();
@@ -612,6 +709,8 @@ class DEMDynamicThread {
     // Return the approximate RAM usage
     size_t estimateDeviceMemUsage() const;
     size_t estimateHostMemUsage() const;
+    // Bind the arrays to records (named dT.<array>) of a memory registry
+    void bindMemoryRecords(MemoryRegistry* registry);
 
     /// Return timing inforation for this current run
     void getTiming(std::vector<std::string>& names, std::vector<double>& vals);
@@ -638,6 +737,27 @@ class DEMDynamicThread {
                        INSPECT_ENTITY_TYPE thing_to_insp,
                        CUB_REDUCE_FLAVOR reduce_flavor,
                        bool all_domain);
+    // Evaluate an inspector group of nQuantities quantities in one pass over spheres and/or owners, then return the
+    // reduced values
+    float* inspectGroupCall(const std::shared_ptr<jitify::Program>& group_kernels,
+                            unsigned int nQuantities,
+                            bool inspect_spheres,
+                            bool inspect_owners);
+    // Evaluate the distribution of a quantity of spheres, owners or contacts in nGroups groups, then return the
+    // summaries of the groups
+    std::vector<DistributionGroupResult> inspectDistributionCall(const std::shared_ptr<jitify::Program>& dist_kernels,
+                                                                 INSPECT_ENTITY_TYPE thing_to_insp,
+                                                                 bool need_contact_counts,
+                                                                 unsigned int nGroups,
+                                                                 const std::vector<float>& bin_edges,
+                                                                 const std::vector<float>& quantiles);
+    // Deposit the current clumps and contacts onto a coarse-graining grid, adding to the window sums (on the device,
+    // or on the host in n_threads threads)
+    void coarseGrainSample(const std::shared_ptr<jitify::Program>& cg_kernels,
+                           const CGGridParams& grid,
+                           bool on_device,
+                           DualArray<double>& sums,
+                           unsigned int n_threads);
 
   private:
     // Name for this class
@@ -665,17 +785,147 @@ class DEMDynamicThread {
     DualArray<scratch_t> m_reduceResArr = DualArray<scratch_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
     DualArray<scratch_t> m_reduceRes = DualArray<scratch_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
 
+    // Registered contact force probes
+    std::vector<ContactForceProbe> forceProbes;
+    // Whether the probe membership masks need to be rebuilt, and for how many owners they were built
+    bool forceProbeMasksDirty = true;
+    size_t forceProbeMaskNumOwners = 0;
+    // Incremented each time forces are calculated, so the probes know if their last results are stale
+    size_t forceCalcCounter = 0;
+    size_t forceProbeEvalStamp = SIZE_MAX;
+    // Per-owner and per-family bit masks of the probes they belong to
+    DualArray<unsigned int> probeOwnerMask = DualArray<unsigned int>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<unsigned int> probeFamilyMask = DualArray<unsigned int>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<float3> probeRefPoints = DualArray<float3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    // FORCE_PROBE_NUM_AGGREGATES floats per probe, then the contact count per probe (plus the number of detail entries)
+    DualArray<float> probeAggregates = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<size_t> probeCounts = DualArray<size_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    // Per-contact detail of the probes that keep it; they only grow, so they are reused over evaluations
+    DualArray<float3> probeDetailPoints = DualArray<float3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<float3> probeDetailForces = DualArray<float3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<float3> probeDetailTorques = DualArray<float3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<unsigned int> probeDetailIDs = DualArray<unsigned int>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    size_t numProbeDetail = 0;
+    std::vector<ContactForceProbeResult> forceProbeResults;
+
+    // Displacement-triggered CD (Verlet skin). An owner's displacement is the translation of its CoM plus the furthest
+    // any of its geometry points can go due to rotation, so a pair not in the contact list cannot come into contact
+    // before an owner in it moves by more than the skin.
+    // Distance from CoM to the furthest point of the owner's contact geometry that rotation moves (0 for one sphere)
+    DualArray<float> ownerBoundRadius = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    // Owner-frame unit axis that turning about does not move the owner's contact geometry (zero if none), so only the
+    // turning of this axis counts
+    DualArray<float3> ownerSymAxis = DualArray<float3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    // Owner positions and orientations at which the contact pairs in use were detected, and those of the pending order
+    DualArray<double3> cdRefPos = DualArray<double3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<float4> cdRefOriQ = DualArray<float4>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<double3> cdOrderPos = DualArray<double3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<float4> cdOrderOriQ = DualArray<float4>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualStruct<float> maxCDDisp = DualStruct<float>(0.f);
+    DualStruct<size_t> numForceBearingContacts = DualStruct<size_t>(0);
+    // The skin to send with the next order, and the skins of the pending order and the contact pairs in use
+    float cdSkin = 0.f;
+    float cdOrderSkin = 0.f;
+    float cdRefSkin = 0.f;
+    bool cdOrderPending = false;
+    // Steps run with the contact pairs in use, and the force calculation time when they were taken in
+    uint64_t cdStepsSinceRef = 0;
+    double cdRefForceTime = 0.0;
+
+    // Chooses the skin of displacement-triggered CD from the observed CD cycles
+    CDSkinTuner cdSkinTuner = CDSkinTuner();
+
+    // Variable time step. The max velocity after the last step feeds the step size choice of the next one.
+    TimeStepController tsController = TimeStepController();
+    DualStruct<float> stepMaxVel = DualStruct<float>(0.f);
+    bool stepMaxVelKnown = false;
+    // Reduce the current system max velocity into stepMaxVel
+    inline float measureStepMaxVel();
+    // Pick the size of the next step (no larger than remaining) and, if it may be rejected, save the state it starts
+    // from
+    inline void beginVariableStep(double remaining);
+    // Judge the step just taken; if rejected, the saved state is restored
+    inline bool finishVariableStep();
+    // The device arrays a step changes, which are saved (into stepUndoBuffer) and restored when steps can be rejected
+    std::vector<std::pair<void*, size_t>> stepStateArrays();
+    // The saved state, all arrays in one buffer at stepUndoOffsets. It is allocated at the first step that can be
+    // rejected and only grows after, so saving the state allocates nothing.
+    DeviceArray<scratch_t> stepUndoBuffer = DeviceArray<scratch_t>(&m_approxDeviceBytesUsed);
+    std::vector<size_t> stepUndoOffsets;
+
+    // Compute the max owner displacement since the snapshot of the contact pairs in use, into maxCDDisp
+    inline float computeMaxCDDisplacement();
+    // Called when kT's produce is taken in: its snapshot and skin become the reference, and the cycle of the previous
+    // contact pairs is reported to the skin tuner
+    inline void promoteCDOrderSnapshot();
+    // Displacement-triggered CD scheduling that runs before each step, in place of the step-count based one
+    inline void advanceDisplacementTriggeredCD();
+
+    // Rebuild the probe membership masks
+    void buildContactForceProbeMasks();
+    // Reduce the contact forces of all probes in one pass, if not already done since the last force calculation
+    void evaluateContactForceProbes();
+
     // Migrate contact history to fit the structure of the newly received contact array
     inline void migrateEnduringContacts();
+    // The same for the packed contact wildcard pools: only the records of the contacts in scope are moved
+    inline void migrateWildcardPools();
 
     // Update clump-based acceleration array based on sphere-based force array
     inline void calculateForces();
 
+    // Contact type-segmented force calculation. forceSegmentTypeMask has the contact types the specialized kernels are
+    // compiled for. The launch plan is renewed when new contact pairs arrive; if the pairs turn out not to be sorted by
+    // type, the generic kernel is used.
+    unsigned int forceSegmentTypeMask = 0;
+
+    // The packed contact wildcard pools of the force model
+    std::vector<ContactWildcardPool> wildcardPools;
+    DualArray<contactPairs_t> contactTypeSegBounds =
+        DualArray<contactPairs_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    std::vector<ForceSegmentLaunch> forceSegmentPlan;
+    bool forceSegmentsStale = true;
+    bool forceSegmentsUsable = false;
+    // Find the contact type segments and plan the kernel launches
+    inline void planForceSegments(size_t nContactPairs);
+
     // Update clump pos/oriQ and vel/omega based on acceleration
     inline void integrateOwnerMotions();
 
+    // Multi-rate integration of one time step: the slow contacts' forces are computed once, and the fast contacts'
+    // forces and the integration are done in sub-steps, with the slow contacts' impulse applied in the first one
+    inline void advanceMultiRateStep();
+    // Set the contact class, step size and time the next force pass or integration is for
+    inline void setMultiRatePass(notStupidBool_t pass, float h, double t);
+
+    // Island sleeping. The quiet records are advanced and waking is done on device at each step; every
+    // sleepCheckInterval steps, the candidates for sleeping are grouped into islands on the host.
+    SleepIslandManager sleepManager = SleepIslandManager();
+    DualArray<bodyID_t> ownerSleepIsland = DualArray<bodyID_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<family_t> ownerSleepFamily = DualArray<family_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<notStupidBool_t> sleepIslandWoken =
+        DualArray<notStupidBool_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    // Quiet steps of each owner, its bounding radius (for the rotational part of its kinetic energy), and the sleeping
+    // role (SLEEP_ROLE) of each family
+    DualArray<unsigned int> ownerQuietSteps =
+        DualArray<unsigned int>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<float> ownerSleepRadius = DualArray<float>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<notStupidBool_t> familySleepRole =
+        DualArray<notStupidBool_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    unsigned int sleepCheckInterval = 100;
+    unsigned int stepsSinceSleepCheck = 0;
+    // Whether any owner is marked asleep or static on device (if not, waking is skipped)
+    bool hasSleepMarks = false;
+    // Wake the sleeping owners that should be, before the forces of a step are computed
+    inline void wakeSleepingIslands();
+    // Advance the quiet records by a step that has been taken
+    inline void accumulateQuietSteps();
+    // Find the quiescent islands and put them to sleep
+    void updateSleepingIslands();
+
     // If kT provides fresh CD results, we unpack and use it
     inline void ifProduceFreshThenUseItAndSendNewOrder();
+    inline void sendNewOrder();
     inline void ifProduceFreshThenUseIt();
     inline void unpack_impl();
 
@@ -701,6 +951,15 @@ class DEMDynamicThread {
     // The dT-side allocations that can be done at initialization time
     void initAllocation();
 
+    // Host access to contact wildcard no.wc_num of a contact, dense or pooled; contactWildcardToHost(wc_num) must have
+    // been called. Setting a pooled one creates a record for the contact if it is in scope and has none.
+    float getContactWildcardOnHost(unsigned int wc_num, size_t cnt) const;
+    void setContactWildcardOnHost(unsigned int wc_num, size_t cnt, float val);
+    void contactWildcardToHost(unsigned int wc_num);
+    void contactWildcardToDevice(unsigned int wc_num);
+    // Whether a contact is in the scope of a pool, judged on the host (contact and family arrays must be on the host)
+    bool contactInWildcardPoolOnHost(unsigned int pool, size_t cnt) const;
+
     // Wildcard setting impl function
     void setFamilyContactWildcardValue_impl(
         unsigned int N1,
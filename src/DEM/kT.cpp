@@ -5,6 +5,7 @@
 
 #include <cstring>
 #include <iostream>
+#include <map>
 #include <thread>
 
 #include <core/ApiVersion.h>
@@ -21,16 +22,17 @@ namespace deme {
 inline void DEMKinematicThread::transferArraysResize(size_t nContactPairs) {
     // These buffers are on dT
     DEME_GPU_CALL(cudaSetDevice(dT->streamInfo.device));
+    // They follow the capacity of the contact arrays, so they may shrink as well
     dT->buffer_size = nContactPairs;
-    DEME_DEVICE_ARRAY_RESIZE(dT->idGeometryA_buffer, nContactPairs);
-    DEME_DEVICE_ARRAY_RESIZE(dT->idGeometryB_buffer, nContactPairs);
-    DEME_DEVICE_ARRAY_RESIZE(dT->contactType_buffer, nContactPairs);
+    dT->idGeometryA_buffer.resize(nContactPairs, /*allow_shrink=*/true);
+    dT->idGeometryB_buffer.resize(nContactPairs, /*allow_shrink=*/true);
+    dT->contactType_buffer.resize(nContactPairs, /*allow_shrink=*/true);
     granData->pDTOwnedBuffer_idGeometryA = dT->idGeometryA_buffer.data();
     granData->pDTOwnedBuffer_idGeometryB = dT->idGeometryB_buffer.data();
     granData->pDTOwnedBuffer_contactType = dT->contactType_buffer.data();
 
     if (!solverFlags.isHistoryless) {
-        DEME_DEVICE_ARRAY_RESIZE(dT->contactMapping_buffer, nContactPairs);
+        dT->contactMapping_buffer.resize(nContactPairs, /*allow_shrink=*/true);
         granData->pDTOwnedBuffer_contactMapping = dT->contactMapping_buffer.data();
     }
     // Unset the device change we just made
@@ -41,48 +43,28 @@ inline void DEMKinematicThread::transferArraysResize(size_t nContactPairs) {
 }
 
 void DEMKinematicThread::calibrateParams() {
-    double prev_time, curr_time;
-    // If it is true, then it's the AccumTimer telling us it is the right time to decide how to change bin size
-    if (CDAccumTimer.QueryOn(prev_time, curr_time, stateParams.binChangeObserveSteps)) {
-        // Auto-adjust bin size
-        if (solverFlags.autoBinSize) {
-            int speed_dir = sign_func(stateParams.binCurrentChangeRate);
-            // Note the speed can be 0, yet we find performance variance. Then this is purely noise. We still wish the
-            // bin size to change in the next iteration, so we assign a direction randomly.
-            if (speed_dir == 0)
-                speed_dir = (randomZeroOrOne() == 0) ? -1 : 1;
-            float speed_update;
-            if (curr_time < prev_time) {
-                // If there is improvement, then we accelerate the current change direction
-                speed_update = speed_dir * stateParams.binChangeRateAcc * stateParams.binTopChangeRate;
-            } else {
-                // If no improvement, revert the direction
-                speed_update = -speed_dir * stateParams.binChangeRateAcc * stateParams.binTopChangeRate;
-            }
-            // But, if the bin size is going to get too big or too small, a penalty is enforced
-            if (stateParams.maxSphFoundInBin > stateParams.binChangeUpperSafety * simParams->errOutBinSphNum ||
-                stateParams.maxTriFoundInBin > stateParams.binChangeUpperSafety * simParams->errOutBinTriNum) {
-                // Then the size must start to decrease
-                speed_update = -1.0 * stateParams.binChangeRateAcc * stateParams.binTopChangeRate;
-            }
-            if (stateParams.numBins >
-                stateParams.binChangeLowerSafety * (double)(std::numeric_limits<binID_t>::max())) {
-                // Then size must start to increase
-                speed_update = 1.0 * stateParams.binChangeRateAcc * stateParams.binTopChangeRate;
-            }
-
-            // Acc is done. Now apply it to bin size change speed
-            stateParams.binCurrentChangeRate += speed_update;
-            // But, the speed must fall in range
-            stateParams.binCurrentChangeRate = clampBetween(
-                stateParams.binCurrentChangeRate, -stateParams.binTopChangeRate, stateParams.binTopChangeRate);
-
-            // Change bin size
-            if (stateParams.binCurrentChangeRate > 0) {
-                simParams->binSize *= (1. + stateParams.binCurrentChangeRate);
-            } else {
-                simParams->binSize /= (1. - stateParams.binCurrentChangeRate);
-            }
+    // Auto-adjust bin size. If nothing was binned (as in hierarchical-grid mode with no binned facets), the bin size
+    // does not matter.
+    if (solverFlags.autoBinSize && stateParams.numBinSphereTouchPairs > 0) {
+        BinSizeSample sample;
+        sample.binSize = simParams->binSize;
+        sample.numSpheres = simParams->nSpheresGM;
+        sample.numTouchPairs = stateParams.numBinSphereTouchPairs;
+        sample.numActiveBins = stateParams.numActiveBins;
+        // In hierarchical-grid mode, spheres are not pairwise checked in bins, so only the triangle count matters
+        sample.maxSpheresInBin = solverFlags.useHierGridCD ? 0. : stateParams.maxSphFoundInBin;
+        sample.maxTrianglesInBin = stateParams.maxTriFoundInBin;
+        sample.numBins = stateParams.numBins;
+        sample.cdTime = lastCDTime;
+        binSizeTuner.Record(sample);
+
+        // Past the safety points, the bin size is forced to shrink or expand
+        binSizeTuner.SetSafetyLimits(stateParams.binChangeUpperSafety * simParams->errOutBinSphNum,
+                                     stateParams.binChangeUpperSafety * simParams->errOutBinTriNum,
+                                     stateParams.binChangeLowerSafety * (double)(std::numeric_limits<binID_t>::max()));
+        double new_size;
+        if (binSizeTuner.Query(simParams->binSize, new_size)) {
+            simParams->binSize = new_size;
             // Register the new bin size
             stateParams.numBins =
                 hostCalcBinNum(simParams->nbX, simParams->nbY, simParams->nbZ, simParams->voxelSize, simParams->binSize,
@@ -90,7 +72,13 @@ void DEMKinematicThread::calibrateParams() {
 
             DEME_DEBUG_PRINTF("Bin size is now: %.7g", simParams->binSize);
             DEME_DEBUG_PRINTF("Total num of bins is now: %zu", stateParams.numBins);
+            if (binSizeTuner.IsModelReady()) {
+                DEME_DEBUG_PRINTF("Predicted CD time at this bin size: %.7gs", binSizeTuner.Predict(new_size));
+            }
         }
+    }
+    double prev_time, curr_time;
+    if (CDAccumTimer.QueryOn(prev_time, curr_time, stateParams.binChangeObserveSteps)) {
         DEME_DEBUG_PRINTF("kT runtime per step: %.7gs", CDAccumTimer.GetPrevTime());
     }
     // binSize is now calculated, we need to migrate that to device
@@ -121,6 +109,10 @@ inline void DEMKinematicThread::unpackMyBuffer() {
     DEME_GPU_CALL(cudaMemcpy(&(stateParams.ts), &(stateParams.ts_buffer), sizeof(float), cudaMemcpyDeviceToDevice));
     DEME_GPU_CALL(cudaMemcpy(&(stateParams.maxDrift), &(stateParams.maxDrift_buffer), sizeof(unsigned int),
                              cudaMemcpyDeviceToDevice));
+    if (solverFlags.useDisplacementCD) {
+        DEME_GPU_CALL(
+            cudaMemcpy(&(stateParams.skin), &(stateParams.skin_buffer), sizeof(float), cudaMemcpyDeviceToDevice));
+    }
 
     // Whatever drift value dT says, kT listens; unless kinematicMaxFutureDrift is negative in which case the user
     // explicitly said not caring the future drift.
@@ -150,7 +142,15 @@ inline void DEMKinematicThread::unpackMyBuffer() {
     }
 
     // kT will need to derive the thickness of the CD margin, based on dT's info on system vel.
-    if (!solverFlags.isExpandFactorFixed) {
+    if (solverFlags.useDisplacementCD) {
+        // In displacement-triggered CD, the margin is the skin dT sent along with this order
+        size_t blocks_needed = (simParams->nOwnerBodies + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+        misc_kernels->kernel("fillMarginFromSkin")
+            .instantiate()
+            .configure(dim3(blocks_needed), dim3(DEME_MAX_THREADS_PER_BLOCK), 0, streamInfo.stream)
+            .launch(&simParams, &granData, &(stateParams.skin), (size_t)(simParams->nOwnerBodies));
+        DEME_GPU_CALL(cudaStreamSynchronize(streamInfo.stream));
+    } else if (!solverFlags.isExpandFactorFixed) {
         // This kernel will turn absv to marginSize, and if a vel is over max, it will clamp it.
         // Converting to size_t is SUPER important... CUDA kernel call basically does not have type conversion.
         size_t blocks_needed = (simParams->nOwnerBodies + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
@@ -186,17 +186,35 @@ inline void DEMKinematicThread::unpackMyBuffer() {
                                  cudaMemcpyDeviceToDevice));
         DEME_GPU_CALL(cudaMemcpy(granData->relPosNode3, relPosNode3_buffer.data(), simParams->nTriGM * sizeof(float3),
                                  cudaMemcpyDeviceToDevice));
+        if (simParams->nMeshGrids > 0) {
+            excludeDeformedMeshesFromGrids();
+        }
         // dT won't be sending if kT is loading, so it is safe
         solverFlags.willMeshDeform = false;
     }
 }
 
+void DEMKinematicThread::contactArraysReallocate(size_t nContactPairs) {
+    idGeometryA.reallocate(nContactPairs, 0);
+    idGeometryB.reallocate(nContactPairs, 0);
+    contactType.reallocate(nContactPairs, NOT_A_CONTACT);
+    if (!solverFlags.isHistoryless) {
+        contactPersistency.reallocate(nContactPairs, CONTACT_NOT_PERSISTENT);
+        previous_idGeometryA.reallocate(nContactPairs, 0);
+        previous_idGeometryB.reallocate(nContactPairs, 0);
+        previous_contactType.reallocate(nContactPairs, NOT_A_CONTACT);
+        contactMapping.reallocate(nContactPairs, NULL_MAPPING_PARTNER);
+    }
+    // Re-packing pointers is automatic, but kernels read them from the device copy
+    granData.toDevice();
+}
+
 inline void DEMKinematicThread::sendToTheirBuffer() {
     DEME_GPU_CALL(cudaMemcpy(granData->pDTOwnedBuffer_nContactPairs, &(solverScratchSpace.numContacts), sizeof(size_t),
                              cudaMemcpyDeviceToDevice));
-    // Resize dT owned buffers before usage
-    if (*solverScratchSpace.numContacts > dT->buffer_size) {
-        transferArraysResize(*solverScratchSpace.numContacts);
+    // Resize dT owned buffers before usage, to the capacity of the contact arrays
+    if (*solverScratchSpace.numContacts > dT->buffer_size || dT->buffer_size > contactCapacity.capacity()) {
+        transferArraysResize(DEME_MAX(contactCapacity.capacity(), *solverScratchSpace.numContacts));
     }
 
     DEME_GPU_CALL(cudaMemcpy(granData->pDTOwnedBuffer_idGeometryA, granData->idGeometryA,
@@ -287,6 +305,13 @@ void DEMKinematicThread::workerThread() {
                              contactPersistency, contactMapping, streamInfo.stream, solverScratchSpace, timers,
                              stateParams);
             CDAccumTimer.End();
+            lastCDTime = CDAccumTimer.GetLastTime();
+
+            // The contact arrays hold just this CD's contacts now (previous_* are a copy), so this is when they can
+            // be grown ahead of need, or given back memory after a sustained drop
+            if (contactCapacity.observe(*solverScratchSpace.numContacts)) {
+                contactArraysReallocate(contactCapacity.capacity());
+            }
 
             timers.GetTimer("Send to dT buffer").start();
             {
@@ -414,10 +439,82 @@ void DEMKinematicThread::resetUserCallStat() {
     // My ingredient production date is... unknown now
     pSchedSupport->kinematicIngredProdDateStamp = -1;
 
-    // We also reset the CD timer (for adjusting bin size)
+    // We also reset the CD timer, and the bin size tuner forgets its unfinished observation (but not what it learned)
     CDAccumTimer.Clear();
-    // Reset bin size change speed
-    stateParams.binCurrentChangeRate = 0.;
+    binSizeTuner.DiscardPending();
+}
+
+void DEMKinematicThread::bindMemoryRecords(MemoryRegistry* registry) {
+    if (!registry)
+        return;
+    DEME_REGISTER_MEMORY(registry, "kT.", idGeometryA, "contact");
+    DEME_REGISTER_MEMORY(registry, "kT.", idGeometryB, "contact");
+    DEME_REGISTER_MEMORY(registry, "kT.", contactType, "contact");
+    DEME_REGISTER_MEMORY(registry, "kT.", previous_idGeometryA, "contact");
+    DEME_REGISTER_MEMORY(registry, "kT.", previous_idGeometryB, "contact");
+    DEME_REGISTER_MEMORY(registry, "kT.", previous_contactType, "contact");
+    DEME_REGISTER_MEMORY(registry, "kT.", contactMapping, "contact");
+    DEME_REGISTER_MEMORY(registry, "kT.", contactPersistency, "contact");
+    DEME_REGISTER_MEMORY(registry, "kT.", voxelID, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", locX, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", locY, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", locZ, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriQw, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriQx, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriQy, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriQz, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", marginSize, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", familyID, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", voxelID_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", locX_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", locY_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", locZ_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriQ0_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriQ1_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriQ2_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriQ3_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", familyID_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", absVel_buffer, "owner");
+    DEME_REGISTER_MEMORY(registry, "kT.", radiiSphere, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosSphereX, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosSphereY, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosSphereZ, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosNode1, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosNode2, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosNode3, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosEntityX, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosEntityY, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosEntityZ, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriEntityX, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriEntityY, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", oriEntityZ, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", sizeEntity1, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", sizeEntity2, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", sizeEntity3, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", ownerClumpBody, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", ownerMesh, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", clumpComponentOffset, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", clumpComponentOffsetExt, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosNode1_buffer, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosNode2_buffer, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", relPosNode3_buffer, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", meshGridInfo, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", meshGridCellStart, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", meshGridCellTris, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", triGridCellLo, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", triInMeshGrid, "geometry");
+    DEME_REGISTER_MEMORY(registry, "kT.", familyMaskMatrix, "family");
+    DEME_REGISTER_MEMORY(registry, "kT.", familyExtraMarginSize, "family");
+    DEME_REGISTER_MEMORY(registry, "kT.", simParams, "params");
+    DEME_REGISTER_MEMORY(registry, "kT.", granData, "params");
+    DEME_REGISTER_MEMORY(registry, "kT.", stateParams.maxVel, "params");
+    DEME_REGISTER_MEMORY(registry, "kT.", stateParams.ts_buffer, "params");
+    DEME_REGISTER_MEMORY(registry, "kT.", stateParams.ts, "params");
+    DEME_REGISTER_MEMORY(registry, "kT.", stateParams.maxDrift_buffer, "params");
+    DEME_REGISTER_MEMORY(registry, "kT.", stateParams.maxDrift, "params");
+    DEME_REGISTER_MEMORY(registry, "kT.", stateParams.skin_buffer, "params");
+    DEME_REGISTER_MEMORY(registry, "kT.", stateParams.skin, "params");
+    solverScratchSpace.setMemoryRegistry(registry, "kT.");
 }
 
 size_t DEMKinematicThread::estimateDeviceMemUsage() const {
@@ -461,6 +558,11 @@ void DEMKinematicThread::packDataPointers() {
     relPosNode1.bindDevicePointer(&(granData->relPosNode1));
     relPosNode2.bindDevicePointer(&(granData->relPosNode2));
     relPosNode3.bindDevicePointer(&(granData->relPosNode3));
+    meshGridInfo.bindDevicePointer(&(granData->meshGridInfo));
+    meshGridCellStart.bindDevicePointer(&(granData->meshGridCellStart));
+    meshGridCellTris.bindDevicePointer(&(granData->meshGridCellTris));
+    triGridCellLo.bindDevicePointer(&(granData->triGridCellLo));
+    triInMeshGrid.bindDevicePointer(&(granData->triInMeshGrid));
 
     // Template array pointers
     radiiSphere.bindDevicePointer(&(granData->radiiSphere));
@@ -499,6 +601,11 @@ void DEMKinematicThread::migrateDataToDevice() {
     relPosNode1.toDeviceAsync(streamInfo.stream);
     relPosNode2.toDeviceAsync(streamInfo.stream);
     relPosNode3.toDeviceAsync(streamInfo.stream);
+    meshGridInfo.toDeviceAsync(streamInfo.stream);
+    meshGridCellStart.toDeviceAsync(streamInfo.stream);
+    meshGridCellTris.toDeviceAsync(streamInfo.stream);
+    triGridCellLo.toDeviceAsync(streamInfo.stream);
+    triInMeshGrid.toDeviceAsync(streamInfo.stream);
 
     radiiSphere.toDeviceAsync(streamInfo.stream);
     relPosSphereX.toDeviceAsync(streamInfo.stream);
@@ -700,6 +807,7 @@ void DEMKinematicThread::allocateGPUArrays(size_t nOwnerBodies,
             DEME_DUAL_ARRAY_RESIZE(previous_contactType, cnt_arr_size, NOT_A_CONTACT);
             DEME_DUAL_ARRAY_RESIZE(contactMapping, cnt_arr_size, NULL_MAPPING_PARTNER);
         }
+        contactCapacity.setCapacity(idGeometryA.size());
     }
 }
 
@@ -831,6 +939,9 @@ void DEMKinematicThread::populateEntityArrays(const std::vector<std::shared_ptr<
         // DEME_DEBUG_PRINTF("kT just loaded a mesh in family %u", +(this_family_num));
         // DEME_DEBUG_PRINTF("Number of triangle facets loaded thus far: %zu", k);
     }
+
+    // Rigid meshes get their local-frame grids now, once
+    buildMeshLocalGrids();
 }
 
 void DEMKinematicThread::initGPUArrays(const std::vector<std::shared_ptr<DEMClumpBatch>>& input_clump_batches,
@@ -950,4 +1061,98 @@ void DEMKinematicThread::updateTriNodeRelPos(size_t start, const std::vector<DEM
     syncMemoryTransfer();
 }
 
+void DEMKinematicThread::buildMeshLocalGrids() {
+    simParams->nMeshGrids = 0;
+    simParams->nTriInMeshGrids = 0;
+    if (!solverFlags.useMeshLocalGrid || simParams->nTriGM == 0) {
+        return;
+    }
+    // Facets of each (non-deformed) mesh; ordered, so the grids are always laid out the same way
+    std::map<bodyID_t, std::vector<bodyID_t>> ownerFacets;
+    for (bodyID_t i = 0; i < simParams->nTriGM; i++) {
+        if (deformedMeshOwners.count(ownerMesh[i]) == 0) {
+            ownerFacets[ownerMesh[i]].push_back(i);
+        }
+    }
+
+    DEME_DUAL_ARRAY_RESIZE(triInMeshGrid, simParams->nTriGM, 0);
+    DEME_DUAL_ARRAY_RESIZE(triGridCellLo, simParams->nTriGM, make_int3(0, 0, 0));
+    std::vector<MeshGridInfo> infos;
+    std::vector<size_t> cellStart(1, 0);
+    std::vector<bodyID_t> cellTris;
+    for (bodyID_t i = 0; i < simParams->nTriGM; i++) {
+        triInMeshGrid[i] = 0;
+    }
+    for (const auto& facets : ownerFacets) {
+        MeshLocalGrid grid;
+        if (!grid.Build(facets.second, relPosNode1.host(), relPosNode2.host(), relPosNode3.host(),
+                        meshLocalGridCellSize)) {
+            DEME_WARNING("Mesh (owner %zu) has degenerate facets, so it will be binned at each contact detection.",
+                         (size_t)facets.first);
+            continue;
+        }
+        infos.push_back(grid.GetInfo(facets.first, cellStart.size() - 1));
+        const size_t base = cellTris.size();
+        const auto& localStart = grid.GetCellStart();
+        for (size_t c = 1; c < localStart.size(); c++) {
+            cellStart.push_back(base + localStart[c]);
+        }
+        cellTris.insert(cellTris.end(), grid.GetCellTris().begin(), grid.GetCellTris().end());
+        const auto& tris = grid.GetTriIDs();
+        simParams->nTriInMeshGrids += tris.size();
+        for (size_t j = 0; j < tris.size(); j++) {
+            triInMeshGrid[tris[j]] = 1;
+            triGridCellLo[tris[j]] = grid.GetTriCellLo()[j];
+        }
+    }
+
+    DEME_DUAL_ARRAY_RESIZE_NOVAL(meshGridInfo, infos.size());
+    DEME_DUAL_ARRAY_RESIZE(meshGridCellStart, cellStart.size(), 0);
+    DEME_DUAL_ARRAY_RESIZE(meshGridCellTris, cellTris.size(), 0);
+    for (size_t i = 0; i < infos.size(); i++) {
+        meshGridInfo[i] = infos[i];
+    }
+    for (size_t i = 0; i < cellStart.size(); i++) {
+        meshGridCellStart[i] = cellStart[i];
+    }
+    for (size_t i = 0; i < cellTris.size(); i++) {
+        meshGridCellTris[i] = cellTris[i];
+    }
+    simParams->nMeshGrids = infos.size();
+    DEME_DEBUG_PRINTF("kT built local-frame grids for %u rigid meshes, with %zu cells and %zu facet entries in total.",
+                      simParams->nMeshGrids, cellStart.size() - 1, cellTris.size());
+}
+
+void DEMKinematicThread::excludeDeformedMeshesFromGrids() {
+    // kT's host-side node arrays still have the shapes the grids were built from
+    const size_t n = simParams->nTriGM;
+    std::vector<float3> old1(relPosNode1.host(), relPosNode1.host() + n);
+    std::vector<float3> old2(relPosNode2.host(), relPosNode2.host() + n);
+    std::vector<float3> old3(relPosNode3.host(), relPosNode3.host() + n);
+    relPosNode1.toHost();
+    relPosNode2.toHost();
+    relPosNode3.toHost();
+    auto differ = [](const float3& a, const float3& b) { return a.x != b.x || a.y != b.y || a.z != b.z; };
+    bool changed = false;
+    for (size_t i = 0; i < n; i++) {
+        if (triInMeshGrid[i] &&
+            (differ(old1[i], relPosNode1[i]) || differ(old2[i], relPosNode2[i]) || differ(old3[i], relPosNode3[i]))) {
+            deformedMeshOwners.insert(ownerMesh[i]);
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    buildMeshLocalGrids();
+    meshGridInfo.toDevice();
+    meshGridCellStart.toDevice();
+    meshGridCellTris.toDevice();
+    triGridCellLo.toDevice();
+    triInMeshGrid.toDevice();
+    // Arrays might have been re-allocated
+    simParams.toDevice();
+    granData.toDevice();
+}
+
 }  // namespace deme
@@ -10,6 +10,7 @@
 #include <vector>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 // #include <set>
 
 #include <core/ApiVersion.h>
@@ -24,6 +25,8 @@
 #include <DEM/BdrsAndObjs.h>
 #include <DEM/Defines.h>
 #include <DEM/Structs.h>
+#include <DEM/utils/MeshLocalGrid.hpp>
+#include <DEM/utils/BinSizeTuner.hpp>
 
 // Forward declare jitify::Program to avoid downstream dependency
 namespace jitify {
@@ -188,6 +191,18 @@ class DEMKinematicThread {
     DualArray<bodyID_t> ownerClumpBody = DualArray<bodyID_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
     DualArray<bodyID_t> ownerMesh = DualArray<bodyID_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
 
+    // Local-frame facet grids of rigid meshes, concatenated (see MeshGridInfo)
+    DualArray<MeshGridInfo> meshGridInfo = DualArray<MeshGridInfo>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<size_t> meshGridCellStart = DualArray<size_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<bodyID_t> meshGridCellTris = DualArray<bodyID_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<int3> triGridCellLo = DualArray<int3>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    DualArray<notStupidBool_t> triInMeshGrid =
+        DualArray<notStupidBool_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
+    // User-specified grid cell size (0 means picked based on facet sizes)
+    float meshLocalGridCellSize = 0.f;
+    // Owners of meshes that have been deformed; they go back to being binned at each CD
+    std::unordered_set<bodyID_t> deformedMeshOwners;
+
     // The ID that maps this sphere component's geometry-defining parameters, when this component is jitified
     DualArray<clumpComponentOffset_t> clumpComponentOffset =
         DualArray<clumpComponentOffset_t>(&m_approxHostBytesUsed, &m_approxDeviceBytesUsed);
@@ -209,6 +224,10 @@ class DEMKinematicThread {
 
     kTStateParams stateParams;
 
+    // Capacity of the contact arrays (and the dT-owned buffers), which grows ahead of the contact number and shrinks
+    // after it stays low for long
+    CapacityManager contactCapacity;
+
   public:
     friend class DEMSolver;
     friend class DEMDynamicThread;
@@ -265,6 +284,8 @@ class DEMKinematicThread {
     /// Return the approximate RAM usage
     size_t estimateDeviceMemUsage() const;
     size_t estimateHostMemUsage() const;
+    // Bind the arrays to records (named kT.<array>) of a memory registry
+    void bindMemoryRecords(MemoryRegistry* registry);
 
     /// Resize arrays
     void allocateGPUArrays(size_t nOwnerBodies,
@@ -383,6 +404,11 @@ class DEMKinematicThread {
     /// positions in `triangles', by the amount stipulated in updates.
     void updateTriNodeRelPos(size_t start, const std::vector<DEMTriangle>& updates);
 
+    /// Build the local-frame facet grids for all meshes that are not deformed (host side only)
+    void buildMeshLocalGrids();
+    /// After receiving mesh deformation, remove the meshes that changed shape from the local-frame grids
+    void excludeDeformedMeshesFromGrids();
+
     /// Update (overwrite) kT's previous contact array based on input
     void updatePrevContactArrays(DualStruct<DEMDataDT>& dT_data, size_t nContacts);
 
@@ -401,6 +427,8 @@ class DEMKinematicThread {
     void sendToTheirBuffer();
     // Resize dT's buffer arrays based on the number of contact pairs
     inline void transferArraysResize(size_t nContactPairs);
+    // Reallocate the contact arrays to this many elements, shrinking if smaller
+    void contactArraysReallocate(size_t nContactPairs);
     // Automatic adjustments to sim params
     void calibrateParams();
     // The kT-side allocations that can be done at initialization time
@@ -421,6 +449,7 @@ class DEMKinematicThread {
     class AccumTimer {
       private:
         double prev_time = DEME_HUGE_FLOAT;
+        double last_time = 0.0;
         unsigned int cached_count = 0;
         Timer<double> timer;
 
@@ -429,11 +458,15 @@ class DEMKinematicThread {
         ~AccumTimer() {}
         void Begin() { timer.start(); }
         void End() {
+            double before = timer.GetTimeSeconds();
             timer.stop();
+            last_time = timer.GetTimeSeconds() - before;
             cached_count++;
         }
 
         double GetPrevTime() { return prev_time; }
+        // Time of the last Begin--End pair alone
+        double GetLastTime() { return last_time; }
 
         void Query(double& prev, double& curr) {
             double avg_time = timer.GetTimeSeconds() / (double)(cached_count);
@@ -463,6 +496,10 @@ class DEMKinematicThread {
     };
 
     AccumTimer CDAccumTimer = AccumTimer();
+    // Wall time of the most recent CD, read by dT when it weighs the cost of CD against the cost of a larger skin
+    std::atomic<double> lastCDTime = 0.0;
+    // Picks the bin size from a cost model fitted to the observed CD times
+    BinSizeTuner binSizeTuner;
 
     // A collection of migrate-to-host methods. Bulk migrate-to-host is by nature on-demand only.
     void migrateFamilyToHost();
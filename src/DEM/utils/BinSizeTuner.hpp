@@ -0,0 +1,486 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_BIN_SIZE_TUNER_HPP
+#define DEME_BIN_SIZE_TUNER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <vector>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Cost-model-driven bin size tuner
+//
+// kT's CD time is modelled after its CUB phases:
+//     T = c0 + c1 * P + c2 * A + c3 * P^2 / A
+// where P is the number of sphere--bin touch pairs (counted, populated, radix sorted and run-length encoded), A is the
+// number of active bins (one block each) and P^2 / A stands for the per-bin pairwise search (sum of n_b^2 for n_b
+// spheres in bin b, assuming they are spread evenly). The coefficients are fitted to the observed (averaged) CD times
+// by non-negative least squares. To predict at a bin size s that has not been tried, P and A are extrapolated with the
+// geometry of the packing: a sphere of (CD) diameter D touches (1 + D / s)^3 bins on average, so
+// P(s) = N (1 + D / s)^3, and the occupied volume V gives A(s) = V / s^3. D and V are measured from the same samples.
+//
+// Decisions are made once per observation window. Until the samples cover 3 different bin sizes, the tuner probes
+// around the current size. After that, it jumps to the predicted optimum, but never further than a trust factor
+// outside the range of sizes it has seen (so the model is refined before it is trusted far away), and only if the
+// predicted saving beats both a relative hysteresis and the noise level of the fit. If the model sees nothing to gain
+// but the fastest size measured is at the edge of the sizes tried, it probes past that edge, so the optimum ends up
+// bracketed by measurements. If the observed time starts to disagree with the model, the flow has probably changed, and
+// the old samples are dropped. The safety limits on the geometries per bin and on the number of bins always win.
+//
+// Only the standard library is used here; DEMtest_BinSizeTuner drives the tuner with synthetic timing traces.
+// -----------------------------------------------------------------------------
+
+// What kT knows about one CD
+struct BinSizeSample {
+    double binSize = 0.;
+    double numSpheres = 0.;
+    double numTouchPairs = 0.;
+    double numActiveBins = 0.;
+    double maxSpheresInBin = 0.;
+    double maxTrianglesInBin = 0.;
+    double numBins = 0.;
+    double cdTime = 0.;
+};
+
+class BinSizeTuner {
+  public:
+    BinSizeTuner() {}
+    ~BinSizeTuner() {}
+
+    /// Number of CDs averaged into one sample before each decision
+    void SetObserveSteps(unsigned int n) { observeSteps = std::max(1u, n); }
+    /// Relative size change used when probing around the current bin size
+    void SetProbeRatio(double r) { probeRatio = std::max(0.01, r); }
+    /// Relative predicted saving needed before the tuner moves the bin size
+    void SetHysteresis(double h) { hysteresis = std::max(0., h); }
+    /// The bin size must not get so large that a bin has more than max_sph spheres or max_tri triangles, or so small
+    /// that there are more than max_bins bins
+    void SetSafetyLimits(double max_sph, double max_tri, double max_bins) {
+        maxSphInBin = max_sph;
+        maxTriInBin = max_tri;
+        maxNumBins = max_bins;
+    }
+
+    /// Record one CD
+    void Record(const BinSizeSample& s) {
+        if (!(s.cdTime >= 0.) || s.binSize <= 0.)
+            return;
+        pending.push_back(s);
+    }
+
+    /// Forget the CDs of an unfinished observation window (but not the learned samples), e.g. after a timer reset
+    void DiscardPending() { pending.clear(); }
+
+    /// Once an observation window is complete, decide on the bin size. Returns true if it should change to new_size.
+    bool Query(double cur_size, double& new_size) {
+        if (pending.size() < observeSteps)
+            return false;
+        BinSizeSample avg = averagePending();
+        pending.clear();
+        new_size = cur_size;
+
+        // The safety limits first
+        double lo, hi;
+        sizeBounds(avg, lo, hi);
+        if (avg.maxSpheresInBin > maxSphInBin || avg.maxTrianglesInBin > maxTriInBin || avg.numBins > maxNumBins) {
+            new_size = clampBetween(avg.binSize, lo, hi);
+            dropHistory();
+            return new_size != cur_size;
+        }
+
+        // Does the new sample agree with what the model expected?
+        if (fitted && history.size() >= NUM_PARAMS + 1) {
+            double predicted = predictFromCounts(avg);
+            if (std::abs(avg.cdTime - predicted) > (DRIFT_SIGMAS * noise + DRIFT_RELATIVE) * predicted) {
+                numDisagree++;
+            } else {
+                numDisagree = 0;
+            }
+            if (numDisagree >= 2) {
+                // The system changed under us; start learning again from this sample
+                dropHistory();
+            }
+        }
+        addToHistory(avg);
+
+        if (numDistinctSizes() < 3 || !fit()) {
+            // Not enough to fit a model: probe around where we have been
+            new_size = nextProbe(avg.binSize);
+            new_size = clampBetween(new_size, lo, hi);
+            return new_size != cur_size;
+        }
+
+        double best = optimalSize(avg, lo, hi);
+        double t_cur = predictAtSize(avg.binSize, avg);
+        double t_best = predictAtSize(best, avg);
+        double saving = t_cur - t_best;
+        if (saving > std::max(hysteresis, noise) * t_cur) {
+            new_size = best;
+        } else if (!bestObservedIsBracketed()) {
+            // The model sees nothing to gain, but the fastest size measured so far is at the edge of the range tried,
+            // so the optimum may be outside of it: probe further in that direction
+            new_size = clampBetween(bracketProbe(), lo, hi);
+        }
+        return new_size != cur_size;
+    }
+
+    /// Model prediction of the CD time at a bin size, using the geometry of the most recent sample
+    double Predict(double size) const {
+        if (!fitted || history.empty())
+            return std::numeric_limits<double>::quiet_NaN();
+        return predictAtSize(size, history.back());
+    }
+    bool IsModelReady() const { return fitted; }
+    /// Noise level (relative residual standard deviation) of the fit
+    double GetNoise() const { return noise; }
+    const std::vector<double>& GetCoefficients() const { return coef; }
+    size_t GetNumSamples() const { return history.size(); }
+
+    /// Return this tuner to initial state
+    void Clear() {
+        pending.clear();
+        dropHistory();
+    }
+
+  private:
+    static constexpr size_t NUM_PARAMS = 4;
+    // Samples kept for the fit, and how fast older ones fade
+    static constexpr size_t MAX_HISTORY = 32;
+    static constexpr double HISTORY_DECAY = 0.9;
+    // How far (as a factor) the tuner may go outside the range of sizes it has samples of
+    static constexpr double TRUST_FACTOR = 1.5;
+    // A sample this far from the prediction counts as a disagreement
+    static constexpr double DRIFT_SIGMAS = 3.;
+    static constexpr double DRIFT_RELATIVE = 0.15;
+
+    unsigned int observeSteps = 25;
+    double probeRatio = 0.2;
+    double hysteresis = 0.03;
+    double maxSphInBin = std::numeric_limits<double>::infinity();
+    double maxTriInBin = std::numeric_limits<double>::infinity();
+    double maxNumBins = std::numeric_limits<double>::infinity();
+
+    std::vector<BinSizeSample> pending;
+    std::deque<BinSizeSample> history;
+    std::vector<double> coef = std::vector<double>(NUM_PARAMS, 0.);
+    double noise = 0.;
+    bool fitted = false;
+    unsigned int numProbes = 0;
+    unsigned int numDisagree = 0;
+
+    static double clampBetween(double v, double lo, double hi) { return std::min(std::max(v, lo), hi); }
+
+    BinSizeSample averagePending() const {
+        BinSizeSample a;
+        double n = (double)pending.size();
+        for (const auto& s : pending) {
+            a.binSize += s.binSize / n;
+            a.numSpheres += s.numSpheres / n;
+            a.numTouchPairs += s.numTouchPairs / n;
+            a.numActiveBins += s.numActiveBins / n;
+            a.numBins += s.numBins / n;
+            a.cdTime += s.cdTime / n;
+            a.maxSpheresInBin = std::max(a.maxSpheresInBin, s.maxSpheresInBin);
+            a.maxTrianglesInBin = std::max(a.maxTrianglesInBin, s.maxTrianglesInBin);
+        }
+        return a;
+    }
+
+    static bool sameSize(double a, double b) { return std::abs(std::log(a / b)) < 0.05; }
+
+    // The last sample of each bin size is kept as long as possible, so the fit does not lose its spread of sizes
+    void addToHistory(const BinSizeSample& s) {
+        history.push_back(s);
+        if (history.size() <= MAX_HISTORY)
+            return;
+        for (auto it = history.begin(); it != history.end(); ++it) {
+            for (auto later = it + 1; later != history.end(); ++later) {
+                if (sameSize(it->binSize, later->binSize)) {
+                    history.erase(it);
+                    return;
+                }
+            }
+        }
+        history.pop_front();
+    }
+
+    // A sample fades as newer samples of (about) the same bin size come in
+    std::vector<double> historyWeights() const {
+        std::vector<double> w(history.size(), 1.);
+        for (size_t i = 0; i < history.size(); i++) {
+            for (size_t j = i + 1; j < history.size(); j++) {
+                if (sameSize(history[i].binSize, history[j].binSize))
+                    w[i] *= HISTORY_DECAY;
+            }
+        }
+        return w;
+    }
+
+    void dropHistory() {
+        history.clear();
+        fitted = false;
+        noise = 0.;
+        numProbes = 0;
+        numDisagree = 0;
+    }
+
+    unsigned int numDistinctSizes() const {
+        std::vector<double> sizes;
+        for (const auto& s : history) {
+            bool seen = false;
+            for (double v : sizes)
+                seen = seen || sameSize(s.binSize, v);
+            if (!seen)
+                sizes.push_back(s.binSize);
+        }
+        return sizes.size();
+    }
+
+    // Up, down, then further up/down, around the latest size
+    double nextProbe(double size) {
+        numProbes++;
+        return (numProbes % 2 == 1) ? size * (1. + probeRatio) : size / std::pow(1. + probeRatio, 2);
+    }
+
+    // Mean CD time of each bin size tried (later samples weigh more), and their sizes, sorted by size
+    void observedBySize(std::vector<double>& sizes, std::vector<double>& times) const {
+        std::vector<double> w = historyWeights(), wsum;
+        sizes.clear();
+        times.clear();
+        for (size_t i = 0; i < history.size(); i++) {
+            size_t j = 0;
+            while (j < sizes.size() && !sameSize(sizes[j], history[i].binSize))
+                j++;
+            if (j == sizes.size()) {
+                sizes.push_back(history[i].binSize);
+                times.push_back(0.);
+                wsum.push_back(0.);
+            }
+            times[j] += w[i] * history[i].cdTime;
+            wsum[j] += w[i];
+        }
+        for (size_t j = 0; j < sizes.size(); j++)
+            times[j] /= wsum[j];
+        for (size_t a = 0; a < sizes.size(); a++) {
+            for (size_t b = a + 1; b < sizes.size(); b++) {
+                if (sizes[b] < sizes[a]) {
+                    std::swap(sizes[a], sizes[b]);
+                    std::swap(times[a], times[b]);
+                }
+            }
+        }
+    }
+
+    size_t bestObservedIndex(const std::vector<double>& times) const {
+        return std::min_element(times.begin(), times.end()) - times.begin();
+    }
+
+    bool bestObservedIsBracketed() const {
+        std::vector<double> sizes, times;
+        observedBySize(sizes, times);
+        size_t best = bestObservedIndex(times);
+        return best > 0 && best + 1 < sizes.size();
+    }
+
+    double bracketProbe() const {
+        std::vector<double> sizes, times;
+        observedBySize(sizes, times);
+        size_t best = bestObservedIndex(times);
+        return (best == 0) ? sizes.front() / (1. + probeRatio) : sizes.back() * (1. + probeRatio);
+    }
+
+    static void features(double P, double A, double* f) {
+        A = std::max(A, 1.);
+        f[0] = 1.;
+        f[1] = P;
+        f[2] = A;
+        f[3] = P * P / A;
+    }
+
+    double predictFromCounts(const BinSizeSample& s) const {
+        double f[NUM_PARAMS];
+        features(s.numTouchPairs, s.numActiveBins, f);
+        double t = 0.;
+        for (size_t k = 0; k < NUM_PARAMS; k++)
+            t += coef[k] * f[k];
+        return t;
+    }
+
+    // Effective CD diameter and occupied volume, weighted toward recent samples
+    void packingGeometry(double& D, double& V) const {
+        double w = 1., wsum = 0., logD = 0., logV = 0.;
+        for (auto it = history.rbegin(); it != history.rend(); ++it, w *= HISTORY_DECAY) {
+            double per_sphere = it->numTouchPairs / std::max(it->numSpheres, 1.);
+            double d = it->binSize * std::max(std::cbrt(per_sphere) - 1., 1e-3);
+            double v = std::max(it->numActiveBins, 1.) * std::pow(it->binSize, 3);
+            logD += w * std::log(d);
+            logV += w * std::log(v);
+            wsum += w;
+        }
+        D = std::exp(logD / wsum);
+        V = std::exp(logV / wsum);
+    }
+
+    double predictAtSize(double size, const BinSizeSample& ref) const {
+        double D, V;
+        packingGeometry(D, V);
+        BinSizeSample s;
+        s.numTouchPairs = ref.numSpheres * std::pow(1. + D / size, 3);
+        s.numActiveBins = std::min(s.numTouchPairs, std::max(1., V / std::pow(size, 3)));
+        return predictFromCounts(s);
+    }
+
+    // Bin sizes allowed by the safety limits, extrapolated from a sample (max geometries in a bin and the number of
+    // bins scale with the bin volume)
+    void sizeBounds(const BinSizeSample& s, double& lo, double& hi) const {
+        lo = 0.;
+        hi = std::numeric_limits<double>::infinity();
+        if (s.maxSpheresInBin > 0. && std::isfinite(maxSphInBin))
+            hi = s.binSize * std::cbrt(maxSphInBin / s.maxSpheresInBin);
+        if (s.maxTrianglesInBin > 0. && std::isfinite(maxTriInBin))
+            hi = std::min(hi, s.binSize * std::cbrt(maxTriInBin / s.maxTrianglesInBin));
+        if (s.numBins > 0. && std::isfinite(maxNumBins))
+            lo = s.binSize * std::cbrt(s.numBins / maxNumBins);
+        if (lo > hi)
+            lo = hi;
+    }
+
+    double optimalSize(const BinSizeSample& ref, double lo, double hi) const {
+        double seen_lo = std::numeric_limits<double>::infinity(), seen_hi = 0.;
+        for (const auto& s : history) {
+            seen_lo = std::min(seen_lo, s.binSize);
+            seen_hi = std::max(seen_hi, s.binSize);
+        }
+        lo = std::max(lo, seen_lo / TRUST_FACTOR);
+        hi = std::min(hi, seen_hi * TRUST_FACTOR);
+        if (lo >= hi)
+            return clampBetween(ref.binSize, std::min(lo, hi), hi);
+        // The model is smooth, so a log-spaced scan is enough
+        const int n = 64;
+        double best = ref.binSize, best_t = std::numeric_limits<double>::infinity();
+        for (int i = 0; i <= n; i++) {
+            double size = lo * std::pow(hi / lo, (double)i / n);
+            double t = predictAtSize(size, ref);
+            if (t < best_t) {
+                best_t = t;
+                best = size;
+            }
+        }
+        return best;
+    }
+
+    // Weighted non-negative least squares: solve, drop the negative coefficients, and solve again
+    bool fit() {
+        const size_t m = history.size();
+        if (m < NUM_PARAMS)
+            return false;
+        std::vector<std::vector<double>> F(m, std::vector<double>(NUM_PARAMS));
+        std::vector<double> y(m), w = historyWeights();
+        // Scale the columns so that the normal equations are well conditioned
+        std::vector<double> scale(NUM_PARAMS, 0.);
+        for (size_t i = 0; i < m; i++) {
+            features(history[i].numTouchPairs, history[i].numActiveBins, F[i].data());
+            y[i] = history[i].cdTime;
+            // Relative errors matter: CD times near the optimum are much smaller than those far from it
+            w[i] /= std::max(y[i] * y[i], 1e-300);
+            for (size_t k = 0; k < NUM_PARAMS; k++)
+                scale[k] = std::max(scale[k], std::abs(F[i][k]));
+        }
+        for (size_t k = 0; k < NUM_PARAMS; k++)
+            scale[k] = (scale[k] > 0.) ? scale[k] : 1.;
+
+        std::vector<bool> active(NUM_PARAMS, true);
+        std::vector<double> c(NUM_PARAMS, 0.);
+        for (size_t iter = 0; iter < NUM_PARAMS; iter++) {
+            if (!solveActive(F, y, w, scale, active, c))
+                return false;
+            bool all_nonneg = true;
+            for (size_t k = 0; k < NUM_PARAMS; k++) {
+                if (active[k] && c[k] < 0.) {
+                    active[k] = false;
+                    c[k] = 0.;
+                    all_nonneg = false;
+                }
+            }
+            if (all_nonneg)
+                break;
+        }
+
+        // Noise level from the weighted (so relative) residuals
+        double rss = 0., wsum = 0.;
+        size_t n_active = 0;
+        for (size_t k = 0; k < NUM_PARAMS; k++)
+            n_active += active[k] ? 1 : 0;
+        for (size_t i = 0; i < m; i++) {
+            double r = y[i];
+            for (size_t k = 0; k < NUM_PARAMS; k++)
+                r -= c[k] * F[i][k];
+            rss += w[i] * r * r;
+            wsum += w[i];
+        }
+        double dof = std::max(1., (double)m - (double)n_active);
+        noise = std::sqrt(rss / wsum * (double)m / dof);
+        coef = c;
+        fitted = true;
+        return true;
+    }
+
+    static bool solveActive(const std::vector<std::vector<double>>& F,
+                            const std::vector<double>& y,
+                            const std::vector<double>& w,
+                            const std::vector<double>& scale,
+                            const std::vector<bool>& active,
+                            std::vector<double>& c) {
+        std::vector<size_t> idx;
+        for (size_t k = 0; k < NUM_PARAMS; k++)
+            if (active[k])
+                idx.push_back(k);
+        const size_t p = idx.size();
+        if (p == 0)
+            return false;
+        // Normal equations, with a tiny ridge against collinear features
+        std::vector<std::vector<double>> M(p, std::vector<double>(p + 1, 0.));
+        for (size_t i = 0; i < F.size(); i++) {
+            for (size_t a = 0; a < p; a++) {
+                double fa = F[i][idx[a]] / scale[idx[a]];
+                for (size_t b = 0; b < p; b++)
+                    M[a][b] += w[i] * fa * F[i][idx[b]] / scale[idx[b]];
+                M[a][p] += w[i] * fa * y[i];
+            }
+        }
+        for (size_t a = 0; a < p; a++)
+            M[a][a] += 1e-9 * (M[a][a] + 1e-30);
+        // Gaussian elimination with partial pivoting
+        for (size_t col = 0; col < p; col++) {
+            size_t piv = col;
+            for (size_t r = col + 1; r < p; r++)
+                if (std::abs(M[r][col]) > std::abs(M[piv][col]))
+                    piv = r;
+            if (std::abs(M[piv][col]) < 1e-300)
+                return false;
+            std::swap(M[col], M[piv]);
+            for (size_t r = 0; r < p; r++) {
+                if (r == col)
+                    continue;
+                double f = M[r][col] / M[col][col];
+                for (size_t k = col; k <= p; k++)
+                    M[r][k] -= f * M[col][k];
+            }
+        }
+        std::fill(c.begin(), c.end(), 0.);
+        for (size_t a = 0; a < p; a++)
+            c[idx[a]] = M[a][p] / M[a][a] / scale[idx[a]];
+        return true;
+    }
+};
+
+}  // namespace deme
+
+#endif
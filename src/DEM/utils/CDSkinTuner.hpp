@@ -0,0 +1,104 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_CD_SKIN_TUNER_HPP
+#define DEME_CD_SKIN_TUNER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <DEM/Defines.h>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Skin tuner of displacement-triggered CD
+//
+// Chooses the skin by modelling the per-step cost as J(s) = a + b * s + c / s. The b * s part is the force
+// calculation on the pairs in the skin that carry no force, whose number grows with s; the c / s part is CD, which
+// is needed every (ratio * s / max displacement per step) steps. The minimizer is s = sqrt(c / b). dT feeds it the
+// finished CD cycles and asks it for a new skin when it orders CD.
+// -----------------------------------------------------------------------------
+
+class CDSkinTuner {
+  private:
+    float min_skin = 0.f;
+    float max_skin = DEME_HUGE_FLOAT;
+    unsigned int num_cycles = 0;
+    uint64_t num_steps = 0;
+    double force_time = 0.;
+    double cd_time = 0.;
+    double pair_steps = 0.;
+    double idle_pair_steps = 0.;
+    double max_disp = 0.;
+
+  public:
+    CDSkinTuner() {}
+    ~CDSkinTuner() {}
+
+    void SetRange(float min_s, float max_s) {
+        min_skin = min_s;
+        max_skin = max_s;
+    }
+
+    // Record one finished CD cycle: the steps the contact pairs served, the force calculation time in those steps,
+    // the time of the CD that made them, the number of pairs and how many carried force, and the max displacement
+    // reached before they were replaced
+    void AddCycle(uint64_t steps, double f_time, double c_time, size_t n_pairs, size_t n_bearing, float disp) {
+        // A timing stats reset in between makes f_time unusable
+        if (steps == 0 || f_time < 0.)
+            return;
+        num_cycles++;
+        num_steps += steps;
+        force_time += f_time;
+        cd_time += c_time;
+        pair_steps += (double)n_pairs * steps;
+        idle_pair_steps += (double)(n_pairs - std::min(n_pairs, n_bearing)) * steps;
+        max_disp += disp;
+    }
+
+    // After enough cycles, give the skin that minimizes the modelled cost, limited to a bounded change from skin
+    bool Query(float skin, float& new_skin) {
+        if (num_cycles < NUM_CD_CYCLES_PER_SKIN_TUNE) {
+            return false;
+        }
+        // Force time per pair per step, CD time per CD, and max displacement per step
+        double t_pair = (pair_steps > 0.) ? force_time / pair_steps : 0.;
+        double t_cd = cd_time / num_cycles;
+        double rate = max_disp / num_steps;
+        // b and c of the model, using that the idle pairs are proportional to the skin
+        double b = t_pair * (idle_pair_steps / num_steps) / skin;
+        double c = t_cd * rate / CD_SKIN_ORDER_RATIO;
+        double optimal;
+        if (b <= 0.) {
+            optimal = skin * CD_SKIN_MAX_TUNE_RATIO;
+        } else if (c <= 0.) {
+            optimal = skin / CD_SKIN_MAX_TUNE_RATIO;
+        } else {
+            optimal = std::sqrt(c / b);
+        }
+        optimal = std::clamp(optimal, (double)skin / CD_SKIN_MAX_TUNE_RATIO, (double)skin * CD_SKIN_MAX_TUNE_RATIO);
+        new_skin = std::clamp((float)optimal, min_skin, max_skin);
+        Clear();
+        return true;
+    }
+
+    // Return this tuner to initial state
+    void Clear() {
+        num_cycles = 0;
+        num_steps = 0;
+        force_time = 0.;
+        cd_time = 0.;
+        pair_steps = 0.;
+        idle_pair_steps = 0.;
+        max_disp = 0.;
+    }
+};
+
+}  // namespace deme
+
+#endif
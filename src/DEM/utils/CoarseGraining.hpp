@@ -0,0 +1,274 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// On-the-fly coarse-graining of particle and contact fields onto a grid. At each sample, every clump deposits its
+// mass, volume, momentum and m v (x) v, and every force-bearing contact deposits f (x) b (force times branch vector) at
+// its contact point, onto the grid nodes within the cutoff of the weight function; the sums are accumulated over a time
+// window of samples, and the window averages give the continuum fields:
+//   density rho = <sum m w>, solid fraction = <sum V w>, velocity u = <sum m v w> / rho,
+//   kinetic stress = <sum m v (x) v w> - rho u (x) u, granular temperature = trace(kinetic stress) / (3 rho),
+//   contact stress = <sum f (x) b w> (compression positive).
+// A contact is deposited at its contact point only (rather than along its branch vector), which is accurate when the
+// weight is wider than a particle.
+//
+// Each node gathers the entities of the 27 cells around it (see kernel/DEMCoarseGrainingHelpers.cuh), in cell order,
+// then in entity order within a cell. The host path runs the gather over the nodes in threads, and the device path in
+// a kernel; neither has a race, and the sums of a node do not depend on the thread count. The host path can also be
+// used on its own, for entities that are not in a simulation.
+
+#ifndef DEME_COARSE_GRAINING_HPP
+#define DEME_COARSE_GRAINING_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <DEM/Defines.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <kernel/DEMCoarseGrainingHelpers.cuh>
+
+namespace deme {
+
+// Where the gather of a coarse-graining sample runs
+enum class CG_BACKEND { DEVICE, HOST };
+
+const char CG_FILE_MAGIC[4] = {'D', 'M', 'C', 'G'};
+const uint16_t CG_FILE_VERSION = 1;
+
+// The fields of the output grids
+const unsigned int CG_NUM_OUTPUT_FIELDS = 21;
+const char* const CG_OUTPUT_FIELD_NAMES[CG_NUM_OUTPUT_FIELDS] = {
+    "solid_fraction",   "density",          "v_x",              "v_y",              "v_z",
+    "granular_temp",    "kin_stress_xx",    "kin_stress_yy",    "kin_stress_zz",    "kin_stress_xy",
+    "kin_stress_xz",    "kin_stress_yz",    "cnt_stress_xx",    "cnt_stress_xy",    "cnt_stress_xz",
+    "cnt_stress_yx",    "cnt_stress_yy",    "cnt_stress_yz",    "cnt_stress_zx",    "cnt_stress_zy",
+    "cnt_stress_zz"};
+
+/// The grid of nX * nY * nZ nodes from lo, spacing apart, with this weight function of this width (the standard
+/// deviation of a Gaussian, or the support radius of Lucy's function)
+inline CGGridParams MakeCGGridParams(double loX,
+                                     double loY,
+                                     double loZ,
+                                     double spacing,
+                                     unsigned int nX,
+                                     unsigned int nY,
+                                     unsigned int nZ,
+                                     CG_WEIGHT weight,
+                                     double width) {
+    CGGridParams g;
+    g.loX = loX;
+    g.loY = loY;
+    g.loZ = loZ;
+    g.spacing = spacing;
+    g.nX = nX;
+    g.nY = nY;
+    g.nZ = nZ;
+    g.weight = weight;
+    g.width = width;
+    g.cutoff = (weight == CG_WEIGHT::GAUSSIAN) ? 3. * width : width;
+    // The cells cover everything within the cutoff of a node
+    g.cellLoX = loX - g.cutoff;
+    g.cellLoY = loY - g.cutoff;
+    g.cellLoZ = loZ - g.cutoff;
+    g.nCellX = (unsigned int)std::floor(((nX - 1) * spacing + 2. * g.cutoff) / g.cutoff) + 1;
+    g.nCellY = (unsigned int)std::floor(((nY - 1) * spacing + 2. * g.cutoff) / g.cutoff) + 1;
+    g.nCellZ = (unsigned int)std::floor(((nZ - 1) * spacing + 2. * g.cutoff) / g.cutoff) + 1;
+    return g;
+}
+
+/// Sort entities by cell (stably, so entities of a cell stay in their order): returns the sorted entities, and starts
+/// (of size nCells + 1) is where each cell's entities begin. Entities out of the cell grid are dropped.
+template <typename T>
+inline std::vector<T> CGSortByCell(const CGGridParams& g,
+                                   const std::vector<T>& entities,
+                                   std::vector<contactPairs_t>& starts) {
+    const unsigned int nCells = cgNumCells(g);
+    std::vector<unsigned int> cells(entities.size());
+    starts.assign((size_t)nCells + 1, 0);
+    for (size_t i = 0; i < entities.size(); i++) {
+        cells[i] = cgCellOf(g, entities[i].x, entities[i].y, entities[i].z);
+        if (cells[i] < nCells)
+            starts[cells[i] + 1]++;
+    }
+    for (unsigned int c = 0; c < nCells; c++)
+        starts[c + 1] += starts[c];
+    std::vector<T> sorted(starts[nCells]);
+    std::vector<contactPairs_t> fill(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < entities.size(); i++) {
+        if (cells[i] < nCells)
+            sorted[fill[cells[i]]++] = entities[i];
+    }
+    return sorted;
+}
+
+/// The host path: add one sample of the particles' and contacts' raw fields to sums (DEME_CG_NUM_RAW_FIELDS per node),
+/// gathering the nodes in n_threads threads (0 means all hardware threads)
+inline void CoarseGrainHost(const CGGridParams& g,
+                            const std::vector<CGParticle>& particles,
+                            const std::vector<CGContact>& contacts,
+                            double* sums,
+                            unsigned int n_threads = 0) {
+    std::vector<contactPairs_t> particleStarts, contactStarts;
+    const std::vector<CGParticle> sortedParticles = CGSortByCell(g, particles, particleStarts);
+    const std::vector<CGContact> sortedContacts = CGSortByCell(g, contacts, contactStarts);
+    hostParallelFor(
+        cgNumNodes(g),
+        [&](unsigned int /*chunk*/, size_t start, size_t end) {
+            double nodeFields[DEME_CG_NUM_RAW_FIELDS];
+            for (size_t node = start; node < end; node++) {
+                cgGatherNode(g, node, sortedParticles.data(), particleStarts.data(), sortedContacts.data(),
+                             contactStarts.data(), nodeFields);
+                for (unsigned int f = 0; f < DEME_CG_NUM_RAW_FIELDS; f++)
+                    sums[node * DEME_CG_NUM_RAW_FIELDS + f] += nodeFields[f];
+            }
+        },
+        n_threads, 256);
+}
+
+/// The output fields (CG_NUM_OUTPUT_FIELDS of them, each over all nodes) from the sums of nSamples samples. The
+/// velocity, kinetic stress and granular temperature of a node with no mass are 0.
+inline std::vector<float> CoarseGrainOutputFields(const CGGridParams& g, const double* sums, unsigned int nSamples) {
+    const size_t nNodes = cgNumNodes(g);
+    std::vector<float> fields(CG_NUM_OUTPUT_FIELDS * nNodes, 0.f);
+    if (nSamples == 0)
+        return fields;
+    for (size_t node = 0; node < nNodes; node++) {
+        double avg[DEME_CG_NUM_RAW_FIELDS];
+        for (unsigned int f = 0; f < DEME_CG_NUM_RAW_FIELDS; f++)
+            avg[f] = sums[node * DEME_CG_NUM_RAW_FIELDS + f] / nSamples;
+        auto out = [&](unsigned int field, double val) { fields[field * nNodes + node] = (float)val; };
+        const double rho = avg[CG_RAW_MASS];
+        out(0, avg[CG_RAW_VOLUME]);
+        out(1, rho);
+        if (rho > 0.) {
+            const double u[3] = {avg[CG_RAW_MOMENTUM] / rho, avg[CG_RAW_MOMENTUM + 1] / rho,
+                                 avg[CG_RAW_MOMENTUM + 2] / rho};
+            // xx, yy, zz, xy, xz, yz
+            const unsigned int r[6] = {0, 1, 2, 0, 0, 1}, s[6] = {0, 1, 2, 1, 2, 2};
+            double kin[6];
+            for (unsigned int k = 0; k < 6; k++)
+                kin[k] = avg[CG_RAW_MVV + k] - rho * u[r[k]] * u[s[k]];
+            for (unsigned int d = 0; d < 3; d++)
+                out(2 + d, u[d]);
+            out(5, (kin[0] + kin[1] + kin[2]) / (3. * rho));
+            for (unsigned int k = 0; k < 6; k++)
+                out(6 + k, kin[k]);
+        }
+        for (unsigned int k = 0; k < 9; k++)
+            out(12 + k, avg[CG_RAW_CONTACT_STRESS + k]);
+    }
+    return fields;
+}
+
+/// A coarse-grained grid file: the grid, the window it averages, and its fields
+struct CoarseGrainFrame {
+    CGGridParams grid;
+    unsigned int nSamples = 0;
+    double timeStart = 0.;
+    double timeEnd = 0.;
+    std::vector<std::string> fieldNames;
+    // Each field over all nodes (x fastest), one after another
+    std::vector<float> fields;
+};
+
+/// Write a grid in the binary layout:
+///   magic, version (uint16), number of fields (uint16), nX, nY, nZ (uint32), lo (3 double), spacing, width (double),
+///   weight, nSamples (uint32), window start and end time (double), then each field's name (uint16 length + chars)
+///   and its values (float32 per node, x fastest)
+inline void WriteCoarseGrainFrame(std::ostream& os, const CoarseGrainFrame& frame) {
+    auto put = [&os](const auto& val) { os.write(reinterpret_cast<const char*>(&val), sizeof(val)); };
+    const size_t nNodes = cgNumNodes(frame.grid);
+    os.write(CG_FILE_MAGIC, sizeof(CG_FILE_MAGIC));
+    put(CG_FILE_VERSION);
+    put((uint16_t)frame.fieldNames.size());
+    put((uint32_t)frame.grid.nX);
+    put((uint32_t)frame.grid.nY);
+    put((uint32_t)frame.grid.nZ);
+    put(frame.grid.loX);
+    put(frame.grid.loY);
+    put(frame.grid.loZ);
+    put(frame.grid.spacing);
+    put(frame.grid.width);
+    put((uint32_t)frame.grid.weight);
+    put((uint32_t)frame.nSamples);
+    put(frame.timeStart);
+    put(frame.timeEnd);
+    for (size_t f = 0; f < frame.fieldNames.size(); f++) {
+        put((uint16_t)frame.fieldNames[f].size());
+        os.write(frame.fieldNames[f].data(), frame.fieldNames[f].size());
+        os.write(reinterpret_cast<const char*>(frame.fields.data() + f * nNodes), nNodes * sizeof(float));
+    }
+}
+
+inline CoarseGrainFrame ReadCoarseGrainFrame(std::istream& is) {
+    auto get = [&is](auto& val) {
+        is.read(reinterpret_cast<char*>(&val), sizeof(val));
+        if (!is)
+            throw std::runtime_error("Coarse-grained grid file ended unexpectedly.");
+    };
+    char magic[4];
+    is.read(magic, sizeof(magic));
+    if (!is || std::memcmp(magic, CG_FILE_MAGIC, sizeof(magic)) != 0)
+        throw std::runtime_error("Not a coarse-grained grid file.");
+    uint16_t version, nFields;
+    get(version);
+    if (version != CG_FILE_VERSION)
+        throw std::runtime_error("Unsupported coarse-grained grid file version " + std::to_string(version) + ".");
+    get(nFields);
+    uint32_t nX, nY, nZ, weight, nSamples;
+    double lo[3], spacing, width;
+    get(nX);
+    get(nY);
+    get(nZ);
+    get(lo[0]);
+    get(lo[1]);
+    get(lo[2]);
+    get(spacing);
+    get(width);
+    get(weight);
+    CoarseGrainFrame frame;
+    frame.grid = MakeCGGridParams(lo[0], lo[1], lo[2], spacing, nX, nY, nZ, (CG_WEIGHT)weight, width);
+    get(nSamples);
+    frame.nSamples = nSamples;
+    get(frame.timeStart);
+    get(frame.timeEnd);
+    const size_t nNodes = cgNumNodes(frame.grid);
+    frame.fields.resize(nFields * nNodes);
+    for (uint16_t f = 0; f < nFields; f++) {
+        uint16_t len;
+        get(len);
+        std::string name(len, ' ');
+        is.read(&name[0], len);
+        is.read(reinterpret_cast<char*>(frame.fields.data() + f * nNodes), nNodes * sizeof(float));
+        if (!is)
+            throw std::runtime_error("Coarse-grained grid file ended unexpectedly.");
+        frame.fieldNames.push_back(std::move(name));
+    }
+    return frame;
+}
+
+inline void WriteCoarseGrainFile(const std::string& filename, const CoarseGrainFrame& frame) {
+    std::ofstream ofile(filename, std::ios::out | std::ios::binary);
+    if (!ofile)
+        throw std::runtime_error("Cannot open " + filename + " for writing.");
+    WriteCoarseGrainFrame(ofile, frame);
+}
+
+inline CoarseGrainFrame ReadCoarseGrainFile(const std::string& filename) {
+    std::ifstream ifile(filename, std::ios::in | std::ios::binary);
+    if (!ifile)
+        throw std::runtime_error("Cannot open " + filename + " for reading.");
+    return ReadCoarseGrainFrame(ifile);
+}
+
+}  // namespace deme
+
+#endif
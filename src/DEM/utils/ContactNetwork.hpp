@@ -0,0 +1,369 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_CONTACT_NETWORK_HPP
+#define DEME_CONTACT_NETWORK_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include <DEM/Defines.h>
+#include <DEM/HostSideHelpers.hpp>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Contact network analytics
+//
+// The force-bearing contacts of a time step form a graph whose vertices are the particles (clumps); a contact with a
+// mesh or an analytical boundary is not an edge, but counts toward the coordination of its particle. From that graph,
+// the analysis gives compact summaries instead of the contact pairs:
+//   - coordination: the histogram of the number of contacts of each particle, and its mean;
+//   - rattlers: particles with fewer than a minimum number of contacts, removed repeatedly (removing one takes a
+//     contact from each of its neighbors) until none is left; the mechanical coordination is the mean over the rest;
+//   - strong network: contacts whose normal force is above a ratio of the mean, the share of the normal force they
+//     carry, and the clusters they link (the force chains);
+//   - clusters: connected components of the graph, and the histogram of their sizes;
+//   - fabric: the mean of n (x) n over particle contacts (n the contact normal), of all and of strong contacts, and its
+//     anisotropy sqrt(3/2 d:d) (d the deviator), which is 0 if isotropic and 1 if all normals are aligned.
+// The per-contact pass (normal forces, fabric) runs in threads over fixed blocks of contacts, whose partial sums are
+// added in block order, so the results do not depend on the thread count. The graph is kept in CSR form, and its
+// traversals (clusters, rattler removal) visit particles in index order.
+// -----------------------------------------------------------------------------
+
+// The contacts of a time step (arrays of nContacts). particleB is NULL_BODYID if B is not a particle; the normal is a
+// unit vector pointing out of A.
+struct ContactNetworkInput {
+    size_t nParticles = 0;
+    size_t nContacts = 0;
+    const bodyID_t* particleA = nullptr;
+    const bodyID_t* particleB = nullptr;
+    const float* fX = nullptr;
+    const float* fY = nullptr;
+    const float* fZ = nullptr;
+    const float* nX = nullptr;
+    const float* nY = nullptr;
+    const float* nZ = nullptr;
+};
+
+/// Settings of a contact network analysis
+struct ContactNetworkOptions {
+    /// A contact is strong if its normal force is larger than this times the mean normal force of particle contacts
+    float strong_force_ratio = 1.f;
+    /// A particle with fewer contacts than this (after removing the rattlers around it) is a rattler
+    unsigned int rattler_min_contacts = 4;
+    /// Keep the coordination, rattler flag and cluster of each particle in the results
+    bool keep_per_particle = false;
+    /// Number of threads of the per-contact pass (0 means all hardware threads)
+    unsigned int n_threads = 0;
+};
+
+/// The summary of a contact network
+struct ContactNetworkSummary {
+    size_t nParticles = 0;
+    /// Number of particle-particle contacts, and of particle-boundary contacts
+    size_t nContacts = 0;
+    size_t nBoundaryContacts = 0;
+
+    /// Number of particles with k contacts, at index k
+    std::vector<size_t> coordinationHistogram;
+    /// Mean number of contacts per particle
+    double meanCoordination = 0.;
+    /// Number of particles with no contact
+    size_t nIsolated = 0;
+
+    size_t nRattlers = 0;
+    /// Mean number of contacts per particle, among the particles that are not rattlers
+    double mechanicalCoordination = 0.;
+
+    /// Mean normal force of particle contacts
+    double meanNormalForce = 0.;
+    size_t nStrongContacts = 0;
+    /// Share of the total normal force of particle contacts carried by the strong ones
+    double strongForceShare = 0.;
+    /// Number of clusters linked by strong contacts (of at least 2 particles), and the size of the largest
+    size_t nStrongClusters = 0;
+    size_t largestStrongCluster = 0;
+
+    /// Number of clusters (an isolated particle is a cluster of 1), and the size of the largest
+    size_t nClusters = 0;
+    size_t largestCluster = 0;
+    /// Number of clusters of each size, in increasing size
+    std::vector<std::pair<size_t, size_t>> clusterSizeHistogram;
+
+    /// Fabric tensors (row-major 3x3) of all and of strong particle contacts, and their anisotropy
+    double fabric[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+    double strongFabric[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+    double fabricAnisotropy = 0.;
+    double strongFabricAnisotropy = 0.;
+
+    /// Per particle (if kept): number of contacts, whether it is a rattler, and its cluster (numbered from 0 in the
+    /// order of their first particle)
+    std::vector<unsigned int> coordination;
+    std::vector<uint8_t> isRattler;
+    std::vector<bodyID_t> clusterID;
+};
+
+/// The anisotropy sqrt(3/2 d:d) of a fabric tensor of unit trace, d being its deviator
+inline double FabricAnisotropy(const double* F) {
+    const double tr3 = (F[0] + F[4] + F[8]) / 3.;
+    double dd = 0.;
+    for (unsigned int r = 0; r < 3; r++) {
+        for (unsigned int s = 0; s < 3; s++) {
+            const double d = F[3 * r + s] - (r == s ? tr3 : 0.);
+            dd += d * d;
+        }
+    }
+    return std::sqrt(1.5 * dd);
+}
+
+/// Analyze the contact network of a time step
+inline ContactNetworkSummary AnalyzeContactNetwork(const ContactNetworkInput& in,
+                                                   const ContactNetworkOptions& opts = ContactNetworkOptions()) {
+    const size_t nP = in.nParticles, nC = in.nContacts;
+    ContactNetworkSummary res;
+    res.nParticles = nP;
+    auto isEdge = [&](size_t c) { return in.particleB[c] != NULL_BODYID; };
+
+    // The normal force of each contact, then the sums over fixed blocks of contacts
+    const size_t blockSize = 4096;
+    const size_t nBlocks = (nC + blockSize - 1) / blockSize;
+    std::vector<float> fn(nC);
+    struct BlockSums {
+        size_t nEdges = 0;
+        size_t nStrong = 0;
+        double fnSum = 0.;
+        double strongFnSum = 0.;
+        double fabric[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+        double strongFabric[9] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+    };
+    std::vector<BlockSums> blocks(nBlocks);
+    hostParallelFor(
+        nBlocks,
+        [&](unsigned int /*chunk*/, size_t start, size_t end) {
+            for (size_t b = start; b < end; b++) {
+                BlockSums& s = blocks[b];
+                for (size_t c = b * blockSize; c < std::min(nC, (b + 1) * blockSize); c++) {
+                    fn[c] = std::fabs(in.fX[c] * in.nX[c] + in.fY[c] * in.nY[c] + in.fZ[c] * in.nZ[c]);
+                    if (!isEdge(c))
+                        continue;
+                    const double n[3] = {in.nX[c], in.nY[c], in.nZ[c]};
+                    s.nEdges++;
+                    s.fnSum += fn[c];
+                    for (unsigned int k = 0; k < 9; k++)
+                        s.fabric[k] += n[k / 3] * n[k % 3];
+                }
+            }
+        },
+        opts.n_threads, 1);
+    BlockSums total;
+    for (const auto& s : blocks) {
+        total.nEdges += s.nEdges;
+        total.fnSum += s.fnSum;
+        for (unsigned int k = 0; k < 9; k++)
+            total.fabric[k] += s.fabric[k];
+    }
+    res.nContacts = total.nEdges;
+    res.nBoundaryContacts = nC - total.nEdges;
+    res.meanNormalForce = total.nEdges > 0 ? total.fnSum / (double)total.nEdges : 0.;
+
+    // Strong contacts need the mean first
+    const double strongThres = (double)opts.strong_force_ratio * res.meanNormalForce;
+    std::vector<uint8_t> strong(nC, 0);
+    hostParallelFor(
+        nBlocks,
+        [&](unsigned int /*chunk*/, size_t start, size_t end) {
+            for (size_t b = start; b < end; b++) {
+                BlockSums& s = blocks[b];
+                for (size_t c = b * blockSize; c < std::min(nC, (b + 1) * blockSize); c++) {
+                    if (!isEdge(c) || !(fn[c] > strongThres))
+                        continue;
+                    const double n[3] = {in.nX[c], in.nY[c], in.nZ[c]};
+                    strong[c] = 1;
+                    s.nStrong++;
+                    s.strongFnSum += fn[c];
+                    for (unsigned int k = 0; k < 9; k++)
+                        s.strongFabric[k] += n[k / 3] * n[k % 3];
+                }
+            }
+        },
+        opts.n_threads, 1);
+    for (const auto& s : blocks) {
+        total.nStrong += s.nStrong;
+        total.strongFnSum += s.strongFnSum;
+        for (unsigned int k = 0; k < 9; k++)
+            total.strongFabric[k] += s.strongFabric[k];
+    }
+    res.nStrongContacts = total.nStrong;
+    res.strongForceShare = total.fnSum > 0. ? total.strongFnSum / total.fnSum : 0.;
+    for (unsigned int k = 0; k < 9; k++) {
+        res.fabric[k] = total.nEdges > 0 ? total.fabric[k] / (double)total.nEdges : 0.;
+        res.strongFabric[k] = total.nStrong > 0 ? total.strongFabric[k] / (double)total.nStrong : 0.;
+    }
+    res.fabricAnisotropy = total.nEdges > 0 ? FabricAnisotropy(res.fabric) : 0.;
+    res.strongFabricAnisotropy = total.nStrong > 0 ? FabricAnisotropy(res.strongFabric) : 0.;
+
+    // Coordination, and the CSR graph of particle contacts (each edge is listed at both ends, with its contact)
+    std::vector<unsigned int> coord(nP, 0);
+    std::vector<size_t> offsets(nP + 1, 0);
+    for (size_t c = 0; c < nC; c++) {
+        coord[in.particleA[c]]++;
+        if (isEdge(c)) {
+            coord[in.particleB[c]]++;
+            offsets[in.particleA[c] + 1]++;
+            offsets[in.particleB[c] + 1]++;
+        }
+    }
+    for (size_t p = 0; p < nP; p++)
+        offsets[p + 1] += offsets[p];
+    std::vector<bodyID_t> neighbors(offsets[nP]);
+    std::vector<size_t> edgeContacts(offsets[nP]);
+    {
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t c = 0; c < nC; c++) {
+            if (!isEdge(c))
+                continue;
+            const bodyID_t a = in.particleA[c], b = in.particleB[c];
+            neighbors[fill[a]] = b;
+            edgeContacts[fill[a]++] = c;
+            neighbors[fill[b]] = a;
+            edgeContacts[fill[b]++] = c;
+        }
+    }
+
+    size_t coordSum = 0;
+    for (size_t p = 0; p < nP; p++) {
+        if (coord[p] >= res.coordinationHistogram.size())
+            res.coordinationHistogram.resize(coord[p] + 1, 0);
+        res.coordinationHistogram[coord[p]]++;
+        coordSum += coord[p];
+        if (coord[p] == 0)
+            res.nIsolated++;
+    }
+    res.meanCoordination = nP > 0 ? (double)coordSum / (double)nP : 0.;
+
+    // Rattlers: remove particles short of contacts until there is none
+    std::vector<unsigned int> remaining(coord);
+    std::vector<uint8_t> rattler(nP, 0);
+    {
+        std::vector<bodyID_t> queue;
+        for (size_t p = 0; p < nP; p++) {
+            if (remaining[p] < opts.rattler_min_contacts) {
+                rattler[p] = 1;
+                queue.push_back(p);
+            }
+        }
+        for (size_t q = 0; q < queue.size(); q++) {
+            const bodyID_t p = queue[q];
+            for (size_t e = offsets[p]; e < offsets[p + 1]; e++) {
+                const bodyID_t nb = neighbors[e];
+                if (rattler[nb])
+                    continue;
+                remaining[nb]--;
+                if (remaining[nb] < opts.rattler_min_contacts) {
+                    rattler[nb] = 1;
+                    queue.push_back(nb);
+                }
+            }
+        }
+        res.nRattlers = queue.size();
+        size_t mechSum = 0;
+        for (size_t p = 0; p < nP; p++) {
+            if (!rattler[p])
+                mechSum += remaining[p];
+        }
+        res.mechanicalCoordination = nP > res.nRattlers ? (double)mechSum / (double)(nP - res.nRattlers) : 0.;
+    }
+
+    // Clusters, of the whole graph and of the strong contacts
+    std::vector<bodyID_t> cluster(nP, NULL_BODYID);
+    std::vector<bodyID_t> strongCluster(nP, NULL_BODYID);
+    auto findClusters = [&](std::vector<bodyID_t>& label, bool strong_only, std::vector<size_t>& sizes) {
+        std::vector<bodyID_t> stack;
+        for (size_t p = 0; p < nP; p++) {
+            if (label[p] != NULL_BODYID)
+                continue;
+            const bodyID_t id = sizes.size();
+            size_t size = 0;
+            label[p] = id;
+            stack.push_back(p);
+            while (!stack.empty()) {
+                const bodyID_t cur = stack.back();
+                stack.pop_back();
+                size++;
+                for (size_t e = offsets[cur]; e < offsets[cur + 1]; e++) {
+                    const bodyID_t nb = neighbors[e];
+                    if (label[nb] == NULL_BODYID && (!strong_only || strong[edgeContacts[e]])) {
+                        label[nb] = id;
+                        stack.push_back(nb);
+                    }
+                }
+            }
+            sizes.push_back(size);
+        }
+    };
+    std::vector<size_t> sizes, strongSizes;
+    findClusters(cluster, false, sizes);
+    findClusters(strongCluster, true, strongSizes);
+    res.nClusters = sizes.size();
+    std::map<size_t, size_t> sizeCounts;
+    for (const auto& s : sizes) {
+        sizeCounts[s]++;
+        res.largestCluster = std::max(res.largestCluster, s);
+    }
+    res.clusterSizeHistogram.assign(sizeCounts.begin(), sizeCounts.end());
+    for (const auto& s : strongSizes) {
+        // A particle with no strong contact is not in a force chain
+        if (s < 2)
+            continue;
+        res.nStrongClusters++;
+        res.largestStrongCluster = std::max(res.largestStrongCluster, s);
+    }
+
+    if (opts.keep_per_particle) {
+        res.coordination = std::move(coord);
+        res.isRattler = std::move(rattler);
+        res.clusterID = std::move(cluster);
+    }
+    return res;
+}
+
+/// Write a summary as `key value' lines (histograms as `key index count' lines)
+inline void WriteContactNetworkSummary(std::ostream& os, const ContactNetworkSummary& s) {
+    os << "particles " << s.nParticles << "\n";
+    os << "contacts " << s.nContacts << "\n";
+    os << "boundary_contacts " << s.nBoundaryContacts << "\n";
+    os << "mean_coordination " << s.meanCoordination << "\n";
+    os << "isolated " << s.nIsolated << "\n";
+    os << "rattlers " << s.nRattlers << "\n";
+    os << "mechanical_coordination " << s.mechanicalCoordination << "\n";
+    os << "mean_normal_force " << s.meanNormalForce << "\n";
+    os << "strong_contacts " << s.nStrongContacts << "\n";
+    os << "strong_force_share " << s.strongForceShare << "\n";
+    os << "strong_clusters " << s.nStrongClusters << "\n";
+    os << "largest_strong_cluster " << s.largestStrongCluster << "\n";
+    os << "clusters " << s.nClusters << "\n";
+    os << "largest_cluster " << s.largestCluster << "\n";
+    os << "fabric";
+    for (unsigned int k = 0; k < 9; k++)
+        os << " " << s.fabric[k];
+    os << "\nfabric_anisotropy " << s.fabricAnisotropy << "\n";
+    os << "strong_fabric";
+    for (unsigned int k = 0; k < 9; k++)
+        os << " " << s.strongFabric[k];
+    os << "\nstrong_fabric_anisotropy " << s.strongFabricAnisotropy << "\n";
+    for (size_t k = 0; k < s.coordinationHistogram.size(); k++)
+        os << "coordination_hist " << k << " " << s.coordinationHistogram[k] << "\n";
+    for (const auto& sc : s.clusterSizeHistogram)
+        os << "cluster_size_hist " << sc.first << " " << sc.second << "\n";
+}
+
+}  // namespace deme
+
+#endif
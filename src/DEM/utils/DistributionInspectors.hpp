@@ -0,0 +1,215 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_DISTRIBUTION_INSPECTORS_HPP
+#define DEME_DISTRIBUTION_INSPECTORS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Distribution inspectors
+//
+// A distribution inspector evaluates a quantity of every sphere, owner or contact on the device, and returns a compact
+// summary of its distribution: count, sum, min and max, a histogram and quantiles. The entities can be grouped (by
+// family, or by a user region code that gives a group number from the position), and then there is a summary per
+// group.
+// On the device, a kernel writes the value and the group of every entity (an entity out of region, or of a group past
+// the last, gets DIST_NULL_GROUP); a second kernel accumulates the group counts, sums, extremes and histograms with
+// atomics. For quantiles, the (group, value) pairs are sorted as one 64-bit key each, so the entries of a group are
+// consecutive and in value order; from the group counts, the host then knows the sorted position of every quantile,
+// and only those entries are gathered and copied back. The quantiles are therefore exact order statistics, not sketch
+// estimates. DEMtest_DistributionQuantiles runs this path on the host against std::nth_element.
+// The histogram bins are defined by their edges, which are computed on the host and used as-is on the device, so an
+// entity falls in the same bin on both. The reference implementation below runs the same rules over host values.
+// -----------------------------------------------------------------------------
+
+// The group of an entity not counted in any group
+const unsigned int DIST_NULL_GROUP = 0xFFFFFFFFu;
+
+enum class DIST_GROUP_BY { NONE, FAMILY, REGION };
+
+/// The distribution summary of a group of entities
+struct DistributionGroupResult {
+    /// Number of entities in the group
+    size_t count = 0;
+    /// Sum of their values
+    double sum = 0.;
+    /// Smallest and largest values (0 if the group is empty)
+    float min = 0.f;
+    float max = 0.f;
+    /// Number of entities in each histogram bin, and below the first/at or above the last bin edge
+    std::vector<size_t> histogram;
+    size_t underflow = 0;
+    size_t overflow = 0;
+    /// The values at the requested quantiles (0 if the group is empty)
+    std::vector<float> quantiles;
+
+    /// Mean of the values (0 if the group is empty)
+    double Mean() const { return count > 0 ? sum / (double)count : 0.; }
+};
+
+/// The edges (nBins + 1) of nBins bins from lo to hi; evenly spaced, or in log scale (lo > 0) if log_bins
+inline std::vector<float> DistributionBinEdges(float lo, float hi, unsigned int nBins, bool log_bins) {
+    std::vector<float> edges(nBins + 1);
+    for (unsigned int i = 0; i <= nBins; i++) {
+        const double frac = (double)i / (double)nBins;
+        edges[i] = log_bins ? (float)((double)lo * std::pow((double)hi / (double)lo, frac))
+                            : (float)((double)lo + ((double)hi - (double)lo) * frac);
+    }
+    // The ends are exact regardless of rounding
+    edges.front() = lo;
+    edges.back() = hi;
+    return edges;
+}
+
+/// The slot of val in a histogram row, given the bin edges: its bin, or nBins if below the first edge, or nBins + 1 if
+/// at or above the last (the device version in DEMDistributionKernels.cu does the same search)
+inline unsigned int DistributionHistSlot(float val, const float* edges, unsigned int nBins) {
+    if (val < edges[0])
+        return nBins;
+    if (!(val < edges[nBins]))
+        return nBins + 1;
+    // The last edge not above val
+    unsigned int lo = 0, hi = nBins;
+    while (hi - lo > 1) {
+        const unsigned int mid = (lo + hi) / 2;
+        if (edges[mid] <= val) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/// A float as an unsigned int of the same order
+inline uint32_t DistributionOrderedKey(float val) {
+    uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+inline float DistributionKeyToFloat(uint32_t key) {
+    const uint32_t bits = (key & 0x80000000u) ? (key & 0x7FFFFFFFu) : ~key;
+    float val;
+    std::memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+/// The position, among count values in increasing order, of quantile q (nearest rank, with q clamped to [0, 1])
+inline size_t DistributionQuantileRank(float q, size_t count) {
+    if (count == 0)
+        return 0;
+    const double qq = std::min(std::max((double)q, 0.), 1.);
+    return std::min((size_t)std::floor(qq * (double)(count - 1) + 0.5), count - 1);
+}
+
+/// The sort key of an entry for the quantiles: its group then its value, or all 1 bits (sorted last) if it is not
+/// counted (makeDistributionSortKeys in DEMDistributionKernels.cu makes the same keys)
+inline uint64_t DistributionSortKey(float val, unsigned int g, unsigned int nGroups) {
+    return (g < nGroups && !std::isnan(val)) ? (((uint64_t)g << 32) | DistributionOrderedKey(val)) : ~(uint64_t)0;
+}
+
+/// The positions of the quantiles of each group in the sorted keys (nQuantiles per group, in group order), given the
+/// group counts. Those of an empty group are not used, and stay at 0.
+inline std::vector<size_t> DistributionQuantilePositions(const unsigned long long* counts,
+                                                         unsigned int nGroups,
+                                                         const std::vector<float>& quantiles) {
+    std::vector<size_t> positions((size_t)nGroups * quantiles.size(), 0);
+    size_t groupStart = 0;
+    for (unsigned int g = 0; g < nGroups; g++) {
+        for (size_t k = 0; k < quantiles.size() && counts[g] > 0; k++) {
+            positions[g * quantiles.size() + k] =
+                groupStart + DistributionQuantileRank(quantiles[k], (size_t)counts[g]);
+        }
+        groupStart += counts[g];
+    }
+    return positions;
+}
+
+/// Assemble the summaries of nGroups groups from the raw accumulated results: counts, sums, the ordered keys of the
+/// extremes, the histograms (a row of nBins + 2 per group: the bins, then under- and overflow), and the quantile
+/// values (nQuantiles per group, in group order)
+inline std::vector<DistributionGroupResult> AssembleDistributionResults(unsigned int nGroups,
+                                                                        unsigned int nBins,
+                                                                        size_t nQuantiles,
+                                                                        const unsigned long long* counts,
+                                                                        const double* sums,
+                                                                        const uint32_t* min_keys,
+                                                                        const uint32_t* max_keys,
+                                                                        const unsigned long long* hist,
+                                                                        const float* quantile_vals) {
+    std::vector<DistributionGroupResult> res(nGroups);
+    for (unsigned int g = 0; g < nGroups; g++) {
+        auto& group = res[g];
+        group.count = (size_t)counts[g];
+        group.sum = sums[g];
+        if (group.count > 0) {
+            group.min = DistributionKeyToFloat(min_keys[g]);
+            group.max = DistributionKeyToFloat(max_keys[g]);
+        }
+        if (nBins > 0) {
+            const unsigned long long* row = hist + (size_t)g * (nBins + 2);
+            group.histogram.assign(row, row + nBins);
+            group.underflow = (size_t)row[nBins];
+            group.overflow = (size_t)row[nBins + 1];
+        }
+        group.quantiles.assign(nQuantiles, 0.f);
+        if (group.count > 0) {
+            for (size_t k = 0; k < nQuantiles; k++)
+                group.quantiles[k] = quantile_vals[(size_t)g * nQuantiles + k];
+        }
+    }
+    return res;
+}
+
+/// The host reference of a distribution inspection: the summaries of nGroups groups of values, where groups[i] is the
+/// group of values[i] (DIST_NULL_GROUP, a group past the last, or a NaN value means it is not counted). bin_edges may
+/// be empty (no histogram).
+inline std::vector<DistributionGroupResult> ReferenceDistribution(const std::vector<float>& values,
+                                                                  const std::vector<unsigned int>& groups,
+                                                                  unsigned int nGroups,
+                                                                  const std::vector<float>& bin_edges,
+                                                                  const std::vector<float>& quantiles) {
+    const unsigned int nBins = bin_edges.empty() ? 0 : (unsigned int)bin_edges.size() - 1;
+    std::vector<unsigned long long> counts(nGroups, 0), hist((size_t)nGroups * (nBins + 2), 0);
+    std::vector<double> sums(nGroups, 0.);
+    std::vector<uint32_t> min_keys(nGroups, 0xFFFFFFFFu), max_keys(nGroups, 0);
+    std::vector<std::vector<float>> members(nGroups);
+    for (size_t i = 0; i < values.size(); i++) {
+        const unsigned int g = groups[i];
+        const float val = values[i];
+        if (g >= nGroups || std::isnan(val))
+            continue;
+        counts[g]++;
+        sums[g] += (double)val;
+        min_keys[g] = std::min(min_keys[g], DistributionOrderedKey(val));
+        max_keys[g] = std::max(max_keys[g], DistributionOrderedKey(val));
+        if (nBins > 0)
+            hist[(size_t)g * (nBins + 2) + DistributionHistSlot(val, bin_edges.data(), nBins)]++;
+        members[g].push_back(val);
+    }
+    std::vector<float> quantile_vals((size_t)nGroups * quantiles.size(), 0.f);
+    for (unsigned int g = 0; g < nGroups; g++) {
+        auto& vals = members[g];
+        for (size_t k = 0; k < quantiles.size() && !vals.empty(); k++) {
+            const size_t rank = DistributionQuantileRank(quantiles[k], vals.size());
+            std::nth_element(vals.begin(), vals.begin() + rank, vals.end());
+            quantile_vals[(size_t)g * quantiles.size() + k] = vals[rank];
+        }
+    }
+    return AssembleDistributionResults(nGroups, nBins, quantiles.size(), counts.data(), sums.data(), min_keys.data(),
+                                       max_keys.data(), hist.data(), quantile_vals.data());
+}
+
+}  // namespace deme
+
+#endif
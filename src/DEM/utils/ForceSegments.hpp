@@ -0,0 +1,132 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_FORCE_SEGMENTS_HPP
+#define DEME_FORCE_SEGMENTS_HPP
+
+#include <string>
+#include <vector>
+
+#include <DEM/VariableTypes.h>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Contact type-segmented force calculation
+//
+// When kT ships contact pairs sorted by type, the pairs of each type form a segment. Instead of one kernel that
+// branches on the contact type, dT can then run a kernel specialized for each type present: the force kernel body is a
+// device function templated on a mask of the contact types it handles (a bit per type), so the geometric code of the
+// other types is compiled out. The wrapper kernels are generated here as JIT source, one per type that can appear in
+// this simulation, plus one that handles all of them. Segments smaller than a fuse size are merged with neighboring
+// small ones and run by the all-type kernel, so tiny segments do not each cost a kernel launch.
+//
+// The segment bounds come from the device as bounds[t] = the first pair of type t or larger, for t in [0, nSlots], so
+// the pairs of type t are [bounds[t], bounds[t + 1]).
+//
+// DEMtest_ForceSegments plans the launches of random sorted pairs, with the bounds found as findContactTypeSegments
+// finds them, and checks that the generated kernels cover every pair with a kernel specialized for its type.
+// -----------------------------------------------------------------------------
+
+// Contact types are smaller than this, so per-type arrays can be indexed by type
+const unsigned int NUM_CONTACT_TYPE_SLOTS = 16;
+
+// One kernel launch of the segmented force calculation
+struct ForceSegmentLaunch {
+    size_t start = 0;
+    size_t count = 0;
+    // Types of the pairs in it
+    unsigned int typeMask = 0;
+    // Types the kernel used is specialized for (a superset of typeMask)
+    unsigned int kernelMask = 0;
+};
+
+inline unsigned int ContactTypeBit(unsigned int type) {
+    return 1u << type;
+}
+
+inline unsigned int NumContactTypesInMask(unsigned int mask) {
+    unsigned int n = 0;
+    for (; mask; mask &= mask - 1)
+        n++;
+    return n;
+}
+
+/// Name of the generated force kernel specialized for a mask of contact types
+inline std::string ForceSegmentKernelName(unsigned int mask) {
+    return "calculateContactForcesOfTypes_" + std::to_string(mask);
+}
+
+/// Generate the specialized force kernels: one per type in compiled_mask, plus one for all of them if more than one
+inline std::string GenerateForceSegmentKernels(unsigned int compiled_mask) {
+    std::vector<unsigned int> masks;
+    for (unsigned int t = 0; t < NUM_CONTACT_TYPE_SLOTS; t++) {
+        if (compiled_mask & ContactTypeBit(t))
+            masks.push_back(ContactTypeBit(t));
+    }
+    if (masks.size() > 1)
+        masks.push_back(compiled_mask);
+    std::string code;
+    for (const auto& mask : masks) {
+        code += "__global__ void " + ForceSegmentKernelName(mask) +
+                "(deme::DEMSimParams* simParams, deme::DEMDataDT* granData, deme::contactPairs_t segStart, "
+                "size_t segLen) {\n";
+        code += "    deme::contactPairs_t myContactID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;\n";
+        code += "    if (myContactID < segLen) {\n";
+        code += "        calculateContactForceOf<" + std::to_string(mask) +
+                "u>(simParams, granData, segStart + myContactID);\n";
+        code += "    }\n";
+        code += "}\n";
+    }
+    return code;
+}
+
+/// Plan the launches from the segment bounds (nSlots + 1 of them) of nPairs sorted pairs. Returns false, with no
+/// launches, if the bounds do not describe the pairs or a type present has no compiled kernel; the caller should then
+/// use the generic kernel.
+inline bool PlanForceSegments(const contactPairs_t* bounds,
+                              size_t nPairs,
+                              unsigned int compiled_mask,
+                              size_t fuse_size,
+                              std::vector<ForceSegmentLaunch>& launches) {
+    launches.clear();
+    if (bounds[0] != 0 || bounds[NUM_CONTACT_TYPE_SLOTS] != nPairs)
+        return false;
+    bool last_is_fused = false;
+    for (unsigned int t = 0; t < NUM_CONTACT_TYPE_SLOTS; t++) {
+        if (bounds[t + 1] < bounds[t]) {
+            launches.clear();
+            return false;
+        }
+        size_t count = bounds[t + 1] - bounds[t];
+        if (count == 0)
+            continue;
+        if (!(compiled_mask & ContactTypeBit(t))) {
+            launches.clear();
+            return false;
+        }
+        if (count >= fuse_size) {
+            launches.push_back({bounds[t], count, ContactTypeBit(t), ContactTypeBit(t)});
+            last_is_fused = false;
+        } else if (last_is_fused) {
+            // Small segments are contiguous in the sorted pairs, so they merge into one range
+            launches.back().count += count;
+            launches.back().typeMask |= ContactTypeBit(t);
+        } else {
+            launches.push_back({bounds[t], count, ContactTypeBit(t), 0});
+            last_is_fused = true;
+        }
+    }
+    // A fused launch with more than one type needs the all-type kernel
+    for (auto& launch : launches) {
+        if (launch.kernelMask == 0)
+            launch.kernelMask = (NumContactTypesInMask(launch.typeMask) > 1) ? compiled_mask : launch.typeMask;
+    }
+    return true;
+}
+
+}  // namespace deme
+
+#endif
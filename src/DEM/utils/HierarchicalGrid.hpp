@@ -0,0 +1,317 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_HIERARCHICAL_GRID_HPP
+#define DEME_HIERARCHICAL_GRID_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+#include <DEM/Defines.h>
+#include <DEM/HostSideHelpers.hpp>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Hierarchical grid for sphere--sphere contact detection
+//
+// With a single bin size, a strongly polydisperse system either has bins crammed with fines, or large spheres that
+// touch hundreds of bins. The hierarchical grid instead has levels whose cell sizes are c0 * 2^l, and each sphere is
+// put, by its center, in exactly one cell of the finest level whose cells are no smaller than its diameter. Then two
+// spheres at levels la <= lb that are in contact have center distance < ra + rb <= c_lb, so B is in one of the 27 cells
+// around A's center at level lb. Each sphere therefore searches the 27 neighbor cells at its own level and at every
+// coarser level. A pair at the same level is reported by the sphere with the smaller ID; a cross-level pair is reported
+// only by the finer sphere, so every pair is found exactly once.
+//
+// Cells are identified by a 64-bit key: the level in the top bits, then the linear cell index of that level, so sorting
+// the keys groups the spheres level by level and cell by cell. kT runs the same procedure on the device (with expanded
+// radii and the family masks); the host version here is the reference it is checked against.
+// -----------------------------------------------------------------------------
+
+constexpr unsigned int HIER_GRID_MAX_LEVELS = 1u << DEME_HIER_GRID_LEVEL_BITS;
+constexpr uint64_t HIER_GRID_MAX_CELLS_PER_LEVEL = (uint64_t)1 << (64 - DEME_HIER_GRID_LEVEL_BITS);
+
+// Number of levels needed so that, with finest cell size cell_size0, the coarsest cells are no smaller than the
+// diameter of the largest sphere
+inline unsigned int hierGridNumLevels(double cell_size0, double max_radius) {
+    unsigned int n = 1;
+    double c = cell_size0;
+    while (c < 2. * max_radius && n < HIER_GRID_MAX_LEVELS) {
+        c *= 2.;
+        n++;
+    }
+    return n;
+}
+
+// The finest level whose cells are no smaller than the diameter of a sphere of this radius
+inline unsigned int hierGridLevelOf(double radius, double cell_size0, unsigned int n_levels) {
+    unsigned int l = 0;
+    double c = cell_size0;
+    while (c < 2. * radius && l + 1 < n_levels) {
+        c *= 2.;
+        l++;
+    }
+    return l;
+}
+
+// Cell numbers of a level, for a domain of this size
+inline int3 hierGridLevelDims(const double3& domain_size, double cell_size) {
+    return make_int3((int)std::max(1., std::ceil(domain_size.x / cell_size)),
+                     (int)std::max(1., std::ceil(domain_size.y / cell_size)),
+                     (int)std::max(1., std::ceil(domain_size.z / cell_size)));
+}
+
+inline uint64_t hierGridCellKey(unsigned int level, const int3& cell, const int3& dims) {
+    return ((uint64_t)level << (64 - DEME_HIER_GRID_LEVEL_BITS)) |
+           ((uint64_t)cell.x + (uint64_t)dims.x * ((uint64_t)cell.y + (uint64_t)dims.y * (uint64_t)cell.z));
+}
+
+// Double the finest cell size until the finest level has few enough cells for the key. Returns the cell size to use.
+inline double hierGridFitCellSize(const double3& domain_size, double cell_size0) {
+    while (true) {
+        int3 dims = hierGridLevelDims(domain_size, cell_size0);
+        if ((double)dims.x * (double)dims.y * (double)dims.z < (double)HIER_GRID_MAX_CELLS_PER_LEVEL)
+            return cell_size0;
+        cell_size0 *= 2.;
+    }
+}
+
+class HierarchicalGrid {
+  public:
+    HierarchicalGrid() {}
+    ~HierarchicalGrid() {}
+
+    /// Put the spheres in the grid. If cell_size0 is not positive, the diameter of the smallest sphere is used. Returns
+    /// false if there is no sphere.
+    bool Build(const std::vector<float3>& pos, const std::vector<float>& radii, double cell_size0 = 0.) {
+        const size_t n = pos.size();
+        sortedKeys.clear();
+        sortedIDs.clear();
+        levelOf.clear();
+        levelDims.clear();
+        if (n == 0 || radii.size() != n)
+            return false;
+
+        double minR = std::numeric_limits<double>::infinity(), maxR = 0.;
+        double3 lo = make_double3(DEME_HUGE_FLOAT, DEME_HUGE_FLOAT, DEME_HUGE_FLOAT);
+        double3 hi = make_double3(-DEME_HUGE_FLOAT, -DEME_HUGE_FLOAT, -DEME_HUGE_FLOAT);
+        for (size_t i = 0; i < n; i++) {
+            minR = std::min(minR, (double)radii[i]);
+            maxR = std::max(maxR, (double)radii[i]);
+            lo.x = std::min(lo.x, (double)pos[i].x);
+            lo.y = std::min(lo.y, (double)pos[i].y);
+            lo.z = std::min(lo.z, (double)pos[i].z);
+            hi.x = std::max(hi.x, (double)pos[i].x);
+            hi.y = std::max(hi.y, (double)pos[i].y);
+            hi.z = std::max(hi.z, (double)pos[i].z);
+        }
+        origin = lo;
+        if (cell_size0 <= 0.)
+            cell_size0 = std::max(2. * minR, DEME_TINY_FLOAT);
+        // The domain is padded by one cell so that a sphere on the upper boundary still has a valid cell
+        double3 domain_size =
+            make_double3(hi.x - lo.x + cell_size0, hi.y - lo.y + cell_size0, hi.z - lo.z + cell_size0);
+        cellSize0 = hierGridFitCellSize(domain_size, cell_size0);
+        nLevels = hierGridNumLevels(cellSize0, maxR);
+        for (unsigned int l = 0; l < nLevels; l++) {
+            levelDims.push_back(hierGridLevelDims(domain_size, GetCellSize(l)));
+        }
+
+        levelOf.resize(n);
+        std::vector<uint64_t> keys(n);
+        for (size_t i = 0; i < n; i++) {
+            levelOf[i] = hierGridLevelOf(radii[i], cellSize0, nLevels);
+            keys[i] = hierGridCellKey(levelOf[i], cellOf(pos[i], levelOf[i]), levelDims[levelOf[i]]);
+        }
+        sortedIDs.resize(n);
+        std::iota(sortedIDs.begin(), sortedIDs.end(), 0);
+        std::stable_sort(sortedIDs.begin(), sortedIDs.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+        sortedKeys.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            sortedKeys[i] = keys[sortedIDs[i]];
+        }
+        return true;
+    }
+
+    /// Call func(j) for every sphere j that sphere i is responsible for checking against (see the rules above)
+    template <typename Func>
+    void ForEachCandidate(const std::vector<float3>& pos, size_t i, const Func& func) const {
+        const unsigned int myLevel = levelOf[i];
+        for (unsigned int l = myLevel; l < nLevels; l++) {
+            const int3 c = cellOf(pos[i], l);
+            const int3& dims = levelDims[l];
+            for (int dz = -1; dz <= 1; dz++) {
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int3 nc = make_int3(c.x + dx, c.y + dy, c.z + dz);
+                        if (nc.x < 0 || nc.y < 0 || nc.z < 0 || nc.x >= dims.x || nc.y >= dims.y || nc.z >= dims.z)
+                            continue;
+                        const uint64_t key = hierGridCellKey(l, nc, dims);
+                        auto range = std::equal_range(sortedKeys.begin(), sortedKeys.end(), key);
+                        for (auto it = range.first; it != range.second; ++it) {
+                            size_t j = sortedIDs[it - sortedKeys.begin()];
+                            if (l == myLevel && j <= i)
+                                continue;
+                            func(j);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /// All sphere pairs (i < j) whose overlap is positive
+    std::vector<std::pair<size_t, size_t>> FindPairs(const std::vector<float3>& pos,
+                                                     const std::vector<float>& radii,
+                                                     size_t* n_candidates = nullptr) const {
+        std::vector<std::pair<size_t, size_t>> res;
+        size_t n_cand = 0;
+        for (size_t i = 0; i < pos.size(); i++) {
+            ForEachCandidate(pos, i, [&](size_t j) {
+                n_cand++;
+                if (spheresOverlap(pos[i], radii[i], pos[j], radii[j]))
+                    res.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+            });
+        }
+        if (n_candidates)
+            *n_candidates = n_cand;
+        return res;
+    }
+
+    unsigned int GetNumLevels() const { return nLevels; }
+    double GetCellSize(unsigned int level) const { return cellSize0 * (double)((uint64_t)1 << level); }
+    const std::vector<unsigned int>& GetLevels() const { return levelOf; }
+    std::vector<size_t> GetNumSpheresEachLevel() const {
+        std::vector<size_t> res(nLevels, 0);
+        for (const auto l : levelOf)
+            res[l]++;
+        return res;
+    }
+
+    // The same overlap test as the device, minus the margins
+    static bool spheresOverlap(const float3& pA, float rA, const float3& pB, float rB) {
+        double dx = (double)pA.x - pB.x, dy = (double)pA.y - pB.y, dz = (double)pA.z - pB.z;
+        double sumR = (double)rA + rB;
+        return dx * dx + dy * dy + dz * dz < sumR * sumR;
+    }
+
+  private:
+    double cellSize0 = 0.;
+    unsigned int nLevels = 0;
+    double3 origin = make_double3(0, 0, 0);
+    std::vector<int3> levelDims;
+    std::vector<unsigned int> levelOf;
+    std::vector<uint64_t> sortedKeys;
+    std::vector<size_t> sortedIDs;
+
+    int3 cellOf(const float3& p, unsigned int level) const {
+        const double c = GetCellSize(level);
+        const int3& dims = levelDims[level];
+        return make_int3(clampBetween<int, int>((int)std::floor(((double)p.x - origin.x) / c), 0, dims.x - 1),
+                         clampBetween<int, int>((int)std::floor(((double)p.y - origin.y) / c), 0, dims.y - 1),
+                         clampBetween<int, int>((int)std::floor(((double)p.z - origin.z) / c), 0, dims.z - 1));
+    }
+};
+
+// Statistics of the single-grid pair search, the quantities that hurt it in polydisperse systems
+struct SingleGridStats {
+    size_t numActiveBins = 0;
+    size_t numBinSphereTouches = 0;
+    size_t maxSpheresInBin = 0;
+    size_t numCandidates = 0;
+};
+
+// The reference pair list of the single-grid (bin) contact detection: every sphere is listed in all the bins its
+// bounding box touches, and a pair is reported by the bin that contains the contact point, like kT's bin kernels do.
+inline std::vector<std::pair<size_t, size_t>> singleGridSpherePairs(const std::vector<float3>& pos,
+                                                                    const std::vector<float>& radii,
+                                                                    double bin_size,
+                                                                    SingleGridStats* stats = nullptr) {
+    std::vector<std::pair<size_t, size_t>> res;
+    const size_t n = pos.size();
+    if (n == 0)
+        return res;
+    double3 lo = make_double3(DEME_HUGE_FLOAT, DEME_HUGE_FLOAT, DEME_HUGE_FLOAT);
+    for (size_t i = 0; i < n; i++) {
+        lo.x = std::min(lo.x, (double)pos[i].x - radii[i]);
+        lo.y = std::min(lo.y, (double)pos[i].y - radii[i]);
+        lo.z = std::min(lo.z, (double)pos[i].z - radii[i]);
+    }
+    auto binOf = [&](double x, double y, double z) {
+        return make_int3((int)std::floor((x - lo.x) / bin_size), (int)std::floor((y - lo.y) / bin_size),
+                         (int)std::floor((z - lo.z) / bin_size));
+    };
+    // (bin, sphere) touch pairs, sorted by bin, as the device does with a radix sort
+    std::vector<std::pair<uint64_t, size_t>> touches;
+    int3 maxBin = make_int3(0, 0, 0);
+    std::vector<int3> binLo(n), binHi(n);
+    for (size_t i = 0; i < n; i++) {
+        binLo[i] = binOf(pos[i].x - radii[i], pos[i].y - radii[i], pos[i].z - radii[i]);
+        binHi[i] = binOf(pos[i].x + radii[i], pos[i].y + radii[i], pos[i].z + radii[i]);
+        maxBin.x = std::max(maxBin.x, binHi[i].x);
+        maxBin.y = std::max(maxBin.y, binHi[i].y);
+        maxBin.z = std::max(maxBin.z, binHi[i].z);
+    }
+    const uint64_t nbX = maxBin.x + 1, nbY = maxBin.y + 1;
+    auto binID = [&](const int3& b) { return (uint64_t)b.x + nbX * ((uint64_t)b.y + nbY * (uint64_t)b.z); };
+    for (size_t i = 0; i < n; i++) {
+        for (int z = binLo[i].z; z <= binHi[i].z; z++)
+            for (int y = binLo[i].y; y <= binHi[i].y; y++)
+                for (int x = binLo[i].x; x <= binHi[i].x; x++)
+                    touches.push_back(std::make_pair(binID(make_int3(x, y, z)), i));
+    }
+    std::sort(touches.begin(), touches.end());
+
+    SingleGridStats st;
+    st.numBinSphereTouches = touches.size();
+    for (size_t start = 0; start < touches.size();) {
+        size_t end = start;
+        while (end < touches.size() && touches[end].first == touches[start].first)
+            end++;
+        st.numActiveBins++;
+        st.maxSpheresInBin = std::max(st.maxSpheresInBin, end - start);
+        for (size_t a = start; a < end; a++) {
+            for (size_t b = a + 1; b < end; b++) {
+                size_t i = touches[a].second, j = touches[b].second;
+                st.numCandidates++;
+                if (!HierarchicalGrid::spheresOverlap(pos[i], radii[i], pos[j], radii[j]))
+                    continue;
+                // Contact point: from B's center towards A's, radB minus half the overlap
+                double dx = (double)pos[i].x - pos[j].x, dy = (double)pos[i].y - pos[j].y,
+                       dz = (double)pos[i].z - pos[j].z;
+                double d = std::sqrt(dx * dx + dy * dy + dz * dz);
+                double s = (d > 0.) ? ((double)radii[j] - ((double)radii[i] + radii[j] - d) / 2.) / d : 0.;
+                int3 cb = binOf(pos[j].x + s * dx, pos[j].y + s * dy, pos[j].z + s * dz);
+                if (binID(cb) == touches[start].first)
+                    res.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+            }
+        }
+        start = end;
+    }
+    if (stats)
+        *stats = st;
+    return res;
+}
+
+// All sphere pairs (i < j) whose overlap is positive, by checking every pair
+inline std::vector<std::pair<size_t, size_t>> bruteForceSpherePairs(const std::vector<float3>& pos,
+                                                                    const std::vector<float>& radii) {
+    std::vector<std::pair<size_t, size_t>> res;
+    for (size_t i = 0; i < pos.size(); i++) {
+        for (size_t j = i + 1; j < pos.size(); j++) {
+            if (HierarchicalGrid::spheresOverlap(pos[i], radii[i], pos[j], radii[j]))
+                res.push_back(std::make_pair(i, j));
+        }
+    }
+    return res;
+}
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,498 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_HOST_FORCE_MODEL_HPP
+#define DEME_HOST_FORCE_MODEL_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <core/utils/GpuError.h>
+#include <DEM/Defines.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <kernel/DEMHelperKernels.cuh>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Host execution of force models
+//
+// The force model sources in kernel/DEMCustomizablePolicies (and custom ones written the same way) are fragments that
+// the solver substitutes into calculateContactForces, where the contact geometry, the ingredients
+// (_forceModelIngredientDefinition_ and co.), the material properties (_materialDefs_) and the contact wildcards are
+// already defined by name. A host model is a class whose calc() defines the same names for one contact of a
+// HostContactBatch, with the model source substituted in at configure time: deme_generate_host_force_model
+// (src/DEM/CMakeLists.txt) does that with utils/HostForceModelClass.hpp.in, and makes the built-in
+// HostFullHertzianForceModel and HostFrictionlessHertzianForceModel (generated DEM/utils/<class name>.hpp headers).
+// A batch keeps the contact states in columns, which CalcHostContactForces runs the model over, in threads over fixed
+// blocks of contacts. A batch can be written to and read from CSV, so the states and results of a run can be recorded,
+// then later compared against by ValidateHostForceModel, for example to check a custom model or another build against
+// a reference. The solver can dump the states and results of its force calculation into a batch
+// (DEMSolver::SetContactStateDump), so a host model can be checked against the device (DEMdemo_HostForceModelCheck
+// does that).
+// There is no SIMD path: the per-contact loop is not vectorized, and a host run is parallel over threads only.
+// The loop carries a vectorization hint, but with GCC 12 (-O3 -ffast-math -march=native) the loop of the built-in
+// models stays scalar, since the material lookups are gathers under the model's overlap branch and the model computes
+// in double; the model sources are shared with the device, so they are not restructured for the host. The hinted loop
+// therefore gives the same results, at the same speed, as the plain one.
+//
+// Available to a model: the geometry (overlapDepth, B2A, locCPA, locCPB), the owner ingredients (AOwnerMass,
+// BOwnerMass, ARadius, BRadius, bodyAMatType, bodyBMatType, AOwnerFamily, BOwnerFamily, ALinVel, BLinVel, ARotVel,
+// BRotVel, AOriQ, BOriQ, AOwnerMOI, BOwnerMOI), ts and time, the material properties of the batch's HostMaterialTable
+// (E and nu per material; CoR, mu and Crr pairwise), the contact wildcards delta_time and delta_tan_x/y/z, and the
+// outputs force and torque_only_force. Owner, geometry and other wildcards, and owner/geometry IDs, are not.
+// -----------------------------------------------------------------------------
+
+/// Vectorization hint for the per-contact loop: OpenMP SIMD if the build enables it (-fopenmp or -fopenmp-simd sets
+/// _OPENMP only for the former, so the latter falls to the compiler-specific hint)
+#if defined(_OPENMP)
+    #define DEME_HOST_SIMD_LOOP _Pragma("omp simd")
+#elif defined(__clang__)
+    #define DEME_HOST_SIMD_LOOP _Pragma("clang loop vectorize(enable)")
+#elif defined(__GNUC__)
+    #define DEME_HOST_SIMD_LOOP _Pragma("GCC ivdep")
+#else
+    #define DEME_HOST_SIMD_LOOP
+#endif
+
+/// The per-contact model has to be inlined into the loop for it to vectorize
+#if defined(__GNUC__) || defined(__clang__)
+    #define DEME_HOST_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+    #define DEME_HOST_INLINE __forceinline
+#else
+    #define DEME_HOST_INLINE inline
+#endif
+
+/// The columns of a HostContactBatch. Those before HOST_CONTACT_HIST_OUT are what the force model is given; the rest
+/// are what it produces (the contact wildcards after the step, the forces, and the torques on A and B in their local
+/// frames, as the force collection makes them).
+enum HOST_CONTACT_COL : unsigned int {
+    HC_OVERLAP,
+    HC_B2A_X,
+    HC_B2A_Y,
+    HC_B2A_Z,
+    HC_CPA_X,
+    HC_CPA_Y,
+    HC_CPA_Z,
+    HC_CPB_X,
+    HC_CPB_Y,
+    HC_CPB_Z,
+    HC_A_MASS,
+    HC_B_MASS,
+    HC_A_RADIUS,
+    HC_B_RADIUS,
+    HC_A_MAT,
+    HC_B_MAT,
+    HC_A_FAMILY,
+    HC_B_FAMILY,
+    HC_A_VEL_X,
+    HC_A_VEL_Y,
+    HC_A_VEL_Z,
+    HC_B_VEL_X,
+    HC_B_VEL_Y,
+    HC_B_VEL_Z,
+    HC_A_ROTVEL_X,
+    HC_A_ROTVEL_Y,
+    HC_A_ROTVEL_Z,
+    HC_B_ROTVEL_X,
+    HC_B_ROTVEL_Y,
+    HC_B_ROTVEL_Z,
+    HC_A_QW,
+    HC_A_QX,
+    HC_A_QY,
+    HC_A_QZ,
+    HC_B_QW,
+    HC_B_QX,
+    HC_B_QY,
+    HC_B_QZ,
+    HC_A_MOI_X,
+    HC_A_MOI_Y,
+    HC_A_MOI_Z,
+    HC_B_MOI_X,
+    HC_B_MOI_Y,
+    HC_B_MOI_Z,
+    HC_DELTA_TIME,
+    HC_DELTA_TAN_X,
+    HC_DELTA_TAN_Y,
+    HC_DELTA_TAN_Z,
+    HC_DELTA_TIME_OUT,
+    HC_DELTA_TAN_X_OUT,
+    HC_DELTA_TAN_Y_OUT,
+    HC_DELTA_TAN_Z_OUT,
+    HC_FORCE_X,
+    HC_FORCE_Y,
+    HC_FORCE_Z,
+    HC_TORQUE_ONLY_FORCE_X,
+    HC_TORQUE_ONLY_FORCE_Y,
+    HC_TORQUE_ONLY_FORCE_Z,
+    HC_TORQUE_A_X,
+    HC_TORQUE_A_Y,
+    HC_TORQUE_A_Z,
+    HC_TORQUE_B_X,
+    HC_TORQUE_B_Y,
+    HC_TORQUE_B_Z,
+    HC_NUM_COLS
+};
+constexpr unsigned int HOST_CONTACT_HIST_OUT = HC_DELTA_TIME_OUT;
+/// A row of the solver's contact state dump: the columns, then 1 if the pair was in contact in the force calculation
+constexpr unsigned int HOST_CONTACT_DUMP_WIDTH = HC_NUM_COLS + 1;
+
+constexpr const char* HOST_CONTACT_COL_NAMES[HC_NUM_COLS] = {
+    "overlap",        "B2A_x",          "B2A_y",          "B2A_z",          "locCPA_x",       "locCPA_y",
+    "locCPA_z",       "locCPB_x",       "locCPB_y",       "locCPB_z",       "A_mass",         "B_mass",
+    "A_radius",       "B_radius",       "A_mat",          "B_mat",          "A_family",       "B_family",
+    "A_vel_x",        "A_vel_y",        "A_vel_z",        "B_vel_x",        "B_vel_y",        "B_vel_z",
+    "A_rotvel_x",     "A_rotvel_y",     "A_rotvel_z",     "B_rotvel_x",     "B_rotvel_y",     "B_rotvel_z",
+    "A_qw",           "A_qx",           "A_qy",           "A_qz",           "B_qw",           "B_qx",
+    "B_qy",           "B_qz",           "A_moi_x",        "A_moi_y",        "A_moi_z",        "B_moi_x",
+    "B_moi_y",        "B_moi_z",        "delta_time",     "delta_tan_x",    "delta_tan_y",    "delta_tan_z",
+    "delta_time_out", "delta_tan_x_out", "delta_tan_y_out", "delta_tan_z_out", "force_x",      "force_y",
+    "force_z",        "tof_x",          "tof_y",          "tof_z",          "torque_A_x",     "torque_A_y",
+    "torque_A_z",     "torque_B_x",     "torque_B_y",     "torque_B_z"};
+
+/// The states of a batch of contacts, one column per HOST_CONTACT_COL, in the frames the force kernel uses: B2A and the
+/// velocities in the global frame, the contact points and rotational velocities in the owners' local frames
+class HostContactBatch {
+  public:
+    HostContactBatch() : m_cols(HC_NUM_COLS) {}
+    explicit HostContactBatch(size_t n) : m_cols(HC_NUM_COLS) { resize(n); }
+
+    void resize(size_t n) {
+        for (unsigned int c = 0; c < HC_NUM_COLS; c++) {
+            // Identity orientation for new contacts
+            const bool isQw = (c == HC_A_QW || c == HC_B_QW);
+            m_cols[c].resize(n, isQw ? 1.f : 0.f);
+        }
+    }
+    size_t size() const { return m_cols[0].size(); }
+
+    std::vector<float>& col(HOST_CONTACT_COL c) { return m_cols[c]; }
+    const std::vector<float>& col(HOST_CONTACT_COL c) const { return m_cols[c]; }
+    float& at(HOST_CONTACT_COL c, size_t i) { return m_cols[c][i]; }
+    float at(HOST_CONTACT_COL c, size_t i) const { return m_cols[c][i]; }
+
+    /// Set a 3-component quantity starting at column c
+    void set3(HOST_CONTACT_COL c, size_t i, const float3& v) {
+        m_cols[c][i] = v.x;
+        m_cols[c + 1][i] = v.y;
+        m_cols[c + 2][i] = v.z;
+    }
+    float3 get3(HOST_CONTACT_COL c, size_t i) const {
+        return make_float3(m_cols[c][i], m_cols[c + 1][i], m_cols[c + 2][i]);
+    }
+    void setQ(HOST_CONTACT_COL c, size_t i, const float4& q) {
+        m_cols[c][i] = q.w;
+        m_cols[c + 1][i] = q.x;
+        m_cols[c + 2][i] = q.y;
+        m_cols[c + 3][i] = q.z;
+    }
+
+    /// Make the contact wildcards after the step the ones before the next, to run consecutive steps
+    void advanceHistory() {
+        for (unsigned int c = 0; c < HOST_CONTACT_HIST_OUT - HC_DELTA_TIME; c++)
+            m_cols[HC_DELTA_TIME + c] = m_cols[HOST_CONTACT_HIST_OUT + c];
+    }
+
+    /// Pointers to the columns, for the per-contact loops
+    void colPointers(float** ptrs) {
+        for (unsigned int c = 0; c < HC_NUM_COLS; c++)
+            ptrs[c] = m_cols[c].data();
+    }
+
+    /// Append the rows of a contact state dump (HOST_CONTACT_DUMP_WIDTH floats each) of the pairs that were in contact
+    void appendDumpRows(const float* rows, size_t n_rows) {
+        for (size_t r = 0; r < n_rows; r++) {
+            const float* row = rows + r * HOST_CONTACT_DUMP_WIDTH;
+            if (row[HC_NUM_COLS] == 0.f)
+                continue;
+            for (unsigned int c = 0; c < HC_NUM_COLS; c++)
+                m_cols[c].push_back(row[c]);
+        }
+    }
+
+    /// Write all columns as CSV, one contact per row
+    void WriteCsv(const std::string& filename) const {
+        std::ofstream out(filename);
+        // Enough digits for the floats to read back exactly
+        out.precision(9);
+        for (unsigned int c = 0; c < HC_NUM_COLS; c++)
+            out << (c ? "," : "") << HOST_CONTACT_COL_NAMES[c];
+        out << "\n";
+        for (size_t i = 0; i < size(); i++) {
+            for (unsigned int c = 0; c < HC_NUM_COLS; c++)
+                out << (c ? "," : "") << m_cols[c][i];
+            out << "\n";
+        }
+    }
+
+    /// Read a CSV that WriteCsv wrote (columns can be in any order; those not there are left at their defaults)
+    void ReadCsv(const std::string& filename) {
+        std::ifstream in(filename);
+        std::string line;
+        if (!in.good() || !std::getline(in, line)) {
+            std::stringstream ss;
+            ss << "Contact state file " << filename << " cannot be read." << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+        std::vector<int> colOf;
+        {
+            std::stringstream header(line);
+            std::string name;
+            while (std::getline(header, name, ',')) {
+                name.erase(name.find_last_not_of(" \r\t") + 1);
+                auto it = std::find(HOST_CONTACT_COL_NAMES, HOST_CONTACT_COL_NAMES + HC_NUM_COLS, name);
+                colOf.push_back(it == HOST_CONTACT_COL_NAMES + HC_NUM_COLS ? -1
+                                                                            : (int)(it - HOST_CONTACT_COL_NAMES));
+            }
+        }
+        resize(0);
+        while (std::getline(in, line)) {
+            if (line.empty() || line == "\r")
+                continue;
+            const size_t i = size();
+            resize(i + 1);
+            std::stringstream row(line);
+            std::string val;
+            for (size_t k = 0; k < colOf.size() && std::getline(row, val, ','); k++) {
+                if (colOf[k] >= 0)
+                    m_cols[colOf[k]][i] = std::stof(val);
+            }
+        }
+    }
+
+  private:
+    std::vector<std::vector<float>> m_cols;
+};
+
+/// A pairwise material property, indexed like the jitified one: prop[matA][matB]
+struct HostPairwiseProp {
+    const float* data = nullptr;
+    unsigned int n = 0;
+    const float* operator[](unsigned int i) const { return data + (size_t)i * n; }
+};
+
+/// The material properties a force model reads, made like the solver makes them: a property a material lacks is 0,
+/// and a pairwise property defaults to the average of the two materials unless the pair is set
+class HostMaterialTable {
+  public:
+    HostMaterialTable(const std::vector<std::string>& pairwise_names = {"CoR", "mu", "Crr"})
+        : m_pairwise_names(pairwise_names) {}
+
+    /// Add a material, returning its index (what bodyAMatType and bodyBMatType refer to)
+    unsigned int LoadMaterial(const std::unordered_map<std::string, float>& props) {
+        m_mats.push_back(props);
+        m_built = false;
+        return (unsigned int)m_mats.size() - 1;
+    }
+    /// Set a pairwise property of two materials (both orders)
+    void SetMaterialPropertyPair(const std::string& name, unsigned int a, unsigned int b, float val) {
+        m_pair_overrides[name].push_back({a, b, val});
+        m_built = false;
+    }
+    unsigned int GetNumMaterials() const { return (unsigned int)m_mats.size(); }
+
+    /// The property of each material
+    const float* prop(const std::string& name) {
+        build(name);
+        return m_tables.at(name).data();
+    }
+    /// The pairwise property of each pair of materials
+    HostPairwiseProp pair(const std::string& name) {
+        build(name);
+        return HostPairwiseProp{m_tables.at(name).data(), GetNumMaterials()};
+    }
+
+  private:
+    struct PairOverride {
+        unsigned int a, b;
+        float val;
+    };
+    std::vector<std::string> m_pairwise_names;
+    std::vector<std::unordered_map<std::string, float>> m_mats;
+    std::unordered_map<std::string, std::vector<PairOverride>> m_pair_overrides;
+    std::unordered_map<std::string, std::vector<float>> m_tables;
+    bool m_built = false;
+
+    void build(const std::string& name) {
+        if (!m_built) {
+            m_tables.clear();
+            m_built = true;
+        }
+        if (m_tables.count(name))
+            return;
+        const unsigned int n = GetNumMaterials();
+        std::vector<float> diag(n, 0.f);
+        for (unsigned int i = 0; i < n; i++) {
+            auto it = m_mats[i].find(name);
+            if (it != m_mats[i].end())
+                diag[i] = it->second;
+        }
+        if (std::find(m_pairwise_names.begin(), m_pairwise_names.end(), name) == m_pairwise_names.end()) {
+            // At least one element, like the jitified array of a material-less system
+            diag.resize(std::max(n, 1u), 0.f);
+            m_tables[name] = diag;
+            return;
+        }
+        std::vector<float> table(std::max(n * n, 1u), 0.f);
+        for (unsigned int i = 0; i < n; i++) {
+            for (unsigned int j = 0; j < n; j++)
+                table[i * n + j] = (i == j) ? diag[i] : (diag[i] + diag[j]) / 2.f;
+        }
+        if (m_pair_overrides.count(name)) {
+            for (const auto& o : m_pair_overrides.at(name)) {
+                if (o.a >= n || o.b >= n) {
+                    std::stringstream ss;
+                    ss << "Material pair (" << o.a << ", " << o.b << ") of property " << name << " is out of the "
+                       << n << " materials loaded." << std::endl;
+                    throw std::runtime_error(ss.str());
+                }
+                table[o.a * n + o.b] = o.val;
+                table[o.b * n + o.a] = o.val;
+            }
+        }
+        m_tables[name] = table;
+    }
+};
+
+/// What a force model reads besides the contact states
+struct HostForceModelParams {
+    const float* E = nullptr;
+    const float* nu = nullptr;
+    HostPairwiseProp CoR, mu, Crr;
+    /// Time step size and elapsed time
+    float ts = 0.f;
+    float time = 0.f;
+
+    HostForceModelParams() {}
+    HostForceModelParams(HostMaterialTable& mats, float ts_size, float time_elapsed = 0.f)
+        : E(mats.prop("E")),
+          nu(mats.prop("nu")),
+          CoR(mats.pair("CoR")),
+          mu(mats.pair("mu")),
+          Crr(mats.pair("Crr")),
+          ts(ts_size),
+          time(time_elapsed) {}
+};
+
+/// Run a force model (a class made by deme_generate_host_force_model) over a batch, filling the columns from
+/// HOST_CONTACT_HIST_OUT on. Threads take fixed blocks of contacts, so the results do not depend on the thread count.
+/// The loop over contacts is scalar (see the note at the top of the file); vectorize only adds the hint to it, and
+/// false gives the plain loop, for comparison.
+template <class Model>
+void CalcHostContactForces(HostContactBatch& batch,
+                           const HostForceModelParams& params,
+                           unsigned int n_threads = 0,
+                           bool vectorize = true) {
+    float* cols[HC_NUM_COLS];
+    batch.colPointers(cols);
+    const size_t nC = batch.size();
+    const size_t blockSize = 1024;
+    const size_t nBlocks = (nC + blockSize - 1) / blockSize;
+    hostParallelFor(
+        nBlocks,
+        [&](unsigned int /*chunk*/, size_t start, size_t end) {
+            // A copy of the column pointers local to the thread, so they are seen as invariant in the loop
+            float* myCols[HC_NUM_COLS];
+            std::copy(cols, cols + HC_NUM_COLS, myCols);
+            for (size_t b = start; b < end; b++) {
+                const size_t cEnd = std::min(nC, (b + 1) * blockSize);
+                if (vectorize) {
+                    DEME_HOST_SIMD_LOOP
+                    for (size_t c = b * blockSize; c < cEnd; c++)
+                        Model::calc(myCols, c, params);
+                } else {
+                    for (size_t c = b * blockSize; c < cEnd; c++)
+                        Model::calc(myCols, c, params);
+                }
+            }
+        },
+        n_threads, 4);
+}
+
+/// How a run compared with a reference: the largest errors of each output group (relative to the magnitude of the
+/// reference vector), and the contacts that were out of tolerance
+struct HostForceValidation {
+    size_t numContacts = 0;
+    size_t numFailed = 0;
+    double maxForceErr = 0.;
+    double maxTorqueErr = 0.;
+    double maxHistoryErr = 0.;
+    /// Indices of (up to 100 of) the contacts out of tolerance
+    std::vector<size_t> failed;
+
+    bool Passed() const { return numFailed == 0; }
+};
+
+/// Run a force model on the states of a reference batch, and compare what it produces (contact wildcards after the
+/// step, force, torque-only force and torques) with what the reference recorded. A vector quantity passes if its error
+/// is within rtol times its reference magnitude, or times floor_frac of the largest magnitude of that quantity in the
+/// batch, whichever is larger; the floor keeps the tiny forces of grazing contacts, where the spring and damping terms
+/// cancel, from failing on round-off alone.
+template <class Model>
+HostForceValidation ValidateHostForceModel(const HostContactBatch& reference,
+                                           const HostForceModelParams& params,
+                                           float rtol = 1e-4f,
+                                           float floor_frac = 1e-3f,
+                                           unsigned int n_threads = 0) {
+    HostContactBatch run(reference.size());
+    for (unsigned int c = 0; c < HOST_CONTACT_HIST_OUT; c++)
+        run.col((HOST_CONTACT_COL)c) = reference.col((HOST_CONTACT_COL)c);
+    CalcHostContactForces<Model>(run, params, n_threads);
+
+    // The compared quantities: first column and number of components
+    const unsigned int quantities[][2] = {{HC_DELTA_TIME_OUT, 1}, {HC_DELTA_TAN_X_OUT, 3}, {HC_FORCE_X, 3},
+                                          {HC_TORQUE_ONLY_FORCE_X, 3}, {HC_TORQUE_A_X, 3}, {HC_TORQUE_B_X, 3}};
+    const unsigned int numQuantities = sizeof(quantities) / sizeof(quantities[0]);
+    auto magnitude = [](const HostContactBatch& batch, size_t i, unsigned int c, unsigned int n) {
+        double m2 = 0.;
+        for (unsigned int k = 0; k < n; k++)
+            m2 += (double)batch.at((HOST_CONTACT_COL)(c + k), i) * batch.at((HOST_CONTACT_COL)(c + k), i);
+        return std::sqrt(m2);
+    };
+    double floors[numQuantities] = {};
+    for (size_t i = 0; i < reference.size(); i++) {
+        for (unsigned int q = 0; q < numQuantities; q++)
+            floors[q] = std::max(floors[q], floor_frac * magnitude(reference, i, quantities[q][0], quantities[q][1]));
+    }
+
+    HostForceValidation res;
+    res.numContacts = reference.size();
+    for (size_t i = 0; i < reference.size(); i++) {
+        bool ok = true;
+        for (unsigned int q = 0; q < numQuantities; q++) {
+            const unsigned int c = quantities[q][0], n = quantities[q][1];
+            double err2 = 0.;
+            for (unsigned int k = 0; k < n; k++) {
+                const HOST_CONTACT_COL col = (HOST_CONTACT_COL)(c + k);
+                const double d = (double)run.at(col, i) - reference.at(col, i);
+                err2 += d * d;
+            }
+            const double err = std::sqrt(err2);
+            const double ref = std::max(magnitude(reference, i, c, n), floors[q]);
+            ok = ok && (err <= rtol * ref);
+            const double relErr = ref > 0. ? err / ref : err;
+            double& maxErr = (c < HC_FORCE_X) ? res.maxHistoryErr
+                                              : ((c < HC_TORQUE_A_X) ? res.maxForceErr : res.maxTorqueErr);
+            maxErr = std::max(maxErr, relErr);
+        }
+        if (!ok) {
+            res.numFailed++;
+            if (res.failed.size() < 100)
+                res.failed.push_back(i);
+        }
+    }
+    return res;
+}
+
+}  // namespace deme
+
+#endif
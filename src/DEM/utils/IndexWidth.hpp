@@ -0,0 +1,87 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_INDEX_WIDTH_HPP
+#define DEME_INDEX_WIDTH_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+#include <DEM/VariableTypes.h>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Entity and contact index width
+//
+// Body, bin and contact-pair indices (bodyID_t, binID_t, contactPairs_t and the bin touch pair types) are 32-bit by
+// default, which caps a simulation at about 4 billion of each. Building with USE_WIDE_INDICES (which defines
+// DEME_USE_WIDE_INDICES for both the static and the JIT-compiled code) makes them 64-bit, at the cost of the memory of
+// every array of them. The largest value of each index type is reserved as its NULL marker, so n items fit in it if
+// n <= its max.
+// Counts are size_t on the host; they are checked here where they become indices, so running out of index range is an
+// error rather than a silent wrap-around. The prefix scans that turn per-item counts into offsets saturate at the index
+// type's max instead of wrapping, so the scan tail (last offset + last count, summed in 64 bits) is exact whenever it
+// is below that max, and is at least that max otherwise.
+// -----------------------------------------------------------------------------
+
+#ifdef __CUDACC__
+    #define DEME_INDEX_HD __host__ __device__
+#else
+    #define DEME_INDEX_HD
+#endif
+
+#ifdef DEME_USE_WIDE_INDICES
+constexpr bool WIDE_INDICES = true;
+#else
+constexpr bool WIDE_INDICES = false;
+#endif
+
+/// The most items an index type can number (its max, which is reserved as NULL, is one past the last index)
+template <typename IndexT>
+constexpr uint64_t MaxIndexCount() {
+    static_assert(std::is_unsigned<IndexT>::value, "Index types are unsigned");
+    return (uint64_t)std::numeric_limits<IndexT>::max();
+}
+
+/// Whether n items can be numbered by an index type
+template <typename IndexT>
+inline bool IndexCountFits(uint64_t n) {
+    return n <= MaxIndexCount<IndexT>();
+}
+
+/// Whether a saturating prefix scan's tail (its total, summed in 64 bits) means the total fits an index type. It is
+/// strict, as a saturated scan's tail is at least the max.
+template <typename IndexT>
+inline bool ScanTotalFitsIndex(uint64_t total) {
+    return total < MaxIndexCount<IndexT>();
+}
+
+/// Addition that saturates at the type's max. It is associative, so a scan with it can be done in any order, and once a
+/// running sum hits the max it stays there.
+template <typename T>
+struct SaturatingSum {
+    DEME_INDEX_HD T operator()(const T& a, const T& b) const {
+        static_assert(std::is_unsigned<T>::value, "Saturating sums are for unsigned index types");
+        return (a > (T)(~(T)0) - b) ? (T)(~(T)0) : (T)(a + b);
+    }
+};
+
+/// The error message of n items (what they are) not fitting an index type
+template <typename IndexT>
+inline std::string IndexOverflowMessage(const char* what, uint64_t n) {
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "The number of %s (%llu) exceeds what a %zu-bit index can hold (%llu).%s", what,
+                  (unsigned long long)n, sizeof(IndexT) * 8, (unsigned long long)MaxIndexCount<IndexT>(),
+                  WIDE_INDICES ? "" : " Rebuild DEME with USE_WIDE_INDICES=ON to use 64-bit indices.");
+    return std::string(buf);
+}
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,186 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_INSPECTOR_GROUPS_HPP
+#define DEME_INSPECTOR_GROUPS_HPP
+
+#include <algorithm>
+#include <cfloat>
+#include <string>
+#include <vector>
+
+#include <DEM/Structs.h>
+#include <DEM/HostSideHelpers.hpp>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Fused inspector groups
+//
+// An inspector runs its own kernel and its own reduction each time it is queried. An inspector group instead evaluates
+// all its members (quantities, each with an optional region) in one kernel per entity type (spheres, owners): each
+// thread computes the values of all members of that entity type for its entity, and a block reduces the values of all
+// members at once into a row of partial results. The rows of both kernels' blocks go to one array, and a second kernel
+// reduces them into the final results, which are copied to the host together. A member's value is its reduction's
+// identity for an entity out of its region, or of the other entity type.
+//
+// The generated code of a member is its inspection code, with the quantity it writes redirected to a local, plus its
+// region check. The reduction has a host path that runs the same two stages over values computed on the host, so the
+// fused reductions can be checked against individual ones.
+// -----------------------------------------------------------------------------
+
+// Inspector groups up to this size are fused into one kernel (the block reduction needs a shared row per member)
+const unsigned int MAX_INSPECTOR_GROUP_SIZE = 32;
+// Threads per block of the fused kernels
+const unsigned int INSPECTOR_GROUP_THREADS_PER_BLOCK = 256;
+
+struct InspectorGroupMember {
+    // Whether it is a quantity of spheres (or else of owners)
+    bool ofSpheres = false;
+    // Code that computes the quantity into a float named groupQuantity
+    std::string quantityCode;
+    // Code that sets a bool named isInRegion (already true); empty if all entities are in region
+    std::string regionCode;
+    // For owner quantities, the owner types it counts
+    ownerType_t ownerTypes = 0;
+    CUB_REDUCE_FLAVOR flavor = CUB_REDUCE_FLAVOR::SUM;
+};
+
+inline float InspectorReduceIdentity(CUB_REDUCE_FLAVOR flavor) {
+    switch (flavor) {
+        case CUB_REDUCE_FLAVOR::MAX:
+            return -FLT_MAX;
+        case CUB_REDUCE_FLAVOR::MIN:
+            return FLT_MAX;
+        default:
+            return 0.f;
+    }
+}
+
+inline float InspectorReduceCombine(CUB_REDUCE_FLAVOR flavor, float a, float b) {
+    switch (flavor) {
+        case CUB_REDUCE_FLAVOR::MAX:
+            return std::max(a, b);
+        case CUB_REDUCE_FLAVOR::MIN:
+            return std::min(a, b);
+        default:
+            return a + b;
+    }
+}
+
+/// The quantity code of a member from its inspector's inspection code, which writes the quantity to
+/// quantity[index_name]: the quantity goes to the group's local instead (the brackets are escaped, as the pattern is a
+/// regex)
+inline std::string InspectorGroupQuantityCode(const std::string& inspection_code, const std::string& index_name) {
+    return replace_pattern(inspection_code, "quantity\\[" + index_name + "\\]", "groupQuantity");
+}
+
+/// The region code of a member from its inspector's, which returns whether the entity is in region
+inline std::string InspectorGroupRegionCode(const std::string& in_region_code) {
+    return replace_pattern(in_region_code, "return", "isInRegion = ");
+}
+
+/// Generate the code that computes the values of the sphere (or owner) members into groupVals; it is inlined in the
+/// fused kernel of that entity type, where X, Y, Z (and myType for owners) are defined
+inline std::string GenerateInspectorGroupQuantities(const std::vector<InspectorGroupMember>& members, bool of_spheres) {
+    std::string code;
+    for (size_t k = 0; k < members.size(); k++) {
+        const auto& member = members[k];
+        if (member.ofSpheres != of_spheres)
+            continue;
+        code += "{\n    bool isInRegion = true;\n";
+        if (!member.regionCode.empty())
+            code += "    { " + member.regionCode + " }\n";
+        if (!member.ofSpheres)
+            code += "    isInRegion = isInRegion && (myType & " + std::to_string((unsigned int)member.ownerTypes) +
+                    ");\n";
+        code += "    if (isInRegion) {\n        float groupQuantity;\n        { " + member.quantityCode +
+                " }\n        groupVals[" + std::to_string(k) + "] = groupQuantity;\n    }\n}\n";
+    }
+    return code;
+}
+
+/// Generate the initializer of groupVals to the identities of the members' reductions (FLT_MAX is spelled out, as the
+/// JIT compiler may not have float.h)
+inline std::string GenerateInspectorGroupIdentities(const std::vector<InspectorGroupMember>& members) {
+    std::string code;
+    for (size_t k = 0; k < members.size(); k++) {
+        if (k > 0)
+            code += ", ";
+        switch (members[k].flavor) {
+            case CUB_REDUCE_FLAVOR::MAX:
+                code += "-3.402823466e+38f";
+                break;
+            case CUB_REDUCE_FLAVOR::MIN:
+                code += "3.402823466e+38f";
+                break;
+            default:
+                code += "0.f";
+        }
+    }
+    return code;
+}
+
+/// Generate the code that combines the values b into a, member by member
+inline std::string GenerateInspectorGroupCombine(const std::vector<InspectorGroupMember>& members) {
+    std::string code;
+    for (size_t k = 0; k < members.size(); k++) {
+        const std::string a = "a[" + std::to_string(k) + "]", b = "b[" + std::to_string(k) + "]";
+        switch (members[k].flavor) {
+            case CUB_REDUCE_FLAVOR::MAX:
+                code += a + " = fmaxf(" + a + ", " + b + ");\n";
+                break;
+            case CUB_REDUCE_FLAVOR::MIN:
+                code += a + " = fminf(" + a + ", " + b + ");\n";
+                break;
+            default:
+                code += a + " += " + b + ";\n";
+        }
+    }
+    return code;
+}
+
+/// The host path of the fused reduction. eval_sphere(i, vals) and eval_owner(i, vals) write the values of the sphere
+/// and owner members for sphere or owner i (leaving the identity for a member it is out of region for). The values of
+/// nSpheres spheres and nOwners owners are reduced in blocks into rows of partials, then the rows are reduced, as the
+/// device does.
+template <typename SphereEvalFunc, typename OwnerEvalFunc>
+std::vector<float> FusedInspectorReduce(const std::vector<InspectorGroupMember>& members,
+                                        size_t nSpheres,
+                                        SphereEvalFunc eval_sphere,
+                                        size_t nOwners,
+                                        OwnerEvalFunc eval_owner,
+                                        size_t block_size = INSPECTOR_GROUP_THREADS_PER_BLOCK) {
+    const size_t nQ = members.size();
+    std::vector<float> identity(nQ), vals(nQ);
+    for (size_t k = 0; k < nQ; k++)
+        identity[k] = InspectorReduceIdentity(members[k].flavor);
+    std::vector<float> res = identity, partial;
+    auto reduce_pass = [&](size_t n, auto& eval) {
+        for (size_t start = 0; start < n; start += block_size) {
+            partial = identity;
+            for (size_t i = start; i < std::min(start + block_size, n); i++) {
+                vals = identity;
+                eval(i, vals.data());
+                for (size_t k = 0; k < nQ; k++)
+                    partial[k] = InspectorReduceCombine(members[k].flavor, partial[k], vals[k]);
+            }
+            for (size_t k = 0; k < nQ; k++)
+                res[k] = InspectorReduceCombine(members[k].flavor, res[k], partial[k]);
+        }
+    };
+    reduce_pass(nSpheres, eval_sphere);
+    reduce_pass(nOwners, eval_owner);
+    return res;
+}
+
+/// Number of rows of partial results of a fused pass over n entities
+inline size_t InspectorGroupNumRows(size_t n) {
+    return (n + INSPECTOR_GROUP_THREADS_PER_BLOCK - 1) / INSPECTOR_GROUP_THREADS_PER_BLOCK;
+}
+
+}  // namespace deme
+
+#endif
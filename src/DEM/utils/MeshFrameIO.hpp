@@ -0,0 +1,365 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// Incremental mesh output. The mesh connectivity and the (local-frame) node coordinates are written once, in a key
+// frame; after that, a frame only carries the owner poses that changed and the blocks of nodes that were changed by
+// deformation (SetTriNodeRelPos/UpdateTriNodeRelPos). A fixed container then costs 1 byte per frame, and a rigid
+// wheel costs one position + quaternion per frame. The decoder keeps the running state and can reconstruct the full
+// global geometry of any decoded frame on demand.
+//
+// The frame layout (after a uint64 byte length) is:
+//   magic, version, flags, time, frameIndex, numMeshes
+//   [key frames] per mesh: owner, numNodes, numFaces, local nodes (float3), faces (int3)
+//   per mesh: state byte; pose (float3 + float4) if changed; changed node blocks if any
+
+#ifndef DEME_MESH_FRAME_IO_HPP
+#define DEME_MESH_FRAME_IO_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <DEM/Defines.h>
+#include <DEM/Structs.h>
+#include <DEM/BdrsAndObjs.h>
+#include <DEM/utils/QuantizedIO.hpp>
+
+namespace deme {
+
+const char MESH_FRAME_FILE_MAGIC[4] = {'D', 'M', 'M', 'F'};
+const uint16_t MESH_FRAME_FILE_VERSION = 1;
+// Deformed nodes are written in blocks of this many nodes
+const size_t MESH_FRAME_NODE_BLOCK = 64;
+
+/// Bit flags stored in each mesh frame header.
+enum MESH_FRAME_FLAG : uint16_t {
+    MESH_FRAME_KEY = 1  ///< Topology and all nodes are stored
+};
+
+/// Bit flags stored per mesh in each frame.
+enum MESH_FRAME_STATE : uint8_t {
+    MESH_STATE_SKIPPED = 1,       ///< Mesh is not outputted in this frame (family disabled for output)
+    MESH_STATE_POSE_CHANGED = 2,  ///< Owner pose follows
+    MESH_STATE_NODES_CHANGED = 4  ///< Changed node blocks follow
+};
+
+/// Full state of all meshes at one output frame. Faces and nodes are shared between frames when they don't change, so
+/// keeping many decoded frames around is cheap.
+class MeshFrame {
+  public:
+    double time = 0.;
+    uint64_t frameIndex = 0;
+    std::vector<bodyID_t> owners;
+    std::vector<notStupidBool_t> skipped;
+    std::vector<float3> pos;
+    std::vector<float4> oriQ;
+    // Node coordinates in the owner's local frame
+    std::vector<std::shared_ptr<const std::vector<float3>>> nodes;
+    std::vector<std::shared_ptr<const std::vector<int3>>> faces;
+
+    size_t GetNumMeshes() const { return owners.size(); }
+
+    /// Node coordinates of a mesh in the global frame.
+    std::vector<float3> GetGlobalNodes(size_t mesh_num) const {
+        std::vector<float3> res(*(nodes.at(mesh_num)));
+        for (auto& pnt : res) {
+            applyFrameTransformLocalToGlobal<float3, float3, float4>(pnt, pos[mesh_num], oriQ[mesh_num]);
+        }
+        return res;
+    }
+
+    /// Write the (non-skipped) meshes of this frame as one VTK unstructured grid, same as WriteMeshFile does with VTK.
+    void WriteAsVtk(std::ostream& ostream) const {
+        std::vector<size_t> vertexOffset(GetNumMeshes() + 1, 0);
+        size_t total_f = 0;
+        for (size_t i = 0; i < GetNumMeshes(); i++) {
+            vertexOffset[i + 1] = vertexOffset[i] + (skipped[i] ? 0 : nodes[i]->size());
+            total_f += skipped[i] ? 0 : faces[i]->size();
+        }
+        ostream << "# vtk DataFile Version 2.0\n";
+        ostream << "VTK from DEM simulation\n";
+        ostream << "ASCII\n";
+        ostream << "\n\n";
+        ostream << "DATASET UNSTRUCTURED_GRID\n";
+        ostream << "POINTS " << vertexOffset.back() << " float\n";
+        for (size_t i = 0; i < GetNumMeshes(); i++) {
+            if (skipped[i])
+                continue;
+            for (const auto& point : GetGlobalNodes(i)) {
+                ostream << point.x << " " << point.y << " " << point.z << "\n";
+            }
+        }
+        ostream << "\n\n";
+        ostream << "CELLS " << total_f << " " << 4 * total_f << "\n";
+        for (size_t i = 0; i < GetNumMeshes(); i++) {
+            if (skipped[i])
+                continue;
+            for (const auto& f : *(faces[i])) {
+                ostream << "3 " << (size_t)f.x + vertexOffset[i] << " " << (size_t)f.y + vertexOffset[i] << " "
+                        << (size_t)f.z + vertexOffset[i] << "\n";
+            }
+        }
+        ostream << "\n\n";
+        ostream << "CELL_TYPES " << total_f << "\n";
+        for (size_t j = 0; j < total_f; j++)
+            ostream << "5 \n";
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame encoder and decoder
+////////////////////////////////////////////////////////////////////////////////
+
+/// Stateful writer of incremental mesh frames. It remembers what was last written for each mesh.
+class MeshFrameEncoder {
+  public:
+    /// @brief Force a key frame every this many frames (0 means only when the set of meshes changes), so reading can
+    /// start from the middle of a run.
+    void SetKeyframeInterval(unsigned int keyframe_interval) { m_keyframe_interval = keyframe_interval; }
+    /// Forget what was written, so the next frame is a key frame.
+    void Reset() {
+        m_has_prev = false;
+        m_frames_since_key = 0;
+    }
+
+    /// Encode the current state of the meshes and append it to the stream. pos, oriQ and skip are per-mesh.
+    void Encode(double time,
+                const std::vector<std::shared_ptr<DEMMeshConnected>>& meshes,
+                const std::vector<float3>& pos,
+                const std::vector<float4>& oriQ,
+                const std::vector<notStupidBool_t>& skip,
+                std::ostream& out) {
+        const size_t n = meshes.size();
+        bool key = !m_has_prev || (m_keyframe_interval > 0 && m_frames_since_key >= m_keyframe_interval) ||
+                   m_owners.size() != n;
+        for (size_t i = 0; i < n && !key; i++) {
+            key = (meshes[i]->owner != m_owners[i]) || (meshes[i]->GetCoordsVertices().size() != m_nodes[i].size()) ||
+                  (meshes[i]->GetIndicesVertexes().size() != m_num_faces[i]);
+        }
+
+        std::string buf;
+        buf.append(MESH_FRAME_FILE_MAGIC, 4);
+        quantPutRaw(buf, MESH_FRAME_FILE_VERSION);
+        quantPutRaw(buf, (uint16_t)(key ? MESH_FRAME_KEY : 0));
+        quantPutRaw(buf, time);
+        quantPutRaw(buf, m_next_frame);
+        quantPutRaw(buf, (uint64_t)n);
+
+        if (key) {
+            m_owners.resize(n);
+            m_nodes.resize(n);
+            m_num_faces.resize(n);
+            m_pos.resize(n);
+            m_oriQ.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                const auto& nodes = meshes[i]->GetCoordsVertices();
+                const auto& faces = meshes[i]->GetIndicesVertexes();
+                quantPutRaw(buf, meshes[i]->owner);
+                quantPutRaw(buf, (uint64_t)nodes.size());
+                quantPutRaw(buf, (uint64_t)faces.size());
+                buf.append(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(float3));
+                buf.append(reinterpret_cast<const char*>(faces.data()), faces.size() * sizeof(int3));
+                m_owners[i] = meshes[i]->owner;
+                m_nodes[i] = nodes;
+                m_num_faces[i] = faces.size();
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            uint8_t state = skip[i] ? MESH_STATE_SKIPPED : 0;
+            bool pose_changed = key || std::memcmp(&pos[i], &m_pos[i], sizeof(float3)) != 0 ||
+                                std::memcmp(&oriQ[i], &m_oriQ[i], sizeof(float4)) != 0;
+            if (pose_changed)
+                state |= MESH_STATE_POSE_CHANGED;
+
+            // Find changed node blocks (in a key frame, the nodes are already written as a whole)
+            const auto& nodes = meshes[i]->GetCoordsVertices();
+            std::vector<uint64_t> changed_blocks;
+            if (!key) {
+                for (size_t start = 0, blk = 0; start < nodes.size(); start += MESH_FRAME_NODE_BLOCK, blk++) {
+                    size_t cnt = std::min(MESH_FRAME_NODE_BLOCK, nodes.size() - start);
+                    if (std::memcmp(nodes.data() + start, m_nodes[i].data() + start, cnt * sizeof(float3)) != 0)
+                        changed_blocks.push_back(blk);
+                }
+            }
+            if (!changed_blocks.empty())
+                state |= MESH_STATE_NODES_CHANGED;
+
+            quantPutRaw(buf, state);
+            if (pose_changed) {
+                quantPutRaw(buf, pos[i]);
+                quantPutRaw(buf, oriQ[i]);
+                m_pos[i] = pos[i];
+                m_oriQ[i] = oriQ[i];
+            }
+            if (!changed_blocks.empty()) {
+                quantPutVarint(buf, changed_blocks.size());
+                for (uint64_t blk : changed_blocks) {
+                    size_t start = blk * MESH_FRAME_NODE_BLOCK;
+                    size_t cnt = std::min(MESH_FRAME_NODE_BLOCK, nodes.size() - start);
+                    quantPutVarint(buf, blk);
+                    buf.append(reinterpret_cast<const char*>(nodes.data() + start), cnt * sizeof(float3));
+                    std::memcpy(m_nodes[i].data() + start, nodes.data() + start, cnt * sizeof(float3));
+                }
+            }
+        }
+
+        uint64_t frame_bytes = buf.size();
+        out.write(reinterpret_cast<const char*>(&frame_bytes), sizeof(frame_bytes));
+        out.write(buf.data(), buf.size());
+
+        m_has_prev = true;
+        m_frames_since_key = key ? 1 : m_frames_since_key + 1;
+        m_next_frame++;
+    }
+
+  private:
+    unsigned int m_keyframe_interval = 0;
+    bool m_has_prev = false;
+    unsigned int m_frames_since_key = 0;
+    uint64_t m_next_frame = 0;
+    // Last written state
+    std::vector<bodyID_t> m_owners;
+    std::vector<std::vector<float3>> m_nodes;
+    std::vector<size_t> m_num_faces;
+    std::vector<float3> m_pos;
+    std::vector<float4> m_oriQ;
+};
+
+/// Stateful reader of incremental mesh frames. Frames must be decoded in order, starting from a key frame.
+class MeshFrameDecoder {
+  public:
+    /// @brief Decode the next frame in the stream.
+    /// @return False if the stream has no more frames.
+    bool Decode(std::istream& in, MeshFrame& frame) {
+        uint64_t frame_bytes;
+        if (!in.read(reinterpret_cast<char*>(&frame_bytes), sizeof(frame_bytes)))
+            return false;
+        std::string buf(frame_bytes, '\0');
+        if (!in.read(&buf[0], frame_bytes)) {
+            DEME_ERROR("Mesh frame is truncated: expected %zu bytes.", (size_t)frame_bytes);
+        }
+        DecodeBuffer(buf.data(), buf.size(), frame);
+        return true;
+    }
+
+    /// Decode one frame body (without the leading length word) from memory.
+    void DecodeBuffer(const char* data, size_t size, MeshFrame& frame) {
+        const char* ptr = data;
+        const char* end = data + size;
+        if (size < 4 || std::memcmp(ptr, MESH_FRAME_FILE_MAGIC, 4) != 0) {
+            DEME_ERROR("Not an incremental mesh frame (bad magic number).");
+        }
+        ptr += 4;
+        uint16_t version = quantGetRaw<uint16_t>(ptr, end);
+        if (version > MESH_FRAME_FILE_VERSION) {
+            DEME_ERROR("Mesh frame version %u is newer than this decoder (%u).", (unsigned int)version,
+                       (unsigned int)MESH_FRAME_FILE_VERSION);
+        }
+        uint16_t flags = quantGetRaw<uint16_t>(ptr, end);
+        double time = quantGetRaw<double>(ptr, end);
+        uint64_t frame_index = quantGetRaw<uint64_t>(ptr, end);
+        size_t n = quantGetRaw<uint64_t>(ptr, end);
+
+        if (flags & MESH_FRAME_KEY) {
+            m_state = MeshFrame();
+            m_state.owners.resize(n);
+            m_state.skipped.resize(n, 0);
+            m_state.pos.resize(n);
+            m_state.oriQ.resize(n);
+            m_state.nodes.resize(n);
+            m_state.faces.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                m_state.owners[i] = quantGetRaw<bodyID_t>(ptr, end);
+                size_t n_nodes = quantGetRaw<uint64_t>(ptr, end);
+                size_t n_faces = quantGetRaw<uint64_t>(ptr, end);
+                auto nodes = std::make_shared<std::vector<float3>>(n_nodes);
+                auto faces = std::make_shared<std::vector<int3>>(n_faces);
+                readBytes(ptr, end, nodes->data(), n_nodes * sizeof(float3));
+                readBytes(ptr, end, faces->data(), n_faces * sizeof(int3));
+                m_state.nodes[i] = nodes;
+                m_state.faces[i] = faces;
+            }
+            m_has_key = true;
+        } else if (!m_has_key || m_state.GetNumMeshes() != n || m_state.frameIndex + 1 != frame_index) {
+            DEME_ERROR(
+                "Mesh frame %zu is not a key frame and does not follow the last decoded frame.\nDecode frames in "
+                "order, starting from a key frame.",
+                (size_t)frame_index);
+        }
+        m_state.time = time;
+        m_state.frameIndex = frame_index;
+
+        for (size_t i = 0; i < n; i++) {
+            uint8_t state = quantGetRaw<uint8_t>(ptr, end);
+            m_state.skipped[i] = (state & MESH_STATE_SKIPPED) ? 1 : 0;
+            if (state & MESH_STATE_POSE_CHANGED) {
+                m_state.pos[i] = quantGetRaw<float3>(ptr, end);
+                m_state.oriQ[i] = quantGetRaw<float4>(ptr, end);
+            }
+            if (state & MESH_STATE_NODES_CHANGED) {
+                // Copy on write: previously decoded frames keep their nodes
+                auto nodes = std::make_shared<std::vector<float3>>(*(m_state.nodes[i]));
+                size_t n_blocks = quantGetVarint(ptr, end);
+                for (size_t j = 0; j < n_blocks; j++) {
+                    size_t start = quantGetVarint(ptr, end) * MESH_FRAME_NODE_BLOCK;
+                    if (start >= nodes->size()) {
+                        DEME_ERROR("Mesh frame %zu has a node block out of range for mesh %zu.", (size_t)frame_index,
+                                   i);
+                    }
+                    size_t cnt = std::min(MESH_FRAME_NODE_BLOCK, nodes->size() - start);
+                    readBytes(ptr, end, nodes->data() + start, cnt * sizeof(float3));
+                }
+                m_state.nodes[i] = nodes;
+            }
+        }
+        frame = m_state;
+    }
+
+    /// Forget the running state (e.g. before seeking to another key frame).
+    void Reset() { m_has_key = false; }
+
+  private:
+    bool m_has_key = false;
+    MeshFrame m_state;
+
+    static void readBytes(const char*& ptr, const char* end, void* dst, size_t bytes) {
+        if (ptr + bytes > end) {
+            DEME_ERROR("Mesh frame is truncated or corrupted.");
+        }
+        std::memcpy(dst, ptr, bytes);
+        ptr += bytes;
+    }
+};
+
+/// Convenience function: decode every frame in a list of files (typically one frame per file, as written by
+/// WriteMeshFile), in the order they were written.
+inline std::vector<MeshFrame> ReadMeshFrameFiles(const std::vector<std::string>& filenames) {
+    std::vector<MeshFrame> frames;
+    MeshFrameDecoder decoder;
+    MeshFrame frame;
+    for (const auto& filename : filenames) {
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        if (!in) {
+            DEME_ERROR("Could not open mesh output file %s.", filename.c_str());
+        }
+        while (decoder.Decode(in, frame)) {
+            frames.push_back(frame);
+        }
+    }
+    return frames;
+}
+inline std::vector<MeshFrame> ReadMeshFrameFile(const std::string& filename) {
+    return ReadMeshFrameFiles({filename});
+}
+
+}  // namespace deme
+
+#endif
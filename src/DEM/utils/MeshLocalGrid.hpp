@@ -0,0 +1,295 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_MESH_LOCAL_GRID_HPP
+#define DEME_MESH_LOCAL_GRID_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <DEM/Defines.h>
+#include <DEM/HostSideHelpers.hpp>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Local-frame facet grids for rigid meshes
+//
+// A rigid mesh never changes shape, so instead of binning its facets in the world frame at every contact detection,
+// its facets are put in a uniform grid in the mesh's own (body) frame once, and the spheres are brought into this frame
+// to look up candidate facets. A facet is listed in all cells its bounding box touches; a sphere visits all cells its
+// padded bounding box touches. To report a sphere--facet pair only once, it is reported from the lowest cell (per
+// axis) that both of them touch.
+//
+// The same procedure runs on the device in kT; the host version here is the reference it is checked against.
+// -----------------------------------------------------------------------------
+
+// How far (relative to the margin) the CD sandwich of a facet may reach from the facet. It matches how
+// makeTriangleSandwich enlarges a facet: vertices move along the incenter directions by margin / sin(half angle), and
+// along the normal by margin. Infinity is returned for degenerate facets.
+inline float meshFacetMiterFactor(const float3& p1, const float3& p2, const float3& p3) {
+    const float3 nodes[3] = {p1, p2, p3};
+    float3 incenter;
+    {
+        float a = length(p2 - p3), b = length(p3 - p1), c = length(p1 - p2);
+        float perimeter = a + b + c;
+        if (!(perimeter > 0))
+            return std::numeric_limits<float>::infinity();
+        incenter = (a * p1 + b * p2 + c * p3) / perimeter;
+    }
+    float res = 0.f;
+    for (int i = 0; i < 3; i++) {
+        float3 expandVec = nodes[i] - incenter;
+        float3 side = nodes[(i + 1) % 3] - nodes[i];
+        float lenE = length(expandVec), lenS = length(side);
+        if (!(lenE > 0) || !(lenS > 0))
+            return std::numeric_limits<float>::infinity();
+        float cos_halfangle = dot(-expandVec, side) / (lenE * lenS);
+        float sin2 = 1.f - cos_halfangle * cos_halfangle;
+        if (!(sin2 > 0))
+            return std::numeric_limits<float>::infinity();
+        res = std::max(res, std::sqrt(1.f / sin2 + 1.f));
+    }
+    return res;
+}
+
+// Squared distance from point p to triangle (a, b, c)
+inline float pointTriangleDistSquared(const float3& p, const float3& a, const float3& b, const float3& c) {
+    // Closest point by Voronoi region, see Ericson, Real-Time Collision Detection, 5.1.5
+    float3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    float3 closest;
+    if (d1 <= 0 && d2 <= 0) {
+        closest = a;
+    } else {
+        float3 bp = p - b;
+        float d3 = dot(ab, bp), d4 = dot(ac, bp);
+        float3 cp = p - c;
+        float d5 = dot(ab, cp), d6 = dot(ac, cp);
+        float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+        if (d3 >= 0 && d4 <= d3) {
+            closest = b;
+        } else if (d6 >= 0 && d5 <= d6) {
+            closest = c;
+        } else if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+            closest = a + ab * (d1 / (d1 - d3));
+        } else if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+            closest = a + ac * (d2 / (d2 - d6));
+        } else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+            closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        } else {
+            float denom = 1.f / (va + vb + vc);
+            closest = a + ab * (vb * denom) + ac * (vc * denom);
+        }
+    }
+    float3 d = p - closest;
+    return dot(d, d);
+}
+
+class MeshLocalGrid {
+  public:
+    MeshLocalGrid() {}
+    ~MeshLocalGrid() {}
+
+    /// Build the grid from the facets listed in triIDs (indices into the node arrays, which are in the mesh's local
+    /// frame). If cell_size is not positive, it is picked based on the facet sizes. Returns false if the mesh has
+    /// degenerate facets, in which case it should be left to the world-frame binning.
+    bool Build(const std::vector<bodyID_t>& triIDs,
+               const float3* node1,
+               const float3* node2,
+               const float3* node3,
+               float cell_size = 0.f) {
+        tris = triIDs;
+        std::sort(tris.begin(), tris.end());
+        cellStart.clear();
+        cellTris.clear();
+        triCellLo.clear();
+        if (tris.empty())
+            return false;
+
+        float3 lo = make_float3(DEME_HUGE_FLOAT, DEME_HUGE_FLOAT, DEME_HUGE_FLOAT);
+        float3 hi = -lo;
+        double sum_extent = 0.;
+        miterFactor = 0.f;
+        for (const auto& t : tris) {
+            float3 tlo = fminf(fminf(node1[t], node2[t]), node3[t]);
+            float3 thi = fmaxf(fmaxf(node1[t], node2[t]), node3[t]);
+            lo = fminf(lo, tlo);
+            hi = fmaxf(hi, thi);
+            float3 ext = thi - tlo;
+            sum_extent += std::max(ext.x, std::max(ext.y, ext.z));
+            miterFactor = std::max(miterFactor, meshFacetMiterFactor(node1[t], node2[t], node3[t]));
+        }
+        if (!std::isfinite(miterFactor))
+            return false;
+
+        const float3 span = hi - lo;
+        const float max_span = std::max(span.x, std::max(span.y, span.z));
+        if (cell_size > 0) {
+            cellSize = cell_size;
+        } else {
+            // About the size of a facet, but no more cells than a few per facet
+            cellSize = static_cast<float>(sum_extent / tris.size());
+            double vol_cap = std::cbrt((double)std::max(span.x, cellSize) * std::max(span.y, cellSize) *
+                                       std::max(span.z, cellSize) / (4. * tris.size()));
+            cellSize = std::max(cellSize, static_cast<float>(vol_cap));
+        }
+        // A flat or tiny mesh still needs a positive cell size
+        cellSize = std::max(cellSize, std::max(max_span, 1e-6f) * 1e-3f);
+        origin = lo;
+        dims.x = std::max(1, (int)std::ceil(span.x / cellSize));
+        dims.y = std::max(1, (int)std::ceil(span.y / cellSize));
+        dims.z = std::max(1, (int)std::ceil(span.z / cellSize));
+        boundCenter = (lo + hi) * 0.5f;
+        boundRadius = length(span) * 0.5f;
+
+        // Counting sort of facet--cell pairs into CSR form
+        const size_t nCells = NumCells();
+        std::vector<int3> triCellHi(tris.size());
+        triCellLo.resize(tris.size());
+        cellStart.assign(nCells + 1, 0);
+        for (size_t i = 0; i < tris.size(); i++) {
+            const bodyID_t t = tris[i];
+            triCellLo[i] = CellOf(fminf(fminf(node1[t], node2[t]), node3[t]));
+            triCellHi[i] = CellOf(fmaxf(fmaxf(node1[t], node2[t]), node3[t]));
+            forEachCell(triCellLo[i], triCellHi[i], [&](size_t cell) { cellStart[cell + 1]++; });
+        }
+        for (size_t c = 0; c < nCells; c++) {
+            cellStart[c + 1] += cellStart[c];
+        }
+        cellTris.resize(cellStart[nCells]);
+        std::vector<size_t> fill(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < tris.size(); i++) {
+            forEachCell(triCellLo[i], triCellHi[i], [&](size_t cell) { cellTris[fill[cell]++] = tris[i]; });
+        }
+        return true;
+    }
+
+    size_t NumCells() const { return (size_t)dims.x * dims.y * dims.z; }
+
+    /// The (clamped) cell that a local point is in
+    int3 CellOf(const float3& p) const {
+        return make_int3(clampIndex((p.x - origin.x) / cellSize, dims.x),
+                         clampIndex((p.y - origin.y) / cellSize, dims.y),
+                         clampIndex((p.z - origin.z) / cellSize, dims.z));
+    }
+
+    /// Call func(triID) once for every facet whose bounding box touches the box of half size pad around the local point
+    /// p. Facets are reported from the lowest cell they share with the query box, so each shows up only once.
+    template <typename Func>
+    void ForEachCandidate(const float3& p, float pad, const Func& func) const {
+        if (cellStart.empty())
+            return;
+        const float3 qlo = p - make_float3(pad, pad, pad);
+        const float3 qhi = p + make_float3(pad, pad, pad);
+        const float3 ghi = origin + make_float3(dims.x * cellSize, dims.y * cellSize, dims.z * cellSize);
+        if (qhi.x < origin.x || qhi.y < origin.y || qhi.z < origin.z || qlo.x > ghi.x || qlo.y > ghi.y ||
+            qlo.z > ghi.z)
+            return;
+        const int3 slo = CellOf(qlo), shi = CellOf(qhi);
+        forEachCell(slo, shi, [&](size_t cell) {
+            const int3 c = cellIndices(cell);
+            for (size_t j = cellStart[cell]; j < cellStart[cell + 1]; j++) {
+                const int3 tlo = triCellLo[localIndexOf(cellTris[j])];
+                if (c.x == std::max(tlo.x, slo.x) && c.y == std::max(tlo.y, slo.y) && c.z == std::max(tlo.z, slo.z))
+                    func(cellTris[j]);
+            }
+        });
+    }
+
+    /// The device-side description of this grid; cell_offset is where its cells start in the concatenated CSR arrays
+    MeshGridInfo GetInfo(bodyID_t owner, size_t cell_offset) const {
+        MeshGridInfo info;
+        info.origin = origin;
+        info.cellSize = cellSize;
+        info.dims = dims;
+        info.cellOffset = cell_offset;
+        info.miterFactor = miterFactor;
+        info.boundCenter = boundCenter;
+        info.boundRadius = boundRadius;
+        info.owner = owner;
+        return info;
+    }
+
+    const std::vector<bodyID_t>& GetTriIDs() const { return tris; }
+    const std::vector<size_t>& GetCellStart() const { return cellStart; }
+    const std::vector<bodyID_t>& GetCellTris() const { return cellTris; }
+    const std::vector<int3>& GetTriCellLo() const { return triCellLo; }
+    float GetMiterFactor() const { return miterFactor; }
+
+  private:
+    float3 origin = make_float3(0, 0, 0);
+    float cellSize = 1.f;
+    int3 dims = make_int3(0, 0, 0);
+    float miterFactor = 0.f;
+    float3 boundCenter = make_float3(0, 0, 0);
+    float boundRadius = 0.f;
+    // Facet IDs of this mesh (ascending), and the lowest cell each of them touches
+    std::vector<bodyID_t> tris;
+    std::vector<int3> triCellLo;
+    // CSR: the facets in cell c are cellTris[cellStart[c], cellStart[c + 1])
+    std::vector<size_t> cellStart;
+    std::vector<bodyID_t> cellTris;
+
+    static int clampIndex(float x, int n) {
+        if (!(x > 0))
+            return 0;
+        if (x >= (float)(n - 1))
+            return n - 1;
+        return (int)x;
+    }
+    int3 cellIndices(size_t cell) const {
+        return make_int3((int)(cell % dims.x), (int)((cell / dims.x) % dims.y),
+                         (int)(cell / ((size_t)dims.x * dims.y)));
+    }
+    size_t localIndexOf(bodyID_t triID) const {
+        return std::lower_bound(tris.begin(), tris.end(), triID) - tris.begin();
+    }
+    template <typename Func>
+    void forEachCell(const int3& lo, const int3& hi, const Func& func) const {
+        for (int k = lo.z; k <= hi.z; k++) {
+            for (int j = lo.y; j <= hi.y; j++) {
+                for (int i = lo.x; i <= hi.x; i++) {
+                    func((size_t)i + (size_t)dims.x * ((size_t)j + (size_t)dims.y * k));
+                }
+            }
+        }
+    }
+};
+
+// Host reference for the sphere--facet candidate pairs of one rigid mesh: all (sphere, facet) whose distance is within
+// the sphere's radius plus pad, with sphere centers given in the mesh's local frame. If grid is null, it is done by
+// brute force over triIDs, which is what the grid-based search must agree with.
+inline std::vector<std::pair<size_t, bodyID_t>> hostMeshSphereCandidatePairs(const std::vector<float3>& sphLocalPos,
+                                                                              const std::vector<float>& sphRadii,
+                                                                              float pad,
+                                                                              const std::vector<bodyID_t>& triIDs,
+                                                                              const float3* node1,
+                                                                              const float3* node2,
+                                                                              const float3* node3,
+                                                                              const MeshLocalGrid* grid = nullptr) {
+    std::vector<std::pair<size_t, bodyID_t>> res;
+    for (size_t i = 0; i < sphLocalPos.size(); i++) {
+        const float reach = sphRadii[i] + pad;
+        auto test = [&](bodyID_t t) {
+            if (pointTriangleDistSquared(sphLocalPos[i], node1[t], node2[t], node3[t]) <= reach * reach)
+                res.push_back(std::make_pair(i, t));
+        };
+        if (grid) {
+            grid->ForEachCandidate(sphLocalPos[i], reach, test);
+        } else {
+            for (const auto& t : triIDs)
+                test(t);
+        }
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,139 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_MULTI_RATE_REFERENCE_HPP
+#define DEME_MULTI_RATE_REFERENCE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Host reference of multi-rate integration
+//
+// A 1D chain of spheres between two rigid walls, with undamped Hertzian contacts (force k d^1.5 at overlap d), so the
+// energy is conserved. A time step of size H is taken the same way dT does it (see DEMDynamicThread::
+// advanceMultiRateStep): the slow contacts' forces are computed at the start of the step, the fast contacts' forces and
+// the (symplectic Euler) integration are done in n sub-steps of size H/n, and the slow contacts' impulse (force * H) is
+// applied in the first sub-step. Each piece is symplectic, so the energy error stays bounded rather than drifting. A
+// contact is fast if either sphere is fast, or if it is a wall contact and those are all fast. With n = 1 it is plain
+// symplectic Euler.
+// -----------------------------------------------------------------------------
+
+class MultiRateChain {
+  public:
+    MultiRateChain(double left_wall, double right_wall) : leftWall(left_wall), rightWall(right_wall) {}
+    ~MultiRateChain() {}
+
+    /// Add a sphere; the spheres must be added from left to right. stiffness is its contact stiffness k; two spheres in
+    /// contact use the larger of their stiffnesses.
+    void AddSphere(double mass, double radius, double stiffness, double x, double v, bool fast) {
+        spheres.push_back({mass, radius, stiffness, x, v, fast});
+    }
+    /// Whether the contacts with the walls are all fast
+    void SetWallContactsFast(bool flag) { wallsFast = flag; }
+    /// Use stiffness k for the contact of sphere j and j + 1, instead of the larger of their stiffnesses (as a solver
+    /// run whose materials are mixed differently would have it)
+    void SetPairStiffness(size_t j, double k) {
+        if (pairK.size() < j + 1)
+            pairK.resize(j + 1, 0.);
+        pairK[j] = k;
+    }
+    /// Use stiffness k for all wall contacts, instead of the sphere's
+    void SetWallStiffness(double k) { wallK = k; }
+
+    /// Advance by H in n sub-steps
+    void Step(double H, unsigned int n) {
+        const double h = H / (double)n;
+        std::vector<double> slow_acc(spheres.size()), acc(spheres.size());
+        collectAcc(slow_acc, false);
+        for (unsigned int i = 0; i < n; i++) {
+            collectAcc(acc, true);
+            for (size_t j = 0; j < spheres.size(); j++) {
+                if (i == 0)
+                    acc[j] += (double)n * slow_acc[j];
+                spheres[j].v += acc[j] * h;
+                spheres[j].x += spheres[j].v * h;
+            }
+        }
+    }
+
+    double KineticEnergy() const {
+        double e = 0.;
+        for (const auto& s : spheres)
+            e += 0.5 * s.mass * s.v * s.v;
+        return e;
+    }
+    double PotentialEnergy() const {
+        double e = 0.;
+        for (size_t j = 0; j < spheres.size(); j++) {
+            e += springEnergy(leftWallOverlap(j), wallStiffness(j));
+            e += springEnergy(rightWallOverlap(j), wallStiffness(j));
+            if (j + 1 < spheres.size())
+                e += springEnergy(pairOverlap(j), pairStiffness(j));
+        }
+        return e;
+    }
+    double Energy() const { return KineticEnergy() + PotentialEnergy(); }
+
+    size_t GetNumSpheres() const { return spheres.size(); }
+    double GetPos(size_t j) const { return spheres[j].x; }
+    double GetVel(size_t j) const { return spheres[j].v; }
+
+  private:
+    struct Sphere {
+        double mass;
+        double radius;
+        double stiffness;
+        double x;
+        double v;
+        bool fast;
+    };
+    std::vector<Sphere> spheres;
+    double leftWall;
+    double rightWall;
+    bool wallsFast = false;
+    // Stiffness overrides, if positive
+    std::vector<double> pairK;
+    double wallK = 0.;
+
+    static double springForce(double d, double k) { return (d > 0.) ? k * d * std::sqrt(d) : 0.; }
+    static double springEnergy(double d, double k) { return (d > 0.) ? 0.4 * k * d * d * std::sqrt(d) : 0.; }
+
+    double leftWallOverlap(size_t j) const { return leftWall - (spheres[j].x - spheres[j].radius); }
+    double rightWallOverlap(size_t j) const { return spheres[j].x + spheres[j].radius - rightWall; }
+    double pairOverlap(size_t j) const {
+        return spheres[j].radius + spheres[j + 1].radius - (spheres[j + 1].x - spheres[j].x);
+    }
+    double pairStiffness(size_t j) const {
+        if (j < pairK.size() && pairK[j] > 0.)
+            return pairK[j];
+        return std::max(spheres[j].stiffness, spheres[j + 1].stiffness);
+    }
+    double wallStiffness(size_t j) const { return (wallK > 0.) ? wallK : spheres[j].stiffness; }
+
+    // Acceleration from the fast (or slow) contacts
+    void collectAcc(std::vector<double>& acc, bool fast) const {
+        std::fill(acc.begin(), acc.end(), 0.);
+        for (size_t j = 0; j < spheres.size(); j++) {
+            bool wall_fast = wallsFast || spheres[j].fast;
+            if (wall_fast == fast) {
+                acc[j] += springForce(leftWallOverlap(j), wallStiffness(j)) / spheres[j].mass;
+                acc[j] -= springForce(rightWallOverlap(j), wallStiffness(j)) / spheres[j].mass;
+            }
+            if (j + 1 < spheres.size() && (spheres[j].fast || spheres[j + 1].fast) == fast) {
+                double f = springForce(pairOverlap(j), pairStiffness(j));
+                acc[j] -= f / spheres[j].mass;
+                acc[j + 1] += f / spheres[j + 1].mass;
+            }
+        }
+    }
+};
+
+}  // namespace deme
+
+#endif
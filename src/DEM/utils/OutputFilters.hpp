@@ -0,0 +1,272 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_OUTPUT_FILTERS_HPP
+#define DEME_OUTPUT_FILTERS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <thread>
+#include <vector>
+#include <DEM/Defines.h>
+#include <DEM/Structs.h>
+#include <DEM/HostSideHelpers.hpp>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Output filters
+//
+// An OutputFilter decides, per entity (sphere, clump or contact), whether it is written by the Write*File calls. It is
+// evaluated on the host, in parallel, before any formatting is done, so the output time scales with the number of
+// entities that pass rather than the system size. The clauses combine as follows: the entity has to be inside at least
+// one of the regions (if any region is set), AND pass the family, velocity and force criteria, AND survive the
+// subsampling. Subsampling is keyed on the entity ID, so the same subset is picked at every frame.
+//
+// The filter runs over the host copies of the arrays, so every entity is still migrated from the device first; only
+// the formatting and writing are cut down to the entities that pass.
+//// TODO: A device variant: evaluate Test in a kernel and compact the passing indices (cub::DeviceSelect::Flagged),
+//// then migrate only the selected entities' data. It needs the filter's clauses in device-readable form.
+// -----------------------------------------------------------------------------
+
+enum class FILTER_REGION { BOX, ORIENTED_BOX, SPHERE, CYLINDER };
+
+struct OutputFilterRegion {
+    FILTER_REGION type = FILTER_REGION::BOX;
+    // Box/oriented box center, sphere center, or the center of the cylinder axis segment
+    float3 center = make_float3(0, 0, 0);
+    // Box half-sizes; for spheres, x is the radius; for cylinders, x is the radius and y is the half length
+    float3 halfDims = make_float3(0, 0, 0);
+    // Orientation of the oriented box (local to global)
+    float4 oriQ = make_float4(0, 0, 0, 1);
+    // Unit axis of the cylinder
+    float3 axis = make_float3(0, 0, 1);
+
+    bool Contains(const float3& p) const {
+        float3 d = p - center;
+        switch (type) {
+            case (FILTER_REGION::BOX):
+                return std::abs(d.x) <= halfDims.x && std::abs(d.y) <= halfDims.y && std::abs(d.z) <= halfDims.z;
+            case (FILTER_REGION::ORIENTED_BOX):
+                // Bring the point to the box's local frame
+                applyOriQToVector3<float, float>(d.x, d.y, d.z, oriQ.w, -oriQ.x, -oriQ.y, -oriQ.z);
+                return std::abs(d.x) <= halfDims.x && std::abs(d.y) <= halfDims.y && std::abs(d.z) <= halfDims.z;
+            case (FILTER_REGION::SPHERE):
+                return dot(d, d) <= halfDims.x * halfDims.x;
+            case (FILTER_REGION::CYLINDER): {
+                float along = dot(d, axis);
+                if (std::abs(along) > halfDims.y)
+                    return false;
+                float3 radial = d - along * axis;
+                return dot(radial, radial) <= halfDims.x * halfDims.x;
+            }
+        }
+        return false;
+    }
+};
+
+// The quantities of one entity that a filter may look at
+struct OutputFilterSample {
+    float3 pos;
+    float3 vel;
+    float force;
+    unsigned int family;
+    // For contacts, the family of the other owner; a single-owner entity sets it the same as family
+    unsigned int family2;
+    size_t ID;
+};
+
+class OutputFilter {
+  public:
+    OutputFilter() {}
+    ~OutputFilter() {}
+
+    /// Only output entities inside the axis-aligned box [lo, hi]
+    OutputFilter& AddBox(const float3& lo, const float3& hi) {
+        OutputFilterRegion r;
+        r.type = FILTER_REGION::BOX;
+        r.center = (lo + hi) * 0.5f;
+        r.halfDims = (hi - lo) * 0.5f;
+        if (r.halfDims.x < 0 || r.halfDims.y < 0 || r.halfDims.z < 0) {
+            DEME_ERROR("AddBox needs lo to be smaller than hi in every direction.");
+        }
+        regions.push_back(r);
+        return *this;
+    }
+    /// Only output entities inside the box with the given center, half-sizes and orientation (local to global)
+    OutputFilter& AddOrientedBox(const float3& center, const float3& half_dims, const float4& oriQ) {
+        OutputFilterRegion r;
+        r.type = FILTER_REGION::ORIENTED_BOX;
+        r.center = center;
+        r.halfDims = half_dims;
+        r.oriQ = oriQ / length(oriQ);
+        regions.push_back(r);
+        return *this;
+    }
+    /// Only output entities inside a sphere
+    OutputFilter& AddSphere(const float3& center, float radius) {
+        OutputFilterRegion r;
+        r.type = FILTER_REGION::SPHERE;
+        r.center = center;
+        r.halfDims = make_float3(radius, 0, 0);
+        regions.push_back(r);
+        return *this;
+    }
+    /// Only output entities inside the finite cylinder whose axis goes from p0 to p1
+    OutputFilter& AddCylinder(const float3& p0, const float3& p1, float radius) {
+        float3 seg = p1 - p0;
+        float len = length(seg);
+        if (len <= 0) {
+            DEME_ERROR("AddCylinder needs two different points to define the cylinder axis.");
+        }
+        OutputFilterRegion r;
+        r.type = FILTER_REGION::CYLINDER;
+        r.center = (p0 + p1) * 0.5f;
+        r.axis = seg / len;
+        r.halfDims = make_float3(radius, len * 0.5f, 0);
+        regions.push_back(r);
+        return *this;
+    }
+    /// Only output entities in these families (for contacts, at least one of the two owners)
+    OutputFilter& IncludeFamilies(const std::set<unsigned int>& families) {
+        includeFamilies.insert(families.begin(), families.end());
+        return *this;
+    }
+    /// Do not output entities in these families (for contacts, if either of the two owners is)
+    OutputFilter& ExcludeFamilies(const std::set<unsigned int>& families) {
+        excludeFamilies.insert(families.begin(), families.end());
+        return *this;
+    }
+    /// Only output entities whose velocity magnitude is within [min_v, max_v]
+    OutputFilter& SetVelocityRange(float min_v, float max_v = std::numeric_limits<float>::infinity()) {
+        minVel = min_v;
+        maxVel = max_v;
+        return *this;
+    }
+    /// Only output entities whose force magnitude (net force for bodies, contact force for contacts) is within
+    /// [min_f, max_f]
+    OutputFilter& SetForceRange(float min_f, float max_f = std::numeric_limits<float>::infinity()) {
+        minForce = min_f;
+        maxForce = max_f;
+        return *this;
+    }
+    /// Only output the entities whose ID % stride == offset
+    OutputFilter& SetStride(unsigned int stride, unsigned int offset = 0) {
+        if (stride == 0) {
+            DEME_ERROR("Output filter stride cannot be 0.");
+        }
+        strideN = stride;
+        strideOffset = offset % stride;
+        return *this;
+    }
+    /// Output a (hash-based, deterministic) fraction of the entities; the same IDs are picked every frame
+    OutputFilter& SetHashSampling(float fraction, uint64_t seed = 0) {
+        if (fraction < 0 || fraction > 1) {
+            DEME_ERROR("Output filter sampling fraction must be in [0, 1], but %f was given.", fraction);
+        }
+        sampleFraction = fraction;
+        sampleSeed = seed;
+        return *this;
+    }
+    /// Remove all clauses
+    void Clear() { *this = OutputFilter(); }
+
+    /// If nothing is set, then everything passes and the writers may skip the filtering pass
+    bool IsActive() const {
+        return !regions.empty() || !includeFamilies.empty() || !excludeFamilies.empty() || NeedsVelocity() ||
+               NeedsForce() || strideN > 1 || sampleFraction < 1.f;
+    }
+    bool NeedsPosition() const { return !regions.empty(); }
+    bool NeedsVelocity() const { return minVel > 0 || maxVel < std::numeric_limits<float>::infinity(); }
+    bool NeedsForce() const { return minForce > 0 || maxForce < std::numeric_limits<float>::infinity(); }
+
+    bool Test(const OutputFilterSample& s) const {
+        // Cheapest clauses first
+        if (strideN > 1 && (s.ID % strideN) != strideOffset)
+            return false;
+        if (sampleFraction < 1.f && !hashPasses(s.ID))
+            return false;
+        if (!excludeFamilies.empty() &&
+            (excludeFamilies.count(s.family) > 0 || excludeFamilies.count(s.family2) > 0))
+            return false;
+        if (!includeFamilies.empty() &&
+            (includeFamilies.count(s.family) == 0 && includeFamilies.count(s.family2) == 0))
+            return false;
+        if (NeedsVelocity()) {
+            float v = length(s.vel);
+            if (v < minVel || v > maxVel)
+                return false;
+        }
+        if (NeedsForce() && (s.force < minForce || s.force > maxForce))
+            return false;
+        if (!regions.empty()) {
+            return std::any_of(regions.begin(), regions.end(),
+                               [&](const OutputFilterRegion& r) { return r.Contains(s.pos); });
+        }
+        return true;
+    }
+
+  private:
+    std::vector<OutputFilterRegion> regions;
+    std::set<unsigned int> includeFamilies;
+    std::set<unsigned int> excludeFamilies;
+    float minVel = 0.f;
+    float maxVel = std::numeric_limits<float>::infinity();
+    float minForce = 0.f;
+    float maxForce = std::numeric_limits<float>::infinity();
+    unsigned int strideN = 1;
+    unsigned int strideOffset = 0;
+    float sampleFraction = 1.f;
+    uint64_t sampleSeed = 0;
+
+    // splitmix64 finalizer, so that consecutive IDs are decorrelated
+    bool hashPasses(size_t ID) const {
+        uint64_t z = static_cast<uint64_t>(ID) + sampleSeed + 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z = z ^ (z >> 31);
+        return static_cast<double>(z >> 11) * (1.0 / 9007199254740992.0) < static_cast<double>(sampleFraction);
+    }
+};
+
+// Evaluate pred(i) for i in [0, n) on a few host threads and return the passing indices in ascending order. The result
+// does not depend on the number of threads.
+template <typename Func>
+inline std::vector<size_t> parallelSelectIndices(size_t n, const Func& pred, unsigned int n_threads = 0) {
+    if (n_threads == 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::vector<size_t>> selected(n_threads);
+    unsigned int n_chunks = hostParallelFor(
+        n,
+        [&](unsigned int t, size_t start, size_t end) {
+            for (size_t i = start; i < end; i++) {
+                if (pred(i))
+                    selected[t].push_back(i);
+            }
+        },
+        n_threads);
+    if (n_chunks == 1) {
+        return std::move(selected[0]);
+    }
+
+    size_t total = 0;
+    for (unsigned int t = 0; t < n_chunks; t++) {
+        total += selected[t].size();
+    }
+    std::vector<size_t> res;
+    res.reserve(total);
+    for (unsigned int t = 0; t < n_chunks; t++) {
+        res.insert(res.end(), selected[t].begin(), selected[t].end());
+    }
+    return res;
+}
+
+}  // namespace deme
+
+#endif
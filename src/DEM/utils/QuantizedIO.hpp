@@ -0,0 +1,481 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// Lossless quantized owner position I/O. Instead of converting voxelID + sub-voxel positions to floating-point numbers
+// and then to text, the solver's native integer location representation is written out directly, together with the
+// grid parameters needed to reconstruct the exact positions. Optionally, a frame can be stored as the difference
+// against the previous frame, which makes (quasi-)static regions cost about 1 byte per coordinate.
+
+#ifndef DEME_QUANTIZED_IO_HPP
+#define DEME_QUANTIZED_IO_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <DEM/Defines.h>
+#include <DEM/Structs.h>
+
+namespace deme {
+
+// File magic and the version of the layout described below
+const char QUANT_FILE_MAGIC[4] = {'D', 'M', 'Q', 'P'};
+const uint16_t QUANT_FILE_VERSION = 1;
+
+/// Bit flags stored in each quantized frame header.
+enum QUANT_FRAME_FLAG : uint16_t {
+    QUANT_DELTA = 1,      ///< Body is coded against the previous frame
+    QUANT_HAS_QUAT = 2,   ///< Orientation quaternions are stored
+    QUANT_HAS_FAMILY = 4  ///< Family numbers are stored
+};
+
+/// Header of one quantized frame. Grid parameters are repeated in every frame so each key frame is self-contained.
+struct QuantizedFrameHeader {
+    uint16_t version = QUANT_FILE_VERSION;
+    uint16_t flags = 0;
+    uint8_t nvXp2 = 0;
+    uint8_t nvYp2 = 0;
+    uint8_t nvZp2 = 0;
+    // Number of bits in a sub-voxel position (VOXEL_RES_POWER2 at the time of writing)
+    uint8_t subVoxelPower = VOXEL_RES_POWER2;
+    double voxelSize = 0.;
+    double l = 0.;
+    double LBFX = 0.;
+    double LBFY = 0.;
+    double LBFZ = 0.;
+    double time = 0.;
+    uint64_t frameIndex = 0;
+    // For a delta frame, the index of the frame it is coded against
+    uint64_t refFrameIndex = 0;
+    uint64_t numEntities = 0;
+};
+
+/// Decoded (or to-be-encoded) content of one frame, in the solver's native representation.
+class QuantizedFrame {
+  public:
+    QuantizedFrameHeader header;
+    std::vector<bodyID_t> ownerIDs;
+    std::vector<voxelID_t> voxel;
+    std::vector<subVoxelPos_t> subX;
+    std::vector<subVoxelPos_t> subY;
+    std::vector<subVoxelPos_t> subZ;
+    // Quaternions in (x, y, z, w) order as in float4; only filled if QUANT_HAS_QUAT
+    std::vector<float4> oriQ;
+    // Only filled if QUANT_HAS_FAMILY
+    std::vector<family_t> family;
+
+    size_t Size() const { return ownerIDs.size(); }
+    void Resize(size_t n) {
+        ownerIDs.resize(n);
+        voxel.resize(n);
+        subX.resize(n);
+        subY.resize(n);
+        subZ.resize(n);
+        if (header.flags & QUANT_HAS_QUAT)
+            oriQ.resize(n);
+        if (header.flags & QUANT_HAS_FAMILY)
+            family.resize(n);
+        header.numEntities = n;
+    }
+
+    /// Reconstruct the global position of entity i. In double precision this reproduces the solver's own conversion.
+    double3 GetPosition(size_t i) const {
+        double X, Y, Z;
+        voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(X, Y, Z, voxel[i], subX[i], subY[i], subZ[i], header.nvXp2,
+                                                            header.nvYp2, header.voxelSize, header.l);
+        return make_double3(X + header.LBFX, Y + header.LBFY, Z + header.LBFZ);
+    }
+    /// Reconstruct all positions.
+    std::vector<double3> GetPositions() const {
+        std::vector<double3> pos(Size());
+        for (size_t i = 0; i < Size(); i++)
+            pos[i] = GetPosition(i);
+        return pos;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Low-level byte packing helpers
+////////////////////////////////////////////////////////////////////////////////
+
+// Fixed-size little-endian-as-in-memory write/read. Files are not portable between hosts of different endianness.
+template <typename T>
+inline void quantPutRaw(std::string& buf, const T& val) {
+    buf.append(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+template <typename T>
+inline T quantGetRaw(const char*& ptr, const char* end) {
+    if (ptr + sizeof(T) > end) {
+        DEME_ERROR("Quantized frame is truncated.");
+    }
+    T val;
+    std::memcpy(&val, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return val;
+}
+
+// LEB128-style variable-length unsigned integer
+inline void quantPutVarint(std::string& buf, uint64_t val) {
+    while (val >= 0x80) {
+        buf.push_back(static_cast<char>((val & 0x7F) | 0x80));
+        val >>= 7;
+    }
+    buf.push_back(static_cast<char>(val));
+}
+inline uint64_t quantGetVarint(const char*& ptr, const char* end) {
+    uint64_t val = 0;
+    unsigned int shift = 0;
+    while (true) {
+        if (ptr >= end || shift > 63) {
+            DEME_ERROR("Quantized frame has a malformed variable-length integer.");
+        }
+        uint8_t byte = static_cast<uint8_t>(*ptr++);
+        val |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+        shift += 7;
+    }
+    return val;
+}
+
+// Zigzag maps signed differences to unsigned numbers so small negative numbers stay small
+inline uint64_t quantZigzag(int64_t val) {
+    return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+}
+inline int64_t quantUnzigzag(uint64_t val) {
+    return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+// A voxel index and a sub-voxel position along one axis, combined into a single integer coordinate along that axis
+inline void quantToAxisCoords(uint64_t& cX,
+                              uint64_t& cY,
+                              uint64_t& cZ,
+                              const voxelID_t& voxel,
+                              const subVoxelPos_t& sX,
+                              const subVoxelPos_t& sY,
+                              const subVoxelPos_t& sZ,
+                              const QuantizedFrameHeader& h) {
+    voxelID_t vX, vY, vZ;
+    IDChopper<voxelID_t, voxelID_t>(vX, vY, vZ, voxel, h.nvXp2, h.nvYp2);
+    cX = ((uint64_t)vX << h.subVoxelPower) | (uint64_t)sX;
+    cY = ((uint64_t)vY << h.subVoxelPower) | (uint64_t)sY;
+    cZ = ((uint64_t)vZ << h.subVoxelPower) | (uint64_t)sZ;
+}
+inline void quantFromAxisCoords(voxelID_t& voxel,
+                                subVoxelPos_t& sX,
+                                subVoxelPos_t& sY,
+                                subVoxelPos_t& sZ,
+                                const uint64_t& cX,
+                                const uint64_t& cY,
+                                const uint64_t& cZ,
+                                const QuantizedFrameHeader& h) {
+    const uint64_t sub_mask = ((uint64_t)1 << h.subVoxelPower) - 1;
+    sX = (subVoxelPos_t)(cX & sub_mask);
+    sY = (subVoxelPos_t)(cY & sub_mask);
+    sZ = (subVoxelPos_t)(cZ & sub_mask);
+    voxel = (voxelID_t)(cX >> h.subVoxelPower);
+    voxel += (voxelID_t)(cY >> h.subVoxelPower) << h.nvXp2;
+    voxel += (voxelID_t)(cZ >> h.subVoxelPower) << (h.nvXp2 + h.nvYp2);
+}
+
+inline uint32_t quantFloatBits(float val) {
+    uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(float));
+    return bits;
+}
+inline float quantBitsFloat(uint32_t bits) {
+    float val;
+    std::memcpy(&val, &bits, sizeof(float));
+    return val;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame encoder and decoder
+////////////////////////////////////////////////////////////////////////////////
+
+/// Stateful writer of quantized frames. It remembers the previously written frame to do optional delta coding.
+class QuantizedFrameEncoder {
+  public:
+    /// @brief Enable or disable coding frames against the previous frame.
+    /// @param use Whether to use delta coding.
+    /// @param keyframe_interval A self-contained key frame is forced every this many frames (0 means never forced).
+    void SetDeltaCoding(bool use, unsigned int keyframe_interval = 0) {
+        m_use_delta = use;
+        m_keyframe_interval = keyframe_interval;
+    }
+    bool GetDeltaCoding() const { return m_use_delta; }
+    /// Forget the previous frame, so the next frame is a key frame.
+    void Reset() {
+        m_has_prev = false;
+        m_frames_since_key = 0;
+    }
+
+    /// Encode a frame and append it to the stream. The frame's delta flag and frame indices are decided here.
+    void Encode(QuantizedFrame& frame, std::ostream& out) {
+        QuantizedFrameHeader& h = frame.header;
+        const size_t n = frame.Size();
+        h.numEntities = n;
+        h.frameIndex = m_next_frame;
+        // Delta coding needs an identical entity list and identical grid as the previous frame
+        bool delta = m_use_delta && m_has_prev && (m_keyframe_interval == 0 || m_frames_since_key < m_keyframe_interval);
+        if (delta) {
+            delta = (n == m_prev.Size()) && (frame.ownerIDs == m_prev.ownerIDs) && sameGrid(h, m_prev.header) &&
+                    ((h.flags & (QUANT_HAS_QUAT | QUANT_HAS_FAMILY)) ==
+                     (m_prev.header.flags & (QUANT_HAS_QUAT | QUANT_HAS_FAMILY)));
+        }
+        if (delta) {
+            h.flags |= QUANT_DELTA;
+            h.refFrameIndex = m_prev.header.frameIndex;
+        } else {
+            h.flags &= ~QUANT_DELTA;
+            h.refFrameIndex = h.frameIndex;
+        }
+
+        std::string buf;
+        buf.reserve(n * 8 + 128);
+        buf.append(QUANT_FILE_MAGIC, 4);
+        quantPutRaw(buf, h.version);
+        quantPutRaw(buf, h.flags);
+        quantPutRaw(buf, h.nvXp2);
+        quantPutRaw(buf, h.nvYp2);
+        quantPutRaw(buf, h.nvZp2);
+        quantPutRaw(buf, h.subVoxelPower);
+        quantPutRaw(buf, h.voxelSize);
+        quantPutRaw(buf, h.l);
+        quantPutRaw(buf, h.LBFX);
+        quantPutRaw(buf, h.LBFY);
+        quantPutRaw(buf, h.LBFZ);
+        quantPutRaw(buf, h.time);
+        quantPutRaw(buf, h.frameIndex);
+        quantPutRaw(buf, h.refFrameIndex);
+        quantPutRaw(buf, h.numEntities);
+
+        // Owner IDs are only stored in key frames, as ascending differences
+        if (!delta) {
+            bodyID_t prev_id = 0;
+            for (size_t i = 0; i < n; i++) {
+                quantPutVarint(buf, quantZigzag((int64_t)frame.ownerIDs[i] - (int64_t)prev_id));
+                prev_id = frame.ownerIDs[i];
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            uint64_t cX, cY, cZ;
+            quantToAxisCoords(cX, cY, cZ, frame.voxel[i], frame.subX[i], frame.subY[i], frame.subZ[i], h);
+            if (delta) {
+                uint64_t pX, pY, pZ;
+                quantToAxisCoords(pX, pY, pZ, m_prev.voxel[i], m_prev.subX[i], m_prev.subY[i], m_prev.subZ[i], h);
+                quantPutVarint(buf, quantZigzag((int64_t)(cX - pX)));
+                quantPutVarint(buf, quantZigzag((int64_t)(cY - pY)));
+                quantPutVarint(buf, quantZigzag((int64_t)(cZ - pZ)));
+            } else {
+                quantPutVarint(buf, cX);
+                quantPutVarint(buf, cY);
+                quantPutVarint(buf, cZ);
+            }
+        }
+
+        if (h.flags & QUANT_HAS_QUAT) {
+            for (size_t i = 0; i < n; i++) {
+                const float4& q = frame.oriQ[i];
+                if (delta) {
+                    // XOR against last frame: an unchanged component costs 1 byte
+                    const float4& p = m_prev.oriQ[i];
+                    quantPutVarint(buf, quantFloatBits(q.x) ^ quantFloatBits(p.x));
+                    quantPutVarint(buf, quantFloatBits(q.y) ^ quantFloatBits(p.y));
+                    quantPutVarint(buf, quantFloatBits(q.z) ^ quantFloatBits(p.z));
+                    quantPutVarint(buf, quantFloatBits(q.w) ^ quantFloatBits(p.w));
+                } else {
+                    quantPutRaw(buf, q.x);
+                    quantPutRaw(buf, q.y);
+                    quantPutRaw(buf, q.z);
+                    quantPutRaw(buf, q.w);
+                }
+            }
+        }
+
+        if (h.flags & QUANT_HAS_FAMILY) {
+            for (size_t i = 0; i < n; i++) {
+                quantPutRaw(buf, frame.family[i]);
+            }
+        }
+
+        // Body length goes first so a reader can skip frames
+        uint64_t frame_bytes = buf.size();
+        out.write(reinterpret_cast<const char*>(&frame_bytes), sizeof(frame_bytes));
+        out.write(buf.data(), buf.size());
+
+        m_prev = frame;
+        m_has_prev = true;
+        m_frames_since_key = delta ? m_frames_since_key + 1 : 1;
+        m_next_frame++;
+    }
+
+  private:
+    static bool sameGrid(const QuantizedFrameHeader& a, const QuantizedFrameHeader& b) {
+        return a.nvXp2 == b.nvXp2 && a.nvYp2 == b.nvYp2 && a.nvZp2 == b.nvZp2 && a.subVoxelPower == b.subVoxelPower &&
+               a.voxelSize == b.voxelSize && a.LBFX == b.LBFX && a.LBFY == b.LBFY && a.LBFZ == b.LBFZ;
+    }
+
+    bool m_use_delta = false;
+    unsigned int m_keyframe_interval = 0;
+    bool m_has_prev = false;
+    unsigned int m_frames_since_key = 0;
+    uint64_t m_next_frame = 0;
+    QuantizedFrame m_prev;
+};
+
+/// Stateful reader of quantized frames. Delta frames must be decoded in order, after the frame they reference.
+class QuantizedFrameDecoder {
+  public:
+    /// @brief Decode the next frame in the stream.
+    /// @return False if the stream has no more frames.
+    bool Decode(std::istream& in, QuantizedFrame& frame) {
+        uint64_t frame_bytes;
+        if (!in.read(reinterpret_cast<char*>(&frame_bytes), sizeof(frame_bytes)))
+            return false;
+        std::string buf(frame_bytes, '\0');
+        if (!in.read(&buf[0], frame_bytes)) {
+            DEME_ERROR("Quantized frame is truncated: expected %zu bytes.", (size_t)frame_bytes);
+        }
+        DecodeBuffer(buf.data(), buf.size(), frame);
+        return true;
+    }
+
+    /// Decode one frame body (without the leading length word) from memory.
+    void DecodeBuffer(const char* data, size_t size, QuantizedFrame& frame) {
+        const char* ptr = data;
+        const char* end = data + size;
+        if (size < 4 || std::memcmp(ptr, QUANT_FILE_MAGIC, 4) != 0) {
+            DEME_ERROR("Not a quantized position frame (bad magic number).");
+        }
+        ptr += 4;
+        QuantizedFrameHeader h;
+        h.version = quantGetRaw<uint16_t>(ptr, end);
+        if (h.version > QUANT_FILE_VERSION) {
+            DEME_ERROR("Quantized frame version %u is newer than this decoder (%u).", (unsigned int)h.version,
+                       (unsigned int)QUANT_FILE_VERSION);
+        }
+        h.flags = quantGetRaw<uint16_t>(ptr, end);
+        h.nvXp2 = quantGetRaw<uint8_t>(ptr, end);
+        h.nvYp2 = quantGetRaw<uint8_t>(ptr, end);
+        h.nvZp2 = quantGetRaw<uint8_t>(ptr, end);
+        h.subVoxelPower = quantGetRaw<uint8_t>(ptr, end);
+        h.voxelSize = quantGetRaw<double>(ptr, end);
+        h.l = quantGetRaw<double>(ptr, end);
+        h.LBFX = quantGetRaw<double>(ptr, end);
+        h.LBFY = quantGetRaw<double>(ptr, end);
+        h.LBFZ = quantGetRaw<double>(ptr, end);
+        h.time = quantGetRaw<double>(ptr, end);
+        h.frameIndex = quantGetRaw<uint64_t>(ptr, end);
+        h.refFrameIndex = quantGetRaw<uint64_t>(ptr, end);
+        h.numEntities = quantGetRaw<uint64_t>(ptr, end);
+
+        const bool delta = h.flags & QUANT_DELTA;
+        const size_t n = h.numEntities;
+        if (delta) {
+            if (!m_has_prev || m_prev.header.frameIndex != h.refFrameIndex || m_prev.Size() != n) {
+                DEME_ERROR(
+                    "Quantized frame %zu is delta-coded against frame %zu, which was not the last decoded frame.\nDecode "
+                    "frames in order, starting from a key frame.",
+                    (size_t)h.frameIndex, (size_t)h.refFrameIndex);
+            }
+        }
+
+        frame.header = h;
+        frame.oriQ.clear();
+        frame.family.clear();
+        frame.Resize(n);
+
+        if (delta) {
+            frame.ownerIDs = m_prev.ownerIDs;
+        } else {
+            bodyID_t prev_id = 0;
+            for (size_t i = 0; i < n; i++) {
+                frame.ownerIDs[i] = (bodyID_t)((int64_t)prev_id + quantUnzigzag(quantGetVarint(ptr, end)));
+                prev_id = frame.ownerIDs[i];
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            uint64_t cX, cY, cZ;
+            if (delta) {
+                uint64_t pX, pY, pZ;
+                quantToAxisCoords(pX, pY, pZ, m_prev.voxel[i], m_prev.subX[i], m_prev.subY[i], m_prev.subZ[i], h);
+                cX = pX + (uint64_t)quantUnzigzag(quantGetVarint(ptr, end));
+                cY = pY + (uint64_t)quantUnzigzag(quantGetVarint(ptr, end));
+                cZ = pZ + (uint64_t)quantUnzigzag(quantGetVarint(ptr, end));
+            } else {
+                cX = quantGetVarint(ptr, end);
+                cY = quantGetVarint(ptr, end);
+                cZ = quantGetVarint(ptr, end);
+            }
+            quantFromAxisCoords(frame.voxel[i], frame.subX[i], frame.subY[i], frame.subZ[i], cX, cY, cZ, h);
+        }
+
+        if (h.flags & QUANT_HAS_QUAT) {
+            for (size_t i = 0; i < n; i++) {
+                float4& q = frame.oriQ[i];
+                if (delta) {
+                    const float4& p = m_prev.oriQ[i];
+                    q.x = quantBitsFloat((uint32_t)quantGetVarint(ptr, end) ^ quantFloatBits(p.x));
+                    q.y = quantBitsFloat((uint32_t)quantGetVarint(ptr, end) ^ quantFloatBits(p.y));
+                    q.z = quantBitsFloat((uint32_t)quantGetVarint(ptr, end) ^ quantFloatBits(p.z));
+                    q.w = quantBitsFloat((uint32_t)quantGetVarint(ptr, end) ^ quantFloatBits(p.w));
+                } else {
+                    q.x = quantGetRaw<float>(ptr, end);
+                    q.y = quantGetRaw<float>(ptr, end);
+                    q.z = quantGetRaw<float>(ptr, end);
+                    q.w = quantGetRaw<float>(ptr, end);
+                }
+            }
+        }
+
+        if (h.flags & QUANT_HAS_FAMILY) {
+            for (size_t i = 0; i < n; i++) {
+                frame.family[i] = quantGetRaw<family_t>(ptr, end);
+            }
+        }
+
+        m_prev = frame;
+        m_has_prev = true;
+    }
+
+    /// Forget the previous frame (e.g. before seeking to another key frame).
+    void Reset() { m_has_prev = false; }
+
+  private:
+    bool m_has_prev = false;
+    QuantizedFrame m_prev;
+};
+
+/// Convenience function: decode every frame in a list of files (typically one frame per file, as written by
+/// WriteClumpFile), in order. The files must be listed in the order they were written if delta coding was used.
+inline std::vector<QuantizedFrame> ReadQuantizedFiles(const std::vector<std::string>& filenames) {
+    std::vector<QuantizedFrame> frames;
+    QuantizedFrameDecoder decoder;
+    QuantizedFrame frame;
+    for (const auto& filename : filenames) {
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        if (!in) {
+            DEME_ERROR("Could not open quantized output file %s.", filename.c_str());
+        }
+        while (decoder.Decode(in, frame)) {
+            frames.push_back(frame);
+        }
+    }
+    return frames;
+}
+inline std::vector<QuantizedFrame> ReadQuantizedFile(const std::string& filename) {
+    return ReadQuantizedFiles({filename});
+}
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,243 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_SLEEP_ISLANDS_HPP
+#define DEME_SLEEP_ISLANDS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <DEM/VariableTypes.h>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Island sleeping
+//
+// Owners linked by contact pairs form islands. An owner is quiet if its kinetic energy per unit mass, approximated as
+// (|v|^2 + (|w| r)^2) / 2 with r its bounding radius, is below a threshold, and a contact is quiet if a bound of its
+// overlap rate, |vA - vB| + |wA| rA + |wB| rB, is below another. An island goes to sleep when all its owners and
+// contacts have been quiet for a number of steps. Sleeping owners are taken out of force calculation and integration,
+// and woken (the whole island at once) by the device when they come in contact with an awake owner, change family, or
+// are given a velocity or acceleration by the user. Waking undoes a sleeping owner's quiet record.
+// Owners are of three roles: regular ones take part as above; static ones (fixed families) never move, so they do not
+// link islands and never wake them; active ones (families with prescribed motion) never sleep, so an island they are in
+// does not sleep either.
+//
+// The quiet records are kept on the device and advanced at every step, so how long an owner has been quiet does not
+// depend on how often islands are checked; the check interval only delays sleep onset by up to an interval. At a check,
+// the device lists the candidates (awake regular owners quiet for long enough) and the owner pairs of the contacts
+// touching them, and only those come to the host, where SleepIslandManager groups them into islands. An island is named
+// by its smallest owner ID, so the islands asleep already need no renumbering. The member functions that run on the
+// device in dT mirror those kernels (DEMPrepForceKernels.cu) for DEMtest_SleepIslands.
+// -----------------------------------------------------------------------------
+
+enum class SLEEP_ROLE : uint8_t { REGULAR = 0, STATIC = 1, ACTIVE = 2 };
+
+// The motion of owners at a step (arrays of nOwners); radius is the bounding radius
+struct SleepStepInput {
+    size_t nOwners = 0;
+    const float* vX = nullptr;
+    const float* vY = nullptr;
+    const float* vZ = nullptr;
+    const float* omgX = nullptr;
+    const float* omgY = nullptr;
+    const float* omgZ = nullptr;
+    const float* radius = nullptr;
+    const SLEEP_ROLE* role = nullptr;
+    // Owner pairs of contacts (arrays of nPairs)
+    size_t nPairs = 0;
+    const bodyID_t* ownerA = nullptr;
+    const bodyID_t* ownerB = nullptr;
+};
+
+// The candidates of an island check, and the owner pairs of the contacts that touch them (static owners left out)
+struct SleepCandidates {
+    std::vector<bodyID_t> owners;
+    std::vector<bodyID_t> pairA;
+    std::vector<bodyID_t> pairB;
+};
+
+class SleepIslandManager {
+  public:
+    // Island of an awake owner, and of a static owner while sleeping is on
+    static constexpr bodyID_t AWAKE_ISLAND = std::numeric_limits<bodyID_t>::max();
+    static constexpr bodyID_t STATIC_ISLAND = AWAKE_ISLAND - 1;
+
+    SleepIslandManager() {}
+    ~SleepIslandManager() {}
+
+    /// Thresholds of kinetic energy per unit mass and of contact overlap rate
+    void SetThresholds(double ke_per_mass, double overlap_rate) {
+        keThreshold = std::max(ke_per_mass, 0.);
+        rateThreshold = std::max(overlap_rate, 0.);
+    }
+    /// Number of steps an island must be quiet for before it sleeps
+    void SetSleepSteps(unsigned int n) { sleepSteps = std::max(n, 1u); }
+
+    double GetKEThreshold() const { return keThreshold; }
+    double GetRateThreshold() const { return rateThreshold; }
+    unsigned int GetSleepSteps() const { return sleepSteps; }
+
+    /// Advance the quiet records (quiet steps of each owner) by a step, as accumulateQuietSteps and
+    /// resetQuietStepsByContact do on the device. A sleeping owner is quiet by definition, and non-regular owners have
+    /// no record.
+    void AccumulateQuietSteps(const SleepStepInput& in, const bodyID_t* island, unsigned int* quiet) const {
+        for (size_t i = 0; i < in.nOwners; i++) {
+            if (in.role[i] != SLEEP_ROLE::REGULAR) {
+                quiet[i] = 0;
+            } else if (island[i] != AWAKE_ISLAND) {
+                quiet[i] = sleepSteps;
+            } else {
+                quiet[i] = ownerIsQuiet(in, i) ? std::min(quiet[i] + 1, sleepSteps) : 0;
+            }
+        }
+        for (size_t k = 0; k < in.nPairs; k++) {
+            bodyID_t a = in.ownerA[k], b = in.ownerB[k];
+            if (a >= in.nOwners || b >= in.nOwners || contactIsQuiet(in, a, b))
+                continue;
+            if (in.role[a] == SLEEP_ROLE::REGULAR && island[a] == AWAKE_ISLAND)
+                quiet[a] = 0;
+            if (in.role[b] == SLEEP_ROLE::REGULAR && island[b] == AWAKE_ISLAND)
+                quiet[b] = 0;
+        }
+    }
+
+    /// The candidates of an island check, as flagSleepCandidates and collectSleepCandidatePairs find them on the
+    /// device: awake regular owners quiet for the sleep steps, and the pairs that touch one
+    SleepCandidates FindCandidates(const SleepStepInput& in, const bodyID_t* island, const unsigned int* quiet) const {
+        SleepCandidates cand;
+        std::vector<uint8_t> is_cand(in.nOwners, 0);
+        for (size_t i = 0; i < in.nOwners; i++) {
+            if (in.role[i] == SLEEP_ROLE::REGULAR && island[i] == AWAKE_ISLAND && quiet[i] >= sleepSteps) {
+                is_cand[i] = 1;
+                cand.owners.push_back((bodyID_t)i);
+            }
+        }
+        for (size_t k = 0; k < in.nPairs; k++) {
+            bodyID_t a = in.ownerA[k], b = in.ownerB[k];
+            if (a >= in.nOwners || b >= in.nOwners || in.role[a] == SLEEP_ROLE::STATIC ||
+                in.role[b] == SLEEP_ROLE::STATIC)
+                continue;
+            if (is_cand[a] || is_cand[b]) {
+                cand.pairA.push_back(a);
+                cand.pairB.push_back(b);
+            }
+        }
+        return cand;
+    }
+
+    /// Group the candidates of a check (in any order) into islands. island[k] is set to the island of
+    /// cand.owners[k]: its smallest owner ID, or AWAKE_ISLAND if a pair links the island to an owner that is not a
+    /// candidate (noisy, active, or asleep already), in which case it cannot sleep. Returns the number of islands that
+    /// fall asleep.
+    size_t FormIslands(const SleepCandidates& cand, std::vector<bodyID_t>& island) {
+        const size_t n = cand.owners.size();
+        sorted.assign(cand.owners.begin(), cand.owners.end());
+        std::sort(sorted.begin(), sorted.end());
+        parent.resize(n);
+        std::iota(parent.begin(), parent.end(), (size_t)0);
+        blocked.assign(n, 0);
+        for (size_t k = 0; k < cand.pairA.size(); k++) {
+            size_t a = localIndex(cand.pairA[k]), b = localIndex(cand.pairB[k]);
+            if (a < n && b < n) {
+                unite(a, b);
+            } else if (a < n) {
+                blocked[a] = 1;
+            } else if (b < n) {
+                blocked[b] = 1;
+            }
+        }
+        // The root of a component is its smallest local index, hence its smallest owner
+        for (size_t l = 0; l < n; l++) {
+            if (blocked[l])
+                blocked[find(l)] = 1;
+        }
+        size_t nIslands = 0;
+        for (size_t l = 0; l < n; l++) {
+            if (find(l) == l && !blocked[l])
+                nIslands++;
+        }
+        island.resize(n);
+        for (size_t k = 0; k < n; k++) {
+            size_t r = find(localIndex(cand.owners[k]));
+            island[k] = blocked[r] ? AWAKE_ISLAND : sorted[r];
+        }
+        return nIslands;
+    }
+
+    /// A whole island check of the host, as dT does it: static owners are marked STATIC_ISLAND, and the islands of
+    /// candidates that can sleep fall asleep. Returns the owners that just fell asleep (the caller should zero their
+    /// velocities).
+    std::vector<bodyID_t> Check(const SleepStepInput& in, std::vector<bodyID_t>& island, const unsigned int* quiet) {
+        for (size_t i = 0; i < in.nOwners; i++) {
+            if (in.role[i] == SLEEP_ROLE::STATIC && island[i] == AWAKE_ISLAND)
+                island[i] = STATIC_ISLAND;
+        }
+        const SleepCandidates cand = FindCandidates(in, island.data(), quiet);
+        std::vector<bodyID_t> cand_island, newly_asleep;
+        FormIslands(cand, cand_island);
+        for (size_t k = 0; k < cand.owners.size(); k++) {
+            if (cand_island[k] != AWAKE_ISLAND) {
+                island[cand.owners[k]] = cand_island[k];
+                newly_asleep.push_back(cand.owners[k]);
+            }
+        }
+        return newly_asleep;
+    }
+
+  private:
+    double keThreshold = 1e-6;
+    double rateThreshold = 1e-3;
+    unsigned int sleepSteps = 1000;
+
+    // Union-find work arrays of FormIslands, on the candidates in owner order
+    std::vector<bodyID_t> sorted;
+    std::vector<size_t> parent;
+    std::vector<uint8_t> blocked;
+
+    static double angSpeed(const SleepStepInput& in, size_t i) {
+        return std::sqrt((double)in.omgX[i] * in.omgX[i] + (double)in.omgY[i] * in.omgY[i] +
+                         (double)in.omgZ[i] * in.omgZ[i]);
+    }
+    bool ownerIsQuiet(const SleepStepInput& in, size_t i) const {
+        double v2 = (double)in.vX[i] * in.vX[i] + (double)in.vY[i] * in.vY[i] + (double)in.vZ[i] * in.vZ[i];
+        double rim = angSpeed(in, i) * in.radius[i];
+        return 0.5 * (v2 + rim * rim) < keThreshold;
+    }
+    bool contactIsQuiet(const SleepStepInput& in, size_t a, size_t b) const {
+        double dx = (double)in.vX[a] - in.vX[b], dy = (double)in.vY[a] - in.vY[b], dz = (double)in.vZ[a] - in.vZ[b];
+        double rate =
+            std::sqrt(dx * dx + dy * dy + dz * dz) + angSpeed(in, a) * in.radius[a] + angSpeed(in, b) * in.radius[b];
+        return rate < rateThreshold;
+    }
+
+    // Index of an owner among the sorted candidates (their number if it is not one)
+    size_t localIndex(bodyID_t owner) const {
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), owner);
+        return (it != sorted.end() && *it == owner) ? (size_t)(it - sorted.begin()) : sorted.size();
+    }
+    size_t find(size_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+    void unite(size_t a, size_t b) {
+        a = find(a);
+        b = find(b);
+        if (a != b)
+            parent[std::max(a, b)] = std::min(a, b);
+    }
+};
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,171 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_TIME_STEP_CONTROLLER_HPP
+#define DEME_TIME_STEP_CONTROLLER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Variable time step controller
+//
+// The step size allowed at a given max velocity v is the smaller of two limits:
+//   - Stability: a contact must be resolved by a number of steps. For Hertzian contacts the collision time of two
+//     bodies of effective mass m*, effective radius R* and effective modulus E* that approach each other at speed u is
+//         t_c = 2.868 (m*^2 / (R* E*^2 u))^(1/5),
+//     and for linear springs of stiffness k it is t_c = pi sqrt(m* / k). u is bounded by the overlap rate 2 v.
+//   - Accuracy: the overlap of a contact must not grow by more than a fraction of the smallest radius in one step.
+// The step grows by at most a rate per step and shrinks at once. It also stays under a ceiling that was promised to kT
+// when a CD order was sent (kT sizes the CD margins assuming the steps are no larger), so the ceiling can only grow
+// at an order, and is the smaller of the last two orders' since dT still uses the contacts from the previous one.
+// If rejection is on, a step after which the max velocity calls for a step much smaller than the one used is
+// rejected; the caller then restores the state and retries with the smaller step.
+// A step that would leave less than the min step (or a tiny fraction of a step) of a span to go takes the remainder
+// along, so the span never ends with a sliver of a step. DEMtest_TimeStepController checks the controller on a
+// Hertzian drop and on a sudden velocity jump.
+// -----------------------------------------------------------------------------
+
+// The contact scales the limits are derived from. refMass and refRadius are of the body type whose collision time is
+// the shortest; minRadius is the smallest sphere radius.
+struct TimeStepScales {
+    double refMass = 0.;
+    double refRadius = 0.;
+    double minRadius = 0.;
+    // Max effective Young's modulus over material pairs, for Hertzian contacts (0 if not used)
+    double maxEStar = 0.;
+    // Max contact stiffness, for linear contacts (0 if not used)
+    double maxStiffness = 0.;
+};
+
+class TimeStepController {
+  public:
+    TimeStepController() {}
+    ~TimeStepController() {}
+
+    void SetScales(const TimeStepScales& s) { scales = s; }
+    /// Set the range the step size must stay in
+    void SetBounds(double min_h, double max_h) {
+        minStep = std::max(min_h, 0.);
+        maxStep = std::max(max_h, minStep);
+    }
+    /// Max relative growth of the step size from one step to the next
+    void SetMaxGrowth(double rate) { maxGrowth = std::max(rate, 0.); }
+    /// Number of steps a collision must be resolved by
+    void SetStepsPerCollision(double n) { stepsPerCollision = std::max(n, 1.); }
+    /// Max overlap increment in one step, as a fraction of the smallest radius
+    void SetMaxOverlapRatio(double r) { maxOverlapRatio = std::max(r, 0.); }
+    /// The velocity used is never lower than this (the velocity gravity brings about in a short drop, say)
+    void SetVelocityFloor(double v) { velFloor = std::max(v, 0.); }
+    /// A step is rejected if it was larger than (1 + tol) times the step the velocity after it allows; 0 disables
+    /// rejection
+    void SetRejectionTolerance(double tol) { rejectTol = std::max(tol, 0.); }
+
+    /// Return to initial state with a step size
+    void Reset(double h) {
+        step = clampStep(h);
+        ceiling = maxStep;
+        prevCeiling = maxStep;
+        numRejected = 0;
+    }
+
+    /// The largest step size the two limits allow at this max velocity (not clamped)
+    double AllowedStep(double max_vel) const {
+        double u = 2. * std::max((double)max_vel, velFloor);
+        double h = std::numeric_limits<double>::infinity();
+        double m_eff = 0.5 * scales.refMass;
+        if (m_eff > 0. && u > 0. && scales.maxEStar > 0. && scales.refRadius > 0.) {
+            double r_eff = 0.5 * scales.refRadius;
+            double t_c = 2.868 * std::pow(m_eff * m_eff / (r_eff * scales.maxEStar * scales.maxEStar * u), 0.2);
+            h = std::min(h, t_c / stepsPerCollision);
+        }
+        if (m_eff > 0. && scales.maxStiffness > 0.) {
+            double t_c = PI_VAL * std::sqrt(m_eff / scales.maxStiffness);
+            h = std::min(h, t_c / stepsPerCollision);
+        }
+        if (u > 0. && maxOverlapRatio > 0. && scales.minRadius > 0.) {
+            h = std::min(h, maxOverlapRatio * scales.minRadius / u);
+        }
+        return h;
+    }
+
+    /// The step size to use next, given the current max velocity
+    double Propose(double max_vel) {
+        double h = std::min(AllowedStep(max_vel), step * (1. + maxGrowth));
+        h = std::min(h, std::min(ceiling, prevCeiling));
+        step = clampStep(h);
+        return step;
+    }
+
+    /// The step size to use next when only remaining is left of the span being advanced: a remainder that the proposed
+    /// step would leave and that is below RemainderTolerance is taken along in this step (or, if that breaks the
+    /// bounds, the remaining is split in two equal steps)
+    double ProposeWithin(double max_vel, double remaining) {
+        double h = Propose(max_vel);
+        if (remaining <= h)
+            return remaining;
+        if (remaining - h >= RemainderTolerance())
+            return h;
+        return (remaining <= std::min(maxStep, GetCeiling())) ? remaining : 0.5 * remaining;
+    }
+    /// A remainder of a span below this is not worth a step of its own
+    double RemainderTolerance() const { return std::max(minStep, REMAINDER_FRACTION * step); }
+
+    /// Judge a step of size h_used, given the max velocity after it. If it returns false, the step should be redone,
+    /// and the next Propose gives a smaller step.
+    bool Accept(double h_used, double max_vel_after) {
+        if (rejectTol <= 0. || h_used <= minStep * (1. + 1e-6))
+            return true;
+        double allowed = AllowedStep(max_vel_after);
+        if (h_used <= (1. + rejectTol) * allowed)
+            return true;
+        numRejected++;
+        step = clampStep(allowed);
+        return false;
+    }
+
+    /// Called when a CD order is sent; returns the step size ceiling that holds until the contacts of this order are
+    /// replaced
+    double RenewCeiling() {
+        prevCeiling = ceiling;
+        ceiling = std::min(maxStep, std::max(step, minStep) * CEILING_GROWTH);
+        return ceiling;
+    }
+
+    double GetStep() const { return step; }
+    double GetMinStep() const { return minStep; }
+    double GetCeiling() const { return std::min(ceiling, prevCeiling); }
+    unsigned int GetNumRejected() const { return numRejected; }
+
+  private:
+    static constexpr double PI_VAL = 3.14159265358979323846;
+    // How much larger than the current step the ceiling promised at an order is
+    static constexpr double CEILING_GROWTH = 2.;
+    // A remainder smaller than this fraction of the step is the round-off of the steps summed up
+    static constexpr double REMAINDER_FRACTION = 1e-4;
+
+    TimeStepScales scales;
+    double minStep = 0.;
+    double maxStep = std::numeric_limits<double>::infinity();
+    double maxGrowth = 0.1;
+    double stepsPerCollision = 30.;
+    double maxOverlapRatio = 0.01;
+    double velFloor = 0.;
+    double rejectTol = 0.;
+
+    double step = 0.;
+    double ceiling = std::numeric_limits<double>::infinity();
+    double prevCeiling = std::numeric_limits<double>::infinity();
+    unsigned int numRejected = 0;
+
+    double clampStep(double h) const { return std::min(std::max(h, minStep), maxStep); }
+};
+
+}  // namespace deme
+
+#endif
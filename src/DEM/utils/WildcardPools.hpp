@@ -0,0 +1,289 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_WILDCARD_POOLS_HPP
+#define DEME_WILDCARD_POOLS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <DEM/Defines.h>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Packed contact wildcard pools
+//
+// A contact wildcard in the default (dense) storage is a float array over all contact pairs. A pool instead keeps the
+// wildcards it holds only for the contacts in its scope, which is a set of contact types and, optionally, a set of
+// family pairs. Those contacts have a record each, holding all the fields of the pool, and the records are packed in
+// one array; an index array over the contact pairs gives the record of each contact, or NULL_MAPPING_PARTNER if it has
+// none. In the force model, a pooled wildcard of a contact with no record reads as 0, and writing it has no effect.
+// The fields can be stored as floats, half-precision floats, or 16-bit integers of a given scale (values are rounded to
+// the nearest multiple of it, and clamped to +-32767 of it).
+// When kT delivers new contacts, the contacts in scope get new record numbers in contact order; an enduring contact's
+// record is moved there and a new one's is zeroed. Contacts out of scope cost only their entry in the index.
+//
+// Dense wildcards are numbered first (in name order), so the dense arrays are numbered as if there were no pools;
+// pooled ones follow in pool order, and in name order within a pool.
+// -----------------------------------------------------------------------------
+
+struct ContactWildcardPool {
+    std::set<std::string> names;
+    // A bit per contact type in scope
+    unsigned int typeMask = 0;
+    // Family pairs in scope; if empty, all are
+    std::vector<std::pair<unsigned int, unsigned int>> familyPairs;
+    CNT_WILDCARD_PRECISION precision = CNT_WILDCARD_PRECISION::FLOAT32;
+    float quantScale = 1.f;
+};
+
+// Where a contact wildcard is stored: pool -1 means the dense array of its number
+struct ContactWildcardSlot {
+    int pool = -1;
+    unsigned int field = 0;
+};
+
+inline size_t WildcardPrecisionBytes(CNT_WILDCARD_PRECISION precision) {
+    return (precision == CNT_WILDCARD_PRECISION::FLOAT32) ? sizeof(float) : sizeof(uint16_t);
+}
+
+inline size_t WildcardPoolRecordBytes(const ContactWildcardPool& pool) {
+    return pool.names.size() * WildcardPrecisionBytes(pool.precision);
+}
+
+/// Float to IEEE half-precision bits, rounding to nearest even (what the device's cvt.rn.f16.f32 does)
+inline uint16_t WildcardFloatToHalf(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    const uint32_t exp = (x >> 23) & 0xFFu;
+    uint32_t mant = x & 0x7FFFFFu;
+    if (exp == 0xFFu)
+        return (uint16_t)(sign | 0x7C00u | (mant ? 0x200u : 0u));
+    const int e = (int)exp - 127 + 15;
+    if (e >= 31)
+        return (uint16_t)(sign | 0x7C00u);
+    if (e <= 0) {
+        // Subnormal in half precision
+        if (e < -10)
+            return (uint16_t)sign;
+        mant |= 0x800000u;
+        const unsigned int shift = (unsigned int)(14 - e);
+        uint32_t h = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1u), halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (h & 1u)))
+            h++;
+        return (uint16_t)(sign | h);
+    }
+    uint32_t h = ((uint32_t)e << 10) | (mant >> 13);
+    const uint32_t rem = mant & 0x1FFFu;
+    // A carry out of the mantissa rounds up the exponent, up to infinity, as it should
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u)))
+        h++;
+    return (uint16_t)(sign | h);
+}
+
+inline float WildcardHalfToFloat(uint16_t h) {
+    const uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    const uint32_t exp = (h >> 10) & 0x1Fu;
+    const uint32_t mant = h & 0x3FFu;
+    uint32_t x;
+    if (exp == 0) {
+        float f = std::ldexp((float)mant, -24);
+        return sign ? -f : f;
+    } else if (exp == 0x1Fu) {
+        x = sign | 0x7F800000u | (mant << 13);
+    } else {
+        x = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+    }
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+/// A value as a 16-bit integer multiple of scale, rounding to nearest even (as rintf on the device)
+inline int16_t WildcardQuantize(float val, float scale) {
+    float q = std::nearbyint(val / scale);
+    q = std::fmin(std::fmax(q, -32767.f), 32767.f);
+    return (int16_t)q;
+}
+
+inline float WildcardDequantize(int16_t q, float scale) {
+    return (float)q * scale;
+}
+
+/// Read a field of a record of a pool's packed data
+inline float ReadPooledWildcard(const uint8_t* data,
+                                const ContactWildcardPool& pool,
+                                size_t record,
+                                unsigned int field) {
+    const size_t elem = record * pool.names.size() + field;
+    switch (pool.precision) {
+        case CNT_WILDCARD_PRECISION::HALF: {
+            uint16_t h;
+            std::memcpy(&h, data + elem * sizeof(h), sizeof(h));
+            return WildcardHalfToFloat(h);
+        }
+        case CNT_WILDCARD_PRECISION::QUANT16: {
+            int16_t q;
+            std::memcpy(&q, data + elem * sizeof(q), sizeof(q));
+            return WildcardDequantize(q, pool.quantScale);
+        }
+        default: {
+            float f;
+            std::memcpy(&f, data + elem * sizeof(f), sizeof(f));
+            return f;
+        }
+    }
+}
+
+/// Write a field of a record of a pool's packed data
+inline void WritePooledWildcard(uint8_t* data,
+                                const ContactWildcardPool& pool,
+                                size_t record,
+                                unsigned int field,
+                                float val) {
+    const size_t elem = record * pool.names.size() + field;
+    switch (pool.precision) {
+        case CNT_WILDCARD_PRECISION::HALF: {
+            uint16_t h = WildcardFloatToHalf(val);
+            std::memcpy(data + elem * sizeof(h), &h, sizeof(h));
+            break;
+        }
+        case CNT_WILDCARD_PRECISION::QUANT16: {
+            int16_t q = WildcardQuantize(val, pool.quantScale);
+            std::memcpy(data + elem * sizeof(q), &q, sizeof(q));
+            break;
+        }
+        default:
+            std::memcpy(data + elem * sizeof(val), &val, sizeof(val));
+    }
+}
+
+/// Index of a family pair in a flattened upper-triangular table of all family pairs (locateMaskPair)
+inline size_t WildcardPoolFamilyPairSlot(unsigned int famA, unsigned int famB) {
+    if (famA > famB)
+        std::swap(famA, famB);
+    return (size_t)(1 + famB) * famB / 2 + famA;
+}
+
+/// The table of family pairs in scope of a pool, for the device to look up; empty if all family pairs are
+inline std::vector<notStupidBool_t> WildcardPoolFamilyPairTable(const ContactWildcardPool& pool) {
+    std::vector<notStupidBool_t> table;
+    if (pool.familyPairs.empty())
+        return table;
+    table.assign(NUM_AVAL_FAMILIES * (NUM_AVAL_FAMILIES + 1) / 2, 0);
+    for (const auto& pair : pool.familyPairs)
+        table.at(WildcardPoolFamilyPairSlot(pair.first, pair.second)) = 1;
+    return table;
+}
+
+/// Whether a contact of this type between these families is in scope of a pool (the host version of the device check)
+inline bool ContactInWildcardPoolScope(const ContactWildcardPool& pool,
+                                       contact_t type,
+                                       unsigned int famA,
+                                       unsigned int famB) {
+    if (type == NOT_A_CONTACT || type >= 32 || !((pool.typeMask >> type) & 1u))
+        return false;
+    if (pool.familyPairs.empty())
+        return true;
+    for (const auto& pair : pool.familyPairs) {
+        if ((pair.first == famA && pair.second == famB) || (pair.first == famB && pair.second == famA))
+            return true;
+    }
+    return false;
+}
+
+/// Number all contact wildcards (names) given the pools: wc_num maps a name to its number, and slots (by number) tell
+/// where each is stored. Returns the number of dense wildcards. The pools are assumed valid: each pooled name is one of
+/// names and is in one pool only.
+inline unsigned int NumberContactWildcards(const std::set<std::string>& names,
+                                           const std::vector<ContactWildcardPool>& pools,
+                                           std::map<std::string, unsigned int>& wc_num,
+                                           std::vector<ContactWildcardSlot>& slots) {
+    wc_num.clear();
+    slots.clear();
+    std::set<std::string> pooled;
+    for (const auto& pool : pools)
+        pooled.insert(pool.names.begin(), pool.names.end());
+    for (const auto& name : names) {
+        if (pooled.count(name))
+            continue;
+        wc_num[name] = (unsigned int)slots.size();
+        slots.push_back(ContactWildcardSlot());
+    }
+    const unsigned int n_dense = (unsigned int)slots.size();
+    for (size_t p = 0; p < pools.size(); p++) {
+        unsigned int field = 0;
+        for (const auto& name : pools[p].names) {
+            wc_num[name] = (unsigned int)slots.size();
+            slots.push_back({(int)p, field++});
+        }
+    }
+    return n_dense;
+}
+
+// A float as a literal of JIT source
+inline std::string WildcardFloatLiteral(float val) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", val);
+    return "((float)(" + std::string(buf) + "))";
+}
+
+/// Generate the force kernel code that loads the pooled contact wildcards, writes them back, and zeroes them for a
+/// non-contact; appended to the code of the dense ones
+inline void EquipPooledContactWildcards(const std::vector<ContactWildcardPool>& pools,
+                                        std::string& acquisition,
+                                        std::string& write_back,
+                                        std::string& destroy_record) {
+    for (size_t p = 0; p < pools.size(); p++) {
+        const auto& pool = pools[p];
+        const std::string pool_num = std::to_string(p);
+        const std::string rec = "wcPoolRecord" + pool_num;
+        const std::string n_fields = std::to_string(pool.names.size());
+        std::string elem_type = "float";
+        if (pool.precision == CNT_WILDCARD_PRECISION::HALF) {
+            elem_type = "unsigned short";
+        } else if (pool.precision == CNT_WILDCARD_PRECISION::QUANT16) {
+            elem_type = "short";
+        }
+        const std::string data = "((" + elem_type + "*)granData->wildcardPoolData[" + pool_num + "])";
+        acquisition +=
+            "deme::contactPairs_t " + rec + " = granData->wildcardPoolIndex[" + pool_num + "][myContactID];\n";
+        std::string stores;
+        unsigned int field = 0;
+        for (const auto& name : pool.names) {
+            const std::string elem = data + "[(size_t)" + rec + " * " + n_fields + " + " + std::to_string(field) + "]";
+            std::string load, store;
+            if (pool.precision == CNT_WILDCARD_PRECISION::HALF) {
+                load = "wildcardHalfToFloat(" + elem + ")";
+                store = "wildcardFloatToHalf(" + name + ")";
+            } else if (pool.precision == CNT_WILDCARD_PRECISION::QUANT16) {
+                load = "(float)" + elem + " * " + WildcardFloatLiteral(pool.quantScale);
+                store = "wildcardQuantize(" + name + ", " + WildcardFloatLiteral(pool.quantScale) + ")";
+            } else {
+                load = elem;
+                store = name;
+            }
+            acquisition += "float " + name + " = (" + rec + " != deme::NULL_MAPPING_PARTNER) ? " + load + " : 0.f;\n";
+            stores += elem + " = " + store + ";\n";
+            destroy_record += name + " = 0;\n";
+            field++;
+        }
+        write_back += "if (" + rec + " != deme::NULL_MAPPING_PARTNER) {\n" + stores + "}\n";
+    }
+}
+
+}  // namespace deme
+
+#endif
@@ -10,6 +10,8 @@
 #include <algorithms/DEMStaticDeviceSubroutines.h>
 #include <algorithms/DEMStaticDeviceUtilities.cuh>
 #include <DEM/HostSideHelpers.hpp>
+#include <DEM/utils/HierarchicalGrid.hpp>
+#include <DEM/utils/IndexWidth.hpp>
 
 #include <algorithms/DEMCubWrappers.cu>
 
@@ -35,6 +37,16 @@ inline void contactEventArraysResize(size_t nContactPairs,
     granData.toDevice();
 }
 
+// The prefix scans of per-item counts into an index type saturate rather than wrap around, so the scan tail (last
+// offset + last count, which is fetched to the host in 64 bits anyway) tells if the total fits the index type. Check
+// it before the tail or the scanned offsets are used.
+template <typename IndexT>
+inline void checkScanTotalFitsIndex(size_t total, const char* what) {
+    if (!ScanTotalFitsIndex<IndexT>(total)) {
+        DEME_ERROR("%s", IndexOverflowMessage<IndexT>(what, total).c_str());
+    }
+}
+
 void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                       std::shared_ptr<jitify::Program>& bin_triangle_kernels,
                       std::shared_ptr<jitify::Program>& sphere_contact_kernels,
@@ -72,40 +84,49 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
     stateParams.maxSphFoundInBin = 0;
     stateParams.maxTriFoundInBin = 0;
     stateParams.avgCntsPerSphere = 0;
+    stateParams.numBinSphereTouchPairs = 0;
+    stateParams.numActiveBins = 0;
 
     // total bytes needed for temp arrays in contact detection
     size_t CD_temp_arr_bytes = 0;
 
     {
+        // The temporary arrays of binning and contact pair finding are given back when this block ends
+        auto bin_scope = scratchPad.openScope();
         timers.GetTimer("Discretize domain").start();
         ////////////////////////////////////////////////////////////////////////////////
         // Sphere-related discretization & sphere--analytical contact detection
         ////////////////////////////////////////////////////////////////////////////////
 
+        // In hierarchical-grid mode, the bins only serve sphere--triangle contacts. If no facet is binned (all are in
+        // local-frame grids, or there is none), the spheres are not binned either, and this pass only finds their
+        // analytical contacts.
+        const bool binSpheres = !solverFlags.useHierGridCD || simParams->nTriGM > simParams->nTriInMeshGrids;
+
         // 1st step: register the number of sphere--bin touching pairs for each sphere for further processing
         CD_temp_arr_bytes = simParams->nSpheresGM * sizeof(binsSphereTouches_t);
         binsSphereTouches_t* numBinsSphereTouches =
-            (binsSphereTouches_t*)scratchPad.allocateTempVector("numBinsSphereTouches", CD_temp_arr_bytes);
+            (binsSphereTouches_t*)scratchPad.allocateTempVector(SCRATCH_CD_NUM_BINS_SPHERE_TOUCHES, CD_temp_arr_bytes);
         // This kernel is also tasked to find how many analytical objects each sphere touches
         // We'll use a new vector 2 to store this
         CD_temp_arr_bytes = simParams->nSpheresGM * sizeof(objID_t);
         objID_t* numAnalGeoSphereTouches =
-            (objID_t*)scratchPad.allocateTempVector("numAnalGeoSphereTouches", CD_temp_arr_bytes);
+            (objID_t*)scratchPad.allocateTempVector(SCRATCH_CD_NUM_ANAL_GEO_SPHERE_TOUCHES, CD_temp_arr_bytes);
         size_t blocks_needed_for_bodies =
             (simParams->nSpheresGM + DEME_NUM_BODIES_PER_BLOCK - 1) / DEME_NUM_BODIES_PER_BLOCK;
 
         bin_sphere_kernels->kernel("getNumberOfBinsEachSphereTouches")
             .instantiate()
             .configure(dim3(blocks_needed_for_bodies), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
-            .launch(&simParams, &granData, numBinsSphereTouches, numAnalGeoSphereTouches);
+            .launch(&simParams, &granData, numBinsSphereTouches, numAnalGeoSphereTouches, binSpheres);
         DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
 
         // 2nd step: prefix scan sphere--bin touching pairs
         // The last element of this scanned array is useful: it can be used to check if the 2 sweeps reach the same
         // conclusion on bin--sph touch pairs
         CD_temp_arr_bytes = (simParams->nSpheresGM + 1) * sizeof(binSphereTouchPairs_t);
-        binSphereTouchPairs_t* numBinsSphereTouchesScan =
-            (binSphereTouchPairs_t*)scratchPad.allocateTempVector("numBinsSphereTouchesScan", CD_temp_arr_bytes);
+        binSphereTouchPairs_t* numBinsSphereTouchesScan = (binSphereTouchPairs_t*)scratchPad.allocateTempVector(
+            SCRATCH_CD_NUM_BINS_SPHERE_TOUCHES_SCAN, CD_temp_arr_bytes);
         cubDEMPrefixScan<binsSphereTouches_t, binSphereTouchPairs_t>(numBinsSphereTouches, numBinsSphereTouchesScan,
                                                                      simParams->nSpheresGM, this_stream, scratchPad);
         // If there are temp variables that need both device and host copies, we just create DualStruct on-spot
@@ -121,11 +142,13 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
         scratchPad.syncDualStructDeviceToHost("numBinSphereTouchPairs");
         // Now pNumBinSphereTouchPairs is host pointer and exclusively used on host
         pNumBinSphereTouchPairs = scratchPad.getDualStructHost("numBinSphereTouchPairs");
+        checkScanTotalFitsIndex<binSphereTouchPairs_t>(*pNumBinSphereTouchPairs, "bin--sphere touch pairs");
+        stateParams.numBinSphereTouchPairs = *pNumBinSphereTouchPairs;
         // The same process is done for sphere--analytical geometry pairs as well.
         // One extra elem is used for storing the final elem in scan result.
         CD_temp_arr_bytes = (simParams->nSpheresGM + 1) * sizeof(binSphereTouchPairs_t);
-        binSphereTouchPairs_t* numAnalGeoSphereTouchesScan =
-            (binSphereTouchPairs_t*)scratchPad.allocateTempVector("numAnalGeoSphereTouchesScan", CD_temp_arr_bytes);
+        binSphereTouchPairs_t* numAnalGeoSphereTouchesScan = (binSphereTouchPairs_t*)scratchPad.allocateTempVector(
+            SCRATCH_CD_NUM_ANAL_GEO_SPHERE_TOUCHES_SCAN, CD_temp_arr_bytes);
         cubDEMPrefixScan<objID_t, binSphereTouchPairs_t>(numAnalGeoSphereTouches, numAnalGeoSphereTouchesScan,
                                                          simParams->nSpheresGM, this_stream, scratchPad);
         deviceAdd<size_t, objID_t, binSphereTouchPairs_t>(
@@ -135,6 +158,7 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                                                     &(scratchPad.numContacts), this_stream);
         // numContact is updated (with geo--sphere pair number), get it to host
         scratchPad.numContacts.toHost();
+        checkScanTotalFitsIndex<binSphereTouchPairs_t>(*(scratchPad.numContacts), "sphere--analytical contacts");
         if (*(scratchPad.numContacts) > idGeometryA.size()) {
             contactEventArraysResize(*(scratchPad.numContacts), idGeometryA, idGeometryB, contactType, granData);
         }
@@ -142,85 +166,83 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
         // displayDeviceArray<binsSphereTouches_t>(numBinsSphereTouches, simParams->nSpheresGM);
         // displayDeviceArray<binSphereTouchPairs_t>(numBinsSphereTouchesScan, simParams->nSpheresGM);
 
-        // 3rd step: use a custom kernel to figure out all sphere--bin touching pairs. Note numBinsSphereTouches can
-        // retire now.
-        scratchPad.finishUsingTempVector("numBinsSphereTouches");
-        scratchPad.finishUsingTempVector("numAnalGeoSphereTouches");
-
-        CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(binID_t);
-        binID_t* binIDsEachSphereTouches =
-            (binID_t*)scratchPad.allocateTempVector("binIDsEachSphereTouches", CD_temp_arr_bytes);
-        CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(bodyID_t);
-        bodyID_t* sphereIDsEachBinTouches =
-            (bodyID_t*)scratchPad.allocateTempVector("sphereIDsEachBinTouches", CD_temp_arr_bytes);
-        // This kernel is also responsible of figuring out sphere--analytical geometry pairs
-        bin_sphere_kernels->kernel("populateBinSphereTouchingPairs")
-            .instantiate()
-            .configure(dim3(blocks_needed_for_bodies), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
-            .launch(&simParams, &granData, numBinsSphereTouchesScan, numAnalGeoSphereTouchesScan,
-                    binIDsEachSphereTouches, sphereIDsEachBinTouches, granData->idGeometryA, granData->idGeometryB,
-                    granData->contactType);
-        DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
-        // std::cout << "Unsorted bin IDs: ";
-        // displayDeviceArray<binID_t>(binIDsEachSphereTouches, *pNumBinSphereTouchPairs);
-        // std::cout << "Corresponding sphere IDs: ";
-        // displayDeviceArray<bodyID_t>(sphereIDsEachBinTouches, *pNumBinSphereTouchPairs);
-
-        // 4th step: allocate and populate SORTED binIDsEachSphereTouches and sphereIDsEachBinTouches. Note
-        // numBinsSphereTouchesScan can retire now (analytical contacts have been processed).
-        scratchPad.finishUsingTempVector("numBinsSphereTouchesScan");
-        scratchPad.finishUsingTempVector("numAnalGeoSphereTouchesScan");
+        // 3rd step: use a custom kernel to figure out all sphere--bin touching pairs. The sorted sphere IDs, and the
+        // number of spheres in each active bin (no more than the pairs), are used till the end, so they are taken
+        // first; the unsorted pairs and the sorted bin IDs are taken in an inner scope and given back after the bins
+        // are encoded.
         CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(bodyID_t);
         bodyID_t* sphereIDsEachBinTouches_sorted =
-            (bodyID_t*)scratchPad.allocateTempVector("sphereIDsEachBinTouches_sorted", CD_temp_arr_bytes);
-        CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(binID_t);
-        binID_t* binIDsEachSphereTouches_sorted =
-            (binID_t*)scratchPad.allocateTempVector("binIDsEachSphereTouches_sorted", CD_temp_arr_bytes);
-        // hostSortByKey<binID_t, bodyID_t>(granData->binIDsEachSphereTouches, granData->sphereIDsEachBinTouches,
-        //                                  *pNumBinSphereTouchPairs);
-        cubDEMSortByKeys<binID_t, bodyID_t>(binIDsEachSphereTouches, binIDsEachSphereTouches_sorted,
-                                            sphereIDsEachBinTouches, sphereIDsEachBinTouches_sorted,
-                                            *pNumBinSphereTouchPairs, this_stream, scratchPad);
-        // std::cout << "Sorted bin IDs: ";
-        // displayDeviceArray<binID_t>(binIDsEachSphereTouches_sorted, *pNumBinSphereTouchPairs);
-        // std::cout << "Corresponding sphere IDs: ";
-        // displayDeviceArray<bodyID_t>(sphereIDsEachBinTouches_sorted, *pNumBinSphereTouchPairs);
-
-        // 5th step: use DeviceRunLengthEncode to identify those active (that have bodies in them) bins.
-        // Also, binIDsEachSphereTouches is large enough for a unique scan because total sphere--bin pairs are more than
-        // active bins.
-        binID_t* binIDsUnique = (binID_t*)binIDsEachSphereTouches;
-        scratchPad.allocateDualStruct("numActiveBins");
-        size_t* pNumActiveBins = scratchPad.getDualStructDevice("numActiveBins");
-        cubDEMUnique<binID_t>(binIDsEachSphereTouches_sorted, binIDsUnique, pNumActiveBins, *pNumBinSphereTouchPairs,
-                              this_stream, scratchPad);
-        // Allocate space for encoding output, and run it. Note the (unsorted) binIDsEachSphereTouches and
-        // sphereIDsEachBinTouches can retire now.
-        scratchPad.finishUsingTempVector("binIDsEachSphereTouches");
-        scratchPad.finishUsingTempVector("sphereIDsEachBinTouches");
-        // Get the unique check result to host
-        scratchPad.syncDualStructDeviceToHost("numActiveBins");
-        pNumActiveBins = scratchPad.getDualStructHost("numActiveBins");
-        CD_temp_arr_bytes = (*pNumActiveBins) * sizeof(binID_t);
-        // This activeBinIDs will need some host treatment later on...
-        scratchPad.allocateDualArray("activeBinIDs", CD_temp_arr_bytes);
-        binID_t* activeBinIDs = (binID_t*)scratchPad.getDualArrayDevice("activeBinIDs");
-        CD_temp_arr_bytes = (*pNumActiveBins) * sizeof(spheresBinTouches_t);
+            (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_SPHERE_IDS_EACH_BIN_TOUCHES_SORTED, CD_temp_arr_bytes);
+        CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(spheresBinTouches_t);
         spheresBinTouches_t* numSpheresBinTouches =
-            (spheresBinTouches_t*)scratchPad.allocateTempVector("numSpheresBinTouches", CD_temp_arr_bytes);
-        // Here you don't have to toHost() again as the runlength should give the same numActiveBins as before
-        pNumActiveBins = scratchPad.getDualStructDevice("numActiveBins");
-        cubDEMRunLengthEncode<binID_t, spheresBinTouches_t>(binIDsEachSphereTouches_sorted, activeBinIDs,
-                                                            numSpheresBinTouches, pNumActiveBins,
-                                                            *pNumBinSphereTouchPairs, this_stream, scratchPad);
+            (spheresBinTouches_t*)scratchPad.allocateTempVector(SCRATCH_CD_NUM_SPHERES_BIN_TOUCHES, CD_temp_arr_bytes);
+        size_t* pNumActiveBins;
+        binID_t* activeBinIDs;
+        {
+            auto pair_scope = scratchPad.openScope();
+            CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(binID_t);
+            binID_t* binIDsEachSphereTouches =
+                (binID_t*)scratchPad.allocateTempVector(SCRATCH_CD_BIN_IDS_EACH_SPHERE_TOUCHES, CD_temp_arr_bytes);
+            CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(bodyID_t);
+            bodyID_t* sphereIDsEachBinTouches =
+                (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_SPHERE_IDS_EACH_BIN_TOUCHES, CD_temp_arr_bytes);
+            // This kernel is also responsible of figuring out sphere--analytical geometry pairs
+            bin_sphere_kernels->kernel("populateBinSphereTouchingPairs")
+                .instantiate()
+                .configure(dim3(blocks_needed_for_bodies), dim3(DEME_NUM_BODIES_PER_BLOCK), 0, this_stream)
+                .launch(&simParams, &granData, numBinsSphereTouchesScan, numAnalGeoSphereTouchesScan,
+                        binIDsEachSphereTouches, sphereIDsEachBinTouches, granData->idGeometryA, granData->idGeometryB,
+                        granData->contactType, binSpheres);
+            DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+            // std::cout << "Unsorted bin IDs: ";
+            // displayDeviceArray<binID_t>(binIDsEachSphereTouches, *pNumBinSphereTouchPairs);
+            // std::cout << "Corresponding sphere IDs: ";
+            // displayDeviceArray<bodyID_t>(sphereIDsEachBinTouches, *pNumBinSphereTouchPairs);
+
+            // 4th step: populate SORTED binIDsEachSphereTouches and sphereIDsEachBinTouches.
+            CD_temp_arr_bytes = (*pNumBinSphereTouchPairs) * sizeof(binID_t);
+            binID_t* binIDsEachSphereTouches_sorted = (binID_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_BIN_IDS_EACH_SPHERE_TOUCHES_SORTED, CD_temp_arr_bytes);
+            // hostSortByKey<binID_t, bodyID_t>(granData->binIDsEachSphereTouches, granData->sphereIDsEachBinTouches,
+            //                                  *pNumBinSphereTouchPairs);
+            cubDEMSortByKeys<binID_t, bodyID_t>(binIDsEachSphereTouches, binIDsEachSphereTouches_sorted,
+                                                sphereIDsEachBinTouches, sphereIDsEachBinTouches_sorted,
+                                                *pNumBinSphereTouchPairs, this_stream, scratchPad);
+            // std::cout << "Sorted bin IDs: ";
+            // displayDeviceArray<binID_t>(binIDsEachSphereTouches_sorted, *pNumBinSphereTouchPairs);
+            // std::cout << "Corresponding sphere IDs: ";
+            // displayDeviceArray<bodyID_t>(sphereIDsEachBinTouches_sorted, *pNumBinSphereTouchPairs);
+
+            // 5th step: use DeviceRunLengthEncode to identify those active (that have bodies in them) bins.
+            // Also, binIDsEachSphereTouches is large enough for a unique scan because total sphere--bin pairs are more
+            // than active bins.
+            binID_t* binIDsUnique = (binID_t*)binIDsEachSphereTouches;
+            scratchPad.allocateDualStruct("numActiveBins");
+            pNumActiveBins = scratchPad.getDualStructDevice("numActiveBins");
+            cubDEMUnique<binID_t>(binIDsEachSphereTouches_sorted, binIDsUnique, pNumActiveBins,
+                                  *pNumBinSphereTouchPairs, this_stream, scratchPad);
+            // Get the unique check result to host
+            scratchPad.syncDualStructDeviceToHost("numActiveBins");
+            pNumActiveBins = scratchPad.getDualStructHost("numActiveBins");
+            stateParams.numActiveBins = *pNumActiveBins;
+            CD_temp_arr_bytes = (*pNumActiveBins) * sizeof(binID_t);
+            // This activeBinIDs will need some host treatment later on...
+            scratchPad.allocateDualArray("activeBinIDs", CD_temp_arr_bytes);
+            activeBinIDs = (binID_t*)scratchPad.getDualArrayDevice("activeBinIDs");
+            // Here you don't have to toHost() again as the runlength should give the same numActiveBins as before
+            pNumActiveBins = scratchPad.getDualStructDevice("numActiveBins");
+            cubDEMRunLengthEncode<binID_t, spheresBinTouches_t>(binIDsEachSphereTouches_sorted, activeBinIDs,
+                                                                numSpheresBinTouches, pNumActiveBins,
+                                                                *pNumBinSphereTouchPairs, this_stream, scratchPad);
+            // std::cout << "binIDsEachSphereTouches_sorted: ";
+            // displayDeviceArray<binID_t>(binIDsEachSphereTouches_sorted, *pNumBinSphereTouchPairs);
+        }
         pNumActiveBins = scratchPad.getDualStructHost("numActiveBins");
         // std::cout << "numActiveBins: " << *pNumActiveBins << std::endl;
         // std::cout << "activeBinIDs: ";
         // displayDeviceArray<binID_t>(activeBinIDs, *pNumActiveBins);
         // std::cout << "numSpheresBinTouches: ";
         // displayDeviceArray<spheresBinTouches_t>(numSpheresBinTouches, *pNumActiveBins);
-        // std::cout << "binIDsEachSphereTouches_sorted: ";
-        // displayDeviceArray<binID_t>(binIDsEachSphereTouches_sorted, *pNumBinSphereTouchPairs);
         scratchPad.finishUsingDualStruct("numBinSphereTouchPairs");
 
         // We find the max geo num in a bin for the purpose of adjusting bin size.
@@ -233,11 +255,10 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
         scratchPad.finishUsingDualStruct("maxGeoInBin");
 
         // Then, scan to find the offsets that are used to index into sphereIDsEachBinTouches_sorted to obtain bin-wise
-        // spheres. Note binIDsEachSphereTouches_sorted can retire.
-        scratchPad.finishUsingTempVector("binIDsEachSphereTouches_sorted");
+        // spheres.
         CD_temp_arr_bytes = (*pNumActiveBins) * sizeof(binSphereTouchPairs_t);
-        binSphereTouchPairs_t* sphereIDsLookUpTable =
-            (binSphereTouchPairs_t*)scratchPad.allocateTempVector("sphereIDsLookUpTable", CD_temp_arr_bytes);
+        binSphereTouchPairs_t* sphereIDsLookUpTable = (binSphereTouchPairs_t*)scratchPad.allocateTempVector(
+            SCRATCH_CD_SPHERE_IDS_LOOK_UP_TABLE, CD_temp_arr_bytes);
         cubDEMPrefixScan<spheresBinTouches_t, binSphereTouchPairs_t>(numSpheresBinTouches, sphereIDsLookUpTable,
                                                                      *pNumActiveBins, this_stream, scratchPad);
         // std::cout << "sphereIDsLookUpTable: ";
@@ -264,10 +285,10 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // the 2 prism surfaces is smaller than its radius, it has contact with this prism, hence potentially with
             // this triangle.
             CD_temp_arr_bytes = simParams->nTriGM * sizeof(float3) * 3;
-            sandwichANode1 = (float3*)scratchPad.allocateTempVector("sandwichANode1", CD_temp_arr_bytes);
+            sandwichANode1 = (float3*)scratchPad.allocateTempVector(SCRATCH_CD_SANDWICH_A_NODE1, CD_temp_arr_bytes);
             sandwichANode2 = sandwichANode1 + simParams->nTriGM;
             sandwichANode3 = sandwichANode2 + simParams->nTriGM;
-            sandwichBNode1 = (float3*)scratchPad.allocateTempVector("sandwichBNode1", CD_temp_arr_bytes);
+            sandwichBNode1 = (float3*)scratchPad.allocateTempVector(SCRATCH_CD_SANDWICH_B_NODE1, CD_temp_arr_bytes);
             sandwichBNode2 = sandwichBNode1 + simParams->nTriGM;
             sandwichBNode3 = sandwichBNode2 + simParams->nTriGM;
             size_t blocks_needed_for_tri =
@@ -282,8 +303,8 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // 1st step: register the number of triangle--bin touching pairs for each triangle for further processing.
             // Because we do a `sandwich' contact detection, we are
             CD_temp_arr_bytes = simParams->nTriGM * sizeof(binsTriangleTouches_t);
-            binsTriangleTouches_t* numBinsTriTouches =
-                (binsTriangleTouches_t*)scratchPad.allocateTempVector("numBinsTriTouches", CD_temp_arr_bytes);
+            binsTriangleTouches_t* numBinsTriTouches = (binsTriangleTouches_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_NUM_BINS_TRI_TOUCHES, CD_temp_arr_bytes);
             {
                 bin_triangle_kernels->kernel("getNumberOfBinsEachTriangleTouches")
                     .instantiate()
@@ -300,8 +321,8 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // The last element of this scanned array is useful: it can be used to check if the 2 sweeps reach the same
             // conclusion on bin--tri touch pairs
             CD_temp_arr_bytes = (simParams->nTriGM + 1) * sizeof(binsTriangleTouchPairs_t);
-            binsTriangleTouchPairs_t* numBinsTriTouchesScan =
-                (binsTriangleTouchPairs_t*)scratchPad.allocateTempVector("numBinsTriTouchesScan", CD_temp_arr_bytes);
+            binsTriangleTouchPairs_t* numBinsTriTouchesScan = (binsTriangleTouchPairs_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_NUM_BINS_TRI_TOUCHES_SCAN, CD_temp_arr_bytes);
             cubDEMPrefixScan<binsTriangleTouches_t, binsTriangleTouchPairs_t>(
                 numBinsTriTouches, numBinsTriTouchesScan, simParams->nTriGM, this_stream, scratchPad);
             scratchPad.allocateDualStruct("numBinTriTouchPairs");
@@ -313,18 +334,25 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                                                            pNumBinTriTouchPairs, this_stream);
             scratchPad.syncDualStructDeviceToHost("numBinTriTouchPairs");
             pNumBinTriTouchPairs = scratchPad.getDualStructHost("numBinTriTouchPairs");
+            checkScanTotalFitsIndex<binsTriangleTouchPairs_t>(*pNumBinTriTouchPairs, "bin--triangle touch pairs");
             // Again, numBinsTriTouchesScan is used in populateBinTriangleTouchingPairs
 
-            // 3rd step: use a custom kernel to figure out all sphere--bin touching pairs. Note numBinsTriTouches can
-            // retire now.
-            scratchPad.finishUsingTempVector("numBinsTriTouches");
-            CD_temp_arr_bytes = *pNumBinTriTouchPairs * sizeof(binID_t);
-            binID_t* binIDsEachTriTouches =
-                (binID_t*)scratchPad.allocateTempVector("binIDsEachTriTouches", CD_temp_arr_bytes);
+            // 3rd step: use a custom kernel to figure out all triangle--bin touching pairs. As with spheres, the arrays
+            // used till the end are taken first, and the others in an inner scope.
             CD_temp_arr_bytes = *pNumBinTriTouchPairs * sizeof(bodyID_t);
-            bodyID_t* triIDsEachBinTouches =
-                (bodyID_t*)scratchPad.allocateTempVector("triIDsEachBinTouches", CD_temp_arr_bytes);
+            triIDsEachBinTouches_sorted =
+                (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_TRI_IDS_EACH_BIN_TOUCHES_SORTED, CD_temp_arr_bytes);
+            CD_temp_arr_bytes = *pNumBinTriTouchPairs * sizeof(trianglesBinTouches_t);
+            numTrianglesBinTouches = (trianglesBinTouches_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_NUM_TRIANGLES_BIN_TOUCHES, CD_temp_arr_bytes);
             {
+                auto pair_scope = scratchPad.openScope();
+                CD_temp_arr_bytes = *pNumBinTriTouchPairs * sizeof(binID_t);
+                binID_t* binIDsEachTriTouches =
+                    (binID_t*)scratchPad.allocateTempVector(SCRATCH_CD_BIN_IDS_EACH_TRI_TOUCHES, CD_temp_arr_bytes);
+                CD_temp_arr_bytes = *pNumBinTriTouchPairs * sizeof(bodyID_t);
+                bodyID_t* triIDsEachBinTouches =
+                    (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_TRI_IDS_EACH_BIN_TOUCHES, CD_temp_arr_bytes);
                 bin_triangle_kernels->kernel("populateBinTriangleTouchingPairs")
                     .instantiate()
                     .configure(dim3(blocks_needed_for_tri), dim3(DEME_NUM_TRIANGLE_PER_BLOCK), 0, this_stream)
@@ -332,48 +360,36 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                             sandwichANode1, sandwichANode2, sandwichANode3, sandwichBNode1, sandwichBNode2,
                             sandwichBNode3);
                 DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+                // std::cout << "binIDsEachTriTouches: " << std::endl;
+                // displayDeviceArray<binsTriangleTouches_t>(binIDsEachTriTouches, *pNumBinTriTouchPairs);
+
+                // 4th step: populate SORTED binIDsEachTriTouches and triIDsEachBinTouches.
+                CD_temp_arr_bytes = *pNumBinTriTouchPairs * sizeof(binID_t);
+                binID_t* binIDsEachTriTouches_sorted = (binID_t*)scratchPad.allocateTempVector(
+                    SCRATCH_CD_BIN_IDS_EACH_TRI_TOUCHES_SORTED, CD_temp_arr_bytes);
+                cubDEMSortByKeys<binID_t, bodyID_t>(binIDsEachTriTouches, binIDsEachTriTouches_sorted,
+                                                    triIDsEachBinTouches, triIDsEachBinTouches_sorted,
+                                                    *pNumBinTriTouchPairs, this_stream, scratchPad);
+
+                // 5th step: use DeviceRunLengthEncode to identify those active (that have tris in them) bins.
+                // Also, binIDsEachTriTouches is large enough for a unique scan because total sphere--bin pairs are
+                // more than active bins.
+                binID_t* binIDsUnique = (binID_t*)binIDsEachTriTouches;
+                cubDEMUnique<binID_t>(binIDsEachTriTouches_sorted, binIDsUnique, pNumActiveBinsForTri,
+                                      *pNumBinTriTouchPairs, this_stream, scratchPad);
+                // Bring value to host
+                scratchPad.syncDualStructDeviceToHost("numActiveBinsForTri");
+                pNumActiveBinsForTri = scratchPad.getDualStructHost("numActiveBinsForTri");
+                CD_temp_arr_bytes = (*pNumActiveBinsForTri) * sizeof(binID_t);
+                // Again, activeBinIDsForTri has some data processing needed on host, so allocated as DualArray
+                scratchPad.allocateDualArray("activeBinIDsForTri", CD_temp_arr_bytes);
+                activeBinIDsForTri = (binID_t*)scratchPad.getDualArrayDevice("activeBinIDsForTri");
+                // Again, no need to bring numActiveBinsForTri to host again, as values not changed
+                pNumActiveBinsForTri = scratchPad.getDualStructDevice("numActiveBinsForTri");
+                cubDEMRunLengthEncode<binID_t, trianglesBinTouches_t>(binIDsEachTriTouches_sorted, activeBinIDsForTri,
+                                                                      numTrianglesBinTouches, pNumActiveBinsForTri,
+                                                                      *pNumBinTriTouchPairs, this_stream, scratchPad);
             }
-            // std::cout << "binIDsEachTriTouches: " << std::endl;
-            // displayDeviceArray<binsTriangleTouches_t>(binIDsEachTriTouches, *pNumBinTriTouchPairs);
-
-            // 4th step: allocate and populate SORTED binIDsEachTriTouches and triIDsEachBinTouches. Note
-            // numBinsTriTouchesScan can retire now.
-            scratchPad.finishUsingTempVector("numBinsTriTouchesScan");
-            CD_temp_arr_bytes = *pNumBinTriTouchPairs * sizeof(bodyID_t);
-            triIDsEachBinTouches_sorted =
-                (bodyID_t*)scratchPad.allocateTempVector("triIDsEachBinTouches_sorted", CD_temp_arr_bytes);
-            CD_temp_arr_bytes = *pNumBinTriTouchPairs * sizeof(binID_t);
-            binID_t* binIDsEachTriTouches_sorted =
-                (binID_t*)scratchPad.allocateTempVector("binIDsEachTriTouches_sorted", CD_temp_arr_bytes);
-            cubDEMSortByKeys<binID_t, bodyID_t>(binIDsEachTriTouches, binIDsEachTriTouches_sorted, triIDsEachBinTouches,
-                                                triIDsEachBinTouches_sorted, *pNumBinTriTouchPairs, this_stream,
-                                                scratchPad);
-
-            // 5th step: use DeviceRunLengthEncode to identify those active (that have tris in them) bins.
-            // Also, binIDsEachTriTouches is large enough for a unique scan because total sphere--bin pairs are more
-            // than active bins.
-            binID_t* binIDsUnique = (binID_t*)binIDsEachTriTouches;
-            cubDEMUnique<binID_t>(binIDsEachTriTouches_sorted, binIDsUnique, pNumActiveBinsForTri,
-                                  *pNumBinTriTouchPairs, this_stream, scratchPad);
-            // Allocate space for encoding output, and run it. Note the (unsorted) binIDsEachTriTouches and
-            // triIDsEachBinTouches can retire now.
-            scratchPad.finishUsingTempVector("binIDsEachTriTouches");
-            scratchPad.finishUsingTempVector("triIDsEachBinTouches");
-            // Bring value to host
-            scratchPad.syncDualStructDeviceToHost("numActiveBinsForTri");
-            pNumActiveBinsForTri = scratchPad.getDualStructHost("numActiveBinsForTri");
-            CD_temp_arr_bytes = (*pNumActiveBinsForTri) * sizeof(binID_t);
-            // Again, activeBinIDsForTri has some data processing needed on host, so allocated as DualArray
-            scratchPad.allocateDualArray("activeBinIDsForTri", CD_temp_arr_bytes);
-            activeBinIDsForTri = (binID_t*)scratchPad.getDualArrayDevice("activeBinIDsForTri");
-            CD_temp_arr_bytes = (*pNumActiveBinsForTri) * sizeof(trianglesBinTouches_t);
-            numTrianglesBinTouches =
-                (trianglesBinTouches_t*)scratchPad.allocateTempVector("numTrianglesBinTouches", CD_temp_arr_bytes);
-            // Again, no need to bring numActiveBinsForTri to host again, as values not changed
-            pNumActiveBinsForTri = scratchPad.getDualStructDevice("numActiveBinsForTri");
-            cubDEMRunLengthEncode<binID_t, trianglesBinTouches_t>(binIDsEachTriTouches_sorted, activeBinIDsForTri,
-                                                                  numTrianglesBinTouches, pNumActiveBinsForTri,
-                                                                  *pNumBinTriTouchPairs, this_stream, scratchPad);
             pNumActiveBinsForTri = scratchPad.getDualStructHost("numActiveBinsForTri");
             // std::cout << "activeBinIDsForTri: " << std::endl;
             // displayDeviceArray<binID_t>(activeBinIDsForTri, *pNumActiveBinsForTri);
@@ -421,11 +437,10 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // displayDeviceArray<binID_t>(mapTriActBinToSphActBin, *pNumActiveBinsForTri);
 
             // 7th step: scan to find the offsets that are used to index into triIDsEachBinTouches_sorted to obtain
-            // bin-wise triangles. Note binIDsEachTriTouches_sorted can retire.
-            scratchPad.finishUsingTempVector("binIDsEachTriTouches_sorted");
+            // bin-wise triangles.
             CD_temp_arr_bytes = (*pNumActiveBinsForTri) * sizeof(binsTriangleTouchPairs_t);
-            triIDsLookUpTable =
-                (binsTriangleTouchPairs_t*)scratchPad.allocateTempVector("triIDsLookUpTable", CD_temp_arr_bytes);
+            triIDsLookUpTable = (binsTriangleTouchPairs_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_TRI_IDS_LOOK_UP_TABLE, CD_temp_arr_bytes);
             cubDEMPrefixScan<trianglesBinTouches_t, binsTriangleTouchPairs_t>(
                 numTrianglesBinTouches, triIDsLookUpTable, *pNumActiveBinsForTri, this_stream, scratchPad);
         }
@@ -441,8 +456,8 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
         // number of contact in each bin is the same level as the number of spheres in each bin (capped by the same data
         // type).
         CD_temp_arr_bytes = (*pNumActiveBins) * sizeof(binContactPairs_t);
-        binContactPairs_t* numSphContactsInEachBin =
-            (binContactPairs_t*)scratchPad.allocateTempVector("numSphContactsInEachBin", CD_temp_arr_bytes);
+        binContactPairs_t* numSphContactsInEachBin = (binContactPairs_t*)scratchPad.allocateTempVector(
+            SCRATCH_CD_NUM_SPH_CONTACTS_IN_EACH_BIN, CD_temp_arr_bytes);
         size_t blocks_needed_for_bins_sph = *pNumActiveBins;
         // Some quantities and arrays for triangles as well, should we need them
         size_t blocks_needed_for_bins_tri = 0;
@@ -451,17 +466,22 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
         if (simParams->nTriGM > 0) {
             blocks_needed_for_bins_tri = *pNumActiveBinsForTri;
             CD_temp_arr_bytes = (*pNumActiveBinsForTri) * sizeof(binContactPairs_t);
-            numTriSphContactsInEachBin =
-                (binContactPairs_t*)scratchPad.allocateTempVector("numTriSphContactsInEachBin", CD_temp_arr_bytes);
+            numTriSphContactsInEachBin = (binContactPairs_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_NUM_TRI_SPH_CONTACTS_IN_EACH_BIN, CD_temp_arr_bytes);
         }
 
-        if (blocks_needed_for_bins_sph > 0) {
-            sphere_contact_kernels->kernel("getNumberOfSphereContactsEachBin")
-                .instantiate()
-                .configure(dim3(blocks_needed_for_bins_sph), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
-                .launch(&simParams, &granData, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
-                        sphereIDsLookUpTable, numSphContactsInEachBin, *pNumActiveBins);
-            DEME_GPU_CALL_WATCH_BETA(cudaStreamSynchronize(this_stream));
+        // In hierarchical-grid mode, there may be no active bin (see binSpheres), but the spheres still need the grid
+        if (blocks_needed_for_bins_sph > 0 || solverFlags.useHierGridCD) {
+            // In hierarchical-grid mode, the bins are still used for sphere--triangle contacts, but sphere--sphere
+            // contacts are found through the hierarchical grid below
+            if (!solverFlags.useHierGridCD) {
+                sphere_contact_kernels->kernel("getNumberOfSphereContactsEachBin")
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_bins_sph), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                    .launch(&simParams, &granData, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
+                            sphereIDsLookUpTable, numSphContactsInEachBin, *pNumActiveBins);
+                DEME_GPU_CALL_WATCH_BETA(cudaStreamSynchronize(this_stream));
+            }
 
             if (blocks_needed_for_bins_tri > 0) {
                 sphTri_contact_kernels->kernel("getNumberOfSphTriContactsEachBin")
@@ -490,15 +510,17 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // The extra entry is maybe superfluous and is for extra safety, in case the 2 sweeps do not agree with each
             // other.
             CD_temp_arr_bytes = (*pNumActiveBins + 1) * sizeof(contactPairs_t);
-            contactPairs_t* sphSphContactReportOffsets =
-                (contactPairs_t*)scratchPad.allocateTempVector("sphSphContactReportOffsets", CD_temp_arr_bytes);
-            cubDEMPrefixScan<binContactPairs_t, contactPairs_t>(numSphContactsInEachBin, sphSphContactReportOffsets,
-                                                                *pNumActiveBins, this_stream, scratchPad);
+            contactPairs_t* sphSphContactReportOffsets = (contactPairs_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_SPH_SPH_CONTACT_REPORT_OFFSETS, CD_temp_arr_bytes);
+            if (!solverFlags.useHierGridCD) {
+                cubDEMPrefixScan<binContactPairs_t, contactPairs_t>(numSphContactsInEachBin, sphSphContactReportOffsets,
+                                                                    *pNumActiveBins, this_stream, scratchPad);
+            }
             contactPairs_t* triSphContactReportOffsets;
             if (simParams->nTriGM > 0) {
                 CD_temp_arr_bytes = (*pNumActiveBinsForTri + 1) * sizeof(contactPairs_t);
-                triSphContactReportOffsets =
-                    (contactPairs_t*)scratchPad.allocateTempVector("triSphContactReportOffsets", CD_temp_arr_bytes);
+                triSphContactReportOffsets = (contactPairs_t*)scratchPad.allocateTempVector(
+                    SCRATCH_CD_TRI_SPH_CONTACT_REPORT_OFFSETS, CD_temp_arr_bytes);
                 cubDEMPrefixScan<binContactPairs_t, contactPairs_t>(numTriSphContactsInEachBin,
                                                                     triSphContactReportOffsets, *pNumActiveBinsForTri,
                                                                     this_stream, scratchPad);
@@ -510,21 +532,170 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // DEME_DEBUG_PRINTF("Family number:");
             // DEME_DEBUG_EXEC(displayDeviceArray<family_t>(granData->familyID.device(), simParams->nOwnerBodies));
 
+            // Facets of rigid meshes that have local-frame grids were not binned. Their contacts are found by bringing
+            // each sphere into the meshes' frames and looking up the grids instead.
+            contactPairs_t* sphMeshGridReportOffsets;
+            float4* meshGridWorldBounds;
+            size_t nSphMeshGridContact = 0;
+            size_t blocks_needed_for_mesh_grids = 0;
+            if (simParams->nMeshGrids > 0 && simParams->nSpheresGM > 0) {
+                // The grids' world-frame bounds first, so spheres can skip the grids far from them
+                meshGridWorldBounds = (float4*)scratchPad.allocateTempVector(SCRATCH_CD_MESH_GRID_WORLD_BOUNDS,
+                                                                             simParams->nMeshGrids * sizeof(float4));
+                sphTri_contact_kernels->kernel("computeMeshGridWorldBounds")
+                    .instantiate()
+                    .configure(dim3((simParams->nMeshGrids + DEME_KT_CD_NTHREADS_PER_BLOCK - 1) /
+                                    DEME_KT_CD_NTHREADS_PER_BLOCK),
+                               dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                    .launch(&simParams, &granData, meshGridWorldBounds);
+
+                blocks_needed_for_mesh_grids =
+                    (simParams->nSpheresGM + DEME_KT_CD_NTHREADS_PER_BLOCK - 1) / DEME_KT_CD_NTHREADS_PER_BLOCK;
+                CD_temp_arr_bytes = simParams->nSpheresGM * sizeof(binContactPairs_t);
+                binContactPairs_t* numSphMeshGridContacts = (binContactPairs_t*)scratchPad.allocateTempVector(
+                    SCRATCH_CD_NUM_SPH_MESH_GRID_CONTACTS, CD_temp_arr_bytes);
+                sphTri_contact_kernels->kernel("getNumberOfSphMeshGridContacts")
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_mesh_grids), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                    .launch(&simParams, &granData, meshGridWorldBounds, numSphMeshGridContacts, sandwichANode1,
+                            sandwichANode2, sandwichANode3, sandwichBNode1, sandwichBNode2, sandwichBNode3);
+                DEME_GPU_CALL_WATCH_BETA(cudaStreamSynchronize(this_stream));
+
+                CD_temp_arr_bytes = (simParams->nSpheresGM + 1) * sizeof(contactPairs_t);
+                sphMeshGridReportOffsets = (contactPairs_t*)scratchPad.allocateTempVector(
+                    SCRATCH_CD_SPH_MESH_GRID_REPORT_OFFSETS, CD_temp_arr_bytes);
+                cubDEMPrefixScan<binContactPairs_t, contactPairs_t>(numSphMeshGridContacts, sphMeshGridReportOffsets,
+                                                                    simParams->nSpheresGM, this_stream, scratchPad);
+                scratchPad.allocateDualStruct("numSMGContact");
+                deviceAdd<size_t, binContactPairs_t, contactPairs_t>(
+                    scratchPad.getDualStructDevice("numSMGContact"),
+                    &(numSphMeshGridContacts[simParams->nSpheresGM - 1]),
+                    &(sphMeshGridReportOffsets[simParams->nSpheresGM - 1]), this_stream);
+                deviceAssign<contactPairs_t, size_t>(&(sphMeshGridReportOffsets[simParams->nSpheresGM]),
+                                                     scratchPad.getDualStructDevice("numSMGContact"), this_stream);
+                scratchPad.syncDualStructDeviceToHost("numSMGContact");
+                nSphMeshGridContact = *scratchPad.getDualStructHost("numSMGContact");
+                checkScanTotalFitsIndex<contactPairs_t>(nSphMeshGridContact, "sphere--mesh grid contacts");
+                scratchPad.finishUsingDualStruct("numSMGContact");
+            }
+
+            // Sphere--sphere contacts through the hierarchical grid: each sphere is put in one cell of the level that
+            // matches its size, then looks in the cells around it at its own level and the coarser ones
+            size_t blocks_needed_for_hier_grid = 0;
+            uint64_t* hierGridKeys_sorted;
+            bodyID_t* hierGridSphIDs_sorted;
+            double3* hierGridSphPos;
+            float* hierGridSphRadius;
+            contactPairs_t* sphHierGridReportOffsets;
+            double hierGridCellSize0 = 0.;
+            unsigned int nHierGridLevels = 1;
+            size_t nSphHierGridContact = 0;
+            if (solverFlags.useHierGridCD) {
+                const size_t nSph = simParams->nSpheresGM;
+                blocks_needed_for_hier_grid =
+                    (nSph + DEME_KT_CD_NTHREADS_PER_BLOCK - 1) / DEME_KT_CD_NTHREADS_PER_BLOCK;
+                hierGridSphPos =
+                    (double3*)scratchPad.allocateTempVector(SCRATCH_CD_HIER_GRID_SPH_POS, nSph * sizeof(double3));
+                hierGridSphRadius =
+                    (float*)scratchPad.allocateTempVector(SCRATCH_CD_HIER_GRID_SPH_RADIUS, nSph * sizeof(float));
+                sphere_contact_kernels->kernel("computeSphereHierGridInputs")
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_hier_grid), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                    .launch(&simParams, &granData, hierGridSphPos, hierGridSphRadius);
+                DEME_GPU_CALL_WATCH_BETA(cudaStreamSynchronize(this_stream));
+
+                // The levels are decided by the current CD radii, which include the margins
+                scratchPad.allocateDualStruct("hierGridMinRad");
+                scratchPad.allocateDualStruct("hierGridMaxRad");
+                cubDEMMin<float>(hierGridSphRadius, (float*)scratchPad.getDualStructDevice("hierGridMinRad"), nSph,
+                                 this_stream, scratchPad);
+                cubDEMMax<float>(hierGridSphRadius, (float*)scratchPad.getDualStructDevice("hierGridMaxRad"), nSph,
+                                 this_stream, scratchPad);
+                scratchPad.syncDualStructDeviceToHost("hierGridMinRad");
+                scratchPad.syncDualStructDeviceToHost("hierGridMaxRad");
+                // Same little-endian trick as maxGeoInBin
+                const double minRad = *((float*)scratchPad.getDualStructHost("hierGridMinRad"));
+                const double maxRad = *((float*)scratchPad.getDualStructHost("hierGridMaxRad"));
+                scratchPad.finishUsingDualStruct("hierGridMinRad");
+                scratchPad.finishUsingDualStruct("hierGridMaxRad");
+                const double3 worldSize =
+                    make_double3((double)((uint64_t)1 << simParams->nvXp2) * simParams->voxelSize,
+                                 (double)((uint64_t)1 << simParams->nvYp2) * simParams->voxelSize,
+                                 (double)((uint64_t)1 << simParams->nvZp2) * simParams->voxelSize);
+                hierGridCellSize0 = hierGridFitCellSize(worldSize, DEME_MAX(2. * minRad, DEME_TINY_FLOAT));
+                nHierGridLevels = hierGridNumLevels(hierGridCellSize0, maxRad);
+                if (hierGridCellSize0 * (double)((uint64_t)1 << (nHierGridLevels - 1)) < 2. * maxRad) {
+                    DEME_ERROR(
+                        "The size ratio between the largest and the smallest sphere (%.6g) is too large for the "
+                        "hierarchical grid to handle.",
+                        maxRad / minRad);
+                }
+
+                // The sorted keys are used till the end; the unsorted ones are given back once sorted
+                hierGridKeys_sorted =
+                    (uint64_t*)scratchPad.allocateTempVector(SCRATCH_CD_HIER_GRID_KEYS_SORTED, nSph * sizeof(uint64_t));
+                hierGridSphIDs_sorted = (bodyID_t*)scratchPad.allocateTempVector(
+                    SCRATCH_CD_HIER_GRID_SPH_IDS_SORTED, nSph * sizeof(bodyID_t));
+                {
+                    auto key_scope = scratchPad.openScope();
+                    uint64_t* hierGridKeys =
+                        (uint64_t*)scratchPad.allocateTempVector(SCRATCH_CD_HIER_GRID_KEYS, nSph * sizeof(uint64_t));
+                    bodyID_t* hierGridSphIDs =
+                        (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_HIER_GRID_SPH_IDS, nSph * sizeof(bodyID_t));
+                    sphere_contact_kernels->kernel("getSphereHierGridKeys")
+                        .instantiate()
+                        .configure(dim3(blocks_needed_for_hier_grid), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0,
+                                   this_stream)
+                        .launch(&simParams, hierGridSphPos, hierGridSphRadius, hierGridKeys, hierGridSphIDs,
+                                hierGridCellSize0, nHierGridLevels);
+                    DEME_GPU_CALL_WATCH_BETA(cudaStreamSynchronize(this_stream));
+                    cubDEMSortByKeys<uint64_t, bodyID_t>(hierGridKeys, hierGridKeys_sorted, hierGridSphIDs,
+                                                         hierGridSphIDs_sorted, nSph, this_stream, scratchPad);
+                }
+
+                binContactPairs_t* numSphHierGridContacts = (binContactPairs_t*)scratchPad.allocateTempVector(
+                    SCRATCH_CD_NUM_SPH_HIER_GRID_CONTACTS, nSph * sizeof(binContactPairs_t));
+                sphere_contact_kernels->kernel("getNumberOfSphereContactsHierGrid")
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_hier_grid), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                    .launch(&simParams, &granData, hierGridKeys_sorted, hierGridSphIDs_sorted, hierGridSphPos,
+                            hierGridSphRadius, numSphHierGridContacts, hierGridCellSize0, nHierGridLevels);
+                DEME_GPU_CALL_WATCH_BETA(cudaStreamSynchronize(this_stream));
+
+                sphHierGridReportOffsets = (contactPairs_t*)scratchPad.allocateTempVector(
+                    SCRATCH_CD_SPH_HIER_GRID_REPORT_OFFSETS, (nSph + 1) * sizeof(contactPairs_t));
+                cubDEMPrefixScan<binContactPairs_t, contactPairs_t>(numSphHierGridContacts, sphHierGridReportOffsets,
+                                                                    nSph, this_stream, scratchPad);
+                scratchPad.allocateDualStruct("numSHGContact");
+                deviceAdd<size_t, binContactPairs_t, contactPairs_t>(
+                    scratchPad.getDualStructDevice("numSHGContact"), &(numSphHierGridContacts[nSph - 1]),
+                    &(sphHierGridReportOffsets[nSph - 1]), this_stream);
+                deviceAssign<contactPairs_t, size_t>(&(sphHierGridReportOffsets[nSph]),
+                                                     scratchPad.getDualStructDevice("numSHGContact"), this_stream);
+                scratchPad.syncDualStructDeviceToHost("numSHGContact");
+                nSphHierGridContact = *scratchPad.getDualStructHost("numSHGContact");
+                checkScanTotalFitsIndex<contactPairs_t>(nSphHierGridContact, "sphere--sphere contacts");
+                scratchPad.finishUsingDualStruct("numSHGContact");
+            }
+
             // Add sphere--sphere contacts together with sphere--analytical geometry contacts
             size_t nSphereGeoContact = *scratchPad.numContacts;
-            size_t nSphereSphereContact = 0, nTriSphereContact = 0;
+            size_t nSphereSphereContact = nSphHierGridContact, nTriSphereContact = 0;
             {
-                scratchPad.allocateDualStruct("numSSContact");
-                deviceAdd<size_t, binContactPairs_t, contactPairs_t>(
-                    scratchPad.getDualStructDevice("numSSContact"), &(numSphContactsInEachBin[*pNumActiveBins - 1]),
-                    &(sphSphContactReportOffsets[*pNumActiveBins - 1]), this_stream);
-                deviceAssign<contactPairs_t, size_t>(&(sphSphContactReportOffsets[*pNumActiveBins]),
-                                                     scratchPad.getDualStructDevice("numSSContact"), this_stream);
-                scratchPad.syncDualStructDeviceToHost("numSSContact");
-                nSphereSphereContact = *scratchPad.getDualStructHost("numSSContact");
-                scratchPad.finishUsingDualStruct("numSSContact");
-
-                if (simParams->nTriGM > 0) {
+                if (!solverFlags.useHierGridCD) {
+                    scratchPad.allocateDualStruct("numSSContact");
+                    deviceAdd<size_t, binContactPairs_t, contactPairs_t>(
+                        scratchPad.getDualStructDevice("numSSContact"), &(numSphContactsInEachBin[*pNumActiveBins - 1]),
+                        &(sphSphContactReportOffsets[*pNumActiveBins - 1]), this_stream);
+                    deviceAssign<contactPairs_t, size_t>(&(sphSphContactReportOffsets[*pNumActiveBins]),
+                                                         scratchPad.getDualStructDevice("numSSContact"), this_stream);
+                    scratchPad.syncDualStructDeviceToHost("numSSContact");
+                    nSphereSphereContact = *scratchPad.getDualStructHost("numSSContact");
+                    checkScanTotalFitsIndex<contactPairs_t>(nSphereSphereContact, "sphere--sphere contacts");
+                    scratchPad.finishUsingDualStruct("numSSContact");
+                }
+                // If all facets are in local-frame grids, then there is no active bin for triangles
+                if (simParams->nTriGM > 0 && *pNumActiveBinsForTri > 0) {
                     scratchPad.allocateDualStruct("numSMContact");
                     deviceAdd<size_t, binContactPairs_t, contactPairs_t>(
                         scratchPad.getDualStructDevice("numSMContact"),
@@ -534,13 +705,18 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                                                          scratchPad.getDualStructDevice("numSMContact"), this_stream);
                     scratchPad.syncDualStructDeviceToHost("numSMContact");
                     nTriSphereContact = *scratchPad.getDualStructHost("numSMContact");
+                    checkScanTotalFitsIndex<contactPairs_t>(nTriSphereContact, "triangle--sphere contacts");
                     scratchPad.finishUsingDualStruct("numSMContact");
                 }
                 // std::cout << "nSphereGeoContact: " << nSphereGeoContact << std::endl;
                 // std::cout << "nSphereSphereContact: " << nSphereSphereContact << std::endl;
             }
 
-            *scratchPad.numContacts = nSphereSphereContact + nSphereGeoContact + nTriSphereContact;
+            *scratchPad.numContacts =
+                nSphereSphereContact + nSphereGeoContact + nTriSphereContact + nSphMeshGridContact;
+            if (!IndexCountFits<contactPairs_t>(*scratchPad.numContacts)) {
+                DEME_ERROR("%s", IndexOverflowMessage<contactPairs_t>("contacts", *scratchPad.numContacts).c_str());
+            }
             if (*scratchPad.numContacts > idGeometryA.size()) {
                 contactEventArraysResize(*scratchPad.numContacts, idGeometryA, idGeometryB, contactType, granData);
             }
@@ -550,12 +726,22 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             bodyID_t* idSphB = (granData->idGeometryB + nSphereGeoContact);
             contact_t* dType = (granData->contactType + nSphereGeoContact);
             // Then fill in those contacts
-            sphere_contact_kernels->kernel("populateSphSphContactPairsEachBin")
-                .instantiate()
-                .configure(dim3(blocks_needed_for_bins_sph), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
-                .launch(&simParams, &granData, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
-                        sphereIDsLookUpTable, sphSphContactReportOffsets, idSphA, idSphB, dType, *pNumActiveBins);
-            DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+            if (solverFlags.useHierGridCD) {
+                sphere_contact_kernels->kernel("populateSphSphContactPairsHierGrid")
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_hier_grid), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                    .launch(&simParams, &granData, hierGridKeys_sorted, hierGridSphIDs_sorted, hierGridSphPos,
+                            hierGridSphRadius, sphHierGridReportOffsets, idSphA, idSphB, dType, hierGridCellSize0,
+                            nHierGridLevels);
+                DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+            } else {
+                sphere_contact_kernels->kernel("populateSphSphContactPairsEachBin")
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_bins_sph), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                    .launch(&simParams, &granData, sphereIDsEachBinTouches_sorted, activeBinIDs, numSpheresBinTouches,
+                            sphereIDsLookUpTable, sphSphContactReportOffsets, idSphA, idSphB, dType, *pNumActiveBins);
+                DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+            }
 
             // Triangle--sphere contact pairs go after sphere--sphere contacts. Remember to mark their type.
             if (blocks_needed_for_bins_tri > 0) {
@@ -576,36 +762,43 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                 // displayDeviceArray<bodyID_t>(granData->idGeometryB, *scratchPad.numContacts);
                 // displayDeviceArray<contact_t>(granData->contactType, *scratchPad.numContacts);
             }
+
+            // Then the sphere--facet contacts found through local-frame grids
+            if (blocks_needed_for_mesh_grids > 0) {
+                size_t offset = nSphereGeoContact + nSphereSphereContact + nTriSphereContact;
+                idSphA = (granData->idGeometryA + offset);
+                bodyID_t* idTriB = (granData->idGeometryB + offset);
+                dType = (granData->contactType + offset);
+                sphTri_contact_kernels->kernel("populateSphMeshGridContacts")
+                    .instantiate()
+                    .configure(dim3(blocks_needed_for_mesh_grids), dim3(DEME_KT_CD_NTHREADS_PER_BLOCK), 0, this_stream)
+                    .launch(&simParams, &granData, meshGridWorldBounds, sphMeshGridReportOffsets, idSphA, idTriB,
+                            dType, sandwichANode1, sandwichANode2, sandwichANode3, sandwichBNode1, sandwichBNode2,
+                            sandwichBNode3);
+                DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+            }
         }  // End of bin-wise contact detection subroutine
 
-        // The following vectors are used till the end
-        scratchPad.finishUsingTempVector("sphereIDsEachBinTouches_sorted");
+        // The following dual arrays are used till the end
         scratchPad.finishUsingDualArray("activeBinIDs");
-        scratchPad.finishUsingTempVector("numSpheresBinTouches");
-        scratchPad.finishUsingTempVector("sphereIDsLookUpTable");
-        scratchPad.finishUsingTempVector("sandwichANode1");
-        scratchPad.finishUsingTempVector("sandwichBNode1");
-        scratchPad.finishUsingTempVector("triIDsEachBinTouches_sorted");
         scratchPad.finishUsingDualArray("activeBinIDsForTri");
-        scratchPad.finishUsingTempVector("numTrianglesBinTouches");
         scratchPad.finishUsingDualArray("mapTriActBinToSphActBin");
-        scratchPad.finishUsingTempVector("triIDsLookUpTable");
-        scratchPad.finishUsingTempVector("numSphContactsInEachBin");
-        scratchPad.finishUsingTempVector("numTriSphContactsInEachBin");
-        scratchPad.finishUsingTempVector("sphSphContactReportOffsets");
-        scratchPad.finishUsingTempVector("triSphContactReportOffsets");
 
         scratchPad.finishUsingDualStruct("numActiveBins");
         scratchPad.finishUsingDualStruct("numActiveBinsForTri");
+    }
 
+    {
         // There is in fact one more task: If the user specified persistent contacts, we check the previous contact list
         // and see if there are some contacts we need to add to the current list. Even if we detected 0 contacts, we
         // might still have persistent contacts to add to the list.
         // Also at this point, all temp arrays are freed now.
         if (solverFlags.hasPersistentContacts && !solverFlags.isHistoryless) {
+            auto persist_scope = scratchPad.openScope();
             // A bool array to help find what persistent contacts from the prev array need to be processed...
             size_t flag_arr_bytes = (*scratchPad.numPrevContacts) * sizeof(notStupidBool_t);
-            notStupidBool_t* grab_flags = (notStupidBool_t*)scratchPad.allocateTempVector("grab_flags", flag_arr_bytes);
+            notStupidBool_t* grab_flags =
+                (notStupidBool_t*)scratchPad.allocateTempVector(SCRATCH_CD_GRAB_FLAGS, flag_arr_bytes);
             size_t blocks_needed_for_flagging =
                 (*scratchPad.numPrevContacts + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
             if (blocks_needed_for_flagging > 0) {
@@ -623,10 +816,12 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // This many elements are sufficient, at very least...
             size_t selected_ids_bytes = (*scratchPad.numPrevContacts) * sizeof(bodyID_t);
             size_t selected_types_bytes = (*scratchPad.numPrevContacts) * sizeof(contact_t);
-            bodyID_t* selected_idA = (bodyID_t*)scratchPad.allocateTempVector("selected_idA", selected_ids_bytes);
-            bodyID_t* selected_idB = (bodyID_t*)scratchPad.allocateTempVector("selected_idB", selected_ids_bytes);
+            bodyID_t* selected_idA =
+                (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_SELECTED_ID_A, selected_ids_bytes);
+            bodyID_t* selected_idB =
+                (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_SELECTED_ID_B, selected_ids_bytes);
             contact_t* selected_types =
-                (contact_t*)scratchPad.allocateTempVector("selected_types", selected_types_bytes);
+                (contact_t*)scratchPad.allocateTempVector(SCRATCH_CD_SELECTED_TYPES, selected_types_bytes);
 
             cubDEMSelectFlagged<bodyID_t, notStupidBool_t>(granData->previous_idGeometryA, selected_idA, grab_flags,
                                                            scratchPad.getDualStructDevice("numPersistCnts"),
@@ -647,11 +842,12 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             size_t total_persistency_bytes = (*scratchPad.numContacts + *pNumPersistCnts) * sizeof(notStupidBool_t);
             selected_ids_bytes = (*pNumPersistCnts) * sizeof(bodyID_t);
             selected_types_bytes = (*pNumPersistCnts) * sizeof(contact_t);
-            bodyID_t* total_idA = (bodyID_t*)scratchPad.allocateTempVector("total_idA", total_ids_bytes);
-            bodyID_t* total_idB = (bodyID_t*)scratchPad.allocateTempVector("total_idB", total_ids_bytes);
-            contact_t* total_types = (contact_t*)scratchPad.allocateTempVector("total_types", total_types_bytes);
+            bodyID_t* total_idA = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_TOTAL_ID_A, total_ids_bytes);
+            bodyID_t* total_idB = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_TOTAL_ID_B, total_ids_bytes);
+            contact_t* total_types =
+                (contact_t*)scratchPad.allocateTempVector(SCRATCH_CD_TOTAL_TYPES, total_types_bytes);
             notStupidBool_t* total_persistency =
-                (notStupidBool_t*)scratchPad.allocateTempVector("total_persistency", total_persistency_bytes);
+                (notStupidBool_t*)scratchPad.allocateTempVector(SCRATCH_CD_TOTAL_PERSISTENCY, total_persistency_bytes);
             DEME_GPU_CALL(cudaMemcpy(total_idA, selected_idA, selected_ids_bytes, cudaMemcpyDeviceToDevice));
             DEME_GPU_CALL(cudaMemcpy(total_idA + *pNumPersistCnts, granData->idGeometryA,
                                      total_ids_bytes - selected_ids_bytes, cudaMemcpyDeviceToDevice));
@@ -672,20 +868,16 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                     .launch(total_persistency, *pNumPersistCnts, CONTACT_IS_PERSISTENT);
                 DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
             }
-            scratchPad.finishUsingTempVector("grab_flags");
-            scratchPad.finishUsingTempVector("selected_idA");
-            scratchPad.finishUsingTempVector("selected_idB");
-            scratchPad.finishUsingTempVector("selected_types");
 
             // Then remove potential redundency in the current contact array.
             // To do that, we sort by idA...
             size_t numTotalCnts = *scratchPad.numContacts + *pNumPersistCnts;
             contact_t* contactType_sorted =
-                (contact_t*)scratchPad.allocateTempVector("contactType_sorted", total_types_bytes);
-            bodyID_t* idA_sorted = (bodyID_t*)scratchPad.allocateTempVector("idA_sorted", total_ids_bytes);
-            bodyID_t* idB_sorted = (bodyID_t*)scratchPad.allocateTempVector("idB_sorted", total_ids_bytes);
+                (contact_t*)scratchPad.allocateTempVector(SCRATCH_CD_CONTACT_TYPE_SORTED, total_types_bytes);
+            bodyID_t* idA_sorted = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_A_SORTED, total_ids_bytes);
+            bodyID_t* idB_sorted = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_B_SORTED, total_ids_bytes);
             notStupidBool_t* persistency_sorted =
-                (notStupidBool_t*)scratchPad.allocateTempVector("persistency_sorted", total_persistency_bytes);
+                (notStupidBool_t*)scratchPad.allocateTempVector(SCRATCH_CD_PERSISTENCY_SORTED, total_persistency_bytes);
             //// TODO: But do I have to SortByKey three times?? Can I zip these value arrays together??
             // Although it is stupid, do pay attention to that it does leverage the fact that RadixSort is stable.
             cubDEMSortByKeys<bodyID_t, bodyID_t>(total_idA, idA_sorted, total_idB, idB_sorted, numTotalCnts,
@@ -699,18 +891,14 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // displayDeviceArray<bodyID_t>(idB_sorted, numTotalCnts);
             // displayDeviceArray<contact_t>(contactType_sorted, numTotalCnts);
             // displayDeviceArray<notStupidBool_t>(persistency_sorted, numTotalCnts);
-            scratchPad.finishUsingTempVector("total_idA");
-            scratchPad.finishUsingTempVector("total_idB");
-            scratchPad.finishUsingTempVector("total_types");
-            scratchPad.finishUsingTempVector("total_persistency");
             scratchPad.finishUsingDualStruct("numPersistCnts");
 
             // Then we run-length it...
             size_t run_length_bytes = simParams->nSpheresGM * sizeof(geoSphereTouches_t);
             geoSphereTouches_t* idA_runlength =
-                (geoSphereTouches_t*)scratchPad.allocateTempVector("idA_runlength", run_length_bytes);
+                (geoSphereTouches_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_A_RUNLENGTH, run_length_bytes);
             size_t unique_id_bytes = simParams->nSpheresGM * sizeof(bodyID_t);
-            bodyID_t* unique_idA = (bodyID_t*)scratchPad.allocateTempVector("unique_idA", unique_id_bytes);
+            bodyID_t* unique_idA = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_UNIQUE_ID_A, unique_id_bytes);
             scratchPad.allocateDualStruct("numUniqueA");
             cubDEMRunLengthEncode<bodyID_t, geoSphereTouches_t>(idA_sorted, unique_idA, idA_runlength,
                                                                 scratchPad.getDualStructDevice("numUniqueA"),
@@ -718,15 +906,15 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             scratchPad.syncDualStructDeviceToHost("numUniqueA");
             size_t* pNumUniqueA = scratchPad.getDualStructHost("numUniqueA");
             size_t scanned_runlength_bytes = (*pNumUniqueA) * sizeof(contactPairs_t);
-            contactPairs_t* idA_scanned_runlength =
-                (contactPairs_t*)scratchPad.allocateTempVector("idA_scanned_runlength", scanned_runlength_bytes);
+            contactPairs_t* idA_scanned_runlength = (contactPairs_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_ID_A_SCANNED_RUNLENGTH, scanned_runlength_bytes);
             cubDEMPrefixScan<geoSphereTouches_t, contactPairs_t>(idA_runlength, idA_scanned_runlength, *pNumUniqueA,
                                                                  this_stream, scratchPad);
 
             // Then each thread will take care of an id in A to mark redundency...
             size_t retain_flags_size = (numTotalCnts) * sizeof(notStupidBool_t);
             notStupidBool_t* retain_flags =
-                (notStupidBool_t*)scratchPad.allocateTempVector("retain_flags", retain_flags_size);
+                (notStupidBool_t*)scratchPad.allocateTempVector(SCRATCH_CD_RETAIN_FLAGS, retain_flags_size);
             blocks_needed_for_setting_1 = (numTotalCnts + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
             if (blocks_needed_for_setting_1 > 0) {
                 history_kernels->kernel("setArr")
@@ -789,16 +977,6 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // And update the number of contacts.
             *scratchPad.numContacts = *pNumRetainedCnts;
             scratchPad.finishUsingDualStruct("numRetainedCnts");
-
-            // Unclaim all temp vectors
-            scratchPad.finishUsingTempVector("idA_runlength");
-            scratchPad.finishUsingTempVector("unique_idA");
-            scratchPad.finishUsingTempVector("idA_scanned_runlength");
-            scratchPad.finishUsingTempVector("contactType_sorted");
-            scratchPad.finishUsingTempVector("idA_sorted");
-            scratchPad.finishUsingTempVector("idB_sorted");
-            scratchPad.finishUsingTempVector("persistency_sorted");
-            scratchPad.finishUsingTempVector("retain_flags");
         }
 
         timers.GetTimer("Find contact pairs").stop();
@@ -812,16 +990,18 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
     // Now, sort idGeometryAB by their owners. Needed for identifying enduring contacts in history-based models.
     if (*scratchPad.numContacts > 0) {
         // All temp vectors are free now...
+        auto map_scope = scratchPad.openScope();
         // Note that if it hasPersistentContacts, idAB and types are already sorted based on idA, so there is no need to
         // do that again.
         size_t type_arr_bytes = (*scratchPad.numContacts) * sizeof(contact_t);
 
         size_t id_arr_bytes = (*scratchPad.numContacts) * sizeof(bodyID_t);
         if (!solverFlags.hasPersistentContacts) {
+            auto sort_scope = scratchPad.openScope();
             contact_t* contactType_sorted =
-                (contact_t*)scratchPad.allocateTempVector("contactType_sorted", type_arr_bytes);
-            bodyID_t* idA_sorted = (bodyID_t*)scratchPad.allocateTempVector("idA_sorted", id_arr_bytes);
-            bodyID_t* idB_sorted = (bodyID_t*)scratchPad.allocateTempVector("idB_sorted", id_arr_bytes);
+                (contact_t*)scratchPad.allocateTempVector(SCRATCH_CD_CONTACT_TYPE_SORTED, type_arr_bytes);
+            bodyID_t* idA_sorted = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_A_SORTED, id_arr_bytes);
+            bodyID_t* idB_sorted = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_B_SORTED, id_arr_bytes);
 
             //// TODO: But do I have to SortByKey two times?? Can I zip these value arrays together??
             // Although it is stupid, do pay attention to that it does leverage the fact that RadixSort is stable.
@@ -835,10 +1015,6 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             DEME_GPU_CALL(cudaMemcpy(granData->idGeometryB, idB_sorted, id_arr_bytes, cudaMemcpyDeviceToDevice));
             DEME_GPU_CALL(
                 cudaMemcpy(granData->contactType, contactType_sorted, type_arr_bytes, cudaMemcpyDeviceToDevice));
-            // Short-lifespan vectors can now be freed
-            scratchPad.finishUsingTempVector("contactType_sorted");
-            scratchPad.finishUsingTempVector("idA_sorted");
-            scratchPad.finishUsingTempVector("idB_sorted");
         }
         // DEME_DEBUG_PRINTF("New contact IDs (A):");
         // DEME_DEBUG_EXEC(displayDeviceArray<bodyID_t>(granData->idGeometryA, *scratchPad.numContacts));
@@ -863,9 +1039,10 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
         // First, identify the new and old idA run-length
         size_t run_length_bytes = nSpheresSafe * sizeof(geoSphereTouches_t);
         geoSphereTouches_t* new_idA_runlength =
-            (geoSphereTouches_t*)scratchPad.allocateTempVector("new_idA_runlength", run_length_bytes);
+            (geoSphereTouches_t*)scratchPad.allocateTempVector(SCRATCH_CD_NEW_ID_A_RUNLENGTH, run_length_bytes);
         size_t unique_id_bytes = nSpheresSafe * sizeof(bodyID_t);
-        bodyID_t* unique_new_idA = (bodyID_t*)scratchPad.allocateTempVector("unique_new_idA", unique_id_bytes);
+        bodyID_t* unique_new_idA =
+            (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_UNIQUE_NEW_ID_A, unique_id_bytes);
         scratchPad.allocateDualStruct("numUniqueNewA");
         cubDEMRunLengthEncode<bodyID_t, geoSphereTouches_t>(granData->idGeometryA, unique_new_idA, new_idA_runlength,
                                                             scratchPad.getDualStructDevice("numUniqueNewA"),
@@ -894,9 +1071,11 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
 
         // Only need to proceed if history-based
         if (!solverFlags.isHistoryless) {
+            auto history_scope = scratchPad.openScope();
             geoSphereTouches_t* old_idA_runlength =
-                (geoSphereTouches_t*)scratchPad.allocateTempVector("old_idA_runlength", run_length_bytes);
-            bodyID_t* unique_old_idA = (bodyID_t*)scratchPad.allocateTempVector("unique_old_idA", unique_id_bytes);
+                (geoSphereTouches_t*)scratchPad.allocateTempVector(SCRATCH_CD_OLD_ID_A_RUNLENGTH, run_length_bytes);
+            bodyID_t* unique_old_idA =
+                (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_UNIQUE_OLD_ID_A, unique_id_bytes);
             scratchPad.allocateDualStruct("numUniqueOldA");
             cubDEMRunLengthEncode<bodyID_t, geoSphereTouches_t>(granData->previous_idGeometryA, unique_old_idA,
                                                                 old_idA_runlength,
@@ -906,10 +1085,10 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             size_t* pNumUniqueOldA = scratchPad.getDualStructHost("numUniqueOldA");
             // Then, add zeros to run-length arrays such that even if a sphereID is not present in idA, it has a
             // place in the run-length arrays that indicates 0 run-length
-            geoSphereTouches_t* new_idA_runlength_full =
-                (geoSphereTouches_t*)scratchPad.allocateTempVector("new_idA_runlength_full", run_length_bytes);
-            geoSphereTouches_t* old_idA_runlength_full =
-                (geoSphereTouches_t*)scratchPad.allocateTempVector("old_idA_runlength_full", run_length_bytes);
+            geoSphereTouches_t* new_idA_runlength_full = (geoSphereTouches_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_NEW_ID_A_RUNLENGTH_FULL, run_length_bytes);
+            geoSphereTouches_t* old_idA_runlength_full = (geoSphereTouches_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_OLD_ID_A_RUNLENGTH_FULL, run_length_bytes);
             DEME_GPU_CALL(cudaMemset((void*)new_idA_runlength_full, 0, run_length_bytes));
             DEME_GPU_CALL(cudaMemset((void*)old_idA_runlength_full, 0, run_length_bytes));
             size_t blocks_needed_for_mapping =
@@ -934,16 +1113,14 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // DEME_DEBUG_EXEC(displayDeviceArray<bodyID_t>(unique_new_idA, *pNumUniqueNewA));
             // DEME_DEBUG_PRINTF("Unique contacts run-length:");
             // DEME_DEBUG_EXEC(displayDeviceArray<geoSphereTouches_t>(new_idA_runlength, *pNumUniqueNewA));
-            scratchPad.finishUsingTempVector("old_idA_runlength");
-            scratchPad.finishUsingTempVector("unique_old_idA");
             scratchPad.finishUsingDualStruct("numUniqueOldA");
 
             // Then, prescan to find run-length offsets, in preparation for custom kernels
             size_t scanned_runlength_bytes = nSpheresSafe * sizeof(contactPairs_t);
-            contactPairs_t* new_idA_scanned_runlength =
-                (contactPairs_t*)scratchPad.allocateTempVector("new_idA_scanned_runlength", scanned_runlength_bytes);
-            contactPairs_t* old_idA_scanned_runlength =
-                (contactPairs_t*)scratchPad.allocateTempVector("old_idA_scanned_runlength", scanned_runlength_bytes);
+            contactPairs_t* new_idA_scanned_runlength = (contactPairs_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_NEW_ID_A_SCANNED_RUNLENGTH, scanned_runlength_bytes);
+            contactPairs_t* old_idA_scanned_runlength = (contactPairs_t*)scratchPad.allocateTempVector(
+                SCRATCH_CD_OLD_ID_A_SCANNED_RUNLENGTH, scanned_runlength_bytes);
             cubDEMPrefixScan<geoSphereTouches_t, contactPairs_t>(new_idA_runlength_full, new_idA_scanned_runlength,
                                                                  nSpheresSafe, this_stream, scratchPad);
             cubDEMPrefixScan<geoSphereTouches_t, contactPairs_t>(old_idA_runlength_full, old_idA_scanned_runlength,
@@ -968,19 +1145,16 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
             // DEME_DEBUG_PRINTF("Contact mapping:");
             // DEME_DEBUG_EXEC(displayDeviceArray<contactPairs_t>(granData->contactMapping,
             // *scratchPad.numContacts));
-            scratchPad.finishUsingTempVector("new_idA_runlength_full");
-            scratchPad.finishUsingTempVector("old_idA_runlength_full");
-            scratchPad.finishUsingTempVector("new_idA_scanned_runlength");
-            scratchPad.finishUsingTempVector("old_idA_scanned_runlength");
 
             // One thing we need to do before storing the old contact pairs: figure out how it is mapped to the actually
             // shipped contact pair array.
             contactPairs_t* old_arr_unsort_to_sort_map;
             if (solverFlags.should_sort_pairs) {
                 size_t map_arr_bytes = (*scratchPad.numPrevContacts) * sizeof(contactPairs_t);
-                old_arr_unsort_to_sort_map =
-                    (contactPairs_t*)scratchPad.allocateTempVector("old_arr_unsort_to_sort_map", map_arr_bytes);
-                contactPairs_t* one_to_n = (contactPairs_t*)scratchPad.allocateTempVector("one_to_n", map_arr_bytes);
+                old_arr_unsort_to_sort_map = (contactPairs_t*)scratchPad.allocateTempVector(
+                    SCRATCH_CD_OLD_ARR_UNSORT_TO_SORT_MAP, map_arr_bytes);
+                contactPairs_t* one_to_n =
+                    (contactPairs_t*)scratchPad.allocateTempVector(SCRATCH_CD_ONE_TO_N, map_arr_bytes);
                 size_t blocks_needed_for_mapping =
                     (*scratchPad.numPrevContacts + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
                 if (blocks_needed_for_mapping > 0) {
@@ -990,8 +1164,9 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                         .launch(one_to_n, *scratchPad.numPrevContacts);
                     DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
 
+                    auto type_scope = scratchPad.openScope();
                     contact_t* old_contactType_sorted = (contact_t*)scratchPad.allocateTempVector(
-                        "old_contactType_sorted", (*scratchPad.numPrevContacts) * sizeof(contact_t));
+                        SCRATCH_CD_OLD_CONTACT_TYPE_SORTED, (*scratchPad.numPrevContacts) * sizeof(contact_t));
                     // Sorted by type is how we shipped the old contact pair info
                     cubDEMSortByKeys<contact_t, contactPairs_t>(granData->previous_contactType, old_contactType_sorted,
                                                                 one_to_n, old_arr_unsort_to_sort_map,
@@ -1005,10 +1180,8 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                 }
                 // one_to_n used for temp storage; now give it back to the true mapping we wanted.
                 // So here, old_arr_unsort_to_sort_map's memory space is not needed anymore, but one_to_n must still
-                // live, a little nuance to pay attention to. However, alas, we can always just delay memory freeing
-                // and do it all at the very end: this is exactly what I did here.
+                // live, a little nuance to pay attention to. Both are given back when the history scope closes.
                 old_arr_unsort_to_sort_map = one_to_n;
-                scratchPad.finishUsingTempVector("old_contactType_sorted");
             }
 
             // Finally, copy new contact array to old contact array for the record. Note we register old contact pairs
@@ -1031,15 +1204,16 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
 
             // dT potentially benefits from type-sorted contact array
             if (solverFlags.should_sort_pairs) {
+                auto sort_scope = scratchPad.openScope();
                 size_t type_arr_bytes = (*scratchPad.numContacts) * sizeof(contact_t);
                 contact_t* contactType_sorted =
-                    (contact_t*)scratchPad.allocateTempVector("contactType_sorted", type_arr_bytes);
+                    (contact_t*)scratchPad.allocateTempVector(SCRATCH_CD_CONTACT_TYPE_SORTED, type_arr_bytes);
                 size_t id_arr_bytes = (*scratchPad.numContacts) * sizeof(bodyID_t);
-                bodyID_t* idA_sorted = (bodyID_t*)scratchPad.allocateTempVector("idA_sorted", id_arr_bytes);
-                bodyID_t* idB_sorted = (bodyID_t*)scratchPad.allocateTempVector("idB_sorted", id_arr_bytes);
+                bodyID_t* idA_sorted = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_A_SORTED, id_arr_bytes);
+                bodyID_t* idB_sorted = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_B_SORTED, id_arr_bytes);
                 size_t cnt_arr_bytes = (*scratchPad.numContacts) * sizeof(contactPairs_t);
                 contactPairs_t* map_sorted =
-                    (contactPairs_t*)scratchPad.allocateTempVector("map_sorted", cnt_arr_bytes);
+                    (contactPairs_t*)scratchPad.allocateTempVector(SCRATCH_CD_MAP_SORTED, cnt_arr_bytes);
 
                 //// TODO: But do I have to SortByKey three times?? Can I zip these value arrays together??
                 cubDEMSortByKeys<contact_t, bodyID_t>(granData->contactType, contactType_sorted, granData->idGeometryB,
@@ -1069,19 +1243,16 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                 DEME_GPU_CALL(
                     cudaMemcpy(granData->contactMapping, map_sorted, cnt_arr_bytes, cudaMemcpyDeviceToDevice));
 
-                scratchPad.finishUsingTempVector("contactType_sorted");
-                scratchPad.finishUsingTempVector("idA_sorted");
-                scratchPad.finishUsingTempVector("idB_sorted");
-                scratchPad.finishUsingTempVector("map_sorted");
             }
         } else {  // If historyless, might still want to sort based on type
             if (solverFlags.should_sort_pairs) {
+                auto sort_scope = scratchPad.openScope();
                 size_t type_arr_bytes = (*scratchPad.numContacts) * sizeof(contact_t);
                 contact_t* contactType_sorted =
-                    (contact_t*)scratchPad.allocateTempVector("contactType_sorted", type_arr_bytes);
+                    (contact_t*)scratchPad.allocateTempVector(SCRATCH_CD_CONTACT_TYPE_SORTED, type_arr_bytes);
                 size_t id_arr_bytes = (*scratchPad.numContacts) * sizeof(bodyID_t);
-                bodyID_t* idA_sorted = (bodyID_t*)scratchPad.allocateTempVector("idA_sorted", id_arr_bytes);
-                bodyID_t* idB_sorted = (bodyID_t*)scratchPad.allocateTempVector("idB_sorted", id_arr_bytes);
+                bodyID_t* idA_sorted = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_A_SORTED, id_arr_bytes);
+                bodyID_t* idB_sorted = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_B_SORTED, id_arr_bytes);
 
                 cubDEMSortByKeys<contact_t, bodyID_t>(granData->contactType, contactType_sorted, granData->idGeometryB,
                                                       idB_sorted, *scratchPad.numContacts, this_stream, scratchPad);
@@ -1093,20 +1264,9 @@ void contactDetection(std::shared_ptr<jitify::Program>& bin_sphere_kernels,
                 DEME_GPU_CALL(cudaMemcpy(granData->idGeometryB, idB_sorted, id_arr_bytes, cudaMemcpyDeviceToDevice));
                 DEME_GPU_CALL(
                     cudaMemcpy(granData->contactType, contactType_sorted, type_arr_bytes, cudaMemcpyDeviceToDevice));
-                scratchPad.finishUsingTempVector("contactType_sorted");
-                scratchPad.finishUsingTempVector("idA_sorted");
-                scratchPad.finishUsingTempVector("idB_sorted");
             }
         }
-        // This part is light on memory, so we can delay some freeing
-        scratchPad.finishUsingTempVector("new_idA_runlength");
-        scratchPad.finishUsingTempVector("unique_new_idA");
         scratchPad.finishUsingDualStruct("numUniqueNewA");
-        // Note one_to_n corresponds to the pointer name old_arr_unsort_to_sort_map, an exception to general "matched"
-        // naming convension. But we delayed their freeing, so you see them both freed here.
-        scratchPad.finishUsingTempVector("one_to_n");
-        scratchPad.finishUsingTempVector("old_arr_unsort_to_sort_map");
-
     }  // End of contact sorting--mapping subroutine
     timers.GetTimer("Build history map").stop();
 
@@ -1147,9 +1307,10 @@ void overwritePrevContactArrays(DualStruct<DEMDataKT>& kT_data,
     }
 
     // Copy to temp array for easier usage
-    bodyID_t* idA = (bodyID_t*)scratchPad.allocateTempVector("idA", nContacts * sizeof(bodyID_t));
-    bodyID_t* idB = (bodyID_t*)scratchPad.allocateTempVector("idB", nContacts * sizeof(bodyID_t));
-    contact_t* cType = (contact_t*)scratchPad.allocateTempVector("cType", nContacts * sizeof(contact_t));
+    auto scope = scratchPad.openScope();
+    bodyID_t* idA = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_A, nContacts * sizeof(bodyID_t));
+    bodyID_t* idB = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_CD_ID_B, nContacts * sizeof(bodyID_t));
+    contact_t* cType = (contact_t*)scratchPad.allocateTempVector(SCRATCH_CD_TYPES, nContacts * sizeof(contact_t));
     DEME_GPU_CALL(cudaMemcpy(idA, dT_data->idGeometryA, nContacts * sizeof(bodyID_t), cudaMemcpyDeviceToDevice));
     DEME_GPU_CALL(cudaMemcpy(idB, dT_data->idGeometryB, nContacts * sizeof(bodyID_t), cudaMemcpyDeviceToDevice));
     DEME_GPU_CALL(cudaMemcpy(cType, dT_data->contactType, nContacts * sizeof(contact_t), cudaMemcpyDeviceToDevice));
@@ -1182,13 +1343,6 @@ void overwritePrevContactArrays(DualStruct<DEMDataKT>& kT_data,
     // dT kT may send these numbers to each other from device
     scratchPad.numPrevContacts.toDevice();
     scratchPad.numPrevSpheres.toDevice();
-
-    scratchPad.finishUsingTempVector("idA");
-    scratchPad.finishUsingTempVector("idB");
-    scratchPad.finishUsingTempVector("cType");
-    // scratchPad.finishUsingTempVector("idA_sorted");
-    // scratchPad.finishUsingTempVector("idB_sorted");
-    // scratchPad.finishUsingTempVector("cType_sorted");
 }
 
 }  // namespace deme
@@ -65,20 +65,23 @@ void collectContactForcesThruCub(std::shared_ptr<jitify::Program>& collect_force
 
     // ==============================================
     // 2nd, combine mass and force to get (contact pair-wise) acceleration, which will be reduced...
-    // Note here allocated is temp vector, since unlike cached vectors, they cannot be reused in the next iteration
+    // Note here allocated is temp vector, since unlike cached vectors, they cannot be reused in the next iteration.
+    // They are taken from the scratch arena by handle, and given back when this scope ends.
+    auto scope = scratchPad.openScope();
     size_t tempArraySizeAcc = (size_t)2 * nContactPairs * sizeof(float3);
     size_t tempArraySizeAcc_sorted = (size_t)2 * nContactPairs * sizeof(float3);
     size_t tempArraySizeOwnerAcc = (size_t)nClumps * sizeof(float3);
     size_t tempArraySizeOwner = (size_t)nClumps * sizeof(bodyID_t);
-    float3* acc_A = (float3*)scratchPad.allocateTempVector("acc_A", tempArraySizeAcc);
+    float3* acc_A = (float3*)scratchPad.allocateTempVector(SCRATCH_ACC_A, tempArraySizeAcc);
     float3* acc_B = (float3*)(acc_A + nContactPairs);
-    float3* acc_A_sorted = (float3*)scratchPad.allocateTempVector("acc_A_sorted", tempArraySizeAcc_sorted);
+    float3* acc_A_sorted = (float3*)scratchPad.allocateTempVector(SCRATCH_ACC_A_SORTED, tempArraySizeAcc_sorted);
     // float3* acc_B_sorted = (float3*)(acc_A_sorted  + nContactPairs);
-    bodyID_t* idAOwner_sorted = (bodyID_t*)scratchPad.allocateTempVector("idAOwner_sorted", cachedArraySizeOwner);
+    bodyID_t* idAOwner_sorted =
+        (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_ID_A_OWNER_SORTED, cachedArraySizeOwner);
     // bodyID_t* idBOwner_sorted = (bodyID_t*)(idAOwner_sorted + nContactPairs);
     float3* accOwner = (float3*)scratchPad.allocateTempVector(
-        "accOwner", tempArraySizeOwnerAcc);  // can store both linear and angular acceleration
-    bodyID_t* uniqueOwner = (bodyID_t*)scratchPad.allocateTempVector("uniqueOwner", tempArraySizeOwner);
+        SCRATCH_ACC_OWNER, tempArraySizeOwnerAcc);  // can store both linear and angular acceleration
+    bodyID_t* uniqueOwner = (bodyID_t*)scratchPad.allocateTempVector(SCRATCH_UNIQUE_OWNER, tempArraySizeOwner);
     // Collect accelerations for body A (modifier used to be h * h / l when we stored acc as h^2*acc)
     // NOTE!! If you pass floating point number to kernels, the number needs to be something like 1.f, not 1.0.
     // Somtimes 1.0 got converted to 0.f with the kernel call.
@@ -161,11 +164,6 @@ void collectContactForcesThruCub(std::shared_ptr<jitify::Program>& collect_force
         .launch(granData->alphaX, granData->alphaY, granData->alphaZ, uniqueOwner, accOwner, *hpForceCollectionRuns);
     DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
 
-    scratchPad.finishUsingTempVector("acc_A");
-    scratchPad.finishUsingTempVector("acc_A_sorted");
-    scratchPad.finishUsingTempVector("idAOwner_sorted");
-    scratchPad.finishUsingTempVector("accOwner");
-    scratchPad.finishUsingTempVector("uniqueOwner");
     scratchPad.finishUsingDualStruct("forceCollectionRuns");
 }
 
@@ -177,6 +177,20 @@ template void cubMinReduceByKey<notStupidBool_t, double>(notStupidBool_t* d_keys
                                                          cudaStream_t& this_stream,
                                                          DEMSolverScratchData& scratchPad);
 
+////////////////////////////////////////////////////////////////////////////////
+// Scan::ExclusiveSum
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T1, typename T2>
+void cubPrefixScan(T1* d_in, T2* d_out, size_t n, cudaStream_t& this_stream, DEMSolverScratchData& scratchPad) {
+    cubDEMPrefixScan<T1, T2>(d_in, d_out, n, this_stream, scratchPad);
+}
+template void cubPrefixScan<notStupidBool_t, contactPairs_t>(notStupidBool_t* d_in,
+                                                             contactPairs_t* d_out,
+                                                             size_t n,
+                                                             cudaStream_t& this_stream,
+                                                             DEMSolverScratchData& scratchPad);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Sort
 ////////////////////////////////////////////////////////////////////////////////
@@ -205,4 +219,21 @@ template void cubSortByKey<notStupidBool_t, double>(notStupidBool_t* d_keys_in,
                                                     size_t n,
                                                     cudaStream_t& this_stream,
                                                     DEMSolverScratchData& scratchPad);
+template void cubSortByKey<unsigned int, contactPairs_t>(unsigned int* d_keys_in,
+                                                        unsigned int* d_keys_out,
+                                                        contactPairs_t* d_vals_in,
+                                                        contactPairs_t* d_vals_out,
+                                                        size_t n,
+                                                        cudaStream_t& this_stream,
+                                                        DEMSolverScratchData& scratchPad);
+
+template <typename T1>
+void cubSortKeys(T1* d_keys_in, T1* d_keys_out, size_t n, cudaStream_t& this_stream, DEMSolverScratchData& scratchPad) {
+    cubDEMSortKeys<T1>(d_keys_in, d_keys_out, n, this_stream, scratchPad);
+}
+template void cubSortKeys<unsigned long long>(unsigned long long* d_keys_in,
+                                              unsigned long long* d_keys_out,
+                                              size_t n,
+                                              cudaStream_t& this_stream,
+                                              DEMSolverScratchData& scratchPad);
 }  // namespace deme
@@ -7,6 +7,7 @@
 #include <DEM/Defines.h>
 #include <DEM/Structs.h>
 #include <core/utils/GpuError.h>
+#include <DEM/utils/IndexWidth.hpp>
 
 namespace deme {
 
@@ -74,11 +75,15 @@ inline void cubDEMPrefixScan(T1* d_in,
     // but d_in type is not big enough to store the scan result. This causes overflow and cub certainly does not care to
     // let you know when it happens. I made a trick: use ExclusiveScan and (T2)0 as the initial value, and this forces
     // cub to store results as T2 type.
+    // The sum saturates at T2's max rather than wrapping around, so that the caller can tell from the scan tail if the
+    // total fits T2 (see ScanTotalFitsIndex).
     size_t cub_scratch_bytes = 0;
-    cub::DeviceScan::ExclusiveScan(NULL, cub_scratch_bytes, d_in, d_out, cub::Sum(), (T2)0, n, this_stream);
+    cub::DeviceScan::ExclusiveScan(NULL, cub_scratch_bytes, d_in, d_out, SaturatingSum<T2>(), (T2)0, n,
+                                   this_stream);
     DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
     void* d_scratch_space = (void*)scratchPad.allocateScratchSpace(cub_scratch_bytes);
-    cub::DeviceScan::ExclusiveScan(d_scratch_space, cub_scratch_bytes, d_in, d_out, cub::Sum(), (T2)0, n, this_stream);
+    cub::DeviceScan::ExclusiveScan(d_scratch_space, cub_scratch_bytes, d_in, d_out, SaturatingSum<T2>(), (T2)0, n,
+                                   this_stream);
     DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
 }
 
@@ -100,6 +105,22 @@ inline void cubDEMSortByKeys(T1* d_keys_in,
     DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
 }
 
+template <typename T1>
+inline void cubDEMSortKeys(T1* d_keys_in,
+                           T1* d_keys_out,
+                           size_t n,
+                           cudaStream_t& this_stream,
+                           DEMSolverScratchData& scratchPad) {
+    size_t cub_scratch_bytes = 0;
+    cub::DeviceRadixSort::SortKeys(NULL, cub_scratch_bytes, d_keys_in, d_keys_out, n, 0,
+                                   sizeof(T1) * DEME_BITS_PER_BYTE, this_stream);
+    DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+    void* d_scratch_space = (void*)scratchPad.allocateScratchSpace(cub_scratch_bytes);
+    cub::DeviceRadixSort::SortKeys(d_scratch_space, cub_scratch_bytes, d_keys_in, d_keys_out, n, 0,
+                                   sizeof(T1) * DEME_BITS_PER_BYTE, this_stream);
+    DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+}
+
 template <typename T1>
 inline void cubDEMUnique(T1* d_in,
                          T1* d_out,
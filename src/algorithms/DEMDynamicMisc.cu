@@ -8,6 +8,7 @@
 
 #include <core/utils/GpuError.h>
 #include <kernel/DEMHelperKernels.cuh>
+#include <kernel/DEMForceProbeHelpers.cuh>
 
 namespace deme {
 
@@ -22,7 +23,7 @@ __global__ void getContactForcesConcerningOwners_impl(float3* d_points,
                                                       size_t numCnt,
                                                       bool need_torque,
                                                       bool torque_in_local) {
-    size_t i = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (i < numCnt) {
         bodyID_t geoA = granData->idGeometryA[i];
         bodyID_t ownerA = granData->ownerClumpBody[geoA];
@@ -118,4 +119,264 @@ void getContactForcesConcerningOwners(float3* d_points,
     DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
 }
 
+// Contact point, force and torque (all global) as experienced by one side (A or B) of a contact
+inline __device__ void getContactSideForce(float3& cntPnt,
+                                           float3& force,
+                                           float3& torque,
+                                           bodyID_t ownerID,
+                                           bool AorB,
+                                           size_t i,
+                                           DEMSimParams* simParams,
+                                           DEMDataDT* granData) {
+    cntPnt = (AorB) ? granData->contactPointGeometryA[i] : granData->contactPointGeometryB[i];
+    force = granData->contactForces[i];
+    torque = granData->contactTorque_convToForce[i];
+    if (!AorB) {
+        force = -force;
+        torque = -torque;
+    }
+    float4 oriQ;
+    oriQ.w = granData->oriQw[ownerID];
+    oriQ.x = granData->oriQx[ownerID];
+    oriQ.y = granData->oriQy[ownerID];
+    oriQ.z = granData->oriQz[ownerID];
+    // Torque-only force times the (local) contact point, then back to global
+    applyOriQToVector3<float, deme::oriQ_t>(torque.x, torque.y, torque.z, oriQ.w, -oriQ.x, -oriQ.y, -oriQ.z);
+    torque = cross(cntPnt, torque);
+    applyOriQToVector3<float, deme::oriQ_t>(torque.x, torque.y, torque.z, oriQ.w, oriQ.x, oriQ.y, oriQ.z);
+
+    double3 CoM;
+    voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+        CoM.x, CoM.y, CoM.z, granData->voxelID[ownerID], granData->locX[ownerID], granData->locY[ownerID],
+        granData->locZ[ownerID], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize, simParams->l);
+    CoM.x += simParams->LBFX;
+    CoM.y += simParams->LBFY;
+    CoM.z += simParams->LBFZ;
+    applyFrameTransformLocalToGlobal<float3, double3, float4>(cntPnt, CoM, oriQ);
+}
+
+__global__ void reduceContactForceProbes_impl(float* d_aggregates,
+                                              unsigned long long* d_counts,
+                                              unsigned int* d_ownerMask,
+                                              unsigned int* d_familyMask,
+                                              float3* d_refPoints,
+                                              unsigned int nProbes,
+                                              unsigned int detailMask,
+                                              float3* d_detailPoints,
+                                              float3* d_detailForces,
+                                              float3* d_detailTorques,
+                                              unsigned int* d_detailProbe,
+                                              unsigned long long* d_numDetail,
+                                              DEMSimParams* simParams,
+                                              DEMDataDT* granData,
+                                              size_t numCnt) {
+    // Block-level accumulators, so each block only does one global atomic per probe quantity
+    __shared__ float s_agg[MAX_NUM_FORCE_PROBES * FORCE_PROBE_NUM_AGGREGATES];
+    __shared__ unsigned int s_cnt[MAX_NUM_FORCE_PROBES];
+    for (unsigned int j = threadIdx.x; j < nProbes * FORCE_PROBE_NUM_AGGREGATES; j += blockDim.x) {
+        s_agg[j] = 0.f;
+    }
+    for (unsigned int j = threadIdx.x; j < nProbes; j += blockDim.x) {
+        s_cnt[j] = 0;
+    }
+    __syncthreads();
+
+    size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < numCnt) {
+        bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[i]];
+        bodyID_t geoB = granData->idGeometryB[i];
+        contact_t typeB = granData->contactType[i];
+        bodyID_t ownerB = DEME_GET_GEO_OWNER_ID(geoB, typeB);
+        unsigned int maskA = d_ownerMask[ownerA] | d_familyMask[granData->familyID[ownerA]];
+        unsigned int maskB = d_ownerMask[ownerB] | d_familyMask[granData->familyID[ownerB]];
+
+        float3 force = granData->contactForces[i];
+        float3 torque = granData->contactTorque_convToForce[i];
+        if ((maskA | maskB) && length(force) + length(torque) >= DEME_TINY_FLOAT) {
+            // Side quantities are derived only once, and only if some probe needs them
+            float3 pntA, forceA, torqueA, pntB, forceB, torqueB;
+            bool doneA = false, doneB = false;
+            for (unsigned int k = 0; k < nProbes; k++) {
+                const unsigned int bit = 1u << k;
+                const unsigned int side = forceProbeSide(maskA, maskB, bit);
+                if (side == FORCE_PROBE_NO_SIDE)
+                    continue;
+                const bool AorB = (side == FORCE_PROBE_SIDE_A);
+                if (AorB && !doneA) {
+                    getContactSideForce(pntA, forceA, torqueA, ownerA, true, i, simParams, granData);
+                    doneA = true;
+                } else if (!AorB && !doneB) {
+                    getContactSideForce(pntB, forceB, torqueB, ownerB, false, i, simParams, granData);
+                    doneB = true;
+                }
+                const float3& pnt = AorB ? pntA : pntB;
+                const float3& f = AorB ? forceA : forceB;
+                const float3& t = AorB ? torqueA : torqueB;
+                float contrib[FORCE_PROBE_NUM_AGGREGATES];
+                forceProbeContribution(contrib, pnt, f, t, d_refPoints[k]);
+                float* agg = s_agg + k * FORCE_PROBE_NUM_AGGREGATES;
+                for (unsigned int j = 0; j < FORCE_PROBE_NUM_AGGREGATES; j++) {
+                    atomicAdd(agg + j, contrib[j]);
+                }
+                atomicAdd(s_cnt + k, 1u);
+
+                if (detailMask & bit) {
+                    unsigned long long writeIndex = atomicAdd(d_numDetail, 1);
+                    d_detailPoints[writeIndex] = pnt;
+                    d_detailForces[writeIndex] = f;
+                    d_detailTorques[writeIndex] = t;
+                    d_detailProbe[writeIndex] = k;
+                }
+            }
+        }
+    }
+    __syncthreads();
+
+    for (unsigned int j = threadIdx.x; j < nProbes * FORCE_PROBE_NUM_AGGREGATES; j += blockDim.x) {
+        if (s_agg[j] != 0.f)
+            atomicAdd(d_aggregates + j, s_agg[j]);
+    }
+    for (unsigned int j = threadIdx.x; j < nProbes; j += blockDim.x) {
+        if (s_cnt[j] > 0)
+            atomicAdd(d_counts + j, (unsigned long long)s_cnt[j]);
+    }
+}
+
+void reduceContactForceProbes(float* d_aggregates,
+                              size_t* d_counts,
+                              unsigned int* d_ownerMask,
+                              unsigned int* d_familyMask,
+                              float3* d_refPoints,
+                              unsigned int nProbes,
+                              unsigned int detailMask,
+                              float3* d_detailPoints,
+                              float3* d_detailForces,
+                              float3* d_detailTorques,
+                              unsigned int* d_detailProbe,
+                              size_t* d_numDetail,
+                              DEMSimParams* simParams,
+                              DEMDataDT* granData,
+                              size_t numCnt,
+                              cudaStream_t& this_stream) {
+    size_t blocks_needed = (numCnt + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    if (blocks_needed == 0)
+        return;
+    reduceContactForceProbes_impl<<<blocks_needed, DEME_MAX_THREADS_PER_BLOCK, 0, this_stream>>>(
+        d_aggregates, reinterpret_cast<unsigned long long*>(d_counts), d_ownerMask, d_familyMask, d_refPoints, nProbes,
+        detailMask, d_detailPoints, d_detailForces, d_detailTorques, d_detailProbe,
+        reinterpret_cast<unsigned long long*>(d_numDetail), simParams, granData, numCnt);
+    DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+}
+
+__global__ void recordOwnerCDSnapshot_impl(double3* d_refPos,
+                                           float4* d_refOriQ,
+                                           DEMSimParams* simParams,
+                                           DEMDataDT* granData,
+                                           size_t n) {
+    size_t ownerID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (ownerID < n) {
+        double3 pos;
+        voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+            pos.x, pos.y, pos.z, granData->voxelID[ownerID], granData->locX[ownerID], granData->locY[ownerID],
+            granData->locZ[ownerID], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize, simParams->l);
+        d_refPos[ownerID] = pos;
+        d_refOriQ[ownerID] = make_float4(granData->oriQx[ownerID], granData->oriQy[ownerID], granData->oriQz[ownerID],
+                                         granData->oriQw[ownerID]);
+    }
+}
+
+void recordOwnerCDSnapshot(double3* d_refPos,
+                           float4* d_refOriQ,
+                           DEMSimParams* simParams,
+                           DEMDataDT* granData,
+                           size_t n,
+                           cudaStream_t& this_stream) {
+    size_t blocks_needed = (n + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    if (blocks_needed == 0)
+        return;
+    recordOwnerCDSnapshot_impl<<<blocks_needed, DEME_MAX_THREADS_PER_BLOCK, 0, this_stream>>>(d_refPos, d_refOriQ,
+                                                                                             simParams, granData, n);
+    DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+}
+
+__global__ void computeOwnerCDDisplacement_impl(float* d_disp,
+                                                const double3* d_refPos,
+                                                const float4* d_refOriQ,
+                                                const float* d_boundRadius,
+                                                const float3* d_symAxis,
+                                                DEMSimParams* simParams,
+                                                DEMDataDT* granData,
+                                                size_t n) {
+    size_t ownerID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (ownerID < n) {
+        double3 pos;
+        voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+            pos.x, pos.y, pos.z, granData->voxelID[ownerID], granData->locX[ownerID], granData->locY[ownerID],
+            granData->locZ[ownerID], simParams->nvXp2, simParams->nvYp2, simParams->voxelSize, simParams->l);
+        const double3 ref = d_refPos[ownerID];
+        const double dx = pos.x - ref.x, dy = pos.y - ref.y, dz = pos.z - ref.z;
+        float trans = sqrt(dx * dx + dy * dy + dz * dz);
+
+        // The vector part of q * conj(q_ref) has length sin(theta / 2), theta being the rotation since the snapshot, so
+        // a point at distance R from the CoM moved by at most 2 * R * sin(theta / 2) due to that rotation
+        const float4 r = d_refOriQ[ownerID];
+        const float3 v1 = make_float3(granData->oriQx[ownerID], granData->oriQy[ownerID], granData->oriQz[ownerID]);
+        const float3 v2 = make_float3(r.x, r.y, r.z);
+        const float w1 = granData->oriQw[ownerID];
+        float3 rel = r.w * v1 - w1 * v2 - cross(v1, v2);
+        float rot = 2.f * length(rel);
+        // If the geometry is symmetric about an axis, what it looks like depends only on where that axis points, and
+        // the smallest rotation that takes the axis there turns it by phi, with 2 * sin(phi / 2) being the distance
+        // between the axis directions
+        const float3 axis = d_symAxis[ownerID];
+        if (length(axis) > 0.f) {
+            float3 now = axis, then = axis;
+            applyOriQToVector3<float, oriQ_t>(now.x, now.y, now.z, w1, v1.x, v1.y, v1.z);
+            applyOriQToVector3<float, oriQ_t>(then.x, then.y, then.z, r.w, r.x, r.y, r.z);
+            rot = fminf(rot, length(now - then));
+        }
+        d_disp[ownerID] = trans + d_boundRadius[ownerID] * rot;
+    }
+}
+
+void computeOwnerCDDisplacement(float* d_disp,
+                                const double3* d_refPos,
+                                const float4* d_refOriQ,
+                                const float* d_boundRadius,
+                                const float3* d_symAxis,
+                                DEMSimParams* simParams,
+                                DEMDataDT* granData,
+                                size_t n,
+                                cudaStream_t& this_stream) {
+    size_t blocks_needed = (n + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    if (blocks_needed == 0)
+        return;
+    computeOwnerCDDisplacement_impl<<<blocks_needed, DEME_MAX_THREADS_PER_BLOCK, 0, this_stream>>>(
+        d_disp, d_refPos, d_refOriQ, d_boundRadius, d_symAxis, simParams, granData, n);
+    DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+}
+
+__global__ void countForceBearingContacts_impl(unsigned long long* d_count, DEMDataDT* granData, size_t numCnt) {
+    size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    int bearing = 0;
+    if (i < numCnt) {
+        bearing = (length(granData->contactForces[i]) > DEME_TINY_FLOAT) ? 1 : 0;
+    }
+    // Every thread of the block has to get here
+    int block_count = __syncthreads_count(bearing);
+    if (threadIdx.x == 0 && block_count > 0) {
+        atomicAdd(d_count, (unsigned long long)block_count);
+    }
+}
+
+void countForceBearingContacts(size_t* d_count, DEMDataDT* granData, size_t numCnt, cudaStream_t& this_stream) {
+    DEME_GPU_CALL(cudaMemsetAsync(d_count, 0, sizeof(size_t), this_stream));
+    size_t blocks_needed = (numCnt + DEME_MAX_THREADS_PER_BLOCK - 1) / DEME_MAX_THREADS_PER_BLOCK;
+    if (blocks_needed > 0) {
+        countForceBearingContacts_impl<<<blocks_needed, DEME_MAX_THREADS_PER_BLOCK, 0, this_stream>>>(
+            reinterpret_cast<unsigned long long*>(d_count), granData, numCnt);
+    }
+    DEME_GPU_CALL(cudaStreamSynchronize(this_stream));
+}
+
 }  // namespace deme
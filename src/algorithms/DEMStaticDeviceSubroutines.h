@@ -63,6 +63,9 @@ void cubMinReduceByKey(T1* d_keys_in,
                        cudaStream_t& this_stream,
                        DEMSolverScratchData& scratchPad);
 
+template <typename T1, typename T2>
+void cubPrefixScan(T1* d_in, T2* d_out, size_t n, cudaStream_t& this_stream, DEMSolverScratchData& scratchPad);
+
 template <typename T1, typename T2>
 void cubSortByKey(T1* d_keys_in,
                   T1* d_keys_out,
@@ -72,6 +75,9 @@ void cubSortByKey(T1* d_keys_in,
                   cudaStream_t& this_stream,
                   DEMSolverScratchData& scratchPad);
 
+template <typename T1>
+void cubSortKeys(T1* d_keys_in, T1* d_keys_out, size_t n, cudaStream_t& this_stream, DEMSolverScratchData& scratchPad);
+
 ////////////////////////////////////////////////////////////////////////////////
 // For kT and dT's private usage
 ////////////////////////////////////////////////////////////////////////////////
@@ -132,6 +138,42 @@ void getContactForcesConcerningOwners(float3* d_points,
                                       bool torque_in_local,
                                       cudaStream_t& this_stream);
 
+void reduceContactForceProbes(float* d_aggregates,
+                              size_t* d_counts,
+                              unsigned int* d_ownerMask,
+                              unsigned int* d_familyMask,
+                              float3* d_refPoints,
+                              unsigned int nProbes,
+                              unsigned int detailMask,
+                              float3* d_detailPoints,
+                              float3* d_detailForces,
+                              float3* d_detailTorques,
+                              unsigned int* d_detailProbe,
+                              size_t* d_numDetail,
+                              DEMSimParams* simParams,
+                              DEMDataDT* granData,
+                              size_t numCnt,
+                              cudaStream_t& this_stream);
+
+void recordOwnerCDSnapshot(double3* d_refPos,
+                           float4* d_refOriQ,
+                           DEMSimParams* simParams,
+                           DEMDataDT* granData,
+                           size_t n,
+                           cudaStream_t& this_stream);
+
+void computeOwnerCDDisplacement(float* d_disp,
+                                const double3* d_refPos,
+                                const float4* d_refOriQ,
+                                const float* d_boundRadius,
+                                const float3* d_symAxis,
+                                DEMSimParams* simParams,
+                                DEMDataDT* granData,
+                                size_t n,
+                                cudaStream_t& this_stream);
+
+void countForceBearingContacts(size_t* d_count, DEMDataDT* granData, size_t numCnt, cudaStream_t& this_stream);
+
 }  // namespace deme
 
 #endif
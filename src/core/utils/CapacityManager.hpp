@@ -0,0 +1,123 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_CAPACITY_MANAGER_HPP
+#define DEME_CAPACITY_MANAGER_HPP
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Capacity manager
+//
+// Decides the capacity (allocated length) of a family of arrays indexed by the same count, such as the contact arrays,
+// from the count needed each time they are used. It grows ahead of the count, so a slowly rising count does not
+// reallocate every time, and it shrinks only after the count has stayed below a low watermark for a window of
+// observations in a row, to a capacity with headroom over the largest count in that window. So a transient spike (an
+// impact, a bucket plunge) does not hold its memory for the rest of the run, while a count that goes up and down does
+// not keep reallocating. The manager only does the bookkeeping; the owner of the arrays reallocates them all to
+// capacity() when observe() says so.
+// -----------------------------------------------------------------------------
+
+/// How a CapacityManager grows and shrinks
+struct CapacityPolicy {
+    /// On growth, the capacity is this times the count needed
+    double growFactor = 1.2;
+    /// The capacity is never below this
+    size_t minCapacity = 1024;
+    /// A count below this fraction of the capacity is low...
+    double lowWatermark = 0.3;
+    /// ... and after this many low observations in a row, the capacity shrinks
+    unsigned int shrinkWindow = 500;
+    /// The shrunk capacity is this times the largest count in the window (must be below 1 / lowWatermark)
+    double shrinkHeadroom = 1.5;
+    /// Set to false to only ever grow
+    bool allowShrink = true;
+};
+
+/// What a CapacityManager has done
+struct CapacityStats {
+    size_t numGrows = 0;
+    size_t numShrinks = 0;
+    size_t peakNeeded = 0;
+    size_t peakCapacity = 0;
+};
+
+class CapacityManager {
+  public:
+    CapacityManager() {}
+    explicit CapacityManager(const CapacityPolicy& policy) { setPolicy(policy); }
+
+    void setPolicy(const CapacityPolicy& policy) {
+        if (policy.growFactor < 1. || policy.lowWatermark < 0. || policy.lowWatermark >= 1. ||
+            policy.shrinkHeadroom < 1. || policy.shrinkHeadroom * policy.lowWatermark >= 1.) {
+            std::stringstream ss;
+            ss << "Capacity policy needs growFactor >= 1, 0 <= lowWatermark < 1 and 1 <= shrinkHeadroom < 1 / "
+                  "lowWatermark, but they are "
+               << policy.growFactor << ", " << policy.lowWatermark << " and " << policy.shrinkHeadroom << "."
+               << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+        m_policy = policy;
+    }
+    const CapacityPolicy& getPolicy() const { return m_policy; }
+
+    /// Tell the capacity already allocated (such as at initialization); it does not count as a growth
+    void setCapacity(size_t capacity) {
+        m_capacity = capacity;
+        m_stats.peakCapacity = std::max(m_stats.peakCapacity, capacity);
+        resetWindow();
+    }
+
+    /// Record the count needed now. Returns true if the capacity changed, and then the arrays should be reallocated
+    /// to capacity().
+    bool observe(size_t needed) {
+        m_stats.peakNeeded = std::max(m_stats.peakNeeded, needed);
+        if (needed > m_capacity) {
+            m_capacity = std::max((size_t)(m_policy.growFactor * needed), std::max(needed, m_policy.minCapacity));
+            m_stats.numGrows++;
+            m_stats.peakCapacity = std::max(m_stats.peakCapacity, m_capacity);
+            resetWindow();
+            return true;
+        }
+        if (!m_policy.allowShrink || needed >= m_policy.lowWatermark * m_capacity) {
+            resetWindow();
+            return false;
+        }
+        m_window_peak = std::max(m_window_peak, needed);
+        if (++m_num_low < m_policy.shrinkWindow)
+            return false;
+        const size_t target = std::max((size_t)(m_policy.shrinkHeadroom * m_window_peak), m_policy.minCapacity);
+        resetWindow();
+        if (target >= m_capacity)
+            return false;
+        m_capacity = target;
+        m_stats.numShrinks++;
+        return true;
+    }
+
+    size_t capacity() const { return m_capacity; }
+    const CapacityStats& getStats() const { return m_stats; }
+
+  private:
+    CapacityPolicy m_policy;
+    CapacityStats m_stats;
+    size_t m_capacity = 0;
+    // Low observations in a row, and the largest count among them
+    unsigned int m_num_low = 0;
+    size_t m_window_peak = 0;
+
+    void resetWindow() {
+        m_num_low = 0;
+        m_window_peak = 0;
+    }
+};
+
+}  // namespace deme
+
+#endif
@@ -7,9 +7,13 @@
 #define DEME_DATA_MIGRATION_HPP
 
 #include <cassert>
+#include <iostream>
 #include <optional>
 #include <unordered_map>
-#include <core/utils/GpuError.h>
+#include <core/utils/MemoryBackend.hpp>
+#include <core/utils/MemoryRegistry.hpp>
+#include <core/utils/ScratchArena.hpp>
+#include <core/utils/CapacityManager.hpp>
 #include <DEM/VariableTypes.h>
 
 namespace deme {
@@ -17,21 +21,21 @@ namespace deme {
 // A to-device memcpy wrapper
 template <typename T>
 void CudaCopyToDevice(T* pD, T* pH) {
-    DEME_GPU_CALL(cudaMemcpy(pD, pH, sizeof(T), cudaMemcpyHostToDevice));
+    MemoryBackend::copy(pD, pH, sizeof(T), MEM_COPY::HOST_TO_DEVICE);
 }
 template <typename T>
 void CudaCopyToDevice(T* pD, T* pH, size_t n) {
-    DEME_GPU_CALL(cudaMemcpy(pD, pH, n * sizeof(T), cudaMemcpyHostToDevice));
+    MemoryBackend::copy(pD, pH, n * sizeof(T), MEM_COPY::HOST_TO_DEVICE);
 }
 
 // A to-host memcpy wrapper
 template <typename T>
 void CudaCopyToHost(T* pH, T* pD) {
-    DEME_GPU_CALL(cudaMemcpy(pH, pD, sizeof(T), cudaMemcpyDeviceToHost));
+    MemoryBackend::copy(pH, pD, sizeof(T), MEM_COPY::DEVICE_TO_HOST);
 }
 template <typename T>
 void CudaCopyToHost(T* pH, T* pD, size_t n) {
-    DEME_GPU_CALL(cudaMemcpy(pH, pD, n * sizeof(T), cudaMemcpyDeviceToHost));
+    MemoryBackend::copy(pH, pD, n * sizeof(T), MEM_COPY::DEVICE_TO_HOST);
 }
 
 // ptr being a reference to a pointer is crucial
@@ -39,32 +43,24 @@ template <typename T>
 inline void DevicePtrDealloc(T*& ptr) {
     if (!ptr)
         return;
-    cudaPointerAttributes attrib;
-    DEME_GPU_CALL(cudaPointerGetAttributes(&attrib, ptr));
-
-    if (attrib.type != cudaMemoryType::cudaMemoryTypeUnregistered)
-        DEME_GPU_CALL(cudaFree(ptr));
+    MemoryBackend::freeDevice(ptr);
 }
 
 // You have to deal with it yourself if ptr is an already-used device pointer
 template <typename T>
 inline void DevicePtrAlloc(T*& ptr, size_t size) {
-    DEME_GPU_CALL(cudaMalloc((void**)&ptr, size * sizeof(T)));
+    ptr = (T*)MemoryBackend::allocDevice(size * sizeof(T));
 }
 
 template <typename T>
 inline void HostPtrDealloc(T*& ptr) {
     if (!ptr)
         return;
-    cudaPointerAttributes attrib;
-    DEME_GPU_CALL(cudaPointerGetAttributes(&attrib, ptr));
-
-    if (attrib.type != cudaMemoryType::cudaMemoryTypeUnregistered)
-        DEME_GPU_CALL(cudaFreeHost(ptr));
+    MemoryBackend::freeHost(ptr);
 }
 template <typename T>
 inline void HostPtrAlloc(T*& ptr, size_t size) {
-    DEME_GPU_CALL(cudaMallocHost((void**)&ptr, size * sizeof(T)));
+    ptr = (T*)MemoryBackend::allocHost(size * sizeof(T));
 }
 
 // Managed advise doesn't seem to do anything...
@@ -107,19 +103,16 @@ template <typename T>
 class DualStruct : private NonCopyable {
   private:
     T* host_data;           // Pointer to host memory (pinned)
-    T* device_data;         // Pointer to device memory
+    T* device_data;         // Pointer to device memory (the same as host_data if the backend has unified views)
     bool modified_on_host;  // Flag to track if host data has been modified
+    MemoryRecord* m_mem_record = nullptr;
   public:
     // Constructor: Initialize and allocate memory for both host and device
-    DualStruct() : modified_on_host(false) {
-        DEME_GPU_CALL(cudaMallocHost((void**)&host_data, sizeof(T)));
-        DEME_GPU_CALL(cudaMalloc((void**)&device_data, sizeof(T)));
-    }
+    DualStruct() : modified_on_host(false) { allocate(); }
 
     // Constructor: Initialize and allocate memory for both host and device with init values
     DualStruct(T init_val) : modified_on_host(false) {
-        DEME_GPU_CALL(cudaMallocHost((void**)&host_data, sizeof(T)));
-        DEME_GPU_CALL(cudaMalloc((void**)&device_data, sizeof(T)));
+        allocate();
 
         *host_data = init_val;
 
@@ -130,18 +123,38 @@ class DualStruct : private NonCopyable {
     ~DualStruct() { free(); }
 
     void free() {
-        HostPtrDealloc(host_data);      // Free pinned memory
-        DevicePtrDealloc(device_data);  // Free device memory
+        setMemoryRecord(nullptr);
+        if (device_data != host_data)
+            DevicePtrDealloc(device_data);  // Free device memory
+        HostPtrDealloc(host_data);          // Free pinned memory
+        host_data = nullptr;
+        device_data = nullptr;
+    }
+
+    // Bind to a record of a memory registry (nullptr to unbind)
+    void setMemoryRecord(MemoryRecord* rec) {
+        if (rec == m_mem_record)
+            return;
+        const ssize_t device_bytes = (device_data && device_data != host_data) ? sizeof(T) : 0;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::HOST, -(ssize_t)(host_data ? sizeof(T) : 0));
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, -device_bytes);
+        m_mem_record = rec;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::HOST, (ssize_t)(host_data ? sizeof(T) : 0));
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, device_bytes);
     }
 
     // Synchronize changes from host to device
     void toDevice() {
-        DEME_GPU_CALL(cudaMemcpy(device_data, host_data, sizeof(T), cudaMemcpyHostToDevice));
+        if (!MemoryBackend::unifiedViews)
+            MemoryBackend::copy(device_data, host_data, sizeof(T), MEM_COPY::HOST_TO_DEVICE);
         modified_on_host = false;
     }
 
     // Synchronize changes from device to host
-    void toHost() { DEME_GPU_CALL(cudaMemcpy(host_data, device_data, sizeof(T), cudaMemcpyDeviceToHost)); }
+    void toHost() {
+        if (!MemoryBackend::unifiedViews)
+            MemoryBackend::copy(host_data, device_data, sizeof(T), MEM_COPY::DEVICE_TO_HOST);
+    }
 
     // // Synchronize change of one field of the struct to device
     // template <typename MemberType>
@@ -195,14 +208,25 @@ class DualStruct : private NonCopyable {
 
     // Get host or device size in bytes
     size_t getNumBytes() const { return sizeof(T); }
+
+  private:
+    void allocate() {
+        HostPtrAlloc(host_data, 1);
+        if (MemoryBackend::unifiedViews) {
+            device_data = host_data;
+        } else {
+            DevicePtrAlloc(device_data, 1);
+        }
+    }
 };
 
-#ifndef DEME_USE_MANAGED_ARRAYS
-// CPU--GPU unified array, leveraging pinned memory
+#if !defined(DEME_USE_MANAGED_ARRAYS) && !defined(DEME_USE_HOST_BACKEND)
+// CPU--GPU unified array, leveraging pinned memory. The host mirror can be dropped for arrays only kernels use; it is
+// then made again, from the device copy, the next time the host side is used.
 template <typename T>
 class DualArray : private NonCopyable {
   public:
-    using PinnedVector = std::vector<T, PinnedAllocator<T>>;
+    using PinnedVector = std::vector<T, MemoryBackend::HostAllocator<T>>;
 
     explicit DualArray(size_t* host_external_counter = nullptr, size_t* device_external_counter = nullptr)
         : m_host_mem_counter(host_external_counter), m_device_mem_counter(device_external_counter) {
@@ -241,7 +265,21 @@ class DualArray : private NonCopyable {
         resizeDevice(n);
     }
 
+    // Resize to exactly n, giving back the memory past n on both sides if it shrinks (resize never does). The first n
+    // elements are kept; like resize(n, val), only host values are filled.
+    void reallocate(size_t n, const T& val) {
+        assert(m_host_vec_ptr == m_pinned_vec.get() && "reallocate() requires internal host ownership");
+        resizeHost(n, val);
+        if (m_host_vec_ptr)
+            m_host_vec_ptr->shrink_to_fit();
+        resizeDevice(n, /*allow_shrink=*/n < m_device_capacity);
+    }
+
     void resizeHost(size_t n) {
+        if (m_mirror_dropped) {
+            m_dropped_size = n;
+            return;
+        }
         ensureHostVector();  // allocates pinned vec if null
         size_t old_bytes = m_host_vec_ptr->size() * sizeof(T);
         m_host_vec_ptr->resize(n);
@@ -250,6 +288,10 @@ class DualArray : private NonCopyable {
     }
 
     void resizeHost(size_t n, const T& val) {
+        if (m_mirror_dropped) {
+            m_dropped_size = n;
+            return;
+        }
         ensureHostVector();  // allocates pinned vec if null
         size_t old_bytes = m_host_vec_ptr->size() * sizeof(T);
         m_host_vec_ptr->resize(n, val);
@@ -269,7 +311,7 @@ class DualArray : private NonCopyable {
         // If previous data exists, copy the minimum amount
         if (m_device_ptr && m_device_capacity > 0) {
             size_t copy_count = std::min(n, m_device_capacity);
-            DEME_GPU_CALL(cudaMemcpy(new_device_ptr, m_device_ptr, copy_count * sizeof(T), cudaMemcpyDeviceToDevice));
+            MemoryBackend::copy(new_device_ptr, m_device_ptr, copy_count * sizeof(T), MEM_COPY::DEVICE_TO_DEVICE);
         }
 
         // Free old memory and update bookkeeping
@@ -284,6 +326,8 @@ class DualArray : private NonCopyable {
     }
 
     void freeHost() {
+        m_mirror_dropped = false;
+        m_dropped_size = 0;
         if (m_host_vec_ptr) {
             updateHostMemCounter(-(ssize_t)(m_host_vec_ptr->size() * sizeof(T)));
         }
@@ -305,65 +349,83 @@ class DualArray : private NonCopyable {
         freeHost();
     }
 
+    // With no host mirror, the device copy is the only one, so there is nothing to send
     void toDevice() {
+        if (m_mirror_dropped)
+            return;
         assert(m_host_vec_ptr);
         size_t count = size();
         if (count > m_device_capacity)
             resizeDevice(count);
-        DEME_GPU_CALL(cudaMemcpy(m_device_ptr, m_host_vec_ptr->data(), count * sizeof(T), cudaMemcpyHostToDevice));
+        MemoryBackend::copy(m_device_ptr, m_host_vec_ptr->data(), count * sizeof(T), MEM_COPY::HOST_TO_DEVICE);
         m_host_dirty = false;
     }
 
     void toDevice(size_t start, size_t n) {
+        if (m_mirror_dropped)
+            return;
         assert(m_host_vec_ptr && m_device_ptr);
         // Partial flavor aims for speed, no size check
-        DEME_GPU_CALL(
-            cudaMemcpy(m_device_ptr + start, m_host_vec_ptr->data() + start, n * sizeof(T), cudaMemcpyHostToDevice));
+        MemoryBackend::copy(m_device_ptr + start, m_host_vec_ptr->data() + start, n * sizeof(T),
+                            MEM_COPY::HOST_TO_DEVICE);
     }
 
-    void toDeviceAsync(cudaStream_t& stream) {
+    void toDeviceAsync(deviceStream_t& stream) {
+        if (m_mirror_dropped)
+            return;
         assert(m_host_vec_ptr);
         size_t count = size();
         if (count > m_device_capacity)
             resizeDevice(count);
-        DEME_GPU_CALL(
-            cudaMemcpyAsync(m_device_ptr, m_host_vec_ptr->data(), count * sizeof(T), cudaMemcpyHostToDevice, stream));
+        MemoryBackend::copyAsync(m_device_ptr, m_host_vec_ptr->data(), count * sizeof(T), MEM_COPY::HOST_TO_DEVICE,
+                                 stream);
         m_host_dirty = false;
     }
 
     // And partial update methods...
     // Normally this is preferred when they are used in tracker implementation
-    void toDeviceAsync(cudaStream_t& stream, size_t start, size_t n) {
+    void toDeviceAsync(deviceStream_t& stream, size_t start, size_t n) {
+        if (m_mirror_dropped)
+            return;
         assert(m_host_vec_ptr && m_device_ptr);
         // Partial flavor aims for speed, no size check
-        DEME_GPU_CALL(cudaMemcpyAsync(m_device_ptr + start, m_host_vec_ptr->data() + start, n * sizeof(T),
-                                      cudaMemcpyHostToDevice, stream));
+        MemoryBackend::copyAsync(m_device_ptr + start, m_host_vec_ptr->data() + start, n * sizeof(T),
+                                 MEM_COPY::HOST_TO_DEVICE, stream);
     }
 
     void toHost() {
+        // A dropped mirror is made again from the device copy, which is this copy already
+        if (restoreHostMirror())
+            return;
         assert(m_device_ptr && m_host_vec_ptr);
-        DEME_GPU_CALL(cudaMemcpy(m_host_vec_ptr->data(), m_device_ptr, size() * sizeof(T), cudaMemcpyDeviceToHost));
+        MemoryBackend::copy(m_host_vec_ptr->data(), m_device_ptr, size() * sizeof(T), MEM_COPY::DEVICE_TO_HOST);
         m_host_dirty = false;
     }
 
     void toHost(size_t start, size_t n) {
+        if (restoreHostMirror())
+            return;
         assert(m_device_ptr && m_host_vec_ptr);
-        DEME_GPU_CALL(
-            cudaMemcpy(m_host_vec_ptr->data() + start, m_device_ptr + start, n * sizeof(T), cudaMemcpyDeviceToHost));
+        MemoryBackend::copy(m_host_vec_ptr->data() + start, m_device_ptr + start, n * sizeof(T),
+                            MEM_COPY::DEVICE_TO_HOST);
     }
 
-    void toHostAsync(cudaStream_t& stream) {
+    void toHostAsync(deviceStream_t& stream) {
+        if (restoreHostMirror())
+            return;
         assert(m_host_vec_ptr && m_device_ptr);
-        DEME_GPU_CALL(
-            cudaMemcpyAsync(m_host_vec_ptr->data(), m_device_ptr, size() * sizeof(T), cudaMemcpyDeviceToHost, stream));
+        MemoryBackend::copyAsync(m_host_vec_ptr->data(), m_device_ptr, size() * sizeof(T), MEM_COPY::DEVICE_TO_HOST,
+                                 stream);
         m_host_dirty = false;
     }
 
-    void toHostAsync(cudaStream_t& stream, size_t start, size_t n) {
+    void toHostAsync(deviceStream_t& stream, size_t start, size_t n) {
+        if (restoreHostMirror())
+            return;
         assert(m_host_vec_ptr && m_device_ptr);
         // Async partial flavor aims for speed, no size check
-        DEME_GPU_CALL(cudaMemcpyAsync(m_host_vec_ptr->data() + start, m_device_ptr + start, n * sizeof(T),
-                                      cudaMemcpyDeviceToHost, stream));
+        MemoryBackend::copyAsync(m_host_vec_ptr->data() + start, m_device_ptr + start, n * sizeof(T),
+                                 MEM_COPY::DEVICE_TO_HOST, stream);
     }
 
     T getVal(size_t start) {
@@ -377,23 +439,27 @@ class DualArray : private NonCopyable {
     }
 
     void setVal(const T& data, size_t start) {
+        restoreHostMirror();
         (*m_host_vec_ptr)[start] = data;
         toDevice(start, 1);
     }
 
     void setVal(const std::vector<T>& data, size_t start, size_t n = 0) {
+        restoreHostMirror();
         size_t count = (n > 0) ? n : data.size();
         // Copy to host vector
         std::copy(data.begin(), data.begin() + count, m_host_vec_ptr->begin() + start);
         toDevice(start, count);
     }
 
-    void setVal(cudaStream_t& stream, const T& data, size_t start) {
+    void setVal(deviceStream_t& stream, const T& data, size_t start) {
+        restoreHostMirror();
         (*m_host_vec_ptr)[start] = data;
         toDeviceAsync(stream, start, 1);
     }
 
-    void setVal(cudaStream_t& stream, const std::vector<T>& data, size_t start, size_t n = 0) {
+    void setVal(deviceStream_t& stream, const std::vector<T>& data, size_t start, size_t n = 0) {
+        restoreHostMirror();
         size_t count = (n > 0) ? n : data.size();
         // Copy to host vector
         std::copy(data.begin(), data.begin() + count, m_host_vec_ptr->begin() + start);
@@ -403,13 +469,20 @@ class DualArray : private NonCopyable {
     void markHostModified() { m_host_dirty = true; }
     void unmarkHostModified() { m_host_dirty = false; }
 
-    // Array's in-use data range is always stored on host by size()
-    size_t size() const { return m_host_vec_ptr ? m_host_vec_ptr->size() : 0; }
+    // Array's in-use data range is always stored on host by size() (or kept aside while the mirror is dropped)
+    size_t size() const {
+        if (m_mirror_dropped)
+            return m_dropped_size;
+        return m_host_vec_ptr ? m_host_vec_ptr->size() : 0;
+    }
 
     // Get host or device size in bytes
-    size_t getNumBytes() const { return m_host_vec_ptr ? m_host_vec_ptr->size() * sizeof(T) : 0; }
+    size_t getNumBytes() const { return size() * sizeof(T); }
 
-    T* host() { return m_host_vec_ptr ? m_host_vec_ptr->data() : nullptr; }
+    T* host() {
+        restoreHostMirror();
+        return m_host_vec_ptr ? m_host_vec_ptr->data() : nullptr;
+    }
 
     T* device() { return m_device_ptr; }
 
@@ -419,7 +492,27 @@ class DualArray : private NonCopyable {
     // data() returns device data for the ease of packing pointers
     T* data() { return device(); }
 
-    PinnedVector& getHostVector() { return *m_host_vec_ptr; }
+    PinnedVector& getHostVector() {
+        restoreHostMirror();
+        return *m_host_vec_ptr;
+    }
+
+    // Free the host mirror, leaving the device copy the only one (pending host changes are sent first). The mirror
+    // is made again, filled from the device, the next time the host side is used. An attached external host vector is
+    // not ours to free, so it stays.
+    void dropHostMirror() {
+        if (m_mirror_dropped || !m_host_vec_ptr || m_host_vec_ptr != m_pinned_vec.get())
+            return;
+        const size_t n = size();
+        if (n > m_device_capacity)
+            resizeDevice(n);
+        if (m_host_dirty)
+            toDevice();
+        freeHost();
+        m_mirror_dropped = true;
+        m_dropped_size = n;
+    }
+    bool hasHostMirror() const { return !m_mirror_dropped; }
 
     void bindDevicePointer(T** external_ptr_to_ptr) {
         m_bound_device_ptr = external_ptr_to_ptr;
@@ -432,6 +525,20 @@ class DualArray : private NonCopyable {
     void setDeviceMemoryCounter(size_t* counter) { m_device_mem_counter = counter; }
     // You can use nullptr to unbind
 
+    // Bind to a record of a memory registry (nullptr to unbind); the record takes over the bytes already allocated
+    void setMemoryRecord(MemoryRecord* rec) {
+        if (rec == m_mem_record)
+            return;
+        const ssize_t host_bytes =
+            (m_host_vec_ptr && !m_mirror_dropped) ? (ssize_t)(m_host_vec_ptr->size() * sizeof(T)) : 0;
+        const ssize_t device_bytes = (ssize_t)(m_device_capacity * sizeof(T));
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::HOST, -host_bytes);
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, -device_bytes);
+        m_mem_record = rec;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::HOST, host_bytes);
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, device_bytes);
+    }
+
     void attachHostVector(const std::vector<T>* external_vec, bool deep_copy = true) {
         freeHost();  // discard internal memory and update memory tracker
         if (deep_copy) {
@@ -444,8 +551,14 @@ class DualArray : private NonCopyable {
         m_host_dirty = true;
     }
 
-    T& operator[](size_t i) { return (*m_host_vec_ptr)[i]; }
-    const T& operator[](size_t i) const { return (*m_host_vec_ptr)[i]; }
+    T& operator[](size_t i) {
+        restoreHostMirror();
+        return (*m_host_vec_ptr)[i];
+    }
+    const T& operator[](size_t i) const {
+        assert(!m_mirror_dropped && "const access needs the host mirror");
+        return (*m_host_vec_ptr)[i];
+    }
     T operator()(size_t i) { return getVal(i); }
 
   private:
@@ -454,6 +567,7 @@ class DualArray : private NonCopyable {
 
     size_t* m_host_mem_counter = nullptr;
     size_t* m_device_mem_counter = nullptr;
+    MemoryRecord* m_mem_record = nullptr;
 
     T* m_device_ptr = nullptr;
     size_t m_device_capacity = 0;
@@ -462,6 +576,25 @@ class DualArray : private NonCopyable {
 
     bool m_host_dirty = false;
 
+    // Whether the host mirror is dropped, and the size it had
+    bool m_mirror_dropped = false;
+    size_t m_dropped_size = 0;
+
+    // Make a dropped host mirror again, from the device copy; returns whether it did
+    bool restoreHostMirror() {
+        if (!m_mirror_dropped)
+            return false;
+        const size_t n = m_dropped_size;
+        m_mirror_dropped = false;
+        m_dropped_size = 0;
+        ensureHostVector(n);
+        updateHostMemCounter(static_cast<ssize_t>(n * sizeof(T)));
+        if (n > 0)
+            MemoryBackend::copy(m_host_vec_ptr->data(), m_device_ptr, n * sizeof(T), MEM_COPY::DEVICE_TO_HOST);
+        m_host_dirty = false;
+        return true;
+    }
+
     void ensureHostVector(size_t n = 0) {
         if (!m_host_vec_ptr) {
             m_pinned_vec = std::make_unique<PinnedVector>(n);
@@ -477,19 +610,22 @@ class DualArray : private NonCopyable {
     void updateHostMemCounter(ssize_t delta) {
         if (m_host_mem_counter)
             *m_host_mem_counter += delta;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::HOST, delta);
     }
 
     void updateDeviceMemCounter(ssize_t delta) {
         if (m_device_mem_counter)
             *m_device_mem_counter += delta;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, delta);
     }
 };
 #else
-// CPU--GPU unified array, leveraging managed memory
+// CPU--GPU unified array, leveraging managed memory (or plain host memory, with the host backend). Host and device
+// views are the same data, so transfers are no-ops, and there is no separate host mirror to drop.
 template <typename T>
 class DualArray : private NonCopyable {
   public:
-    using ManagedVector = std::vector<T, ManagedAllocator<T>>;
+    using ManagedVector = std::vector<T, MemoryBackend::UnifiedAllocator<T>>;
 
     explicit DualArray(size_t* host_external_counter = nullptr, size_t* device_external_counter = nullptr)
         : m_host_mem_counter(host_external_counter), m_device_mem_counter(device_external_counter) {
@@ -521,6 +657,14 @@ class DualArray : private NonCopyable {
         resizeDevice(n);
     }
 
+    // Resize to exactly n, giving back the memory past n if it shrinks (resize never does)
+    void reallocate(size_t n, const T& val) {
+        assert(m_host_vec_ptr == m_pinned_vec.get() && "reallocate() requires internal host ownership");
+        resizeHost(n, val);
+        m_host_vec_ptr->shrink_to_fit();
+        updateBoundDevicePointer();
+    }
+
     void resizeHost(size_t n) {
         ensureHostVector();  // allocates pinned vec if null
         size_t old_bytes = m_host_vec_ptr->size() * sizeof(T);
@@ -562,17 +706,17 @@ class DualArray : private NonCopyable {
 
     void toDevice(size_t start, size_t n) {}
 
-    void toDeviceAsync(cudaStream_t& stream) {}
+    void toDeviceAsync(deviceStream_t& stream) {}
 
-    void toDeviceAsync(cudaStream_t& stream, size_t start, size_t n) {}
+    void toDeviceAsync(deviceStream_t& stream, size_t start, size_t n) {}
 
     void toHost() {}
 
     void toHost(size_t start, size_t n) {}
 
-    void toHostAsync(cudaStream_t& stream) {}
+    void toHostAsync(deviceStream_t& stream) {}
 
-    void toHostAsync(cudaStream_t& stream, size_t start, size_t n) {}
+    void toHostAsync(deviceStream_t& stream, size_t start, size_t n) {}
 
     T getVal(size_t start) { return (*m_host_vec_ptr)[start]; }
 
@@ -587,9 +731,9 @@ class DualArray : private NonCopyable {
         std::copy(data.begin(), data.begin() + count, m_host_vec_ptr->begin() + start);
     }
 
-    void setVal(cudaStream_t& stream, const T& data, size_t start) { (*m_host_vec_ptr)[start] = data; }
+    void setVal(deviceStream_t& stream, const T& data, size_t start) { (*m_host_vec_ptr)[start] = data; }
 
-    void setVal(cudaStream_t& stream, const std::vector<T>& data, size_t start, size_t n = 0) {
+    void setVal(deviceStream_t& stream, const std::vector<T>& data, size_t start, size_t n = 0) {
         size_t count = (n > 0) ? n : data.size();
         std::copy(data.begin(), data.begin() + count, m_host_vec_ptr->begin() + start);
     }
@@ -608,13 +752,17 @@ class DualArray : private NonCopyable {
     T* device() { return host(); }
 
     // Overloaded operator& for device pointer access
-    T* operator&() const { return host(); }
+    T* operator&() const { return m_host_vec_ptr ? m_host_vec_ptr->data() : nullptr; }
 
     // data() returns device data for the ease of packing pointers
     T* data() { return host(); }
 
     ManagedVector& getHostVector() { return *m_host_vec_ptr; }
 
+    // The host view is the device view, so there is no mirror to drop
+    void dropHostMirror() {}
+    bool hasHostMirror() const { return true; }
+
     void bindDevicePointer(T** external_ptr_to_ptr) {
         m_bound_device_ptr = external_ptr_to_ptr;
         updateBoundDevicePointer();
@@ -626,6 +774,16 @@ class DualArray : private NonCopyable {
     void setDeviceMemoryCounter(size_t* counter) { m_device_mem_counter = counter; }
     // You can use nullptr to unbind
 
+    // Bind to a record of a memory registry (nullptr to unbind); managed memory is recorded as device memory
+    void setMemoryRecord(MemoryRecord* rec) {
+        if (rec == m_mem_record)
+            return;
+        const ssize_t bytes = m_host_vec_ptr ? (ssize_t)(m_host_vec_ptr->size() * sizeof(T)) : 0;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, -bytes);
+        m_mem_record = rec;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, bytes);
+    }
+
     T& operator[](size_t i) { return (*m_host_vec_ptr)[i]; }
     const T& operator[](size_t i) const { return (*m_host_vec_ptr)[i]; }
     T operator()(size_t i) { return getVal(i); }
@@ -636,6 +794,7 @@ class DualArray : private NonCopyable {
 
     size_t* m_host_mem_counter = nullptr;
     size_t* m_device_mem_counter = nullptr;
+    MemoryRecord* m_mem_record = nullptr;
 
     T** m_bound_device_ptr = nullptr;
 
@@ -658,10 +817,25 @@ class DualArray : private NonCopyable {
             *m_host_mem_counter += delta;
         if (m_device_mem_counter)
             *m_device_mem_counter += delta;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, delta);
     }
 };
 #endif
 
+// Backing allocator of a ScratchArena of device memory
+struct DeviceScratchAllocator {
+    static constexpr MEM_SPACE space = MEM_SPACE::DEVICE;
+    void* allocate(size_t bytes) {
+        char* ptr = nullptr;
+        DevicePtrAlloc(ptr, bytes);
+        return ptr;
+    }
+    void deallocate(void* ptr, size_t /*bytes*/) {
+        char* p = (char*)ptr;
+        DevicePtrDealloc(p);
+    }
+};
+
 // Pure device data type, usually used for scratching space
 template <typename T>
 class DeviceArray : private NonCopyable {
@@ -682,7 +856,7 @@ class DeviceArray : private NonCopyable {
         // If previous data exists, copy the minimum amount
         if (m_data && m_capacity > 0) {
             size_t copy_count = std::min(n, m_capacity);
-            DEME_GPU_CALL(cudaMemcpy(new_device_ptr, m_data, copy_count * sizeof(T), cudaMemcpyDeviceToDevice));
+            MemoryBackend::copy(new_device_ptr, m_data, copy_count * sizeof(T), MEM_COPY::DEVICE_TO_DEVICE);
         }
         // Free old memory and update bookkeeping
         updateMemCounter(-(ssize_t)(m_capacity * sizeof(T)));
@@ -712,14 +886,25 @@ class DeviceArray : private NonCopyable {
 
     void setMemoryCounter(size_t* counter) { m_mem_counter = counter; }
 
+    // Bind to a record of a memory registry (nullptr to unbind)
+    void setMemoryRecord(MemoryRecord* rec) {
+        if (rec == m_mem_record)
+            return;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, -(ssize_t)(m_capacity * sizeof(T)));
+        m_mem_record = rec;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, (ssize_t)(m_capacity * sizeof(T)));
+    }
+
   private:
     T* m_data = nullptr;
     size_t m_capacity = 0;
     size_t* m_mem_counter = nullptr;
+    MemoryRecord* m_mem_record = nullptr;
 
     void updateMemCounter(ssize_t delta) {
         if (m_mem_counter)
             *m_mem_counter += delta;
+        UpdateMemoryRecord(m_mem_record, MEM_SPACE::DEVICE, delta);
     }
 };
 
@@ -733,9 +918,39 @@ class ResourcePool : private NonCopyable {
     std::vector<std::optional<std::string>> in_use;
     std::unordered_map<std::string, size_t> name_to_index;
 
+    // The memory registry each slot is recorded in, as prefix[slot number]
+    MemoryRegistry* m_registry = nullptr;
+    std::string m_registry_prefix;
+    std::string m_registry_category;
+
+    void registerSlot(size_t i) {
+        if (m_registry)
+            vectors[i]->setMemoryRecord(
+                m_registry->Register(m_registry_prefix + "[" + std::to_string(i) + "]", m_registry_category));
+    }
+    // Note which name a slot is claimed as, before it is resized for it
+    void noteSlot(size_t i, const std::string& name) {
+        if (m_registry)
+            m_registry->SetNote(m_registry->Register(m_registry_prefix + "[" + std::to_string(i) + "]",
+                                                     m_registry_category),
+                                name);
+    }
+
   public:
     virtual ~ResourcePool() { releaseAll(); }
 
+    /// Record the slots of this pool in a memory registry, as prefix[slot number] in a category
+    void setMemoryRegistry(MemoryRegistry* registry, const std::string& prefix, const std::string& category) {
+        m_registry = registry;
+        m_registry_prefix = prefix;
+        m_registry_category = category;
+        for (size_t i = 0; i < vectors.size(); ++i) {
+            registerSlot(i);
+            if (in_use[i])
+                noteSlot(i, *in_use[i]);
+        }
+    }
+
     void resize(const std::string& name, size_t new_size) {
         auto it = name_to_index.find(name);
         if (it == name_to_index.end()) {
@@ -808,6 +1023,7 @@ class DeviceVectorPool : public ResourcePool<T, DeviceArray<T>> {
 
         for (size_t i = 0; i < Base::in_use.size(); ++i) {
             if (!Base::in_use[i]) {
+                Base::noteSlot(i, name);
                 Base::vectors[i]->resize(size);
                 Base::in_use[i] = name;
                 Base::name_to_index[name] = i;
@@ -815,9 +1031,13 @@ class DeviceVectorPool : public ResourcePool<T, DeviceArray<T>> {
             }
         }
 
-        Base::vectors.emplace_back(std::make_unique<DeviceArray<T>>(size, m_mem_counter));
+        // Registered before the allocation, so the allocation is logged as a growth
+        Base::vectors.emplace_back(std::make_unique<DeviceArray<T>>(m_mem_counter));
         Base::in_use.emplace_back(name);
         size_t new_index = Base::vectors.size() - 1;
+        Base::registerSlot(new_index);
+        Base::noteSlot(new_index, name);
+        Base::vectors[new_index]->resize(size);
         Base::name_to_index[name] = new_index;
         return Base::vectors[new_index]->data();
     }
@@ -864,6 +1084,7 @@ class DualArrayPool : public ResourcePool<T, DualArray<T>> {
 
         for (size_t i = 0; i < Base::in_use.size(); ++i) {
             if (!Base::in_use[i]) {
+                Base::noteSlot(i, name);
                 Base::vectors[i]->resize(size);
                 Base::in_use[i] = name;
                 Base::name_to_index[name] = i;
@@ -871,9 +1092,13 @@ class DualArrayPool : public ResourcePool<T, DualArray<T>> {
             }
         }
 
-        Base::vectors.emplace_back(std::make_unique<DualArray<T>>(size, m_host_mem_counter, m_device_mem_counter));
+        // Registered before the allocation, so the allocation is logged as a growth
+        Base::vectors.emplace_back(std::make_unique<DualArray<T>>(m_host_mem_counter, m_device_mem_counter));
         Base::in_use.emplace_back(name);
         size_t new_index = Base::vectors.size() - 1;
+        Base::registerSlot(new_index);
+        Base::noteSlot(new_index, name);
+        Base::vectors[new_index]->resize(size);
         Base::name_to_index[name] = new_index;
         return Base::vectors[new_index].get();
     }
@@ -935,6 +1160,7 @@ class DualStructPool : public ResourcePool<T, DualStruct<T>> {
 
         for (size_t i = 0; i < Base::in_use.size(); ++i) {
             if (!Base::in_use[i]) {
+                Base::noteSlot(i, name);
                 Base::in_use[i] = name;
                 Base::name_to_index[name] = i;
                 return Base::vectors[i].get();
@@ -944,6 +1170,8 @@ class DualStructPool : public ResourcePool<T, DualStruct<T>> {
         Base::vectors.emplace_back(std::make_unique<DualStruct<T>>());
         Base::in_use.emplace_back(name);
         size_t new_index = Base::vectors.size() - 1;
+        Base::registerSlot(new_index);
+        Base::noteSlot(new_index, name);
         Base::name_to_index[name] = new_index;
         return Base::vectors[new_index].get();
     }
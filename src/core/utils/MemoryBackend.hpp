@@ -0,0 +1,136 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_MEMORY_BACKEND_HPP
+#define DEME_MEMORY_BACKEND_HPP
+
+#include <cstring>
+#include <memory>
+#include <new>
+
+#ifndef DEME_USE_HOST_BACKEND
+    #include <core/utils/GpuError.h>
+    #include <core/utils/CudaAllocator.hpp>
+#endif
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Memory backends
+//
+// DualStruct, DualArray and DeviceArray get their memory, and copy between their host and device sides, only through
+// the MemoryBackend chosen at compile time. The CUDA backend is the default. Building with DEME_USE_HOST_BACKEND
+// selects the host backend instead, where "device" memory is plain host memory, so these data structures (and what is
+// built only on them) can be constructed, tested and benchmarked without the CUDA runtime; the build option
+// HOST_TESTS_USE_HOST_BACKEND does so for their tests. The solver itself is always built on the CUDA backend, and a
+// program must not mix code built on the two, as the data structures are defined differently on each. A backend whose
+// host and device views coincide (unifiedViews) lets the arrays keep one copy and skip their transfers altogether, as
+// managed arrays (DEME_USE_MANAGED_ARRAYS) always did.
+// -----------------------------------------------------------------------------
+
+/// Direction of a copy between memory spaces
+enum class MEM_COPY { HOST_TO_DEVICE, DEVICE_TO_HOST, DEVICE_TO_DEVICE, HOST_TO_HOST };
+
+/// Backend of plain host memory; also usable as a host-side allocator where CUDA is in use
+struct HostMemoryBackend {
+    /// Host and device pointers of the same data are one and the same
+    static constexpr bool unifiedViews = true;
+
+    template <class T>
+    using HostAllocator = std::allocator<T>;
+    template <class T>
+    using UnifiedAllocator = std::allocator<T>;
+
+    static void* allocDevice(size_t bytes) { return ::operator new(bytes); }
+    static void freeDevice(void* ptr) { ::operator delete(ptr); }
+    static void* allocHost(size_t bytes) { return ::operator new(bytes); }
+    static void freeHost(void* ptr) { ::operator delete(ptr); }
+
+    template <typename StreamT>
+    static void copyAsync(void* dst, const void* src, size_t bytes, MEM_COPY kind, StreamT& /*stream*/) {
+        copy(dst, src, bytes, kind);
+    }
+    static void copy(void* dst, const void* src, size_t bytes, MEM_COPY /*kind*/) {
+        if (bytes > 0 && dst != src)
+            std::memmove(dst, src, bytes);
+    }
+};
+
+#ifndef DEME_USE_HOST_BACKEND
+
+typedef cudaStream_t deviceStream_t;
+
+/// Backend of CUDA device memory, with pinned host mirrors
+struct CudaMemoryBackend {
+    static constexpr bool unifiedViews = false;
+
+    template <class T>
+    using HostAllocator = PinnedAllocator<T>;
+    template <class T>
+    using UnifiedAllocator = ManagedAllocator<T>;
+
+    static void* allocDevice(size_t bytes) {
+        void* ptr = nullptr;
+        DEME_GPU_CALL(cudaMalloc(&ptr, bytes));
+        return ptr;
+    }
+    static void freeDevice(void* ptr) {
+        if (!ptr)
+            return;
+        cudaPointerAttributes attrib;
+        DEME_GPU_CALL(cudaPointerGetAttributes(&attrib, ptr));
+        if (attrib.type != cudaMemoryType::cudaMemoryTypeUnregistered)
+            DEME_GPU_CALL(cudaFree(ptr));
+    }
+    static void* allocHost(size_t bytes) {
+        void* ptr = nullptr;
+        DEME_GPU_CALL(cudaMallocHost(&ptr, bytes));
+        return ptr;
+    }
+    static void freeHost(void* ptr) {
+        if (!ptr)
+            return;
+        cudaPointerAttributes attrib;
+        DEME_GPU_CALL(cudaPointerGetAttributes(&attrib, ptr));
+        if (attrib.type != cudaMemoryType::cudaMemoryTypeUnregistered)
+            DEME_GPU_CALL(cudaFreeHost(ptr));
+    }
+
+    static void copy(void* dst, const void* src, size_t bytes, MEM_COPY kind) {
+        DEME_GPU_CALL(cudaMemcpy(dst, src, bytes, cudaKind(kind)));
+    }
+    static void copyAsync(void* dst, const void* src, size_t bytes, MEM_COPY kind, deviceStream_t& stream) {
+        DEME_GPU_CALL(cudaMemcpyAsync(dst, src, bytes, cudaKind(kind), stream));
+    }
+
+  private:
+    static cudaMemcpyKind cudaKind(MEM_COPY kind) {
+        switch (kind) {
+            case MEM_COPY::HOST_TO_DEVICE:
+                return cudaMemcpyHostToDevice;
+            case MEM_COPY::DEVICE_TO_HOST:
+                return cudaMemcpyDeviceToHost;
+            case MEM_COPY::DEVICE_TO_DEVICE:
+                return cudaMemcpyDeviceToDevice;
+            default:
+                return cudaMemcpyHostToHost;
+        }
+    }
+};
+
+typedef CudaMemoryBackend MemoryBackend;
+
+#else
+
+// Streams mean nothing to the host backend, but the signatures keep them
+typedef void* deviceStream_t;
+
+typedef HostMemoryBackend MemoryBackend;
+
+#endif
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,251 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_MEMORY_REGISTRY_HPP
+#define DEME_MEMORY_REGISTRY_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Memory registry
+//
+// The arrays of the solver (DualArray, DeviceArray, DualStruct, and the pools of DEMSolverScratchData) can be bound to
+// a named record of a registry, on top of their anonymous byte counters. A record keeps the current and peak bytes of
+// its array on the host (pinned mirror) and on the device, and belongs to a category (such as contact, owner, geometry,
+// wildcard or scratch), for which the registry keeps rollups. Every growth is also logged, with its time and the new
+// totals, in a timeline of bounded length, so after a memory spike the arrays that grew, and in which order, can be
+// told apart. A pool slot is a record of its own, noted with the name it is currently claimed as.
+// Records are never removed, so an array that is freed keeps its peak. The registry is shared by the solver threads,
+// and locks on every update; arrays only update it when their allocation changes, not when their data do.
+// -----------------------------------------------------------------------------
+
+enum class MEM_SPACE { HOST = 0, DEVICE = 1 };
+
+class MemoryRegistry;
+
+/// The memory of one named array
+struct MemoryRecord {
+    std::string name;
+    std::string category;
+    /// What the array is currently used as (for pool slots)
+    std::string note;
+    /// Current and peak bytes, on the host and on the device
+    size_t bytes[2] = {0, 0};
+    size_t peakBytes[2] = {0, 0};
+    /// Number of times it grew
+    size_t numGrowths = 0;
+
+    MemoryRegistry* registry = nullptr;
+};
+
+/// A growth of an array
+struct MemoryEvent {
+    /// Number of the event since the registry started (events dropped from the timeline still count)
+    uint64_t seq = 0;
+    /// Seconds since the registry started
+    double time = 0.;
+    std::string name;
+    std::string note;
+    MEM_SPACE space = MEM_SPACE::DEVICE;
+    size_t oldBytes = 0;
+    size_t newBytes = 0;
+    /// Total bytes of all records in this space, after the growth
+    size_t totalBytes = 0;
+};
+
+/// The current and peak bytes of a category (or of all records); the peak is of the sum, not the sum of peaks
+struct MemoryRollup {
+    size_t bytes[2] = {0, 0};
+    size_t peakBytes[2] = {0, 0};
+};
+
+class MemoryRegistry {
+  public:
+    MemoryRegistry() : m_start(std::chrono::steady_clock::now()) {}
+    ~MemoryRegistry() {}
+
+    MemoryRegistry(const MemoryRegistry&) = delete;
+    MemoryRegistry& operator=(const MemoryRegistry&) = delete;
+
+    /// Get the record of this name, making it (in this category) if it does not exist
+    MemoryRecord* Register(const std::string& name, const std::string& category) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(name);
+        if (it != m_index.end())
+            return &m_records[it->second];
+        m_records.emplace_back();
+        MemoryRecord& rec = m_records.back();
+        rec.name = name;
+        rec.category = category;
+        rec.registry = this;
+        m_index[name] = m_records.size() - 1;
+        return &rec;
+    }
+
+    /// Change the bytes of a record in a space by delta
+    void Update(MemoryRecord* rec, MEM_SPACE space, ssize_t delta) {
+        if (delta == 0)
+            return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const unsigned int s = (unsigned int)space;
+        const size_t oldBytes = rec->bytes[s];
+        rec->bytes[s] = (size_t)std::max<ssize_t>((ssize_t)oldBytes + delta, 0);
+        rec->peakBytes[s] = std::max(rec->peakBytes[s], rec->bytes[s]);
+        const ssize_t change = (ssize_t)rec->bytes[s] - (ssize_t)oldBytes;
+        addTo(m_categories[rec->category], s, change);
+        addTo(m_total, s, change);
+        if (change > 0) {
+            rec->numGrowths++;
+            MemoryEvent ev;
+            ev.seq = m_numEvents++;
+            ev.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+            ev.name = rec->name;
+            ev.note = rec->note;
+            ev.space = space;
+            ev.oldBytes = oldBytes;
+            ev.newBytes = rec->bytes[s];
+            ev.totalBytes = m_total.bytes[s];
+            m_timeline.push_back(std::move(ev));
+            while (m_timeline.size() > m_timelineCapacity)
+                m_timeline.pop_front();
+        }
+    }
+
+    /// Note what a record is currently used as
+    void SetNote(MemoryRecord* rec, const std::string& note) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        rec->note = note;
+    }
+
+    /// Set how many growth events the timeline keeps (the oldest are dropped first)
+    void SetTimelineCapacity(size_t n) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_timelineCapacity = n;
+        while (m_timeline.size() > m_timelineCapacity)
+            m_timeline.pop_front();
+    }
+
+    /// Get a copy of all records, in the order they were registered
+    std::vector<MemoryRecord> GetRecords() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return std::vector<MemoryRecord>(m_records.begin(), m_records.end());
+    }
+    /// Get the rollups of all categories
+    std::map<std::string, MemoryRollup> GetCategoryRollups() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_categories;
+    }
+    /// Get the rollup of all records
+    MemoryRollup GetTotal() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_total;
+    }
+    /// Get the growth events kept in the timeline, oldest first
+    std::vector<MemoryEvent> GetTimeline() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return std::vector<MemoryEvent>(m_timeline.begin(), m_timeline.end());
+    }
+
+    /// Write a JSON report: the totals, the category rollups, the records (largest device peak first, those with no
+    /// peak left out) and the timeline
+    void WriteReport(std::ostream& os) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto writeBytes = [&](const size_t* bytes, const size_t* peaks) {
+            os << "\"host_bytes\": " << bytes[0] << ", \"device_bytes\": " << bytes[1]
+               << ", \"peak_host_bytes\": " << peaks[0] << ", \"peak_device_bytes\": " << peaks[1];
+        };
+        os << "{\n  \"total\": {";
+        writeBytes(m_total.bytes, m_total.peakBytes);
+        os << "},\n  \"categories\": {";
+        bool first = true;
+        for (const auto& [cat, roll] : m_categories) {
+            os << (first ? "\n" : ",\n") << "    \"" << jsonEscape(cat) << "\": {";
+            writeBytes(roll.bytes, roll.peakBytes);
+            os << "}";
+            first = false;
+        }
+        os << "\n  },\n  \"arrays\": [";
+        std::vector<const MemoryRecord*> sorted;
+        for (const auto& rec : m_records) {
+            if (rec.peakBytes[0] > 0 || rec.peakBytes[1] > 0)
+                sorted.push_back(&rec);
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [](const MemoryRecord* a, const MemoryRecord* b) {
+            return a->peakBytes[1] + a->peakBytes[0] > b->peakBytes[1] + b->peakBytes[0];
+        });
+        first = true;
+        for (const auto* rec : sorted) {
+            os << (first ? "\n" : ",\n") << "    {\"name\": \"" << jsonEscape(rec->name) << "\", \"category\": \""
+               << jsonEscape(rec->category) << "\", \"note\": \"" << jsonEscape(rec->note) << "\", ";
+            writeBytes(rec->bytes, rec->peakBytes);
+            os << ", \"growths\": " << rec->numGrowths << "}";
+            first = false;
+        }
+        os << "\n  ],\n  \"timeline\": [";
+        first = true;
+        for (const auto& ev : m_timeline) {
+            os << (first ? "\n" : ",\n") << "    {\"seq\": " << ev.seq << ", \"time\": " << ev.time << ", \"name\": \""
+               << jsonEscape(ev.name) << "\", \"note\": \"" << jsonEscape(ev.note) << "\", \"space\": \""
+               << (ev.space == MEM_SPACE::HOST ? "host" : "device") << "\", \"old_bytes\": " << ev.oldBytes
+               << ", \"new_bytes\": " << ev.newBytes << ", \"total_bytes\": " << ev.totalBytes << "}";
+            first = false;
+        }
+        os << "\n  ],\n  \"dropped_events\": " << (m_numEvents - m_timeline.size()) << "\n}\n";
+    }
+
+  private:
+    mutable std::mutex m_mutex;
+    // A deque, so records do not move as more are registered
+    std::deque<MemoryRecord> m_records;
+    std::unordered_map<std::string, size_t> m_index;
+    std::map<std::string, MemoryRollup> m_categories;
+    MemoryRollup m_total;
+
+    std::deque<MemoryEvent> m_timeline;
+    size_t m_timelineCapacity = 4096;
+    uint64_t m_numEvents = 0;
+    std::chrono::steady_clock::time_point m_start;
+
+    static void addTo(MemoryRollup& roll, unsigned int s, ssize_t change) {
+        roll.bytes[s] = (size_t)std::max<ssize_t>((ssize_t)roll.bytes[s] + change, 0);
+        roll.peakBytes[s] = std::max(roll.peakBytes[s], roll.bytes[s]);
+    }
+
+    static std::string jsonEscape(const std::string& str) {
+        std::string out;
+        for (char c : str) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out;
+    }
+};
+
+// What the arrays call when their allocation changes
+inline void UpdateMemoryRecord(MemoryRecord* rec, MEM_SPACE space, ssize_t delta) {
+    if (rec)
+        rec->registry->Update(rec, space, delta);
+}
+
+// Bind an array to the record of its own name (with a prefix, such as that of its worker), in a category
+#define DEME_REGISTER_MEMORY(registry, prefix, arr, category) \
+    { (arr).setMemoryRecord((registry)->Register(std::string(prefix) + #arr, category)); }
+
+}  // namespace deme
+
+#endif
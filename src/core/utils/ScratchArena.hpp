@@ -0,0 +1,351 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_SCRATCH_ARENA_HPP
+#define DEME_SCRATCH_ARENA_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <core/utils/MemoryRegistry.hpp>
+
+namespace deme {
+
+// -----------------------------------------------------------------------------
+// Scratch arena
+//
+// Temporary arrays that live within one call (such as those of force collection) are taken from an arena, instead of
+// the name-keyed pools. An array is known by an integer handle, registered once, so no string is hashed when it is
+// taken. Arrays are taken inside a scope, and all those taken in a scope are given back when it closes, in reverse
+// order; an array is a range (offset) of one of a few large blocks, so arrays of disjoint lifetimes share memory.
+// When the arena runs out of room it adds a block (arrays already taken keep their pointers). When no scope is open,
+// the blocks are merged into one large enough for the largest use seen, and a block that stays much larger than what
+// is used gets shrunk, only after it has been so for a number of scopes in a row, so sizes that go up and down do not
+// keep the arena reallocating.
+// -----------------------------------------------------------------------------
+
+typedef unsigned int ScratchHandle;
+
+/// How a scratch arena grows and shrinks
+struct ScratchArenaPolicy {
+    /// Arrays start at multiples of this many bytes
+    size_t alignment = 256;
+    /// The smallest block allocated
+    size_t minBlockBytes = (size_t)1 << 20;
+    /// When out of room, the new block is at least (growFactor - 1) times the current capacity
+    double growFactor = 1.5;
+    /// When merging or shrinking, the block is this times the largest use it has to hold
+    double headroom = 1.25;
+    /// A block larger than shrinkRatio times the largest use of the last scopes...
+    double shrinkRatio = 4.;
+    /// ... for this many outermost scopes in a row, is shrunk
+    unsigned int shrinkPatience = 64;
+};
+
+/// What a scratch arena has done
+struct ScratchArenaStats {
+    /// Arrays taken
+    size_t numAllocs = 0;
+    /// Blocks allocated and freed through the backing allocator
+    size_t numBlockAllocs = 0;
+    size_t numBlockFrees = 0;
+    /// Times the blocks were merged into one, and times the block was shrunk
+    size_t numMerges = 0;
+    size_t numShrinks = 0;
+    /// Bytes of arrays currently taken (with alignment padding), and the most ever
+    size_t bytesInUse = 0;
+    size_t peakBytesInUse = 0;
+    /// Bytes of all blocks, and the number of blocks
+    size_t capacity = 0;
+    size_t numBlocks = 0;
+};
+
+/// What the arena knows of the array of a handle
+struct ScratchHandleStats {
+    std::string name;
+    size_t numAllocs = 0;
+    size_t lastBytes = 0;
+    size_t peakBytes = 0;
+};
+
+/// Backing allocator of host memory, for host-side use and for testing the arena without a device
+struct HostScratchAllocator {
+    static constexpr MEM_SPACE space = MEM_SPACE::HOST;
+    void* allocate(size_t bytes) { return ::operator new(bytes); }
+    void deallocate(void* ptr, size_t /*bytes*/) { ::operator delete(ptr); }
+};
+
+/// @brief Arena of temporary arrays taken by handle, in scopes.
+/// @tparam Allocator Backing allocator, with allocate(bytes), deallocate(ptr, bytes) and a MEM_SPACE named space.
+template <typename Allocator>
+class ScratchArena {
+  public:
+    /// Closes (gives back the arrays taken in) its scope when it goes out of scope
+    class Scope {
+      public:
+        ~Scope() { m_arena.closeScope(m_mark); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        friend class ScratchArena;
+        Scope(ScratchArena& arena) : m_arena(arena), m_mark(arena.openScope()) {}
+        ScratchArena& m_arena;
+        size_t m_mark;
+    };
+
+    explicit ScratchArena(size_t* external_counter = nullptr, const Allocator& alloc = Allocator())
+        : m_alloc(alloc), m_mem_counter(external_counter) {}
+    ~ScratchArena() { releaseAll(); }
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    /// Get the handle of this name, registering it if it is new; handles are numbered from 0 in registration order
+    ScratchHandle registerHandle(const std::string& name) {
+        auto it = m_name_to_handle.find(name);
+        if (it != m_name_to_handle.end())
+            return it->second;
+        const ScratchHandle h = (ScratchHandle)m_handles.size();
+        m_handles.emplace_back();
+        m_handles.back().name = name;
+        m_live.push_back(nullptr);
+        m_name_to_handle[name] = h;
+        return h;
+    }
+    size_t getNumHandles() const { return m_handles.size(); }
+
+    /// Open a scope; the arrays taken until it is destroyed are given back then
+    Scope scope() { return Scope(*this); }
+
+    /// Take an array of at least this many bytes for a handle, in the innermost scope. The handle must not have an
+    /// array already.
+    void* allocate(ScratchHandle h, size_t bytes) {
+        checkHandle(h);
+        if (m_scope_marks.empty()) {
+            std::stringstream ss;
+            ss << "Scratch array " << m_handles[h].name << " is taken outside of any scope." << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+        if (m_live[h]) {
+            std::stringstream ss;
+            ss << "Scratch array " << m_handles[h].name << " is taken again before its scope closed." << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+        // Find room in the current block or those after it, or add a block
+        size_t b = m_current_block, offset = 0;
+        for (; b < m_blocks.size(); b++) {
+            offset = alignedOffset(m_blocks[b], b == m_current_block ? m_blocks[b].used : 0);
+            if (offset + bytes <= m_blocks[b].size)
+                break;
+        }
+        if (b == m_blocks.size()) {
+            const size_t grow = (size_t)((m_policy.growFactor - 1.) * m_stats.capacity);
+            addBlock(std::max({bytes + m_policy.alignment, m_policy.minBlockBytes, grow}));
+            offset = alignedOffset(m_blocks[b], 0);
+        }
+        // Remember where we were, so giving this array back goes back there
+        Taken t;
+        t.handle = h;
+        t.prevBlock = m_current_block;
+        t.prevUsed = m_blocks[m_current_block].used;
+        t.bytesInUseBefore = m_stats.bytesInUse;
+        m_taken.push_back(t);
+
+        // The tail left in a block we moved past is not counted, as a merged block would not have it
+        const size_t prevEnd = (b == m_current_block) ? m_blocks[b].used : 0;
+        m_stats.bytesInUse += offset + bytes - prevEnd;
+        m_current_block = b;
+        m_blocks[b].used = offset + bytes;
+        m_stats.peakBytesInUse = std::max(m_stats.peakBytesInUse, m_stats.bytesInUse);
+        m_cycle_peak = std::max(m_cycle_peak, m_stats.bytesInUse);
+        m_stats.numAllocs++;
+        m_handles[h].numAllocs++;
+        m_handles[h].lastBytes = bytes;
+        m_handles[h].peakBytes = std::max(m_handles[h].peakBytes, bytes);
+
+        m_live[h] = m_blocks[b].ptr + offset;
+        return m_live[h];
+    }
+
+    /// The array a handle currently has (nullptr if none)
+    void* get(ScratchHandle h) const {
+        checkHandle(h);
+        return m_live[h];
+    }
+
+    void setPolicy(const ScratchArenaPolicy& policy) {
+        if (policy.alignment == 0 || (policy.alignment & (policy.alignment - 1)) != 0) {
+            std::stringstream ss;
+            ss << "Scratch arena alignment must be a power of 2, not " << policy.alignment << "." << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+        m_policy = policy;
+    }
+    const ScratchArenaPolicy& getPolicy() const { return m_policy; }
+    const ScratchArenaStats& getStats() const { return m_stats; }
+    const ScratchHandleStats& getHandleStats(ScratchHandle h) const {
+        checkHandle(h);
+        return m_handles[h];
+    }
+
+    void setMemoryCounter(size_t* counter) { m_mem_counter = counter; }
+    // Bind to a record of a memory registry (nullptr to unbind)
+    void setMemoryRecord(MemoryRecord* rec) {
+        if (rec == m_mem_record)
+            return;
+        UpdateMemoryRecord(m_mem_record, Allocator::space, -(ssize_t)m_stats.capacity);
+        m_mem_record = rec;
+        UpdateMemoryRecord(m_mem_record, Allocator::space, (ssize_t)m_stats.capacity);
+    }
+
+    /// Free all blocks; no scope may be open
+    void releaseAll() {
+        for (auto& block : m_blocks)
+            freeBlock(block);
+        m_blocks.clear();
+        m_current_block = 0;
+    }
+
+    void printStatus() const {
+        printf("Scratch arena: %zu block(s), %zu bytes, %zu bytes in use (peak %zu)\n", m_stats.numBlocks,
+               m_stats.capacity, m_stats.bytesInUse, m_stats.peakBytesInUse);
+        for (const auto& hs : m_handles) {
+            printf("  %s: %zu allocations, last %zu bytes, peak %zu bytes\n", hs.name.c_str(), hs.numAllocs,
+                   hs.lastBytes, hs.peakBytes);
+        }
+    }
+
+  private:
+    struct Block {
+        char* ptr = nullptr;
+        size_t size = 0;
+        size_t used = 0;
+    };
+    // An array taken, and where the arena was before it
+    struct Taken {
+        ScratchHandle handle;
+        size_t prevBlock;
+        size_t prevUsed;
+        size_t bytesInUseBefore;
+    };
+
+    Allocator m_alloc;
+    ScratchArenaPolicy m_policy;
+    ScratchArenaStats m_stats;
+
+    std::vector<Block> m_blocks;
+    size_t m_current_block = 0;
+    std::vector<Taken> m_taken;
+    std::vector<size_t> m_scope_marks;
+
+    std::vector<ScratchHandleStats> m_handles;
+    std::vector<void*> m_live;
+    std::unordered_map<std::string, ScratchHandle> m_name_to_handle;
+
+    // The largest use in the current outermost scope, and in the outermost scopes since the last resize
+    size_t m_cycle_peak = 0;
+    size_t m_window_peak = 0;
+    unsigned int m_num_oversized_cycles = 0;
+
+    size_t* m_mem_counter = nullptr;
+    MemoryRecord* m_mem_record = nullptr;
+
+    void checkHandle(ScratchHandle h) const {
+        if (h >= m_handles.size()) {
+            std::stringstream ss;
+            ss << "Scratch handle " << h << " is not registered." << std::endl;
+            throw std::runtime_error(ss.str());
+        }
+    }
+
+    size_t alignedOffset(const Block& block, size_t used) const {
+        const uintptr_t addr = (uintptr_t)block.ptr + used;
+        const uintptr_t aligned = (addr + m_policy.alignment - 1) & ~(uintptr_t)(m_policy.alignment - 1);
+        return used + (size_t)(aligned - addr);
+    }
+
+    void addBlock(size_t bytes) {
+        Block block;
+        block.ptr = (char*)m_alloc.allocate(bytes);
+        block.size = bytes;
+        m_blocks.push_back(block);
+        m_stats.numBlockAllocs++;
+        m_stats.numBlocks++;
+        m_stats.capacity += bytes;
+        updateMemCounter((ssize_t)bytes);
+    }
+
+    void freeBlock(Block& block) {
+        m_alloc.deallocate(block.ptr, block.size);
+        m_stats.numBlockFrees++;
+        m_stats.numBlocks--;
+        m_stats.capacity -= block.size;
+        updateMemCounter(-(ssize_t)block.size);
+        block.ptr = nullptr;
+    }
+
+    void updateMemCounter(ssize_t delta) {
+        if (m_mem_counter)
+            *m_mem_counter += delta;
+        UpdateMemoryRecord(m_mem_record, Allocator::space, delta);
+    }
+
+    size_t openScope() {
+        m_scope_marks.push_back(m_taken.size());
+        return m_taken.size();
+    }
+
+    void closeScope(size_t mark) {
+        // Scopes are objects with automatic storage, so they close in reverse order
+        while (m_taken.size() > mark) {
+            const Taken& t = m_taken.back();
+            m_live[t.handle] = nullptr;
+            m_blocks[m_current_block].used = 0;
+            m_current_block = t.prevBlock;
+            m_blocks[m_current_block].used = t.prevUsed;
+            m_stats.bytesInUse = t.bytesInUseBefore;
+            m_taken.pop_back();
+        }
+        m_scope_marks.pop_back();
+        if (m_scope_marks.empty())
+            adjustBlocks();
+    }
+
+    // With nothing taken, merge the blocks, or shrink the one block if it has long been too large
+    void adjustBlocks() {
+        const size_t cycle_peak = m_cycle_peak;
+        m_cycle_peak = 0;
+        m_window_peak = std::max(m_window_peak, cycle_peak);
+        const size_t target = std::max((size_t)(m_policy.headroom * m_window_peak), m_policy.minBlockBytes);
+        if (m_blocks.size() > 1) {
+            // Blocks were added mid-scope; one that holds all they held is better next time
+            m_stats.numMerges++;
+        } else if (m_blocks.size() == 1 && m_stats.capacity > m_policy.shrinkRatio * m_window_peak &&
+                   target < m_stats.capacity) {
+            if (++m_num_oversized_cycles < m_policy.shrinkPatience)
+                return;
+            m_stats.numShrinks++;
+        } else {
+            m_num_oversized_cycles = 0;
+            m_window_peak = 0;
+            return;
+        }
+        releaseAll();
+        addBlock(target);
+        m_num_oversized_cycles = 0;
+        m_window_peak = 0;
+    }
+};
+
+}  // namespace deme
+
+#endif
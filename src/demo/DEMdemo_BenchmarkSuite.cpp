@@ -0,0 +1,757 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// A benchmark suite. It times the host-only subsystems (sampling, mesh loading,
+// CSV I/O, JIT source generation and entity population), and, if a GPU is
+// present, the setup, initialization and dynamics of canonical scenes built from
+// the demos: a settling box, a rotating drum, a hopper discharge, a mesh plow and
+// a polydisperse bed. The problem size is the number of particles of each scene.
+// Results are written to a JSON file together with fingerprints of the hardware
+// and of the configuration, and can be compared against a stored baseline.
+//
+// Usage: DEMdemo_BenchmarkSuite [--scene NAME|all] [--size N] [--time T]
+//        [--repeat R] [--host-only] [--output FILE] [--baseline FILE]
+//        [--tolerance F]
+// With --baseline, the exit code is 1 if any timing regressed by more than
+// the tolerance (a fraction, 0.15 by default).
+// =============================================================================
+
+#include <core/ApiVersion.h>
+#include <core/utils/ThreadManager.h>
+#include <DEM/API.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <DEM/utils/Samplers.hpp>
+
+#include <cuda_runtime_api.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace deme;
+using namespace std::filesystem;
+
+const std::vector<std::string> SCENES = {"settling_box", "rotating_drum", "hopper_discharge", "mesh_plow",
+                                         "polydisperse_bed"};
+
+struct BenchConfig {
+    std::string scene = "all";
+    // Number of particles of each scene (and of the host-only subsystems that scale)
+    size_t size = 20000;
+    // Simulated time of the dynamics phase of each scene
+    double time = 0.02;
+    // Times each host-only subsystem is run (the best is reported)
+    unsigned int repeat = 3;
+    bool hostOnly = false;
+    std::string output = "DEMdemo_BenchmarkSuite.json";
+    std::string baseline;
+    double tolerance = 0.15;
+};
+
+struct BenchEntry {
+    std::string name;
+    double seconds = 0.;
+    double meanSeconds = 0.;
+    // What was processed (particles, triangles, bytes...), for throughput
+    size_t items = 0;
+};
+
+struct SceneSetup {
+    size_t numParticles = 0;
+    double stepSize = 0.;
+};
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+double SecondsSince(const std::chrono::high_resolution_clock::time_point& start) {
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Run f repeat times, recording the best and the mean wall time; f returns the number of items it processed
+void TimeRepeated(std::vector<BenchEntry>& results,
+                  const std::string& name,
+                  unsigned int repeat,
+                  const std::function<size_t()>& f) {
+    BenchEntry entry;
+    entry.name = name;
+    entry.seconds = DEME_HUGE_FLOAT;
+    for (unsigned int i = 0; i < repeat; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        entry.items = f();
+        double t = SecondsSince(start);
+        entry.seconds = std::min(entry.seconds, t);
+        entry.meanSeconds += t / repeat;
+    }
+    results.push_back(entry);
+}
+
+void Record(std::vector<BenchEntry>& results, const std::string& name, double seconds, size_t items) {
+    BenchEntry entry;
+    entry.name = name;
+    entry.seconds = seconds;
+    entry.meanSeconds = seconds;
+    entry.items = items;
+    results.push_back(entry);
+}
+
+// Keep the n points lowest in Z, so a generously sampled region is filled from the bottom up to the problem size
+std::vector<float3> KeepLowest(std::vector<float3> xyz, size_t n) {
+    if (xyz.size() > n) {
+        std::stable_sort(xyz.begin(), xyz.end(), [](const float3& a, const float3& b) { return a.z < b.z; });
+        xyz.resize(n);
+    }
+    return xyz;
+}
+
+float MaxZ(const std::vector<float3>& xyz) {
+    float z = -DEME_HUGE_FLOAT;
+    for (const auto& p : xyz)
+        z = std::max(z, p.z);
+    return z;
+}
+
+// 64-bit FNV-1a, stable across platforms and compilers (unlike std::hash)
+std::string Fingerprint(const std::map<std::string, std::string>& fields) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const auto& [key, val] : fields) {
+        for (char c : key + "=" + val + ";") {
+            hash ^= (unsigned char)c;
+            hash *= 1099511628211ULL;
+        }
+    }
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash);
+    return std::string(buf);
+}
+
+std::string JsonEscape(const std::string& str) {
+    std::string out;
+    for (char c : str) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// =============================================================================
+// Hardware and configuration fingerprints
+// =============================================================================
+
+std::string CpuModel() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos)
+                return line.substr(line.find_first_not_of(" \t", colon + 1));
+        }
+    }
+    return "unknown";
+}
+
+int NumDevices() {
+    int ndevices = 0;
+    if (cudaGetDeviceCount(&ndevices) != cudaSuccess)
+        return 0;
+    return ndevices;
+}
+
+std::map<std::string, std::string> HardwareInfo() {
+    std::map<std::string, std::string> info;
+    info["cpu"] = CpuModel();
+    info["cpu_threads"] = std::to_string(std::thread::hardware_concurrency());
+    const int ndevices = NumDevices();
+    info["gpu_count"] = std::to_string(ndevices);
+    std::string gpus;
+    for (int i = 0; i < ndevices; i++) {
+        cudaDeviceProp prop;
+        if (cudaGetDeviceProperties(&prop, i) != cudaSuccess)
+            continue;
+        gpus += (i > 0 ? "; " : "") + std::string(prop.name) + " (sm_" + std::to_string(prop.major) +
+                std::to_string(prop.minor) + ", " + std::to_string(prop.totalGlobalMem >> 20) + " MiB)";
+    }
+    info["gpus"] = ndevices > 0 ? gpus : "none";
+#if defined(_WIN32) || defined(_WIN64)
+    info["os"] = "Windows";
+#elif defined(__APPLE__)
+    info["os"] = "macOS";
+#else
+    info["os"] = "Linux";
+#endif
+    return info;
+}
+
+std::map<std::string, std::string> ConfigInfo(const BenchConfig& cfg, bool run_scenes) {
+    std::map<std::string, std::string> info;
+    info["scenes"] = run_scenes ? cfg.scene : "none";
+    info["size"] = std::to_string(cfg.size);
+    info["time"] = to_string_with_precision(cfg.time, 6);
+    info["repeat"] = std::to_string(cfg.repeat);
+    info["deme_version"] = std::to_string(DEME_VERSION_MAJOR) + "." + std::to_string(DEME_VERSION_MINOR) + "." +
+                           std::to_string(DEME_VERSION_PATCH);
+#if defined(__VERSION__)
+    info["compiler"] = __VERSION__;
+#elif defined(_MSC_VER)
+    info["compiler"] = "MSVC " + std::to_string(_MSC_VER);
+#else
+    info["compiler"] = "unknown";
+#endif
+#ifdef NDEBUG
+    info["assertions"] = "off";
+#else
+    info["assertions"] = "on";
+#endif
+#ifdef DEME_USE_MANAGED_ARRAYS
+    info["managed_arrays"] = "on";
+#else
+    info["managed_arrays"] = "off";
+#endif
+#ifdef DEME_USE_WIDE_INDICES
+    info["wide_indices"] = "on";
+#else
+    info["wide_indices"] = "off";
+#endif
+    return info;
+}
+
+// =============================================================================
+// Host-only subsystems
+// =============================================================================
+
+void RunHostBenchmarks(const BenchConfig& cfg, std::vector<BenchEntry>& results) {
+    // Sampling: fill a box of unit spacing with about size points
+    const float half = 0.5f * std::cbrt((float)cfg.size);
+    const float3 box_half = make_float3(half, half, half);
+    TimeRepeated(results, "host/sampling/pd", cfg.repeat, [&]() {
+        PDSampler sampler(1.f);
+        return sampler.SampleBox(make_float3(0), box_half).size();
+    });
+    TimeRepeated(results, "host/sampling/hcp", cfg.repeat, [&]() {
+        HCPSampler sampler(1.f);
+        return sampler.SampleBox(make_float3(0), box_half).size();
+    });
+    TimeRepeated(results, "host/sampling/grid", cfg.repeat,
+                 [&]() { return DEMBoxGridSampler(make_float3(0), box_half, 1.f).size(); });
+
+    // Mesh loading: the largest meshes the demos use
+    TimeRepeated(results, "host/mesh_loading", cfg.repeat, [&]() {
+        size_t num_tri = 0;
+        for (const auto& name : {"mesh/excavator.obj", "mesh/internal_mixer.obj", "mesh/funnel.obj"}) {
+            DEMMeshConnected mesh;
+            mesh.LoadWavefrontMesh(GetDEMEDataFile(name));
+            num_tri += mesh.GetNumTriangles();
+        }
+        return num_tri;
+    });
+
+    // CSV I/O: size clumps in the format of the solver's clump output file
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> unif(-half, half);
+    std::vector<float3> xyz(cfg.size);
+    for (auto& p : xyz)
+        p = make_float3(unif(gen), unif(gen), unif(gen));
+    path csv_file = temp_directory_path() / "DEMdemo_BenchmarkSuite_clumps.csv";
+    TimeRepeated(results, "host/csv_io/write", cfg.repeat, [&]() {
+        std::ofstream out(csv_file);
+        out << OUTPUT_FILE_X_COL_NAME + "," + OUTPUT_FILE_Y_COL_NAME + "," + OUTPUT_FILE_Z_COL_NAME +
+                   ",Qw,Qx,Qy,Qz," + OUTPUT_FILE_CLUMP_TYPE_NAME
+            << "\n";
+        for (size_t i = 0; i < xyz.size(); i++) {
+            out << xyz[i].x << "," << xyz[i].y << "," << xyz[i].z << ",1,0,0,0,type_" << i % 4 << "\n";
+        }
+        return xyz.size();
+    });
+    TimeRepeated(results, "host/csv_io/read", cfg.repeat, [&]() {
+        size_t n = 0;
+        for (const auto& [name, points] : DEMSolver::ReadClumpXyzFromCsv(csv_file.string()))
+            n += points.size();
+        return n;
+    });
+    remove(csv_file);
+
+    // JIT source generation: the policy sources are read and compacted, then substituted into the force kernel, as
+    // the solver and JitHelper::buildProgram do before handing it to the compiler
+    TimeRepeated(results, "host/jit_source_generation", cfg.repeat, [&]() {
+        std::string code = read_file_to_string(RuntimeDataHelper::data_path / "kernel" / "DEMCalcForceKernels.cu");
+        std::unordered_map<std::string, std::string> subs;
+        subs["_DEMForceModel_"] = compact_code(HERTZIAN_FORCE_MODEL());
+        subs["_clumpTemplateDefs_;"] = compact_code(CLUMP_COMPONENT_DEFINITIONS_JITIFIED());
+        subs["_componentAcqStrat_;"] = compact_code(CLUMP_COMPONENT_ACQUISITION_ALL_JITIFIED());
+        subs["_massDefs_;"] = compact_code(MASS_DEFINITIONS_JITIFIED());
+        subs["_moiDefs_;"] = compact_code(MOI_DEFINITIONS_JITIFIED());
+        subs["_massAcqStrat_;"] = compact_code(MASS_ACQUISITION_JITIFIED());
+        subs["_forceModelPrerequisites_;"] = " ";
+        subs["_forceModelContactWildcardAcq_;"] = " ";
+        subs["_forceModelContactWildcardWrite_;"] = " ";
+        subs["_forceModelContactWildcardDestroy_;"] = " ";
+        for (const auto& sub : subs)
+            code = std::regex_replace(code, std::regex(sub.first), sub.second);
+        return code.size();
+    });
+
+    // Entity population: a batch of clumps set up as AddClumps does
+    auto clump_template = std::make_shared<DEMClumpTemplate>();
+    clump_template->mass = 1.f;
+    clump_template->MOI = make_float3(0.1f);
+    clump_template->radii = {0.5f, 0.4f, 0.4f};
+    clump_template->relPos = {make_float3(0), make_float3(0.3f, 0, 0), make_float3(-0.3f, 0, 0)};
+    clump_template->nComp = 3;
+    TimeRepeated(results, "host/entity_population", cfg.repeat, [&]() {
+        DEMClumpBatch batch(xyz.size());
+        batch.SetTypes(clump_template);
+        batch.SetPos(xyz);
+        batch.SetVel(make_float3(0, 0, -0.5f));
+        batch.SetFamilies(std::vector<unsigned int>(xyz.size(), 1));
+        batch.nSpheres = xyz.size() * clump_template->nComp;
+        return batch.GetNumClumps();
+    });
+}
+
+// =============================================================================
+// Scenes
+// =============================================================================
+
+// Monodisperse spheres settling in a box whose footprint grows with the problem size, like DEMdemo_TestPack
+SceneSetup BuildSettlingBox(DEMSolver& DEMSim, const BenchConfig& cfg) {
+    auto mat_type = DEMSim.LoadMaterial({{"E", 1e8}, {"nu", 0.3}, {"CoR", 0.5}, {"mu", 0.5}});
+    const float rad = 0.01;
+    auto sphere_template = DEMSim.LoadSphereType(2.6e3 * 4. / 3. * PI * rad * rad * rad, rad, mat_type);
+
+    const float spacing = 2.1 * rad;
+    const float width = spacing * std::cbrt((float)cfg.size);
+    HCPSampler sampler(spacing);
+    auto xyz = KeepLowest(sampler.SampleBox(make_float3(0, 0, 2. * width),
+                                            make_float3(width / 2. - spacing, width / 2. - spacing, 2. * width)),
+                          cfg.size);
+    DEMSim.AddClumps(sphere_template, xyz);
+
+    DEMSim.InstructBoxDomainDimension({-width / 2., width / 2.}, {-width / 2., width / 2.}, {0, MaxZ(xyz) + width});
+    DEMSim.InstructBoxDomainBoundingBC("top_open", mat_type);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    DEMSim.SetMaxVelocity(10.);
+    return {xyz.size(), 5e-6};
+}
+
+// Ellipsoids in a drum rotating about X, like DEMdemo_RotatingDrum; the particles shrink as the problem size grows
+SceneSetup BuildRotatingDrum(DEMSolver& DEMSim, const BenchConfig& cfg) {
+    DEMSim.DisableJitifyClumpTemplates();
+    auto mat_type_sand = DEMSim.LoadMaterial({{"E", 1e9}, {"nu", 0.3}, {"CoR", 0.6}, {"mu", 0.4}, {"Crr", 0.01}});
+    auto mat_type_drum = DEMSim.LoadMaterial({{"E", 2e9}, {"nu", 0.3}, {"CoR", 0.6}, {"mu", 0.8}, {"Crr", 0.01}});
+    DEMSim.SetMaterialPropertyPair("mu", mat_type_sand, mat_type_drum, 0.8);
+
+    const float CylRad = 2.0, CylHeight = 1.0, CylParticleRad = 0.05, CylMass = 1.0;
+    const float safe_delta = 0.03;
+    const float sample_halfheight = CylHeight / 2.0 - 3.0 * safe_delta;
+    const float sample_halfwidth = CylRad / 1.5;
+    // The grid spacing of the demo is (cbrt(2) * 2.1, cbrt(2) * 2.1, 4.2) times the scaling
+    const float cell = std::cbrt(2.f) * 2.1f;
+    const float scaling = std::cbrt(8. * sample_halfheight * sample_halfwidth * sample_halfwidth /
+                                    (cfg.size * cell * cell * 4.2));
+
+    std::vector<float> radii = {1.0, 0.88, 0.64, 0.88, 0.64};
+    std::vector<float3> relPos = {make_float3(0, 0, 0), make_float3(0, 0, 0.86), make_float3(0, 0, 1.44),
+                                  make_float3(0, 0, -0.86), make_float3(0, 0, -1.44)};
+    float mass = 2.6e3 * 4. / 3. * PI * 2 * 1 * 1;
+    float3 MOI = make_float3(1. / 5. * mass * (1 * 1 + 2 * 2), 1. / 5. * mass * (1 * 1 + 2 * 2),
+                             1. / 5. * mass * (1 * 1 + 1 * 1));
+    auto ellipsoid = DEMSim.LoadClumpType(mass, MOI, radii, relPos, mat_type_sand);
+    ellipsoid->Scale(scaling);
+
+    auto Drum_particles = DEMCylSurfSampler(make_float3(0), make_float3(1, 0, 0), CylRad, CylHeight, CylParticleRad);
+    float IXX = CylMass * CylRad * CylRad;
+    float IYY = (CylMass / 12) * (3 * CylRad * CylRad + CylHeight * CylHeight);
+    auto Drum_template =
+        DEMSim.LoadClumpType(CylMass, make_float3(IXX, IYY, IYY),
+                             std::vector<float>(Drum_particles.size(), CylParticleRad), Drum_particles, mat_type_drum);
+
+    auto xyz = KeepLowest(DEMBoxGridSampler(make_float3(0),
+                                            make_float3(sample_halfheight, sample_halfwidth, sample_halfwidth),
+                                            scaling * cell, scaling * cell, scaling * 4.2),
+                          cfg.size);
+    DEMSim.AddClumps(ellipsoid, xyz);
+
+    const unsigned int drum_family = 100;
+    auto Drum = DEMSim.AddClumps(Drum_template, make_float3(0));
+    Drum->SetFamilies(drum_family);
+    DEMSim.SetFamilyPrescribedAngVel(drum_family, "1.0", "0", "0");
+    DEMSim.DisableContactBetweenFamilies(drum_family, drum_family);
+    auto planes = DEMSim.AddExternalObject();
+    planes->AddPlane(make_float3(CylHeight / 2. - safe_delta, 0, 0), make_float3(-1, 0, 0), mat_type_drum);
+    planes->AddPlane(make_float3(-CylHeight / 2. + safe_delta, 0, 0), make_float3(1, 0, 0), mat_type_drum);
+    planes->SetFamily(drum_family);
+
+    DEMSim.InstructBoxDomainDimension(5, 5, 5);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    DEMSim.SetMaxVelocity(6.);
+    return {xyz.size(), 5e-6};
+}
+
+// Random clumps poured through a funnel, like DEMdemo_Repose; the column above the funnel grows with the problem size
+SceneSetup BuildHopperDischarge(DEMSolver& DEMSim, const BenchConfig& cfg) {
+    DEMSim.UseFrictionalHertzianModel();
+    auto mat_type_walls = DEMSim.LoadMaterial({{"E", 1e8}, {"nu", 0.3}, {"CoR", 0.3}, {"mu", 1}});
+    auto mat_type_particles = DEMSim.LoadMaterial({{"E", 1e9}, {"nu", 0.3}, {"CoR", 0.3}, {"mu", 1}});
+
+    auto funnel = DEMSim.AddWavefrontMeshObject(GetDEMEDataFile("mesh/funnel.obj"), mat_type_walls);
+    funnel->Scale(0.15);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> unif(0.f, 1.f);
+    const float min_rad = 0.02, max_rad = 0.04;
+    std::vector<std::shared_ptr<DEMClumpTemplate>> clump_types;
+    for (int i = 0; i < 6; i++) {
+        int num_sphere = i % 5 + 1;
+        float mass = 0.8 * (float)num_sphere;
+        float3 MOI = make_float3(2e-5, 1.5e-5, 1.8e-5) * (float)num_sphere * 1600.;
+        std::vector<float> radii;
+        std::vector<float3> relPos;
+        for (int j = 0; j < num_sphere; j++) {
+            radii.push_back(min_rad + unif(gen) * (max_rad - min_rad));
+            relPos.push_back(j == 0 ? make_float3(0)
+                                    : make_float3(unif(gen) - 0.5f, unif(gen) - 0.5f, unif(gen) - 0.5f) * 0.04f);
+        }
+        clump_types.push_back(DEMSim.LoadClumpType(mass, MOI, radii, relPos, mat_type_particles));
+    }
+
+    const float spacing = 0.16, fill_width = 1.5;
+    PDSampler sampler(spacing);
+    std::vector<float3> xyz;
+    for (float layer_z = 0; xyz.size() < cfg.size; layer_z += spacing) {
+        auto layer_xyz = sampler.SampleCylinderZ(make_float3(0, 0, fill_width + spacing + layer_z), fill_width, 0);
+        xyz.insert(xyz.end(), layer_xyz.begin(), layer_xyz.end());
+    }
+    xyz.resize(cfg.size);
+    std::vector<std::shared_ptr<DEMClumpTemplate>> types;
+    for (size_t i = 0; i < xyz.size(); i++)
+        types.push_back(clump_types.at(i % clump_types.size()));
+    DEMSim.AddClumps(types, xyz);
+
+    DEMSim.InstructBoxDomainDimension({-5, 5}, {-5, 5}, {-5, MaxZ(xyz) + 5.f});
+    DEMSim.InstructBoxDomainBoundingBC("top_open", mat_type_walls);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    DEMSim.SetMaxVelocity(25.);
+    return {xyz.size(), 5e-6};
+}
+
+// An excavator mesh plowing through a bed of ellipsoids, like DEMdemo_Plow; the particles shrink as the problem size
+// grows
+SceneSetup BuildMeshPlow(DEMSolver& DEMSim, const BenchConfig& cfg) {
+    DEMSim.UseFrictionalHertzianModel();
+    const float world_halfsize = 5.;
+    auto mat_type_walls = DEMSim.LoadMaterial({{"E", 1e8}, {"nu", 0.3}, {"CoR", 0.3}, {"mu", 0.5}});
+    auto mat_type_particles = DEMSim.LoadMaterial({{"E", 1e9}, {"nu", 0.3}, {"CoR", 0.7}, {"mu", 0.5}});
+    DEMSim.SetMaterialPropertyPair("CoR", mat_type_walls, mat_type_particles, 0.3);
+
+    // The demo fills a (2 * fill_halfwidth)^2 * fill_height region with a spacing of 2, 2 and 4.5 times the scaling
+    const float fill_height = world_halfsize * 1.5;
+    const float scaling =
+        std::cbrt(4. * (world_halfsize - 0.1) * (world_halfsize - 0.1) * fill_height / (cfg.size * 2. * 2. * 4.5));
+    float mass = 2.6e3 * 4. / 3. * PI * 2 * 1 * 1;
+    float3 MOI = make_float3(1. / 5. * mass * (1 * 1 + 2 * 2), 1. / 5. * mass * (1 * 1 + 2 * 2),
+                             1. / 5. * mass * (1 * 1 + 1 * 1));
+    auto my_template =
+        DEMSim.LoadClumpType(mass, MOI, GetDEMEDataFile("clumps/ellipsoid_2_1_1.csv"), mat_type_particles);
+    my_template->Scale(scaling);
+
+    auto excavator = DEMSim.AddWavefrontMeshObject(GetDEMEDataFile("mesh/excavator.obj"), mat_type_walls);
+    excavator->Scale(1. / 20.);
+    excavator->SetInitPos(make_float3(0, 0.6 * world_halfsize, 0.2 * world_halfsize));
+    excavator->SetInitQuat(make_float4(0.7071, 0, 0, 0.7071));
+    excavator->SetFamily(1);
+    // Plow from the start, rotating about the point (0, 0, 0.4 * world_halfsize)
+    DEMSim.SetFamilyPrescribedLinVel(1, "0",
+                                     "-" + to_string_with_precision(0.3 * world_halfsize) + " * sin(3.14 / 4. * t)",
+                                     "-" + to_string_with_precision(0.3 * world_halfsize) + " * cos(3.14 / 4. * t)");
+    DEMSim.SetFamilyPrescribedAngVel(1, "-3.14 / 4", "0", "0");
+
+    const float fill_halfwidth = world_halfsize - 4. * scaling;
+    const float fill_bottom = -world_halfsize + 3. * scaling;
+    PDSampler sampler(2. * scaling);
+    std::vector<float3> xyz;
+    for (float layer_z = 0; xyz.size() < cfg.size; layer_z += 4.5 * scaling) {
+        auto layer_xyz = sampler.SampleBox(make_float3(0, 0, fill_bottom + layer_z),
+                                           make_float3(fill_halfwidth, fill_halfwidth, 0));
+        xyz.insert(xyz.end(), layer_xyz.begin(), layer_xyz.end());
+    }
+    xyz.resize(cfg.size);
+    DEMSim.AddClumps(my_template, xyz);
+
+    DEMSim.InstructBoxDomainDimension({-world_halfsize, world_halfsize}, {-world_halfsize, world_halfsize},
+                                      {-world_halfsize, std::max(world_halfsize, MaxZ(xyz) + 1.f)});
+    DEMSim.InstructBoxDomainBoundingBC("top_open", mat_type_walls);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    return {xyz.size(), 5e-6};
+}
+
+// GRC-like clumps of four sizes settling in a box whose footprint grows with the problem size, like
+// DEMdemo_GRCPrep_Part1
+SceneSetup BuildPolydisperseBed(DEMSolver& DEMSim, const BenchConfig& cfg) {
+    auto mat_type_terrain = DEMSim.LoadMaterial({{"E", 1e9}, {"nu", 0.3}, {"CoR", 0.3}, {"mu", 0.5}});
+
+    const float terrain_density = 2.6e3;
+    float mass1 = terrain_density * 4.2520508;
+    float3 MOI1 = make_float3(1.6850426, 1.6375114, 2.1187753) * terrain_density;
+    float mass2 = terrain_density * 2.1670011;
+    float3 MOI2 = make_float3(0.57402126, 0.60616378, 0.92890173) * terrain_density;
+    std::vector<double> scales = {0.014, 0.0075833, 0.0044, 0.003};
+    auto template2 =
+        DEMSim.LoadClumpType(mass2, MOI2, GetDEMEDataFile("clumps/triangular_flat_6comp.csv"), mat_type_terrain);
+    auto template1 =
+        DEMSim.LoadClumpType(mass1, MOI1, GetDEMEDataFile("clumps/triangular_flat.csv"), mat_type_terrain);
+    std::vector<std::shared_ptr<DEMClumpTemplate>> templates = {template2, DEMSim.Duplicate(template2), template1,
+                                                                DEMSim.Duplicate(template1)};
+    for (size_t i = 0; i < scales.size(); i++) {
+        templates.at(i)->Scale(scales.at(i));
+    }
+
+    const float spacing = scales.at(0) * 2.2;
+    const float width = spacing * std::cbrt((float)cfg.size);
+    HCPSampler sampler(spacing);
+    auto xyz = KeepLowest(sampler.SampleBox(make_float3(0, 0, 2. * width),
+                                            make_float3(width / 2. - spacing, width / 2. - spacing, 2. * width)),
+                          cfg.size);
+    std::mt19937 gen(759);
+    std::discrete_distribution<int> pick({0.1, 0.2, 0.3, 0.4});
+    std::vector<std::shared_ptr<DEMClumpTemplate>> types;
+    for (size_t i = 0; i < xyz.size(); i++) {
+        types.push_back(templates.at(pick(gen)));
+    }
+    DEMSim.AddClumps(types, xyz);
+
+    DEMSim.InstructBoxDomainDimension({-width / 2., width / 2.}, {-width / 2., width / 2.}, {0, MaxZ(xyz) + width});
+    DEMSim.InstructBoxDomainBoundingBC("top_open", mat_type_terrain);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    DEMSim.SetMaxVelocity(15.);
+    return {xyz.size(), 2e-6};
+}
+
+// Time the setup (entity population on the solver), the initialization (JIT compilation and device allocation
+// included) and the dynamics of a scene, then the solver's own breakdown of the dynamics
+void RunScene(const std::string& scene,
+              const std::function<SceneSetup(DEMSolver&, const BenchConfig&)>& build,
+              const BenchConfig& cfg,
+              std::vector<BenchEntry>& results) {
+    std::cout << "Running " << scene << "..." << std::endl;
+    DEMSolver DEMSim;
+    DEMSim.SetVerbosity(QUIET);
+    DEMSim.SetNoForceRecord();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    SceneSetup setup = build(DEMSim, cfg);
+    DEMSim.SetInitTimeStep(setup.stepSize);
+    Record(results, scene + "/setup", SecondsSince(start), setup.numParticles);
+
+    start = std::chrono::high_resolution_clock::now();
+    DEMSim.Initialize();
+    Record(results, scene + "/initialize", SecondsSince(start), setup.numParticles);
+
+    DEMSim.ClearTimingStats();
+    start = std::chrono::high_resolution_clock::now();
+    DEMSim.DoDynamicsThenSync(cfg.time);
+    const double dynamics_time = SecondsSince(start);
+    // Particle-steps, so the throughput can be compared across sizes
+    const size_t num_steps = (size_t)std::ceil(cfg.time / setup.stepSize);
+    Record(results, scene + "/dynamics", dynamics_time, setup.numParticles * num_steps);
+
+    for (const auto& [task, seconds] : DEMSim.GetTimingStats(true))
+        Record(results, scene + "/kT/" + task, seconds, 0);
+    for (const auto& [task, seconds] : DEMSim.GetTimingStats(false))
+        Record(results, scene + "/dT/" + task, seconds, 0);
+    Record(results, scene + "/num_contacts", 0., DEMSim.GetNumContacts());
+}
+
+// =============================================================================
+// Output and comparison
+// =============================================================================
+
+void WriteJson(const std::string& filename,
+               const std::map<std::string, std::string>& hardware,
+               const std::map<std::string, std::string>& config,
+               const std::vector<BenchEntry>& results) {
+    std::ofstream out(filename);
+    auto writeFields = [&](const std::map<std::string, std::string>& fields) {
+        bool first = true;
+        for (const auto& [key, val] : fields) {
+            out << (first ? "\n" : ",\n") << "    \"" << JsonEscape(key) << "\": \"" << JsonEscape(val) << "\"";
+            first = false;
+        }
+    };
+    out << "{\n  \"suite\": \"DEMdemo_BenchmarkSuite\",\n";
+    out << "  \"hardware_fingerprint\": \"" << Fingerprint(hardware) << "\",\n";
+    out << "  \"config_fingerprint\": \"" << Fingerprint(config) << "\",\n";
+    out << "  \"hardware\": {";
+    writeFields(hardware);
+    out << "\n  },\n  \"config\": {";
+    writeFields(config);
+    out << "\n  },\n  \"results\": [";
+    bool first = true;
+    for (const auto& entry : results) {
+        // One result per line, which is what ReadBaseline relies on
+        out << (first ? "\n" : ",\n") << "    {\"name\": \"" << JsonEscape(entry.name)
+            << "\", \"seconds\": " << to_string_with_precision(entry.seconds, 9)
+            << ", \"mean_seconds\": " << to_string_with_precision(entry.meanSeconds, 9)
+            << ", \"items\": " << entry.items << "}";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+}
+
+// Read back the results (name to best seconds) and the fingerprints of a file WriteJson wrote
+bool ReadBaseline(const std::string& filename,
+                  std::map<std::string, double>& seconds,
+                  std::string& hardware_fingerprint,
+                  std::string& config_fingerprint) {
+    std::ifstream in(filename);
+    if (!in.good())
+        return false;
+    const std::regex result_re("\"name\": \"([^\"]+)\", \"seconds\": ([-+0-9.eE]+)");
+    const std::regex hardware_re("\"hardware_fingerprint\": \"([0-9a-f]+)\"");
+    const std::regex config_re("\"config_fingerprint\": \"([0-9a-f]+)\"");
+    std::string line;
+    std::smatch match;
+    while (std::getline(in, line)) {
+        if (std::regex_search(line, match, result_re)) {
+            seconds[match[1]] = std::stod(match[2]);
+        } else if (std::regex_search(line, match, hardware_re)) {
+            hardware_fingerprint = match[1];
+        } else if (std::regex_search(line, match, config_re)) {
+            config_fingerprint = match[1];
+        }
+    }
+    return true;
+}
+
+// Compare the timings with the baseline's; returns the number of regressions
+unsigned int CompareWithBaseline(const BenchConfig& cfg,
+                                 const std::map<std::string, std::string>& hardware,
+                                 const std::map<std::string, std::string>& config,
+                                 const std::vector<BenchEntry>& results) {
+    std::map<std::string, double> base;
+    std::string base_hardware, base_config;
+    if (!ReadBaseline(cfg.baseline, base, base_hardware, base_config)) {
+        std::cout << "Could not read baseline " << cfg.baseline << std::endl;
+        return 1;
+    }
+    if (base_hardware != Fingerprint(hardware))
+        std::cout << "WARNING: the baseline was run on different hardware." << std::endl;
+    if (base_config != Fingerprint(config))
+        std::cout << "WARNING: the baseline was run with a different configuration; timings may not compare."
+                  << std::endl;
+
+    // Timings this short are mostly noise
+    const double min_seconds = 1e-3;
+    unsigned int num_regressions = 0, num_improvements = 0, num_compared = 0;
+    printf("%-48s %12s %12s %9s\n", "name", "baseline(s)", "now(s)", "ratio");
+    for (const auto& entry : results) {
+        auto it = base.find(entry.name);
+        if (it == base.end() || (it->second < min_seconds && entry.seconds < min_seconds))
+            continue;
+        const double ratio = entry.seconds / std::max<double>(it->second, DEME_TINY_FLOAT);
+        const char* verdict = "";
+        if (ratio > 1. + cfg.tolerance) {
+            verdict = "  REGRESSION";
+            num_regressions++;
+        } else if (ratio < 1. / (1. + cfg.tolerance)) {
+            verdict = "  improvement";
+            num_improvements++;
+        }
+        printf("%-48s %12.6g %12.6g %9.3f%s\n", entry.name.c_str(), it->second, entry.seconds, ratio, verdict);
+        num_compared++;
+    }
+    std::cout << num_compared << " timings compared: " << num_regressions << " regression(s), " << num_improvements
+              << " improvement(s), tolerance " << cfg.tolerance * 100. << "%" << std::endl;
+    return num_regressions;
+}
+
+void PrintUsage() {
+    std::cout << "Usage: DEMdemo_BenchmarkSuite [--scene NAME|all] [--size N] [--time T] [--repeat R] [--host-only]"
+              << "\n       [--output FILE] [--baseline FILE] [--tolerance F]\nScenes:";
+    for (const auto& scene : SCENES)
+        std::cout << " " << scene;
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_val = i + 1 < argc;
+        if (arg == "--scene" && has_val) {
+            cfg.scene = argv[++i];
+        } else if (arg == "--size" && has_val) {
+            cfg.size = std::stoul(argv[++i]);
+        } else if (arg == "--time" && has_val) {
+            cfg.time = std::stod(argv[++i]);
+        } else if (arg == "--repeat" && has_val) {
+            cfg.repeat = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--host-only") {
+            cfg.hostOnly = true;
+        } else if (arg == "--output" && has_val) {
+            cfg.output = argv[++i];
+        } else if (arg == "--baseline" && has_val) {
+            cfg.baseline = argv[++i];
+        } else if (arg == "--tolerance" && has_val) {
+            cfg.tolerance = std::stod(argv[++i]);
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (cfg.scene != "all" && std::find(SCENES.begin(), SCENES.end(), cfg.scene) == SCENES.end()) {
+        PrintUsage();
+        return 1;
+    }
+
+    const bool run_scenes = !cfg.hostOnly && NumDevices() > 0;
+    if (!cfg.hostOnly && !run_scenes)
+        std::cout << "No GPU found; only the host-only subsystems are benchmarked." << std::endl;
+
+    std::vector<BenchEntry> results;
+    std::cout << "Running host-only subsystems..." << std::endl;
+    RunHostBenchmarks(cfg, results);
+
+    if (run_scenes) {
+        const std::map<std::string, std::function<SceneSetup(DEMSolver&, const BenchConfig&)>> builders = {
+            {"settling_box", BuildSettlingBox},         {"rotating_drum", BuildRotatingDrum},
+            {"hopper_discharge", BuildHopperDischarge}, {"mesh_plow", BuildMeshPlow},
+            {"polydisperse_bed", BuildPolydisperseBed}};
+        for (const auto& scene : SCENES) {
+            if (cfg.scene == "all" || cfg.scene == scene)
+                RunScene(scene, builders.at(scene), cfg, results);
+        }
+    }
+
+    for (const auto& entry : results) {
+        printf("%-48s %12.6g s %14zu items\n", entry.name.c_str(), entry.seconds, entry.items);
+    }
+
+    const auto hardware = HardwareInfo();
+    const auto config = ConfigInfo(cfg, run_scenes);
+    WriteJson(cfg.output, hardware, config, results);
+    std::cout << "Results written to " << cfg.output << std::endl;
+
+    int ret = 0;
+    if (!cfg.baseline.empty())
+        ret = CompareWithBaseline(cfg, hardware, config, results) > 0 ? 1 : 0;
+
+    std::cout << "DEMdemo_BenchmarkSuite exiting..." << std::endl;
+    return ret;
+}
@@ -0,0 +1,138 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// A scaling benchmark of contact detection in strongly polydisperse systems.
+// A bed of fines with boulders in it settles in a box, and the boulder-to-fine
+// size ratio is swept. Each case is run with the uniform bins and then with the
+// hierarchical grid (UseHierarchicalBinning). The two must find the same
+// clump--clump contact pairs after the first step (the program fails if they do
+// not), and the wall time of both is reported.
+// =============================================================================
+
+#include <core/ApiVersion.h>
+#include <core/utils/ThreadManager.h>
+#include <DEM/API.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <DEM/utils/Samplers.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+using namespace deme;
+
+const float fine_rad = 0.005;
+const float world_size = 0.6;
+const double step_size = 1e-5;
+const unsigned int num_steps = 2000;
+
+// Run one case and return the wall time of the steps. Also reports the clump--clump contact pairs after the first step,
+// each with the smaller ID first, sorted.
+double RunCase(float size_ratio,
+               bool use_hier_grid,
+               std::vector<std::pair<bodyID_t, bodyID_t>>& contact_pairs,
+               size_t& num_spheres) {
+    DEMSolver DEMSim;
+    DEMSim.SetVerbosity(QUIET);
+    DEMSim.SetNoForceRecord();
+    DEMSim.InstructBoxDomainDimension(world_size, world_size, world_size);
+    DEMSim.UseHierarchicalBinning(use_hier_grid);
+    // Large size ratios put many fines in a bin; let the bin-based run go on anyway so it can be timed
+    DEMSim.SetMaxSphereInBin(32768);
+
+    auto mat_type = DEMSim.LoadMaterial({{"E", 1e8}, {"nu", 0.3}, {"CoR", 0.3}, {"mu", 0.5}});
+    DEMSim.InstructBoxDomainBoundingBC("all", mat_type);
+
+    const float boulder_rad = fine_rad * size_ratio;
+    const float density = 2600.;
+    auto fine_template = DEMSim.LoadSphereType(density * 4. / 3. * PI * std::pow(fine_rad, 3), fine_rad, mat_type);
+    auto boulder_template =
+        DEMSim.LoadSphereType(density * 4. / 3. * PI * std::pow(boulder_rad, 3), boulder_rad, mat_type);
+
+    // Boulders on a loose lattice in the lower half of the box, then fines fill the space around them
+    std::vector<float3> boulder_xyz;
+    if (size_ratio > 1.f) {
+        GridSampler boulder_sampler(4.f * boulder_rad);
+        float half = world_size / 2. - 2.f * boulder_rad;
+        boulder_xyz = boulder_sampler.SampleBox(make_float3(0, 0, -world_size / 4.),
+                                                make_float3(half, half, world_size / 4. - 2.f * boulder_rad));
+    }
+    HCPSampler fine_sampler(2.05f * fine_rad);
+    float fine_half = world_size / 2. - 2.f * fine_rad;
+    std::vector<float3> fine_candidates =
+        fine_sampler.SampleBox(make_float3(0, 0, -world_size / 8.),
+                               make_float3(fine_half, fine_half, world_size * 3. / 8. - 2.f * fine_rad));
+    std::vector<float3> fine_xyz;
+    for (const auto& p : fine_candidates) {
+        bool clear = true;
+        for (const auto& b : boulder_xyz) {
+            if (length(p - b) < boulder_rad + fine_rad) {
+                clear = false;
+                break;
+            }
+        }
+        if (clear)
+            fine_xyz.push_back(p);
+    }
+    if (boulder_xyz.size() > 0)
+        DEMSim.AddClumps(boulder_template, boulder_xyz);
+    DEMSim.AddClumps(fine_template, fine_xyz);
+    num_spheres = boulder_xyz.size() + fine_xyz.size();
+
+    DEMSim.SetInitTimeStep(step_size);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    DEMSim.SetMaxVelocity(10.);
+    DEMSim.Initialize();
+
+    DEMSim.DoDynamicsThenSync(step_size);
+    contact_pairs = DEMSim.GetClumpContacts();
+    for (auto& pair : contact_pairs) {
+        if (pair.first > pair.second)
+            std::swap(pair.first, pair.second);
+    }
+    std::sort(contact_pairs.begin(), contact_pairs.end());
+
+    auto start = std::chrono::high_resolution_clock::now();
+    DEMSim.DoDynamicsThenSync(step_size * num_steps);
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main() {
+    std::vector<float> size_ratios = {1., 2., 5., 10., 20.};
+    std::cout << "size_ratio, num_spheres, contacts_bins, contacts_hier, time_bins(s), time_hier(s), speedup"
+              << std::endl;
+    int num_mismatched_cases = 0;
+    for (float ratio : size_ratios) {
+        std::vector<std::pair<bodyID_t, bodyID_t>> pairs_bins, pairs_hier;
+        size_t n_sph;
+        double t_bins = RunCase(ratio, false, pairs_bins, n_sph);
+        double t_hier = RunCase(ratio, true, pairs_hier, n_sph);
+        std::cout << ratio << ", " << n_sph << ", " << pairs_bins.size() << ", " << pairs_hier.size() << ", "
+                  << t_bins << ", " << t_hier << ", " << t_bins / t_hier << std::endl;
+        if (pairs_bins != pairs_hier) {
+            std::vector<std::pair<bodyID_t, bodyID_t>> only_bins, only_hier;
+            std::set_difference(pairs_bins.begin(), pairs_bins.end(), pairs_hier.begin(), pairs_hier.end(),
+                                std::back_inserter(only_bins));
+            std::set_difference(pairs_hier.begin(), pairs_hier.end(), pairs_bins.begin(), pairs_bins.end(),
+                                std::back_inserter(only_hier));
+            std::cout << "ERROR: at size ratio " << ratio << ", the two contact detection modes found different "
+                      << "contact pairs: " << only_bins.size() << " only with bins, " << only_hier.size()
+                      << " only with the hierarchical grid" << std::endl;
+            for (size_t i = 0; i < std::min<size_t>(only_bins.size(), 5); i++)
+                std::cout << "    only with bins: " << only_bins[i].first << ", " << only_bins[i].second << std::endl;
+            for (size_t i = 0; i < std::min<size_t>(only_hier.size(), 5); i++)
+                std::cout << "    only with the hierarchical grid: " << only_hier[i].first << ", "
+                          << only_hier[i].second << std::endl;
+            num_mismatched_cases++;
+        }
+    }
+    std::cout << "DEMdemo_HierarchicalBinning exiting..." << std::endl;
+    return num_mismatched_cases == 0 ? 0 : 1;
+}
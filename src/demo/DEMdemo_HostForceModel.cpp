@@ -0,0 +1,230 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The built-in Hertz-Mindlin force model run on the host (HostForceModel.hpp).
+// Random sphere-sphere contacts are made, and the model is run on them in the
+// plain scalar loop to record a reference, which is written to a CSV file. The
+// reference is read back and the threaded run, with the vectorization hint, is
+// validated against it. The normal force of static contacts is checked against
+// the analytic Hertz force, and the tangential force against the Coulomb limit
+// over a few steps of accumulating history. Then the throughput of both runs is
+// reported. With --reference FILE, the run is validated against a recorded
+// reference file instead (then --ts should be the step size it was recorded
+// with), and --rtol sets the tolerance of the validation, for references
+// recorded by other builds. DEMdemo_HostForceModelCheck checks the model against
+// the solver's own force calculation.
+// =============================================================================
+
+#include <DEM/utils/HostFullHertzianForceModel.hpp>
+#include <DEM/utils/HostFrictionlessHertzianForceModel.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+using namespace deme;
+
+// Make n random contacts between spheres of num_mats materials, with the contact geometry as the kernel has it
+void MakeContacts(HostContactBatch& batch, size_t n, unsigned int num_mats, unsigned int seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> uni(0.f, 1.f);
+    auto randUnit = [&]() {
+        float3 v;
+        do {
+            v = make_float3(2.f * uni(gen) - 1.f, 2.f * uni(gen) - 1.f, 2.f * uni(gen) - 1.f);
+        } while (length(v) < 0.1f || length(v) > 1.f);
+        return normalize(v);
+    };
+    auto randQ = [&]() {
+        const float3 axis = randUnit();
+        const float half = (float)PI * uni(gen);
+        return make_float4(axis.x * sinf(half), axis.y * sinf(half), axis.z * sinf(half), cosf(half));
+    };
+    batch.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        const float RA = 0.005f + 0.01f * uni(gen), RB = 0.005f + 0.01f * uni(gen);
+        const float overlap = 0.01f * std::min(RA, RB) * uni(gen);
+        const float3 B2A = randUnit();
+        // Global contact point, in the middle of the overlap; A's center at the origin
+        const float3 posA = make_float3(0, 0, 0);
+        const float3 posB = posA - (RA + RB - overlap) * B2A;
+        const float3 CP = posA - (RA - overlap / 2.f) * B2A;
+        const float4 qA = randQ(), qB = randQ();
+        // Local contact points: rotate the global offsets by the inverse orientations
+        float3 locCPA = CP - posA, locCPB = CP - posB;
+        applyOriQToVector3<float, oriQ_t>(locCPA.x, locCPA.y, locCPA.z, qA.w, -qA.x, -qA.y, -qA.z);
+        applyOriQToVector3<float, oriQ_t>(locCPB.x, locCPB.y, locCPB.z, qB.w, -qB.x, -qB.y, -qB.z);
+        const float densA = 2600.f, densB = 2600.f;
+        const float massA = densA * 4.f / 3.f * (float)PI * RA * RA * RA;
+        const float massB = densB * 4.f / 3.f * (float)PI * RB * RB * RB;
+
+        batch.at(HC_OVERLAP, i) = overlap;
+        batch.set3(HC_B2A_X, i, B2A);
+        batch.set3(HC_CPA_X, i, locCPA);
+        batch.set3(HC_CPB_X, i, locCPB);
+        batch.at(HC_A_MASS, i) = massA;
+        batch.at(HC_B_MASS, i) = massB;
+        batch.at(HC_A_RADIUS, i) = RA;
+        batch.at(HC_B_RADIUS, i) = RB;
+        batch.at(HC_A_MAT, i) = (float)(gen() % num_mats);
+        batch.at(HC_B_MAT, i) = (float)(gen() % num_mats);
+        batch.set3(HC_A_VEL_X, i, 0.5f * uni(gen) * randUnit());
+        batch.set3(HC_B_VEL_X, i, 0.5f * uni(gen) * randUnit());
+        batch.set3(HC_A_ROTVEL_X, i, 20.f * uni(gen) * randUnit());
+        batch.set3(HC_B_ROTVEL_X, i, 20.f * uni(gen) * randUnit());
+        batch.setQ(HC_A_QW, i, qA);
+        batch.setQ(HC_B_QW, i, qB);
+        batch.set3(HC_A_MOI_X, i, make_float3(0.4f * massA * RA * RA));
+        batch.set3(HC_B_MOI_X, i, make_float3(0.4f * massB * RB * RB));
+        // Some contacts are new, the others carry history
+        if (uni(gen) < 0.7f) {
+            const float3 tan = cross(B2A, randUnit());
+            batch.set3(HC_DELTA_TAN_X, i, 1e-5f * uni(gen) * tan);
+            batch.at(HC_DELTA_TIME, i) = 1e-3f * uni(gen);
+        }
+    }
+}
+
+// Largest relative error of the normal force of static contacts against the Hertz force (4/3) E* sqrt(R*) d^(3/2)
+double CheckHertz(HostMaterialTable& mats, float ts) {
+    HostContactBatch batch;
+    MakeContacts(batch, 1000, mats.GetNumMaterials(), 7);
+    for (unsigned int c : {HC_A_VEL_X, HC_B_VEL_X, HC_A_ROTVEL_X, HC_B_ROTVEL_X, HC_DELTA_TAN_X}) {
+        for (unsigned int k = 0; k < 3; k++)
+            std::fill(batch.col((HOST_CONTACT_COL)(c + k)).begin(), batch.col((HOST_CONTACT_COL)(c + k)).end(), 0.f);
+    }
+    HostForceModelParams params(mats, ts);
+    CalcHostContactForces<HostFullHertzianForceModel>(batch, params);
+    double maxErr = 0.;
+    for (size_t i = 0; i < batch.size(); i++) {
+        const unsigned int a = (unsigned int)batch.at(HC_A_MAT, i), b = (unsigned int)batch.at(HC_B_MAT, i);
+        const double EA = params.E[a], EB = params.E[b], nuA = params.nu[a], nuB = params.nu[b];
+        const double E_eff = 1. / ((1. - nuA * nuA) / EA + (1. - nuB * nuB) / EB);
+        const double RA = batch.at(HC_A_RADIUS, i), RB = batch.at(HC_B_RADIUS, i);
+        const double d = batch.at(HC_OVERLAP, i);
+        const double Fn = 4. / 3. * E_eff * std::sqrt(RA * RB / (RA + RB)) * std::pow(d, 1.5);
+        const double F = length(batch.get3(HC_FORCE_X, i));
+        maxErr = std::max(maxErr, std::abs(F - Fn) / Fn);
+    }
+    return maxErr;
+}
+
+// Run a few steps of accumulating history, returning the largest |Ft| / (mu |Fn|) seen
+double CheckCoulomb(HostMaterialTable& mats, float ts, unsigned int steps) {
+    HostContactBatch batch;
+    MakeContacts(batch, 10000, mats.GetNumMaterials(), 11);
+    HostForceModelParams params(mats, ts);
+    double maxRatio = 0.;
+    for (unsigned int s = 0; s < steps; s++) {
+        CalcHostContactForces<HostFullHertzianForceModel>(batch, params);
+        for (size_t i = 0; i < batch.size(); i++) {
+            const float3 F = batch.get3(HC_FORCE_X, i), B2A = batch.get3(HC_B2A_X, i);
+            const float Fn = dot(F, B2A);
+            const float Ft = length(F - Fn * B2A);
+            const float mu = params.mu[(unsigned int)batch.at(HC_A_MAT, i)][(unsigned int)batch.at(HC_B_MAT, i)];
+            if (Fn > 0.f && mu > 0.f)
+                maxRatio = std::max(maxRatio, (double)Ft / (mu * Fn));
+        }
+        batch.advanceHistory();
+    }
+    return maxRatio;
+}
+
+// Contacts per second of a run, best of a few
+template <class Model>
+double TimeRun(HostContactBatch& batch, const HostForceModelParams& params, unsigned int n_threads, bool vectorize) {
+    double best = 1e30;
+    for (int r = 0; r < 5; r++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        CalcHostContactForces<Model>(batch, params, n_threads, vectorize);
+        std::chrono::duration<double> t = std::chrono::high_resolution_clock::now() - start;
+        best = std::min(best, t.count());
+    }
+    return batch.size() / best;
+}
+
+int main(int argc, char* argv[]) {
+    std::string reference_file;
+    std::string out_file = "DemoOutput_HostForceModel_reference.csv";
+    size_t num_contacts = 200000;
+    unsigned int n_threads = 0;
+    float ts = 1e-5f;
+    float rtol = 1e-4f;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--reference") && i + 1 < argc)
+            reference_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+            out_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--contacts") && i + 1 < argc)
+            num_contacts = std::stoul(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+            n_threads = std::stoul(argv[++i]);
+        else if (!std::strcmp(argv[i], "--ts") && i + 1 < argc)
+            ts = std::stof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--rtol") && i + 1 < argc)
+            rtol = std::stof(argv[++i]);
+        else {
+            printf("Usage: %s [--reference FILE] [--output FILE] [--contacts N] [--threads N] [--ts STEP] "
+                   "[--rtol TOL]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    // The materials of the demos with these models
+    HostMaterialTable mats;
+    mats.LoadMaterial({{"E", 1e9f}, {"nu", 0.3f}, {"CoR", 0.8f}, {"mu", 0.3f}, {"Crr", 0.01f}});
+    mats.LoadMaterial({{"E", 5e7f}, {"nu", 0.33f}, {"CoR", 0.5f}, {"mu", 0.5f}, {"Crr", 0.f}});
+    mats.LoadMaterial({{"E", 2e9f}, {"nu", 0.25f}, {"CoR", 0.6f}, {"mu", 0.7f}});
+    mats.SetMaterialPropertyPair("mu", 0, 2, 0.2f);
+    HostForceModelParams params(mats, ts);
+
+    bool passed = true;
+    HostContactBatch reference;
+    if (reference_file.empty()) {
+        MakeContacts(reference, num_contacts, mats.GetNumMaterials(), 42);
+        CalcHostContactForces<HostFullHertzianForceModel>(reference, params, 1, false);
+        reference.WriteCsv(out_file);
+        printf("Recorded the scalar run on %zu contacts to %s\n", reference.size(), out_file.c_str());
+        reference.ReadCsv(out_file);
+    } else {
+        reference.ReadCsv(reference_file);
+        printf("Read %zu recorded contacts from %s\n", reference.size(), reference_file.c_str());
+    }
+    HostForceValidation val =
+        ValidateHostForceModel<HostFullHertzianForceModel>(reference, params, rtol, 1e-3f, n_threads);
+    printf("Validation: %zu of %zu contacts out of tolerance; max relative error of force %g, torque %g, history %g\n",
+           val.numFailed, val.numContacts, val.maxForceErr, val.maxTorqueErr, val.maxHistoryErr);
+    for (size_t k = 0; k < std::min<size_t>(val.failed.size(), 5); k++) {
+        const size_t i = val.failed[k];
+        printf("  contact %zu: recorded force (%g, %g, %g)\n", i, reference.at(HC_FORCE_X, i),
+               reference.at(HC_FORCE_Y, i), reference.at(HC_FORCE_Z, i));
+    }
+    passed = passed && val.Passed();
+
+    const double hertzErr = CheckHertz(mats, ts);
+    printf("Static normal force vs. analytic Hertz: max relative error %g\n", hertzErr);
+    passed = passed && hertzErr < 1e-4;
+
+    const double coulombRatio = CheckCoulomb(mats, ts, 20);
+    printf("Tangential force over 20 steps: max |Ft| / (mu Fn) = %g\n", coulombRatio);
+    passed = passed && coulombRatio < 1. + 1e-4;
+
+    HostContactBatch batch;
+    MakeContacts(batch, num_contacts, mats.GetNumMaterials(), 3);
+    const double scalarRate = TimeRun<HostFullHertzianForceModel>(batch, params, 1, false);
+    const double simdRate = TimeRun<HostFullHertzianForceModel>(batch, params, 1, true);
+    const double threadedRate = TimeRun<HostFullHertzianForceModel>(batch, params, n_threads, true);
+    const double frictionlessRate = TimeRun<HostFrictionlessHertzianForceModel>(batch, params, n_threads, true);
+    printf("Contacts per second: plain loop %.3g, hinted %.3g, hinted and threaded %.3g (frictionless %.3g)\n",
+           scalarRate, simdRate, threadedRate, frictionlessRate);
+
+    printf(passed ? "PASSED\n" : "FAILED\n");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The built-in Hertz-Mindlin force model run on the host (HostForceModel.hpp),
+// checked against the solver. The solver runs a fixed scene (spheres of two
+// materials settling in a box of a third) with its contact states dumped
+// (SetContactStateDump), the dump of the last step is written to a CSV file, and
+// the host model is validated against the forces, torques and histories the
+// device computed for those states. The device rounds differently (fused
+// multiply-adds, and its own sqrt and pow), so --rtol should not be much below
+// its default.
+// =============================================================================
+
+#include <DEM/API.h>
+#include <DEM/utils/HostFullHertzianForceModel.hpp>
+#include <DEM/utils/Samplers.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace deme;
+
+// The materials of DEMdemo_HostForceModel, and the friction coefficient between the first and the third
+const std::vector<std::unordered_map<std::string, float>> MATERIALS = {
+    {{"E", 1e9f}, {"nu", 0.3f}, {"CoR", 0.8f}, {"mu", 0.3f}, {"Crr", 0.01f}},
+    {{"E", 5e7f}, {"nu", 0.33f}, {"CoR", 0.5f}, {"mu", 0.5f}, {"Crr", 0.f}},
+    {{"E", 2e9f}, {"nu", 0.25f}, {"CoR", 0.6f}, {"mu", 0.7f}}};
+const float MU_0_2 = 0.2f;
+
+int main(int argc, char* argv[]) {
+    std::string out_file = "DemoOutput_HostForceModel_device.csv";
+    unsigned int n_threads = 0;
+    float rtol = 1e-3f;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+            out_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+            n_threads = std::stoul(argv[++i]);
+        else if (!std::strcmp(argv[i], "--rtol") && i + 1 < argc)
+            rtol = std::stof(argv[++i]);
+        else {
+            printf("Usage: %s [--output FILE] [--threads N] [--rtol TOL]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    DEMSolver DEMSim;
+    DEMSim.SetVerbosity("ERROR");
+    DEMSim.UseFrictionalHertzianModel();
+    DEMSim.SetContactStateDump();
+    std::vector<std::shared_ptr<DEMMaterial>> solver_mats;
+    HostMaterialTable mats;
+    for (const auto& props : MATERIALS) {
+        solver_mats.push_back(DEMSim.LoadMaterial(props));
+        mats.LoadMaterial(props);
+    }
+    DEMSim.SetMaterialPropertyPair("mu", solver_mats[0], solver_mats[2], MU_0_2);
+    mats.SetMaterialPropertyPair("mu", 0, 2, MU_0_2);
+
+    DEMSim.InstructBoxDomainDimension(0.2, 0.2, 0.2);
+    DEMSim.InstructBoxDomainBoundingBC("all", solver_mats[2]);
+    const float rA = 0.005f, rB = 0.007f, density = 2600.f;
+    auto sphereA = DEMSim.LoadSphereType(density * 4.f / 3.f * (float)PI * rA * rA * rA, rA, solver_mats[0]);
+    auto sphereB = DEMSim.LoadSphereType(density * 4.f / 3.f * (float)PI * rB * rB * rB, rB, solver_mats[1]);
+    HCPSampler sampler(2.2f * rB);
+    auto xyz = sampler.SampleBox(make_float3(0, 0, 0), make_float3(0.08f, 0.08f, 0.08f));
+    std::vector<std::shared_ptr<DEMClumpTemplate>> types;
+    for (size_t i = 0; i < xyz.size(); i++)
+        types.push_back((i % 2) ? sphereB : sphereA);
+    DEMSim.AddClumps(types, xyz);
+    DEMSim.SetInitTimeStep(1e-5);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    DEMSim.Initialize();
+    // Long enough for a pile with sliding, rolling and resting contacts
+    DEMSim.DoDynamicsThenSync(0.3);
+
+    HostContactBatch states = DEMSim.GetContactStates();
+    states.WriteCsv(out_file);
+    printf("Wrote the device's states and results of %zu contacts to %s\n", states.size(), out_file.c_str());
+    HostForceModelParams params(mats, (float)DEMSim.GetTimeStepSize(), (float)DEMSim.GetSimTime());
+    HostForceValidation val =
+        ValidateHostForceModel<HostFullHertzianForceModel>(states, params, rtol, 1e-3f, n_threads);
+    printf("Against the device: %zu of %zu contacts out of tolerance; max relative error of force %g, torque %g, "
+           "history %g\n",
+           val.numFailed, val.numContacts, val.maxForceErr, val.maxTorqueErr, val.maxHistoryErr);
+    for (size_t k = 0; k < std::min<size_t>(val.failed.size(), 5); k++) {
+        const size_t i = val.failed[k];
+        printf("  contact %zu: device force (%g, %g, %g)\n", i, states.at(HC_FORCE_X, i), states.at(HC_FORCE_Y, i),
+               states.at(HC_FORCE_Z, i));
+    }
+
+    const bool passed = val.Passed() && val.numContacts > 0;
+    printf(passed ? "PASSED\n" : "FAILED\n");
+    return passed ? 0 : 1;
+}
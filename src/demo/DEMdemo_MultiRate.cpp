@@ -0,0 +1,203 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Multi-rate integration. First, an energy-conservation check on the host
+// reference (MultiRateReference.hpp): a chain of soft spheres with a few stiff
+// ones in it bounces between two walls, without damping. The energy error of
+// sub-stepping the stiff contacts at a coarse step should stay close to that of
+// the fine single-rate step, and not drift. Second, the solver runs a chain of
+// soft and steel spheres between two walls, undamped and frictionless, with the
+// steel spheres' contacts sub-stepped, and its end state must match that of the
+// host reference taking the same steps. The demo returns nonzero if either check
+// fails. Last, a cluster of steel balls (their own family) is dropped into a bed
+// of soft particles, with the fine step, and with a coarse step and the balls'
+// contacts sub-stepped; the two should end up alike.
+// =============================================================================
+
+#include <core/ApiVersion.h>
+#include <core/utils/ThreadManager.h>
+#include <DEM/API.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <DEM/utils/Samplers.hpp>
+#include <DEM/utils/MultiRateReference.hpp>
+
+#include <cstdio>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace deme;
+
+// Max and final relative energy error of the host reference chain over a duration
+void RunReferenceChain(double H, unsigned int n_sub, double& max_err, double& final_err) {
+    const double rad = 0.01, mass = 0.01, soft_k = 1e6, stiff_k = 1e8;
+    const int num_spheres = 20;
+    MultiRateChain chain(0., 2. * rad * num_spheres * 1.05);
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> vel(-1., 1.);
+    for (int i = 0; i < num_spheres; i++) {
+        bool stiff = (i == 5 || i == 14);
+        chain.AddSphere(mass, rad, stiff ? stiff_k : soft_k, rad * 1.05 * (2 * i + 1), vel(gen), stiff);
+    }
+    chain.SetWallContactsFast(true);
+
+    const double duration = 2.;
+    double E0 = chain.Energy();
+    max_err = 0.;
+    for (long i = 0; i < (long)(duration / H); i++) {
+        chain.Step(H, n_sub);
+        max_err = std::max(max_err, std::abs(chain.Energy() / E0 - 1.));
+    }
+    final_err = chain.Energy() / E0 - 1.;
+}
+
+// Run a chain of soft and steel spheres (the latter sub-stepped) with the solver and with the host reference, taking
+// the same steps; returns whether the end states agree
+bool CompareChainWithReference(double H, unsigned int n_sub, double duration) {
+    const double rad = 0.01, mass = 0.01, nu = 0.3, E_soft = 1e7, E_steel = 2e11;
+    const int num_spheres = 12;
+    const double length = 2. * rad * num_spheres * 1.05;
+    // Spheres 4, 5 and 9 are steel, so there are steel--steel and steel--soft contacts; the chain ends are soft, so the
+    // wall contacts are all slow
+    auto is_steel = [](int i) { return i == 4 || i == 5 || i == 9; };
+    // The Hertzian contact force is k d^1.5 with k = 4/3 E* sqrt(R*)
+    auto e_star = [nu](double E1, double E2) { return 1. / ((1. - nu * nu) / E1 + (1. - nu * nu) / E2); };
+    auto sphere_E = [&](int i) { return is_steel(i) ? E_steel : E_soft; };
+
+    MultiRateChain chain(0., length);
+    std::vector<float3> xyz, vel;
+    std::vector<unsigned int> families;
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> rand_vel(-1., 1.);
+    for (int i = 0; i < num_spheres; i++) {
+        const double x = rad * 1.05 * (2 * i + 1), v = rand_vel(gen);
+        chain.AddSphere(mass, rad, 0., x, v, is_steel(i));
+        if (i + 1 < num_spheres)
+            chain.SetPairStiffness(i, 4. / 3. * e_star(sphere_E(i), sphere_E(i + 1)) * std::sqrt(0.5 * rad));
+        xyz.push_back(make_float3(x, 0, 0));
+        vel.push_back(make_float3(v, 0, 0));
+        families.push_back(is_steel(i) ? 1 : 0);
+    }
+    // The walls are soft, and a plane's radius is infinite
+    chain.SetWallStiffness(4. / 3. * e_star(E_soft, E_soft) * std::sqrt(rad));
+
+    DEMSolver DEMSim;
+    DEMSim.SetVerbosity(QUIET);
+    DEMSim.UseFrictionlessHertzianModel();
+    DEMSim.InstructBoxDomainDimension({0.f, (float)length}, {-0.05f, 0.05f}, {-0.05f, 0.05f});
+    // A CoR of 1 means no damping
+    auto mat_soft = DEMSim.LoadMaterial({{"E", E_soft}, {"nu", nu}, {"CoR", 1.}});
+    auto mat_steel = DEMSim.LoadMaterial({{"E", E_steel}, {"nu", nu}, {"CoR", 1.}});
+    DEMSim.InstructBoxDomainBoundingBC("all", mat_soft);
+    auto soft_type = DEMSim.LoadSphereType(mass, rad, mat_soft);
+    auto steel_type = DEMSim.LoadSphereType(mass, rad, mat_steel);
+    std::vector<std::shared_ptr<DEMClumpTemplate>> types;
+    for (int i = 0; i < num_spheres; i++)
+        types.push_back(is_steel(i) ? steel_type : soft_type);
+    auto spheres = DEMSim.AddClumps(types, xyz);
+    spheres->SetVel(vel);
+    spheres->SetFamilies(families);
+    auto tracker = DEMSim.Track(spheres);
+    DEMSim.SetMultiRateSubSteps(n_sub);
+    DEMSim.SetFamilySubStepped(1);
+    DEMSim.SetInitTimeStep(H);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, 0));
+    DEMSim.SetMaxVelocity(5.);
+    DEMSim.Initialize();
+    DEMSim.DoDynamicsThenSync(duration);
+
+    for (long i = 0; i < std::lround(duration / H); i++)
+        chain.Step(H, n_sub);
+
+    const auto pos = tracker->Positions();
+    const auto vels = tracker->Velocities();
+    double max_pos_diff = 0., max_vel_diff = 0., max_speed = 0.;
+    for (int i = 0; i < num_spheres; i++) {
+        max_pos_diff = std::max(max_pos_diff, std::abs(pos[i].x - chain.GetPos(i)));
+        max_vel_diff = std::max(max_vel_diff, std::abs(vels[i].x - chain.GetVel(i)));
+        max_speed = std::max(max_speed, std::abs(chain.GetVel(i)));
+    }
+    std::cout << "Solver vs host reference chain, step " << H << " in " << n_sub << " sub-steps: max position diff "
+              << max_pos_diff << ", max velocity diff " << max_vel_diff << " (max speed " << max_speed << ")"
+              << std::endl;
+    return max_pos_diff < 0.01 * rad && max_vel_diff < 0.01 * max_speed;
+}
+
+// Drop steel balls into a soft bed; returns the wall time, and the first ball's final height
+double RunBallDrop(double step_size, unsigned int n_sub, float& ball_z) {
+    DEMSolver DEMSim;
+    DEMSim.SetVerbosity(QUIET);
+    DEMSim.InstructBoxDomainDimension(0.4, 0.4, 0.6);
+    auto mat_soft = DEMSim.LoadMaterial({{"E", 1e7}, {"nu", 0.3}, {"CoR", 0.5}, {"mu", 0.3}});
+    auto mat_steel = DEMSim.LoadMaterial({{"E", 2e11}, {"nu", 0.3}, {"CoR", 0.5}, {"mu", 0.3}});
+    DEMSim.InstructBoxDomainBoundingBC("all", mat_soft);
+
+    const float rad = 0.005, ball_rad = 0.04;
+    auto sph_type = DEMSim.LoadSphereType(2600. * 4. / 3. * PI * std::pow(rad, 3), rad, mat_soft);
+    auto ball_type = DEMSim.LoadSphereType(7800. * 4. / 3. * PI * std::pow(ball_rad, 3), ball_rad, mat_steel);
+    HCPSampler sampler(2.05f * rad);
+    auto bed_xyz = sampler.SampleBox(make_float3(0, 0, -0.2), make_float3(0.19, 0.19, 0.09));
+    DEMSim.AddClumps(sph_type, bed_xyz);
+    // The balls are packed close, so the stiff steel--steel contacts are many as they fall in
+    GridSampler ball_sampler(2.02f * ball_rad);
+    auto ball_xyz = ball_sampler.SampleBox(make_float3(0, 0, 0.2), make_float3(0.05, 0.05, 0.05));
+    auto balls = DEMSim.AddClumps(ball_type, ball_xyz);
+    balls->SetVel(make_float3(0, 0, -2.));
+    balls->SetFamily(1);
+    auto ball_tracker = DEMSim.Track(balls);
+
+    // The soft particles have collision times long enough for the coarse step, so only the contacts involving the
+    // steel balls are sub-stepped
+    DEMSim.SetMultiRateSubSteps(n_sub);
+    DEMSim.SetFamilySubStepped(1);
+    DEMSim.SetInitTimeStep(step_size);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    DEMSim.SetMaxVelocity(10.);
+    DEMSim.Initialize();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    DEMSim.DoDynamicsThenSync(0.1);
+    auto end = std::chrono::high_resolution_clock::now();
+    ball_z = ball_tracker->Pos().z;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main() {
+    bool passed = true;
+    std::cout << "Host reference chain: step, sub-steps, max |dE|/E0, final dE/E0" << std::endl;
+    struct Case {
+        double H;
+        unsigned int n;
+    };
+    std::vector<Case> cases = {{1e-6, 1}, {1e-5, 1}, {1e-5, 10}};
+    std::vector<double> max_errs;
+    for (const auto& c : cases) {
+        double max_err, final_err;
+        RunReferenceChain(c.H, c.n, max_err, final_err);
+        max_errs.push_back(max_err);
+        std::cout << c.H << ", " << c.n << ", " << max_err << ", " << final_err << std::endl;
+    }
+    // Sub-stepping the stiff contacts should recover most of the accuracy the fine step has
+    if (max_errs[2] > 0.5 * max_errs[1] || max_errs[2] > 5. * max_errs[0]) {
+        std::cout << "FAILED: multi-rate integration did not conserve energy as well as expected!" << std::endl;
+        passed = false;
+    }
+
+    if (!CompareChainWithReference(1e-5, 10, 0.02)) {
+        std::cout << "FAILED: the solver's multi-rate run differs from the host reference!" << std::endl;
+        passed = false;
+    }
+
+    float z_fine, z_multi;
+    double t_fine = RunBallDrop(1e-6, 1, z_fine);
+    double t_multi = RunBallDrop(1e-5, 10, z_multi);
+    std::cout << "Ball drop, fine step: ball z " << z_fine << ", time " << t_fine << " s" << std::endl;
+    std::cout << "Ball drop, multi-rate: ball z " << z_multi << ", time " << t_multi << " s" << std::endl;
+
+    std::cout << "DEMdemo_MultiRate exiting..." << std::endl;
+    return passed ? 0 : 1;
+}
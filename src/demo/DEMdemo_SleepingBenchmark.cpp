@@ -0,0 +1,176 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// A benchmark of island sleeping (EnableSleeping). Two scaled-down versions of
+// the settling problems in the Repose and GRCPrep demos are run with sleeping
+// off and on: random clumps poured through a funnel into a pile, and GRC-like
+// clumps settling in a box. Each is timed in a settling phase, then in a resting
+// phase in which most of the particles should be asleep. The mean height of the
+// particles is reported as a check that the two runs end up alike.
+// =============================================================================
+
+#include <core/ApiVersion.h>
+#include <core/utils/ThreadManager.h>
+#include <DEM/API.h>
+#include <DEM/HostSideHelpers.hpp>
+#include <DEM/utils/Samplers.hpp>
+
+#include <cstdio>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace deme;
+
+struct BenchResult {
+    double settleTime = 0.;
+    double restTime = 0.;
+    size_t numOwners = 0;
+    size_t numAsleep = 0;
+    float meanZ = 0.;
+};
+
+// Time the settling and the resting phases of an initialized simulation
+void TimePhases(DEMSolver& DEMSim, double settle_time, double rest_time, size_t num_clumps, BenchResult& res) {
+    auto start = std::chrono::high_resolution_clock::now();
+    DEMSim.DoDynamicsThenSync(settle_time);
+    auto mid = std::chrono::high_resolution_clock::now();
+    DEMSim.DoDynamicsThenSync(rest_time);
+    auto end = std::chrono::high_resolution_clock::now();
+    res.settleTime = std::chrono::duration<double>(mid - start).count();
+    res.restTime = std::chrono::duration<double>(end - mid).count();
+    res.numOwners = DEMSim.GetNumOwners();
+    res.numAsleep = DEMSim.GetNumSleepingOwners();
+    // Clumps are added first, so they are the first owners
+    auto pos = DEMSim.GetOwnerPosition(0, num_clumps);
+    double z = 0.;
+    for (const auto& p : pos)
+        z += p.z;
+    res.meanZ = z / pos.size();
+}
+
+// Random clumps poured through a funnel onto the floor, like DEMdemo_Repose
+BenchResult RunRepose(bool use_sleeping) {
+    DEMSolver DEMSim;
+    DEMSim.UseFrictionalHertzianModel();
+    DEMSim.SetVerbosity(QUIET);
+    DEMSim.SetNoForceRecord();
+    DEMSim.EnableSleeping(use_sleeping);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> unif(0.f, 1.f);
+    auto mat_type_walls = DEMSim.LoadMaterial({{"E", 1e8}, {"nu", 0.3}, {"CoR", 0.3}, {"mu", 1}});
+    auto mat_type_particles = DEMSim.LoadMaterial({{"E", 1e9}, {"nu", 0.3}, {"CoR", 0.3}, {"mu", 1}});
+
+    auto funnel = DEMSim.AddWavefrontMeshObject(GetDEMEDataFile("mesh/funnel.obj"), mat_type_walls);
+    funnel->Scale(0.15);
+
+    const float min_rad = 0.02, max_rad = 0.04;
+    std::vector<std::shared_ptr<DEMClumpTemplate>> clump_types;
+    for (int i = 0; i < 6; i++) {
+        int num_sphere = i % 5 + 1;
+        float mass = 0.8 * (float)num_sphere;
+        float3 MOI = make_float3(2e-5, 1.5e-5, 1.8e-5) * (float)num_sphere * 1600.;
+        std::vector<float> radii;
+        std::vector<float3> relPos;
+        for (int j = 0; j < num_sphere; j++) {
+            radii.push_back(min_rad + unif(gen) * (max_rad - min_rad));
+            relPos.push_back(j == 0 ? make_float3(0)
+                                    : make_float3(unif(gen) - 0.5f, unif(gen) - 0.5f, unif(gen) - 0.5f) * 0.04f);
+        }
+        clump_types.push_back(DEMSim.LoadClumpType(mass, MOI, radii, relPos, mat_type_particles));
+    }
+
+    const float spacing = 0.16, fill_width = 1.5;
+    PDSampler sampler(spacing);
+    std::vector<std::shared_ptr<DEMClumpTemplate>> pile_types;
+    std::vector<float3> pile_xyz;
+    for (float layer_z = 0; layer_z < 2.f * fill_width; layer_z += spacing) {
+        auto layer_xyz = sampler.SampleCylinderZ(make_float3(0, 0, fill_width + spacing + layer_z), fill_width, 0);
+        for (size_t i = 0; i < layer_xyz.size(); i++)
+            pile_types.push_back(clump_types.at(i % clump_types.size()));
+        pile_xyz.insert(pile_xyz.end(), layer_xyz.begin(), layer_xyz.end());
+    }
+    DEMSim.AddClumps(pile_types, pile_xyz);
+
+    DEMSim.InstructBoxDomainDimension({-5, 5}, {-5, 5}, {-5, 10});
+    DEMSim.InstructBoxDomainBoundingBC("top_open", mat_type_walls);
+    DEMSim.SetInitTimeStep(5e-6);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    DEMSim.SetMaxVelocity(25.);
+    DEMSim.Initialize();
+
+    BenchResult res;
+    TimePhases(DEMSim, 2.0, 1.0, pile_xyz.size(), res);
+    return res;
+}
+
+// GRC-like clumps settling in a box, like DEMdemo_GRCPrep_Part1
+BenchResult RunGRCPrep(bool use_sleeping) {
+    DEMSolver DEMSim;
+    DEMSim.SetVerbosity(QUIET);
+    DEMSim.SetNoForceRecord();
+    DEMSim.EnableSleeping(use_sleeping);
+
+    auto mat_type_terrain = DEMSim.LoadMaterial({{"E", 1e9}, {"nu", 0.3}, {"CoR", 0.3}, {"mu", 0.5}});
+    const float world_size = 0.3;
+    DEMSim.InstructBoxDomainDimension(world_size, world_size, 2. * world_size);
+    DEMSim.InstructBoxDomainBoundingBC("top_open", mat_type_terrain);
+
+    // The GRCPrep templates, scaled larger so the particle count stays moderate
+    const float terrain_density = 2.6e3;
+    float mass1 = terrain_density * 4.2520508;
+    float3 MOI1 = make_float3(1.6850426, 1.6375114, 2.1187753) * terrain_density;
+    float mass2 = terrain_density * 2.1670011;
+    float3 MOI2 = make_float3(0.57402126, 0.60616378, 0.92890173) * terrain_density;
+    std::vector<double> scales = {0.014, 0.0075833, 0.0044, 0.003};
+    auto template2 =
+        DEMSim.LoadClumpType(mass2, MOI2, GetDEMEDataFile("clumps/triangular_flat_6comp.csv"), mat_type_terrain);
+    auto template1 =
+        DEMSim.LoadClumpType(mass1, MOI1, GetDEMEDataFile("clumps/triangular_flat.csv"), mat_type_terrain);
+    std::vector<std::shared_ptr<DEMClumpTemplate>> templates = {template2, DEMSim.Duplicate(template2), template1,
+                                                                DEMSim.Duplicate(template1)};
+    for (size_t i = 0; i < scales.size(); i++) {
+        templates.at(i)->Scale(scales.at(i) * 1.5);
+    }
+
+    std::mt19937 gen(759);
+    std::discrete_distribution<int> pick({0.1, 0.2, 0.3, 0.4});
+    HCPSampler sampler(scales.at(0) * 1.5 * 2.2);
+    float half = world_size / 2. - scales.at(0) * 1.5 * 1.2;
+    auto xyz = sampler.SampleBox(make_float3(0, 0, 0), make_float3(half, half, 0.25));
+    std::vector<std::shared_ptr<DEMClumpTemplate>> types;
+    for (size_t i = 0; i < xyz.size(); i++) {
+        types.push_back(templates.at(pick(gen)));
+    }
+    DEMSim.AddClumps(types, xyz);
+
+    DEMSim.SetInitTimeStep(2e-6);
+    DEMSim.SetGravitationalAcceleration(make_float3(0, 0, -9.81));
+    DEMSim.SetMaxVelocity(15.);
+    DEMSim.Initialize();
+
+    BenchResult res;
+    TimePhases(DEMSim, 0.8, 0.4, xyz.size(), res);
+    return res;
+}
+
+void Report(const char* name, const BenchResult& off, const BenchResult& on) {
+    std::cout << name << ", " << on.numOwners << ", " << on.numAsleep << ", " << off.settleTime << ", "
+              << on.settleTime << ", " << off.restTime << ", " << on.restTime << ", " << off.restTime / on.restTime
+              << ", " << off.meanZ << ", " << on.meanZ << std::endl;
+}
+
+int main() {
+    std::cout << "case, num_owners, num_asleep, settle_off(s), settle_on(s), rest_off(s), rest_on(s), rest_speedup, "
+                 "mean_z_off, mean_z_on"
+              << std::endl;
+    Report("Repose", RunRepose(false), RunRepose(true));
+    Report("GRCPrep", RunGRCPrep(false), RunGRCPrep(true));
+    std::cout << "DEMdemo_SleepingBenchmark exiting..." << std::endl;
+    return 0;
+}
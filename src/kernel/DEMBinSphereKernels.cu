@@ -11,8 +11,9 @@ _analyticalEntityDefs_;
 __global__ void getNumberOfBinsEachSphereTouches(deme::DEMSimParams* simParams,
                                                  deme::DEMDataKT* granData,
                                                  deme::binsSphereTouches_t* numBinsSphereTouches,
-                                                 deme::objID_t* numAnalGeoSphereTouches) {
-    deme::bodyID_t sphereID = blockIdx.x * blockDim.x + threadIdx.x;
+                                                 deme::objID_t* numAnalGeoSphereTouches,
+                                                 bool binSpheres) {
+    deme::bodyID_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (sphereID < simParams->nSpheresGM) {
         // Register sphere--analytical geometry contacts
         deme::objID_t contact_count = 0;
@@ -48,8 +49,9 @@ __global__ void getNumberOfBinsEachSphereTouches(deme::DEMSimParams* simParams,
                 myPosXYZ = ownerXYZ + to_double3(myRelPos);
             }
 
-            deme::binsSphereTouches_t numX, numY, numZ;
-            {
+            // If the bins are not needed (see contactDetection), the spheres only look for analytical contacts
+            deme::binsSphereTouches_t numX = 0, numY = 0, numZ = 0;
+            if (binSpheres) {
                 // The bin number that I live in (with fractions)?
                 double myBinX = myPosXYZ.x / simParams->binSize;
                 double myBinY = myPosXYZ.y / simParams->binSize;
@@ -138,8 +140,9 @@ __global__ void populateBinSphereTouchingPairs(deme::DEMSimParams* simParams,
                                                deme::bodyID_t* sphereIDsEachBinTouches,
                                                deme::bodyID_t* idGeoA,
                                                deme::bodyID_t* idGeoB,
-                                               deme::contact_t* contactType) {
-    deme::bodyID_t sphereID = blockIdx.x * blockDim.x + threadIdx.x;
+                                               deme::contact_t* contactType,
+                                               bool binSpheres) {
+    deme::bodyID_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (sphereID < simParams->nSpheresGM) {
         double3 myPosXYZ;
         double myRadius;
@@ -187,7 +190,7 @@ __global__ void populateBinSphereTouchingPairs(deme::DEMSimParams* simParams,
             // Now, write the IDs of those bins that I touch, back to the global memory
             deme::binID_t thisBinID;
             for (deme::binID_t k = (deme::binID_t)((myBinZ - myRadiusSpan > 0.0) ? myBinZ - myRadiusSpan : 0.0);
-                 (k <= (deme::binID_t)(myBinZ + myRadiusSpan)) && (k < simParams->nbZ); k++) {
+                 binSpheres && (k <= (deme::binID_t)(myBinZ + myRadiusSpan)) && (k < simParams->nbZ); k++) {
                 for (deme::binID_t j = (deme::binID_t)((myBinY - myRadiusSpan > 0.0) ? myBinY - myRadiusSpan : 0.0);
                      (j <= (deme::binID_t)(myBinY + myRadiusSpan)) && (j < simParams->nbY); j++) {
                     for (deme::binID_t i = (deme::binID_t)((myBinX - myRadiusSpan > 0.0) ? myBinX - myRadiusSpan : 0.0);
@@ -27,7 +27,7 @@ __global__ void makeTriangleSandwich(deme::DEMSimParams* simParams,
                                      float3* sandwichBNode1,
                                      float3* sandwichBNode2,
                                      float3* sandwichBNode3) {
-    deme::bodyID_t triID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::bodyID_t triID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (triID < simParams->nTriGM) {
         // Get my component offset info from global array
         const float3 p1 = granData->relPosNode1[triID];
@@ -93,8 +93,13 @@ __global__ void getNumberOfBinsEachTriangleTouches(deme::DEMSimParams* simParams
                                                    float3* nodeA2,
                                                    float3* nodeB2,
                                                    float3* nodeC2) {
-    deme::bodyID_t triID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::bodyID_t triID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (triID < simParams->nTriGM) {
+        // Facets of rigid meshes that have local-frame grids are not binned
+        if (simParams->nMeshGrids > 0 && granData->triInMeshGrid[triID]) {
+            numBinsTriTouches[triID] = 0;
+            return;
+        }
         // 3 vertices of the triangle
         float3 vA1, vB1, vC1, vA2, vB2, vC2;
         deme::binID_t L1[3], L2[3], U1[3], U2[3];
@@ -147,8 +152,12 @@ __global__ void populateBinTriangleTouchingPairs(deme::DEMSimParams* simParams,
                                                  float3* nodeA2,
                                                  float3* nodeB2,
                                                  float3* nodeC2) {
-    deme::bodyID_t triID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::bodyID_t triID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (triID < simParams->nTriGM) {
+        // Those are taken care of by local-frame grids, and reported 0 touched bins
+        if (simParams->nMeshGrids > 0 && granData->triInMeshGrid[triID]) {
+            return;
+        }
         // 3 vertices of the triangle
         float3 vA1, vB1, vC1, vA2, vB2, vC2;
         deme::binID_t L1[3], L2[3], U1[3], U2[3];
@@ -206,7 +215,7 @@ __global__ void mapTriActiveBinsToSphActiveBins(deme::binID_t* activeBinIDsForTr
                                                 deme::binID_t* mapTriActBinToSphActBin,
                                                 size_t numActiveBinsForTri,
                                                 size_t numActiveBinsForSph) {
-    size_t threadID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t threadID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (threadID < numActiveBinsForTri) {
         deme::binID_t binID = activeBinIDsForTri[threadID];
         deme::binID_t indexInOther;
@@ -0,0 +1,152 @@
+// DEM coarse-graining helpers, shared by the host and the device paths (see DEM/utils/CoarseGraining.hpp)
+
+#ifndef DEME_COARSE_GRAINING_HELPERS_CUH
+#define DEME_COARSE_GRAINING_HELPERS_CUH
+
+#include <DEM/Defines.h>
+
+namespace deme {
+
+// Number of raw fields deposited on a grid node, and where each starts
+#define DEME_CG_NUM_RAW_FIELDS 20
+enum CG_RAW_FIELD : unsigned int {
+    CG_RAW_MASS = 0,            // sum of m * w
+    CG_RAW_VOLUME = 1,          // sum of V * w
+    CG_RAW_MOMENTUM = 2,        // sum of m * v * w (x, y, z)
+    CG_RAW_MVV = 5,             // sum of m * v (x) v * w (xx, yy, zz, xy, xz, yz)
+    CG_RAW_CONTACT_STRESS = 11  // sum of f (x) b * w (xx, xy, xz, yx, yy, yz, zx, zy, zz)
+};
+
+// Weight (coarse-graining kernel) functions
+enum class CG_WEIGHT : unsigned int {
+    // exp(-r^2 / (2 w^2)) / ((2 pi)^(3/2) w^3), cut off at 3 w (and scaled up to still integrate to 1)
+    GAUSSIAN = 0,
+    // 105 / (16 pi c^3) * (1 + 3 r / c) * (1 - r / c)^3, with support c = w
+    LUCY = 1
+};
+
+// A grid of nX * nY * nZ nodes (x fastest), and the cell list of deposited entities. The cells are as large as the
+// weight's cutoff, so the entities that reach a node are in the 27 cells around it.
+struct CGGridParams {
+    double loX, loY, loZ;
+    double spacing;
+    unsigned int nX, nY, nZ;
+    CG_WEIGHT weight;
+    double width;
+    double cutoff;
+    double cellLoX, cellLoY, cellLoZ;
+    unsigned int nCellX, nCellY, nCellZ;
+};
+
+// A deposited owner; an owner that is not deposited has a NaN position
+struct CGParticle {
+    double x, y, z;
+    float mass, volume;
+    float vX, vY, vZ;
+};
+
+// A deposited contact at its contact point: the force on A and the branch vector b (from B's center to A's, or from
+// the contact point to A's center if B is not a particle); a contact that is not deposited has a NaN position
+struct CGContact {
+    double x, y, z;
+    float fX, fY, fZ;
+    float bX, bY, bZ;
+};
+
+inline __host__ __device__ size_t cgNumNodes(const CGGridParams& g) {
+    return (size_t)g.nX * g.nY * g.nZ;
+}
+
+inline __host__ __device__ unsigned int cgNumCells(const CGGridParams& g) {
+    return g.nCellX * g.nCellY * g.nCellZ;
+}
+
+// The weight at squared distance r2
+inline __host__ __device__ double cgWeight(const CGGridParams& g, double r2) {
+    if (r2 >= g.cutoff * g.cutoff)
+        return 0.;
+    if (g.weight == CG_WEIGHT::GAUSSIAN) {
+        // (2 pi)^(3/2) times the part of the Gaussian within 3 w
+        return exp(-r2 / (2. * g.width * g.width)) / (15.288289907833517 * g.width * g.width * g.width);
+    }
+    const double q = sqrt(r2) / g.cutoff;
+    const double oneMinusQ = 1. - q;
+    // 105 / (16 pi)
+    return 2.0889086280811262 / (g.cutoff * g.cutoff * g.cutoff) * (1. + 3. * q) * oneMinusQ * oneMinusQ * oneMinusQ;
+}
+
+// The cell of a position, or the number of cells if it is outside the cell grid (or NaN)
+inline __host__ __device__ unsigned int cgCellOf(const CGGridParams& g, double x, double y, double z) {
+    const double fx = (x - g.cellLoX) / g.cutoff, fy = (y - g.cellLoY) / g.cutoff, fz = (z - g.cellLoZ) / g.cutoff;
+    if (!(fx >= 0. && fx < (double)g.nCellX && fy >= 0. && fy < (double)g.nCellY && fz >= 0. &&
+          fz < (double)g.nCellZ))
+        return cgNumCells(g);
+    return (unsigned int)fx + g.nCellX * ((unsigned int)fy + g.nCellY * (unsigned int)fz);
+}
+
+// The raw fields of a node, from the particles and contacts sorted by cell (cell c holds the entries from starts[c] to
+// starts[c + 1]). The cells, and the entries in a cell, are visited in a fixed order, so the sums do not depend on how
+// the nodes are distributed among threads.
+inline __host__ __device__ void cgGatherNode(const CGGridParams& g,
+                                             size_t node,
+                                             const CGParticle* particles,
+                                             const contactPairs_t* particleStarts,
+                                             const CGContact* contacts,
+                                             const contactPairs_t* contactStarts,
+                                             double* out) {
+    for (unsigned int f = 0; f < DEME_CG_NUM_RAW_FIELDS; f++)
+        out[f] = 0.;
+    const unsigned int iX = node % g.nX, iY = (node / g.nX) % g.nY, iZ = node / ((size_t)g.nX * g.nY);
+    const double pX = g.loX + iX * g.spacing, pY = g.loY + iY * g.spacing, pZ = g.loZ + iZ * g.spacing;
+    const int cX = (int)((pX - g.cellLoX) / g.cutoff), cY = (int)((pY - g.cellLoY) / g.cutoff),
+              cZ = (int)((pZ - g.cellLoZ) / g.cutoff);
+    for (int z = cZ - 1; z <= cZ + 1; z++) {
+        if (z < 0 || z >= (int)g.nCellZ)
+            continue;
+        for (int y = cY - 1; y <= cY + 1; y++) {
+            if (y < 0 || y >= (int)g.nCellY)
+                continue;
+            for (int x = cX - 1; x <= cX + 1; x++) {
+                if (x < 0 || x >= (int)g.nCellX)
+                    continue;
+                const unsigned int cell = x + g.nCellX * (y + g.nCellY * z);
+                for (contactPairs_t i = particleStarts[cell]; i < particleStarts[cell + 1]; i++) {
+                    const CGParticle& p = particles[i];
+                    const double dx = p.x - pX, dy = p.y - pY, dz = p.z - pZ;
+                    const double w = cgWeight(g, dx * dx + dy * dy + dz * dz);
+                    if (w == 0.)
+                        continue;
+                    const double mw = p.mass * w;
+                    out[CG_RAW_MASS] += mw;
+                    out[CG_RAW_VOLUME] += p.volume * w;
+                    out[CG_RAW_MOMENTUM + 0] += mw * p.vX;
+                    out[CG_RAW_MOMENTUM + 1] += mw * p.vY;
+                    out[CG_RAW_MOMENTUM + 2] += mw * p.vZ;
+                    out[CG_RAW_MVV + 0] += mw * p.vX * p.vX;
+                    out[CG_RAW_MVV + 1] += mw * p.vY * p.vY;
+                    out[CG_RAW_MVV + 2] += mw * p.vZ * p.vZ;
+                    out[CG_RAW_MVV + 3] += mw * p.vX * p.vY;
+                    out[CG_RAW_MVV + 4] += mw * p.vX * p.vZ;
+                    out[CG_RAW_MVV + 5] += mw * p.vY * p.vZ;
+                }
+                for (contactPairs_t i = contactStarts[cell]; i < contactStarts[cell + 1]; i++) {
+                    const CGContact& c = contacts[i];
+                    const double dx = c.x - pX, dy = c.y - pY, dz = c.z - pZ;
+                    const double w = cgWeight(g, dx * dx + dy * dy + dz * dz);
+                    if (w == 0.)
+                        continue;
+                    const double f[3] = {c.fX * w, c.fY * w, c.fZ * w};
+                    const double b[3] = {c.bX, c.bY, c.bZ};
+                    for (unsigned int r = 0; r < 3; r++) {
+                        for (unsigned int s = 0; s < 3; s++)
+                            out[CG_RAW_CONTACT_STRESS + 3 * r + s] += f[r] * b[s];
+                    }
+                }
+            }
+        }
+    }
+}
+
+}  // namespace deme
+
+#endif
@@ -0,0 +1,161 @@
+// DEM kernels used for coarse-graining particle and contact fields onto a grid (see DEM/utils/CoarseGraining.hpp)
+#include <DEM/Defines.h>
+#include <DEMHelperKernels.cuh>
+#include <DEMCoarseGrainingHelpers.cuh>
+_kernelIncludes_;
+
+// Mass properties are below, if jitified mass properties are in use
+_massDefs_;
+_moiDefs_;
+_volumeDefs_;
+
+// The record of each owner (clumps are deposited, other owners get a NaN position), its cell and its index
+__global__ void extractCGParticles(deme::DEMDataDT* granData,
+                                   deme::DEMSimParams* simParams,
+                                   deme::CGGridParams grid,
+                                   deme::CGParticle* particles,
+                                   unsigned int* cells,
+                                   deme::contactPairs_t* ids,
+                                   size_t nOwnerBodies) {
+    deme::bodyID_t myOwner = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myOwner < nOwnerBodies) {
+        deme::CGParticle rec;
+        rec.x = rec.y = rec.z = nan("");
+        rec.mass = rec.volume = rec.vX = rec.vY = rec.vZ = 0.f;
+        if (granData->ownerTypes[myOwner] & deme::OWNER_T_CLUMP) {
+            float myMass;
+            // Get my mass info from either jitified arrays or global memory
+            // Outputs myMass
+            // Use an input named exactly `myOwner' which is the id of this owner
+            { _massAcqStrat_; }
+            double ownerX, ownerY, ownerZ;
+            voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+                ownerX, ownerY, ownerZ, granData->voxelID[myOwner], granData->locX[myOwner], granData->locY[myOwner],
+                granData->locZ[myOwner], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+            rec.x = ownerX + simParams->LBFX;
+            rec.y = ownerY + simParams->LBFY;
+            rec.z = ownerZ + simParams->LBFZ;
+            rec.mass = myMass;
+            rec.volume = volumeProperties[granData->inertiaPropOffsets[myOwner]];
+            rec.vX = granData->vX[myOwner];
+            rec.vY = granData->vY[myOwner];
+            rec.vZ = granData->vZ[myOwner];
+        }
+        particles[myOwner] = rec;
+        cells[myOwner] = deme::cgCellOf(grid, rec.x, rec.y, rec.z);
+        ids[myOwner] = myOwner;
+    }
+}
+
+// The record of each contact (force-bearing ones are deposited, others get a NaN position), its cell and its index
+__global__ void extractCGContacts(deme::DEMDataDT* granData,
+                                  deme::DEMSimParams* simParams,
+                                  deme::CGGridParams grid,
+                                  deme::CGContact* contacts,
+                                  unsigned int* cells,
+                                  deme::contactPairs_t* ids,
+                                  size_t nContactPairs) {
+    deme::contactPairs_t myContactID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myContactID < nContactPairs) {
+        deme::CGContact rec;
+        rec.x = rec.y = rec.z = nan("");
+        rec.fX = rec.fY = rec.fZ = rec.bX = rec.bY = rec.bZ = 0.f;
+        const deme::contact_t myContactType = granData->contactType[myContactID];
+        const float3 myForce = granData->contactForces[myContactID];
+        if (myContactType != deme::NOT_A_CONTACT && length(myForce) > DEME_TINY_FLOAT) {
+            const deme::bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[myContactID]];
+            const deme::bodyID_t ownerB = DEME_GET_GEO_OWNER_ID(granData->idGeometryB[myContactID], myContactType);
+            double3 posA, posB;
+            voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+                posA.x, posA.y, posA.z, granData->voxelID[ownerA], granData->locX[ownerA], granData->locY[ownerA],
+                granData->locZ[ownerA], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+            // The contact point is stored in A's frame, relative to its CoM
+            float3 myCntPnt = granData->contactPointGeometryA[myContactID];
+            applyOriQToVector3<float, deme::oriQ_t>(myCntPnt.x, myCntPnt.y, myCntPnt.z, granData->oriQw[ownerA],
+                                                    granData->oriQx[ownerA], granData->oriQy[ownerA],
+                                                    granData->oriQz[ownerA]);
+            rec.x = posA.x + myCntPnt.x + simParams->LBFX;
+            rec.y = posA.y + myCntPnt.y + simParams->LBFY;
+            rec.z = posA.z + myCntPnt.z + simParams->LBFZ;
+            rec.fX = myForce.x;
+            rec.fY = myForce.y;
+            rec.fZ = myForce.z;
+            if (myContactType == deme::SPHERE_SPHERE_CONTACT) {
+                voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+                    posB.x, posB.y, posB.z, granData->voxelID[ownerB], granData->locX[ownerB],
+                    granData->locY[ownerB], granData->locZ[ownerB], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+                rec.bX = posA.x - posB.x;
+                rec.bY = posA.y - posB.y;
+                rec.bZ = posA.z - posB.z;
+            } else {
+                // A mesh or an analytical boundary takes the other part of the branch
+                rec.bX = -myCntPnt.x;
+                rec.bY = -myCntPnt.y;
+                rec.bZ = -myCntPnt.z;
+            }
+        }
+        contacts[myContactID] = rec;
+        cells[myContactID] = deme::cgCellOf(grid, rec.x, rec.y, rec.z);
+        ids[myContactID] = myContactID;
+    }
+}
+
+// Put the records in the order of sortedIds
+__global__ void permuteCGParticles(const deme::CGParticle* in,
+                                   const deme::contactPairs_t* sortedIds,
+                                   deme::CGParticle* out,
+                                   size_t n) {
+    size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) {
+        out[i] = in[sortedIds[i]];
+    }
+}
+
+__global__ void permuteCGContacts(const deme::CGContact* in,
+                                  const deme::contactPairs_t* sortedIds,
+                                  deme::CGContact* out,
+                                  size_t n) {
+    size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) {
+        out[i] = in[sortedIds[i]];
+    }
+}
+
+// Where each cell's entries begin in the sorted cells (starts has nCells + 1 entries; the entries out of the cell grid
+// are sorted last, past starts[nCells])
+__global__ void findCGCellStarts(const unsigned int* sortedCells,
+                                 size_t n,
+                                 unsigned int nCells,
+                                 deme::contactPairs_t* starts) {
+    size_t cell = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (cell <= nCells) {
+        size_t lo = 0, hi = n;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (sortedCells[mid] < cell) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        starts[cell] = lo;
+    }
+}
+
+// Each node gathers its raw fields, and adds them to the window sums
+__global__ void gatherCGNodes(deme::CGGridParams grid,
+                              const deme::CGParticle* particles,
+                              const deme::contactPairs_t* particleStarts,
+                              const deme::CGContact* contacts,
+                              const deme::contactPairs_t* contactStarts,
+                              double* sums,
+                              size_t nNodes) {
+    size_t node = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (node < nNodes) {
+        double nodeFields[DEME_CG_NUM_RAW_FIELDS];
+        deme::cgGatherNode(grid, node, particles, particleStarts, contacts, contactStarts, nodeFields);
+        for (unsigned int f = 0; f < DEME_CG_NUM_RAW_FIELDS; f++) {
+            sums[node * DEME_CG_NUM_RAW_FIELDS + f] += nodeFields[f];
+        }
+    }
+}
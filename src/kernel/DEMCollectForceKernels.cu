@@ -14,7 +14,7 @@ __global__ void cashInOwnerIndexA(deme::bodyID_t* idOwner,
                                   deme::bodyID_t* ownerClumpBody,
                                   deme::contact_t* contactType,
                                   size_t nContactPairs) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < nContactPairs) {
         deme::bodyID_t thisBodyID = id[myID];
         idOwner[myID] = ownerClumpBody[thisBodyID];
@@ -27,7 +27,7 @@ __global__ void cashInOwnerIndexB(deme::bodyID_t* idOwner,
                                   deme::bodyID_t* ownerMesh,
                                   deme::contact_t* contactType,
                                   size_t nContactPairs) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < nContactPairs) {
         deme::bodyID_t thisBodyID = id[myID];
         deme::contact_t thisCntType = contactType[myID];
@@ -54,7 +54,7 @@ __global__ void cashInMassMoiIndex(float* massOwner,
     const float moiZ[] = {_moiZ_};
     const float MassProperties[] = {_MassProperties_};
 
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < nContactPairs) {
         deme::bodyID_t thisOwnerID = idOwner[myID];
         deme::inertiaOffset_t myMassOffset = inertiaPropOffsets[thisOwnerID];
@@ -75,7 +75,7 @@ __global__ void forceToAcc(float3* acc,
                            float modifier,
                            size_t n,
                            deme::DEMDataDT* granData) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         float myMass;
         const deme::bodyID_t myOwner = owner[myID];
@@ -100,7 +100,7 @@ __global__ void forceToAngAcc(float3* angAcc,
                               float modifier,
                               size_t n,
                               deme::DEMDataDT* granData) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         const deme::bodyID_t myOwner = owner[myID];
         float3 myMOI;
@@ -125,7 +125,7 @@ __global__ void forceToAngAcc(float3* angAcc,
 
 // Place information to an array based on an index array and a value array
 __global__ void stashElem(float* out1, float* out2, float* out3, deme::bodyID_t* index, float3* value, size_t n) {
-    deme::bodyID_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::bodyID_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         // my_index is unique, no race condition
         deme::bodyID_t my_index = index[myID];
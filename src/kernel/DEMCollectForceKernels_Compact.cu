@@ -11,7 +11,7 @@ _moiDefs_;
 
 // computes a ./ b
 __global__ void forceToAcc(deme::DEMDataDT* granData, size_t n) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         deme::contact_t thisCntType = granData->contactType[myID];
         const float3 F = granData->contactForces[myID];
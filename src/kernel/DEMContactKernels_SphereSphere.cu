@@ -435,3 +435,227 @@ __global__ void populateSphSphContactPairsEachBin(deme::DEMSimParams* simParams,
         }
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// Hierarchical-grid sphere--sphere contact detection. See DEM/utils/HierarchicalGrid.hpp for the scheme and the host
+// reference.
+////////////////////////////////////////////////////////////////////////////////
+
+inline __device__ unsigned int hierGridLevelOf(const float& radius,
+                                               const double& cellSize0,
+                                               const unsigned int& nLevels) {
+    unsigned int l = 0;
+    double c = cellSize0;
+    while (c < 2. * radius && l + 1 < nLevels) {
+        c *= 2.;
+        l++;
+    }
+    return l;
+}
+
+inline __device__ int3 hierGridLevelDims(deme::DEMSimParams* simParams, const double& cellSize) {
+    return make_int3((int)ceil((double)((uint64_t)1 << simParams->nvXp2) * simParams->voxelSize / cellSize),
+                     (int)ceil((double)((uint64_t)1 << simParams->nvYp2) * simParams->voxelSize / cellSize),
+                     (int)ceil((double)((uint64_t)1 << simParams->nvZp2) * simParams->voxelSize / cellSize));
+}
+
+inline __device__ int3 hierGridCellOf(const double3& pos, const double& cellSize, const int3& dims) {
+    int3 cell;
+    cell.x = DEME_MIN(DEME_MAX((int)floor(pos.x / cellSize), 0), dims.x - 1);
+    cell.y = DEME_MIN(DEME_MAX((int)floor(pos.y / cellSize), 0), dims.y - 1);
+    cell.z = DEME_MIN(DEME_MAX((int)floor(pos.z / cellSize), 0), dims.z - 1);
+    return cell;
+}
+
+inline __device__ uint64_t hierGridCellKey(const unsigned int& level, const int3& cell, const int3& dims) {
+    return ((uint64_t)level << (64 - DEME_HIER_GRID_LEVEL_BITS)) |
+           ((uint64_t)cell.x + (uint64_t)dims.x * ((uint64_t)cell.y + (uint64_t)dims.y * (uint64_t)cell.z));
+}
+
+// First and one-past-last index of key in the sorted array
+inline __device__ void hierGridKeyRange(const uint64_t* sortedKeys,
+                                        const deme::bodyID_t& n,
+                                        const uint64_t& key,
+                                        deme::bodyID_t& first,
+                                        deme::bodyID_t& last) {
+    deme::bodyID_t lo = 0, hi = n;
+    while (lo < hi) {
+        deme::bodyID_t mid = lo + (hi - lo) / 2;
+        if (sortedKeys[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    first = lo;
+    hi = n;
+    while (lo < hi) {
+        deme::bodyID_t mid = lo + (hi - lo) / 2;
+        if (sortedKeys[mid] <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    last = lo;
+}
+
+// Position (relative to the LBF point of the world) and CD radius (margin included) of each sphere
+__global__ void computeSphereHierGridInputs(deme::DEMSimParams* simParams,
+                                            deme::DEMDataKT* granData,
+                                            double3* sphPos,
+                                            float* sphRadius) {
+    deme::bodyID_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (sphereID < simParams->nSpheresGM) {
+        deme::bodyID_t ownerID, bodyID;
+        deme::family_t ownerFamily;
+        float radius;
+        double X, Y, Z;
+        fillSharedMemSpheres<float, double>(simParams, granData, 0, sphereID, &ownerID, &bodyID, &ownerFamily, &radius,
+                                            &X, &Y, &Z);
+        sphPos[sphereID] = make_double3(X, Y, Z);
+        sphRadius[sphereID] = radius;
+    }
+}
+
+__global__ void getSphereHierGridKeys(deme::DEMSimParams* simParams,
+                                      double3* sphPos,
+                                      float* sphRadius,
+                                      uint64_t* cellKeys,
+                                      deme::bodyID_t* sphereIDs,
+                                      double cellSize0,
+                                      unsigned int nLevels) {
+    deme::bodyID_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (sphereID < simParams->nSpheresGM) {
+        const unsigned int level = hierGridLevelOf(sphRadius[sphereID], cellSize0, nLevels);
+        const double cellSize = cellSize0 * (double)((uint64_t)1 << level);
+        const int3 dims = hierGridLevelDims(simParams, cellSize);
+        cellKeys[sphereID] = hierGridCellKey(level, hierGridCellOf(sphPos[sphereID], cellSize, dims), dims);
+        sphereIDs[sphereID] = sphereID;
+    }
+}
+
+// Sphere i (in sorted order) checks the 27 cells around it at its own level and all coarser levels. Same-level pairs
+// are reported by the sphere with the smaller ID, cross-level pairs by the finer sphere.
+template <bool FILL>
+inline __device__ deme::contactPairs_t sphereHierGridContacts(deme::DEMSimParams* simParams,
+                                                              deme::DEMDataKT* granData,
+                                                              const deme::bodyID_t& i,
+                                                              const uint64_t* sortedKeys,
+                                                              const deme::bodyID_t* sortedIDs,
+                                                              const double3* sphPos,
+                                                              const float* sphRadius,
+                                                              const double& cellSize0,
+                                                              const unsigned int& nLevels,
+                                                              deme::bodyID_t* idSphA,
+                                                              deme::bodyID_t* idSphB,
+                                                              deme::contact_t* dType,
+                                                              const deme::contactPairs_t& reportOffset,
+                                                              const deme::contactPairs_t& reportOffset_end) {
+    const deme::bodyID_t n = simParams->nSpheresGM;
+    const deme::bodyID_t myID = sortedIDs[i];
+    const unsigned int myLevel = (unsigned int)(sortedKeys[i] >> (64 - DEME_HIER_GRID_LEVEL_BITS));
+    const double3 myPos = sphPos[myID];
+    const float myRadius = sphRadius[myID];
+    const deme::bodyID_t myOwner = granData->ownerClumpBody[myID];
+    const unsigned int myFamily = granData->familyID[myOwner];
+    const float myArtificialMargin = granData->familyExtraMarginSize[myFamily];
+
+    deme::contactPairs_t count = 0;
+    for (unsigned int l = myLevel; l < nLevels; l++) {
+        const double cellSize = cellSize0 * (double)((uint64_t)1 << l);
+        const int3 dims = hierGridLevelDims(simParams, cellSize);
+        const int3 myCell = hierGridCellOf(myPos, cellSize, dims);
+        for (int dz = -1; dz <= 1; dz++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    const int3 cell = make_int3(myCell.x + dx, myCell.y + dy, myCell.z + dz);
+                    if (cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= dims.x || cell.y >= dims.y ||
+                        cell.z >= dims.z)
+                        continue;
+                    deme::bodyID_t first, last;
+                    hierGridKeyRange(sortedKeys, n, hierGridCellKey(l, cell, dims), first, last);
+                    for (deme::bodyID_t k = first; k < last; k++) {
+                        const deme::bodyID_t otherID = sortedIDs[k];
+                        if (l == myLevel && otherID <= myID)
+                            continue;
+                        const deme::bodyID_t otherOwner = granData->ownerClumpBody[otherID];
+                        if (otherOwner == myOwner)
+                            continue;
+                        // Grab family number from memory (not jitified: b/c family number can change frequently)
+                        const unsigned int otherFamily = granData->familyID[otherOwner];
+                        unsigned int maskMatID = locateMaskPair<unsigned int>(myFamily, otherFamily);
+                        if (granData->familyMasks[maskMatID] != deme::DONT_PREVENT_CONTACT)
+                            continue;
+
+                        const double3 otherPos = sphPos[otherID];
+                        double contactPntX, contactPntY, contactPntZ, overlapDepth;
+                        float normX, normY, normZ;
+                        bool in_contact = checkSpheresOverlap<double, float>(
+                            myPos.x, myPos.y, myPos.z, myRadius, otherPos.x, otherPos.y, otherPos.z,
+                            sphRadius[otherID], contactPntX, contactPntY, contactPntZ, normX, normY, normZ,
+                            overlapDepth);
+                        // Same as the bin-based kernels: the overlap must be larger than the smaller artificial margin
+                        float otherArtificialMargin = granData->familyExtraMarginSize[otherFamily];
+                        float artificialMargin =
+                            (myArtificialMargin < otherArtificialMargin) ? myArtificialMargin : otherArtificialMargin;
+                        if (!in_contact || overlapDepth <= (double)artificialMargin)
+                            continue;
+
+                        if (FILL) {
+                            deme::contactPairs_t offset = reportOffset + count;
+                            if (offset < reportOffset_end) {
+                                idSphA[offset] = (myID < otherID) ? myID : otherID;
+                                idSphB[offset] = (myID < otherID) ? otherID : myID;
+                                dType[offset] = deme::SPHERE_SPHERE_CONTACT;
+                            }
+                        }
+                        count++;
+                    }
+                }
+            }
+        }
+    }
+    return count;
+}
+
+__global__ void getNumberOfSphereContactsHierGrid(deme::DEMSimParams* simParams,
+                                                  deme::DEMDataKT* granData,
+                                                  uint64_t* sortedKeys,
+                                                  deme::bodyID_t* sortedIDs,
+                                                  double3* sphPos,
+                                                  float* sphRadius,
+                                                  deme::binContactPairs_t* numContactsEachSphere,
+                                                  double cellSize0,
+                                                  unsigned int nLevels) {
+    deme::bodyID_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < simParams->nSpheresGM) {
+        numContactsEachSphere[i] = sphereHierGridContacts<false>(simParams, granData, i, sortedKeys, sortedIDs, sphPos,
+                                                                 sphRadius, cellSize0, nLevels, nullptr, nullptr,
+                                                                 nullptr, 0, 0);
+    }
+}
+
+__global__ void populateSphSphContactPairsHierGrid(deme::DEMSimParams* simParams,
+                                                   deme::DEMDataKT* granData,
+                                                   uint64_t* sortedKeys,
+                                                   deme::bodyID_t* sortedIDs,
+                                                   double3* sphPos,
+                                                   float* sphRadius,
+                                                   deme::contactPairs_t* contactReportOffsets,
+                                                   deme::bodyID_t* idSphA,
+                                                   deme::bodyID_t* idSphB,
+                                                   deme::contact_t* dType,
+                                                   double cellSize0,
+                                                   unsigned int nLevels) {
+    deme::bodyID_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < simParams->nSpheresGM) {
+        const deme::contactPairs_t myReportOffset = contactReportOffsets[i];
+        const deme::contactPairs_t myReportOffset_end = contactReportOffsets[i + 1];
+        deme::contactPairs_t count = sphereHierGridContacts<true>(simParams, granData, i, sortedKeys, sortedIDs, sphPos,
+                                                                  sphRadius, cellSize0, nLevels, idSphA, idSphB, dType,
+                                                                  myReportOffset, myReportOffset_end);
+        // The 2 sweeps should agree, but the unfilled slots are invalidated for safety
+        for (deme::contactPairs_t k = myReportOffset + count; k < myReportOffset_end; k++) {
+            dType[k] = deme::NOT_A_CONTACT;
+        }
+    }
+}
@@ -425,3 +425,263 @@ __global__ void populateTriSphContactsEachBin(deme::DEMSimParams* simParams,
         }
     }
 }
+
+// The world-frame bounding sphere of each local-frame grid, padded by how far the facets' CD sandwiches may reach from
+// the facets (x, y, z: center, w: radius). It is made once per contact detection, so the sweeps below can rule out a
+// far-away grid with a distance check, first for a whole block of spheres and then for each sphere, before any of the
+// per-grid work.
+__global__ void computeMeshGridWorldBounds(deme::DEMSimParams* simParams,
+                                           deme::DEMDataKT* granData,
+                                           float4* meshGridWorldBounds) {
+    unsigned int g = blockIdx.x * blockDim.x + threadIdx.x;
+    if (g < simParams->nMeshGrids) {
+        const deme::MeshGridInfo info = granData->meshGridInfo[g];
+        const deme::bodyID_t meshOwner = info.owner;
+        double3 meshXYZ;
+        voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+            meshXYZ.x, meshXYZ.y, meshXYZ.z, granData->voxelID[meshOwner], granData->locX[meshOwner],
+            granData->locY[meshOwner], granData->locZ[meshOwner], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+        float3 center = info.boundCenter;
+        applyOriQToVector3<float, deme::oriQ_t>(center.x, center.y, center.z, granData->oriQw[meshOwner],
+                                                granData->oriQx[meshOwner], granData->oriQy[meshOwner],
+                                                granData->oriQz[meshOwner]);
+        meshGridWorldBounds[g] = make_float4(meshXYZ.x + center.x, meshXYZ.y + center.y, meshXYZ.z + center.z,
+                                             info.boundRadius + granData->marginSize[meshOwner] * info.miterFactor);
+    }
+}
+
+// Sweep through the local-frame grids of rigid meshes for the facets that sphereID may touch. The contact criterion is
+// the same as in the bin-based kernels above. If WRITE, the pairs are written starting at writeOffset. Returns the
+// number of pairs found.
+// The whole block calls this together (threads without a sphere pass active = false), because the grids are culled
+// per block first: the grids are taken a tile of DEME_KT_CD_NTHREADS_PER_BLOCK at a time, each thread checks one of
+// them against the bounding box of the block's spheres, and the ones that pass are compacted, in grid order, into a
+// list that the block's spheres then go through. A sphere so checks the grids near its block only, instead of all of
+// them.
+template <bool WRITE>
+inline __device__ deme::contactPairs_t sphereMeshGridContacts(deme::DEMSimParams* simParams,
+                                                              deme::DEMDataKT* granData,
+                                                              deme::bodyID_t sphereID,
+                                                              bool active,
+                                                              const float4* meshGridWorldBounds,
+                                                              float3* sandwichANode1,
+                                                              float3* sandwichANode2,
+                                                              float3* sandwichANode3,
+                                                              float3* sandwichBNode1,
+                                                              float3* sandwichBNode2,
+                                                              float3* sandwichBNode3,
+                                                              deme::bodyID_t* idSphA,
+                                                              deme::bodyID_t* idTriB,
+                                                              deme::contact_t* dType,
+                                                              deme::contactPairs_t writeOffset,
+                                                              deme::contactPairs_t writeOffset_end) {
+    __shared__ float3 blockLo[DEME_KT_CD_NTHREADS_PER_BLOCK];
+    __shared__ float3 blockHi[DEME_KT_CD_NTHREADS_PER_BLOCK];
+    __shared__ unsigned int nearGrids[DEME_KT_CD_NTHREADS_PER_BLOCK];
+    __shared__ unsigned int warpNearCnt[DEME_KT_CD_NTHREADS_PER_BLOCK / DEME_CUDA_WARP_SIZE];
+
+    deme::bodyID_t ownerID;
+    deme::family_t ownerFamily;
+    float myRadius;
+    float3 sphXYZ;
+    if (active) {
+        fillSharedMemSpheres<float, float>(simParams, granData, 0, sphereID, &ownerID, &sphereID, &ownerFamily,
+                                           &myRadius, &sphXYZ.x, &sphXYZ.y, &sphXYZ.z);
+        blockLo[threadIdx.x] = make_float3(sphXYZ.x - myRadius, sphXYZ.y - myRadius, sphXYZ.z - myRadius);
+        blockHi[threadIdx.x] = make_float3(sphXYZ.x + myRadius, sphXYZ.y + myRadius, sphXYZ.z + myRadius);
+    } else {
+        blockLo[threadIdx.x] = make_float3(DEME_HUGE_FLOAT, DEME_HUGE_FLOAT, DEME_HUGE_FLOAT);
+        blockHi[threadIdx.x] = make_float3(-DEME_HUGE_FLOAT, -DEME_HUGE_FLOAT, -DEME_HUGE_FLOAT);
+    }
+    // The bounding box of all the block's spheres
+    __syncthreads();
+    for (unsigned int stride = DEME_KT_CD_NTHREADS_PER_BLOCK / 2; stride > 0; stride /= 2) {
+        if (threadIdx.x < stride) {
+            blockLo[threadIdx.x] = fminf(blockLo[threadIdx.x], blockLo[threadIdx.x + stride]);
+            blockHi[threadIdx.x] = fmaxf(blockHi[threadIdx.x], blockHi[threadIdx.x + stride]);
+        }
+        __syncthreads();
+    }
+    const float3 boxLo = blockLo[0], boxHi = blockHi[0];
+
+    const unsigned int lane = threadIdx.x % DEME_CUDA_WARP_SIZE, warp = threadIdx.x / DEME_CUDA_WARP_SIZE;
+    deme::contactPairs_t count = 0;
+    for (unsigned int tile = 0; tile < simParams->nMeshGrids; tile += DEME_KT_CD_NTHREADS_PER_BLOCK) {
+        // Is my grid of this tile near the block's spheres?
+        const unsigned int myGrid = tile + threadIdx.x;
+        bool near = false;
+        if (myGrid < simParams->nMeshGrids) {
+            const float4 bound = meshGridWorldBounds[myGrid];
+            const float3 center = make_float3(bound.x, bound.y, bound.z);
+            const float3 dist = center - fmaxf(boxLo, fminf(center, boxHi));
+            near = dot(dist, dist) <= bound.w * bound.w;
+        }
+        // Compact the near grids, keeping their order so the counting and the writing sweeps see the same list
+        const unsigned int ballot = __ballot_sync(0xffffffff, near);
+        if (lane == 0)
+            warpNearCnt[warp] = __popc(ballot);
+        __syncthreads();
+        unsigned int myNearOffset = 0, nNear = 0;
+        for (unsigned int w = 0; w < DEME_KT_CD_NTHREADS_PER_BLOCK / DEME_CUDA_WARP_SIZE; w++) {
+            if (w < warp)
+                myNearOffset += warpNearCnt[w];
+            nNear += warpNearCnt[w];
+        }
+        if (near)
+            nearGrids[myNearOffset + __popc(ballot & ((1u << lane) - 1))] = myGrid;
+        __syncthreads();
+
+        for (unsigned int c = 0; c < nNear && active; c++) {
+            const unsigned int g = nearGrids[c];
+            // Of the grids near the block, those far from this sphere are ruled out before their info is loaded
+            {
+                const float4 bound = meshGridWorldBounds[g];
+                const float3 dist = make_float3(sphXYZ.x - bound.x, sphXYZ.y - bound.y, sphXYZ.z - bound.z);
+                const float reach = bound.w + myRadius;
+                if (dot(dist, dist) > reach * reach)
+                    continue;
+            }
+            const deme::MeshGridInfo info = granData->meshGridInfo[g];
+            const deme::bodyID_t meshOwner = info.owner;
+            if (ownerID == meshOwner)
+                continue;
+            const deme::family_t meshFamily = granData->familyID[meshOwner];
+            unsigned int maskMatID = locateMaskPair<unsigned int>(ownerFamily, meshFamily);
+            if (granData->familyMasks[maskMatID] != deme::DONT_PREVENT_CONTACT)
+                continue;
+            float artificialMargin =
+                (granData->familyExtraMarginSize[ownerFamily] < granData->familyExtraMarginSize[meshFamily])
+                    ? granData->familyExtraMarginSize[ownerFamily]
+                    : granData->familyExtraMarginSize[meshFamily];
+
+            // Bring the sphere to the mesh's frame
+            double3 meshXYZ;
+            voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+                meshXYZ.x, meshXYZ.y, meshXYZ.z, granData->voxelID[meshOwner], granData->locX[meshOwner],
+                granData->locY[meshOwner], granData->locZ[meshOwner], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+            float3 localXYZ = make_float3(sphXYZ.x - meshXYZ.x, sphXYZ.y - meshXYZ.y, sphXYZ.z - meshXYZ.z);
+            applyOriQToVector3<float, deme::oriQ_t>(localXYZ.x, localXYZ.y, localXYZ.z, granData->oriQw[meshOwner],
+                                                    -granData->oriQx[meshOwner], -granData->oriQy[meshOwner],
+                                                    -granData->oriQz[meshOwner]);
+            // The facets' sandwiches are at most this far away from the facets
+            const float pad = myRadius + granData->marginSize[meshOwner] * info.miterFactor;
+
+            // Cell range that the sphere touches
+            int slo[3], shi[3];
+            {
+                const float p[3] = {localXYZ.x, localXYZ.y, localXYZ.z};
+                const float o[3] = {info.origin.x, info.origin.y, info.origin.z};
+                const int n[3] = {info.dims.x, info.dims.y, info.dims.z};
+                bool outside = false;
+                for (int d = 0; d < 3; d++) {
+                    float lo = (p[d] - pad - o[d]) / info.cellSize;
+                    float hi = (p[d] + pad - o[d]) / info.cellSize;
+                    if (hi < 0.f || lo > (float)n[d]) {
+                        outside = true;
+                        break;
+                    }
+                    slo[d] = (lo > 0.f) ? ((lo >= (float)(n[d] - 1)) ? n[d] - 1 : (int)lo) : 0;
+                    shi[d] = (hi > 0.f) ? ((hi >= (float)(n[d] - 1)) ? n[d] - 1 : (int)hi) : 0;
+                }
+                if (outside)
+                    continue;
+            }
+
+            for (int k = slo[2]; k <= shi[2]; k++) {
+                for (int j = slo[1]; j <= shi[1]; j++) {
+                    for (int i = slo[0]; i <= shi[0]; i++) {
+                        const size_t cell =
+                            info.cellOffset + (size_t)i + (size_t)info.dims.x * ((size_t)j + (size_t)info.dims.y * k);
+                        for (size_t e = granData->meshGridCellStart[cell]; e < granData->meshGridCellStart[cell + 1];
+                             e++) {
+                            const deme::bodyID_t triID = granData->meshGridCellTris[e];
+                            // Only report from the lowest cell that both the sphere and the facet touch
+                            const int3 tlo = granData->triGridCellLo[triID];
+                            if (i != DEME_MAX(tlo.x, slo[0]) || j != DEME_MAX(tlo.y, slo[1]) ||
+                                k != DEME_MAX(tlo.z, slo[2]))
+                                continue;
+
+                            deme::bodyID_t triOwnerID, triIDCopy;
+                            deme::family_t triOwnerFamily;
+                            float3 triANode1, triANode2, triANode3, triBNode1, triBNode2, triBNode3;
+                            fillSharedMemTriangles(simParams, granData, 0, triID, &triOwnerID, &triIDCopy,
+                                                   &triOwnerFamily, sandwichANode1, sandwichANode2, sandwichANode3,
+                                                   sandwichBNode1, sandwichBNode2, sandwichBNode3, &triANode1,
+                                                   &triANode2, &triANode3, &triBNode1, &triBNode2, &triBNode3);
+                            float3 cntPnt, normal;
+                            float depth;
+                            bool in_contact_A = triangle_sphere_CD_directional<float3, float>(
+                                triANode1, triANode2, triANode3, sphXYZ, myRadius, normal, depth, cntPnt);
+                            in_contact_A = in_contact_A && (-depth > artificialMargin);
+                            bool in_contact_B = triangle_sphere_CD_directional<float3, float>(
+                                triBNode1, triBNode2, triBNode3, sphXYZ, myRadius, normal, depth, cntPnt);
+                            in_contact_B = in_contact_B && (-depth > artificialMargin);
+                            if (in_contact_A || in_contact_B) {
+                                if (WRITE) {
+                                    if (writeOffset + count < writeOffset_end) {
+                                        idSphA[writeOffset + count] = sphereID;
+                                        idTriB[writeOffset + count] = triID;
+                                        dType[writeOffset + count] = deme::SPHERE_MESH_CONTACT;
+                                    }
+                                }
+                                count++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return count;
+}
+
+__global__ void getNumberOfSphMeshGridContacts(deme::DEMSimParams* simParams,
+                                               deme::DEMDataKT* granData,
+                                               const float4* meshGridWorldBounds,
+                                               deme::binContactPairs_t* numSphMeshGridContacts,
+                                               float3* sandwichANode1,
+                                               float3* sandwichANode2,
+                                               float3* sandwichANode3,
+                                               float3* sandwichBNode1,
+                                               float3* sandwichBNode2,
+                                               float3* sandwichBNode3) {
+    deme::bodyID_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    // Every thread of the block takes part in the grid culling, so none returns early
+    const bool active = sphereID < simParams->nSpheresGM;
+    deme::contactPairs_t count = sphereMeshGridContacts<false>(
+        simParams, granData, sphereID, active, meshGridWorldBounds, sandwichANode1, sandwichANode2, sandwichANode3,
+        sandwichBNode1, sandwichBNode2, sandwichBNode3, nullptr, nullptr, nullptr, 0, 0);
+    if (active) {
+        numSphMeshGridContacts[sphereID] = count;
+    }
+}
+
+__global__ void populateSphMeshGridContacts(deme::DEMSimParams* simParams,
+                                            deme::DEMDataKT* granData,
+                                            const float4* meshGridWorldBounds,
+                                            deme::contactPairs_t* sphMeshGridReportOffsets,
+                                            deme::bodyID_t* idSphA,
+                                            deme::bodyID_t* idTriB,
+                                            deme::contact_t* dType,
+                                            float3* sandwichANode1,
+                                            float3* sandwichANode2,
+                                            float3* sandwichANode3,
+                                            float3* sandwichBNode1,
+                                            float3* sandwichBNode2,
+                                            float3* sandwichBNode3) {
+    deme::bodyID_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    // Every thread of the block takes part in the grid culling, so none returns early
+    const bool active = sphereID < simParams->nSpheresGM;
+    deme::contactPairs_t myReportOffset = 0, myReportOffset_end = 0;
+    if (active) {
+        myReportOffset = sphMeshGridReportOffsets[sphereID];
+        myReportOffset_end = sphMeshGridReportOffsets[sphereID + 1];
+    }
+    deme::contactPairs_t count = sphereMeshGridContacts<true>(
+        simParams, granData, sphereID, active, meshGridWorldBounds, sandwichANode1, sandwichANode2, sandwichANode3,
+        sandwichBNode1, sandwichBNode2, sandwichBNode3, idSphA, idTriB, dType, myReportOffset, myReportOffset_end);
+    // Like in the bin-based kernels, the 2 sweeps should agree, but the unfilled slots are invalidated for safety
+    for (deme::contactPairs_t i = myReportOffset + count; i < myReportOffset_end; i++) {
+        dType[i] = deme::NOT_A_CONTACT;
+    }
+}
@@ -0,0 +1,267 @@
+// DEM kernels used for evaluating the distribution of a quantity (see DEM/utils/DistributionInspectors.hpp)
+#include <DEM/Defines.h>
+#include <DEMHelperKernels.cuh>
+_kernelIncludes_;
+
+// If clump templates are jitified, they will be below
+_clumpTemplateDefs_;
+
+// Mass properties are below, if jitified mass properties are in use
+_massDefs_;
+_moiDefs_;
+_volumeDefs_;
+
+// The group of an entity not counted in any group (DIST_NULL_GROUP)
+#define DEME_DIST_NULL_GROUP 0xFFFFFFFFu
+
+// A float as an unsigned int of the same order (DistributionOrderedKey)
+__device__ __forceinline__ unsigned int distOrderedKey(float val) {
+    unsigned int bits = __float_as_uint(val);
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+__device__ __forceinline__ float distKeyToFloat(unsigned int key) {
+    return __uint_as_float((key & 0x80000000u) ? (key & 0x7FFFFFFFu) : ~key);
+}
+
+// The slot of val in a histogram row (DistributionHistSlot)
+__device__ __forceinline__ unsigned int distHistSlot(float val, const float* edges, unsigned int nBins) {
+    if (val < edges[0])
+        return nBins;
+    if (!(val < edges[nBins]))
+        return nBins + 1;
+    unsigned int lo = 0, hi = nBins;
+    while (hi - lo > 1) {
+        const unsigned int mid = (lo + hi) / 2;
+        if (edges[mid] <= val) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Each sphere's value and group
+__global__ void inspectSphereDistribution(deme::DEMDataDT* granData,
+                                          deme::DEMSimParams* simParams,
+                                          float* values,
+                                          unsigned int* groups,
+                                          size_t nSpheres) {
+    size_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (sphereID < nSpheres) {
+        deme::bodyID_t myOwner = granData->ownerClumpBody[sphereID];
+        float3 myRelPos;
+        float myRadius;
+        float oriQw, oriQx, oriQy, oriQz;
+        double ownerX, ownerY, ownerZ;
+        // Get my component offset info from either jitified arrays or global memory
+        // Outputs myRelPos, myRadius
+        // Use an input named exactly `sphereID' which is the id of this sphere component
+        { _componentAcqStrat_; }
+
+        voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+            ownerX, ownerY, ownerZ, granData->voxelID[myOwner], granData->locX[myOwner], granData->locY[myOwner],
+            granData->locZ[myOwner], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+        oriQw = granData->oriQw[myOwner];
+        oriQx = granData->oriQx[myOwner];
+        oriQy = granData->oriQy[myOwner];
+        oriQz = granData->oriQz[myOwner];
+        applyOriQToVector3<float, deme::oriQ_t>(myRelPos.x, myRelPos.y, myRelPos.z, oriQw, oriQx, oriQy, oriQz);
+
+        float X = ownerX + myRelPos.x + simParams->LBFX;
+        float Y = ownerY + myRelPos.y + simParams->LBFY;
+        float Z = ownerZ + myRelPos.z + simParams->LBFZ;
+
+        float distValue = 0.f;
+        unsigned int distGroup = DEME_DIST_NULL_GROUP;
+        bool isInRegion = true;
+        { _distributionRegion_; }
+        if (isInRegion) {
+            { _distributionQuantity_; }
+            { _distributionGroup_; }
+        }
+        values[sphereID] = distValue;
+        groups[sphereID] = distGroup;
+    }
+}
+
+// Each owner's value and group; ownerContactCounts is the number of force-bearing contacts of each owner, if the
+// quantity needs it
+__global__ void inspectOwnerDistribution(deme::DEMDataDT* granData,
+                                         deme::DEMSimParams* simParams,
+                                         float* values,
+                                         unsigned int* groups,
+                                         const unsigned int* ownerContactCounts,
+                                         size_t nOwnerBodies,
+                                         deme::ownerType_t owner_type) {
+    deme::bodyID_t myOwner = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myOwner < nOwnerBodies) {
+        float distValue = 0.f;
+        unsigned int distGroup = DEME_DIST_NULL_GROUP;
+        deme::ownerType_t myType = granData->ownerTypes[myOwner];
+        if (myType & owner_type) {
+            float oriQw, oriQx, oriQy, oriQz;
+            double ownerX, ownerY, ownerZ;
+            float myMass;
+            float3 myMOI;
+            // Get my mass info from either jitified arrays or global memory
+            // Outputs myMass
+            // Use an input named exactly `myOwner' which is the id of this owner
+            { _massAcqStrat_; }
+
+            // Get my mass info from either jitified arrays or global memory
+            // Outputs myMOI
+            // Use an input named exactly `myOwner' which is the id of this owner
+            { _moiAcqStrat_; }
+
+            voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+                ownerX, ownerY, ownerZ, granData->voxelID[myOwner], granData->locX[myOwner], granData->locY[myOwner],
+                granData->locZ[myOwner], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+            oriQw = granData->oriQw[myOwner];
+            oriQx = granData->oriQx[myOwner];
+            oriQy = granData->oriQy[myOwner];
+            oriQz = granData->oriQz[myOwner];
+
+            float X = ownerX + simParams->LBFX;
+            float Y = ownerY + simParams->LBFY;
+            float Z = ownerZ + simParams->LBFZ;
+
+            bool isInRegion = true;
+            { _distributionRegion_; }
+            if (isInRegion) {
+                { _distributionQuantity_; }
+                { _distributionGroup_; }
+            }
+        }
+        values[myOwner] = distValue;
+        groups[myOwner] = distGroup;
+    }
+}
+
+// Each force-bearing contact's value and group. The position (X, Y, Z) of a contact is its contact point, and its
+// owner (for the family) is that of its geometry A, which is always a sphere.
+__global__ void inspectContactDistribution(deme::DEMDataDT* granData,
+                                           deme::DEMSimParams* simParams,
+                                           float* values,
+                                           unsigned int* groups,
+                                           size_t nContactPairs) {
+    size_t myContactID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myContactID < nContactPairs) {
+        float distValue = 0.f;
+        unsigned int distGroup = DEME_DIST_NULL_GROUP;
+        const deme::contact_t myContactType = granData->contactType[myContactID];
+        const float3 myForce = granData->contactForces[myContactID];
+        // Pairs that are only in the contact margin have no force, and are not counted
+        if (myContactType != deme::NOT_A_CONTACT && length(myForce) > DEME_TINY_FLOAT) {
+            deme::bodyID_t sphereID = granData->idGeometryA[myContactID];
+            deme::bodyID_t myOwner = granData->ownerClumpBody[sphereID];
+            float3 myRelPos;
+            float myRadius;
+            // Outputs myRelPos, myRadius (in the owner's frame)
+            { _componentAcqStrat_; }
+
+            // The contact point, in A's owner's frame relative to its CoM, is in the middle of the overlap, as contact
+            // detection places it; so the overlap is twice how much it is inside sphere A
+            float3 myCntPnt = granData->contactPointGeometryA[myContactID];
+            float3 myNormal = myCntPnt - myRelPos;
+            const float myOverlap = 2.f * (myRadius - length(myNormal));
+
+            float oriQw = granData->oriQw[myOwner];
+            float oriQx = granData->oriQx[myOwner];
+            float oriQy = granData->oriQy[myOwner];
+            float oriQz = granData->oriQz[myOwner];
+            applyOriQToVector3<float, deme::oriQ_t>(myCntPnt.x, myCntPnt.y, myCntPnt.z, oriQw, oriQx, oriQy, oriQz);
+            applyOriQToVector3<float, deme::oriQ_t>(myNormal.x, myNormal.y, myNormal.z, oriQw, oriQx, oriQy, oriQz);
+            // From the center of sphere A to the contact point, in the global frame
+            myNormal = normalize(myNormal);
+
+            double ownerX, ownerY, ownerZ;
+            voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+                ownerX, ownerY, ownerZ, granData->voxelID[myOwner], granData->locX[myOwner], granData->locY[myOwner],
+                granData->locZ[myOwner], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+            float X = ownerX + myCntPnt.x + simParams->LBFX;
+            float Y = ownerY + myCntPnt.y + simParams->LBFY;
+            float Z = ownerZ + myCntPnt.z + simParams->LBFZ;
+
+            bool isInRegion = true;
+            { _distributionRegion_; }
+            if (isInRegion) {
+                { _distributionQuantity_; }
+                { _distributionGroup_; }
+            }
+        }
+        values[myContactID] = distValue;
+        groups[myContactID] = distGroup;
+    }
+}
+
+// The number of force-bearing contacts of each owner, added to counts (which start at 0)
+__global__ void countOwnerContacts(deme::DEMDataDT* granData, unsigned int* counts, size_t nContactPairs) {
+    size_t myContactID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myContactID < nContactPairs) {
+        const deme::contact_t myContactType = granData->contactType[myContactID];
+        if (myContactType != deme::NOT_A_CONTACT && length(granData->contactForces[myContactID]) > DEME_TINY_FLOAT) {
+            deme::bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[myContactID]];
+            deme::bodyID_t ownerB = DEME_GET_GEO_OWNER_ID(granData->idGeometryB[myContactID], myContactType);
+            atomicAdd(counts + ownerA, 1u);
+            atomicAdd(counts + ownerB, 1u);
+        }
+    }
+}
+
+// Accumulate the count, sum, extremes and histogram of each of nGroups groups (their arrays are zeroed, except minKeys,
+// which are all 1 bits); a histogram row has nBins bins, then under- and overflow
+__global__ void accumulateDistribution(const float* values,
+                                       const unsigned int* groups,
+                                       size_t n,
+                                       unsigned int nGroups,
+                                       const float* binEdges,
+                                       unsigned int nBins,
+                                       unsigned long long* counts,
+                                       double* sums,
+                                       unsigned int* minKeys,
+                                       unsigned int* maxKeys,
+                                       unsigned long long* hist) {
+    size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) {
+        const unsigned int g = groups[i];
+        const float val = values[i];
+        if (g < nGroups && !isnan(val)) {
+            const unsigned int key = distOrderedKey(val);
+            atomicAdd(counts + g, 1ull);
+            atomicAdd(sums + g, (double)val);
+            atomicMin(minKeys + g, key);
+            atomicMax(maxKeys + g, key);
+            if (nBins > 0) {
+                atomicAdd(hist + (size_t)g * (nBins + 2) + distHistSlot(val, binEdges, nBins), 1ull);
+            }
+        }
+    }
+}
+
+// The sort key of each entry: its group then its value, or all 1 bits (sorted last) if it is not counted
+__global__ void makeDistributionSortKeys(const float* values,
+                                         const unsigned int* groups,
+                                         size_t n,
+                                         unsigned int nGroups,
+                                         unsigned long long* keys) {
+    size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < n) {
+        const unsigned int g = groups[i];
+        const float val = values[i];
+        keys[i] = (g < nGroups && !isnan(val)) ? (((unsigned long long)g << 32) | distOrderedKey(val))
+                                               : 0xFFFFFFFFFFFFFFFFull;
+    }
+}
+
+// The values at the given positions of the sorted keys
+__global__ void gatherDistributionQuantiles(const unsigned long long* sortedKeys,
+                                            const size_t* positions,
+                                            size_t nPositions,
+                                            float* out) {
+    size_t i = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < nPositions) {
+        out[i] = distKeyToFloat((unsigned int)(sortedKeys[positions[i]] & 0xFFFFFFFFull));
+    }
+}
@@ -0,0 +1,44 @@
+// DEM contact force probe helpers, shared by the device reduction (reduceContactForceProbes) and host checks
+
+#ifndef DEME_FORCE_PROBE_HELPERS_CUH
+#define DEME_FORCE_PROBE_HELPERS_CUH
+
+#include <DEM/Defines.h>
+
+namespace deme {
+
+// Which side of a contact a probe takes the force of: the side whose owner is in the probe. A contact between two
+// members of the probe is internal, and its two sides would cancel in the probe's totals, so it is left out.
+enum FORCE_PROBE_SIDE : unsigned int { FORCE_PROBE_NO_SIDE = 0, FORCE_PROBE_SIDE_A = 1, FORCE_PROBE_SIDE_B = 2 };
+
+inline __host__ __device__ unsigned int forceProbeSide(unsigned int maskA, unsigned int maskB, unsigned int bit) {
+    const bool inA = maskA & bit, inB = maskB & bit;
+    if (inA == inB)
+        return FORCE_PROBE_NO_SIDE;
+    return inA ? FORCE_PROBE_SIDE_A : FORCE_PROBE_SIDE_B;
+}
+
+// What one contact side (point, force and torque, all global) adds to the FORCE_PROBE_NUM_AGGREGATES aggregates of a
+// probe whose moments are about ref
+inline __host__ __device__ void forceProbeContribution(float* contrib,
+                                                       const float3& pnt,
+                                                       const float3& f,
+                                                       const float3& t,
+                                                       const float3& ref) {
+    const float3 moment = cross(pnt - ref, f) + t;
+    const float w = length(f);
+    contrib[0] = f.x;
+    contrib[1] = f.y;
+    contrib[2] = f.z;
+    contrib[3] = moment.x;
+    contrib[4] = moment.y;
+    contrib[5] = moment.z;
+    contrib[6] = w * pnt.x;
+    contrib[7] = w * pnt.y;
+    contrib[8] = w * pnt.z;
+    contrib[9] = w;
+}
+
+}  // namespace deme
+
+#endif
@@ -611,4 +611,59 @@ __inline__ __device__ void boundingBoxIntersectBin(deme::binID_t* L,
     U[2] = max_bin.z;
 }
 
+// Owner of geometry B of a contact of a type
+inline __device__ deme::bodyID_t contactOwnerB(deme::DEMDataDT* granData, deme::contact_t type, deme::bodyID_t geoB) {
+    return (type == deme::SPHERE_SPHERE_CONTACT) ? granData->ownerClumpBody[geoB]
+           : (type == deme::SPHERE_MESH_CONTACT) ? granData->ownerMesh[geoB]
+                                                 : granData->ownerAnalBody[geoB];
+}
+
+// Whether a contact is frozen by island sleeping: both owners are asleep (or static), and they are not both static
+inline __device__ bool contactIsAsleep(deme::DEMDataDT* granData, size_t myContactID) {
+    const deme::contact_t type = granData->contactType[myContactID];
+    if (type == deme::NOT_A_CONTACT) {
+        return false;
+    }
+    const deme::bodyID_t geoB = granData->idGeometryB[myContactID];
+    const deme::bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[myContactID]];
+    const deme::bodyID_t ownerB = (type == deme::SPHERE_SPHERE_CONTACT) ? granData->ownerClumpBody[geoB]
+                                  : (type == deme::SPHERE_MESH_CONTACT) ? granData->ownerMesh[geoB]
+                                                                        : granData->ownerAnalBody[geoB];
+    const deme::bodyID_t islandA = granData->ownerSleepIsland[ownerA];
+    const deme::bodyID_t islandB = granData->ownerSleepIsland[ownerB];
+    return islandA != deme::NULL_BODYID && islandB != deme::NULL_BODYID &&
+           !(islandA == deme::STATIC_SLEEP_ISLAND && islandB == deme::STATIC_SLEEP_ISLAND);
+}
+
+// Contact type masks (a bit per contact type) of the specialized force kernels. These are evaluated at compile time.
+inline __host__ __device__ constexpr bool contactTypeInMask(unsigned int mask, deme::contact_t type) {
+    return (mask >> type) & 1u;
+}
+inline __host__ __device__ constexpr bool contactTypeMaskIsSingle(unsigned int mask) {
+    return mask != 0 && (mask & (mask - 1)) == 0;
+}
+inline __host__ __device__ constexpr deme::contact_t lowestContactTypeInMask(unsigned int mask,
+                                                                             deme::contact_t type = 0) {
+    return (type >= 31 || ((mask >> type) & 1u)) ? type : lowestContactTypeInMask(mask, type + 1);
+}
+inline __host__ __device__ constexpr bool analyticalContactInMask(unsigned int mask) {
+    return (mask >> (deme::SPHERE_ANALYTICAL_CONTACT + 1)) != 0;
+}
+
+// Conversions of the half-precision and quantized fields of packed contact wildcard pools. The host versions are in
+// WildcardPools.hpp and round the same way.
+inline __device__ float wildcardHalfToFloat(unsigned short h) {
+    float f;
+    asm("cvt.f32.f16 %0, %1;" : "=f"(f) : "h"(h));
+    return f;
+}
+inline __device__ unsigned short wildcardFloatToHalf(float f) {
+    unsigned short h;
+    asm("cvt.rn.f16.f32 %0, %1;" : "=h"(h) : "f"(f));
+    return h;
+}
+inline __device__ short wildcardQuantize(float val, float scale) {
+    return (short)fminf(fmaxf(rintf(val / scale), -32767.f), 32767.f);
+}
+
 #endif
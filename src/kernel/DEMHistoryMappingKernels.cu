@@ -7,7 +7,7 @@ __global__ void fillRunLengthArray(deme::geoSphereTouches_t* runlength_full,
                                    deme::bodyID_t* unique_ids,
                                    deme::geoSphereTouches_t* runlength,
                                    size_t numUnique) {
-    deme::bodyID_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::bodyID_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < numUnique) {
         deme::bodyID_t i = unique_ids[myID];
         runlength_full[i] = runlength[myID];
@@ -21,7 +21,7 @@ __global__ void buildPersistentMap(deme::geoSphereTouches_t* new_idA_runlength_f
                                    deme::contactPairs_t* mapping,
                                    deme::DEMDataKT* granData,
                                    size_t nSpheresSafe) {
-    deme::bodyID_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::bodyID_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < nSpheresSafe) {
         deme::geoSphereTouches_t new_cnt_count = new_idA_runlength_full[myID];
         deme::geoSphereTouches_t old_cnt_count = old_idA_runlength_full[myID];
@@ -61,7 +61,7 @@ __global__ void buildPersistentMap(deme::geoSphereTouches_t* new_idA_runlength_f
 }
 
 __global__ void lineNumbers(deme::contactPairs_t* arr, size_t n) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         arr[myID] = myID;
     }
@@ -70,7 +70,7 @@ __global__ void lineNumbers(deme::contactPairs_t* arr, size_t n) {
 __global__ void convertToAndFrom(deme::contactPairs_t* old_arr_unsort_to_sort_map,
                                  deme::contactPairs_t* converted_map,
                                  size_t n) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         deme::contactPairs_t map_from = old_arr_unsort_to_sort_map[myID];
         converted_map[map_from] = myID;
@@ -80,7 +80,7 @@ __global__ void convertToAndFrom(deme::contactPairs_t* old_arr_unsort_to_sort_ma
 __global__ void rearrangeMapping(deme::contactPairs_t* map_sorted,
                                  deme::contactPairs_t* old_arr_unsort_to_sort_map,
                                  size_t n) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         deme::contactPairs_t map_to = map_sorted[myID];
         if (map_to != deme::NULL_MAPPING_PARTNER)
@@ -92,7 +92,7 @@ __global__ void markBoolIf(deme::notStupidBool_t* bool_arr,
                            deme::notStupidBool_t* value_arr,
                            deme::notStupidBool_t val,
                            size_t n) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         deme::notStupidBool_t my_val = value_arr[myID];
         if (my_val == val) {
@@ -104,7 +104,7 @@ __global__ void markBoolIf(deme::notStupidBool_t* bool_arr,
 }
 
 __global__ void setArr(deme::notStupidBool_t* arr, size_t n, deme::notStupidBool_t val) {
-    deme::contactPairs_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::contactPairs_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         arr[myID] = val;
     }
@@ -117,7 +117,7 @@ __global__ void markDuplicateContacts(deme::geoSphereTouches_t* idA_runlength,
                                       deme::notStupidBool_t* persistency,
                                       deme::notStupidBool_t* retain_list,
                                       size_t n) {
-    deme::bodyID_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::bodyID_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         deme::geoSphereTouches_t cnt_count = idA_runlength[myID];
         // If this idA has non-zero runlength in new: a potential removal needed
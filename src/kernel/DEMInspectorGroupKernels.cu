@@ -0,0 +1,151 @@
+// DEM kernels used for evaluating a group of inspected quantities in one pass (see DEM/utils/InspectorGroups.hpp)
+#include <DEM/Defines.h>
+#include <DEMHelperKernels.cuh>
+_kernelIncludes_;
+
+// If clump templates are jitified, they will be below
+_clumpTemplateDefs_;
+
+// Mass properties are below, if jitified mass properties are in use
+_massDefs_;
+_moiDefs_;
+_volumeDefs_;
+
+#define DEME_N_GROUP_QUANTITIES _nGroupQuantities_
+
+// Combine the values b into a, member by member
+__device__ __forceinline__ void combineGroupVals(float* a, const float* b) {
+    _groupCombine_;
+}
+
+// Reduce the values of all threads in this block into out (by thread 0)
+__device__ __forceinline__ void blockReduceGroupVals(float* vals, float* out) {
+    __shared__ float warpVals[DEME_N_GROUP_QUANTITIES][32];
+    const unsigned int lane = threadIdx.x % 32, warp = threadIdx.x / 32;
+    const unsigned int nWarps = (blockDim.x + 31) / 32;
+    float other[DEME_N_GROUP_QUANTITIES];
+    for (unsigned int offset = 16; offset > 0; offset /= 2) {
+        for (unsigned int k = 0; k < DEME_N_GROUP_QUANTITIES; k++) {
+            other[k] = __shfl_down_sync(0xffffffff, vals[k], offset);
+        }
+        // Threads past the last entity hold the identities, so they can be combined as well
+        combineGroupVals(vals, other);
+    }
+    if (lane == 0) {
+        for (unsigned int k = 0; k < DEME_N_GROUP_QUANTITIES; k++) {
+            warpVals[k][warp] = vals[k];
+        }
+    }
+    __syncthreads();
+    if (warp == 0) {
+        float groupVals[DEME_N_GROUP_QUANTITIES] = {_groupIdentities_};
+        if (lane < nWarps) {
+            for (unsigned int k = 0; k < DEME_N_GROUP_QUANTITIES; k++) {
+                groupVals[k] = warpVals[k][lane];
+            }
+        }
+        for (unsigned int offset = 16; offset > 0; offset /= 2) {
+            for (unsigned int k = 0; k < DEME_N_GROUP_QUANTITIES; k++) {
+                other[k] = __shfl_down_sync(0xffffffff, groupVals[k], offset);
+            }
+            combineGroupVals(groupVals, other);
+        }
+        if (lane == 0) {
+            for (unsigned int k = 0; k < DEME_N_GROUP_QUANTITIES; k++) {
+                out[k] = groupVals[k];
+            }
+        }
+    }
+}
+
+// Each block writes a row of partial results (one per quantity of the group, the owner ones left as identities) to
+// partials. The block size must be a multiple of 32.
+__global__ void inspectSpherePropertiesFused(deme::DEMDataDT* granData,
+                                             deme::DEMSimParams* simParams,
+                                             float* partials,
+                                             size_t nSpheres) {
+    size_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    float groupVals[DEME_N_GROUP_QUANTITIES] = {_groupIdentities_};
+    if (sphereID < nSpheres) {
+        deme::bodyID_t myOwner = granData->ownerClumpBody[sphereID];
+        float3 myRelPos;
+        float myRadius;
+        float oriQw, oriQx, oriQy, oriQz;
+        double ownerX, ownerY, ownerZ;
+        // Get my component offset info from either jitified arrays or global memory
+        // Outputs myRelPos, myRadius
+        // Use an input named exactly `sphereID' which is the id of this sphere component
+        { _componentAcqStrat_; }
+
+        voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+            ownerX, ownerY, ownerZ, granData->voxelID[myOwner], granData->locX[myOwner], granData->locY[myOwner],
+            granData->locZ[myOwner], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+        oriQw = granData->oriQw[myOwner];
+        oriQx = granData->oriQx[myOwner];
+        oriQy = granData->oriQy[myOwner];
+        oriQz = granData->oriQz[myOwner];
+        applyOriQToVector3<float, deme::oriQ_t>(myRelPos.x, myRelPos.y, myRelPos.z, oriQw, oriQx, oriQy, oriQz);
+
+        float X = ownerX + myRelPos.x + simParams->LBFX;
+        float Y = ownerY + myRelPos.y + simParams->LBFY;
+        float Z = ownerZ + myRelPos.z + simParams->LBFZ;
+
+        // All quantities of the group, each within its own region
+        { _sphereGroupQuantities_; }
+    }
+    blockReduceGroupVals(groupVals, partials + (size_t)blockIdx.x * DEME_N_GROUP_QUANTITIES);
+}
+
+// The same as above, for the owner quantities of the group
+__global__ void inspectOwnerPropertiesFused(deme::DEMDataDT* granData,
+                                            deme::DEMSimParams* simParams,
+                                            float* partials,
+                                            size_t nOwnerBodies) {
+    deme::bodyID_t myOwner = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    float groupVals[DEME_N_GROUP_QUANTITIES] = {_groupIdentities_};
+    if (myOwner < nOwnerBodies) {
+        deme::ownerType_t myType = granData->ownerTypes[myOwner];
+        float oriQw, oriQx, oriQy, oriQz;
+        double ownerX, ownerY, ownerZ;
+        float myMass;
+        float3 myMOI;
+        // Get my mass info from either jitified arrays or global memory
+        // Outputs myMass
+        // Use an input named exactly `myOwner' which is the id of this owner
+        { _massAcqStrat_; }
+
+        // Get my mass info from either jitified arrays or global memory
+        // Outputs myMOI
+        // Use an input named exactly `myOwner' which is the id of this owner
+        { _moiAcqStrat_; }
+
+        voxelIDToPosition<double, deme::voxelID_t, deme::subVoxelPos_t>(
+            ownerX, ownerY, ownerZ, granData->voxelID[myOwner], granData->locX[myOwner], granData->locY[myOwner],
+            granData->locZ[myOwner], _nvXp2_, _nvYp2_, _voxelSize_, _l_);
+        oriQw = granData->oriQw[myOwner];
+        oriQx = granData->oriQx[myOwner];
+        oriQy = granData->oriQy[myOwner];
+        oriQz = granData->oriQz[myOwner];
+
+        float X = ownerX + simParams->LBFX;
+        float Y = ownerY + simParams->LBFY;
+        float Z = ownerZ + simParams->LBFZ;
+
+        // All quantities of the group, each within its own region and for its own owner types
+        { _ownerGroupQuantities_; }
+    }
+    blockReduceGroupVals(groupVals, partials + (size_t)blockIdx.x * DEME_N_GROUP_QUANTITIES);
+}
+
+// Reduce the rows of partial results of nRows blocks into res. Run by one block.
+__global__ void reduceInspectorGroupPartials(const float* partials, size_t nRows, float* res) {
+    float groupVals[DEME_N_GROUP_QUANTITIES] = {_groupIdentities_};
+    float row[DEME_N_GROUP_QUANTITIES];
+    for (size_t i = threadIdx.x; i < nRows; i += blockDim.x) {
+        for (unsigned int k = 0; k < DEME_N_GROUP_QUANTITIES; k++) {
+            row[k] = partials[i * DEME_N_GROUP_QUANTITIES + k];
+        }
+        combineGroupVals(groupVals, row);
+    }
+    blockReduceGroupVals(groupVals, res);
+}
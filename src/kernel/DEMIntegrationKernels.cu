@@ -254,11 +254,46 @@ inline __device__ void integrateVelPos(deme::bodyID_t ownerID,
 // }
 
 __global__ void integrateOwners(deme::DEMSimParams* simParams, deme::DEMDataDT* granData) {
-    deme::bodyID_t ownerID = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::bodyID_t ownerID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (ownerID < simParams->nOwnerBodies) {
+        // Sleeping (and static) owners do not move
+        if (simParams->useSleeping && granData->ownerSleepIsland[ownerID] != deme::NULL_BODYID) {
+            return;
+        }
         // These 2 quantities mean the velocity and ang vel used for updating position/quaternion for this step.
         // Depending on the integration scheme in use, they can be different.
         float3 v, omgBar;
         integrateVelPos(ownerID, simParams, granData, v, omgBar, simParams->h, simParams->timeElapsed);
     }
 }
+
+// Multi-rate integration: the acceleration that the slow contacts bring about is kept, and applied as an impulse in the
+// first sub-step of a time step (N times, N being the number of sub-steps)
+__global__ void stashSlowAcc(deme::DEMSimParams* simParams, deme::DEMDataDT* granData, float* slowAcc) {
+    deme::bodyID_t ownerID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    const size_t n = simParams->nOwnerBodies;
+    if (ownerID < n) {
+        slowAcc[ownerID] = granData->aX[ownerID];
+        slowAcc[n + ownerID] = granData->aY[ownerID];
+        slowAcc[2 * n + ownerID] = granData->aZ[ownerID];
+        slowAcc[3 * n + ownerID] = granData->alphaX[ownerID];
+        slowAcc[4 * n + ownerID] = granData->alphaY[ownerID];
+        slowAcc[5 * n + ownerID] = granData->alphaZ[ownerID];
+    }
+}
+
+__global__ void addSlowAcc(deme::DEMSimParams* simParams,
+                           deme::DEMDataDT* granData,
+                           const float* slowAcc,
+                           float factor) {
+    deme::bodyID_t ownerID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    const size_t n = simParams->nOwnerBodies;
+    if (ownerID < n) {
+        granData->aX[ownerID] += factor * slowAcc[ownerID];
+        granData->aY[ownerID] += factor * slowAcc[n + ownerID];
+        granData->aZ[ownerID] += factor * slowAcc[2 * n + ownerID];
+        granData->alphaX[ownerID] += factor * slowAcc[3 * n + ownerID];
+        granData->alphaY[ownerID] += factor * slowAcc[4 * n + ownerID];
+        granData->alphaZ[ownerID] += factor * slowAcc[5 * n + ownerID];
+    }
+}
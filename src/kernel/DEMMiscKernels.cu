@@ -7,7 +7,7 @@ __global__ void markOwnerToChange(deme::notStupidBool_t* idBool,
                                   deme::bodyID_t* dIDs,
                                   float* dFactors,
                                   size_t n) {
-    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < n) {
         deme::bodyID_t myOwner = dIDs[myID];
         float myFactor = dFactors[myID];
@@ -18,7 +18,7 @@ __global__ void markOwnerToChange(deme::notStupidBool_t* idBool,
 
 template <typename DEMData>
 __global__ void modifyComponents(DEMData* granData, deme::notStupidBool_t* idBool, float* factors, size_t n) {
-    size_t sphereID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (sphereID < n) {
         // Get my owner ID
         deme::bodyID_t myOwner = granData->ownerClumpBody[sphereID];
@@ -39,7 +39,7 @@ __global__ void computeMarginFromAbsv(deme::DEMSimParams* simParams,
                                       float* ts,
                                       unsigned int* maxDrift,
                                       size_t n) {
-    size_t ownerID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t ownerID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (ownerID < n) {
         float absv = granData->marginSize[ownerID];
         unsigned int my_family = granData->familyID[ownerID];
@@ -60,8 +60,17 @@ __global__ void computeMarginFromAbsv(deme::DEMSimParams* simParams,
     }
 }
 
+// Displacement-triggered CD: every owner gets the same skin, since dT orders a CD before any owner moves by more
+__global__ void fillMarginFromSkin(deme::DEMSimParams* simParams, deme::DEMDataKT* granData, float* skin, size_t n) {
+    size_t ownerID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (ownerID < n) {
+        unsigned int my_family = granData->familyID[ownerID];
+        granData->marginSize[ownerID] = (*skin) + granData->familyExtraMarginSize[my_family];
+    }
+}
+
 __global__ void fillMarginValues(deme::DEMSimParams* simParams, deme::DEMDataKT* granData, size_t n) {
-    size_t ownerID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t ownerID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (ownerID < n) {
         unsigned int my_family = granData->familyID[ownerID];
         granData->marginSize[ownerID] = simParams->beta + granData->familyExtraMarginSize[my_family];
@@ -14,7 +14,7 @@ __global__ void inspectOwnerProperty(deme::DEMDataDT* granData,
                                      deme::notStupidBool_t* not_in_region,
                                      size_t nOwnerBodies,
                                      deme::ownerType_t owner_type) {
-    deme::bodyID_t myOwner = blockIdx.x * blockDim.x + threadIdx.x;
+    deme::bodyID_t myOwner = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myOwner < nOwnerBodies) {
         deme::ownerType_t myType = granData->ownerTypes[myOwner];
         if (myType & owner_type) {
@@ -30,25 +30,89 @@ inline __device__ void cleanUpAcc(size_t thisClump, deme::DEMSimParams* simParam
 }
 
 __global__ void prepareAccArrays(deme::DEMSimParams* simParams, deme::DEMDataDT* granData) {
-    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < simParams->nOwnerBodies) {
         cleanUpAcc(myID, simParams, granData);
     }
 }
 
 __global__ void prepareForceArrays(deme::DEMSimParams* simParams, deme::DEMDataDT* granData, size_t nContactPairs) {
-    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < nContactPairs) {
+        // A fast pass in multi-rate integration must keep the slow contacts' forces (they are computed once per step)
+        if (simParams->multiRatePass == deme::MULTI_RATE_FAST &&
+            granData->contactRateClass[myID] != deme::MULTI_RATE_FAST) {
+            return;
+        }
+        if (simParams->useSleeping && contactIsAsleep(granData, myID)) {
+            return;
+        }
         cleanUpContactForces(myID, simParams, granData);
     }
 }
 
+// A contact is fast in multi-rate integration if either of its owners is in a sub-stepped family, or if it is a
+// sphere--mesh contact and those are all sub-stepped
+__global__ void markContactRateClasses(deme::DEMSimParams* simParams,
+                                       deme::DEMDataDT* granData,
+                                       bool subStepMeshContacts,
+                                       size_t nContactPairs) {
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContactPairs) {
+        const deme::contact_t type = granData->contactType[myID];
+        if (type == deme::NOT_A_CONTACT) {
+            granData->contactRateClass[myID] = deme::MULTI_RATE_SLOW;
+            return;
+        }
+        const deme::bodyID_t geoB = granData->idGeometryB[myID];
+        const deme::bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[myID]];
+        deme::bodyID_t ownerB;
+        if (type == deme::SPHERE_SPHERE_CONTACT) {
+            ownerB = granData->ownerClumpBody[geoB];
+        } else if (type == deme::SPHERE_MESH_CONTACT) {
+            ownerB = granData->ownerMesh[geoB];
+        } else {
+            ownerB = granData->ownerAnalBody[geoB];
+        }
+        bool fast = (subStepMeshContacts && type == deme::SPHERE_MESH_CONTACT) ||
+                    granData->familySubStepped[granData->familyID[ownerA]] ||
+                    granData->familySubStepped[granData->familyID[ownerB]];
+        granData->contactRateClass[myID] = fast ? deme::MULTI_RATE_FAST : deme::MULTI_RATE_SLOW;
+    }
+}
+
+// Find where each contact type starts in the type-sorted contact arrays. segBounds[t] (t in [0, nSlots]) becomes the
+// first pair of type t or larger, and segBounds[nSlots + 1] is set to 1 if the types are not sorted after all.
+__global__ void findContactTypeSegments(deme::DEMDataDT* granData,
+                                        deme::contactPairs_t* segBounds,
+                                        unsigned int nSlots,
+                                        size_t nContactPairs) {
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContactPairs) {
+        const unsigned int type = granData->contactType[myID];
+        const unsigned int prev_type = (myID > 0) ? granData->contactType[myID - 1] : 0;
+        if (type >= nSlots || prev_type > type) {
+            segBounds[nSlots + 1] = 1;
+            return;
+        }
+        // Each bound has exactly one writer
+        for (unsigned int t = (myID > 0) ? prev_type + 1 : 0; t <= type; t++) {
+            segBounds[t] = myID;
+        }
+        if (myID == nContactPairs - 1) {
+            for (unsigned int t = type + 1; t <= nSlots; t++) {
+                segBounds[t] = nContactPairs;
+            }
+        }
+    }
+}
+
 __global__ void rearrangeContactWildcards(deme::DEMDataDT* granData,
                                           float* newWildcards,
                                           deme::notStupidBool_t* sentry,
                                           unsigned int nWildcards,
                                           size_t nContactPairs) {
-    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < nContactPairs) {
         deme::contactPairs_t map_from = granData->contactMapping[myID];
         if (map_from == deme::NULL_MAPPING_PARTNER) {
@@ -68,7 +132,7 @@ __global__ void rearrangeContactWildcards(deme::DEMDataDT* granData,
 }
 
 __global__ void markAliveContacts(float* wildcard, deme::notStupidBool_t* sentry, size_t nContactPairs) {
-    size_t myID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (myID < nContactPairs) {
         float myEntry = abs(wildcard[myID]);
         // If this is alive then mark it
@@ -79,3 +143,264 @@ __global__ void markAliveContacts(float* wildcard, deme::notStupidBool_t* sentry
         }
     }
 }
+
+// Mark the contacts in the scope of a packed contact wildcard pool: of a type in typeMask, and of a family pair in
+// scope (familyPairs is a table indexed by locateMaskPair, or NULL if all family pairs are in scope)
+__global__ void markWildcardPoolScope(deme::DEMDataDT* granData,
+                                      deme::notStupidBool_t* inScope,
+                                      unsigned int typeMask,
+                                      deme::notStupidBool_t* familyPairs,
+                                      size_t nContactPairs) {
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContactPairs) {
+        const deme::contact_t type = granData->contactType[myID];
+        bool in_scope = (type != deme::NOT_A_CONTACT) && ((typeMask >> type) & 1u);
+        if (in_scope && familyPairs) {
+            const deme::bodyID_t geoB = granData->idGeometryB[myID];
+            const deme::bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[myID]];
+            const deme::bodyID_t ownerB = (type == deme::SPHERE_SPHERE_CONTACT) ? granData->ownerClumpBody[geoB]
+                                          : (type == deme::SPHERE_MESH_CONTACT) ? granData->ownerMesh[geoB]
+                                                                                : granData->ownerAnalBody[geoB];
+            const unsigned int famA = granData->familyID[ownerA];
+            const unsigned int famB = granData->familyID[ownerB];
+            in_scope = familyPairs[locateMaskPair<unsigned int>(famA, famB)];
+        }
+        inScope[myID] = in_scope ? 1 : 0;
+    }
+}
+
+// Give the contacts in scope of a pool their new records (newRecord, the scanned inScope): an enduring contact's record
+// is moved from its old place, and a new contact, or one that had no record, gets a zeroed one. Records are moved in
+// 2-byte units.
+__global__ void remapWildcardPoolRecords(deme::DEMDataDT* granData,
+                                         deme::notStupidBool_t* inScope,
+                                         deme::contactPairs_t* newRecord,
+                                         deme::contactPairs_t* oldIndex,
+                                         unsigned short* oldData,
+                                         deme::contactPairs_t* newIndex,
+                                         unsigned short* newData,
+                                         unsigned int recordUnits,
+                                         size_t nContactPairs) {
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContactPairs) {
+        if (!inScope[myID]) {
+            newIndex[myID] = deme::NULL_MAPPING_PARTNER;
+            return;
+        }
+        const deme::contactPairs_t my_record = newRecord[myID];
+        newIndex[myID] = my_record;
+        const deme::contactPairs_t map_from = granData->contactMapping[myID];
+        const deme::contactPairs_t old_record =
+            (map_from == deme::NULL_MAPPING_PARTNER) ? deme::NULL_MAPPING_PARTNER : oldIndex[map_from];
+        unsigned short* dst = newData + (size_t)my_record * recordUnits;
+        if (old_record == deme::NULL_MAPPING_PARTNER) {
+            for (unsigned int i = 0; i < recordUnits; i++) {
+                dst[i] = 0;
+            }
+        } else {
+            const unsigned short* src = oldData + (size_t)old_record * recordUnits;
+            for (unsigned int i = 0; i < recordUnits; i++) {
+                dst[i] = src[i];
+            }
+        }
+    }
+}
+
+// A sleeping island is woken if any of its owners is in contact with an awake owner (not with a static one)
+__global__ void wakeIslandsByContact(deme::DEMSimParams* simParams, deme::DEMDataDT* granData, size_t nContactPairs) {
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContactPairs) {
+        const deme::contact_t type = granData->contactType[myID];
+        if (type == deme::NOT_A_CONTACT) {
+            return;
+        }
+        const deme::bodyID_t geoB = granData->idGeometryB[myID];
+        const deme::bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[myID]];
+        deme::bodyID_t ownerB;
+        if (type == deme::SPHERE_SPHERE_CONTACT) {
+            ownerB = granData->ownerClumpBody[geoB];
+        } else if (type == deme::SPHERE_MESH_CONTACT) {
+            ownerB = granData->ownerMesh[geoB];
+        } else {
+            ownerB = granData->ownerAnalBody[geoB];
+        }
+        const deme::bodyID_t islandA = granData->ownerSleepIsland[ownerA];
+        const deme::bodyID_t islandB = granData->ownerSleepIsland[ownerB];
+        if (islandA == deme::NULL_BODYID && islandB != deme::NULL_BODYID && islandB != deme::STATIC_SLEEP_ISLAND) {
+            granData->sleepIslandWoken[islandB] = 1;
+        } else if (islandB == deme::NULL_BODYID && islandA != deme::NULL_BODYID &&
+                   islandA != deme::STATIC_SLEEP_ISLAND) {
+            granData->sleepIslandWoken[islandA] = 1;
+        }
+    }
+}
+
+// Owners of woken islands wake up; so do sleeping owners that changed family or that the user gave a velocity or an
+// acceleration (sleeping owners have zero velocities)
+__global__ void wakeSleepingOwners(deme::DEMSimParams* simParams, deme::DEMDataDT* granData) {
+    deme::bodyID_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < simParams->nOwnerBodies) {
+        const deme::bodyID_t island = granData->ownerSleepIsland[myID];
+        if (island == deme::NULL_BODYID) {
+            return;
+        }
+        bool wake = (granData->familyID[myID] != granData->ownerSleepFamily[myID]);
+        if (island != deme::STATIC_SLEEP_ISLAND) {
+            wake = wake || granData->sleepIslandWoken[island] || granData->accSpecified[myID] ||
+                   granData->angAccSpecified[myID] || granData->vX[myID] != 0.f || granData->vY[myID] != 0.f ||
+                   granData->vZ[myID] != 0.f || granData->omgBarX[myID] != 0.f || granData->omgBarY[myID] != 0.f ||
+                   granData->omgBarZ[myID] != 0.f;
+        }
+        if (wake) {
+            granData->ownerSleepIsland[myID] = deme::NULL_BODYID;
+            granData->ownerQuietSteps[myID] = 0;
+        }
+    }
+}
+
+// Island sleeping keeps the number of steps each owner has been quiet for (SleepIslands.hpp has the host version).
+// After each step, the record of an awake regular owner counts up if it is quiet and starts over if not; a sleeping
+// owner is quiet by definition, and other owners have no record.
+__global__ void accumulateQuietSteps(deme::DEMSimParams* simParams,
+                                     deme::DEMDataDT* granData,
+                                     float keThreshold,
+                                     unsigned int sleepSteps) {
+    deme::bodyID_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < simParams->nOwnerBodies) {
+        unsigned int quiet = 0;
+        if (granData->familySleepRole[granData->familyID[myID]] == deme::SLEEP_ROLE_REGULAR) {
+            if (granData->ownerSleepIsland[myID] != deme::NULL_BODYID) {
+                quiet = sleepSteps;
+            } else {
+                const float vX = granData->vX[myID], vY = granData->vY[myID], vZ = granData->vZ[myID];
+                const float oX = granData->omgBarX[myID], oY = granData->omgBarY[myID], oZ = granData->omgBarZ[myID];
+                const float rim2 = (oX * oX + oY * oY + oZ * oZ) * granData->ownerSleepRadius[myID] *
+                                   granData->ownerSleepRadius[myID];
+                if (0.5f * (vX * vX + vY * vY + vZ * vZ + rim2) < keThreshold) {
+                    quiet = min(granData->ownerQuietSteps[myID] + 1, sleepSteps);
+                }
+            }
+        }
+        granData->ownerQuietSteps[myID] = quiet;
+    }
+}
+
+// A contact whose overlap rate bound is not below the threshold starts over the records of its awake regular owners
+__global__ void resetQuietStepsByContact(deme::DEMSimParams* simParams,
+                                         deme::DEMDataDT* granData,
+                                         float rateThreshold,
+                                         size_t nContactPairs) {
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContactPairs) {
+        const deme::contact_t type = granData->contactType[myID];
+        if (type == deme::NOT_A_CONTACT) {
+            return;
+        }
+        const deme::bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[myID]];
+        const deme::bodyID_t ownerB = contactOwnerB(granData, type, granData->idGeometryB[myID]);
+        const float3 dv = make_float3(granData->vX[ownerA] - granData->vX[ownerB],
+                                      granData->vY[ownerA] - granData->vY[ownerB],
+                                      granData->vZ[ownerA] - granData->vZ[ownerB]);
+        const float3 wA = make_float3(granData->omgBarX[ownerA], granData->omgBarY[ownerA], granData->omgBarZ[ownerA]);
+        const float3 wB = make_float3(granData->omgBarX[ownerB], granData->omgBarY[ownerB], granData->omgBarZ[ownerB]);
+        const float rate = length(dv) + length(wA) * granData->ownerSleepRadius[ownerA] +
+                           length(wB) * granData->ownerSleepRadius[ownerB];
+        if (rate < rateThreshold) {
+            return;
+        }
+        if (granData->ownerSleepIsland[ownerA] == deme::NULL_BODYID &&
+            granData->familySleepRole[granData->familyID[ownerA]] == deme::SLEEP_ROLE_REGULAR) {
+            granData->ownerQuietSteps[ownerA] = 0;
+        }
+        if (granData->ownerSleepIsland[ownerB] == deme::NULL_BODYID &&
+            granData->familySleepRole[granData->familyID[ownerB]] == deme::SLEEP_ROLE_REGULAR) {
+            granData->ownerQuietSteps[ownerB] = 0;
+        }
+    }
+}
+
+// At an island check, the awake regular owners quiet for long enough are flagged and listed as candidates. Static
+// owners are marked as such on the way, and the marked (static or sleeping) owners are counted.
+__global__ void flagSleepCandidates(deme::DEMSimParams* simParams,
+                                    deme::DEMDataDT* granData,
+                                    unsigned int sleepSteps,
+                                    deme::notStupidBool_t* isCandidate,
+                                    deme::bodyID_t* candidates,
+                                    size_t* nCandidates,
+                                    size_t* nMarked) {
+    deme::bodyID_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < simParams->nOwnerBodies) {
+        const deme::family_t family = granData->familyID[myID];
+        const deme::notStupidBool_t role = granData->familySleepRole[family];
+        deme::bodyID_t island = granData->ownerSleepIsland[myID];
+        if (role == deme::SLEEP_ROLE_STATIC && island == deme::NULL_BODYID) {
+            island = deme::STATIC_SLEEP_ISLAND;
+            granData->ownerSleepIsland[myID] = island;
+            granData->ownerSleepFamily[myID] = family;
+        }
+        const bool candidate = (role == deme::SLEEP_ROLE_REGULAR && island == deme::NULL_BODYID &&
+                                granData->ownerQuietSteps[myID] >= sleepSteps);
+        isCandidate[myID] = candidate;
+        if (candidate) {
+            candidates[atomicAdd((unsigned long long*)nCandidates, 1ULL)] = myID;
+        }
+        if (island != deme::NULL_BODYID) {
+            atomicAdd((unsigned long long*)nMarked, 1ULL);
+        }
+    }
+}
+
+// The owner pairs of the contacts that touch a candidate, leaving out those with a static owner (which do not link
+// islands)
+__global__ void collectSleepCandidatePairs(deme::DEMSimParams* simParams,
+                                           deme::DEMDataDT* granData,
+                                           const deme::notStupidBool_t* isCandidate,
+                                           deme::bodyID_t* pairA,
+                                           deme::bodyID_t* pairB,
+                                           size_t* nPairs,
+                                           size_t nContactPairs) {
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nContactPairs) {
+        const deme::contact_t type = granData->contactType[myID];
+        if (type == deme::NOT_A_CONTACT) {
+            return;
+        }
+        const deme::bodyID_t ownerA = granData->ownerClumpBody[granData->idGeometryA[myID]];
+        const deme::bodyID_t ownerB = contactOwnerB(granData, type, granData->idGeometryB[myID]);
+        if (granData->familySleepRole[granData->familyID[ownerA]] == deme::SLEEP_ROLE_STATIC ||
+            granData->familySleepRole[granData->familyID[ownerB]] == deme::SLEEP_ROLE_STATIC) {
+            return;
+        }
+        if (isCandidate[ownerA] || isCandidate[ownerB]) {
+            const size_t k = atomicAdd((unsigned long long*)nPairs, 1ULL);
+            pairA[k] = ownerA;
+            pairB[k] = ownerB;
+        }
+    }
+}
+
+// Candidates given an island on the host fall asleep and stop moving
+__global__ void putOwnersToSleep(deme::DEMSimParams* simParams,
+                                 deme::DEMDataDT* granData,
+                                 const deme::bodyID_t* candidates,
+                                 const deme::bodyID_t* islands,
+                                 size_t nCandidates) {
+    size_t myID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
+    if (myID < nCandidates) {
+        const deme::bodyID_t island = islands[myID];
+        if (island == deme::NULL_BODYID) {
+            return;
+        }
+        const deme::bodyID_t owner = candidates[myID];
+        granData->ownerSleepIsland[owner] = island;
+        granData->ownerSleepFamily[owner] = granData->familyID[owner];
+        // The island may be named after one that was woken before
+        granData->sleepIslandWoken[island] = 0;
+        granData->vX[owner] = 0.f;
+        granData->vY[owner] = 0.f;
+        granData->vZ[owner] = 0.f;
+        granData->omgBarX[owner] = 0.f;
+        granData->omgBarY[owner] = 0.f;
+        granData->omgBarZ[owner] = 0.f;
+    }
+}
@@ -16,7 +16,7 @@ __global__ void inspectSphereProperty(deme::DEMDataDT* granData,
                                       deme::notStupidBool_t* not_in_region,
                                       size_t nSpheres,
                                       deme::ownerType_t owner_type) {
-    size_t sphereID = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t sphereID = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
     if (sphereID < nSpheres) {
         // Get my owner ID
         deme::bodyID_t myOwner = granData->ownerClumpBody[sphereID];
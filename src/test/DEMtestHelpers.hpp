@@ -0,0 +1,49 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef DEME_TEST_HELPERS_HPP
+#define DEME_TEST_HELPERS_HPP
+
+#include <cmath>
+#include <cstdio>
+
+// The number of failed checks of this test program; main returns nonzero if any failed
+inline int& DEMTestFailures() {
+    static int n = 0;
+    return n;
+}
+
+// Check a condition, and report (but go on) if it does not hold
+#define DEME_TEST_CHECK(cond)                                                \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::printf("FAILED at %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            DEMTestFailures()++;                                             \
+        }                                                                    \
+    } while (0)
+
+// Check that a and b are within a relative tolerance (or an absolute one near 0) of each other
+#define DEME_TEST_CHECK_CLOSE(a, b, rtol)                                                                      \
+    do {                                                                                                       \
+        const double deme_test_a_ = (double)(a), deme_test_b_ = (double)(b);                                   \
+        if (!(std::abs(deme_test_a_ - deme_test_b_) <=                                                         \
+              (rtol) * std::fmax(1.0, std::fmax(std::abs(deme_test_a_), std::abs(deme_test_b_))))) {           \
+            std::printf("FAILED at %s:%d: %s (%.9g) vs %s (%.9g)\n", __FILE__, __LINE__, #a, deme_test_a_, #b, \
+                        deme_test_b_);                                                                         \
+            DEMTestFailures()++;                                                                               \
+        }                                                                                                      \
+    } while (0)
+
+// Report and make main's return value
+inline int DEMTestResult(const char* name) {
+    if (DEMTestFailures() == 0) {
+        std::printf("%s: all checks passed\n", name);
+        return 0;
+    }
+    std::printf("%s: %d check(s) FAILED\n", name, DEMTestFailures());
+    return 1;
+}
+
+#endif
@@ -0,0 +1,157 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The cost-model-driven bin size tuner (BinSizeTuner.hpp), driven by synthetic
+// CD timing traces. A packing of N spheres of CD diameter D in a volume V gives
+// the touch pairs and active bins at each bin size, and the CD time follows the
+// tuner's cost model with made-up coefficients, times random timing noise. The
+// tuner must bring the CD time to within a few percent of the optimum from bin
+// sizes far below and far above it, stay put once there (hysteresis), follow a
+// change of the packing, and respect the safety limits.
+// =============================================================================
+
+#include <DEM/utils/BinSizeTuner.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <random>
+
+using namespace deme;
+
+struct SyntheticCD {
+    double numSpheres = 2e6;
+    double diameter = 0.01;
+    double volume = 1.;
+    double c[4] = {2e-4, 4e-9, 2e-8, 3e-10};
+    double noise = 0.1;
+    std::mt19937 gen{12345};
+
+    double touchPairs(double s) const { return numSpheres * std::pow(1. + diameter / s, 3); }
+    double activeBins(double s) const { return std::min(touchPairs(s), std::max(1., volume / std::pow(s, 3))); }
+    double maxSpheresInBin(double s) const { return 3. * numSpheres * std::pow(s, 3) / volume; }
+    double trueTime(double s) const {
+        double P = touchPairs(s), A = activeBins(s);
+        return c[0] + c[1] * P + c[2] * A + c[3] * P * P / A;
+    }
+    BinSizeSample sample(double s) {
+        std::uniform_real_distribution<double> dist(1. - noise, 1. + noise);
+        BinSizeSample r;
+        r.binSize = s;
+        r.numSpheres = numSpheres;
+        r.numTouchPairs = touchPairs(s);
+        r.numActiveBins = activeBins(s);
+        r.maxSpheresInBin = maxSpheresInBin(s);
+        r.numBins = volume / std::pow(s, 3);
+        r.cdTime = trueTime(s) * dist(gen);
+        return r;
+    }
+    double optimalSize(double lo = 1e-5, double hi = 1.) const {
+        double best = lo, best_t = trueTime(lo);
+        for (int i = 0; i <= 4000; i++) {
+            double s = lo * std::pow(hi / lo, i / 4000.);
+            if (trueTime(s) < best_t) {
+                best_t = trueTime(s);
+                best = s;
+            }
+        }
+        return best;
+    }
+};
+
+// Run windows of CDs; returns the number of bin size changes
+unsigned int runWindows(BinSizeTuner& tuner, SyntheticCD& cd, double& size, unsigned int n_windows) {
+    unsigned int changes = 0;
+    for (unsigned int w = 0; w < n_windows; w++) {
+        for (unsigned int i = 0; i < 10; i++)
+            tuner.Record(cd.sample(size));
+        double new_size;
+        if (tuner.Query(size, new_size)) {
+            size = new_size;
+            changes++;
+        }
+    }
+    return changes;
+}
+
+int main() {
+    // Convergence from far below and far above the optimum, at several noise levels
+    const double start_factors[] = {0.25, 0.6, 3., 13.};
+    const double noise_levels[] = {0., 0.05, 0.2};
+    for (double noise : noise_levels) {
+        for (double f : start_factors) {
+            SyntheticCD cd;
+            cd.noise = noise;
+            const double opt = cd.optimalSize();
+            BinSizeTuner tuner;
+            tuner.SetObserveSteps(10);
+            double size = opt * f;
+            unsigned int changes = runWindows(tuner, cd, size, 40);
+            double excess = cd.trueTime(size) / cd.trueTime(opt) - 1.;
+            std::printf("noise %.2f, start at %5.2fx optimum: %2u changes, ends at %.3fx optimum, CD time +%.2f%%\n",
+                        noise, f, changes, size / opt, excess * 100.);
+            DEME_TEST_CHECK(tuner.IsModelReady());
+            DEME_TEST_CHECK(excess < 0.03);
+
+            // Hysteresis: once converged, the tuner stays put through more noisy windows
+            unsigned int later_changes = runWindows(tuner, cd, size, 40);
+            excess = cd.trueTime(size) / cd.trueTime(opt) - 1.;
+            std::printf("    then %u changes in 40 more windows, CD time +%.2f%%\n", later_changes, excess * 100.);
+            DEME_TEST_CHECK(later_changes <= 2);
+            DEME_TEST_CHECK(excess < 0.03);
+        }
+    }
+
+    // A change of the packing (the spheres grow) moves the optimum; the tuner drops its old samples and follows
+    {
+        SyntheticCD cd;
+        cd.noise = 0.05;
+        BinSizeTuner tuner;
+        tuner.SetObserveSteps(10);
+        double size = cd.optimalSize();
+        runWindows(tuner, cd, size, 30);
+        cd.diameter *= 3.;
+        cd.numSpheres /= 27.;
+        const double opt = cd.optimalSize();
+        runWindows(tuner, cd, size, 60);
+        double excess = cd.trueTime(size) / cd.trueTime(opt) - 1.;
+        std::printf("After the packing changed: ends at %.3fx the new optimum, CD time +%.2f%%\n", size / opt,
+                    excess * 100.);
+        DEME_TEST_CHECK(excess < 0.03);
+    }
+
+    // The safety limit on spheres per bin wins over the cost model
+    {
+        SyntheticCD cd;
+        cd.noise = 0.05;
+        const double opt = cd.optimalSize();
+        const double max_sph = cd.maxSpheresInBin(opt * 0.7);
+        BinSizeTuner tuner;
+        tuner.SetObserveSteps(10);
+        tuner.SetSafetyLimits(max_sph, 1e30, 1e30);
+        double size = opt * 2.;
+        double max_sph_seen_late = 0.;
+        for (unsigned int w = 0; w < 40; w++) {
+            runWindows(tuner, cd, size, 1);
+            if (w >= 2)
+                max_sph_seen_late = std::max(max_sph_seen_late, cd.maxSpheresInBin(size));
+        }
+        std::printf("Safety limit below the optimum: ends at %.3fx optimum, %.0f spheres in a bin (limit %.0f)\n",
+                    size / opt, max_sph_seen_late, max_sph);
+        DEME_TEST_CHECK(max_sph_seen_late <= max_sph * 1.001);
+    }
+
+    // Nothing is decided before an observation window is complete
+    {
+        SyntheticCD cd;
+        BinSizeTuner tuner;
+        tuner.SetObserveSteps(10);
+        for (int i = 0; i < 9; i++)
+            tuner.Record(cd.sample(0.01));
+        double new_size;
+        DEME_TEST_CHECK(!tuner.Query(0.01, new_size));
+    }
+
+    return DEMTestResult("DEMtest_BinSizeTuner");
+}
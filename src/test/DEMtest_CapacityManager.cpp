@@ -0,0 +1,139 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The capacity manager (CapacityManager.hpp). The capacity must grow ahead of
+// the count needed, so a slowly rising count reallocates only now and then. It
+// must not shrink before shrinkWindow low observations in a row, and a count at
+// or above the low watermark must start the window over. When it shrinks after
+// a spike has decayed, the capacity must be shrinkHeadroom times the largest
+// count in the window (and no less than minCapacity). setPolicy must reject a
+// policy whose shrunk capacity would itself be low (shrinkHeadroom *
+// lowWatermark >= 1).
+// =============================================================================
+
+#include <core/utils/CapacityManager.hpp>
+#include "DEMtestHelpers.hpp"
+
+using namespace deme;
+
+template <typename F>
+bool throws(F&& f) {
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+CapacityPolicy smallPolicy() {
+    CapacityPolicy policy;
+    policy.growFactor = 1.2;
+    policy.minCapacity = 100;
+    policy.lowWatermark = 0.3;
+    policy.shrinkWindow = 10;
+    policy.shrinkHeadroom = 1.5;
+    return policy;
+}
+
+int main() {
+    // Growth ahead of the count needed
+    {
+        CapacityManager cap(smallPolicy());
+        DEME_TEST_CHECK(cap.observe(1000));
+        DEME_TEST_CHECK(cap.capacity() == 1200 && cap.getStats().numGrows == 1);
+        // Within the headroom, nothing changes
+        DEME_TEST_CHECK(!cap.observe(1200) && cap.capacity() == 1200);
+        // A small count gets minCapacity
+        CapacityManager small(smallPolicy());
+        DEME_TEST_CHECK(small.observe(10) && small.capacity() == 100);
+
+        // A count rising slowly, from 1000 to 2000, reallocates a few times, not at every rise
+        unsigned int numChanges = 0;
+        bool alwaysFits = true;
+        for (size_t needed = 1000; needed <= 2000; needed += 10) {
+            numChanges += cap.observe(needed);
+            alwaysFits = alwaysFits && cap.capacity() >= needed;
+        }
+        std::printf("Rising from 1000 to 2000 in steps of 10: %u reallocation(s), capacity %zu\n", numChanges,
+                    cap.capacity());
+        DEME_TEST_CHECK(alwaysFits && numChanges >= 1 && numChanges <= 4);
+        DEME_TEST_CHECK(cap.getStats().numGrows == 1 + numChanges && cap.getStats().numShrinks == 0);
+        DEME_TEST_CHECK(cap.getStats().peakNeeded == 2000 && cap.getStats().peakCapacity == cap.capacity());
+    }
+
+    // A spike that decays: no shrink within the window, then a shrink to the headroom over the window's peak
+    {
+        const CapacityPolicy policy = smallPolicy();
+        CapacityManager cap(policy);
+        cap.setCapacity(1000);
+        DEME_TEST_CHECK(cap.observe(10000) && cap.capacity() == 12000);
+        const size_t decayed[10] = {500, 700, 800, 600, 500, 500, 400, 500, 600, 500};
+        for (unsigned int k = 0; k + 1 < policy.shrinkWindow; k++)
+            DEME_TEST_CHECK(!cap.observe(decayed[k]));
+        DEME_TEST_CHECK(cap.capacity() == 12000 && cap.getStats().numShrinks == 0);
+        DEME_TEST_CHECK(cap.observe(decayed[policy.shrinkWindow - 1]));
+        std::printf("Shrunk from 12000 to %zu after %u low observations\n", cap.capacity(), policy.shrinkWindow);
+        DEME_TEST_CHECK(cap.capacity() == (size_t)(policy.shrinkHeadroom * 800));
+        DEME_TEST_CHECK(cap.getStats().numShrinks == 1 && cap.getStats().peakCapacity == 12000);
+        // The shrunk capacity is not itself low for the counts that made it
+        DEME_TEST_CHECK(!cap.observe(800) && cap.capacity() == 1200);
+
+        // The target is no less than minCapacity
+        CapacityManager floor(policy);
+        floor.setCapacity(1000);
+        for (unsigned int k = 0; k < policy.shrinkWindow; k++)
+            floor.observe(20);
+        DEME_TEST_CHECK(floor.capacity() == policy.minCapacity);
+
+        // And with allowShrink off, it never shrinks
+        CapacityPolicy growOnly = policy;
+        growOnly.allowShrink = false;
+        CapacityManager keep(growOnly);
+        keep.setCapacity(12000);
+        for (unsigned int k = 0; k < 3 * policy.shrinkWindow; k++)
+            DEME_TEST_CHECK(!keep.observe(500));
+        DEME_TEST_CHECK(keep.capacity() == 12000 && keep.getStats().numShrinks == 0);
+    }
+
+    // A count that is not low starts the window over, and forgets the window's peak
+    {
+        const CapacityPolicy policy = smallPolicy();
+        CapacityManager cap(policy);
+        cap.setCapacity(12000);
+        cap.observe(900);
+        for (unsigned int k = 1; k + 1 < policy.shrinkWindow; k++)
+            cap.observe(500);
+        // 3600 is the low watermark of 12000
+        DEME_TEST_CHECK(!cap.observe(3600) && cap.capacity() == 12000);
+        for (unsigned int k = 0; k + 1 < policy.shrinkWindow; k++)
+            DEME_TEST_CHECK(!cap.observe(600));
+        DEME_TEST_CHECK(cap.capacity() == 12000 && cap.getStats().numShrinks == 0);
+        DEME_TEST_CHECK(cap.observe(500));
+        // 1.5 times 600, the peak after the reset, not 900
+        DEME_TEST_CHECK(cap.capacity() == 900 && cap.getStats().numShrinks == 1);
+    }
+
+    // Policies that cannot work are rejected, and leave the policy as it was
+    {
+        CapacityManager cap(smallPolicy());
+        CapacityPolicy bad = smallPolicy();
+        bad.lowWatermark = 0.5;
+        bad.shrinkHeadroom = 2.;
+        DEME_TEST_CHECK(throws([&]() { cap.setPolicy(bad); }));
+        bad.shrinkHeadroom = 2.5;
+        DEME_TEST_CHECK(throws([&]() { cap.setPolicy(bad); }));
+        DEME_TEST_CHECK(throws([&]() { CapacityManager another(bad); }));
+        DEME_TEST_CHECK(cap.getPolicy().shrinkHeadroom == 1.5 && cap.getPolicy().lowWatermark == 0.3);
+        bad.shrinkHeadroom = 1.9;
+        DEME_TEST_CHECK(!throws([&]() { cap.setPolicy(bad); }));
+        CapacityPolicy slow = smallPolicy();
+        slow.growFactor = 0.9;
+        DEME_TEST_CHECK(throws([&]() { cap.setPolicy(slow); }));
+    }
+
+    return DEMTestResult("DEMtest_CapacityManager");
+}
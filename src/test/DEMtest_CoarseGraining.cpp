@@ -0,0 +1,158 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The host path of coarse-graining (CoarseGraining.hpp). The density field of
+// one particle, with the Gaussian and with Lucy's weight, must integrate over a
+// grid fine enough for the weight to the particle's mass (and its momentum and
+// volume fields to its momentum and volume). The sums of a sample of many
+// particles and contacts must be bit-identical on 1 and several threads. A grid
+// written with WriteCoarseGrainFrame must read back with ReadCoarseGrainFrame
+// exactly, and a file that is not one, or ends early, must throw.
+// =============================================================================
+
+#include <unordered_map>
+#include <core/utils/GpuError.h>
+#include <DEM/utils/CoarseGraining.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <random>
+#include <sstream>
+
+using namespace deme;
+
+template <typename F>
+bool throws(F&& f) {
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+std::vector<std::string> outputFieldNames() {
+    return std::vector<std::string>(CG_OUTPUT_FIELD_NAMES, CG_OUTPUT_FIELD_NAMES + CG_NUM_OUTPUT_FIELDS);
+}
+
+int main() {
+    // One particle, off the nodes, on a grid that covers its weight's support with spacing a tenth of the cutoff
+    {
+        CGParticle p;
+        p.x = 0.013;
+        p.y = -0.021;
+        p.z = 0.007;
+        p.mass = 2.5f;
+        p.volume = 0.4f;
+        p.vX = 1.f;
+        p.vY = -2.f;
+        p.vZ = 0.5f;
+        for (const CG_WEIGHT weight : {CG_WEIGHT::GAUSSIAN, CG_WEIGHT::LUCY}) {
+            const double width = (weight == CG_WEIGHT::GAUSSIAN) ? 0.1 : 0.3;
+            const double cutoff = (weight == CG_WEIGHT::GAUSSIAN) ? 3. * width : width;
+            const double spacing = cutoff / 10.;
+            const unsigned int n = 25;
+            const double lo = -(double)((n - 1) / 2) * spacing;
+            const CGGridParams g = MakeCGGridParams(lo, lo, lo, spacing, n, n, n, weight, width);
+            std::vector<double> sums(cgNumNodes(g) * DEME_CG_NUM_RAW_FIELDS, 0.);
+            CoarseGrainHost(g, {p}, {}, sums.data());
+            const std::vector<float> fields = CoarseGrainOutputFields(g, sums.data(), 1);
+            double mass = 0., volume = 0., momentum[3] = {0., 0., 0.};
+            const double cellVol = spacing * spacing * spacing;
+            for (size_t node = 0; node < cgNumNodes(g); node++) {
+                mass += sums[node * DEME_CG_NUM_RAW_FIELDS + CG_RAW_MASS] * cellVol;
+                volume += sums[node * DEME_CG_NUM_RAW_FIELDS + CG_RAW_VOLUME] * cellVol;
+                for (unsigned int d = 0; d < 3; d++)
+                    momentum[d] += sums[node * DEME_CG_NUM_RAW_FIELDS + CG_RAW_MOMENTUM + d] * cellVol;
+            }
+            std::printf("%s weight: the density integrates to %.9g (mass %g)\n",
+                        (weight == CG_WEIGHT::GAUSSIAN) ? "Gaussian" : "Lucy", mass, p.mass);
+            DEME_TEST_CHECK_CLOSE(mass, p.mass, 1e-3);
+            DEME_TEST_CHECK_CLOSE(volume, p.volume, 1e-3);
+            DEME_TEST_CHECK_CLOSE(momentum[0], p.mass * p.vX, 1e-3);
+            DEME_TEST_CHECK_CLOSE(momentum[1], p.mass * p.vY, 1e-3);
+            DEME_TEST_CHECK_CLOSE(momentum[2], p.mass * p.vZ, 1e-3);
+            // Where there is mass, the velocity field is the particle's, and a single particle has no kinetic stress
+            const size_t nNodes = cgNumNodes(g), center = (n / 2) + n * ((n / 2) + n * (n / 2));
+            DEME_TEST_CHECK_CLOSE(fields[2 * nNodes + center], p.vX, 1e-6);
+            DEME_TEST_CHECK_CLOSE(fields[3 * nNodes + center], p.vY, 1e-6);
+            DEME_TEST_CHECK(std::abs(fields[5 * nNodes + center]) < 1e-3 * fields[1 * nNodes + center]);
+        }
+    }
+
+    // Many particles and contacts: the same sums, bit for bit, on 1 and 4 threads
+    {
+        std::mt19937 gen(43);
+        std::uniform_real_distribution<double> pos(-1., 1.);
+        std::uniform_real_distribution<float> val(-1.f, 1.f), pos_val(0.1f, 1.f);
+        std::vector<CGParticle> particles(20000);
+        for (auto& p : particles) {
+            p.x = pos(gen);
+            p.y = pos(gen);
+            p.z = pos(gen);
+            p.mass = pos_val(gen);
+            p.volume = pos_val(gen);
+            p.vX = val(gen);
+            p.vY = val(gen);
+            p.vZ = val(gen);
+        }
+        std::vector<CGContact> contacts(30000);
+        for (auto& c : contacts) {
+            c.x = pos(gen);
+            c.y = pos(gen);
+            c.z = pos(gen);
+            c.fX = val(gen);
+            c.fY = val(gen);
+            c.fZ = val(gen);
+            c.bX = 0.05f * val(gen);
+            c.bY = 0.05f * val(gen);
+            c.bZ = 0.05f * val(gen);
+        }
+        // A particle that is not deposited
+        particles[7].x = std::nan("");
+        const CGGridParams g = MakeCGGridParams(-1., -1., -1., 0.1, 21, 21, 21, CG_WEIGHT::GAUSSIAN, 0.05);
+        const size_t nSums = cgNumNodes(g) * DEME_CG_NUM_RAW_FIELDS;
+        std::vector<double> sums1(nSums, 0.), sums4(nSums, 0.);
+        // Two samples, accumulated
+        for (int s = 0; s < 2; s++) {
+            CoarseGrainHost(g, particles, contacts, sums1.data(), 1);
+            CoarseGrainHost(g, particles, contacts, sums4.data(), 4);
+        }
+        DEME_TEST_CHECK(std::memcmp(sums1.data(), sums4.data(), nSums * sizeof(double)) == 0);
+        bool finite = true;
+        for (const double v : sums1)
+            finite = finite && std::isfinite(v);
+        DEME_TEST_CHECK(finite && sums1[(nSums / 2 / DEME_CG_NUM_RAW_FIELDS) * DEME_CG_NUM_RAW_FIELDS] > 0.);
+
+        // Round trip of the averaged grid through the file layout
+        CoarseGrainFrame frame;
+        frame.grid = g;
+        frame.nSamples = 2;
+        frame.timeStart = 0.25;
+        frame.timeEnd = 0.5;
+        frame.fieldNames = outputFieldNames();
+        frame.fields = CoarseGrainOutputFields(g, sums1.data(), 2);
+        std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+        WriteCoarseGrainFrame(ss, frame);
+        const std::string bytes = ss.str();
+        const CoarseGrainFrame back = ReadCoarseGrainFrame(ss);
+        DEME_TEST_CHECK(back.grid.nX == g.nX && back.grid.nY == g.nY && back.grid.nZ == g.nZ);
+        DEME_TEST_CHECK(back.grid.loX == g.loX && back.grid.loY == g.loY && back.grid.loZ == g.loZ);
+        DEME_TEST_CHECK(back.grid.spacing == g.spacing && back.grid.width == g.width && back.grid.weight == g.weight);
+        DEME_TEST_CHECK(back.grid.cutoff == g.cutoff && back.grid.nCellX == g.nCellX);
+        DEME_TEST_CHECK(back.nSamples == 2 && back.timeStart == 0.25 && back.timeEnd == 0.5);
+        DEME_TEST_CHECK(back.fieldNames == frame.fieldNames);
+        DEME_TEST_CHECK(back.fields.size() == frame.fields.size() &&
+                        std::memcmp(back.fields.data(), frame.fields.data(), frame.fields.size() * sizeof(float)) == 0);
+
+        // Not a grid file, or one that ends early
+        std::stringstream notCG(std::string("DMCX") + bytes.substr(4));
+        DEME_TEST_CHECK(throws([&]() { ReadCoarseGrainFrame(notCG); }));
+        std::stringstream cut(bytes.substr(0, bytes.size() - 10));
+        DEME_TEST_CHECK(throws([&]() { ReadCoarseGrainFrame(cut); }));
+    }
+
+    return DEMTestResult("DEMtest_CoarseGraining");
+}
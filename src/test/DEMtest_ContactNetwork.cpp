@@ -0,0 +1,198 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The contact network analysis (ContactNetwork.hpp), on graphs whose results
+// are worked out by hand. A chain must peel off entirely as rattlers, from its
+// free end, with a boundary contact counting toward coordination but not as an
+// edge, and its aligned normals must give a fabric anisotropy of 1. A closed
+// cluster (every particle touching every other) with a particle hanging off it
+// and an isolated one must lose only those two as rattlers, which gives its
+// mechanical coordination, and must make two clusters. Normals along all three
+// axes must give an isotropic fabric, and the strong contacts among them (all
+// along one axis) an aligned one, as a strong cluster of their own. The results
+// must not depend on the thread count.
+// =============================================================================
+
+#include <unordered_map>
+#include <core/utils/GpuError.h>
+#include <DEM/utils/ContactNetwork.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <random>
+
+using namespace deme;
+
+// A contact list, with the force along the normal
+struct TestNetwork {
+    size_t nParticles = 0;
+    std::vector<bodyID_t> a, b;
+    std::vector<float> fX, fY, fZ, nX, nY, nZ;
+
+    void add(bodyID_t pa, bodyID_t pb, float3 normal, float fn) {
+        a.push_back(pa);
+        b.push_back(pb);
+        nX.push_back(normal.x);
+        nY.push_back(normal.y);
+        nZ.push_back(normal.z);
+        fX.push_back(fn * normal.x);
+        fY.push_back(fn * normal.y);
+        fZ.push_back(fn * normal.z);
+    }
+    ContactNetworkInput input() const {
+        ContactNetworkInput in;
+        in.nParticles = nParticles;
+        in.nContacts = a.size();
+        in.particleA = a.data();
+        in.particleB = b.data();
+        in.fX = fX.data();
+        in.fY = fY.data();
+        in.fZ = fZ.data();
+        in.nX = nX.data();
+        in.nY = nY.data();
+        in.nZ = nZ.data();
+        return in;
+    }
+};
+
+bool sameSummary(const ContactNetworkSummary& s1, const ContactNetworkSummary& s2) {
+    bool same = s1.nContacts == s2.nContacts && s1.nRattlers == s2.nRattlers && s1.nClusters == s2.nClusters &&
+                s1.nStrongContacts == s2.nStrongContacts && s1.nStrongClusters == s2.nStrongClusters &&
+                s1.meanNormalForce == s2.meanNormalForce && s1.strongForceShare == s2.strongForceShare &&
+                s1.mechanicalCoordination == s2.mechanicalCoordination &&
+                s1.coordinationHistogram == s2.coordinationHistogram &&
+                s1.clusterSizeHistogram == s2.clusterSizeHistogram;
+    for (unsigned int k = 0; k < 9; k++)
+        same = same && s1.fabric[k] == s2.fabric[k] && s1.strongFabric[k] == s2.strongFabric[k];
+    return same;
+}
+
+int main() {
+    const float3 ex = make_float3(1, 0, 0), ey = make_float3(0, 1, 0), ez = make_float3(0, 0, 1);
+
+    // A chain 0-1-2-3-4 along x, with forces 1 to 4, and particle 0 also on a boundary
+    {
+        TestNetwork net;
+        net.nParticles = 5;
+        for (bodyID_t p = 0; p < 4; p++)
+            net.add(p, p + 1, ex, 1.f + p);
+        // The boundary contact's force is not a particle contact's, so it does not count in the mean
+        net.add(0, NULL_BODYID, ez, 100.f);
+        ContactNetworkOptions opts;
+        opts.rattler_min_contacts = 2;
+        opts.keep_per_particle = true;
+        const ContactNetworkSummary s = AnalyzeContactNetwork(net.input(), opts);
+
+        DEME_TEST_CHECK(s.nContacts == 4 && s.nBoundaryContacts == 1);
+        DEME_TEST_CHECK((s.coordination == std::vector<unsigned int>{2, 2, 2, 2, 1}));
+        DEME_TEST_CHECK((s.coordinationHistogram == std::vector<size_t>{0, 1, 4}));
+        DEME_TEST_CHECK_CLOSE(s.meanCoordination, 9. / 5., 1e-12);
+        // 4 has one contact; removing it leaves 3 with one, and so on down to 0, whose boundary contact is not enough
+        DEME_TEST_CHECK(s.nRattlers == 5 && s.mechanicalCoordination == 0.);
+        DEME_TEST_CHECK_CLOSE(s.meanNormalForce, 2.5, 1e-12);
+        // Strong: 3 and 4 (above 2.5), linking 2, 3 and 4
+        DEME_TEST_CHECK(s.nStrongContacts == 2 && s.nStrongClusters == 1 && s.largestStrongCluster == 3);
+        DEME_TEST_CHECK_CLOSE(s.strongForceShare, 0.7, 1e-12);
+        DEME_TEST_CHECK(s.nClusters == 1 && s.largestCluster == 5 && s.nIsolated == 0);
+        // All normals along x: n (x) n is diag(1, 0, 0)
+        DEME_TEST_CHECK(s.fabric[0] == 1. && s.fabric[4] == 0. && s.fabric[8] == 0. && s.fabric[1] == 0.);
+        DEME_TEST_CHECK_CLOSE(s.fabricAnisotropy, 1., 1e-12);
+        DEME_TEST_CHECK_CLOSE(s.strongFabricAnisotropy, 1., 1e-12);
+
+        // With a bar of 1, no particle is short of contacts, so nothing peels
+        opts.rattler_min_contacts = 1;
+        const ContactNetworkSummary s1 = AnalyzeContactNetwork(net.input(), opts);
+        DEME_TEST_CHECK(s1.nRattlers == 0);
+        DEME_TEST_CHECK_CLOSE(s1.mechanicalCoordination, 9. / 5., 1e-12);
+    }
+
+    // A closed cluster of 4 (every pair in contact), particle 4 touching only 0, and particle 5 touching nothing
+    {
+        TestNetwork net;
+        net.nParticles = 6;
+        for (bodyID_t p = 0; p < 4; p++) {
+            for (bodyID_t q = p + 1; q < 4; q++)
+                net.add(p, q, ey, 1.f);
+        }
+        net.add(4, 0, ex, 1.f);
+        ContactNetworkOptions opts;
+        opts.rattler_min_contacts = 3;
+        opts.keep_per_particle = true;
+        const ContactNetworkSummary s = AnalyzeContactNetwork(net.input(), opts);
+
+        DEME_TEST_CHECK(s.nContacts == 7 && s.nBoundaryContacts == 0);
+        DEME_TEST_CHECK((s.coordination == std::vector<unsigned int>{4, 3, 3, 3, 1, 0}));
+        DEME_TEST_CHECK(s.nIsolated == 1);
+        // 4 and 5 are rattlers; taking 4 away leaves 0 with 3 contacts, enough to stay, so the cluster's 4 particles
+        // have 3 contacts each
+        DEME_TEST_CHECK(s.nRattlers == 2);
+        DEME_TEST_CHECK((s.isRattler == std::vector<uint8_t>{0, 0, 0, 0, 1, 1}));
+        DEME_TEST_CHECK_CLOSE(s.mechanicalCoordination, 3., 1e-12);
+        DEME_TEST_CHECK_CLOSE(s.meanCoordination, 14. / 6., 1e-12);
+        // Clusters: 0 to 4, then 5 alone
+        DEME_TEST_CHECK(s.nClusters == 2 && s.largestCluster == 5);
+        DEME_TEST_CHECK((s.clusterSizeHistogram == std::vector<std::pair<size_t, size_t>>{{1, 1}, {5, 1}}));
+        DEME_TEST_CHECK((s.clusterID == std::vector<bodyID_t>{0, 0, 0, 0, 0, 1}));
+        // All forces are equal, so none is above the mean
+        DEME_TEST_CHECK(s.nStrongContacts == 0 && s.nStrongClusters == 0 && s.strongForceShare == 0.);
+
+        // The rattler removal cascades when the cluster is not enough to hold: at 4 contacts, all go
+        opts.rattler_min_contacts = 4;
+        DEME_TEST_CHECK(AnalyzeContactNetwork(net.input(), opts).nRattlers == 6);
+    }
+
+    // A star: particle 0 touching 6 others along +-x, +-y and +-z, the x contacts carrying 3 and the others 1
+    {
+        TestNetwork net;
+        net.nParticles = 7;
+        const float3 normals[6] = {ex, -1.f * ex, ey, -1.f * ey, ez, -1.f * ez};
+        for (bodyID_t k = 0; k < 6; k++)
+            net.add(0, k + 1, normals[k], (k < 2) ? 3.f : 1.f);
+        const ContactNetworkSummary s = AnalyzeContactNetwork(net.input());
+
+        // Isotropic: n (x) n averages to the identity over 3
+        for (unsigned int k = 0; k < 9; k++)
+            DEME_TEST_CHECK_CLOSE(s.fabric[k], (k % 4 == 0) ? 1. / 3. : 0., 1e-12);
+        DEME_TEST_CHECK(s.fabricAnisotropy < 1e-12);
+        // The mean is 10 / 6, so the two x contacts are strong, carrying 6 of 10, and they are aligned
+        DEME_TEST_CHECK_CLOSE(s.meanNormalForce, 10. / 6., 1e-12);
+        DEME_TEST_CHECK(s.nStrongContacts == 2);
+        DEME_TEST_CHECK_CLOSE(s.strongForceShare, 0.6, 1e-12);
+        DEME_TEST_CHECK(s.strongFabric[0] == 1. && s.strongFabric[4] == 0. && s.strongFabric[8] == 0.);
+        DEME_TEST_CHECK_CLOSE(s.strongFabricAnisotropy, 1., 1e-12);
+        // The strong contacts link 0, 1 and 2; the others are each alone in the strong network
+        DEME_TEST_CHECK(s.nStrongClusters == 1 && s.largestStrongCluster == 3);
+        DEME_TEST_CHECK(s.nClusters == 1 && s.largestCluster == 7);
+        // 0 has 6 contacts, but the others 1 each, so all of them go, and then 0
+        DEME_TEST_CHECK(s.nRattlers == 7);
+    }
+
+    // A random network over several blocks of contacts gives the same results on 1 and 4 threads
+    {
+        TestNetwork net;
+        net.nParticles = 3000;
+        std::mt19937 gen(44);
+        std::uniform_int_distribution<bodyID_t> particle(0, net.nParticles - 1);
+        std::uniform_real_distribution<float> comp(-1.f, 1.f), force(0.f, 5.f);
+        for (size_t c = 0; c < 10000; c++) {
+            float3 n = make_float3(comp(gen), comp(gen), comp(gen));
+            n = n / std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            const bodyID_t pa = particle(gen);
+            const bodyID_t pb = (c % 10 == 0) ? NULL_BODYID : (bodyID_t)((pa + 1 + particle(gen) % 100) % 3000);
+            net.add(pa, pb, n, force(gen));
+        }
+        ContactNetworkOptions opts;
+        opts.n_threads = 1;
+        const ContactNetworkSummary s1 = AnalyzeContactNetwork(net.input(), opts);
+        opts.n_threads = 4;
+        const ContactNetworkSummary s4 = AnalyzeContactNetwork(net.input(), opts);
+        DEME_TEST_CHECK(sameSummary(s1, s4));
+        DEME_TEST_CHECK(s1.nContacts == 9000 && s1.nBoundaryContacts == 1000);
+        std::printf("Random network: mean coordination %g, %zu rattlers, %zu strong contacts, anisotropy %g\n",
+                    s1.meanCoordination, s1.nRattlers, s1.nStrongContacts, s1.fabricAnisotropy);
+    }
+
+    return DEMTestResult("DEMtest_ContactNetwork");
+}
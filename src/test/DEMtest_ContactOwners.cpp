@@ -0,0 +1,84 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The owners of a contact list as ExportContacts resolves them
+// (contactOwnersOnHost in HostSideHelpers.hpp). Geometry A is always a sphere,
+// so its owner comes from the sphere owners whatever the contact type; geometry
+// B's comes from the sphere, facet or analytical component owners as the type
+// says. A list mixing all of them, with the sphere IDs outside the range of the
+// facet and analytical owner arrays, must give the right pairs, and the same
+// pairs when resolved in chunks on several threads.
+// =============================================================================
+
+#include <unordered_map>
+#include <core/utils/GpuError.h>
+#include <DEM/HostSideHelpers.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <vector>
+
+using namespace deme;
+
+int main() {
+    // 100 spheres in 10 clumps (owners 0 to 9), 2 analytical components of owner 10, 4 facets of owner 11
+    const size_t n_spheres = 100;
+    std::vector<bodyID_t> ownerClumpBody(n_spheres), ownerAnalBody = {10, 10}, ownerMesh = {11, 11, 11, 11};
+    for (size_t i = 0; i < n_spheres; i++)
+        ownerClumpBody[i] = (bodyID_t)(i / 10);
+
+    // Contacts cycling through the types, spheres going through all 100
+    const contact_t cycle[6] = {SPHERE_SPHERE_CONTACT, SPHERE_MESH_CONTACT,  SPHERE_PLANE_CONTACT,
+                                SPHERE_CYL_CONTACT,    SPHERE_PLATE_CONTACT, NOT_A_CONTACT};
+    const size_t n = 20000;
+    std::vector<contact_t> types(n);
+    std::vector<bodyID_t> geoA(n), geoB(n), expectA(n), expectB(n);
+    for (size_t i = 0; i < n; i++) {
+        types[i] = cycle[i % 6];
+        geoA[i] = (bodyID_t)((i * 7 + 50) % n_spheres);
+        expectA[i] = ownerClumpBody[geoA[i]];
+        switch (types[i]) {
+            case SPHERE_SPHERE_CONTACT:
+                geoB[i] = (bodyID_t)((i * 13) % n_spheres);
+                expectB[i] = ownerClumpBody[geoB[i]];
+                break;
+            case SPHERE_MESH_CONTACT:
+                geoB[i] = (bodyID_t)(i % ownerMesh.size());
+                expectB[i] = 11;
+                break;
+            case NOT_A_CONTACT:
+                geoA[i] = geoB[i] = 0;
+                expectA[i] = expectB[i] = NULL_BODYID;
+                break;
+            default:
+                geoB[i] = (bodyID_t)(i % ownerAnalBody.size());
+                expectB[i] = 10;
+        }
+    }
+
+    // One chunk, then several
+    std::vector<bodyID_t> idA(n, 0), idB(n, 0);
+    contactOwnersOnHost(idA.data(), idB.data(), types.data(), geoA.data(), geoB.data(), ownerClumpBody.data(),
+                        ownerMesh.data(), ownerAnalBody.data(), 0, n);
+    DEME_TEST_CHECK(idA == expectA);
+    DEME_TEST_CHECK(idB == expectB);
+
+    std::vector<bodyID_t> idA_mt(n, 0), idB_mt(n, 0);
+    const unsigned int n_chunks = hostParallelFor(
+        n,
+        [&](unsigned int, size_t start, size_t end) {
+            contactOwnersOnHost(idA_mt.data(), idB_mt.data(), types.data(), geoA.data(), geoB.data(),
+                                ownerClumpBody.data(), ownerMesh.data(), ownerAnalBody.data(), start, end);
+        },
+        4, 1000);
+    std::printf("Resolved %zu contacts in %u chunk(s)\n", n, n_chunks);
+    DEME_TEST_CHECK(idA_mt == expectA);
+    DEME_TEST_CHECK(idB_mt == expectB);
+
+    // Sphere 57 of the first sphere--mesh contact and sphere 64 of the first sphere--plane one are in clumps 5 and 6
+    DEME_TEST_CHECK(geoA[1] == 57 && idA[1] == 5 && idB[1] == 11);
+    DEME_TEST_CHECK(geoA[2] == 64 && idA[2] == 6 && idB[2] == 10);
+    return DEMTestResult("DEMtest_ContactOwners");
+}
@@ -0,0 +1,162 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Exact quantiles of distribution inspectors (DistributionInspectors.hpp). The
+// device path is run on the host step by step: sort keys of (group, value), a
+// radix sort of them in 8-bit digits like the device sort, the quantile
+// positions from the group counts, and the gather of those positions. Its
+// quantiles must be the very values std::nth_element picks from each group's
+// values, for data with duplicates, both signed zeros, infinities, subnormals,
+// NaNs (not counted), empty groups and entities of no group.
+// =============================================================================
+
+#include <DEM/utils/DistributionInspectors.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace deme;
+
+// Stable LSD radix sort of 64-bit keys, one byte per pass
+void radixSortKeys(std::vector<uint64_t>& keys) {
+    std::vector<uint64_t> tmp(keys.size());
+    for (unsigned int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[257] = {0};
+        for (const auto k : keys)
+            offsets[((k >> shift) & 0xFF) + 1]++;
+        for (unsigned int d = 0; d < 256; d++)
+            offsets[d + 1] += offsets[d];
+        for (const auto k : keys)
+            tmp[offsets[(k >> shift) & 0xFF]++] = k;
+        keys.swap(tmp);
+    }
+}
+
+// The quantiles as the device path gets them, nQuantiles per group
+std::vector<float> deviceQuantiles(const std::vector<float>& values,
+                                   const std::vector<unsigned int>& groups,
+                                   unsigned int nGroups,
+                                   const std::vector<float>& quantiles) {
+    std::vector<unsigned long long> counts(nGroups, 0);
+    std::vector<uint64_t> keys(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        keys[i] = DistributionSortKey(values[i], groups[i], nGroups);
+        if (groups[i] < nGroups && !std::isnan(values[i]))
+            counts[groups[i]]++;
+    }
+    radixSortKeys(keys);
+    const auto positions = DistributionQuantilePositions(counts.data(), nGroups, quantiles);
+    std::vector<float> res(positions.size(), 0.f);
+    for (unsigned int g = 0; g < nGroups; g++) {
+        for (size_t k = 0; k < quantiles.size() && counts[g] > 0; k++) {
+            const uint64_t key = keys[positions[g * quantiles.size() + k]];
+            // The gathered entry belongs to the group
+            DEME_TEST_CHECK((key >> 32) == g);
+            res[g * quantiles.size() + k] = DistributionKeyToFloat((uint32_t)(key & 0xFFFFFFFFu));
+        }
+    }
+    return res;
+}
+
+void checkCase(const char* name,
+               const std::vector<float>& values,
+               const std::vector<unsigned int>& groups,
+               unsigned int nGroups,
+               const std::vector<float>& quantiles) {
+    const auto dev = deviceQuantiles(values, groups, nGroups, quantiles);
+    const auto ref = ReferenceDistribution(values, groups, nGroups, {}, quantiles);
+    std::vector<std::vector<float>> members(nGroups);
+    for (size_t i = 0; i < values.size(); i++) {
+        if (groups[i] < nGroups && !std::isnan(values[i]))
+            members[groups[i]].push_back(values[i]);
+    }
+    size_t n_checked = 0, n_mismatch = 0;
+    for (unsigned int g = 0; g < nGroups; g++) {
+        auto& vals = members[g];
+        DEME_TEST_CHECK(ref[g].count == vals.size());
+        for (size_t k = 0; k < quantiles.size(); k++) {
+            float expected = 0.f;
+            if (!vals.empty()) {
+                const size_t rank = DistributionQuantileRank(quantiles[k], vals.size());
+                std::nth_element(vals.begin(), vals.begin() + rank, vals.end());
+                expected = vals[rank];
+            }
+            const float got = dev[g * quantiles.size() + k];
+            // Equal as values (so -0 and +0 are the same order statistic)
+            if (!(got == expected) || !(ref[g].quantiles[k] == expected))
+                n_mismatch++;
+            n_checked++;
+        }
+    }
+    std::printf("%s: %zu values, %u groups, %zu quantiles checked, %zu mismatches\n", name, values.size(), nGroups,
+                n_checked, n_mismatch);
+    DEME_TEST_CHECK(n_mismatch == 0);
+}
+
+int main() {
+    const std::vector<float> quantiles = {0.f, 0.01f, 0.1f, 0.25f, 0.5f, 0.75f, 0.9f, 0.99f, 0.999f, 1.f};
+    std::mt19937 gen(31);
+
+    // Many values in a few dozen groups, some groups empty, some entities of no group
+    {
+        const unsigned int nGroups = 37;
+        std::normal_distribution<float> normal(0.f, 3.f);
+        std::uniform_int_distribution<unsigned int> group(0, nGroups + 4);
+        std::vector<float> values(200000);
+        std::vector<unsigned int> groups(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = normal(gen);
+            groups[i] = group(gen);
+            // Leave groups 5 and 6 empty
+            if (groups[i] == 5 || groups[i] == 6)
+                groups[i] = DIST_NULL_GROUP;
+        }
+        checkCase("normal values", values, groups, nGroups, quantiles);
+    }
+
+    // Heavy duplicates and special values: both zeros, infinities, subnormals, the extremes of float, and NaNs
+    {
+        const unsigned int nGroups = 5;
+        const float specials[] = {0.f,
+                                  -0.f,
+                                  1.f,
+                                  -1.f,
+                                  std::numeric_limits<float>::infinity(),
+                                  -std::numeric_limits<float>::infinity(),
+                                  std::numeric_limits<float>::denorm_min(),
+                                  -std::numeric_limits<float>::denorm_min(),
+                                  std::numeric_limits<float>::max(),
+                                  std::numeric_limits<float>::lowest(),
+                                  std::numeric_limits<float>::min(),
+                                  std::numeric_limits<float>::quiet_NaN()};
+        std::uniform_int_distribution<size_t> pick(0, sizeof(specials) / sizeof(float) - 1);
+        std::uniform_int_distribution<unsigned int> group(0, nGroups - 1);
+        std::vector<float> values(50000);
+        std::vector<unsigned int> groups(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = specials[pick(gen)];
+            groups[i] = group(gen);
+        }
+        checkCase("special values", values, groups, nGroups, quantiles);
+    }
+
+    // Groups of one and two values, and a single group (no grouping)
+    {
+        std::vector<float> values = {3.f, -2.f, 7.f, 7.f, 1e-30f};
+        std::vector<unsigned int> groups = {0, 1, 1, 2, 3};
+        checkCase("tiny groups", values, groups, 4, quantiles);
+        std::uniform_real_distribution<float> uni(-1e3f, 1e3f);
+        values.resize(9999);
+        for (auto& v : values)
+            v = uni(gen);
+        groups.assign(values.size(), 0);
+        checkCase("one group", values, groups, 1, quantiles);
+    }
+
+    return DEMTestResult("DEMtest_DistributionQuantiles");
+}
@@ -0,0 +1,148 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// DualArray, DualStruct and DeviceArray (DataMigrationHelper.hpp) on the memory
+// backend the build selects (HOST_TESTS_USE_HOST_BACKEND). Data must make the
+// round trip host -> device -> host whole and in part, survive resizing and a
+// dropped host mirror, and keep a bound device pointer current. Their memory
+// must be counted while allocated and given back when freed. The device side
+// is read and written only through the backend's copies, so the same checks
+// hold on both backends.
+// =============================================================================
+
+#include <core/utils/DataMigrationHelper.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <numeric>
+#include <vector>
+
+using namespace deme;
+
+// What the device side holds, read through the backend
+template <typename T>
+std::vector<T> deviceContent(T* device, size_t n) {
+    std::vector<T> res(n);
+    MemoryBackend::copy(res.data(), device, n * sizeof(T), MEM_COPY::DEVICE_TO_HOST);
+    return res;
+}
+
+// Write the device side through the backend
+template <typename T>
+void writeDevice(T* device, const std::vector<T>& vals, size_t start = 0) {
+    MemoryBackend::copy(device + start, vals.data(), vals.size() * sizeof(T), MEM_COPY::HOST_TO_DEVICE);
+}
+
+int main() {
+    std::printf("Memory backend: %s\n", MemoryBackend::unifiedViews ? "unified host and device views" : "CUDA");
+    const size_t n = 1000;
+    std::vector<float> ramp(n);
+    std::iota(ramp.begin(), ramp.end(), 0.f);
+
+    // Round trip, whole and in part
+    {
+        DualArray<float> arr(n, 0.f);
+        for (size_t i = 0; i < n; i++)
+            arr[i] = ramp[i];
+        arr.toDevice();
+        DEME_TEST_CHECK(deviceContent(arr.device(), n) == ramp);
+
+        std::vector<float> doubled(n);
+        for (size_t i = 0; i < n; i++)
+            doubled[i] = 2.f * ramp[i];
+        writeDevice(arr.device(), doubled);
+        arr.toHost();
+        DEME_TEST_CHECK(std::vector<float>(arr.host(), arr.host() + n) == doubled);
+
+        // Only the part asked for is copied back (on a backend with separate views)
+        writeDevice(arr.device(), std::vector<float>(10, -1.f), 100);
+        arr.toHost(100, 5);
+        DEME_TEST_CHECK(arr[100] == -1.f && arr[104] == -1.f);
+        if (!MemoryBackend::unifiedViews)
+            DEME_TEST_CHECK(arr[105] == doubled[105]);
+        DEME_TEST_CHECK(arr.getVal(109) == -1.f);
+        arr.setVal(7.f, 500);
+        DEME_TEST_CHECK(deviceContent(arr.device() + 500, 1)[0] == 7.f);
+        arr.setVal(std::vector<float>{1.f, 2.f, 3.f}, 600);
+        DEME_TEST_CHECK(deviceContent(arr.device() + 600, 3) == (std::vector<float>{1.f, 2.f, 3.f}));
+        DEME_TEST_CHECK(arr.getVal(600, 3) == (std::vector<float>{1.f, 2.f, 3.f}));
+    }
+
+    // Resizing keeps the data on both sides and keeps a bound pointer current; dropping the host mirror keeps the data
+    {
+        DualArray<float> arr(n, 0.f);
+        float* bound = nullptr;
+        arr.bindDevicePointer(&bound);
+        DEME_TEST_CHECK(bound == arr.device());
+        for (size_t i = 0; i < n; i++)
+            arr[i] = ramp[i];
+        arr.toDevice();
+        arr.resize(4 * n, 0.f);
+        DEME_TEST_CHECK(arr.size() == 4 * n && bound == arr.device());
+        DEME_TEST_CHECK(deviceContent(arr.device(), n) == ramp);
+        DEME_TEST_CHECK(arr[n - 1] == ramp[n - 1] && arr[2 * n] == 0.f);
+
+        arr.toDevice();
+        arr.dropHostMirror();
+        DEME_TEST_CHECK(arr.size() == 4 * n);
+        writeDevice(arr.device(), std::vector<float>{42.f}, 3);
+        // The mirror is made again from the device copy the next time the host side is used
+        DEME_TEST_CHECK(arr[3] == 42.f && arr[n - 1] == ramp[n - 1]);
+        DEME_TEST_CHECK(arr.hasHostMirror());
+
+        arr.reallocate(n / 2, 0.f);
+        DEME_TEST_CHECK(arr.size() == n / 2 && bound == arr.device());
+        DEME_TEST_CHECK(arr[3] == 42.f && arr[n / 2 - 1] == ramp[n / 2 - 1]);
+    }
+
+    // DualStruct round trip
+    {
+        struct Params {
+            double h;
+            unsigned int nSteps;
+        };
+        DualStruct<Params> params(Params{1e-5, 10});
+        DEME_TEST_CHECK(deviceContent(params.getDevicePointer(), 1)[0].nSteps == 10);
+        params->nSteps = 20;
+        params.markModified();
+        DEME_TEST_CHECK(!params.checkNoPendingModification());
+        params.toDevice();
+        DEME_TEST_CHECK(params.checkNoPendingModification());
+        DEME_TEST_CHECK(deviceContent(params.getDevicePointer(), 1)[0].nSteps == 20);
+        writeDevice(params.getDevicePointer(), std::vector<Params>{Params{2e-5, 30}});
+        params.toHost();
+        DEME_TEST_CHECK(params->h == 2e-5 && params->nSteps == 30);
+    }
+
+    // Memory is counted while allocated, and given back when freed
+    {
+        size_t host_bytes = 0, device_bytes = 0, scratch_bytes = 0;
+        MemoryRegistry registry;
+        {
+            DualArray<double> arr(n, 1., &host_bytes, &device_bytes);
+            DEME_REGISTER_MEMORY(&registry, "", arr, "owner");
+            DeviceArray<int> scratch(n, &scratch_bytes);
+            DEME_REGISTER_MEMORY(&registry, "", scratch, "scratch");
+            DEME_TEST_CHECK(host_bytes >= n * sizeof(double) && device_bytes >= n * sizeof(double));
+            DEME_TEST_CHECK(scratch_bytes == n * sizeof(int));
+            const MemoryRollup total = registry.GetTotal();
+            DEME_TEST_CHECK(total.bytes[(unsigned int)MEM_SPACE::DEVICE] >= n * (sizeof(double) + sizeof(int)));
+
+            // The device scratch keeps its data when it grows
+            std::vector<int> ids(n);
+            std::iota(ids.begin(), ids.end(), 0);
+            writeDevice(scratch.data(), ids);
+            scratch.resize(2 * n);
+            DEME_TEST_CHECK(scratch.size() == 2 * n && deviceContent(scratch.data(), n) == ids);
+        }
+        std::printf("After freeing: %zu host, %zu device, %zu scratch bytes counted; %zu bytes recorded\n", host_bytes,
+                    device_bytes, scratch_bytes,
+                    registry.GetTotal().bytes[0] + registry.GetTotal().bytes[1]);
+        DEME_TEST_CHECK(host_bytes == 0 && device_bytes == 0 && scratch_bytes == 0);
+        DEME_TEST_CHECK(registry.GetTotal().bytes[0] == 0 && registry.GetTotal().bytes[1] == 0);
+    }
+
+    return DEMTestResult("DEMtest_DualArray");
+}
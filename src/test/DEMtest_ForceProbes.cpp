@@ -0,0 +1,138 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Contact force probes (DEMForceProbeHelpers.cuh), reduced on the host the way
+// reduceContactForceProbes does on the device. Two bodies resting on each other
+// in a tray make a probe: their mutual contact is internal, so the probe's net
+// force and moment must be the sum of the contact forces on its members taken
+// one by one, in which the two sides of that contact cancel. A probe of one of
+// them must see the mutual contact, and a family probe of both must match the
+// owner probe.
+// =============================================================================
+
+#include <DEM/Defines.h>
+#include <kernel/DEMHelperKernels.cuh>
+#include <kernel/DEMForceProbeHelpers.cuh>
+#include "DEMtestHelpers.hpp"
+
+#include <set>
+#include <vector>
+
+using namespace deme;
+
+// A contact with its global contact point, and the force and torque on its A side (B gets the opposites)
+struct ProbeContact {
+    bodyID_t ownerA, ownerB;
+    float3 pnt, force, torque;
+};
+
+struct ProbeTotals {
+    float3 force = make_float3(0, 0, 0);
+    float3 moment = make_float3(0, 0, 0);
+    size_t numContacts = 0;
+};
+
+// What the kernel does for probe k, given the probe membership masks of the owners
+ProbeTotals reduceProbe(const std::vector<ProbeContact>& contacts,
+                        const std::vector<unsigned int>& ownerMask,
+                        unsigned int k,
+                        const float3& ref) {
+    ProbeTotals res;
+    float agg[FORCE_PROBE_NUM_AGGREGATES] = {};
+    const unsigned int bit = 1u << k;
+    for (const auto& c : contacts) {
+        const unsigned int side = forceProbeSide(ownerMask[c.ownerA], ownerMask[c.ownerB], bit);
+        if (side == FORCE_PROBE_NO_SIDE)
+            continue;
+        const bool AorB = (side == FORCE_PROBE_SIDE_A);
+        float contrib[FORCE_PROBE_NUM_AGGREGATES];
+        forceProbeContribution(contrib, c.pnt, AorB ? c.force : -1.f * c.force, AorB ? c.torque : -1.f * c.torque,
+                               ref);
+        for (unsigned int j = 0; j < FORCE_PROBE_NUM_AGGREGATES; j++)
+            agg[j] += contrib[j];
+        res.numContacts++;
+    }
+    res.force = make_float3(agg[0], agg[1], agg[2]);
+    res.moment = make_float3(agg[3], agg[4], agg[5]);
+    return res;
+}
+
+// The contact forces on each member, taken one by one like GetOwnerContactForces does, and summed
+ProbeTotals sumOverMembers(const std::vector<ProbeContact>& contacts,
+                           const std::set<bodyID_t>& members,
+                           const float3& ref) {
+    ProbeTotals res;
+    for (const auto& c : contacts) {
+        if (members.count(c.ownerA)) {
+            res.force = res.force + c.force;
+            res.moment = res.moment + cross(c.pnt - ref, c.force) + c.torque;
+        }
+        if (members.count(c.ownerB)) {
+            res.force = res.force - c.force;
+            res.moment = res.moment - cross(c.pnt - ref, c.force) - c.torque;
+        }
+    }
+    return res;
+}
+
+#define CHECK_CLOSE3(a, b)                     \
+    do {                                       \
+        DEME_TEST_CHECK_CLOSE(a.x, b.x, 1e-5); \
+        DEME_TEST_CHECK_CLOSE(a.y, b.y, 1e-5); \
+        DEME_TEST_CHECK_CLOSE(a.z, b.z, 1e-5); \
+    } while (0)
+
+int main() {
+    // Owner 0 rests on owner 1, which rests in the tray (owner 2); owner 3 leans on both from the side
+    const float3 ref = make_float3(0.1f, -0.2f, 0.f);
+    std::vector<ProbeContact> contacts = {
+        // The mutual contact, listed both ways round over the test so either side can be A
+        {1, 0, make_float3(0, 0, 1.f), make_float3(0.3f, -0.1f, -9.8f), make_float3(0.01f, 0.f, 0.02f)},
+        {1, 2, make_float3(0, 0, 0.f), make_float3(0.f, 0.2f, 19.6f), make_float3(0.f, 0.f, 0.f)},
+        {3, 0, make_float3(0.5f, 0, 1.5f), make_float3(-2.f, 0.f, 0.5f), make_float3(0.f, 0.03f, 0.f)},
+        {1, 3, make_float3(0.5f, 0, 0.5f), make_float3(-1.f, 0.1f, 0.f), make_float3(0.f, 0.f, 0.f)},
+    };
+    // Probe 0 is owners 0 and 1, probe 1 is owner 0 alone; probe 2 is the family of 0 and 1, folded into the masks
+    // like the kernel does
+    std::vector<unsigned int> ownerMask = {0b111, 0b101, 0, 0};
+
+    for (int flip = 0; flip < 2; flip++) {
+        if (flip) {
+            std::swap(contacts[0].ownerA, contacts[0].ownerB);
+            contacts[0].force = -1.f * contacts[0].force;
+            contacts[0].torque = -1.f * contacts[0].torque;
+        }
+        const ProbeTotals pair = reduceProbe(contacts, ownerMask, 0, ref);
+        const ProbeTotals expected = sumOverMembers(contacts, {0, 1}, ref);
+        std::printf("Two-body probe: force (%g, %g, %g), moment (%g, %g, %g) over %zu contacts\n", pair.force.x,
+                    pair.force.y, pair.force.z, pair.moment.x, pair.moment.y, pair.moment.z, pair.numContacts);
+        // The mutual contact is left out, and the members' forces on each other cancel
+        DEME_TEST_CHECK(pair.numContacts == 3);
+        CHECK_CLOSE3(pair.force, expected.force);
+        CHECK_CLOSE3(pair.moment, expected.moment);
+
+        // Owner 0 alone sees the mutual contact
+        const ProbeTotals single = reduceProbe(contacts, ownerMask, 1, ref);
+        const ProbeTotals expected_single = sumOverMembers(contacts, {0}, ref);
+        DEME_TEST_CHECK(single.numContacts == 2);
+        CHECK_CLOSE3(single.force, expected_single.force);
+        CHECK_CLOSE3(single.moment, expected_single.moment);
+
+        // The family probe is the same as the owner probe
+        const ProbeTotals family = reduceProbe(contacts, ownerMask, 2, ref);
+        DEME_TEST_CHECK(family.numContacts == pair.numContacts);
+        CHECK_CLOSE3(family.force, pair.force);
+        CHECK_CLOSE3(family.moment, pair.moment);
+    }
+
+    // A contact between two members counts for neither side; one between a member and an outsider, for the member's
+    DEME_TEST_CHECK(forceProbeSide(0b1, 0b1, 0b1) == FORCE_PROBE_NO_SIDE);
+    DEME_TEST_CHECK(forceProbeSide(0b10, 0b10, 0b1) == FORCE_PROBE_NO_SIDE);
+    DEME_TEST_CHECK(forceProbeSide(0b11, 0b10, 0b1) == FORCE_PROBE_SIDE_A);
+    DEME_TEST_CHECK(forceProbeSide(0b10, 0b11, 0b1) == FORCE_PROBE_SIDE_B);
+
+    return DEMTestResult("DEMtest_ForceProbes");
+}
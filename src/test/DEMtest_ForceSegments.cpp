@@ -0,0 +1,184 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Contact type-segmented force calculation (ForceSegments.hpp). Contact pairs
+// sorted by type get their segment bounds the way findContactTypeSegments finds
+// them on the device, and PlanForceSegments plans the launches. The generated
+// JIT source is read back for its kernels, and each launch is run through the
+// kernel it names: every pair must be handled exactly once, by a kernel whose
+// type mask has the pair's type, and segments must be fused only if smaller
+// than the fuse size. Unsorted pairs, and types without a compiled kernel, must
+// fall back to the generic kernel.
+// =============================================================================
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <regex>
+
+#include <DEM/utils/ForceSegments.hpp>
+#include "DEMtestHelpers.hpp"
+
+using namespace deme;
+
+// The segment bounds as findContactTypeSegments writes them, a thread per pair; bounds[nSlots + 1] flags unsorted
+// pairs
+std::vector<contactPairs_t> findSegments(const std::vector<unsigned int>& types) {
+    const unsigned int nSlots = NUM_CONTACT_TYPE_SLOTS;
+    std::vector<contactPairs_t> bounds(nSlots + 2, 0);
+    const size_t n = types.size();
+    for (size_t myID = 0; myID < n; myID++) {
+        const unsigned int type = types[myID];
+        const unsigned int prev_type = (myID > 0) ? types[myID - 1] : 0;
+        if (type >= nSlots || prev_type > type) {
+            bounds[nSlots + 1] = 1;
+            continue;
+        }
+        for (unsigned int t = (myID > 0) ? prev_type + 1 : 0; t <= type; t++)
+            bounds[t] = myID;
+        if (myID == n - 1) {
+            for (unsigned int t = type + 1; t <= nSlots; t++)
+                bounds[t] = n;
+        }
+    }
+    return bounds;
+}
+
+// The kernels of the generated source: name mask -> mask of the force function it calls
+std::map<unsigned int, unsigned int> parseKernels(const std::string& code) {
+    std::map<unsigned int, unsigned int> kernels;
+    const std::regex kernel_re("__global__ void calculateContactForcesOfTypes_([0-9]+)\\(([^)]*)\\) \\{\\n"
+                               "[^}]*calculateContactForceOf<([0-9]+)u>\\(simParams, granData, segStart \\+ "
+                               "myContactID\\);");
+    for (auto it = std::sregex_iterator(code.begin(), code.end(), kernel_re); it != std::sregex_iterator(); ++it) {
+        unsigned int name_mask = std::stoul((*it)[1]);
+        DEME_TEST_CHECK(kernels.count(name_mask) == 0);
+        DEME_TEST_CHECK((*it)[2] == "deme::DEMSimParams* simParams, deme::DEMDataDT* granData, "
+                                    "deme::contactPairs_t segStart, size_t segLen");
+        kernels[name_mask] = std::stoul((*it)[3]);
+    }
+    return kernels;
+}
+
+// Run the planned launches through the generated kernels, and check them against the pairs; returns false on the
+// first problem found
+bool checkPlan(const std::vector<unsigned int>& types,
+               unsigned int compiled_mask,
+               size_t fuse_size,
+               const std::vector<ForceSegmentLaunch>& launches) {
+    const auto kernels = parseKernels(GenerateForceSegmentKernels(compiled_mask));
+    std::vector<unsigned int> handled(types.size(), 0);
+    size_t next_start = 0;
+    for (const auto& launch : launches) {
+        // Launches are in pair order and leave no gap
+        if (launch.start != next_start || launch.count == 0)
+            return false;
+        next_start = launch.start + launch.count;
+        if (ForceSegmentKernelName(launch.kernelMask) !=
+            "calculateContactForcesOfTypes_" + std::to_string(launch.kernelMask))
+            return false;
+        auto kernel = kernels.find(launch.kernelMask);
+        if (kernel == kernels.end() || kernel->second != launch.kernelMask)
+            return false;
+        if ((launch.typeMask & ~launch.kernelMask) != 0)
+            return false;
+        // A single-type launch of a big segment uses that type's kernel; a fused one only has small segments
+        unsigned int types_in = 0;
+        for (size_t i = launch.start; i < next_start && i < types.size(); i++) {
+            if (!(kernel->second & ContactTypeBit(types[i])))
+                return false;
+            types_in |= ContactTypeBit(types[i]);
+            handled[i]++;
+        }
+        if (types_in != launch.typeMask)
+            return false;
+        if (NumContactTypesInMask(launch.typeMask) > 1 || launch.count < fuse_size) {
+            for (unsigned int t = 0; t < NUM_CONTACT_TYPE_SLOTS; t++) {
+                if ((launch.typeMask & ContactTypeBit(t)) &&
+                    (size_t)std::count(types.begin(), types.end(), t) >= fuse_size)
+                    return false;
+            }
+        }
+        if (NumContactTypesInMask(launch.typeMask) == 1 && launch.kernelMask != launch.typeMask)
+            return false;
+    }
+    if (next_start != types.size())
+        return false;
+    return std::all_of(handled.begin(), handled.end(), [](unsigned int h) { return h == 1; });
+}
+
+int main() {
+    std::mt19937 gen(11);
+    // The types of a simulation with meshes and a plane and a cylinder, as equipForceSegments compiles them
+    const std::vector<unsigned int> sim_types = {0, 1, 2, 11, 12};
+    unsigned int compiled_mask = 0;
+    for (auto t : sim_types)
+        compiled_mask |= ContactTypeBit(t);
+
+    // The generated source: a kernel for each compiled type, and one for all of them
+    {
+        const auto kernels = parseKernels(GenerateForceSegmentKernels(compiled_mask));
+        DEME_TEST_CHECK(kernels.size() == sim_types.size() + 1);
+        for (auto t : sim_types)
+            DEME_TEST_CHECK(kernels.count(ContactTypeBit(t)) && kernels.at(ContactTypeBit(t)) == ContactTypeBit(t));
+        DEME_TEST_CHECK(kernels.count(compiled_mask) && kernels.at(compiled_mask) == compiled_mask);
+        // With one type only, there is no all-type kernel
+        DEME_TEST_CHECK(parseKernels(GenerateForceSegmentKernels(ContactTypeBit(1))).size() == 1);
+    }
+
+    // Random sorted pairs, with segments of all sizes around the fuse size
+    {
+        const size_t fuse_size = 64;
+        std::uniform_int_distribution<size_t> seg_len(0, 3 * fuse_size);
+        std::bernoulli_distribution present(0.7);
+        size_t n_plans = 0, n_bad = 0, n_launches = 0, n_fused = 0;
+        for (int trial = 0; trial < 500; trial++) {
+            std::vector<unsigned int> types;
+            for (auto t : sim_types) {
+                if (present(gen))
+                    types.insert(types.end(), seg_len(gen), t);
+            }
+            if (types.empty())
+                continue;
+            const auto bounds = findSegments(types);
+            DEME_TEST_CHECK(bounds[NUM_CONTACT_TYPE_SLOTS + 1] == 0);
+            std::vector<ForceSegmentLaunch> launches;
+            const bool usable = PlanForceSegments(bounds.data(), types.size(), compiled_mask, fuse_size, launches);
+            n_plans++;
+            if (!usable || !checkPlan(types, compiled_mask, fuse_size, launches))
+                n_bad++;
+            n_launches += launches.size();
+            for (const auto& launch : launches)
+                n_fused += (NumContactTypesInMask(launch.typeMask) > 1);
+        }
+        std::printf("Sorted pairs: %zu plans, %zu launches (%zu fused), %zu bad plans\n", n_plans, n_launches, n_fused,
+                    n_bad);
+        DEME_TEST_CHECK(n_bad == 0);
+        DEME_TEST_CHECK(n_fused > 0);
+        // With a fuse size of 1, every segment is a launch of its own
+        std::vector<unsigned int> types = {0, 1, 1, 2, 11, 11, 11, 12};
+        std::vector<ForceSegmentLaunch> launches;
+        DEME_TEST_CHECK(PlanForceSegments(findSegments(types).data(), types.size(), compiled_mask, 1, launches));
+        DEME_TEST_CHECK(launches.size() == 5 && checkPlan(types, compiled_mask, 1, launches));
+    }
+
+    // The generic kernel is used for unsorted pairs, for a type with no compiled kernel, and for bounds that do not
+    // describe the pairs
+    {
+        std::vector<ForceSegmentLaunch> launches;
+        std::vector<unsigned int> unsorted = {1, 1, 2, 1, 11};
+        DEME_TEST_CHECK(findSegments(unsorted)[NUM_CONTACT_TYPE_SLOTS + 1] == 1);
+        std::vector<unsigned int> cone = {1, 1, 14};
+        DEME_TEST_CHECK(!PlanForceSegments(findSegments(cone).data(), cone.size(), compiled_mask, 1, launches));
+        DEME_TEST_CHECK(launches.empty());
+        std::vector<unsigned int> types = {1, 1, 2};
+        DEME_TEST_CHECK(!PlanForceSegments(findSegments(types).data(), types.size() + 1, compiled_mask, 1, launches));
+        DEME_TEST_CHECK(launches.empty());
+    }
+
+    return DEMTestResult("DEMtest_ForceSegments");
+}
@@ -0,0 +1,91 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The hierarchical grid's sphere pair search (HierarchicalGrid.hpp). For size
+// ratios from 1 to 40, random packings of fines, boulders and sizes in between
+// must give the same pair list from the hierarchical grid, from the single-grid
+// reference (which reports a pair in the bin holding the contact point, like
+// kT's bin kernels) and from checking every pair: no pair missed, none reported
+// twice. Polydisperse packings must use more than one level. A sphere inside
+// another is not placed: the contact point of such a pair can lie outside the
+// smaller sphere's bins, so the bin search (here and on the device) misses it,
+// and a DEM packing never has one.
+// =============================================================================
+
+#include <unordered_map>
+#include <core/utils/GpuError.h>
+#include <DEM/utils/HierarchicalGrid.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <random>
+
+using namespace deme;
+
+typedef std::vector<std::pair<size_t, size_t>> PairList;
+
+PairList sorted(PairList pairs) {
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+bool hasDuplicates(const PairList& sorted_pairs) {
+    return std::adjacent_find(sorted_pairs.begin(), sorted_pairs.end()) != sorted_pairs.end();
+}
+
+int main() {
+    const float fine_rad = 0.5f;
+    const float size_ratios[] = {1.f, 1.5f, 2.f, 3.f, 5.f, 8.f, 10.f, 20.f, 30.f, 40.f};
+    std::mt19937 gen(2021);
+    for (const float ratio : size_ratios) {
+        // A few boulders, then a tenth of the spheres of sizes in between, then fines filling the rest of the box (the
+        // large spheres go first, as there may be no room left for them among the fines)
+        const float big_rad = fine_rad * ratio;
+        const float box = std::max(20.f, 3.f * big_rad);
+        std::uniform_real_distribution<float> coord(0.f, box), between(fine_rad, big_rad);
+        const size_t n_fines = 2500, n_between = 250, n_boulders = (ratio > 1.f) ? 6 : 0;
+        std::vector<float3> pos;
+        std::vector<float> radii;
+        for (size_t i = 0; i < n_boulders + n_between + n_fines; i++) {
+            const float r = (i < n_boulders) ? big_rad : ((i < n_boulders + n_between) ? between(gen) : fine_rad);
+            float3 p;
+            bool inside;
+            do {
+                p = make_float3(coord(gen), coord(gen), coord(gen));
+                inside = false;
+                for (size_t j = 0; j < pos.size() && !inside; j++) {
+                    const double dx = p.x - pos[j].x, dy = p.y - pos[j].y, dz = p.z - pos[j].z;
+                    const double gap = std::abs((double)r - radii[j]);
+                    inside = dx * dx + dy * dy + dz * dz <= gap * gap;
+                }
+            } while (inside);
+            pos.push_back(p);
+            radii.push_back(r);
+        }
+
+        HierarchicalGrid grid;
+        DEME_TEST_CHECK(grid.Build(pos, radii));
+        size_t n_hier_candidates = 0;
+        const PairList hier = sorted(grid.FindPairs(pos, radii, &n_hier_candidates));
+        SingleGridStats single_stats;
+        const PairList single = sorted(singleGridSpherePairs(pos, radii, 4. * fine_rad, &single_stats));
+        const PairList brute = sorted(bruteForceSpherePairs(pos, radii));
+        std::printf("Size ratio %g: %u level(s), %zu pairs; candidates %zu (hierarchical), %zu (single grid)\n", ratio,
+                    grid.GetNumLevels(), brute.size(), n_hier_candidates, single_stats.numCandidates);
+
+        DEME_TEST_CHECK(!brute.empty());
+        DEME_TEST_CHECK(!hasDuplicates(hier) && !hasDuplicates(single));
+        DEME_TEST_CHECK(hier == brute);
+        DEME_TEST_CHECK(single == brute);
+        // Every sphere is at one level, and the boulders are at the coarsest
+        const std::vector<size_t> per_level = grid.GetNumSpheresEachLevel();
+        DEME_TEST_CHECK(std::accumulate(per_level.begin(), per_level.end(), (size_t)0) == pos.size());
+        DEME_TEST_CHECK(grid.GetCellSize(grid.GetLevels().front()) >= 2. * radii.front());
+        if (ratio >= 2.f)
+            DEME_TEST_CHECK(grid.GetNumLevels() > 1 && grid.GetLevels().front() == grid.GetNumLevels() - 1);
+    }
+
+    return DEMTestResult("DEMtest_HierarchicalGrid");
+}
@@ -0,0 +1,151 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Index range checks (IndexWidth.hpp) on counts whose total goes past 2^32.
+// Per-item counts are scanned into offsets the way contact detection does it
+// (an exclusive scan with SaturatingSum, done in blocks then combined, like a
+// device scan), and the scan tail (last offset + last count, in 64 bits) is
+// checked with ScanTotalFitsIndex. With 32-bit indices, a total past 2^32 must
+// be caught; with 64-bit indices (DEME_USE_WIDE_INDICES), it must fit and the
+// tail must be exact.
+// =============================================================================
+
+#include <DEM/utils/IndexWidth.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace deme;
+
+// Exclusive scan of counts into offsets with saturating sums, in blocks whose totals are scanned and then added to
+// each block's local offsets, so the sums are associated in a different order than a sequential scan
+template <typename T1, typename T2>
+void blockedSaturatingScan(const std::vector<T1>& counts, std::vector<T2>& offsets, size_t block_size) {
+    SaturatingSum<T2> op;
+    size_t n = counts.size();
+    size_t n_blocks = (n + block_size - 1) / block_size;
+    offsets.assign(n, 0);
+    std::vector<T2> block_totals(n_blocks, 0);
+    for (size_t b = 0; b < n_blocks; b++) {
+        T2 sum = 0;
+        for (size_t i = b * block_size; i < std::min(n, (b + 1) * block_size); i++) {
+            offsets[i] = sum;
+            sum = op(sum, (T2)counts[i]);
+        }
+        block_totals[b] = sum;
+    }
+    T2 prefix = 0;
+    for (size_t b = 0; b < n_blocks; b++) {
+        for (size_t i = b * block_size; i < std::min(n, (b + 1) * block_size); i++) {
+            offsets[i] = op(prefix, offsets[i]);
+        }
+        prefix = op(prefix, block_totals[b]);
+    }
+}
+
+// The scan tail as contact detection fetches it: last offset + last count, summed in 64 bits
+template <typename T1, typename T2>
+uint64_t scanTail(const std::vector<T1>& counts, const std::vector<T2>& offsets) {
+    return (uint64_t)offsets.back() + (uint64_t)counts.back();
+}
+
+template <typename T1, typename T2>
+void checkScan(const std::vector<T1>& counts, const char* what) {
+    uint64_t exact_total = 0;
+    for (const auto c : counts)
+        exact_total += c;
+    std::vector<T2> offsets;
+    blockedSaturatingScan(counts, offsets, 1000);
+    uint64_t tail = scanTail(counts, offsets);
+    bool fits = ScanTotalFitsIndex<T2>(tail);
+    std::printf("%s: %zu counts, total %llu, scan tail %llu, fits a %zu-bit index: %s\n", what, counts.size(),
+                (unsigned long long)exact_total, (unsigned long long)tail, sizeof(T2) * 8, fits ? "yes" : "no");
+    // The check says yes exactly when the total is below the max (the max itself is reserved as NULL)
+    DEME_TEST_CHECK(fits == (exact_total < MaxIndexCount<T2>()));
+    if (fits) {
+        // Then nothing saturated: the tail and every offset are exact
+        DEME_TEST_CHECK(tail == exact_total);
+        uint64_t running = 0;
+        bool offsets_exact = true;
+        for (size_t i = 0; i < counts.size(); i++) {
+            offsets_exact = offsets_exact && ((uint64_t)offsets[i] == running);
+            running += counts[i];
+        }
+        DEME_TEST_CHECK(offsets_exact);
+    } else {
+        // A saturated scan sticks at the max, and never wraps around to a small value
+        DEME_TEST_CHECK(tail >= MaxIndexCount<T2>());
+        DEME_TEST_CHECK(std::is_sorted(offsets.begin(), offsets.end()));
+        std::string msg = IndexOverflowMessage<T2>(what, exact_total);
+        DEME_TEST_CHECK(msg.find(std::to_string(exact_total)) != std::string::npos);
+        DEME_TEST_CHECK((msg.find("USE_WIDE_INDICES") != std::string::npos) == !WIDE_INDICES);
+    }
+}
+
+int main() {
+    std::printf("Index width: %s\n", WIDE_INDICES ? "64-bit" : "32-bit");
+    DEME_TEST_CHECK(sizeof(contactPairs_t) == (WIDE_INDICES ? 8 : 4));
+    DEME_TEST_CHECK(sizeof(binSphereTouchPairs_t) == (WIDE_INDICES ? 8 : 4));
+
+    // The saturating sum itself
+    {
+        SaturatingSum<uint32_t> op;
+        const uint32_t max32 = 0xFFFFFFFFu;
+        DEME_TEST_CHECK(op(1u, 2u) == 3u);
+        DEME_TEST_CHECK(op(max32 - 1, 1u) == max32);
+        DEME_TEST_CHECK(op(max32 - 1, 2u) == max32);
+        DEME_TEST_CHECK(op(max32, max32) == max32);
+        // Associativity, which a parallel scan relies on
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<uint32_t> big(0, max32), small(0, 1u << 20);
+        bool assoc = true;
+        for (int i = 0; i < 100000; i++) {
+            uint32_t a = (i % 2) ? big(gen) : small(gen), b = (i % 3) ? big(gen) : small(gen),
+                     c = (i % 5) ? small(gen) : big(gen);
+            assoc = assoc && (op(op(a, b), c) == op(a, op(b, c)));
+        }
+        DEME_TEST_CHECK(assoc);
+    }
+
+    // The index count checks at the boundary
+    DEME_TEST_CHECK(IndexCountFits<uint32_t>(0xFFFFFFFFull));
+    DEME_TEST_CHECK(!IndexCountFits<uint32_t>(0x100000000ull));
+    DEME_TEST_CHECK(ScanTotalFitsIndex<uint32_t>(0xFFFFFFFEull));
+    DEME_TEST_CHECK(!ScanTotalFitsIndex<uint32_t>(0xFFFFFFFFull));
+    DEME_TEST_CHECK(IndexCountFits<contactPairs_t>(0x100000000ull) == WIDE_INDICES);
+
+    // Bin--sphere touch counts (16-bit each) whose total is past 2^32: 70000 spheres touching 65535 bins each
+    {
+        std::vector<binsSphereTouches_t> counts(70000, 65535);
+        checkScan<binsSphereTouches_t, binSphereTouchPairs_t>(counts, "bin--sphere touch pairs");
+    }
+    // Per-bin contact counts past 2^32 in total, with the overflow happening partway through a block
+    {
+        std::vector<binContactPairs_t> counts(5000);
+        std::mt19937 gen(7);
+        std::uniform_int_distribution<binContactPairs_t> dist(0, 2000000);
+        for (auto& c : counts)
+            c = dist(gen);
+        checkScan<binContactPairs_t, contactPairs_t>(counts, "sphere--sphere contacts");
+    }
+    // Totals just below and right at the 32-bit limit
+    {
+        std::vector<binContactPairs_t> counts(2, 0x7FFFFFFFu);
+        checkScan<binContactPairs_t, contactPairs_t>(counts, "contacts just below the limit");
+        counts.push_back(1);
+        checkScan<binContactPairs_t, contactPairs_t>(counts, "contacts at the limit");
+    }
+    // A small case, which always fits
+    {
+        std::vector<binContactPairs_t> counts = {3, 0, 5, 1, 0, 0, 9};
+        checkScan<binContactPairs_t, contactPairs_t>(counts, "a few contacts");
+    }
+
+    return DEMTestResult("DEMtest_IndexWidth");
+}
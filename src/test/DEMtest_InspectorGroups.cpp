@@ -0,0 +1,290 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The code an inspector group generates (InspectorGroups.hpp), run on the host.
+// The program is built twice: built with DEME_TEST_GENERATE_INSPECTOR_GROUP, it
+// writes the group's generated code (member quantities of spheres and of
+// owners, reduction identities and combine) to the directory it is given; the
+// test proper includes that code in the places the fused kernels have it, and
+// runs it on synthetic owners (clumps, meshes, analytical) and spheres. Each
+// member's result, from the fused reduction with the generated combine and from
+// the host path of the fused reduction, must match an individual reduction of
+// that quantity over the entities in its region and of its owner types.
+// =============================================================================
+
+#include <unordered_map>
+#include <core/utils/GpuError.h>
+#include <DEM/utils/InspectorGroups.hpp>
+#include <kernel/DEMHelperKernels.cuh>
+#include "DEMtestHelpers.hpp"
+
+#include <fstream>
+#include <random>
+
+using namespace deme;
+
+// The group's members, made from inspection and region code as DEMInspectorGroup::generateMembers makes them. The
+// quantities are those of the solver's inspectors (clump_max_z and co.), written to quantity[] the same way.
+struct TestMember {
+    bool ofSpheres;
+    ownerType_t ownerTypes;
+    CUB_REDUCE_FLAVOR flavor;
+    std::string inspectionCode;
+    std::string regionCode;
+};
+
+const std::vector<TestMember> TEST_MEMBERS = {
+    {true, 0, CUB_REDUCE_FLAVOR::MAX, "quantity[sphereID] = Z + myRadius;", ""},
+    {true, 0, CUB_REDUCE_FLAVOR::MIN, "quantity[sphereID] = Z - myRadius;", "return (X > 0.f);"},
+    {true, 0, CUB_REDUCE_FLAVOR::SUM, "quantity[sphereID] = myRadius;", "return (X * X + Y * Y < 4.f);"},
+    {true, 0, CUB_REDUCE_FLAVOR::MAX,
+     "float3 relPos = myRelPos;\n"
+     "float3 rotVel, linVel;\n"
+     "linVel.x = granData->vX[myOwner]; linVel.y = granData->vY[myOwner]; linVel.z = granData->vZ[myOwner];\n"
+     "rotVel.x = granData->omgBarX[myOwner]; rotVel.y = granData->omgBarY[myOwner];\n"
+     "rotVel.z = granData->omgBarZ[myOwner];\n"
+     "float3 pRotVel = cross(rotVel, relPos);\n"
+     "applyOriQToVector3<float, deme::oriQ_t>(pRotVel.x, pRotVel.y, pRotVel.z, oriQw, oriQx, oriQy, oriQz);\n"
+     "quantity[sphereID] = length(pRotVel + linVel);",
+     "return (Z > -1.f);"},
+    {false, OWNER_T_CLUMP, CUB_REDUCE_FLAVOR::SUM, "quantity[myOwner] = myMass;", "return (Z < 1.f);"},
+    {false, OWNER_T_CLUMP | OWNER_T_MESH | OWNER_T_ANALYTICAL, CUB_REDUCE_FLAVOR::MAX,
+     "double myVX = granData->vX[myOwner];\n"
+     "double myVY = granData->vY[myOwner];\n"
+     "double myVZ = granData->vZ[myOwner];\n"
+     "quantity[myOwner] = sqrt(myVX * myVX + myVY * myVY + myVZ * myVZ);",
+     ""},
+    {false, OWNER_T_CLUMP, CUB_REDUCE_FLAVOR::SUM,
+     "double myVX = granData->vX[myOwner];\n"
+     "double myVY = granData->vY[myOwner];\n"
+     "double myVZ = granData->vZ[myOwner];\n"
+     "double myKE = 0.5 * myMass * (myVX * myVX + myVY * myVY + myVZ * myVZ);\n"
+     "myVX = granData->omgBarX[myOwner];\n"
+     "myVY = granData->omgBarY[myOwner];\n"
+     "myVZ = granData->omgBarZ[myOwner];\n"
+     "myKE += 0.5 * ((double)myMOI.x * myVX * myVX + (double)myMOI.y * myVY * myVY +\n"
+     "               (double)myMOI.z * myVZ * myVZ);\n"
+     "quantity[myOwner] = myKE;",
+     "return (X + Y > 0.f);"},
+    {false, OWNER_T_MESH | OWNER_T_ANALYTICAL, CUB_REDUCE_FLAVOR::MIN, "quantity[myOwner] = Z;", ""},
+};
+
+std::vector<InspectorGroupMember> makeMembers() {
+    std::vector<InspectorGroupMember> members;
+    for (const auto& m : TEST_MEMBERS) {
+        InspectorGroupMember gen;
+        gen.ofSpheres = m.ofSpheres;
+        gen.ownerTypes = m.ownerTypes;
+        gen.flavor = m.flavor;
+        gen.quantityCode = InspectorGroupQuantityCode(m.inspectionCode, m.ofSpheres ? "sphereID" : "myOwner");
+        if (!m.regionCode.empty())
+            gen.regionCode = InspectorGroupRegionCode(m.regionCode);
+        members.push_back(gen);
+    }
+    return members;
+}
+
+#ifdef DEME_TEST_GENERATE_INSPECTOR_GROUP
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::printf("Usage: %s <output directory>\n", argv[0]);
+        return 1;
+    }
+    const std::vector<InspectorGroupMember> members = makeMembers();
+    const std::string dir(argv[1]);
+    std::ofstream(dir + "/InspectorGroupSphereQuantities.inc") << GenerateInspectorGroupQuantities(members, true);
+    std::ofstream(dir + "/InspectorGroupOwnerQuantities.inc") << GenerateInspectorGroupQuantities(members, false);
+    std::ofstream(dir + "/InspectorGroupIdentities.inc") << GenerateInspectorGroupIdentities(members) << "\n";
+    std::ofstream(dir + "/InspectorGroupCombine.inc") << GenerateInspectorGroupCombine(members);
+    return 0;
+}
+
+#else
+
+// The owner and sphere states the quantity codes read, named as in DEMDataDT
+struct TestGranData {
+    std::vector<float> vX, vY, vZ, omgBarX, omgBarY, omgBarZ;
+};
+
+struct TestSystem {
+    TestGranData data;
+    std::vector<ownerType_t> ownerTypes;
+    std::vector<double3> ownerPos;
+    std::vector<float4> ownerOriQ;
+    std::vector<float> ownerMass;
+    std::vector<float3> ownerMOI;
+    std::vector<bodyID_t> ownerClumpBody;
+    std::vector<float3> relPos;
+    std::vector<float> radii;
+};
+
+TestSystem makeSystem(size_t n_owners) {
+    TestSystem sys;
+    std::mt19937 gen(41);
+    std::uniform_real_distribution<float> coord(-3.f, 3.f), vel(-2.f, 2.f), unit(0.f, 1.f);
+    for (size_t i = 0; i < n_owners; i++) {
+        sys.ownerTypes.push_back((i % 10 == 3) ? OWNER_T_MESH : ((i % 15 == 7) ? OWNER_T_ANALYTICAL : OWNER_T_CLUMP));
+        sys.ownerPos.push_back(make_double3(coord(gen), coord(gen), coord(gen)));
+        float4 q = make_float4(coord(gen), coord(gen), coord(gen), coord(gen));
+        const float qn = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        sys.ownerOriQ.push_back(make_float4(q.x / qn, q.y / qn, q.z / qn, q.w / qn));
+        sys.ownerMass.push_back(0.5f + unit(gen));
+        sys.ownerMOI.push_back(make_float3(0.1f + unit(gen), 0.1f + unit(gen), 0.1f + unit(gen)));
+        sys.data.vX.push_back(vel(gen));
+        sys.data.vY.push_back(vel(gen));
+        sys.data.vZ.push_back(vel(gen));
+        sys.data.omgBarX.push_back(vel(gen));
+        sys.data.omgBarY.push_back(vel(gen));
+        sys.data.omgBarZ.push_back(vel(gen));
+        if (sys.ownerTypes[i] != OWNER_T_CLUMP)
+            continue;
+        for (int s = 0; s < 3; s++) {
+            sys.ownerClumpBody.push_back((bodyID_t)i);
+            sys.relPos.push_back(make_float3(0.2f * coord(gen), 0.2f * coord(gen), 0.2f * coord(gen)));
+            sys.radii.push_back(0.05f + 0.2f * unit(gen));
+        }
+    }
+    return sys;
+}
+
+// What the fused sphere kernel does for a sphere: its position, then the group's generated sphere quantities
+void evalSphereGroup(const TestSystem& sys, size_t sphereID, float* groupVals) {
+    const TestGranData* granData = &sys.data;
+    const bodyID_t myOwner = sys.ownerClumpBody[sphereID];
+    float3 myRelPos = sys.relPos[sphereID];
+    const float myRadius = sys.radii[sphereID];
+    const float oriQw = sys.ownerOriQ[myOwner].w, oriQx = sys.ownerOriQ[myOwner].x, oriQy = sys.ownerOriQ[myOwner].y,
+                oriQz = sys.ownerOriQ[myOwner].z;
+    applyOriQToVector3<float, oriQ_t>(myRelPos.x, myRelPos.y, myRelPos.z, oriQw, oriQx, oriQy, oriQz);
+    const float X = sys.ownerPos[myOwner].x + myRelPos.x;
+    const float Y = sys.ownerPos[myOwner].y + myRelPos.y;
+    const float Z = sys.ownerPos[myOwner].z + myRelPos.z;
+    (void)granData, (void)myRadius, (void)X, (void)Y, (void)Z;
+    {
+    #include "InspectorGroupSphereQuantities.inc"
+    }
+}
+
+// And what the fused owner kernel does for an owner
+void evalOwnerGroup(const TestSystem& sys, size_t myOwner, float* groupVals) {
+    const TestGranData* granData = &sys.data;
+    const ownerType_t myType = sys.ownerTypes[myOwner];
+    const float myMass = sys.ownerMass[myOwner];
+    const float3 myMOI = sys.ownerMOI[myOwner];
+    const float X = sys.ownerPos[myOwner].x, Y = sys.ownerPos[myOwner].y, Z = sys.ownerPos[myOwner].z;
+    (void)granData, (void)myType, (void)myMass, (void)myMOI, (void)X, (void)Y, (void)Z;
+    {
+    #include "InspectorGroupOwnerQuantities.inc"
+    }
+}
+
+const float GROUP_IDENTITIES[] = {
+    #include "InspectorGroupIdentities.inc"
+};
+
+void combineGroupVals(float* a, const float* b) {
+    #include "InspectorGroupCombine.inc"
+}
+
+// The fused kernels' reduction with the generated identities and combine: blocks of entities into rows of partials
+// (the sphere rows, then the owner rows), then the rows into the results
+template <typename EvalFunc>
+void reduceIntoRows(size_t n, EvalFunc eval, std::vector<float>& rows) {
+    const size_t nQ = TEST_MEMBERS.size();
+    std::vector<float> row(nQ), vals(nQ);
+    for (size_t start = 0; start < n; start += INSPECTOR_GROUP_THREADS_PER_BLOCK) {
+        std::copy(GROUP_IDENTITIES, GROUP_IDENTITIES + nQ, row.begin());
+        for (size_t i = start; i < std::min(start + INSPECTOR_GROUP_THREADS_PER_BLOCK, n); i++) {
+            std::copy(GROUP_IDENTITIES, GROUP_IDENTITIES + nQ, vals.begin());
+            eval(i, vals.data());
+            combineGroupVals(row.data(), vals.data());
+        }
+        rows.insert(rows.end(), row.begin(), row.end());
+    }
+}
+
+// The individual reduction of each member, written out directly
+std::vector<float> individualReductions(const TestSystem& sys) {
+    const size_t nOwners = sys.ownerTypes.size(), nSpheres = sys.radii.size();
+    std::vector<float> res;
+    for (const auto& m : TEST_MEMBERS)
+        res.push_back(InspectorReduceIdentity(m.flavor));
+    auto fold = [&](size_t k, bool in_region, float val) {
+        if (in_region)
+            res[k] = InspectorReduceCombine(TEST_MEMBERS[k].flavor, res[k], val);
+    };
+    for (size_t i = 0; i < nSpheres; i++) {
+        const bodyID_t o = sys.ownerClumpBody[i];
+        const float4 q = sys.ownerOriQ[o];
+        float3 p = sys.relPos[i];
+        applyOriQToVector3<float, oriQ_t>(p.x, p.y, p.z, q.w, q.x, q.y, q.z);
+        const float X = sys.ownerPos[o].x + p.x, Y = sys.ownerPos[o].y + p.y, Z = sys.ownerPos[o].z + p.z;
+        const float r = sys.radii[i];
+        fold(0, true, Z + r);
+        fold(1, X > 0.f, Z - r);
+        fold(2, X * X + Y * Y < 4.f, r);
+        float3 w = cross(make_float3(sys.data.omgBarX[o], sys.data.omgBarY[o], sys.data.omgBarZ[o]), p);
+        applyOriQToVector3<float, oriQ_t>(w.x, w.y, w.z, q.w, q.x, q.y, q.z);
+        fold(3, Z > -1.f, length(w + make_float3(sys.data.vX[o], sys.data.vY[o], sys.data.vZ[o])));
+    }
+    for (size_t o = 0; o < nOwners; o++) {
+        const bool isClump = sys.ownerTypes[o] == OWNER_T_CLUMP;
+        const float X = sys.ownerPos[o].x, Y = sys.ownerPos[o].y, Z = sys.ownerPos[o].z;
+        const double vx = sys.data.vX[o], vy = sys.data.vY[o], vz = sys.data.vZ[o];
+        const double wx = sys.data.omgBarX[o], wy = sys.data.omgBarY[o], wz = sys.data.omgBarZ[o];
+        const float3 moi = sys.ownerMOI[o];
+        fold(4, isClump && Z < 1.f, sys.ownerMass[o]);
+        fold(5, true, std::sqrt(vx * vx + vy * vy + vz * vz));
+        fold(6, isClump && X + Y > 0.f,
+             0.5 * sys.ownerMass[o] * (vx * vx + vy * vy + vz * vz) +
+                 0.5 * (moi.x * wx * wx + moi.y * wy * wy + moi.z * wz * wz));
+        fold(7, !isClump, Z);
+    }
+    return res;
+}
+
+int main() {
+    const std::vector<InspectorGroupMember> members = makeMembers();
+    const size_t nQ = members.size();
+    DEME_TEST_CHECK(sizeof(GROUP_IDENTITIES) / sizeof(float) == nQ);
+
+    const TestSystem sys = makeSystem(700);
+    const size_t nOwners = sys.ownerTypes.size(), nSpheres = sys.radii.size();
+    auto evalSphere = [&](size_t i, float* vals) { evalSphereGroup(sys, i, vals); };
+    auto evalOwner = [&](size_t i, float* vals) { evalOwnerGroup(sys, i, vals); };
+
+    // The fused reduction as the kernels run it
+    std::vector<float> rows;
+    reduceIntoRows(nSpheres, evalSphere, rows);
+    reduceIntoRows(nOwners, evalOwner, rows);
+    const size_t nRows = rows.size() / nQ;
+    DEME_TEST_CHECK(nRows == InspectorGroupNumRows(nSpheres) + InspectorGroupNumRows(nOwners) && nRows > 2);
+    std::vector<float> fused(GROUP_IDENTITIES, GROUP_IDENTITIES + nQ);
+    for (size_t r = 0; r < nRows; r++)
+        combineGroupVals(fused.data(), rows.data() + r * nQ);
+
+    // Its host path, and the individual reductions
+    const std::vector<float> hostPath = FusedInspectorReduce(members, nSpheres, evalSphere, nOwners, evalOwner);
+    const std::vector<float> individual = individualReductions(sys);
+
+    for (size_t k = 0; k < nQ; k++) {
+        std::printf("Member %zu: fused %.7g, host path %.7g, individual %.7g\n", k, fused[k], hostPath[k],
+                    individual[k]);
+        // No member is left at its identity: every one has entities in its region
+        DEME_TEST_CHECK(individual[k] != InspectorReduceIdentity(members[k].flavor));
+        if (members[k].flavor == CUB_REDUCE_FLAVOR::SUM) {
+            DEME_TEST_CHECK_CLOSE(fused[k], individual[k], 1e-5);
+            DEME_TEST_CHECK_CLOSE(hostPath[k], individual[k], 1e-5);
+        } else {
+            DEME_TEST_CHECK(fused[k] == individual[k] && hostPath[k] == individual[k]);
+        }
+    }
+
+    return DEMTestResult("DEMtest_InspectorGroups");
+}
+
+#endif
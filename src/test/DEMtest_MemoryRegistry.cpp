@@ -0,0 +1,168 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The memory registry (MemoryRegistry.hpp). Arrays bound to named records must
+// be counted in their record, category and the total, with the peak of a
+// rollup being that of the sum, not the sum of the records' peaks. A record
+// whose array is freed keeps its peak. Growths are logged in order in a
+// timeline of bounded length, and the report lists the records by peak. Updates
+// from several threads at once must add up.
+// =============================================================================
+
+#include <core/utils/MemoryRegistry.hpp>
+#include "DEMtestHelpers.hpp"
+
+// The registry is standalone: it must not pull in the solver's structs, which need the solver libraries to link
+#ifdef DEME_HOST_STRUCTS
+    #error "MemoryRegistry.hpp must not include DEM/Structs.h"
+#endif
+
+#include <sstream>
+#include <thread>
+
+using namespace deme;
+
+// An array that updates its record as its allocation changes, like DualArray does
+struct TrackedArray {
+    MemoryRecord* rec = nullptr;
+    size_t hostBytes = 0, deviceBytes = 0;
+
+    void setMemoryRecord(MemoryRecord* r) {
+        UpdateMemoryRecord(rec, MEM_SPACE::HOST, -(ssize_t)hostBytes);
+        UpdateMemoryRecord(rec, MEM_SPACE::DEVICE, -(ssize_t)deviceBytes);
+        rec = r;
+        UpdateMemoryRecord(rec, MEM_SPACE::HOST, (ssize_t)hostBytes);
+        UpdateMemoryRecord(rec, MEM_SPACE::DEVICE, (ssize_t)deviceBytes);
+    }
+    void resize(size_t host, size_t device) {
+        UpdateMemoryRecord(rec, MEM_SPACE::HOST, (ssize_t)host - (ssize_t)hostBytes);
+        UpdateMemoryRecord(rec, MEM_SPACE::DEVICE, (ssize_t)device - (ssize_t)deviceBytes);
+        hostBytes = host;
+        deviceBytes = device;
+    }
+};
+
+const MemoryRecord* findRecord(const std::vector<MemoryRecord>& recs, const std::string& name) {
+    for (const auto& rec : recs) {
+        if (rec.name == name)
+            return &rec;
+    }
+    return nullptr;
+}
+
+int main() {
+    const unsigned int H = (unsigned int)MEM_SPACE::HOST, D = (unsigned int)MEM_SPACE::DEVICE;
+
+    // Records, categories and the total, with peaks of sums
+    {
+        MemoryRegistry reg;
+        TrackedArray contactA, contactB, owner;
+        // Bound before and after they hold memory
+        contactA.resize(0, 1000);
+        DEME_REGISTER_MEMORY(&reg, "dT.", contactA, "contact");
+        DEME_REGISTER_MEMORY(&reg, "dT.", contactB, "contact");
+        DEME_REGISTER_MEMORY(&reg, "dT.", owner, "owner");
+        owner.resize(64, 500);
+        // The same name gives the same record
+        DEME_TEST_CHECK(reg.Register("dT.contactA", "contact") == contactA.rec);
+        DEME_TEST_CHECK(reg.GetRecords().size() == 3);
+
+        // contactA shrinks while contactB grows: the category peak is the largest sum, not the sum of the peaks
+        contactA.resize(0, 200);
+        contactB.resize(0, 900);
+        contactB.resize(0, 100);
+        const auto cats = reg.GetCategoryRollups();
+        std::printf("Contact category: %zu device bytes, peak %zu; owner: %zu host, %zu device bytes\n",
+                    cats.at("contact").bytes[D], cats.at("contact").peakBytes[D], cats.at("owner").bytes[H],
+                    cats.at("owner").bytes[D]);
+        DEME_TEST_CHECK(cats.at("contact").bytes[D] == 300);
+        DEME_TEST_CHECK(cats.at("contact").peakBytes[D] == 1100);
+        DEME_TEST_CHECK(cats.at("contact").peakBytes[H] == 0);
+        DEME_TEST_CHECK(cats.at("owner").bytes[H] == 64 && cats.at("owner").bytes[D] == 500);
+        const MemoryRollup total = reg.GetTotal();
+        DEME_TEST_CHECK(total.bytes[D] == 800 && total.bytes[H] == 64);
+        DEME_TEST_CHECK(total.peakBytes[D] == 1600);
+
+        // A freed array keeps its peak and growth count
+        contactB.resize(0, 0);
+        const auto recs = reg.GetRecords();
+        const MemoryRecord* b = findRecord(recs, "dT.contactB");
+        DEME_TEST_CHECK(b && b->bytes[D] == 0 && b->peakBytes[D] == 900 && b->numGrowths == 1);
+        const MemoryRecord* a = findRecord(recs, "dT.contactA");
+        DEME_TEST_CHECK(a && a->peakBytes[D] == 1000 && a->numGrowths == 1);
+        // Records come in registration order
+        DEME_TEST_CHECK(recs[0].name == "dT.contactA" && recs[2].name == "dT.owner");
+
+        // Unbinding takes the array's bytes out of the record (and rollups), and binding it again puts them back
+        owner.setMemoryRecord(nullptr);
+        DEME_TEST_CHECK(reg.GetTotal().bytes[D] == 200);
+        owner.setMemoryRecord(reg.Register("dT.owner", "owner"));
+        DEME_TEST_CHECK(reg.GetTotal().bytes[D] == 700);
+    }
+
+    // The timeline logs growths in order, with the totals after them, and drops the oldest beyond its capacity
+    {
+        MemoryRegistry reg;
+        TrackedArray pool;
+        DEME_REGISTER_MEMORY(&reg, "", pool, "scratch");
+        reg.SetNote(pool.rec, "contactMapping");
+        pool.resize(0, 100);
+        reg.SetNote(pool.rec, "newWildcards");
+        pool.resize(0, 50);
+        pool.resize(0, 300);
+        auto timeline = reg.GetTimeline();
+        DEME_TEST_CHECK(timeline.size() == 2);
+        DEME_TEST_CHECK(timeline[0].seq == 0 && timeline[0].note == "contactMapping" && timeline[0].newBytes == 100);
+        DEME_TEST_CHECK(timeline[1].seq == 1 && timeline[1].note == "newWildcards" && timeline[1].oldBytes == 50);
+        DEME_TEST_CHECK(timeline[1].totalBytes == 300 && timeline[1].time >= timeline[0].time);
+
+        reg.SetTimelineCapacity(3);
+        for (size_t k = 1; k <= 10; k++)
+            pool.resize(k * 1000, 0);
+        timeline = reg.GetTimeline();
+        DEME_TEST_CHECK(timeline.size() == 3);
+        DEME_TEST_CHECK(timeline.front().seq == 9 && timeline.back().seq == 11);
+        DEME_TEST_CHECK(timeline.back().space == MEM_SPACE::HOST && timeline.back().newBytes == 10000);
+
+        // The report lists the records by peak, leaves out those with none, and counts the dropped events
+        TrackedArray small, unused;
+        DEME_REGISTER_MEMORY(&reg, "", small, "geometry");
+        DEME_REGISTER_MEMORY(&reg, "", unused, "geometry");
+        small.resize(0, 10);
+        std::stringstream ss;
+        reg.WriteReport(ss);
+        const std::string report = ss.str();
+        const size_t pool_at = report.find("\"name\": \"pool\""), small_at = report.find("\"name\": \"small\"");
+        DEME_TEST_CHECK(pool_at != std::string::npos && small_at != std::string::npos && pool_at < small_at);
+        DEME_TEST_CHECK(report.find("\"name\": \"unused\"") == std::string::npos);
+        DEME_TEST_CHECK(report.find("\"dropped_events\": 10") != std::string::npos);
+    }
+
+    // Updates from several threads add up
+    {
+        MemoryRegistry reg;
+        const unsigned int n_threads = 4, n_updates = 20000;
+        std::vector<TrackedArray> arrays(n_threads);
+        for (unsigned int t = 0; t < n_threads; t++)
+            arrays[t].setMemoryRecord(reg.Register("thread" + std::to_string(t), "scratch"));
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < n_threads; t++) {
+            threads.emplace_back([&arrays, t, n_updates]() {
+                for (unsigned int k = 1; k <= n_updates; k++)
+                    arrays[t].resize(0, (k % 2) ? 2 * k : k);
+            });
+        }
+        for (auto& th : threads)
+            th.join();
+        const MemoryRollup total = reg.GetTotal();
+        std::printf("%u threads updating at once: %zu device bytes in total, expected %zu\n", n_threads,
+                    total.bytes[D], (size_t)n_threads * n_updates);
+        DEME_TEST_CHECK(total.bytes[D] == (size_t)n_threads * n_updates);
+        DEME_TEST_CHECK(reg.GetCategoryRollups().at("scratch").bytes[D] == total.bytes[D]);
+    }
+
+    return DEMTestResult("DEMtest_MemoryRegistry");
+}
@@ -0,0 +1,210 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Incremental mesh output (MeshFrameIO.hpp). A run of frames of a fixed
+// container, a rigid wheel that only moves, and a deformable mesh that has one
+// block of nodes changed at a time must decode, frame by frame, to exactly the
+// poses, local nodes and faces that were written, and the global geometry the
+// reader rebuilds must be that of the meshes as written. A frame where nothing
+// changes must cost 1 byte per mesh, a moved wheel one pose, and a changed node
+// block that block only. Frames decoded earlier must keep their nodes. Reading
+// may start at a key frame, but not at a frame that is not one, and a change in
+// a mesh's node count must force a key frame.
+// =============================================================================
+
+#include <unordered_map>
+#include <core/utils/GpuError.h>
+#include <kernel/DEMHelperKernels.cuh>
+#include <DEM/utils/MeshFrameIO.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <random>
+#include <sstream>
+
+using namespace deme;
+
+template <typename F>
+bool throws(F&& f) {
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Bytes of a frame's header (magic, version, flags, time, frame index and number of meshes), with its length word
+const size_t frameHeaderBytes = sizeof(uint64_t) + 4 + 2 * sizeof(uint16_t) + sizeof(double) + 2 * sizeof(uint64_t);
+const size_t poseBytes = sizeof(float3) + sizeof(float4);
+
+template <typename T>
+bool sameBits(const T& a, const T& b) {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+template <typename T>
+bool sameBits(const std::vector<T>& a, const std::vector<T>& b) {
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+// A strip of triangles over n_nodes nodes, bent randomly out of plane
+std::shared_ptr<DEMMeshConnected> makeStrip(bodyID_t owner, size_t n_nodes, std::mt19937& gen) {
+    std::uniform_real_distribution<float> bend(-0.1f, 0.1f);
+    auto mesh = std::make_shared<DEMMeshConnected>();
+    mesh->owner = owner;
+    for (size_t i = 0; i < n_nodes; i++)
+        mesh->m_vertices.push_back(make_float3(0.5f * (float)(i / 2), (float)(i % 2), bend(gen)));
+    for (int i = 0; i + 2 < (int)n_nodes; i++)
+        mesh->m_face_v_indices.push_back(make_int3(i, i + 1, i + 2));
+    mesh->nTri = mesh->m_face_v_indices.size();
+    return mesh;
+}
+
+// What was written in one frame
+struct WrittenFrame {
+    std::vector<float3> pos;
+    std::vector<float4> oriQ;
+    std::vector<notStupidBool_t> skip;
+    std::vector<std::vector<float3>> nodes;
+};
+
+std::string encodeToString(MeshFrameEncoder& encoder,
+                           double time,
+                           const std::vector<std::shared_ptr<DEMMeshConnected>>& meshes,
+                           const WrittenFrame& w) {
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    encoder.Encode(time, meshes, w.pos, w.oriQ, w.skip, ss);
+    return ss.str();
+}
+
+int main() {
+    std::mt19937 gen(28);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    // A container, a wheel and a deformable sheet of 200 nodes (3 full node blocks and a partial one)
+    std::vector<std::shared_ptr<DEMMeshConnected>> meshes = {makeStrip(10, 40, gen), makeStrip(11, 30, gen),
+                                                             makeStrip(12, 200, gen)};
+    const size_t nMeshes = meshes.size();
+    const size_t sheetBlockBytes = 1 + 1 + MESH_FRAME_NODE_BLOCK * sizeof(float3);
+
+    WrittenFrame w;
+    w.pos = {make_float3(0, 0, 0), make_float3(1, 2, 3), make_float3(-1, 0, 0.5f)};
+    w.oriQ = {make_float4(0, 0, 0, 1), make_float4(0, 0, 0, 1), make_float4(0, 0, 0, 1)};
+    w.skip = {0, 0, 0};
+
+    MeshFrameEncoder encoder;
+    std::vector<WrittenFrame> written;
+    std::vector<std::string> bytes;
+    auto writeFrame = [&]() {
+        w.nodes.clear();
+        for (const auto& mesh : meshes)
+            w.nodes.push_back(mesh->m_vertices);
+        bytes.push_back(encodeToString(encoder, 0.1 * written.size(), meshes, w));
+        written.push_back(w);
+    };
+
+    // 0: key frame
+    writeFrame();
+    // 1: nothing changes
+    writeFrame();
+    // 2: the wheel rolls, and only its pose is written
+    w.pos[1].x += 0.25f;
+    w.oriQ[1] = make_float4(0, std::sin(0.1f), 0, std::cos(0.1f));
+    writeFrame();
+    // 3: one node of the sheet's second block moves, so that block alone is written
+    meshes[2]->m_vertices[100].z += 0.01f;
+    writeFrame();
+    // 4: the last, partial block changes, and the wheel moves on
+    meshes[2]->m_vertices[199] = make_float3(unit(gen), unit(gen), unit(gen));
+    w.pos[1].x += 0.25f;
+    writeFrame();
+    // 5: the container is not output, and the first block of the sheet changes at several nodes
+    w.skip[0] = 1;
+    for (size_t i = 0; i < 64; i += 7)
+        meshes[2]->m_vertices[i].y += 0.001f * (float)i;
+    writeFrame();
+
+    // Sizes: unchanged meshes cost their state byte alone
+    DEME_TEST_CHECK(bytes[1].size() == frameHeaderBytes + nMeshes);
+    DEME_TEST_CHECK(bytes[2].size() == frameHeaderBytes + nMeshes + poseBytes);
+    DEME_TEST_CHECK(bytes[3].size() == frameHeaderBytes + nMeshes + sheetBlockBytes);
+    DEME_TEST_CHECK(bytes[4].size() == frameHeaderBytes + nMeshes + poseBytes + 2 + 8 * sizeof(float3));
+    DEME_TEST_CHECK(bytes[5].size() == frameHeaderBytes + nMeshes + sheetBlockBytes);
+    std::printf("Frame bytes: key %zu, unchanged %zu, wheel pose %zu, node block %zu\n", bytes[0].size(),
+                bytes[1].size(), bytes[2].size(), bytes[3].size());
+
+    // Decode the run, and rebuild the full geometry of every frame
+    std::stringstream all(std::ios::in | std::ios::out | std::ios::binary);
+    for (const auto& b : bytes)
+        all << b;
+    MeshFrameDecoder decoder;
+    std::vector<MeshFrame> frames;
+    MeshFrame frame;
+    while (decoder.Decode(all, frame))
+        frames.push_back(frame);
+    DEME_TEST_CHECK(frames.size() == written.size());
+    bool exact = true, geometry_exact = true;
+    for (size_t f = 0; f < frames.size() && f < written.size(); f++) {
+        const MeshFrame& fr = frames[f];
+        const WrittenFrame& wr = written[f];
+        exact = exact && fr.frameIndex == f && fr.time == 0.1 * f && fr.GetNumMeshes() == nMeshes;
+        for (size_t i = 0; i < nMeshes && exact; i++) {
+            exact = exact && fr.owners[i] == meshes[i]->owner && fr.skipped[i] == wr.skip[i] &&
+                    sameBits(fr.pos[i], wr.pos[i]) && sameBits(fr.oriQ[i], wr.oriQ[i]) &&
+                    sameBits(*(fr.nodes[i]), wr.nodes[i]) && sameBits(*(fr.faces[i]), meshes[i]->m_face_v_indices);
+            std::vector<float3> global = wr.nodes[i];
+            for (auto& pnt : global)
+                applyFrameTransformLocalToGlobal<float3, float3, float4>(pnt, wr.pos[i], wr.oriQ[i]);
+            geometry_exact = geometry_exact && sameBits(fr.GetGlobalNodes(i), global);
+        }
+    }
+    DEME_TEST_CHECK(exact && geometry_exact);
+    // Only the frames where a mesh changed have new nodes for it; the others share them
+    DEME_TEST_CHECK(frames[0].nodes[2] == frames[2].nodes[2] && frames[2].nodes[2] != frames[3].nodes[2]);
+    DEME_TEST_CHECK(frames[0].nodes[0] == frames[5].nodes[0] && frames[0].faces[2] == frames[5].faces[2]);
+    DEME_TEST_CHECK(frames[0].nodes[2]->at(100).z != frames[3].nodes[2]->at(100).z);
+    // The skipped container is left out of the VTK output
+    std::stringstream vtk;
+    frames[5].WriteAsVtk(vtk);
+    DEME_TEST_CHECK(vtk.str().find("POINTS 230 float") != std::string::npos);
+
+    // Reading from the middle of a run needs a key frame to start from
+    MeshFrameEncoder keyed;
+    keyed.SetKeyframeInterval(3);
+    std::vector<std::string> keyed_bytes;
+    std::vector<std::vector<float3>> wheel_nodes;
+    for (size_t f = 0; f < 5; f++) {
+        meshes[1]->m_vertices[f].x += 0.1f;
+        wheel_nodes.push_back(meshes[1]->m_vertices);
+        keyed_bytes.push_back(encodeToString(keyed, 0.1 * f, meshes, w));
+    }
+    auto decodeFrame = [&](MeshFrameDecoder& decoder, size_t f, MeshFrame& frame) {
+        decoder.DecodeBuffer(keyed_bytes[f].data() + sizeof(uint64_t), keyed_bytes[f].size() - sizeof(uint64_t),
+                             frame);
+    };
+    // Frames 0 and 3 are key frames
+    MeshFrameDecoder late;
+    MeshFrame from_key;
+    decodeFrame(late, 3, from_key);
+    DEME_TEST_CHECK(from_key.frameIndex == 3 && sameBits(*(from_key.nodes[1]), wheel_nodes[3]));
+    decodeFrame(late, 4, from_key);
+    DEME_TEST_CHECK(from_key.frameIndex == 4 && sameBits(*(from_key.nodes[1]), wheel_nodes[4]));
+    MeshFrameDecoder too_late;
+    DEME_TEST_CHECK(throws([&]() { decodeFrame(too_late, 4, from_key); }));
+    MeshFrameDecoder skipping;
+    decodeFrame(skipping, 0, from_key);
+    DEME_TEST_CHECK(throws([&]() { decodeFrame(skipping, 2, from_key); }));
+
+    // A mesh that gains nodes cannot be coded against the last frame
+    meshes[2]->m_vertices.push_back(make_float3(0, 0, 0));
+    const std::string grown = encodeToString(encoder, 1., meshes, w);
+    auto frameFlags = [](const std::string& b) {
+        uint16_t flags;
+        std::memcpy(&flags, b.data() + sizeof(uint64_t) + 4 + sizeof(uint16_t), sizeof(uint16_t));
+        return flags;
+    };
+    DEME_TEST_CHECK((frameFlags(grown) & MESH_FRAME_KEY) && !(frameFlags(bytes[5]) & MESH_FRAME_KEY));
+
+    return DEMTestResult("DEMtest_MeshFrameIO");
+}
@@ -0,0 +1,154 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Local-frame facet grids of rigid meshes (MeshLocalGrid.hpp). Spheres of mixed
+// sizes are scattered around a few meshes (a wavy terrain, a closed box and a
+// soup of random facets of mixed sizes), and the sphere--facet pair lists found
+// through the grid are compared with the brute-force ones, for the automatic
+// cell size and a few fixed ones. The lists must be identical, which also means
+// no pair is reported twice through the grid.
+// =============================================================================
+
+#include <unordered_map>
+#include <core/utils/GpuError.h>
+#include <DEM/utils/MeshLocalGrid.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <random>
+#include <vector>
+
+using namespace deme;
+
+struct TestMesh {
+    const char* name;
+    std::vector<float3> n1, n2, n3;
+    void Add(const float3& a, const float3& b, const float3& c) {
+        n1.push_back(a);
+        n2.push_back(b);
+        n3.push_back(c);
+    }
+};
+
+// A height field z = 0.2 sin(x) cos(y) over [0, 6]^2, two facets per grid square
+TestMesh makeTerrain(int n) {
+    TestMesh m;
+    m.name = "terrain";
+    auto h = [](float x, float y) { return 0.2f * std::sin(x) * std::cos(y); };
+    const float d = 6.f / n;
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            float x0 = i * d, y0 = j * d, x1 = x0 + d, y1 = y0 + d;
+            float3 a = make_float3(x0, y0, h(x0, y0)), b = make_float3(x1, y0, h(x1, y0));
+            float3 c = make_float3(x1, y1, h(x1, y1)), e = make_float3(x0, y1, h(x0, y1));
+            m.Add(a, b, c);
+            m.Add(a, c, e);
+        }
+    }
+    return m;
+}
+
+// A closed box of size 2 x 1 x 0.5, centered at the origin, with 12 facets
+TestMesh makeBox() {
+    TestMesh m;
+    m.name = "box";
+    float3 v[8];
+    for (int i = 0; i < 8; i++)
+        v[i] = make_float3((i & 1) ? 1.f : -1.f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.25f : -0.25f);
+    const int quads[6][4] = {{0, 1, 3, 2}, {4, 6, 7, 5}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 2, 6, 4}, {1, 5, 7, 3}};
+    for (const auto& q : quads) {
+        m.Add(v[q[0]], v[q[1]], v[q[2]]);
+        m.Add(v[q[0]], v[q[2]], v[q[3]]);
+    }
+    return m;
+}
+
+// Random facets, mostly small but a few large ones spanning many cells
+TestMesh makeSoup(int n, std::mt19937& gen) {
+    TestMesh m;
+    m.name = "facet soup";
+    std::uniform_real_distribution<float> pos(-2.f, 2.f), unit(-1.f, 1.f);
+    for (int i = 0; i < n; i++) {
+        float size = (i % 20 == 0) ? 1.5f : 0.15f;
+        float3 c = make_float3(pos(gen), pos(gen), pos(gen));
+        float3 a, b, e;
+        // Avoid slivers, which Build rejects as degenerate
+        do {
+            a = c + size * make_float3(unit(gen), unit(gen), unit(gen));
+            b = c + size * make_float3(unit(gen), unit(gen), unit(gen));
+            e = c + size * make_float3(unit(gen), unit(gen), unit(gen));
+        } while (!(meshFacetMiterFactor(a, b, e) < 20.f));
+        m.Add(a, b, e);
+    }
+    return m;
+}
+
+void checkMesh(const TestMesh& m, std::mt19937& gen) {
+    // Use facet IDs that are not 0-based and not contiguous, as in a simulation with many meshes
+    const size_t nTri = m.n1.size();
+    const size_t idOffset = 7;
+    std::vector<float3> n1(idOffset + 2 * nTri), n2(n1.size()), n3(n1.size());
+    std::vector<bodyID_t> triIDs;
+    for (size_t i = 0; i < nTri; i++) {
+        bodyID_t id = (bodyID_t)(idOffset + 2 * i);
+        n1[id] = m.n1[i];
+        n2[id] = m.n2[i];
+        n3[id] = m.n3[i];
+        triIDs.push_back(id);
+    }
+    // Spheres of mixed sizes in and around the mesh's bounding box, including some far from it
+    float3 lo = make_float3(1e30f, 1e30f, 1e30f), hi = -lo;
+    for (size_t i = 0; i < nTri; i++) {
+        lo = fminf(lo, fminf(fminf(m.n1[i], m.n2[i]), m.n3[i]));
+        hi = fmaxf(hi, fmaxf(fmaxf(m.n1[i], m.n2[i]), m.n3[i]));
+    }
+    std::uniform_real_distribution<float> ux(lo.x - 0.5f, hi.x + 0.5f), uy(lo.y - 0.5f, hi.y + 0.5f),
+        uz(lo.z - 0.5f, hi.z + 0.5f), small_r(0.01f, 0.08f), big_r(0.3f, 1.2f);
+    std::vector<float3> sphPos;
+    std::vector<float> sphRad;
+    for (int i = 0; i < 4000; i++) {
+        sphPos.push_back(make_float3(ux(gen), uy(gen), uz(gen)));
+        sphRad.push_back((i % 50 == 0) ? big_r(gen) : small_r(gen));
+    }
+    sphPos.push_back(hi + make_float3(10.f, 10.f, 10.f));
+    sphRad.push_back(0.1f);
+    const float pad = 0.01f;
+
+    const auto brute = hostMeshSphereCandidatePairs(sphPos, sphRad, pad, triIDs, n1.data(), n2.data(), n3.data());
+    DEME_TEST_CHECK(!brute.empty());
+    const float cell_sizes[] = {0.f, 0.05f, 0.37f, 3.f, 100.f};
+    for (const float cs : cell_sizes) {
+        MeshLocalGrid grid;
+        bool built = grid.Build(triIDs, n1.data(), n2.data(), n3.data(), cs);
+        DEME_TEST_CHECK(built);
+        if (!built)
+            continue;
+        const auto viaGrid =
+            hostMeshSphereCandidatePairs(sphPos, sphRad, pad, triIDs, n1.data(), n2.data(), n3.data(), &grid);
+        std::printf("%s: %zu facets, %zu cells (cell size %g), %zu pairs by brute force, %zu through the grid\n",
+                    m.name, nTri, grid.NumCells(), cs, brute.size(), viaGrid.size());
+        DEME_TEST_CHECK(viaGrid == brute);
+        // Every facet is listed in at least one cell
+        size_t nListed = grid.GetCellStart().back();
+        DEME_TEST_CHECK(nListed >= nTri);
+        DEME_TEST_CHECK(grid.GetTriIDs() == triIDs);
+    }
+}
+
+int main() {
+    std::mt19937 gen(2024);
+    checkMesh(makeTerrain(24), gen);
+    checkMesh(makeBox(), gen);
+    checkMesh(makeSoup(600, gen), gen);
+
+    // A degenerate facet (collinear nodes) leaves the mesh to the world-frame binning
+    {
+        std::vector<float3> n1 = {make_float3(0, 0, 0)}, n2 = {make_float3(1, 0, 0)}, n3 = {make_float3(2, 0, 0)};
+        MeshLocalGrid grid;
+        DEME_TEST_CHECK(!grid.Build({0}, n1.data(), n2.data(), n3.data()));
+    }
+
+    return DEMTestResult("DEMtest_MeshLocalGrid");
+}
@@ -0,0 +1,122 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The host reference of multi-rate integration (MultiRateReference.hpp), which
+// DEMdemo_MultiRate compares the solver against. With every contact fast, a
+// sub-stepped step must be exactly the same as that many fine steps; with
+// every contact slow, it must match one coarse step. A chain of soft spheres
+// with a few stiff ones must conserve energy about as well when only the stiff
+// contacts are sub-stepped as with the fine step for all, and much better than
+// with the coarse step. Stiffness overrides equal to the default stiffnesses
+// must not change anything.
+// =============================================================================
+
+#include <DEM/utils/MultiRateReference.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <random>
+
+using namespace deme;
+
+const double RAD = 0.01, MASS = 0.01, SOFT_K = 1e6, STIFF_K = 1e8;
+const int NUM_SPHERES = 20;
+
+// The chain of DEMdemo_MultiRate's energy check; fast_all makes every sphere (and wall contact) fast, slow_all none
+MultiRateChain makeChain(bool fast_all = false, bool slow_all = false) {
+    MultiRateChain chain(0., 2. * RAD * NUM_SPHERES * 1.05);
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> vel(-1., 1.);
+    for (int i = 0; i < NUM_SPHERES; i++) {
+        bool stiff = (i == 5 || i == 14);
+        chain.AddSphere(MASS, RAD, stiff ? STIFF_K : SOFT_K, RAD * 1.05 * (2 * i + 1), vel(gen),
+                        fast_all || (stiff && !slow_all));
+    }
+    chain.SetWallContactsFast(!slow_all);
+    return chain;
+}
+
+// Max relative energy error over a duration
+double maxEnergyError(MultiRateChain chain, double H, unsigned int n_sub, double duration) {
+    const double E0 = chain.Energy();
+    double max_err = 0.;
+    for (long i = 0; i < (long)(duration / H); i++) {
+        chain.Step(H, n_sub);
+        max_err = std::max(max_err, std::abs(chain.Energy() / E0 - 1.));
+    }
+    return max_err;
+}
+
+bool sameState(const MultiRateChain& a, const MultiRateChain& b, double tol) {
+    for (size_t j = 0; j < a.GetNumSpheres(); j++) {
+        if (std::abs(a.GetPos(j) - b.GetPos(j)) > tol * RAD || std::abs(a.GetVel(j) - b.GetVel(j)) > tol)
+            return false;
+    }
+    return true;
+}
+
+int main() {
+    const double H = 1e-5;
+    const unsigned int n_sub = 10;
+    const long n_steps = 20000;
+
+    // Every contact fast: sub-stepping is the fine step, to the bit
+    {
+        MultiRateChain multi = makeChain(true), fine = makeChain(true);
+        for (long i = 0; i < n_steps; i++) {
+            multi.Step(H, n_sub);
+            for (unsigned int k = 0; k < n_sub; k++)
+                fine.Step(H / n_sub, 1);
+        }
+        std::printf("All contacts fast: %ld sub-stepped steps %s %ld fine steps\n", n_steps,
+                    sameState(multi, fine, 0.) ? "match" : "do NOT match", n_steps * n_sub);
+        DEME_TEST_CHECK(sameState(multi, fine, 0.));
+    }
+
+    // Every contact slow: the sub-steps only split the drift of one coarse step, so it is that step up to round-off
+    {
+        MultiRateChain multi = makeChain(false, true), coarse = makeChain(false, true);
+        for (long i = 0; i < 1000; i++) {
+            multi.Step(H, n_sub);
+            coarse.Step(H, 1);
+        }
+        std::printf("All contacts slow: sub-stepped steps %s coarse steps\n",
+                    sameState(multi, coarse, 1e-9) ? "match" : "do NOT match");
+        DEME_TEST_CHECK(sameState(multi, coarse, 1e-9));
+    }
+
+    // Energy conservation with the stiff contacts sub-stepped, as DEMdemo_MultiRate checks it
+    {
+        const double duration = 1.;
+        const double err_fine = maxEnergyError(makeChain(), H / n_sub, 1, duration);
+        const double err_coarse = maxEnergyError(makeChain(), H, 1, duration);
+        const double err_multi = maxEnergyError(makeChain(), H, n_sub, duration);
+        // And over twice the duration, the error of the multi-rate run does not drift away
+        const double err_multi_long = maxEnergyError(makeChain(), H, n_sub, 2. * duration);
+        std::printf("Max |dE|/E0: fine step %.3g, coarse step %.3g, multi-rate %.3g (%.3g over twice as long)\n",
+                    err_fine, err_coarse, err_multi, err_multi_long);
+        DEME_TEST_CHECK(err_multi <= 0.5 * err_coarse);
+        DEME_TEST_CHECK(err_multi <= 5. * err_fine);
+        DEME_TEST_CHECK(err_multi_long <= 2. * err_multi);
+    }
+
+    // Overrides equal to the default stiffnesses change nothing
+    {
+        MultiRateChain plain = makeChain(), overridden = makeChain();
+        for (int j = 0; j + 1 < NUM_SPHERES; j++) {
+            bool stiff = (j == 4 || j == 5 || j == 13 || j == 14);
+            overridden.SetPairStiffness(j, stiff ? STIFF_K : SOFT_K);
+        }
+        overridden.SetWallStiffness(SOFT_K);
+        for (long i = 0; i < n_steps; i++) {
+            plain.Step(H, n_sub);
+            overridden.Step(H, n_sub);
+        }
+        DEME_TEST_CHECK(sameState(plain, overridden, 0.));
+        DEME_TEST_CHECK(plain.Energy() == overridden.Energy());
+    }
+
+    return DEMTestResult("DEMtest_MultiRateReference");
+}
@@ -0,0 +1,247 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Output filters (OutputFilters.hpp), on the host. Each region (box, oriented
+// box, sphere, cylinder) must take the points just inside its boundary and not
+// those just outside, and several regions must combine as their union. Family
+// inclusion must pass a contact if either owner is included, exclusion must
+// drop it if either owner is excluded. Stride must pick exactly the IDs of its
+// residue; hash sampling must pick about its fraction, the same IDs at every
+// call, a subset of the IDs a larger fraction picks, and other IDs with another
+// seed. Clauses must combine with AND, bad settings must throw, and the indices
+// parallelSelectIndices returns must not depend on the thread count.
+// =============================================================================
+
+#include <unordered_map>
+#include <core/utils/GpuError.h>
+#include <DEM/utils/OutputFilters.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <random>
+
+using namespace deme;
+
+template <typename F>
+bool throws(F&& f) {
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+OutputFilterSample sampleAt(const float3& pos, size_t ID = 0, unsigned int family = 0, unsigned int family2 = 0) {
+    OutputFilterSample s;
+    s.pos = pos;
+    s.vel = make_float3(0, 0, 0);
+    s.force = 0.f;
+    s.family = family;
+    s.family2 = family2;
+    s.ID = ID;
+    return s;
+}
+
+bool passes(const OutputFilter& filter, const float3& pos) {
+    return filter.Test(sampleAt(pos));
+}
+
+int main() {
+    const float eps = 1e-3f;
+
+    // Axis-aligned box [-1, 3] x [0, 2] x [-2, -1]
+    {
+        OutputFilter filter;
+        filter.AddBox(make_float3(-1, 0, -2), make_float3(3, 2, -1));
+        DEME_TEST_CHECK(filter.IsActive() && filter.NeedsPosition() && !filter.NeedsVelocity());
+        DEME_TEST_CHECK(passes(filter, make_float3(1, 1, -1.5f)));
+        DEME_TEST_CHECK(passes(filter, make_float3(-1 + eps, 2 - eps, -2 + eps)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(-1 - eps, 1, -1.5f)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(1, 2 + eps, -1.5f)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(1, 1, -1 + eps)));
+        DEME_TEST_CHECK(throws([]() { OutputFilter().AddBox(make_float3(0, 0, 1), make_float3(1, 1, 0)); }));
+    }
+
+    // A box of half-sizes (2, 1, 0.5) turned 90 degrees about z, so its long side is along global y
+    {
+        OutputFilter filter;
+        const float s = std::sqrt(0.5f);
+        // The quaternion need not be normalized
+        filter.AddOrientedBox(make_float3(1, 1, 1), make_float3(2, 1, 0.5f), make_float4(0, 0, 2 * s, 2 * s));
+        DEME_TEST_CHECK(passes(filter, make_float3(1, 1 + 2 - eps, 1)));
+        DEME_TEST_CHECK(passes(filter, make_float3(1 - 1 + eps, 1, 1 + 0.5f - eps)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(1 + 2 - eps, 1, 1)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(1 + 1 + eps, 1, 1)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(1, 1, 1 - 0.5f - eps)));
+        // Turned 45 degrees about z instead: the corner of the unturned box falls out, a point on the long axis is in
+        OutputFilter turned;
+        const float c = std::cos(float(PI) / 8), sn = std::sin(float(PI) / 8);
+        turned.AddOrientedBox(make_float3(0, 0, 0), make_float3(2, 1, 0.5f), make_float4(0, 0, sn, c));
+        DEME_TEST_CHECK(!passes(turned, make_float3(1.9f, -0.9f, 0)));
+        DEME_TEST_CHECK(passes(turned, make_float3(1.9f * s, 1.9f * s, 0)));
+        DEME_TEST_CHECK(!passes(turned, make_float3(2.1f * s, 2.1f * s, 0)));
+    }
+
+    // A sphere of radius 2 at (1, -1, 0)
+    {
+        OutputFilter filter;
+        filter.AddSphere(make_float3(1, -1, 0), 2.f);
+        DEME_TEST_CHECK(passes(filter, make_float3(1, -1, 0)));
+        DEME_TEST_CHECK(passes(filter, make_float3(1, -1, 2 - eps)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(1, -1, 2 + eps)));
+        // Inside the bounding box, outside the sphere
+        DEME_TEST_CHECK(!passes(filter, make_float3(2.5f, 0.5f, 0)));
+        DEME_TEST_CHECK(passes(filter, make_float3(2.4f, 0.4f, 0)));
+    }
+
+    // A cylinder of radius 0.5 with its axis from (0, 0, 0) to (2, 2, 0)
+    {
+        OutputFilter filter;
+        filter.AddCylinder(make_float3(0, 0, 0), make_float3(2, 2, 0), 0.5f);
+        const float s = std::sqrt(0.5f);
+        DEME_TEST_CHECK(passes(filter, make_float3(1, 1, 0)));
+        // Just inside and outside the curved side, from the axis' middle
+        DEME_TEST_CHECK(passes(filter, make_float3(1, 1, 0.5f - eps)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(1, 1, 0.5f + eps)));
+        DEME_TEST_CHECK(passes(filter, make_float3(1 - (0.5f - eps) * s, 1 + (0.5f - eps) * s, 0)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(1 - (0.5f + eps) * s, 1 + (0.5f + eps) * s, 0)));
+        // Just inside and outside the end caps
+        DEME_TEST_CHECK(passes(filter, make_float3(eps, eps, 0.2f)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(-eps, -eps, 0.2f)));
+        DEME_TEST_CHECK(passes(filter, make_float3(2 - eps, 2 - eps, 0)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(2 + eps, 2 + eps, 0)));
+        DEME_TEST_CHECK(throws([]() { OutputFilter().AddCylinder(make_float3(1, 1, 1), make_float3(1, 1, 1), 1.f); }));
+    }
+
+    // Several regions: the union
+    {
+        OutputFilter filter;
+        filter.AddSphere(make_float3(0, 0, 0), 1.f).AddBox(make_float3(5, 5, 5), make_float3(6, 6, 6));
+        DEME_TEST_CHECK(passes(filter, make_float3(0.5f, 0, 0)) && passes(filter, make_float3(5.5f, 5.5f, 5.5f)));
+        DEME_TEST_CHECK(!passes(filter, make_float3(3, 3, 3)));
+        filter.Clear();
+        DEME_TEST_CHECK(!filter.IsActive() && passes(filter, make_float3(3, 3, 3)));
+    }
+
+    // Families: a contact (family, family2) passes inclusion if either is included, and fails exclusion if either is
+    // excluded
+    {
+        const float3 o = make_float3(0, 0, 0);
+        OutputFilter inc;
+        inc.IncludeFamilies({1, 3});
+        DEME_TEST_CHECK(inc.Test(sampleAt(o, 0, 1, 1)) && inc.Test(sampleAt(o, 0, 3, 3)));
+        DEME_TEST_CHECK(!inc.Test(sampleAt(o, 0, 2, 2)));
+        DEME_TEST_CHECK(inc.Test(sampleAt(o, 0, 2, 3)) && inc.Test(sampleAt(o, 0, 1, 5)));
+        OutputFilter exc;
+        exc.ExcludeFamilies({2});
+        DEME_TEST_CHECK(exc.Test(sampleAt(o, 0, 1, 1)) && !exc.Test(sampleAt(o, 0, 2, 2)));
+        DEME_TEST_CHECK(!exc.Test(sampleAt(o, 0, 1, 2)) && !exc.Test(sampleAt(o, 0, 2, 1)));
+        // Both: included, but not if the other owner is excluded
+        OutputFilter both;
+        both.IncludeFamilies({1}).ExcludeFamilies({2});
+        DEME_TEST_CHECK(both.Test(sampleAt(o, 0, 1, 3)) && !both.Test(sampleAt(o, 0, 1, 2)));
+        DEME_TEST_CHECK(!both.Test(sampleAt(o, 0, 3, 3)));
+    }
+
+    // Velocity and force ranges, and clauses combining with AND
+    {
+        OutputFilter filter;
+        filter.SetVelocityRange(1.f, 2.f).SetForceRange(10.f).AddSphere(make_float3(0, 0, 0), 1.f);
+        DEME_TEST_CHECK(filter.NeedsVelocity() && filter.NeedsForce());
+        OutputFilterSample s = sampleAt(make_float3(0, 0, 0));
+        s.vel = make_float3(0, 1.5f, 0);
+        s.force = 20.f;
+        DEME_TEST_CHECK(filter.Test(s));
+        s.vel = make_float3(0, 2.5f, 0);
+        DEME_TEST_CHECK(!filter.Test(s));
+        s.vel = make_float3(0, 1.5f, 0);
+        s.force = 5.f;
+        DEME_TEST_CHECK(!filter.Test(s));
+        s.force = 20.f;
+        s.pos = make_float3(0, 0, 1.5f);
+        DEME_TEST_CHECK(!filter.Test(s));
+    }
+
+    // Stride and hash sampling over many IDs
+    {
+        const size_t n = 100000;
+        const float3 o = make_float3(0, 0, 0);
+        OutputFilter stride;
+        stride.SetStride(7, 10);
+        bool exact = true;
+        size_t n_stride = 0;
+        for (size_t ID = 0; ID < n; ID++) {
+            const bool p = stride.Test(sampleAt(o, ID));
+            exact = exact && p == (ID % 7 == 3);
+            n_stride += p;
+        }
+        DEME_TEST_CHECK(exact && n_stride == (n + 3) / 7);
+        DEME_TEST_CHECK(throws([]() { OutputFilter().SetStride(0); }));
+
+        OutputFilter tenth, half, tenth_again, other_seed;
+        tenth.SetHashSampling(0.1f, 5);
+        half.SetHashSampling(0.5f, 5);
+        tenth_again.SetHashSampling(0.1f, 5);
+        other_seed.SetHashSampling(0.1f, 6);
+        size_t n_tenth = 0, n_half = 0, n_both_seeds = 0;
+        bool same = true, nested = true;
+        // Consecutive IDs must not come in runs
+        size_t longest_run = 0, run = 0;
+        for (size_t ID = 0; ID < n; ID++) {
+            const bool p = tenth.Test(sampleAt(o, ID));
+            const bool q = half.Test(sampleAt(o, ID));
+            n_tenth += p;
+            n_half += q;
+            same = same && p == tenth_again.Test(sampleAt(o, ID));
+            nested = nested && (!p || q);
+            n_both_seeds += p && other_seed.Test(sampleAt(o, ID));
+            run = p ? run + 1 : 0;
+            longest_run = std::max(longest_run, run);
+        }
+        std::printf("Hash sampling of %zu IDs: %zu at 0.1, %zu at 0.5, %zu at 0.1 with both seeds, longest run %zu\n",
+                    n, n_tenth, n_half, n_both_seeds, longest_run);
+        DEME_TEST_CHECK(same && nested);
+        DEME_TEST_CHECK(std::abs((double)n_tenth - 0.1 * n) < 0.01 * n);
+        DEME_TEST_CHECK(std::abs((double)n_half - 0.5 * n) < 0.01 * n);
+        // Another seed picks (about) an independent tenth: about a tenth of a tenth in common
+        DEME_TEST_CHECK(std::abs((double)n_both_seeds - 0.01 * n) < 0.003 * n);
+        DEME_TEST_CHECK(longest_run < 10);
+
+        OutputFilter none, all;
+        none.SetHashSampling(0.f);
+        all.SetHashSampling(1.f);
+        bool none_pass = false, all_pass = true;
+        for (size_t ID = 0; ID < 1000; ID++) {
+            none_pass = none_pass || none.Test(sampleAt(o, ID));
+            all_pass = all_pass && all.Test(sampleAt(o, ID));
+        }
+        DEME_TEST_CHECK(!none_pass && all_pass && !all.IsActive());
+        DEME_TEST_CHECK(throws([]() { OutputFilter().SetHashSampling(1.5f); }));
+        DEME_TEST_CHECK(throws([]() { OutputFilter().SetHashSampling(-0.1f); }));
+    }
+
+    // The selected indices, ascending, on 1 and several threads
+    {
+        std::mt19937 gen(27);
+        std::uniform_real_distribution<float> coord(-2.f, 2.f);
+        std::vector<OutputFilterSample> samples(50000);
+        for (size_t i = 0; i < samples.size(); i++)
+            samples[i] = sampleAt(make_float3(coord(gen), coord(gen), coord(gen)), i, i % 4, i % 4);
+        OutputFilter filter;
+        filter.AddSphere(make_float3(0, 0, 0), 1.5f).ExcludeFamilies({2}).SetHashSampling(0.7f);
+        auto pred = [&](size_t i) { return filter.Test(samples[i]); };
+        const std::vector<size_t> sel1 = parallelSelectIndices(samples.size(), pred, 1);
+        const std::vector<size_t> sel4 = parallelSelectIndices(samples.size(), pred, 4);
+        std::vector<size_t> serial;
+        for (size_t i = 0; i < samples.size(); i++) {
+            if (pred(i))
+                serial.push_back(i);
+        }
+        DEME_TEST_CHECK(!serial.empty() && sel1 == serial && sel4 == serial);
+    }
+
+    return DEMTestResult("DEMtest_OutputFilters");
+}
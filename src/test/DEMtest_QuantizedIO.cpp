@@ -0,0 +1,282 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The quantized position format (QuantizedIO.hpp). Varints and zigzag must
+// round-trip every value, edge values included, in the expected number of
+// bytes, and a varint that ends early or runs too long must throw. A run of
+// frames, delta-coded with a key frame forced every few frames, must decode to
+// exactly the voxel IDs, sub-voxel positions, owner IDs, quaternions and
+// families that were written: entities that stay put, creep within a voxel,
+// cross voxel boundaries (both ways) and jump across the domain, at the edges
+// of the sub-voxel range. Static entities must make a delta frame small, a
+// changed owner list must force a key frame, and a delta frame decoded without
+// the frame it is coded against must throw.
+// =============================================================================
+
+#include <unordered_map>
+#include <core/utils/GpuError.h>
+#include <kernel/DEMHelperKernels.cuh>
+#include <DEM/utils/QuantizedIO.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <limits>
+#include <random>
+#include <sstream>
+
+using namespace deme;
+
+template <typename F>
+bool throws(F&& f) {
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// The grid of the frames: 2^10 x 2^10 x 2^12 voxels
+const uint8_t nvXp2 = 10, nvYp2 = 10, nvZp2 = 12;
+
+// Entity positions as one integer coordinate per axis (voxel index, then sub-voxel position), put together into the
+// solver's representation independently of the format's own helpers
+struct AxisCoords {
+    uint64_t c[3];
+};
+
+void setEntity(QuantizedFrame& frame, size_t i, const AxisCoords& a) {
+    const uint64_t sub_mask = ((uint64_t)1 << VOXEL_RES_POWER2) - 1;
+    frame.subX[i] = (subVoxelPos_t)(a.c[0] & sub_mask);
+    frame.subY[i] = (subVoxelPos_t)(a.c[1] & sub_mask);
+    frame.subZ[i] = (subVoxelPos_t)(a.c[2] & sub_mask);
+    frame.voxel[i] = (voxelID_t)(a.c[0] >> VOXEL_RES_POWER2) | ((voxelID_t)(a.c[1] >> VOXEL_RES_POWER2) << nvXp2) |
+                     ((voxelID_t)(a.c[2] >> VOXEL_RES_POWER2) << (nvXp2 + nvYp2));
+}
+
+bool sameFrame(const QuantizedFrame& f1, const QuantizedFrame& f2) {
+    bool same = f1.Size() == f2.Size() && f1.ownerIDs == f2.ownerIDs && f1.voxel == f2.voxel && f1.subX == f2.subX &&
+                f1.subY == f2.subY && f1.subZ == f2.subZ && f1.family == f2.family &&
+                f1.oriQ.size() == f2.oriQ.size();
+    // Quaternions bit for bit
+    same = same &&
+           (f1.oriQ.empty() || std::memcmp(f1.oriQ.data(), f2.oriQ.data(), f1.oriQ.size() * sizeof(float4)) == 0);
+    const QuantizedFrameHeader &h1 = f1.header, &h2 = f2.header;
+    return same && h1.flags == h2.flags && h1.nvXp2 == h2.nvXp2 && h1.nvYp2 == h2.nvYp2 && h1.nvZp2 == h2.nvZp2 &&
+           h1.subVoxelPower == h2.subVoxelPower && h1.voxelSize == h2.voxelSize && h1.l == h2.l &&
+           h1.LBFX == h2.LBFX && h1.LBFY == h2.LBFY && h1.LBFZ == h2.LBFZ && h1.time == h2.time &&
+           h1.frameIndex == h2.frameIndex && h1.refFrameIndex == h2.refFrameIndex;
+}
+
+std::string encodeToString(QuantizedFrameEncoder& encoder, QuantizedFrame& frame) {
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    encoder.Encode(frame, ss);
+    return ss.str();
+}
+
+int main() {
+    // Varints: every edge value comes back, in 7 bits per byte
+    {
+        const uint64_t values[] = {0,
+                                   1,
+                                   0x7F,
+                                   0x80,
+                                   0x3FFF,
+                                   0x4000,
+                                   0xFFFFFFFFull,
+                                   (uint64_t)1 << 56,
+                                   (uint64_t)1 << 63,
+                                   std::numeric_limits<uint64_t>::max()};
+        const size_t lengths[] = {1, 1, 1, 2, 2, 3, 5, 9, 10, 10};
+        std::string buf;
+        for (unsigned int k = 0; k < 10; k++) {
+            const size_t before = buf.size();
+            quantPutVarint(buf, values[k]);
+            DEME_TEST_CHECK(buf.size() - before == lengths[k]);
+        }
+        const char* ptr = buf.data();
+        const char* end = buf.data() + buf.size();
+        bool all_back = true;
+        for (const uint64_t v : values)
+            all_back = all_back && quantGetVarint(ptr, end) == v;
+        DEME_TEST_CHECK(all_back && ptr == end);
+
+        // One that ends early, and one longer than any 64-bit number
+        const std::string cut("\xFF\xFF", 2), overlong(11, '\x80');
+        DEME_TEST_CHECK(throws([&]() {
+            const char* p = cut.data();
+            quantGetVarint(p, cut.data() + cut.size());
+        }));
+        DEME_TEST_CHECK(throws([&]() {
+            const char* p = overlong.data();
+            quantGetVarint(p, overlong.data() + overlong.size());
+        }));
+    }
+
+    // Zigzag: small numbers of either sign stay small, and the extremes come back
+    {
+        DEME_TEST_CHECK(quantZigzag(0) == 0 && quantZigzag(-1) == 1 && quantZigzag(1) == 2 && quantZigzag(-2) == 3);
+        DEME_TEST_CHECK(quantZigzag(-64) == 127 && quantZigzag(64) == 128);
+        const int64_t values[] = {0,
+                                  1,
+                                  -1,
+                                  63,
+                                  -64,
+                                  (int64_t)1 << 40,
+                                  -((int64_t)1 << 40),
+                                  std::numeric_limits<int64_t>::max(),
+                                  std::numeric_limits<int64_t>::min()};
+        bool all_back = true;
+        for (const int64_t v : values)
+            all_back = all_back && quantUnzigzag(quantZigzag(v)) == v;
+        DEME_TEST_CHECK(all_back);
+        DEME_TEST_CHECK(quantZigzag(std::numeric_limits<int64_t>::min()) == std::numeric_limits<uint64_t>::max());
+    }
+
+    // A run of frames, delta-coded with a key frame every 4
+    {
+        const size_t n = 2000;
+        const uint64_t max_coord[3] = {((uint64_t)1 << (nvXp2 + VOXEL_RES_POWER2)) - 1,
+                                       ((uint64_t)1 << (nvYp2 + VOXEL_RES_POWER2)) - 1,
+                                       ((uint64_t)1 << (nvZp2 + VOXEL_RES_POWER2)) - 1};
+        const uint64_t sub_max = ((uint64_t)1 << VOXEL_RES_POWER2) - 1;
+        std::mt19937 gen(26);
+        std::uniform_real_distribution<double> unit(0., 1.);
+        std::uniform_int_distribution<int> creep(-50, 50), kind(0, 4);
+        std::uniform_int_distribution<unsigned int> fam(0, 255);
+
+        QuantizedFrame frame;
+        frame.header.flags = QUANT_HAS_QUAT | QUANT_HAS_FAMILY;
+        frame.header.nvXp2 = nvXp2;
+        frame.header.nvYp2 = nvYp2;
+        frame.header.nvZp2 = nvZp2;
+        frame.header.l = 1e-7;
+        frame.header.voxelSize = frame.header.l * (double)((uint64_t)1 << VOXEL_RES_POWER2);
+        frame.header.LBFX = -3.25;
+        frame.header.LBFY = 0.5;
+        frame.header.LBFZ = -1e-3;
+        frame.Resize(n);
+        // Owner IDs with gaps, and some out of order
+        for (size_t i = 0; i < n; i++)
+            frame.ownerIDs[i] = (bodyID_t)(3 * i + ((i % 7 == 0) ? 5 : 0));
+        std::vector<AxisCoords> coords(n);
+        for (size_t i = 0; i < n; i++) {
+            for (unsigned int d = 0; d < 3; d++)
+                coords[i].c[d] = (uint64_t)(unit(gen) * (double)max_coord[d]);
+            frame.oriQ[i] = make_float4((float)unit(gen), (float)unit(gen), (float)unit(gen), (float)unit(gen));
+            frame.family[i] = (family_t)fam(gen);
+        }
+        // The corners of the domain, and the edges of a voxel's sub-voxel range
+        coords[0] = {{0, 0, 0}};
+        coords[1] = {{max_coord[0], max_coord[1], max_coord[2]}};
+        coords[2] = {{sub_max, sub_max + 1, 5 * sub_max + 4}};
+        coords[3] = {{sub_max + 1, sub_max, (sub_max + 1) * 100}};
+
+        QuantizedFrameEncoder encoder;
+        encoder.SetDeltaCoding(true, 4);
+        std::vector<QuantizedFrame> written;
+        std::vector<std::string> bytes;
+        const unsigned int n_frames = 10;
+        for (unsigned int f = 0; f < n_frames; f++) {
+            if (f > 0) {
+                for (size_t i = 4; i < n; i++) {
+                    // A fifth stays put, then a fifth each creeps, crosses a voxel boundary, jumps and turns
+                    const int k = kind(gen);
+                    for (unsigned int d = 0; d < 3; d++) {
+                        int64_t c = (int64_t)coords[i].c[d];
+                        if (k == 1)
+                            c += creep(gen);
+                        else if (k == 2)
+                            c += ((i + f + d) % 2 == 0) ? (int64_t)sub_max + 1 : -((int64_t)sub_max + 1);
+                        else if (k == 3)
+                            c = (int64_t)(unit(gen) * (double)max_coord[d]);
+                        coords[i].c[d] = (uint64_t)std::min<int64_t>(std::max<int64_t>(c, 0), (int64_t)max_coord[d]);
+                    }
+                    if (k == 4) {
+                        frame.oriQ[i].x = -frame.oriQ[i].x;
+                        frame.oriQ[i].w = std::nextafter(frame.oriQ[i].w, 2.f);
+                        frame.family[i] = (family_t)fam(gen);
+                    }
+                }
+                // Entities 2 and 3 trade places, across voxels along every axis
+                std::swap(coords[2], coords[3]);
+            }
+            for (size_t i = 0; i < n; i++)
+                setEntity(frame, i, coords[i]);
+            frame.header.time = 0.01 * f;
+            bytes.push_back(encodeToString(encoder, frame));
+            written.push_back(frame);
+        }
+
+        // Key frames at 0, 4 and 8, each delta frame coded against the frame before it
+        for (unsigned int f = 0; f < n_frames; f++) {
+            const bool delta = written[f].header.flags & QUANT_DELTA;
+            DEME_TEST_CHECK(delta == (f % 4 != 0));
+            DEME_TEST_CHECK(written[f].header.frameIndex == f &&
+                            written[f].header.refFrameIndex == (delta ? f - 1 : f));
+        }
+
+        std::stringstream all(std::ios::in | std::ios::out | std::ios::binary);
+        for (const auto& b : bytes)
+            all << b;
+        QuantizedFrameDecoder decoder;
+        QuantizedFrame back;
+        unsigned int n_decoded = 0;
+        bool all_exact = true, positions_exact = true;
+        while (decoder.Decode(all, back)) {
+            all_exact = all_exact && n_decoded < n_frames && sameFrame(back, written[n_decoded]);
+            // And the positions are the solver's own conversion of the voxel-native representation
+            for (size_t i = 0; i < n && all_exact; i++) {
+                double X, Y, Z;
+                voxelIDToPosition<double, voxelID_t, subVoxelPos_t>(
+                    X, Y, Z, written[n_decoded].voxel[i], written[n_decoded].subX[i], written[n_decoded].subY[i],
+                    written[n_decoded].subZ[i], nvXp2, nvYp2, written[n_decoded].header.voxelSize,
+                    written[n_decoded].header.l);
+                const double3 p = back.GetPosition(i);
+                positions_exact = positions_exact && p.x == X + back.header.LBFX && p.y == Y + back.header.LBFY &&
+                                  p.z == Z + back.header.LBFZ;
+            }
+            n_decoded++;
+        }
+        DEME_TEST_CHECK(all_exact && positions_exact && n_decoded == n_frames);
+        std::printf("Frame bytes: key %zu, delta %zu\n", bytes[0].size(), bytes[1].size());
+        DEME_TEST_CHECK(bytes[1].size() < bytes[0].size());
+
+        // With every entity static, a delta frame costs about a byte per coordinate and quaternion component
+        QuantizedFrameEncoder still;
+        still.SetDeltaCoding(true);
+        QuantizedFrame same = written.back();
+        encodeToString(still, same);
+        const std::string static_bytes = encodeToString(still, same);
+        DEME_TEST_CHECK(same.header.flags & QUANT_DELTA);
+        DEME_TEST_CHECK(static_bytes.size() <= n * (3 + 4 + sizeof(family_t)) + 256);
+
+        // A changed owner list cannot be coded against the last frame
+        same.ownerIDs[10]++;
+        encodeToString(still, same);
+        DEME_TEST_CHECK(!(same.header.flags & QUANT_DELTA));
+
+        // A delta frame without the frame it is coded against
+        QuantizedFrameDecoder fresh;
+        QuantizedFrame lost;
+        const std::string& delta_frame = bytes[5];
+        DEME_TEST_CHECK(throws([&]() {
+            fresh.DecodeBuffer(delta_frame.data() + sizeof(uint64_t), delta_frame.size() - sizeof(uint64_t), lost);
+        }));
+        // Nor against an older one
+        QuantizedFrameDecoder skipped;
+        skipped.DecodeBuffer(bytes[4].data() + sizeof(uint64_t), bytes[4].size() - sizeof(uint64_t), lost);
+        DEME_TEST_CHECK(throws([&]() {
+            const std::string& b = bytes[6];
+            skipped.DecodeBuffer(b.data() + sizeof(uint64_t), b.size() - sizeof(uint64_t), lost);
+        }));
+        // A frame that ends early
+        std::stringstream cut(bytes[0].substr(0, bytes[0].size() - 3), std::ios::in | std::ios::binary);
+        QuantizedFrameDecoder cut_decoder;
+        DEME_TEST_CHECK(throws([&]() { cut_decoder.Decode(cut, lost); }));
+    }
+
+    return DEMTestResult("DEMtest_QuantizedIO");
+}
@@ -0,0 +1,193 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The scratch arena (ScratchArena.hpp), on host memory. Arrays taken in a scope
+// must be given back when it closes, so a later scope reuses their memory, and
+// must be aligned. Running out of room mid-scope must add blocks without moving
+// the arrays already taken, and the blocks must be merged into one when no
+// scope is open, so the same use then allocates nothing. A block that stays
+// much larger than what is used must be shrunk only after the set number of
+// scopes in a row. Misuse (taking outside a scope, taking twice, an unknown
+// handle) must throw. The memory counter and registry record follow the blocks.
+// =============================================================================
+
+#include <core/utils/ScratchArena.hpp>
+#include "DEMtestHelpers.hpp"
+
+// The arena is standalone: it must not pull in the solver's structs, which need the solver libraries to link
+#ifdef DEME_HOST_STRUCTS
+    #error "ScratchArena.hpp must not include DEM/Structs.h"
+#endif
+
+#include <cstring>
+
+using namespace deme;
+
+// Host allocator that counts what it has out
+struct CountingAllocator {
+    static constexpr MEM_SPACE space = MEM_SPACE::HOST;
+    static size_t liveBytes;
+    static size_t numAllocs;
+    void* allocate(size_t bytes) {
+        liveBytes += bytes;
+        numAllocs++;
+        return HostScratchAllocator().allocate(bytes);
+    }
+    void deallocate(void* ptr, size_t bytes) {
+        liveBytes -= bytes;
+        HostScratchAllocator().deallocate(ptr, bytes);
+    }
+};
+size_t CountingAllocator::liveBytes = 0;
+size_t CountingAllocator::numAllocs = 0;
+
+typedef ScratchArena<CountingAllocator> Arena;
+
+template <typename F>
+bool throws(F&& f) {
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+ScratchArenaPolicy smallPolicy() {
+    ScratchArenaPolicy policy;
+    policy.minBlockBytes = 4096;
+    policy.shrinkPatience = 4;
+    return policy;
+}
+
+int main() {
+    // Handles, reuse of memory across and within scopes, and alignment
+    {
+        Arena arena;
+        const ScratchHandle a = arena.registerHandle("a"), b = arena.registerHandle("b");
+        const ScratchHandle c = arena.registerHandle("c");
+        DEME_TEST_CHECK(a == 0 && b == 1 && c == 2);
+        DEME_TEST_CHECK(arena.registerHandle("b") == b && arena.getNumHandles() == 3);
+
+        void* first = nullptr;
+        {
+            auto scope = arena.scope();
+            first = arena.allocate(a, 100);
+            DEME_TEST_CHECK(arena.get(a) == first);
+        }
+        DEME_TEST_CHECK(arena.get(a) == nullptr && arena.getStats().bytesInUse == 0);
+        {
+            auto outer = arena.scope();
+            // The next scope gets the memory of the last
+            DEME_TEST_CHECK(arena.allocate(b, 100) == first);
+            char* inInner = nullptr;
+            {
+                auto inner = arena.scope();
+                inInner = (char*)arena.allocate(a, 1000);
+                DEME_TEST_CHECK(inInner >= (char*)first + 100);
+                DEME_TEST_CHECK((uintptr_t)inInner % arena.getPolicy().alignment == 0);
+            }
+            // The inner scope's array is given back, and the outer one's is kept
+            DEME_TEST_CHECK(arena.get(a) == nullptr && arena.get(b) == first);
+            DEME_TEST_CHECK(arena.allocate(c, 10) == inInner);
+        }
+        const ScratchHandleStats& hs = arena.getHandleStats(a);
+        DEME_TEST_CHECK(hs.name == "a" && hs.numAllocs == 2 && hs.lastBytes == 1000 && hs.peakBytes == 1000);
+        DEME_TEST_CHECK(arena.getStats().numAllocs == 4 && arena.getStats().numBlockAllocs == 1);
+    }
+
+    // Misuse throws
+    {
+        Arena arena;
+        const ScratchHandle a = arena.registerHandle("a");
+        DEME_TEST_CHECK(throws([&]() { arena.allocate(a, 8); }));
+        {
+            auto scope = arena.scope();
+            arena.allocate(a, 8);
+            DEME_TEST_CHECK(throws([&]() { arena.allocate(a, 8); }));
+            DEME_TEST_CHECK(throws([&]() { arena.allocate(7, 8); }));
+        }
+        ScratchArenaPolicy policy;
+        policy.alignment = 48;
+        DEME_TEST_CHECK(throws([&]() { arena.setPolicy(policy); }));
+    }
+
+    // Out of room mid-scope: blocks are added and the arrays taken stay put; then they are merged into one
+    {
+        size_t counter = 0;
+        MemoryRegistry registry;
+        {
+            Arena arena(&counter);
+            arena.setPolicy(smallPolicy());
+            arena.setMemoryRecord(registry.Register("arena", "scratch"));
+            const ScratchHandle hs[3] = {arena.registerHandle("a"), arena.registerHandle("b"),
+                                         arena.registerHandle("c")};
+            const size_t sizes[3] = {3000, 3000, 10000};
+            for (int round = 0; round < 2; round++) {
+                auto scope = arena.scope();
+                unsigned char* ptrs[3];
+                for (int k = 0; k < 3; k++) {
+                    ptrs[k] = (unsigned char*)arena.allocate(hs[k], sizes[k]);
+                    std::memset(ptrs[k], 1 + k, sizes[k]);
+                }
+                bool intact = true;
+                for (int k = 0; k < 3; k++) {
+                    for (size_t i = 0; i < sizes[k]; i++)
+                        intact = intact && (ptrs[k][i] == 1 + k);
+                }
+                DEME_TEST_CHECK(intact);
+                if (round == 0) {
+                    std::printf("Out of room: %zu blocks, %zu bytes\n", arena.getStats().numBlocks,
+                                arena.getStats().capacity);
+                    DEME_TEST_CHECK(arena.getStats().numBlocks == 3);
+                }
+            }
+            const ScratchArenaStats& st = arena.getStats();
+            std::printf("After merging: %zu block(s), %zu bytes for a peak use of %zu; %zu block allocations\n",
+                        st.numBlocks, st.capacity, st.peakBytesInUse, st.numBlockAllocs);
+            // The second round fit in the merged block
+            DEME_TEST_CHECK(st.numMerges == 1 && st.numBlocks == 1 && st.numBlockAllocs == 4);
+            DEME_TEST_CHECK(st.capacity >= st.peakBytesInUse && st.peakBytesInUse >= 16000);
+            DEME_TEST_CHECK(counter == st.capacity && CountingAllocator::liveBytes == st.capacity);
+            DEME_TEST_CHECK(registry.GetTotal().bytes[(unsigned int)MEM_SPACE::HOST] == st.capacity);
+        }
+        // All blocks are freed with the arena
+        DEME_TEST_CHECK(counter == 0 && CountingAllocator::liveBytes == 0);
+        DEME_TEST_CHECK(registry.GetTotal().bytes[(unsigned int)MEM_SPACE::HOST] == 0);
+    }
+
+    // Shrinking: only after the block has been much too large for shrinkPatience scopes in a row
+    {
+        Arena arena;
+        arena.setPolicy(smallPolicy());
+        const ScratchHandle a = arena.registerHandle("a");
+        auto use = [&](size_t bytes) {
+            auto scope = arena.scope();
+            arena.allocate(a, bytes);
+        };
+        use(1 << 20);
+        const size_t big = arena.getStats().capacity;
+        // Sizes that go up and down do not shrink it
+        for (int k = 0; k < 10; k++) {
+            for (unsigned int s = 0; s + 1 < smallPolicy().shrinkPatience; s++)
+                use(1000);
+            use(1 << 20);
+        }
+        DEME_TEST_CHECK(arena.getStats().numShrinks == 0 && arena.getStats().capacity == big);
+        // Staying small does
+        for (unsigned int s = 0; s + 1 < smallPolicy().shrinkPatience; s++)
+            use(1000);
+        DEME_TEST_CHECK(arena.getStats().numShrinks == 0);
+        use(1000);
+        std::printf("Shrunk from %zu to %zu bytes after %u small scopes\n", big, arena.getStats().capacity,
+                    smallPolicy().shrinkPatience);
+        DEME_TEST_CHECK(arena.getStats().numShrinks == 1);
+        DEME_TEST_CHECK(arena.getStats().capacity == smallPolicy().minBlockBytes);
+        DEME_TEST_CHECK(arena.getStats().numBlocks == 1);
+    }
+
+    return DEMTestResult("DEMtest_ScratchArena");
+}
@@ -0,0 +1,293 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// Island sleeping (SleepIslands.hpp), the host versions of what dT does on the
+// device at each step (quiet records) and at each island check (candidates),
+// and the island grouping it does on the host. Piles resting on a static floor
+// must fall asleep as separate islands, named by their smallest owners, after
+// the sleep steps; a noisy owner, a noisy contact or an active owner keeps its
+// pile awake. Noise between two checks must push sleep onset back, so onset is
+// the same whatever the check interval, up to one interval. Islands of random
+// contact graphs must match a breadth-first search.
+// =============================================================================
+
+#include <DEM/utils/SleepIslands.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <queue>
+#include <random>
+
+using namespace deme;
+
+const bodyID_t AWAKE = SleepIslandManager::AWAKE_ISLAND;
+const bodyID_t STATIC = SleepIslandManager::STATIC_ISLAND;
+
+// Owners and their contacts, with the islands and quiet records the device would keep
+struct SleepWorld {
+    std::vector<float> vX, vY, vZ, omgX, omgY, omgZ, radius;
+    std::vector<SLEEP_ROLE> role;
+    std::vector<bodyID_t> pairA, pairB;
+    std::vector<bodyID_t> island;
+    std::vector<unsigned int> quiet;
+
+    bodyID_t AddOwner(SLEEP_ROLE r = SLEEP_ROLE::REGULAR) {
+        for (auto* arr : {&vX, &vY, &vZ, &omgX, &omgY, &omgZ})
+            arr->push_back(0.f);
+        radius.push_back(0.01f);
+        role.push_back(r);
+        island.push_back(AWAKE);
+        quiet.push_back(0);
+        return (bodyID_t)(role.size() - 1);
+    }
+    void AddContact(bodyID_t a, bodyID_t b) {
+        pairA.push_back(a);
+        pairB.push_back(b);
+    }
+    SleepStepInput Input() const {
+        SleepStepInput in;
+        in.nOwners = role.size();
+        in.vX = vX.data();
+        in.vY = vY.data();
+        in.vZ = vZ.data();
+        in.omgX = omgX.data();
+        in.omgY = omgY.data();
+        in.omgZ = omgZ.data();
+        in.radius = radius.data();
+        in.role = role.data();
+        in.nPairs = pairA.size();
+        in.ownerA = pairA.data();
+        in.ownerB = pairB.data();
+        return in;
+    }
+    // A step and, every interval steps, an island check; returns the owners that fell asleep
+    std::vector<bodyID_t> Step(SleepIslandManager& mgr, unsigned int interval, unsigned long step) {
+        mgr.AccumulateQuietSteps(Input(), island.data(), quiet.data());
+        if ((step + 1) % interval != 0)
+            return {};
+        auto newly_asleep = mgr.Check(Input(), island, quiet.data());
+        for (auto i : newly_asleep) {
+            vX[i] = vY[i] = vZ[i] = omgX[i] = omgY[i] = omgZ[i] = 0.f;
+        }
+        return newly_asleep;
+    }
+};
+
+// A static floor (owner 0) with two piles on it: owners 1-3 stacked, and owners 4-5
+SleepWorld twoPiles() {
+    SleepWorld w;
+    bodyID_t floor = w.AddOwner(SLEEP_ROLE::STATIC);
+    for (int i = 0; i < 5; i++)
+        w.AddOwner();
+    w.AddContact(1, floor);
+    w.AddContact(2, 1);
+    w.AddContact(3, 2);
+    w.AddContact(floor, 4);
+    w.AddContact(5, 4);
+    w.AddContact(5, floor);
+    return w;
+}
+
+SleepIslandManager makeManager(unsigned int sleep_steps) {
+    SleepIslandManager mgr;
+    mgr.SetThresholds(1e-6, 1e-4);
+    mgr.SetSleepSteps(sleep_steps);
+    return mgr;
+}
+
+// Step when owner falls asleep (or n_steps if it does not)
+unsigned long sleepOnset(SleepWorld w,
+                         unsigned int sleep_steps,
+                         unsigned int interval,
+                         unsigned long n_steps,
+                         bodyID_t owner,
+                         unsigned long noisy_step) {
+    SleepIslandManager mgr = makeManager(sleep_steps);
+    for (unsigned long s = 0; s < n_steps; s++) {
+        w.vX[owner] = (s == noisy_step) ? 1.f : 0.f;
+        w.Step(mgr, interval, s);
+        if (w.island[owner] != AWAKE)
+            return s + 1;
+    }
+    return n_steps;
+}
+
+// Islands of candidates by breadth-first search: a component of candidates linked by pairs, which sleeps unless a
+// pair links it to an owner that is not a candidate
+std::vector<bodyID_t> bfsIslands(size_t n_owners, const SleepCandidates& cand) {
+    std::vector<uint8_t> is_cand(n_owners, 0);
+    for (auto o : cand.owners)
+        is_cand[o] = 1;
+    std::vector<std::vector<bodyID_t>> adj(n_owners);
+    for (size_t k = 0; k < cand.pairA.size(); k++) {
+        adj[cand.pairA[k]].push_back(cand.pairB[k]);
+        adj[cand.pairB[k]].push_back(cand.pairA[k]);
+    }
+    std::vector<bodyID_t> island(n_owners, AWAKE);
+    std::vector<uint8_t> seen(n_owners, 0);
+    for (auto start : cand.owners) {
+        if (seen[start])
+            continue;
+        std::vector<bodyID_t> members;
+        bool blocked = false;
+        std::queue<bodyID_t> q;
+        q.push(start);
+        seen[start] = 1;
+        while (!q.empty()) {
+            bodyID_t o = q.front();
+            q.pop();
+            members.push_back(o);
+            for (auto p : adj[o]) {
+                if (!is_cand[p]) {
+                    blocked = true;
+                } else if (!seen[p]) {
+                    seen[p] = 1;
+                    q.push(p);
+                }
+            }
+        }
+        const bodyID_t name = *std::min_element(members.begin(), members.end());
+        for (auto o : members)
+            island[o] = blocked ? AWAKE : name;
+    }
+    std::vector<bodyID_t> res;
+    for (auto o : cand.owners)
+        res.push_back(island[o]);
+    return res;
+}
+
+int main() {
+    const unsigned int sleep_steps = 100;
+
+    // Two quiet piles fall asleep as two islands, named by their smallest owners, at the first check after the sleep
+    // steps; the floor is static
+    {
+        SleepWorld w = twoPiles();
+        SleepIslandManager mgr = makeManager(sleep_steps);
+        unsigned long onset = 0;
+        for (unsigned long s = 0; s < 400 && onset == 0; s++) {
+            if (!w.Step(mgr, 30, s).empty())
+                onset = s + 1;
+        }
+        std::printf("Two quiet piles: asleep after %lu steps, islands %u %u %u | %u %u\n", onset, w.island[1],
+                    w.island[2], w.island[3], w.island[4], w.island[5]);
+        DEME_TEST_CHECK(onset == 120);
+        DEME_TEST_CHECK(w.island[0] == STATIC);
+        DEME_TEST_CHECK(w.island[1] == 1 && w.island[2] == 1 && w.island[3] == 1);
+        DEME_TEST_CHECK(w.island[4] == 4 && w.island[5] == 4);
+
+        // A quiet owner that comes to rest on a sleeping pile does not join its island and stays awake (on the device,
+        // its contact wakes the pile instead)
+        bodyID_t late = w.AddOwner();
+        w.AddContact(late, 3);
+        for (unsigned long s = 0; s < 300; s++)
+            w.Step(mgr, 30, s);
+        DEME_TEST_CHECK(w.island[late] == AWAKE);
+        DEME_TEST_CHECK(w.island[1] == 1);
+    }
+
+    // A noisy owner, a noisy contact between two quiet owners, or an active owner keeps its pile awake
+    for (int which = 0; which < 3; which++) {
+        SleepWorld w = twoPiles();
+        SleepIslandManager mgr = makeManager(sleep_steps);
+        if (which == 0) {
+            w.omgZ[5] = 1.f;
+        } else if (which == 1) {
+            // Each is below the energy threshold, but they slide past each other
+            w.vX[4] = 1e-3f;
+            w.vX[5] = -1e-3f;
+        } else {
+            w.role[5] = SLEEP_ROLE::ACTIVE;
+        }
+        for (unsigned long s = 0; s < 1000; s++)
+            w.Step(mgr, 10, s);
+        const char* names[] = {"a noisy owner", "a noisy contact", "an active owner"};
+        std::printf("A pile with %s: islands %u %u %u | %u %u\n", names[which], w.island[1], w.island[2],
+                    w.island[3], w.island[4], w.island[5]);
+        DEME_TEST_CHECK(w.island[1] == 1 && w.island[3] == 1);
+        DEME_TEST_CHECK(w.island[4] == AWAKE && w.island[5] == AWAKE);
+    }
+
+    // Noise between two checks pushes sleep onset back whatever the check interval: onset is within an interval of
+    // the sleep steps after the noise
+    {
+        const unsigned long noisy_step = 95;
+        for (unsigned int interval : {1u, 7u, 50u, 100u}) {
+            unsigned long onset = sleepOnset(twoPiles(), sleep_steps, interval, 1000, 2, noisy_step);
+            std::printf("Check every %3u steps: noise at step %lu, asleep after %lu steps\n", interval, noisy_step,
+                        onset);
+            DEME_TEST_CHECK(onset >= noisy_step + 1 + sleep_steps);
+            DEME_TEST_CHECK(onset < noisy_step + 1 + sleep_steps + interval);
+        }
+    }
+
+    // The records match one kept step by step without checks, and a woken owner (the device resets its record)
+    // starts over
+    {
+        SleepWorld w = twoPiles();
+        SleepIslandManager mgr = makeManager(sleep_steps);
+        for (unsigned long s = 0; s < 150; s++)
+            w.Step(mgr, 1000, s);
+        DEME_TEST_CHECK(w.quiet[1] == sleep_steps && w.quiet[0] == 0);
+        for (unsigned long s = 0; s < 150; s++)
+            w.Step(mgr, 150, s);
+        DEME_TEST_CHECK(w.island[2] == 1);
+        for (bodyID_t i = 1; i <= 3; i++) {
+            w.island[i] = AWAKE;
+            w.quiet[i] = 0;
+        }
+        for (unsigned long s = 0; s < sleep_steps - 1; s++)
+            w.Step(mgr, 1, s);
+        DEME_TEST_CHECK(w.island[2] == AWAKE);
+        w.Step(mgr, 1, 0);
+        DEME_TEST_CHECK(w.island[2] == 1);
+    }
+
+    // Islands of random candidate graphs, given in a shuffled order as the device lists them, match a BFS
+    {
+        std::mt19937 gen(7);
+        size_t n_mismatch = 0, n_islands = 0;
+        for (int trial = 0; trial < 50; trial++) {
+            const size_t n_owners = 2000;
+            std::uniform_int_distribution<bodyID_t> pick(0, n_owners - 1);
+            std::bernoulli_distribution is_cand(0.9);
+            SleepCandidates cand;
+            std::vector<uint8_t> cand_flag(n_owners, 0);
+            for (bodyID_t o = 0; o < n_owners; o++) {
+                if (is_cand(gen)) {
+                    cand.owners.push_back(o);
+                    cand_flag[o] = 1;
+                }
+            }
+            std::shuffle(cand.owners.begin(), cand.owners.end(), gen);
+            for (int k = 0; k < 1200; k++) {
+                bodyID_t a = pick(gen), b = pick(gen);
+                if (cand_flag[a] || cand_flag[b]) {
+                    cand.pairA.push_back(a);
+                    cand.pairB.push_back(b);
+                }
+            }
+            SleepIslandManager mgr;
+            std::vector<bodyID_t> islands;
+            size_t n = mgr.FormIslands(cand, islands);
+            const auto expected = bfsIslands(n_owners, cand);
+            std::vector<bodyID_t> names;
+            for (size_t k = 0; k < islands.size(); k++) {
+                if (islands[k] != expected[k])
+                    n_mismatch++;
+                if (islands[k] != AWAKE)
+                    names.push_back(islands[k]);
+            }
+            std::sort(names.begin(), names.end());
+            DEME_TEST_CHECK(n == (size_t)(std::unique(names.begin(), names.end()) - names.begin()));
+            n_islands += n;
+        }
+        std::printf("Random graphs: %zu islands, %zu mismatches against BFS\n", n_islands, n_mismatch);
+        DEME_TEST_CHECK(n_mismatch == 0);
+        DEME_TEST_CHECK(n_islands > 0);
+    }
+
+    return DEMTestResult("DEMtest_SleepIslands");
+}
@@ -0,0 +1,184 @@
+//  Copyright (c) 2021, SBEL GPU Development Team
+//  Copyright (c) 2021, University of Wisconsin - Madison
+//
+//	SPDX-License-Identifier: BSD-3-Clause
+
+// =============================================================================
+// The variable time step controller (TimeStepController.hpp). A sphere is
+// dropped onto a rigid wall and bounces off it through a Hertzian contact,
+// advanced in spans (like DoDynamics calls) the way dT takes variable steps:
+// the step limit must resolve the collision by the requested number of steps,
+// the rebound must be elastic, and no span may end in a sliver of a step. Then
+// a sudden velocity jump must get a step rejected, and the retry accepted.
+// =============================================================================
+
+#include <DEM/utils/TimeStepController.hpp>
+#include "DEMtestHelpers.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace deme;
+
+struct HertzDrop {
+    double radius = 0.01;
+    double mass = 2500. * 4. / 3. * 3.14159265358979 * 0.01 * 0.01 * 0.01;
+    // Effective modulus of the sphere--rigid wall contact (E = 1e8, nu = 0.3)
+    double EStar = 1e8 / (1. - 0.3 * 0.3);
+    double g = 9.81;
+    // Height of the center above the wall, and the velocity
+    double z = 0.1 + 0.01;
+    double v = 0.;
+
+    double overlap() const { return std::max(radius - z, 0.); }
+    double acc() const {
+        double d = overlap();
+        return -g + 4. / 3. * EStar * std::sqrt(radius) * d * std::sqrt(d) / mass;
+    }
+    // Velocity Verlet
+    void step(double h) {
+        double v_half = v + 0.5 * h * acc();
+        z += h * v_half;
+        v = v_half + 0.5 * h * acc();
+    }
+};
+
+int main() {
+    const double steps_per_collision = 30.;
+    const double min_step = 1e-7, max_step = 1e-3;
+
+    // A Hertzian drop, advanced in spans of 1.7e-3 s until the sphere is back up near its starting height
+    {
+        HertzDrop drop;
+        TimeStepController ctrl;
+        TimeStepScales scales;
+        // The controller takes the scales of a pair of identical bodies; a sphere on a rigid wall is a pair of
+        // bodies of twice the mass and radius
+        scales.refMass = 2. * drop.mass;
+        scales.refRadius = 2. * drop.radius;
+        scales.minRadius = drop.radius;
+        scales.maxEStar = drop.EStar;
+        ctrl.SetScales(scales);
+        ctrl.SetBounds(min_step, max_step);
+        ctrl.SetStepsPerCollision(steps_per_collision);
+        ctrl.SetVelocityFloor(std::sqrt(2. * drop.g * drop.radius));
+        ctrl.Reset(1e-5);
+
+        const double span = 1.7e-3;
+        double time = 0., spans_total = 0.;
+        double impact_speed = 0., rebound_speed = 0., max_overlap = 0., max_overlap_step = 0.;
+        double min_step_used = 1e30, impact_step = 0.;
+        unsigned int contact_steps = 0, n_steps = 0;
+        bool in_contact = false, bounced = false;
+        while (!bounced || drop.v > 0.) {
+            // The span loop of dT, with the step size kept in a float like simParams->h
+            float h = 0.f;
+            for (double cycle = 0.; cycle < span; cycle += (double)h) {
+                if (cycle > 0. && span - cycle < ctrl.RemainderTolerance())
+                    break;
+                h = (float)ctrl.ProposeWithin(std::abs(drop.v), span - cycle);
+                double overlap_before = drop.overlap();
+                if (!in_contact && drop.overlap() == 0. && drop.z - drop.radius < 1e-3 && drop.v < 0.)
+                    impact_speed = std::abs(drop.v);
+                drop.step(h);
+                time += h;
+                n_steps++;
+                min_step_used = std::min(min_step_used, (double)h);
+                max_overlap_step = std::max(max_overlap_step, std::abs(drop.overlap() - overlap_before));
+                if (drop.overlap() > 0.) {
+                    if (!in_contact && !bounced)
+                        impact_step = h;
+                    in_contact = true;
+                    contact_steps++;
+                    max_overlap = std::max(max_overlap, drop.overlap());
+                } else if (in_contact) {
+                    in_contact = false;
+                    bounced = true;
+                    rebound_speed = drop.v;
+                }
+            }
+            spans_total += span;
+            if (spans_total > 1.)
+                break;
+        }
+        // Hertz theory for the impact: contact duration and max overlap
+        const double t_c =
+            2.868 * std::pow(drop.mass * drop.mass / (drop.radius * drop.EStar * drop.EStar * impact_speed), 0.2);
+        const double max_overlap_theory = std::pow(
+            15. * drop.mass * impact_speed * impact_speed / (16. * drop.EStar * std::sqrt(drop.radius)), 0.4);
+        std::printf("Drop: %u steps in %.4f s, impact at %.4f m/s, rebound at %.4f m/s\n", n_steps, time,
+                    impact_speed, rebound_speed);
+        std::printf("    %u steps in contact (%.0f requested), step at impact %.3g (t_c/%.0f = %.3g)\n", contact_steps,
+                    steps_per_collision, impact_step, steps_per_collision, t_c / steps_per_collision);
+        std::printf("    max overlap %.4g (theory %.4g), smallest step %.3g\n", max_overlap, max_overlap_theory,
+                    min_step_used);
+        DEME_TEST_CHECK(bounced);
+        DEME_TEST_CHECK_CLOSE(impact_speed, std::sqrt(2. * drop.g * 0.1), 0.01);
+        // The collision is resolved by at least the requested number of steps
+        DEME_TEST_CHECK(contact_steps >= steps_per_collision);
+        DEME_TEST_CHECK(impact_step <= t_c / steps_per_collision);
+        // ... so the bounce is elastic and the overlap is as in theory
+        DEME_TEST_CHECK(std::abs(rebound_speed - impact_speed) < 0.01 * impact_speed);
+        DEME_TEST_CHECK(std::abs(max_overlap - max_overlap_theory) < 0.02 * max_overlap_theory);
+        // The overlap limit held (1% of the radius per step by default)
+        DEME_TEST_CHECK(max_overlap_step <= 0.01 * drop.radius * 1.001);
+        // No span ended in a sliver of a step, and the spans were covered in full
+        DEME_TEST_CHECK(min_step_used >= min_step * (1. - 1e-6));
+        DEME_TEST_CHECK(std::abs(time - spans_total) < 1e-6 * spans_total);
+    }
+
+    // The remainder of a span: below the tolerance it is taken along, above it it is a step of its own
+    {
+        TimeStepController ctrl;
+        ctrl.SetBounds(min_step, max_step);
+        ctrl.SetMaxGrowth(0.);
+        ctrl.Reset(1e-5);
+        DEME_TEST_CHECK(ctrl.ProposeWithin(0., 1e-5 + 0.5 * min_step) == 1e-5 + 0.5 * min_step);
+        DEME_TEST_CHECK(ctrl.ProposeWithin(0., 1e-5 + 2. * min_step) == 1e-5);
+        DEME_TEST_CHECK(ctrl.ProposeWithin(0., 0.3e-5) == 0.3e-5);
+        // Taking the remainder along must not break the max step; then the remainder is split in two
+        ctrl.Reset(max_step);
+        DEME_TEST_CHECK(ctrl.ProposeWithin(0., max_step + 0.5 * min_step) == 0.5 * (max_step + 0.5 * min_step));
+    }
+
+    // A sudden velocity jump: the step taken is rejected, and the retry with the smaller step is accepted
+    {
+        TimeStepController ctrl;
+        TimeStepScales scales;
+        scales.refMass = 1e-2;
+        scales.refRadius = 0.02;
+        scales.minRadius = 0.01;
+        scales.maxEStar = 1e8;
+        ctrl.SetScales(scales);
+        ctrl.SetBounds(min_step, max_step);
+        ctrl.SetRejectionTolerance(0.2);
+        ctrl.Reset(1e-5);
+        // Settle at a slow velocity
+        double h = 0.;
+        for (int i = 0; i < 200; i++) {
+            h = ctrl.Propose(0.01);
+            DEME_TEST_CHECK(ctrl.Accept(h, 0.01));
+        }
+        const double fast = 50.;
+        const bool accepted = ctrl.Accept(h, fast);
+        const double retry = ctrl.Propose(fast);
+        std::printf("Velocity jump: step %.3g at 0.01 m/s, %s at %.0f m/s, retried with %.3g\n", h,
+                    accepted ? "accepted" : "rejected", fast, retry);
+        DEME_TEST_CHECK(!accepted);
+        DEME_TEST_CHECK(ctrl.GetNumRejected() == 1);
+        DEME_TEST_CHECK(retry <= ctrl.AllowedStep(fast) * (1. + 1e-9));
+        DEME_TEST_CHECK(ctrl.Accept(retry, fast));
+        DEME_TEST_CHECK(ctrl.GetNumRejected() == 1);
+        // A step that is within the tolerance of the allowed one is accepted
+        DEME_TEST_CHECK(ctrl.Accept(1.1 * ctrl.AllowedStep(fast), fast));
+        // The min step is never rejected, since there is no smaller one to retry with
+        ctrl.SetBounds(ctrl.AllowedStep(fast) * 10., max_step);
+        DEME_TEST_CHECK(ctrl.Accept(ctrl.AllowedStep(fast) * 10., fast));
+        // Without rejection, any step is accepted
+        TimeStepController no_reject;
+        no_reject.SetScales(scales);
+        DEME_TEST_CHECK(no_reject.Accept(1., fast));
+    }
+
+    return DEMTestResult("DEMtest_TimeStepController");
+}